@@ -64,6 +64,7 @@ free_address (struct ATS_Address *addr)
                                                        addr));
   update_addresses_stat ();
   GAS_plugin_delete_address (addr);
+  GAS_normalization_remove_address (addr);
   GAS_performance_notify_all_clients (&addr->peer,
                                       addr->plugin,
                                       addr->addr,
@@ -247,6 +247,18 @@ struct GAS_NormalizationInfo
    * Normalized values from queue to a range of values [1.0...2.0]
    */
   double norm;
+
+  /**
+   * Node of the address in the heap giving the minimum value of
+   * this property over all addresses, NULL if not yet known.
+   */
+  struct GNUNET_CONTAINER_HeapNode *min_node;
+
+  /**
+   * Node of the address in the heap giving the maximum value of
+   * this property over all addresses, NULL if not yet known.
+   */
+  struct GNUNET_CONTAINER_HeapNode *max_node;
 };
 
 
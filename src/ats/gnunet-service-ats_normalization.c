@@ -34,6 +34,14 @@
 #define LOG(kind,...) GNUNET_log_from (kind, "ats-normalization",__VA_ARGS__)
 
 
+/**
+ * How long do we wait after the range of a property changed before
+ * we renormalize all addresses?  Range changes within this time are
+ * handled by one pass over all addresses.
+ */
+#define RENORMALIZATION_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 250)
+
+
 /**
  * Range information for normalization of quality properties.
  */
@@ -51,11 +59,53 @@ struct PropertyRange
 };
 
 
+/**
+ * Quality properties we normalize.
+ */
+enum NormalizedProperty
+{
+  NP_DELAY = 0,
+  NP_DISTANCE = 1,
+  NP_UTILIZATION_IN = 2,
+  NP_UTILIZATION_OUT = 3,
+  NP_COUNT = 4
+};
+
+
+/**
+ * Heaps of all addresses ordered by the value of a property, so that
+ * we can find the range of the property without looking at all
+ * addresses.
+ */
+struct PropertyHeaps
+{
+  /**
+   * Addresses with the smallest value at the root.
+   */
+  struct GNUNET_CONTAINER_Heap *min;
+
+  /**
+   * Addresses with the largest value at the root.
+   */
+  struct GNUNET_CONTAINER_Heap *max;
+};
+
+
 /**
  * Range information for all quality properties we see.
  */
 static struct PropertyRange property_range;
 
+/**
+ * Heaps for each of the properties we normalize.
+ */
+static struct PropertyHeaps heaps[NP_COUNT];
+
+/**
+ * Task to renormalize all addresses after the range changed.
+ */
+static struct GNUNET_SCHEDULER_Task *renormalize_task;
+
 
 /**
  * Add the value from @a atsi to the running average of the
@@ -93,40 +143,89 @@ update_avg (uint64_t current_val,
 
 
 /**
- * Function called for all addresses and peers to find the minimum and
- * maximum (averaged) values for a given quality property.  Given
- * those, we can then calculate the normalized score.
+ * Get the normalization information of @a address for property @a np.
  *
- * @param cls the `struct PropertyRange`
- * @param h which peer are we looking at (ignored)
- * @param k the address for that peer
- * @return #GNUNET_OK (continue to iterate)
+ * @param address address to inspect
+ * @param np which property
+ * @return normalization information
  */
-static int
-find_min_max_it (void *cls,
-                 const struct GNUNET_PeerIdentity *h,
-                 void *k)
+static struct GAS_NormalizationInfo *
+get_info (struct ATS_Address *address,
+          enum NormalizedProperty np)
 {
-  struct PropertyRange *pr = cls;
-  const struct ATS_Address *a = k;
-
-  pr->max.utilization_out = GNUNET_MAX (pr->max.utilization_out,
-                                        a->properties.utilization_out);
-  pr->max.utilization_in = GNUNET_MAX (pr->max.utilization_in,
-                                       a->properties.utilization_in);
-  pr->max.distance = GNUNET_MAX (pr->max.distance,
-                                 a->properties.distance);
-  pr->max.delay = GNUNET_TIME_relative_max (pr->max.delay,
-                                            a->properties.delay);
-  pr->min.utilization_out = GNUNET_MIN (pr->min.utilization_out,
-                                        a->properties.utilization_out);
-  pr->min.utilization_in = GNUNET_MIN (pr->min.utilization_in,
-                                       a->properties.utilization_in);
-  pr->min.distance = GNUNET_MIN (pr->min.distance,
-                                 a->properties.distance);
-  pr->min.delay = GNUNET_TIME_relative_min (pr->min.delay,
-                                            a->properties.delay);
-  return GNUNET_OK;
+  switch (np)
+  {
+  case NP_DELAY:
+    return &address->norm_delay;
+  case NP_DISTANCE:
+    return &address->norm_distance;
+  case NP_UTILIZATION_IN:
+    return &address->norm_utilization_in;
+  case NP_UTILIZATION_OUT:
+    return &address->norm_utilization_out;
+  default:
+    GNUNET_assert (0);
+  }
+  return NULL;
+}
+
+
+/**
+ * Get the current value of property @a np of @a address.
+ *
+ * @param address address to inspect
+ * @param np which property
+ * @return the value
+ */
+static uint64_t
+get_value (const struct ATS_Address *address,
+           enum NormalizedProperty np)
+{
+  switch (np)
+  {
+  case NP_DELAY:
+    return address->properties.delay.rel_value_us;
+  case NP_DISTANCE:
+    return address->properties.distance;
+  case NP_UTILIZATION_IN:
+    return address->properties.utilization_in;
+  case NP_UTILIZATION_OUT:
+    return address->properties.utilization_out;
+  default:
+    GNUNET_assert (0);
+  }
+  return 0;
+}
+
+
+/**
+ * Find the minimum and maximum values of the quality properties
+ * over all addresses.  Given those, we can then calculate the
+ * normalized score.
+ *
+ * @param[out] pr set to the range of values
+ */
+static void
+find_min_max (struct PropertyRange *pr)
+{
+  const struct ATS_Address *a;
+
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_DELAY].min)))
+    pr->min.delay = a->properties.delay;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_DELAY].max)))
+    pr->max.delay = a->properties.delay;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_DISTANCE].min)))
+    pr->min.distance = a->properties.distance;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_DISTANCE].max)))
+    pr->max.distance = a->properties.distance;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_UTILIZATION_IN].min)))
+    pr->min.utilization_in = a->properties.utilization_in;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_UTILIZATION_IN].max)))
+    pr->max.utilization_in = a->properties.utilization_in;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_UTILIZATION_OUT].min)))
+    pr->min.utilization_out = a->properties.utilization_out;
+  if (NULL != (a = GNUNET_CONTAINER_heap_peek (heaps[NP_UTILIZATION_OUT].max)))
+    pr->max.utilization_out = a->properties.utilization_out;
 }
 
 
@@ -222,6 +321,55 @@ init_range (struct PropertyRange *pr)
 }
 
 
+/**
+ * The range of a property changed a while ago, (re)normalize all
+ * addresses and tell the solver about them in one bulk operation.
+ *
+ * @param cls NULL
+ */
+static void
+renormalize_all (void *cls)
+{
+  renormalize_task = NULL;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Renormalizing all addresses\n");
+  GAS_plugin_solver_lock ();
+  GNUNET_CONTAINER_multipeermap_iterate (GSA_addresses,
+                                         &normalize_address,
+                                         NULL);
+  GNUNET_CONTAINER_multipeermap_iterate (GSA_addresses,
+                                         &notify_change,
+                                         NULL);
+  GAS_plugin_solver_unlock ();
+}
+
+
+/**
+ * Recompute the range of all properties.  If it changed, schedule
+ * renormalization of all addresses.
+ *
+ * @return #GNUNET_YES if the range changed
+ */
+static int
+update_range ()
+{
+  struct PropertyRange range;
+
+  init_range (&range);
+  find_min_max (&range);
+  if (0 == memcmp (&range,
+                   &property_range,
+                   sizeof (struct PropertyRange)))
+    return GNUNET_NO;
+  property_range = range;
+  if (NULL == renormalize_task)
+    renormalize_task = GNUNET_SCHEDULER_add_delayed (RENORMALIZATION_DELAY,
+                                                     &renormalize_all,
+                                                     NULL);
+  return GNUNET_YES;
+}
+
+
 /**
  * Update and normalize atsi performance information
  *
@@ -231,7 +379,6 @@ void
 GAS_normalization_update_property (struct ATS_Address *address)
 {
   const struct GNUNET_ATS_Properties *prop = &address->properties;
-  struct PropertyRange range;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Updating properties for peer `%s'\n",
@@ -246,34 +393,64 @@ GAS_normalization_update_property (struct ATS_Address *address)
   update_avg (prop->utilization_in,
               &address->norm_utilization_out);
 
-  init_range (&range);
-  GNUNET_CONTAINER_multipeermap_iterate (GSA_addresses,
-                                         &find_min_max_it,
-                                         &range);
-  if (0 != memcmp (&range,
-                   &property_range,
-                   sizeof (struct PropertyRange)))
+  for (enum NormalizedProperty np = 0; np < NP_COUNT; np++)
   {
-    /* limits changed, (re)normalize all addresses */
-    property_range = range;
-    GNUNET_CONTAINER_multipeermap_iterate (GSA_addresses,
-                                           &normalize_address,
-                                           NULL);
-    GNUNET_CONTAINER_multipeermap_iterate (GSA_addresses,
-                                           &notify_change,
-                                           NULL);
+    struct GAS_NormalizationInfo *ni = get_info (address,
+                                                 np);
+    uint64_t value = get_value (address,
+                                np);
+
+    if (NULL == ni->min_node)
+    {
+      ni->min_node = GNUNET_CONTAINER_heap_insert (heaps[np].min,
+                                                   address,
+                                                   value);
+      ni->max_node = GNUNET_CONTAINER_heap_insert (heaps[np].max,
+                                                   address,
+                                                   value);
+    }
+    else
+    {
+      GNUNET_CONTAINER_heap_update_cost (ni->min_node,
+                                         value);
+      GNUNET_CONTAINER_heap_update_cost (ni->max_node,
+                                         value);
+    }
   }
-  else
+  /* If the limits changed, the other addresses are renormalized
+     later; this one we renormalize right away. */
+  (void) update_range ();
+  normalize_address (NULL,
+                     &address->peer,
+                     address);
+  notify_change (NULL,
+                 &address->peer,
+                 address);
+  GAS_plugin_solver_unlock ();
+}
+
+
+/**
+ * Forget about the properties of an address that is going away.
+ *
+ * @param address the address to remove
+ */
+void
+GAS_normalization_remove_address (struct ATS_Address *address)
+{
+  for (enum NormalizedProperty np = 0; np < NP_COUNT; np++)
   {
-    /* renormalize just this one address */
-    normalize_address (NULL,
-                       &address->peer,
-                       address);
-    notify_change (NULL,
-                   &address->peer,
-                   address);
+    struct GAS_NormalizationInfo *ni = get_info (address,
+                                                 np);
+
+    if (NULL == ni->min_node)
+      continue;
+    GNUNET_CONTAINER_heap_remove_node (ni->min_node);
+    GNUNET_CONTAINER_heap_remove_node (ni->max_node);
+    ni->min_node = NULL;
+    ni->max_node = NULL;
   }
-  GAS_plugin_solver_unlock ();
+  (void) update_range ();
 }
 
 
@@ -284,6 +461,11 @@ void
 GAS_normalization_start ()
 {
   init_range (&property_range);
+  for (enum NormalizedProperty np = 0; np < NP_COUNT; np++)
+  {
+    heaps[np].min = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+    heaps[np].max = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MAX);
+  }
 }
 
 
@@ -293,7 +475,18 @@ GAS_normalization_start ()
 void
 GAS_normalization_stop ()
 {
-  /* nothing to do */
+  if (NULL != renormalize_task)
+  {
+    GNUNET_SCHEDULER_cancel (renormalize_task);
+    renormalize_task = NULL;
+  }
+  for (enum NormalizedProperty np = 0; np < NP_COUNT; np++)
+  {
+    GNUNET_CONTAINER_heap_destroy (heaps[np].min);
+    GNUNET_CONTAINER_heap_destroy (heaps[np].max);
+    heaps[np].min = NULL;
+    heaps[np].max = NULL;
+  }
 }
 
 
@@ -43,6 +43,15 @@ void
 GAS_normalization_update_property (struct ATS_Address *address);
 
 
+/**
+ * Forget about the properties of an address that is going away.
+ *
+ * @param address the address to remove
+ */
+void
+GAS_normalization_remove_address (struct ATS_Address *address);
+
+
 /**
  * Start the normalization component
  */
@@ -32,7 +32,6 @@
 #include "gnunet-service-ats_preferences.h"
 #include "gnunet_ats_service.h"
 #include "gnunet_ats_plugin.h"
-#include "test_ats_api_common.h"
 
 #define DEFAULT_UPDATE_PERCENTAGE       20
 #define DEFAULT_PEERS_START     10
@@ -40,12 +39,32 @@
 #define DEFAULT_ADDRESSES       10
 #define DEFAULT_ATS_COUNT       2
 
+/**
+ * Number of property updates to time when measuring normalization.
+ */
+#define NORMALIZATION_UPDATES 100000
+
+/**
+ * Largest number of addresses to measure normalization with.
+ */
+#define NORMALIZATION_MAX_ADDRESSES 100000
+
+/**
+ * Number of rounds of churn to average over.
+ */
+#define CHURN_ROUNDS 100
+
 
 /**
  * Handle for statistics.
  */
 struct GNUNET_STATISTICS_Handle *GSA_stats;
 
+/**
+ * All addresses, used by normalization.
+ */
+struct GNUNET_CONTAINER_MultiPeerMap *GSA_addresses;
+
 /**
  * Handle for ATS address component
  */
@@ -136,6 +155,22 @@ struct PerfHandle
    */
   int measure_updates;
 
+  /**
+   * Measure throughput of property updates
+   */
+  int measure_normalization;
+
+  /**
+   * Measure solver latency under churn
+   */
+  int measure_churn;
+
+  /**
+   * Are we timing the solver ourselves?  Then we ignore what
+   * the solver tells us about its progress.
+   */
+  int own_timing;
+
   /**
    * Number of iterations
    */
@@ -328,12 +363,91 @@ end_now (int res)
   GNUNET_free_non_null (ph.peers);
   GNUNET_free_non_null (ph.iterations_results);
 
-  GAS_normalization_stop ();
-  GAS_preference_done ();
+  if (NULL != GSA_addresses)
+    GAS_normalization_stop ();
   ret = res;
 }
 
 
+/**
+ * Stop instant solving, there are many state updates
+ * happening in bulk right now.
+ */
+void
+GAS_plugin_solver_lock ()
+{
+  ph.sf->s_bulk_start (ph.sf->cls);
+}
+
+
+/**
+ * Resume instant solving, we are done with the bulk state updates.
+ */
+void
+GAS_plugin_solver_unlock ()
+{
+  ph.sf->s_bulk_stop (ph.sf->cls);
+}
+
+
+/**
+ * The relative value for a property changed.
+ *
+ * @param address the peer for which a property changed
+ */
+void
+GAS_plugin_notify_property_changed (struct ATS_Address *address)
+{
+  ph.sf->s_address_update_property (ph.sf->cls,
+                                    address);
+}
+
+
+/**
+ * Load quotas for networks from configuration
+ *
+ * @param cfg configuration handle
+ * @param out_dest where to write outbound quotas
+ * @param in_dest where to write inbound quotas
+ * @param dest_length length of inbound and outbound arrays
+ * @return number of networks loaded
+ */
+static unsigned int
+load_quotas (const struct GNUNET_CONFIGURATION_Handle *cfg,
+             unsigned long long *out_dest,
+             unsigned long long *in_dest,
+             int dest_length)
+{
+  char *entry;
+  unsigned int c;
+
+  for (c = 0; (c < GNUNET_ATS_NetworkTypeCount) && (c < dest_length); c++)
+  {
+    GNUNET_asprintf (&entry,
+                     "%s_QUOTA_OUT",
+                     GNUNET_ATS_print_network_type (c));
+    if (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_size (cfg,
+                                             "ats",
+                                             entry,
+                                             &out_dest[c]))
+      out_dest[c] = GNUNET_ATS_DefaultBandwidth;
+    GNUNET_free (entry);
+    GNUNET_asprintf (&entry,
+                     "%s_QUOTA_IN",
+                     GNUNET_ATS_print_network_type (c));
+    if (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_size (cfg,
+                                             "ats",
+                                             entry,
+                                             &in_dest[c]))
+      in_dest[c] = GNUNET_ATS_DefaultBandwidth;
+    GNUNET_free (entry);
+  }
+  return c;
+}
+
+
 /**
  * Create a peer used for benchmarking
  *
@@ -360,35 +474,29 @@ perf_update_address (struct ATS_Address *cur)
 {
   int r_type;
   int abs_val;
-  double rel_val;
 
   r_type = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 2);
   switch (r_type)
   {
   case 0:
     abs_val = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 100);
-    rel_val = (100 + (double) abs_val) / 100;
-
     GNUNET_log(GNUNET_ERROR_TYPE_INFO,
-        "Updating peer `%s' address %p type %s abs val %u rel val %.3f\n",
+        "Updating peer `%s' address %p type %s abs val %u\n",
         GNUNET_i2s (&cur->peer), cur,
-        "GNUNET_ATS_QUALITY_NET_DELAY",
-        abs_val, rel_val);
-    ph.sf->s_address_update_property (ph.sf->cls, cur,
-        GNUNET_ATS_QUALITY_NET_DELAY,
-        abs_val, rel_val);
+        "delay",
+        abs_val);
+    cur->properties.delay = GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS,
+                                                           abs_val);
+    GAS_normalization_update_property (cur);
     break;
   case 1:
     abs_val = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 10);
-    rel_val = (100 + (double) abs_val) / 100;
-
     GNUNET_log(GNUNET_ERROR_TYPE_INFO,
-        "Updating peer `%s' address %p type %s abs val %u rel val %.3f\n",
-        GNUNET_i2s (&cur->peer), cur, "GNUNET_ATS_QUALITY_NET_DISTANCE",
-        abs_val, rel_val);
-    ph.sf->s_address_update_property (ph.sf->cls, cur,
-        GNUNET_ATS_QUALITY_NET_DISTANCE,
-        abs_val, rel_val);
+        "Updating peer `%s' address %p type %s abs val %u\n",
+        GNUNET_i2s (&cur->peer), cur, "distance",
+        abs_val);
+    cur->properties.distance = abs_val;
+    GAS_normalization_update_property (cur);
     break;
   default:
     break;
@@ -418,7 +526,12 @@ bandwidth_changed_cb (void *cls,
 static const double *
 get_preferences_cb (void *cls, const struct GNUNET_PeerIdentity *id)
 {
-  return GAS_preference_get_by_peer (NULL, id);
+  static double prefs[GNUNET_ATS_PREFERENCE_END];
+  unsigned int c;
+
+  for (c = 0; c < GNUNET_ATS_PREFERENCE_END; c++)
+    prefs[c] = DEFAULT_REL_PREFERENCE;
+  return prefs;
 }
 
 
@@ -427,23 +540,18 @@ perf_address_initial_update (void *dead,
     struct GNUNET_CONTAINER_MultiPeerMap * addresses,
     struct ATS_Address *address)
 {
-  double delay;
-  double distance;
-  uint32_t random = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 100);
-  delay = (100 + (double) random) / 100;
-  ph.sf->s_address_update_property (ph.sf->cls,
-                                    address, GNUNET_ATS_QUALITY_NET_DELAY,
-      100,  delay);
-
-  random = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 100);
-  distance = (100 + (double) random) / 100;
+  uint32_t delay;
+  uint32_t distance;
 
-  ph.sf->s_address_update_property (ph.sf->cls, address,
-                                    GNUNET_ATS_QUALITY_NET_DISTANCE,
-                                    10, distance);
+  delay = 100 + GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 100);
+  distance = 1 + GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 10);
+  address->properties.delay = GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS,
+                                                             delay);
+  address->properties.distance = distance;
+  GAS_normalization_update_property (address);
 
   GNUNET_log(GNUNET_ERROR_TYPE_INFO,
-             "Initial update address %p : %.2f  %.2f\n",
+             "Initial update address %p : %u ms  %u\n",
              address, delay, distance);
 }
 
@@ -536,10 +644,26 @@ perf_update_all_addresses (unsigned int cp, unsigned int ca, unsigned int percen
 static struct ATS_Address *
 perf_create_address (int cp, int ca)
 {
+  static const char plugin_addr[] = "test 1";
   struct ATS_Address *a;
-
-  a = create_address (&ph.peers[cp].id,
-      "Test 1", "test 1", strlen ("test 1") + 1, 0);
+  unsigned int c;
+
+  a = GNUNET_malloc (sizeof (struct ATS_Address) + sizeof (plugin_addr));
+  a->peer = ph.peers[cp].id;
+  a->addr_len = sizeof (plugin_addr);
+  a->addr = &a[1];
+  GNUNET_memcpy (&a[1],
+                 plugin_addr,
+                 sizeof (plugin_addr));
+  a->plugin = GNUNET_strdup ("Test 1");
+  a->session_id = 1 + ca;
+  for (c = 0; c < GAS_normalization_queue_length; c++)
+  {
+    a->norm_delay.atsi_abs[c] = UINT64_MAX;
+    a->norm_distance.atsi_abs[c] = UINT64_MAX;
+    a->norm_utilization_in.atsi_abs[c] = UINT64_MAX;
+    a->norm_utilization_out.atsi_abs[c] = UINT64_MAX;
+  }
   GNUNET_CONTAINER_multipeermap_put (ph.addresses, &ph.peers[cp].id, a,
       GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
   return a;
@@ -560,6 +684,9 @@ solver_info_cb (void *cls,
     enum GAS_Solver_Additional_Information add)
 {
   char *add_info;
+
+  if (GNUNET_YES == ph.own_timing)
+    return;
   switch (add) {
     case GAS_INFO_NONE:
       add_info = "GAS_INFO_NONE";
@@ -1063,19 +1190,195 @@ do_delete_address (void *cls,
   struct ATS_Address *cur = value;
 
   GNUNET_log(GNUNET_ERROR_TYPE_DEBUG,
-             "Deleting addresses for peer %u\n",
-             pid);
+             "Deleting addresses for peer %s\n",
+             GNUNET_i2s (pid));
   GNUNET_assert (GNUNET_OK ==
                  GNUNET_CONTAINER_multipeermap_remove (ph.addresses,
                                                        pid,
                                                        cur));
   ph.sf->s_del (ph.sf->cls, cur);
-  GNUNET_free_non_null (cur->atsi);
+  GAS_normalization_remove_address (cur);
+  GNUNET_free (cur->plugin);
   GNUNET_free (cur);
   return GNUNET_OK;
 }
 
 
+/**
+ * Measure how many address property updates per second the
+ * normalization (and the solver, which is kept in bulk mode) can
+ * take with @a count_a addresses.
+ *
+ * @param count_a number of addresses
+ * @return updates per second
+ */
+static unsigned long long
+perf_measure_normalization (unsigned int count_a)
+{
+  struct ATS_Address **addrs;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative delta;
+  unsigned int cp;
+
+  ph.own_timing = GNUNET_YES;
+  /* one address per peer */
+  addrs = GNUNET_new_array (count_a,
+                            struct ATS_Address *);
+  ph.peers = GNUNET_new_array (count_a,
+                               struct PerfPeer);
+  ph.sf->s_bulk_start (ph.sf->cls);
+  for (cp = 0; cp < count_a; cp++)
+  {
+    perf_create_peer (cp);
+    addrs[cp] = perf_create_address (cp, 0);
+    addrs[cp]->properties.scope = GNUNET_ATS_NET_WAN;
+    ph.sf->s_add (ph.sf->cls,
+                  addrs[cp],
+                  GNUNET_ATS_NET_WAN);
+    perf_address_initial_update (NULL,
+                                 ph.addresses,
+                                 addrs[cp]);
+  }
+  start = GNUNET_TIME_absolute_get ();
+  for (cp = 0; cp < NORMALIZATION_UPDATES; cp++)
+    perf_update_address (addrs[GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                                         count_a)]);
+  delta = GNUNET_TIME_absolute_get_duration (start);
+  for (cp = 0; cp < count_a; cp++)
+    GNUNET_CONTAINER_multipeermap_get_multiple (ph.addresses,
+                                                &ph.peers[cp].id,
+                                                &do_delete_address,
+                                                NULL);
+  ph.sf->s_bulk_stop (ph.sf->cls);
+  GNUNET_free (ph.peers);
+  ph.peers = NULL;
+  GNUNET_free (addrs);
+  ph.own_timing = GNUNET_NO;
+  return (1000LL * 1000LL * NORMALIZATION_UPDATES)
+    / GNUNET_MAX (1, delta.rel_value_us);
+}
+
+
+/**
+ * Delete the address selected by the `struct DUA_Ctx`.
+ *
+ * @param cls the `struct DUA_Ctx`
+ * @param pid peer of the address
+ * @param value the `struct ATS_Address`
+ * @return #GNUNET_NO once we deleted the address
+ */
+static int
+do_churn_address (void *cls,
+                  const struct GNUNET_PeerIdentity *pid,
+                  void *value)
+{
+  struct DUA_Ctx *ctx = cls;
+
+  if (ctx->c_cur_a++ != ctx->r)
+    return GNUNET_OK;
+  do_delete_address (NULL,
+                     pid,
+                     value);
+  return GNUNET_NO;
+}
+
+
+/**
+ * Add an address for a peer and tell the solver about it.
+ *
+ * @param cp index of the peer
+ * @param ca index of the address
+ */
+static void
+perf_add_address (int cp,
+                  int ca)
+{
+  struct ATS_Address *a;
+  uint32_t net;
+
+  /* Random equally distributed network selection */
+  net = 1 + (ca %  (GNUNET_ATS_NetworkTypeCount - 1));
+  a = perf_create_address (cp, ca);
+  a->properties.scope = net;
+  ph.sf->s_add (ph.sf->cls, a, net);
+  perf_address_initial_update (NULL, ph.addresses, a);
+}
+
+
+/**
+ * Measure how long the solver takes to adapt after a round of churn,
+ * in which the configured percentage of peers each lose an address
+ * and gain a new one.
+ *
+ * @param count_p number of peers
+ * @param count_a number of addresses per peer
+ * @return average time the solver took per round
+ */
+static struct GNUNET_TIME_Relative
+perf_measure_churn (unsigned int count_p,
+                    unsigned int count_a)
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative total;
+  struct DUA_Ctx dua_ctx;
+  unsigned int churn;
+  unsigned int cp;
+  unsigned int c;
+  unsigned int round;
+
+  ph.own_timing = GNUNET_YES;
+  ph.peers = GNUNET_new_array (count_p,
+                               struct PerfPeer);
+  ph.sf->s_bulk_start (ph.sf->cls);
+  for (cp = 0; cp < count_p; cp++)
+  {
+    perf_create_peer (cp);
+    for (c = 0; c < count_a; c++)
+      perf_add_address (cp, c);
+    ph.sf->s_get (ph.sf->cls, &ph.peers[cp].id);
+  }
+  ph.sf->s_bulk_stop (ph.sf->cls);
+
+  churn = GNUNET_MAX (1, count_p * ph.opt_update_percent / 100);
+  total = GNUNET_TIME_UNIT_ZERO;
+  for (round = 0; round < CHURN_ROUNDS; round++)
+  {
+    ph.sf->s_bulk_start (ph.sf->cls);
+    for (c = 0; c < churn; c++)
+    {
+      cp = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, count_p);
+      dua_ctx.c_cur_a = 0;
+      dua_ctx.r = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, count_a);
+      GNUNET_CONTAINER_multipeermap_get_multiple (ph.addresses,
+                                                  &ph.peers[cp].id,
+                                                  &do_churn_address,
+                                                  &dua_ctx);
+      perf_add_address (cp, round * churn + c);
+    }
+    start = GNUNET_TIME_absolute_get ();
+    ph.sf->s_bulk_stop (ph.sf->cls);
+    total = GNUNET_TIME_relative_add (total,
+                                      GNUNET_TIME_absolute_get_duration (start));
+  }
+
+  ph.sf->s_bulk_start (ph.sf->cls);
+  for (cp = 0; cp < count_p; cp++)
+  {
+    ph.sf->s_get_stop (ph.sf->cls, &ph.peers[cp].id);
+    GNUNET_CONTAINER_multipeermap_get_multiple (ph.addresses,
+                                                &ph.peers[cp].id,
+                                                &do_delete_address,
+                                                NULL);
+  }
+  ph.sf->s_bulk_stop (ph.sf->cls);
+  GNUNET_free (ph.peers);
+  ph.peers = NULL;
+  ph.own_timing = GNUNET_NO;
+  return GNUNET_TIME_relative_divide (total,
+                                      CHURN_ROUNDS);
+}
+
+
 /**
  * Run a performance iteration
  */
@@ -1119,10 +1422,7 @@ perf_run_iteration (void)
       /* fprintf (stderr, "Network: %u `%s'\n",
        * mod_net , GNUNET_ATS_print_network_type(mod_net)); */
 
-      cur_addr->atsi = GNUNET_new (struct GNUNET_ATS_Information);
-      cur_addr->atsi_count = 1;
-      cur_addr->atsi[0].type = htonl (GNUNET_ATS_NETWORK_TYPE);
-      cur_addr->atsi[0].value = htonl (net);
+      cur_addr->properties.scope = net;
       ph.sf->s_add (ph.sf->cls, cur_addr, net);
 
       ph.current_a = ca + 1;
@@ -1198,6 +1498,7 @@ perf_run_iteration (void)
   GNUNET_log(GNUNET_ERROR_TYPE_INFO,
       "Iteration done\n");
   GNUNET_free(ph.peers);
+  ph.peers = NULL;
 }
 
 
@@ -1321,8 +1622,8 @@ run (void *cls, char * const *args, const char *cfgfile,
                 ph.env.out_quota[c],
                 ph.env.in_quota[c]);
   }
+  GSA_addresses = ph.addresses;
   GAS_normalization_start ();
-  GAS_preference_init ();
 
   GNUNET_asprintf (&plugin,
                    "libgnunet_plugin_ats_%s",
@@ -1339,6 +1640,31 @@ run (void *cls, char * const *args, const char *cfgfile,
     return;
   }
 
+  if (GNUNET_YES == ph.measure_normalization)
+  {
+    unsigned int count_a;
+
+    /* Measure property updates instead of solutions */
+    for (count_a = 1000; count_a <= NORMALIZATION_MAX_ADDRESSES; count_a *= 10)
+      fprintf (stderr,
+               "Property updates with %u addresses: %llu updates/s\n",
+               count_a,
+               perf_measure_normalization (count_a));
+    ph.total_iterations = 0;
+  }
+  if (GNUNET_YES == ph.measure_churn)
+  {
+    /* Measure how fast the solver adapts to peers coming and going */
+    fprintf (stderr,
+             "Solver latency under churn of %u%% of %u peers with %u addresses: %llu us\n",
+             ph.opt_update_percent,
+             ph.N_peers_end,
+             ph.N_address,
+             (unsigned long long) perf_measure_churn (ph.N_peers_end,
+                                                      ph.N_address).rel_value_us);
+    ph.total_iterations = 0;
+  }
+
   /* Do the benchmark */
   for (ph.current_iteration = 1; ph.current_iteration <= ph.total_iterations; ph.current_iteration++)
   {
@@ -1378,9 +1704,12 @@ run (void *cls, char * const *args, const char *cfgfile,
     GNUNET_free(ph.iterations_results[c].results_array);
   }
   GNUNET_free (ph.iterations_results);
+  ph.iterations_results = NULL;
 
   GNUNET_CONFIGURATION_destroy (solver_cfg);
-  GNUNET_STATISTICS_destroy (ph.stat, GNUNET_NO);
+  end_now (0);
+  GNUNET_CONTAINER_multipeermap_destroy (ph.addresses);
+  GSA_addresses = NULL;
 }
 
 
@@ -1401,6 +1730,8 @@ main (int argc, char *argv[])
   ph.ats_string = NULL;
   ph.create_datafile = GNUNET_NO;
   ph.measure_updates = GNUNET_NO;
+  ph.measure_normalization = GNUNET_NO;
+  ph.measure_churn = GNUNET_NO;
   ph.total_iterations = 1;
 
   static struct GNUNET_GETOPT_CommandLineOption options[] = {
@@ -1425,6 +1756,12 @@ main (int argc, char *argv[])
       { 'u', "update", NULL,
           gettext_noop ("measure updates"),
           0, &GNUNET_GETOPT_set_one, &ph.measure_updates},
+      { 'n', "normalization", NULL,
+          gettext_noop ("measure throughput of address property updates with 1k to 100k addresses"),
+          0, &GNUNET_GETOPT_set_one, &ph.measure_normalization},
+      { 'C', "churn", NULL,
+          gettext_noop ("measure solver latency while the percentage of peers given with -p changes addresses"),
+          0, &GNUNET_GETOPT_set_one, &ph.measure_churn},
       GNUNET_GETOPT_OPTION_END
   };
 
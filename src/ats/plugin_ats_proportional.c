@@ -51,6 +51,15 @@
 #define PROPORTIONALITY_FACTOR 2.0
 
 
+/**
+ * Default time we wait after a change outside of a bulk operation
+ * before we redistribute bandwidth, so that bursts of changes (for
+ * example when many peers come and go) result in one recalculation
+ * per affected network.
+ */
+#define PROP_COALESCE_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 10)
+
+
 /**
  * Address information stored for the proportional solver in the
  * `solver_information` member of `struct GNUNET_ATS_Address`.
@@ -153,6 +162,12 @@ struct Network
    */
   unsigned int total_addresses;
 
+  /**
+   * Did something change in this network since we last distributed
+   * its bandwidth?
+   */
+  int dirty;
+
 };
 
 
@@ -182,16 +197,26 @@ struct GAS_PROPORTIONAL_Handle
    */
   double stability_factor;
 
+  /**
+   * Task to redistribute bandwidth in the dirty networks.
+   */
+  struct GNUNET_SCHEDULER_Task *coalesce_task;
+
+  /**
+   * How long do we collect changes outside of bulk operations
+   * before we redistribute bandwidth?
+   */
+  struct GNUNET_TIME_Relative coalesce_delay;
+
   /**
    * Bulk lock counter. If zero, we are not locked.
    */
   unsigned int bulk_lock;
 
   /**
-   * Number of changes made while solver was locked.  We really only
-   * use 0/non-zero to check on unlock if we have to run the update.
+   * Number of networks marked dirty.
    */
-  unsigned int bulk_requests;
+  unsigned int dirty_networks;
 
   /**
    * Number of active addresses for solver
@@ -242,6 +267,8 @@ all_require_connectivity (struct GAS_PROPORTIONAL_Handle *s,
 {
   struct AddressWrapper *aw;
 
+  if (0 == con)
+    return GNUNET_YES;
   for (aw = net->head; NULL != aw; aw = aw->next)
     if (con >
         s->env->get_connectivity (s->env->cls,
@@ -409,9 +436,84 @@ propagate_bandwidth (struct GAS_PROPORTIONAL_Handle *s,
 }
 
 
+/**
+ * Distribute bandwidth in all networks marked dirty and notify
+ * about the changes.
+ *
+ * @param s the solver handle
+ */
+static void
+distribute_bandwidth_in_dirty_networks (struct GAS_PROPORTIONAL_Handle *s)
+{
+  enum GAS_Solver_Additional_Information info;
+  unsigned int i;
+
+  if (0 == s->dirty_networks)
+    return;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Redistributing bandwidth in %u of %u networks\n",
+       s->dirty_networks,
+       s->env->network_count);
+  info = (1 == s->dirty_networks) ? GAS_INFO_PROP_SINGLE : GAS_INFO_PROP_ALL;
+  s->env->info_cb (s->env->cls,
+                   GAS_OP_SOLVE_START,
+                   GAS_STAT_SUCCESS,
+                   info);
+  for (i = 0; i < s->env->network_count; i++)
+    if (GNUNET_YES == s->network_entries[i].dirty)
+      distribute_bandwidth (s,
+                            &s->network_entries[i]);
+  s->env->info_cb (s->env->cls,
+                   GAS_OP_SOLVE_STOP,
+                   GAS_STAT_SUCCESS,
+                   info);
+  s->env->info_cb (s->env->cls,
+                   GAS_OP_SOLVE_UPDATE_NOTIFICATION_START,
+                   GAS_STAT_SUCCESS,
+                   info);
+  for (i = 0; i < s->env->network_count; i++)
+  {
+    if (GNUNET_YES != s->network_entries[i].dirty)
+      continue;
+    s->network_entries[i].dirty = GNUNET_NO;
+    propagate_bandwidth (s,
+                         &s->network_entries[i]);
+  }
+  s->dirty_networks = 0;
+  s->env->info_cb (s->env->cls,
+                   GAS_OP_SOLVE_UPDATE_NOTIFICATION_STOP,
+                   GAS_STAT_SUCCESS,
+                   info);
+  GNUNET_STATISTICS_update (s->env->stats,
+                            "# ATS bandwidth redistributions",
+                            1,
+                            GNUNET_NO);
+}
+
+
+/**
+ * Redistribute bandwidth after collecting changes for a while.
+ *
+ * @param cls the `struct GAS_PROPORTIONAL_Handle`
+ */
+static void
+coalesced_distribute (void *cls)
+{
+  struct GAS_PROPORTIONAL_Handle *s = cls;
+
+  s->coalesce_task = NULL;
+  if (0 != s->bulk_lock)
+    return; /* done when the bulk operation is */
+  distribute_bandwidth_in_dirty_networks (s);
+}
+
+
 /**
  * Distribute bandwidth.  The addresses have already been selected,
  * this is merely distributed the bandwidth among the addresses.
+ * We only mark the network as dirty here; the bandwidth is
+ * distributed at the end of the current bulk operation, or after
+ * #PROP_COALESCE_DELAY if there is none.
  *
  * @param s the solver handle
  * @param n the network, can be NULL for all networks
@@ -422,68 +524,27 @@ distribute_bandwidth_in_network (struct GAS_PROPORTIONAL_Handle *s,
 {
   unsigned int i;
 
-  if (0 != s->bulk_lock)
-  {
-    s->bulk_requests++;
-    return;
-  }
-  if (NULL != n)
+  for (i = 0; i < s->env->network_count; i++)
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-        "Redistributing bandwidth in network %s with %u active and %u total addresses\n",
-         GNUNET_ATS_print_network_type(n->type),
-         n->active_addresses,
-         n->total_addresses);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_START,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_SINGLE);
-    distribute_bandwidth(s,
-                         n);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_STOP,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_SINGLE);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_UPDATE_NOTIFICATION_START,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_SINGLE);
-    propagate_bandwidth (s,
-                         n);
-
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_UPDATE_NOTIFICATION_STOP,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_SINGLE);
+    if ( (NULL != n) &&
+         (n != &s->network_entries[i]) )
+      continue;
+    if (GNUNET_YES == s->network_entries[i].dirty)
+      continue;
+    s->network_entries[i].dirty = GNUNET_YES;
+    s->dirty_networks++;
   }
-  else
+  if (0 != s->bulk_lock)
+    return;
+  if (0 == s->coalesce_delay.rel_value_us)
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "Redistributing bandwidth in all %u networks\n",
-         s->env->network_count);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_START,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_ALL);
-    for (i = 0; i < s->env->network_count; i++)
-      distribute_bandwidth (s,
-                            &s->network_entries[i]);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_STOP,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_ALL);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_UPDATE_NOTIFICATION_START,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_ALL);
-    for (i = 0; i < s->env->network_count; i++)
-      propagate_bandwidth (s,
-                           &s->network_entries[i]);
-    s->env->info_cb (s->env->cls,
-                     GAS_OP_SOLVE_UPDATE_NOTIFICATION_STOP,
-                     GAS_STAT_SUCCESS,
-                     GAS_INFO_PROP_ALL);
+    distribute_bandwidth_in_dirty_networks (s);
+    return;
   }
+  if (NULL == s->coalesce_task)
+    s->coalesce_task = GNUNET_SCHEDULER_add_delayed (s->coalesce_delay,
+                                                     &coalesced_distribute,
+                                                     s);
 }
 
 
@@ -501,6 +562,15 @@ struct FindBestAddressCtx
    * The currently best address
    */
   struct ATS_Address *best;
+
+  /**
+   * Result of #all_require_connectivity() for each network and
+   * the connectivity requirement of the peer, #GNUNET_SYSERR if
+   * not yet computed.  The requirement is the same for all
+   * addresses of the peer, so we need to check each network
+   * at most once.
+   */
+  int all_require[GNUNET_ATS_NetworkTypeCount];
 };
 
 
@@ -544,12 +614,16 @@ find_best_address_it (void *cls,
   /* we can gain -1 slot if this peers connectivity
      requirement is higher than that of another peer
      in that network scope */
-  con = ctx->s->env->get_connectivity (ctx->s->env->cls,
-                                       key);
-  if (GNUNET_YES !=
-      all_require_connectivity (ctx->s,
-                                asi->network,
-                                con))
+  if (GNUNET_SYSERR == ctx->all_require[asi->network->type])
+  {
+    con = ctx->s->env->get_connectivity (ctx->s->env->cls,
+                                         key);
+    ctx->all_require[asi->network->type]
+      = all_require_connectivity (ctx->s,
+                                  asi->network,
+                                  con);
+  }
+  if (GNUNET_YES != ctx->all_require[asi->network->type])
     need--;
   /* test if minimum bandwidth for 'current' would be available */
   bw_available
@@ -633,9 +707,12 @@ get_best_address (struct GAS_PROPORTIONAL_Handle *s,
                   const struct GNUNET_PeerIdentity *id)
 {
   struct FindBestAddressCtx fba_ctx;
+  unsigned int i;
 
   fba_ctx.best = NULL;
   fba_ctx.s = s;
+  for (i = 0; i < GNUNET_ATS_NetworkTypeCount; i++)
+    fba_ctx.all_require[i] = GNUNET_SYSERR;
   GNUNET_CONTAINER_multipeermap_get_multiple (addresses,
                                               id,
                                               &find_best_address_it,
@@ -968,13 +1045,16 @@ GAS_proportional_bulk_stop (void *solver)
   }
   s->bulk_lock--;
   if ( (0 == s->bulk_lock) &&
-       (0 < s->bulk_requests) )
+       (0 < s->dirty_networks) )
   {
     LOG (GNUNET_ERROR_TYPE_INFO,
          "No lock pending, recalculating\n");
-    distribute_bandwidth_in_network (s,
-                                     NULL);
-    s->bulk_requests = 0;
+    if (NULL != s->coalesce_task)
+    {
+      GNUNET_SCHEDULER_cancel (s->coalesce_task);
+      s->coalesce_task = NULL;
+    }
+    distribute_bandwidth_in_dirty_networks (s);
   }
 }
 
@@ -1151,6 +1231,12 @@ libgnunet_plugin_ats_proportional_init (void *cls)
            f_tmp);
     }
   }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_time (env->cfg,
+                                           "ats",
+                                           "PROP_COALESCE_DELAY",
+                                           &s->coalesce_delay))
+    s->coalesce_delay = PROP_COALESCE_DELAY;
   s->prop_factor = PROPORTIONALITY_FACTOR;
   if (GNUNET_SYSERR !=
       GNUNET_CONFIGURATION_get_value_float (env->cfg,
@@ -1215,6 +1301,11 @@ libgnunet_plugin_ats_proportional_done (void *cls)
   struct AddressWrapper *next;
   unsigned int c;
 
+  if (NULL != s->coalesce_task)
+  {
+    GNUNET_SCHEDULER_cancel (s->coalesce_task);
+    s->coalesce_task = NULL;
+  }
   for (c = 0; c < s->env->network_count; c++)
   {
     GNUNET_break (0 == s->network_entries[c].total_addresses);
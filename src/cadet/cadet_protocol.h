@@ -434,6 +434,15 @@ struct GNUNET_CADET_ChannelOpenMessage
    * ID of the channel within the tunnel.
    */
   struct GNUNET_CADET_ChannelTunnelNumber ctn;
+
+#ifdef NEW_CADET
+  /**
+   * Receive window of the initiator: how many messages past the next
+   * one expected it accepts.  The destination must not have more
+   * messages in flight.  0 if not announced.
+   */
+  uint32_t window GNUNET_PACKED;
+#endif
 };
 
 
@@ -452,9 +461,12 @@ struct GNUNET_CADET_ChannelManageMessage
 
 #ifdef NEW_CADET
   /**
-   * For alignment.
+   * For #GNUNET_MESSAGE_TYPE_CADET_CHANNEL_OPEN_ACK, the receive
+   * window of the destination, see
+   * `struct GNUNET_CADET_ChannelOpenMessage`.  Always 0 for
+   * #GNUNET_MESSAGE_TYPE_CADET_CHANNEL_DESTROY.
    */
-  uint32_t reserved GNUNET_PACKED;
+  uint32_t window GNUNET_PACKED;
 #endif
 
   /**
@@ -565,7 +577,9 @@ struct GNUNET_CADET_ChannelAppDataMessage
 
 
 /**
- * Message to acknowledge end-to-end data.
+ * Message to acknowledge end-to-end data.  Followed by zero or more
+ * `struct GNUNET_CADET_ChannelSackRange` for messages received beyond
+ * those covered by @e futures.
  */
 struct GNUNET_CADET_ChannelDataAckMessage
 {
@@ -595,6 +609,24 @@ struct GNUNET_CADET_ChannelDataAckMessage
 };
 
 
+/**
+ * Range of consecutive messages that were received, more than 64
+ * messages past the @e mid of a `struct GNUNET_CADET_ChannelDataAckMessage`.
+ */
+struct GNUNET_CADET_ChannelSackRange
+{
+  /**
+   * First message ID of the range.
+   */
+  struct ChannelMessageIdentifier start;
+
+  /**
+   * Number of messages in the range, in NBO.
+   */
+  uint32_t length GNUNET_PACKED;
+};
+
+
 #endif
 
 GNUNET_NETWORK_STRUCT_END
@@ -171,7 +171,7 @@ struct GNUNET_CONTAINER_MultiPeerMap *peers;
  * Map from `struct GNUNET_CADET_ConnectionTunnelIdentifier`
  * hash codes to `struct CadetConnection` objects.
  */
-struct GNUNET_CONTAINER_MultiShortmap *connections;
+struct CadetCidMap *connections;
 
 /**
  * How many messages are needed to trigger an AXOLOTL ratchet advance.
@@ -193,6 +193,18 @@ struct GNUNET_TIME_Relative keepalive_period;
  */
 unsigned long long drop_percent;
 
+/**
+ * How many messages may be unacknowledged on a channel, and
+ * buffered out of order at the receiver?
+ */
+unsigned long long channel_window;
+
+/**
+ * How many connections would we like to have per tunnel?  Traffic
+ * is spread over all of them.
+ */
+unsigned long long desired_connections;
+
 
 /**
  * Send a message to a client.
@@ -396,6 +408,7 @@ shutdown_rest ()
                    NULL);
   /* All paths, tunnels, channels, connections and CORE must be down before this point. */
   GCP_destroy_all_peers ();
+  GCPP_shutdown ();
   if (NULL != peers)
   {
     GNUNET_CONTAINER_multipeermap_destroy (peers);
@@ -403,7 +416,7 @@ shutdown_rest ()
   }
   if (NULL != connections)
   {
-    GNUNET_CONTAINER_multishortmap_destroy (connections);
+    GCCM_destroy (connections);
     connections = NULL;
   }
   if (NULL != ats_ch)
@@ -1380,6 +1393,20 @@ run (void *cls,
                                "need delay value");
     keepalive_period = GNUNET_TIME_UNIT_MINUTES;
   }
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (c,
+                                               "CADET",
+                                               "CHANNEL_WINDOW",
+                                               &channel_window)) ||
+       (0 == channel_window) )
+    channel_window = 32;
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (c,
+                                               "CADET",
+                                               "DESIRED_CONNECTIONS",
+                                               &desired_connections)) ||
+       (0 == desired_connections) )
+    desired_connections = 3;
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_number (c,
                                              "CADET",
@@ -1417,8 +1444,7 @@ run (void *cls,
                                                          GNUNET_NO);
   peers = GNUNET_CONTAINER_multipeermap_create (16,
                                                 GNUNET_YES);
-  connections = GNUNET_CONTAINER_multishortmap_create (256,
-                                                       GNUNET_YES);
+  connections = GCCM_create (256);
   GCH_init (c);
   GCD_init (c);
   GCO_init (c);
@@ -31,6 +31,7 @@
 #include "gnunet_util_lib.h"
 #define NEW_CADET 1
 #include "cadet_protocol.h"
+#include "gnunet-service-cadet-new_cidmap.h"
 
 /**
  * A client to the CADET service.  Each client gets a unique handle.
@@ -62,6 +63,11 @@ struct CadetTunnelQueueEntry;
  */
 struct CadetPeerPath;
 
+/**
+ * Node in the trie of the prefixes of all known paths.
+ */
+struct CadetPathTrieNode;
+
 /**
  * Entry in a peer path.
  */
@@ -77,6 +83,24 @@ struct CadetPeerPathEntry
    */
   struct CadetPeerPathEntry *prev;
 
+  /**
+   * DLL of entries of paths with the same peers up to and
+   * including this entry.
+   */
+  struct CadetPeerPathEntry *next_prefix;
+
+  /**
+   * DLL of entries of paths with the same peers up to and
+   * including this entry.
+   */
+  struct CadetPeerPathEntry *prev_prefix;
+
+  /**
+   * Node of the prefix ending with this entry in the trie of
+   * all known paths.
+   */
+  struct CadetPathTrieNode *node;
+
   /**
    * The peer at this offset of the path.
    */
@@ -134,10 +158,23 @@ struct CadetTConnection
   struct GNUNET_TIME_Absolute created;
 
   /**
-   * Connection throughput, to keep fastest connection alive.
+   * Measured connection throughput in bytes/s, 0 if unknown.  Used
+   * to keep the fastest connection alive and to decide which
+   * connection to send on.
    */
   uint32_t throughput;
 
+  /**
+   * When did we hand the last message to the connection?  Zero if
+   * the connection is not busy with a message of ours.
+   */
+  struct GNUNET_TIME_Absolute busy_since;
+
+  /**
+   * Size of the message we last handed to the connection.
+   */
+  size_t busy_size;
+
   /**
    * Is the connection currently ready for transmission?
    */
@@ -201,7 +238,7 @@ extern struct GNUNET_CONTAINER_MultiHashMap *open_ports;
  * Map from `struct GNUNET_CADET_ConnectionTunnelIdentifier`
  * hash codes to `struct CadetConnection` objects.
  */
-extern struct GNUNET_CONTAINER_MultiShortmap *connections;
+extern struct CadetCidMap *connections;
 
 /**
  * Map from ports to channels where the ports were closed at the
@@ -240,6 +277,18 @@ extern int shutting_down;
  */
 extern unsigned long long drop_percent;
 
+/**
+ * How many messages may be unacknowledged on a channel, and
+ * buffered out of order at the receiver?
+ */
+extern unsigned long long channel_window;
+
+/**
+ * How many connections would we like to have per tunnel?  Traffic
+ * is spread over all of them.
+ */
+extern unsigned long long desired_connections;
+
 
 /**
  * Send a message to a client.
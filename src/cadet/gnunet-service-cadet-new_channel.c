@@ -30,8 +30,6 @@
  *   + figure out flow control without ACKs (unreliable traffic!)
  * - revisit handling of 'unbuffered' traffic!
  *   (need to push down through tunnel into connection selection)
- * - revisit handling of 'buffered' traffic: 4 is a rather small buffer; maybe
- *   reserve more bits in 'options' to allow for buffer size control?
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
@@ -68,12 +66,17 @@
  * important both to detect values that are actually in the past, as well
  * as to limit adversarially triggerable memory consumption.
  *
- * Note that right now we have "max_pending_messages = 4" hard-coded in
- * the logic below, so a value of 4 would suffice here. But we plan to
- * allow larger windows in the future...
+ * The window of a channel (#channel_window, or the window announced
+ * by the other peer) is capped to this value.
  */
 #define MAX_OUT_OF_ORDER_DISTANCE 1024
 
+/**
+ * After how many duplicate DATA_ACKs (same base, but later messages
+ * acknowledged) do we retransmit the missing message right away?
+ */
+#define FAST_RETRANSMIT_DUP_ACKS 3
+
 
 /**
  * All the states a channel can be in.
@@ -168,6 +171,12 @@ struct CadetReliableMessage
    */
   int num_transmissions;
 
+  /**
+   * #GNUNET_YES if the last transmission counts against the
+   * congestion window of the tunnel.
+   */
+  int in_flight;
+
 };
 
 
@@ -200,6 +209,25 @@ struct CadetOutOfOrderMessage
 };
 
 
+/**
+ * Slot of the reorder buffer of a reliable channel.
+ */
+struct CadetReorderSlot
+{
+  /**
+   * The envelope with the payload, NULL if the message was not yet
+   * received or was already given to the client out of order.
+   */
+  struct GNUNET_MQ_Envelope *env;
+
+  /**
+   * Has the message for this slot been received?
+   */
+  int received;
+
+};
+
+
 /**
  * Client endpoint of a `struct CadetChannel`.  A channel may be a
  * loopback channel, in which case it has two of these endpoints.
@@ -311,15 +339,37 @@ struct CadetChannel
   struct GNUNET_TIME_Relative retry_time;
 
   /**
-   * Bitfield of already-received messages past @e mid_recv.
+   * Reorder buffer of a reliable channel with messages received
+   * past @e mid_recv, indexed by MID modulo @e recv_ring_size.
+   */
+  struct CadetReorderSlot *recv_ring;
+
+  /**
+   * Number of slots in @e recv_ring, a power of two larger than
+   * @e recv_window.
+   */
+  unsigned int recv_ring_size;
+
+  /**
+   * Number of messages waiting in @e recv_ring for the client.
    */
-  uint64_t mid_futures;
+  unsigned int recv_ring_used;
 
   /**
    * Next MID expected for incoming traffic.
    */
   struct ChannelMessageIdentifier mid_recv;
 
+  /**
+   * Base of the last DATA_ACK we got for outgoing traffic.
+   */
+  struct ChannelMessageIdentifier ack_base;
+
+  /**
+   * Number of DATA_ACKs in a row that had @e ack_base as the base.
+   */
+  unsigned int dup_acks;
+
   /**
    * Next MID to use for outgoing traffic.
    */
@@ -332,10 +382,18 @@ struct CadetChannel
 
   /**
    * Maximum (reliable) messages pending ACK for this channel
-   * before we throttle the client.
+   * before we throttle the client.  At most the receive window
+   * announced by the other peer.
    */
   unsigned int max_pending_messages;
 
+  /**
+   * How many messages past @e mid_recv we accept (and buffer for
+   * the client).  Announced to the other peer in our CHANNEL_OPEN
+   * or CHANNEL_OPEN_ACK.
+   */
+  unsigned int recv_window;
+
   /**
    * Number identifying this channel in its tunnel.
    */
@@ -466,9 +524,20 @@ channel_destroy (struct CadetChannel *ch)
     GNUNET_CONTAINER_DLL_remove (ch->head_sent,
                                  ch->tail_sent,
                                  crm);
+    if (GNUNET_YES == crm->in_flight)
+      GCT_congestion_lost (ch->t,
+                           GNUNET_NO);
     GNUNET_free (crm->data_message);
     GNUNET_free (crm);
   }
+  if (NULL != ch->recv_ring)
+  {
+    for (unsigned int i=0;i<ch->recv_ring_size;i++)
+      if (NULL != ch->recv_ring[i].env)
+        GNUNET_MQ_discard (ch->recv_ring[i].env);
+    GNUNET_free (ch->recv_ring);
+    ch->recv_ring = NULL;
+  }
   if (NULL != ch->owner)
   {
     free_channel_client (ch->owner);
@@ -505,6 +574,105 @@ channel_destroy (struct CadetChannel *ch)
 }
 
 
+/**
+ * Set the windows of a new channel from our configuration, and
+ * allocate the reorder buffer if the channel is reliable and goes
+ * through a tunnel.
+ *
+ * @param ch the channel
+ */
+static void
+init_window (struct CadetChannel *ch)
+{
+  if (ch->nobuffer)
+    ch->recv_window = 1;
+  else
+    ch->recv_window = (unsigned int) GNUNET_MIN (channel_window,
+                                                 MAX_OUT_OF_ORDER_DISTANCE);
+  ch->max_pending_messages = ch->recv_window;
+  if ( (GNUNET_NO == ch->reliable) ||
+       (GNUNET_YES == ch->is_loopback) )
+    return;
+  ch->recv_ring_size = 2;
+  while (ch->recv_ring_size <= ch->recv_window)
+    ch->recv_ring_size *= 2;
+  ch->recv_ring = GNUNET_new_array (ch->recv_ring_size,
+                                    struct CadetReorderSlot);
+}
+
+
+/**
+ * Limit the messages we have in flight to the receive window
+ * announced by the other peer.  Must be called before the client
+ * gets its first ACKs.
+ *
+ * @param ch the channel
+ * @param window window announced by the other peer, 0 if none
+ */
+static void
+clamp_window (struct CadetChannel *ch,
+              uint32_t window)
+{
+  if (0 == window)
+    return; /* not announced, use ours */
+  if (window < ch->max_pending_messages)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Other peer of %s only accepts %u messages in flight\n",
+         GCCH_2s (ch),
+         (unsigned int) window);
+    ch->max_pending_messages = window;
+  }
+}
+
+
+/**
+ * Get the slot of the reorder buffer for @a mid.
+ *
+ * @param ch reliable channel
+ * @param mid message ID in host byte order
+ * @return the slot
+ */
+static struct CadetReorderSlot *
+get_slot (struct CadetChannel *ch,
+          uint32_t mid)
+{
+  return &ch->recv_ring[mid & (ch->recv_ring_size - 1)];
+}
+
+
+/**
+ * The message at @e mid_recv of @a ch was given to the client.
+ * Advance @e mid_recv past it and past all messages that were
+ * already given to the client out of order.
+ *
+ * @param ch reliable channel
+ */
+static void
+advance_mid_recv (struct CadetChannel *ch)
+{
+  struct CadetReorderSlot *slot;
+  uint32_t mid = ntohl (ch->mid_recv.mid);
+
+  slot = get_slot (ch,
+                   mid);
+  GNUNET_assert (NULL == slot->env);
+  slot->received = GNUNET_NO;
+  mid++;
+  while (1)
+  {
+    slot = get_slot (ch,
+                     mid);
+    if ( (GNUNET_NO == slot->received) ||
+         (NULL != slot->env) )
+      break;
+    slot->received = GNUNET_NO;
+    mid++;
+  }
+  ch->mid_recv.mid = htonl (mid);
+}
+
+
 /**
  * Send a channel create message.
  *
@@ -571,6 +739,7 @@ send_channel_open (void *cls)
   msgcc.opt = htonl (options);
   msgcc.port = ch->port;
   msgcc.ctn = ch->ctn;
+  msgcc.window = htonl (ch->recv_window);
   ch->state = CADET_CHANNEL_OPEN_SENT;
   if (NULL != ch->last_control_qe)
     GCT_send_cancel (ch->last_control_qe);
@@ -635,7 +804,6 @@ GCCH_channel_local_new (struct CadetClient *owner,
   ch->nobuffer = (0 != (options & GNUNET_CADET_OPTION_NOBUFFER));
   ch->reliable = (0 != (options & GNUNET_CADET_OPTION_RELIABLE));
   ch->out_of_order = (0 != (options & GNUNET_CADET_OPTION_OUT_OF_ORDER));
-  ch->max_pending_messages = (ch->nobuffer) ? 1 : 4; /* FIXME: 4!? Do not hardcode! */
   ch->owner = ccco;
   ch->port = *port;
   if (0 == memcmp (&my_full_id,
@@ -645,6 +813,7 @@ GCCH_channel_local_new (struct CadetClient *owner,
     struct CadetClient *c;
 
     ch->is_loopback = GNUNET_YES;
+    init_window (ch);
     c = GNUNET_CONTAINER_multihashmap_get (open_ports,
                                            port);
     if (NULL == c)
@@ -670,6 +839,7 @@ GCCH_channel_local_new (struct CadetClient *owner,
     ch->t = GCP_get_tunnel (destination,
                             GNUNET_YES);
     ch->retry_time = CADET_INITIAL_RETRANSMIT_TIME;
+    init_window (ch);
     ch->ctn = GCT_add_channel (ch->t,
                                ch);
   }
@@ -714,13 +884,15 @@ timeout_closed_cb (void *cls)
  * @param ctn identifier of this channel in the tunnel
  * @param port desired local port
  * @param options options for the channel
+ * @param window receive window announced by the initiator, 0 if none
  * @return handle to the new channel
  */
 struct CadetChannel *
 GCCH_channel_incoming_new (struct CadetTunnel *t,
                            struct GNUNET_CADET_ChannelTunnelNumber ctn,
                            const struct GNUNET_HashCode *port,
-                           uint32_t options)
+                           uint32_t options,
+                           uint32_t window)
 {
   struct CadetChannel *ch;
   struct CadetClient *c;
@@ -733,7 +905,9 @@ GCCH_channel_incoming_new (struct CadetTunnel *t,
   ch->nobuffer = (0 != (options & GNUNET_CADET_OPTION_NOBUFFER));
   ch->reliable = (0 != (options & GNUNET_CADET_OPTION_RELIABLE));
   ch->out_of_order = (0 != (options & GNUNET_CADET_OPTION_OUT_OF_ORDER));
-  ch->max_pending_messages = (ch->nobuffer) ? 1 : 4; /* FIXME: 4!? Do not hardcode! */
+  init_window (ch);
+  clamp_window (ch,
+                window);
   GNUNET_STATISTICS_update (stats,
                             "# channels",
                             1,
@@ -800,24 +974,61 @@ send_ack_cb (void *cls,
 static void
 send_channel_data_ack (struct CadetChannel *ch)
 {
-  struct GNUNET_CADET_ChannelDataAckMessage msg;
+  char buf[sizeof (struct GNUNET_CADET_ChannelDataAckMessage)
+           + GCCH_MAX_SACK_RANGES * sizeof (struct GNUNET_CADET_ChannelSackRange)] GNUNET_ALIGN;
+  struct GNUNET_CADET_ChannelDataAckMessage *msg
+    = (struct GNUNET_CADET_ChannelDataAckMessage *) buf;
+  struct GNUNET_CADET_ChannelSackRange *ranges
+    = (struct GNUNET_CADET_ChannelSackRange *) &msg[1];
+  unsigned int num_ranges;
+  uint32_t base;
+  uint64_t futures;
 
   if (GNUNET_NO == ch->reliable)
     return; /* no ACKs */
-  msg.header.type = htons (GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA_ACK);
-  msg.header.size = htons (sizeof (msg));
-  msg.ctn = ch->ctn;
-  msg.mid.mid = htonl (ntohl (ch->mid_recv.mid));
-  msg.futures = GNUNET_htonll (ch->mid_futures);
+  base = ntohl (ch->mid_recv.mid);
+  futures = 0;
+  num_ranges = 0;
+  for (unsigned int off=1;off<=ch->recv_window;off++)
+  {
+    if (GNUNET_NO == get_slot (ch,
+                               base + off)->received)
+      continue;
+    if (off <= 64)
+    {
+      futures |= (1LLU << (off - 1));
+      continue;
+    }
+    /* beyond the bitfield, extend the last range or start a new one */
+    if ( (0 < num_ranges) &&
+         (ntohl (ranges[num_ranges - 1].start.mid)
+          + ntohl (ranges[num_ranges - 1].length) == base + off) )
+    {
+      ranges[num_ranges - 1].length
+        = htonl (ntohl (ranges[num_ranges - 1].length) + 1);
+      continue;
+    }
+    if (GCCH_MAX_SACK_RANGES == num_ranges)
+      break;
+    ranges[num_ranges].start.mid = htonl (base + off);
+    ranges[num_ranges].length = htonl (1);
+    num_ranges++;
+  }
+  msg->header.type = htons (GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA_ACK);
+  msg->header.size = htons (sizeof (*msg) + num_ranges * sizeof (*ranges));
+  msg->ctn = ch->ctn;
+  msg->mid = ch->mid_recv;
+  msg->futures = GNUNET_htonll (futures);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
-       "Sending DATA_ACK %u:%llX via %s\n",
-       (unsigned int) ntohl (msg.mid.mid),
-       (unsigned long long) ch->mid_futures,
+       "Sending DATA_ACK %u:%llX+%u via %s\n",
+       (unsigned int) base,
+       (unsigned long long) futures,
+       num_ranges,
        GCCH_2s (ch));
   if (NULL != ch->last_control_qe)
     GCT_send_cancel (ch->last_control_qe);
   ch->last_control_qe = GCT_send (ch->t,
-                                  &msg.header,
+                                  &msg->header,
                                   &send_ack_cb,
                                   ch);
 }
@@ -841,7 +1052,7 @@ send_open_ack (void *cls)
        GCCH_2s (ch));
   msg.header.type = htons (GNUNET_MESSAGE_TYPE_CADET_CHANNEL_OPEN_ACK);
   msg.header.size = htons (sizeof (msg));
-  msg.reserved = htonl (0);
+  msg.window = htonl (ch->recv_window);
   msg.ctn = ch->ctn;
   if (NULL != ch->last_control_qe)
     GCT_send_cancel (ch->last_control_qe);
@@ -979,7 +1190,8 @@ GCCH_bind (struct CadetChannel *ch,
   {
     ch->state = CADET_CHANNEL_OPEN_SENT;
     GCCH_handle_channel_open_ack (ch,
-                                  NULL);
+                                  NULL,
+                                  0);
   }
   else
   {
@@ -1114,10 +1326,12 @@ GCCH_channel_local_destroy (struct CadetChannel *ch,
  *
  * @param ch channel to destroy
  * @param cti identifier of the connection that delivered the message
+ * @param window receive window announced by the destination, 0 if none
  */
 void
 GCCH_handle_channel_open_ack (struct CadetChannel *ch,
-                              const struct GNUNET_CADET_ConnectionTunnelIdentifier *cti)
+                              const struct GNUNET_CADET_ConnectionTunnelIdentifier *cti,
+                              uint32_t window)
 {
   switch (ch->state)
   {
@@ -1145,6 +1359,8 @@ GCCH_handle_channel_open_ack (struct CadetChannel *ch,
       ch->retry_control_task = NULL;
     }
     ch->state = CADET_CHANNEL_READY;
+    clamp_window (ch,
+                  window);
     /* On first connect, send client as many ACKs as we allow messages
        to be buffered! */
     for (unsigned int i=0;i<ch->max_pending_messages;i++)
@@ -1199,6 +1415,97 @@ is_before (void *cls,
 }
 
 
+/**
+ * We got payload data for a reliable channel.  Pass it on to the
+ * client if it is the next one (or the channel is out-of-order),
+ * otherwise keep it in the reorder buffer.  Either way, send an ACK.
+ *
+ * @param ch reliable channel that got data
+ * @param ccc client to give the data to
+ * @param msg message that was received
+ * @param env envelope with the payload of @a msg for the client
+ */
+static void
+handle_reliable_data (struct CadetChannel *ch,
+                      struct CadetChannelClient *ccc,
+                      const struct GNUNET_CADET_ChannelAppDataMessage *msg,
+                      struct GNUNET_MQ_Envelope *env)
+{
+  struct CadetReorderSlot *slot;
+  uint32_t mid_min;
+  uint32_t mid_msg;
+
+  /* check if message ought to be dropped because it is ancient/too distant/duplicate */
+  mid_min = ntohl (ch->mid_recv.mid);
+  mid_msg = ntohl (msg->mid.mid);
+  if ( (uint32_t) (mid_msg - mid_min) > ch->recv_window)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "%s at %u drops ancient or far-future message %u\n",
+         GCCH_2s (ch),
+         (unsigned int) mid_min,
+         (unsigned int) mid_msg);
+    GNUNET_STATISTICS_update (stats,
+                              "# duplicate DATA (ancient or future)",
+                              1,
+                              GNUNET_NO);
+    GNUNET_MQ_discard (env);
+    send_channel_data_ack (ch);
+    return;
+  }
+  slot = get_slot (ch,
+                   mid_msg);
+  if (GNUNET_YES == slot->received)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Duplicate payload on %s (mid %u) dropped\n",
+         GCCH_2s (ch),
+         (unsigned int) mid_msg);
+    GNUNET_STATISTICS_update (stats,
+                              "# duplicate DATA",
+                              1,
+                              GNUNET_NO);
+    GNUNET_MQ_discard (env);
+    send_channel_data_ack (ch);
+    return;
+  }
+  slot->received = GNUNET_YES;
+  if ( (GNUNET_YES == ccc->client_ready) &&
+       ( (mid_msg == mid_min) ||
+         (GNUNET_YES == ch->out_of_order) ) )
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Giving payload with MID %u from %s to client %s\n",
+         (unsigned int) mid_msg,
+         GCCH_2s (ch),
+         GSC_2s (ccc->c));
+    ccc->client_ready = GNUNET_NO;
+    GSC_send_to_client (ccc->c,
+                        env);
+    if (mid_msg == mid_min)
+      advance_mid_recv (ch);
+    send_channel_data_ack (ch);
+    return;
+  }
+  slot->env = env;
+  ch->recv_ring_used++;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Queued %s payload on %s-%X(%p) (mid %u, need %u first)\n",
+       (GNUNET_YES == ccc->client_ready)
+       ? "out-of-order"
+       : "client-not-ready",
+       GCCH_2s (ch),
+       ntohl (ccc->ccn.channel_of_client),
+       ccc,
+       (unsigned int) mid_msg,
+       (unsigned int) mid_min);
+  /* NOTE: this ACK we _could_ skip, as the packet is out-of-order and
+     the sender may already be transmitting the previous one.  However,
+     duplicate ACKs are what triggers fast retransmission at the sender. */
+  send_channel_data_ack (ch);
+}
+
+
 /**
  * We got payload data for a channel.  Pass it on to the client
  * and send an ACK to the other end (once flow control allows it!)
@@ -1218,10 +1525,6 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
   size_t payload_size;
   struct CadetOutOfOrderMessage *com;
   int duplicate;
-  uint32_t mid_min;
-  uint32_t mid_max;
-  uint32_t mid_msg;
-  uint32_t delta;
 
   GNUNET_assert (GNUNET_NO == ch->is_loopback);
   if ( (GNUNET_YES == ch->destroy) &&
@@ -1248,6 +1551,14 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
                  &msg[1],
                  payload_size);
   ccc = (NULL != ch->owner) ? ch->owner : ch->dest;
+  if (GNUNET_YES == ch->reliable)
+  {
+    handle_reliable_data (ch,
+                          ccc,
+                          msg,
+                          env);
+    return;
+  }
   if ( (GNUNET_YES == ccc->client_ready) &&
        ( (GNUNET_YES == ch->out_of_order) ||
          (msg->mid.mid == ch->mid_recv.mid) ) )
@@ -1262,88 +1573,31 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
     GSC_send_to_client (ccc->c,
                         env);
     ch->mid_recv.mid = htonl (1 + ntohl (ch->mid_recv.mid));
-    ch->mid_futures >>= 1;
-    send_channel_data_ack (ch);
     return;
   }
 
-  if (GNUNET_YES == ch->reliable)
+  /* Channel is unreliable, so we do not ACK. But we also cannot
+     allow buffering everything, so check if we have space... */
+  if (ccc->num_recv >= ch->recv_window)
   {
-    /* check if message ought to be dropped because it is ancient/too distant/duplicate */
-    mid_min = ntohl (ch->mid_recv.mid);
-    mid_max = mid_min + ch->max_pending_messages;
-    mid_msg = ntohl (msg->mid.mid);
-    if ( ( (uint32_t) (mid_msg - mid_min) > ch->max_pending_messages) ||
-         ( (uint32_t) (mid_max - mid_msg) > ch->max_pending_messages) )
-    {
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "%s at %u drops ancient or far-future message %u\n",
-           GCCH_2s (ch),
-           (unsigned int) mid_min,
-           ntohl (msg->mid.mid));
-
-      GNUNET_STATISTICS_update (stats,
-                                "# duplicate DATA (ancient or future)",
-                                1,
-                                GNUNET_NO);
-      GNUNET_MQ_discard (env);
-      send_channel_data_ack (ch);
-      return;
-    }
-    /* mark bit for future ACKs */
-    delta = mid_msg - mid_min - 1; /* overflow/underflow are OK here */
-    if (delta < 64)
-    {
-      if (0 != (ch->mid_futures & (1LLU << delta)))
-      {
-        /* Duplicate within the queue, drop also */
-        LOG (GNUNET_ERROR_TYPE_DEBUG,
-             "Duplicate payload of %u bytes on %s (mid %u) dropped\n",
-             (unsigned int) payload_size,
-             GCCH_2s (ch),
-             ntohl (msg->mid.mid));
-        GNUNET_STATISTICS_update (stats,
-                                  "# duplicate DATA",
-                                  1,
-                                  GNUNET_NO);
-        GNUNET_MQ_discard (env);
-        send_channel_data_ack (ch);
-        return;
-      }
-      ch->mid_futures |= (1LLU << delta);
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "Marked bit %llX for mid %u (base: %u); now: %llX\n",
-           (1LLU << delta),
-           mid_msg,
-           mid_min,
-           ch->mid_futures);
-    }
-  }
-  else /* ! ch->reliable */
-  {
-    /* Channel is unreliable, so we do not ACK. But we also cannot
-       allow buffering everything, so check if we have space... */
-    if (ccc->num_recv >= ch->max_pending_messages)
-    {
-      struct CadetOutOfOrderMessage *drop;
+    struct CadetOutOfOrderMessage *drop;
 
-      /* Yep, need to drop. Drop the oldest message in
-         the buffer. */
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "Queue full due slow client on %s, dropping oldest message\n",
-           GCCH_2s (ch));
-      GNUNET_STATISTICS_update (stats,
-                                "# messages dropped due to slow client",
-                                1,
-                                GNUNET_NO);
-      drop = ccc->head_recv;
-      GNUNET_CONTAINER_DLL_remove (ccc->head_recv,
-                                   ccc->tail_recv,
-                                   drop);
-      ccc->num_recv--;
-      GNUNET_MQ_discard (drop->env);
-      GNUNET_free (drop);
-    }
+    /* Yep, need to drop. Drop the oldest message in
+       the buffer. */
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Queue full due slow client on %s, dropping oldest message\n",
+         GCCH_2s (ch));
+    GNUNET_STATISTICS_update (stats,
+                              "# messages dropped due to slow client",
+                              1,
+                              GNUNET_NO);
+    drop = ccc->head_recv;
+    GNUNET_CONTAINER_DLL_remove (ccc->head_recv,
+                                 ccc->tail_recv,
+                                 drop);
+    ccc->num_recv--;
+    GNUNET_MQ_discard (drop->env);
+    GNUNET_free (drop);
   }
 
   /* Insert message into sorted out-of-order queue */
@@ -1360,11 +1614,6 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
   ccc->num_recv++;
   if (GNUNET_YES == duplicate)
   {
-    /* Duplicate within the queue, drop also (this is not covered by
-       the case above if "delta" >= 64, which could be the case if
-       max_pending_messages is also >= 64 or if our client is unready
-       and we are seeing retransmissions of the message our client is
-       blocked on. */
     LOG (GNUNET_ERROR_TYPE_DEBUG,
          "Duplicate payload of %u bytes on %s (mid %u) dropped\n",
          (unsigned int) payload_size,
@@ -1380,7 +1629,6 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
     ccc->num_recv--;
     GNUNET_MQ_discard (com->env);
     GNUNET_free (com);
-    send_channel_data_ack (ch);
     return;
   }
   LOG (GNUNET_ERROR_TYPE_DEBUG,
@@ -1394,11 +1642,6 @@ GCCH_handle_channel_plaintext_data (struct CadetChannel *ch,
        ccc,
        ntohl (msg->mid.mid),
        ntohl (ch->mid_recv.mid));
-  /* NOTE: this ACK we _could_ skip, as the packet is out-of-order and
-     the sender may already be transmitting the previous one.  Needs
-     experimental evaluation to see if/when this ACK helps or
-     hurts. (We might even want another option.) */
-  send_channel_data_ack (ch);
 }
 
 
@@ -1435,6 +1678,12 @@ retry_transmission (void *cls)
        "Retrying transmission on %s of message %u\n",
        GCCH_2s (ch),
        (unsigned int) ntohl (crm->data_message->mid.mid));
+  if (GNUNET_YES == crm->in_flight)
+  {
+    crm->in_flight = GNUNET_NO;
+    GCT_congestion_lost (ch->t,
+                         GNUNET_YES);
+  }
   crm->qe = GCT_send (ch->t,
                       &crm->data_message->header,
                       &data_sent_cb,
@@ -1471,6 +1720,11 @@ handle_matching_ack (struct CadetChannel *ch,
     GCT_send_cancel (crm->qe);
     crm->qe = NULL;
   }
+  if (GNUNET_YES == crm->in_flight)
+    GCT_congestion_acked (ch->t,
+                          (1 == crm->num_transmissions)
+                          ? GNUNET_TIME_absolute_get_duration (crm->first_transmission_time)
+                          : GNUNET_TIME_UNIT_FOREVER_REL);
   if ( (1 == crm->num_transmissions) &&
        (NULL != cti) )
   {
@@ -1505,8 +1759,12 @@ GCCH_handle_channel_plaintext_data_ack (struct CadetChannel *ch,
                                         const struct GNUNET_CADET_ConnectionTunnelIdentifier *cti,
                                         const struct GNUNET_CADET_ChannelDataAckMessage *ack)
 {
+  const struct GNUNET_CADET_ChannelSackRange *ranges
+    = (const struct GNUNET_CADET_ChannelSackRange *) &ack[1];
+  unsigned int num_ranges;
   struct CadetReliableMessage *crm;
   struct CadetReliableMessage *crmn;
+  struct CadetReliableMessage *missing;
   int found;
   uint32_t mid_base;
   uint64_t mid_mask;
@@ -1519,25 +1777,31 @@ GCCH_handle_channel_plaintext_data_ack (struct CadetChannel *ch,
     GNUNET_break_op (0);
     return;
   }
+  num_ranges = (ntohs (ack->header.size) - sizeof (*ack))
+    / sizeof (struct GNUNET_CADET_ChannelSackRange);
   /* mid_base is the MID of the next message that the
      other peer expects (i.e. that is missing!), everything
      LOWER (but excluding mid_base itself) was received. */
   mid_base = ntohl (ack->mid.mid);
-  mid_mask = GNUNET_htonll (ack->futures);
+  mid_mask = GNUNET_ntohll (ack->futures);
   found = GNUNET_NO;
+  missing = NULL;
   for (crm = ch->head_sent;
         NULL != crm;
        crm = crmn)
   {
+    uint32_t mid = ntohl (crm->data_message->mid.mid);
+    int acked;
+
     crmn = crm->next;
-    delta = (unsigned int) (ntohl (crm->data_message->mid.mid) - mid_base);
+    delta = (unsigned int) (mid - mid_base);
     if (delta >= UINT_MAX - ch->max_pending_messages)
     {
       /* overflow, means crm was a bit in the past, so this ACK counts for it. */
       LOG (GNUNET_ERROR_TYPE_DEBUG,
            "Got DATA_ACK with base %u satisfying past message %u on %s\n",
            (unsigned int) mid_base,
-           ntohl (crm->data_message->mid.mid),
+           (unsigned int) mid,
            GCCH_2s (ch));
       handle_matching_ack (ch,
                            cti,
@@ -1545,19 +1809,32 @@ GCCH_handle_channel_plaintext_data_ack (struct CadetChannel *ch,
       found = GNUNET_YES;
       continue;
     }
-    delta--;
-    if (delta >= 64)
+    if (0 == delta)
+    {
+      missing = crm;
       continue;
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "Testing bit %llX for mid %u (base: %u)\n",
-         (1LLU << delta),
-         ntohl (crm->data_message->mid.mid),
-         mid_base);
-    if (0 != (mid_mask & (1LLU << delta)))
+    }
+    delta--;
+    acked = GNUNET_NO;
+    if (delta < 64)
+    {
+      acked = (0 != (mid_mask & (1LLU << delta)));
+    }
+    else
+    {
+      for (unsigned int i=0;i<num_ranges;i++)
+        if ( (uint32_t) (mid - ntohl (ranges[i].start.mid)) <
+             ntohl (ranges[i].length) )
+        {
+          acked = GNUNET_YES;
+          break;
+        }
+    }
+    if (GNUNET_YES == acked)
     {
       LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "Got DATA_ACK with mask for %u on %s\n",
-           ntohl (crm->data_message->mid.mid),
+           "Got DATA_ACK with selective ACK for %u on %s\n",
+           (unsigned int) mid,
            GCCH_2s (ch));
       handle_matching_ack (ch,
                            cti,
@@ -1565,6 +1842,42 @@ GCCH_handle_channel_plaintext_data_ack (struct CadetChannel *ch,
       found = GNUNET_YES;
     }
   }
+  if (ack->mid.mid != ch->ack_base.mid)
+  {
+    ch->ack_base = ack->mid;
+    ch->dup_acks = 0;
+  }
+  else if ( (NULL != missing) &&
+            (FAST_RETRANSMIT_DUP_ACKS == ++ch->dup_acks) &&
+            (NULL == missing->qe) )
+  {
+    /* The receiver keeps getting later messages, but not the one
+       at the base; do not wait for the timer. */
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Fast retransmission of message %u on %s\n",
+         (unsigned int) mid_base,
+         GCCH_2s (ch));
+    GNUNET_STATISTICS_update (stats,
+                              "# fast retransmissions",
+                              1,
+                              GNUNET_NO);
+    if (NULL != ch->retry_data_task)
+    {
+      GNUNET_SCHEDULER_cancel (ch->retry_data_task);
+      ch->retry_data_task = NULL;
+    }
+    if (GNUNET_YES == missing->in_flight)
+    {
+      missing->in_flight = GNUNET_NO;
+      GCT_congestion_lost (ch->t,
+                           GNUNET_YES);
+    }
+    missing->qe = GCT_send (ch->t,
+                            &missing->data_message->header,
+                            &data_sent_cb,
+                            missing);
+    found = GNUNET_YES;
+  }
   if (GNUNET_NO == found)
   {
     /* ACK for message we already dropped, might have been a
@@ -1618,7 +1931,8 @@ GCCH_handle_remote_destroy (struct CadetChannel *ch,
     return;
   }
   ccc = (NULL != ch->owner) ? ch->owner : ch->dest;
-  if (NULL != ccc->head_recv)
+  if ( (NULL != ccc->head_recv) ||
+       (0 != ch->recv_ring_used) )
   {
     LOG (GNUNET_ERROR_TYPE_WARNING,
          "Lost end of transmission due to remote shutdown on %s\n",
@@ -1703,6 +2017,11 @@ data_sent_cb (void *cls,
       crm->connection_taken = *cid;
       GCC_ack_expected (cid);
     }
+    if (GNUNET_NO == crm->in_flight)
+    {
+      crm->in_flight = GNUNET_YES;
+      GCT_congestion_sent (ch->t);
+    }
   }
   if ( (0 == crm->retry_delay.rel_value_us) &&
        (NULL != cid) )
@@ -1867,6 +2186,74 @@ GCCH_handle_local_data (struct CadetChannel *ch,
 }
 
 
+/**
+ * The client of a reliable channel is ready for more data.  Give it
+ * the next message from the reorder buffer, if we have it (or any
+ * message if the channel is out-of-order).
+ *
+ * @param ch reliable channel
+ * @param ccc client that is ready
+ */
+static void
+deliver_reliable (struct CadetChannel *ch,
+                  struct CadetChannelClient *ccc)
+{
+  struct CadetReorderSlot *slot;
+  struct GNUNET_MQ_Envelope *env;
+  uint32_t mid = ntohl (ch->mid_recv.mid);
+
+  slot = get_slot (ch,
+                   mid);
+  if ( (NULL == slot->env) &&
+       (GNUNET_YES == ch->out_of_order) &&
+       (0 != ch->recv_ring_used) )
+  {
+    for (unsigned int off=1;off<=ch->recv_window;off++)
+    {
+      slot = get_slot (ch,
+                       mid + off);
+      if (NULL != slot->env)
+      {
+        mid += off;
+        break;
+      }
+    }
+  }
+  if (NULL == slot->env)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Got LOCAL_ACK, %s-%X ready to receive more data, but message %u is missing on %s\n",
+         GSC_2s (ccc->c),
+         ntohl (ccc->ccn.channel_of_client),
+         (unsigned int) mid,
+         GCCH_2s (ch));
+    return;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Got LOCAL_ACK, giving payload message %u to %s-%X on %s\n",
+       (unsigned int) mid,
+       GSC_2s (ccc->c),
+       ntohl (ccc->ccn.channel_of_client),
+       GCCH_2s (ch));
+  env = slot->env;
+  slot->env = NULL;
+  ch->recv_ring_used--;
+  if (mid == ntohl (ch->mid_recv.mid))
+    advance_mid_recv (ch);
+  ccc->client_ready = GNUNET_NO;
+  GSC_send_to_client (ccc->c,
+                      env);
+  send_channel_data_ack (ch);
+  if (0 != ch->recv_ring_used)
+    return;
+  if (GNUNET_NO == ch->destroy)
+    return;
+  GCT_send_channel_destroy (ch->t,
+                            ch->ctn);
+  channel_destroy (ch);
+}
+
+
 /**
  * Handle ACK from client on local channel.  Means the client is ready
  * for more data, see if we have any for it.
@@ -1890,6 +2277,13 @@ GCCH_handle_local_ack (struct CadetChannel *ch,
   else
     GNUNET_assert (0);
   ccc->client_ready = GNUNET_YES;
+  if ( (GNUNET_YES == ch->reliable) &&
+       (GNUNET_NO == ch->is_loopback) )
+  {
+    deliver_reliable (ch,
+                      ccc);
+    return;
+  }
   com = ccc->head_recv;
   if (NULL == com)
   {
@@ -1931,19 +2325,6 @@ GCCH_handle_local_ack (struct CadetChannel *ch,
     return;
   }
 
-  if ( (com->mid.mid != ch->mid_recv.mid) &&
-       (GNUNET_NO == ch->out_of_order) &&
-       (GNUNET_YES == ch->reliable) )
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "Got LOCAL_ACK, %s-%X ready to receive more data (but next one is out-of-order %u vs. %u)!\n",
-         GSC_2s (ccc->c),
-         ntohl (ccc->ccn.channel_of_client),
-         ntohl (com->mid.mid),
-         ntohl (ch->mid_recv.mid));
-    return; /* missing next one in-order */
-  }
-
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Got LOCAL_ACK, giving payload message %u to %s-%X on %s\n",
        ntohl (com->mid.mid),
@@ -1960,12 +2341,10 @@ GCCH_handle_local_ack (struct CadetChannel *ch,
      enough, as it would be OK to have lost some! */
 
   ch->mid_recv.mid = htonl (1 + ntohl (com->mid.mid));
-  ch->mid_futures >>= 1; /* equivalent to division by 2 */
   ccc->client_ready = GNUNET_NO;
   GSC_send_to_client (ccc->c,
                       com->env);
   GNUNET_free (com);
-  send_channel_data_ack (ch);
   if (NULL != ccc->head_recv)
     return;
   if (GNUNET_NO == ch->destroy)
@@ -2024,9 +2403,9 @@ GCCH_debug (struct CadetChannel *ch,
           ntohl (ch->dest->ccn.channel_of_client));
   }
   LOG2 (level,
-        "CHN  Message IDs recv: %d (%LLX), send: %d\n",
+        "CHN  Message IDs recv: %d (%u buffered), send: %d\n",
         ntohl (ch->mid_recv.mid),
-        (unsigned long long) ch->mid_futures,
+        ch->recv_ring_used,
         ntohl (ch->mid_send.mid));
 }
 
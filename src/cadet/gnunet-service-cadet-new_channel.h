@@ -33,6 +33,13 @@
 #include "cadet_protocol.h"
 
 
+/**
+ * Maximum number of `struct GNUNET_CADET_ChannelSackRange` we put
+ * into (and accept in) a #GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA_ACK.
+ */
+#define GCCH_MAX_SACK_RANGES 16
+
+
 /**
  * A channel is a bidirectional connection between two CADET
  * clients.  Communiation can be reliable, unreliable, in-order
@@ -144,13 +151,15 @@ GCCH_tunnel_up (struct CadetChannel *ch);
  * @param origin peer to who initiated the channel
  * @param port desired local port
  * @param options options for the channel
+ * @param window receive window announced by the initiator, 0 if none
  * @return handle to the new channel
  */
 struct CadetChannel *
 GCCH_channel_incoming_new (struct CadetTunnel *t,
                            struct GNUNET_CADET_ChannelTunnelNumber chid,
                            const struct GNUNET_HashCode *port,
-                           uint32_t options);
+                           uint32_t options,
+                           uint32_t window);
 
 
 /**
@@ -201,10 +210,12 @@ GCCH_handle_channel_plaintext_data_ack (struct CadetChannel *ch,
  * @param ch channel to destroy
  * @param cti identifier of the connection that delivered the message,
  *        NULL if the ACK was inferred because we got payload or are on loopback
+ * @param window receive window announced by the destination, 0 if none
  */
 void
 GCCH_handle_channel_open_ack (struct CadetChannel *ch,
-                              const struct GNUNET_CADET_ConnectionTunnelIdentifier *cti);
+                              const struct GNUNET_CADET_ConnectionTunnelIdentifier *cti,
+                              uint32_t window);
 
 
 /**
@@ -0,0 +1,353 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file cadet/gnunet-service-cadet-new_cidmap.c
+ * @brief flat table from connection identifiers to connections or
+ *        routes, used on the forwarding fast path
+ *
+ * The table uses open addressing with linear probing.  The 32-bit
+ * hashes are kept in an array of their own, so that a lookup
+ * usually touches one cache line of hashes and then the one slot
+ * with the matching key, instead of following the bucket chains of
+ * a `struct GNUNET_CONTAINER_MultiShortmap`.  Removal shifts the
+ * following entries back, so there are no tombstones.
+ *
+ * Relays use identifiers chosen by other peers as keys, so the hash
+ * is keyed with a random value to keep them from forcing long
+ * probe sequences.
+ */
+#include "platform.h"
+#include "gnunet-service-cadet-new_cidmap.h"
+
+/**
+ * Smallest number of slots of a map, must be a power of two.
+ */
+#define MIN_SLOTS 16
+
+
+/**
+ * Entry in the map.
+ */
+struct Slot
+{
+  /**
+   * The value, NULL if the slot is free.
+   */
+  void *value;
+
+  /**
+   * The key.
+   */
+  struct GNUNET_CADET_ConnectionTunnelIdentifier cid;
+};
+
+
+/**
+ * Map from `struct GNUNET_CADET_ConnectionTunnelIdentifier` to
+ * arbitrary values.
+ */
+struct CadetCidMap
+{
+  /**
+   * Hashes of the keys in @e slots, 0 for free slots.
+   */
+  uint32_t *hashes;
+
+  /**
+   * Array of @e num_slots slots.
+   */
+  struct Slot *slots;
+
+  /**
+   * Number of slots, always a power of two.
+   */
+  unsigned int num_slots;
+
+  /**
+   * Number of used slots.
+   */
+  unsigned int size;
+
+  /**
+   * Random key for the hash function.
+   */
+  uint32_t salt;
+};
+
+
+/**
+ * Compute the hash of a connection identifier, never 0.
+ *
+ * @param map map the hash is for
+ * @param cid identifier to hash
+ * @return the hash
+ */
+static uint32_t
+cid_hash (const struct CadetCidMap *map,
+          const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid)
+{
+  uint32_t words[sizeof (*cid) / sizeof (uint32_t)];
+  uint32_t h = map->salt;
+
+  GNUNET_memcpy (words,
+                 cid,
+                 sizeof (words));
+  for (unsigned int i=0;i<sizeof (words) / sizeof (uint32_t);i++)
+  {
+    h = (h ^ words[i]) * 0x9E3779B1U;
+    h ^= h >> 15;
+  }
+  return (0 == h) ? 1 : h;
+}
+
+
+/**
+ * Create a new map.
+ *
+ * @param len initial number of entries we expect
+ * @return the new map
+ */
+struct CadetCidMap *
+GCCM_create (unsigned int len)
+{
+  struct CadetCidMap *map;
+
+  map = GNUNET_new (struct CadetCidMap);
+  map->num_slots = MIN_SLOTS;
+  while (map->num_slots < 2 * len)
+    map->num_slots *= 2;
+  map->hashes = GNUNET_new_array (map->num_slots,
+                                  uint32_t);
+  map->slots = GNUNET_new_array (map->num_slots,
+                                 struct Slot);
+  map->salt = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                        UINT32_MAX);
+  return map;
+}
+
+
+/**
+ * Destroy a map.  Does not free the values.
+ *
+ * @param map map to destroy
+ */
+void
+GCCM_destroy (struct CadetCidMap *map)
+{
+  GNUNET_free (map->hashes);
+  GNUNET_free (map->slots);
+  GNUNET_free (map);
+}
+
+
+/**
+ * Get the number of entries in the map.
+ *
+ * @param map map to inspect
+ * @return number of entries
+ */
+unsigned int
+GCCM_size (const struct CadetCidMap *map)
+{
+  return map->size;
+}
+
+
+/**
+ * Find the slot of a key.
+ *
+ * @param map map to search
+ * @param cid key to look for
+ * @param h hash of @a cid
+ * @return index of the slot with @a cid, or of the free slot
+ *         where @a cid would be inserted
+ */
+static unsigned int
+find_slot (const struct CadetCidMap *map,
+           const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid,
+           uint32_t h)
+{
+  unsigned int mask = map->num_slots - 1;
+  unsigned int i = h & mask;
+
+  while (0 != map->hashes[i])
+  {
+    if ( (h == map->hashes[i]) &&
+         (0 == memcmp (cid,
+                       &map->slots[i].cid,
+                       sizeof (*cid))) )
+      return i;
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+
+/**
+ * Double the number of slots of the map.
+ *
+ * @param map map to grow
+ */
+static void
+grow (struct CadetCidMap *map)
+{
+  uint32_t *old_hashes = map->hashes;
+  struct Slot *old_slots = map->slots;
+  unsigned int old_num = map->num_slots;
+  unsigned int mask;
+
+  map->num_slots *= 2;
+  mask = map->num_slots - 1;
+  map->hashes = GNUNET_new_array (map->num_slots,
+                                  uint32_t);
+  map->slots = GNUNET_new_array (map->num_slots,
+                                 struct Slot);
+  for (unsigned int j=0;j<old_num;j++)
+  {
+    unsigned int i;
+
+    if (0 == old_hashes[j])
+      continue;
+    i = old_hashes[j] & mask;
+    while (0 != map->hashes[i])
+      i = (i + 1) & mask;
+    map->hashes[i] = old_hashes[j];
+    map->slots[i] = old_slots[j];
+  }
+  GNUNET_free (old_hashes);
+  GNUNET_free (old_slots);
+}
+
+
+/**
+ * Look up the value for a connection identifier.
+ *
+ * @param map map to search
+ * @param cid identifier to look for
+ * @return NULL if @a cid is not in @a map
+ */
+void *
+GCCM_get (const struct CadetCidMap *map,
+          const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid)
+{
+  unsigned int i;
+
+  i = find_slot (map,
+                 cid,
+                 cid_hash (map,
+                           cid));
+  return map->slots[i].value;
+}
+
+
+/**
+ * Add a value to the map.
+ *
+ * @param map map to modify
+ * @param cid identifier to use as the key
+ * @param value value to store, must not be NULL
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a cid
+ *         is already in @a map
+ */
+int
+GCCM_put (struct CadetCidMap *map,
+          const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid,
+          void *value)
+{
+  uint32_t h = cid_hash (map,
+                         cid);
+  unsigned int i;
+
+  GNUNET_assert (NULL != value);
+  i = find_slot (map,
+                 cid,
+                 h);
+  if (0 != map->hashes[i])
+    return GNUNET_SYSERR;
+  /* keep the load factor at most 1/2 */
+  if (2 * (map->size + 1) > map->num_slots)
+  {
+    grow (map);
+    i = find_slot (map,
+                   cid,
+                   h);
+  }
+  map->hashes[i] = h;
+  map->slots[i].cid = *cid;
+  map->slots[i].value = value;
+  map->size++;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Remove a value from the map.
+ *
+ * @param map map to modify
+ * @param cid identifier of the entry to remove
+ * @param value value expected under @a cid
+ * @return #GNUNET_YES if the entry was removed, #GNUNET_NO if
+ *         @a cid was not mapped to @a value
+ */
+int
+GCCM_remove (struct CadetCidMap *map,
+             const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid,
+             const void *value)
+{
+  unsigned int mask = map->num_slots - 1;
+  unsigned int i;
+  unsigned int j;
+
+  i = find_slot (map,
+                 cid,
+                 cid_hash (map,
+                           cid));
+  if ( (0 == map->hashes[i]) ||
+       (value != map->slots[i].value) )
+    return GNUNET_NO;
+  /* shift back entries that would no longer be found */
+  j = i;
+  while (1)
+  {
+    unsigned int home;
+
+    j = (j + 1) & mask;
+    if (0 == map->hashes[j])
+      break;
+    home = map->hashes[j] & mask;
+    /* can the entry at 'j' move to 'i' (is 'home' outside of (i,j])? */
+    if ( (i <= j)
+         ? ( (home <= i) || (home > j) )
+         : ( (home <= i) && (home > j) ) )
+    {
+      map->hashes[i] = map->hashes[j];
+      map->slots[i] = map->slots[j];
+      i = j;
+    }
+  }
+  map->hashes[i] = 0;
+  map->slots[i].value = NULL;
+  map->size--;
+  return GNUNET_YES;
+}
+
+
+/* end of gnunet-service-cadet-new_cidmap.c */
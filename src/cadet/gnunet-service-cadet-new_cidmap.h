@@ -0,0 +1,115 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file cadet/gnunet-service-cadet-new_cidmap.h
+ * @brief flat table from connection identifiers to connections or
+ *        routes, used on the forwarding fast path
+ *
+ * All functions in this file should use the prefix GCCM (Gnunet
+ * Cadet Connection identifier Map)
+ */
+#ifndef GNUNET_SERVICE_CADET_CIDMAP_H
+#define GNUNET_SERVICE_CADET_CIDMAP_H
+
+#include "gnunet_util_lib.h"
+#include "cadet_protocol.h"
+
+
+/**
+ * Map from `struct GNUNET_CADET_ConnectionTunnelIdentifier` to
+ * arbitrary values.  Keys are unique.
+ */
+struct CadetCidMap;
+
+
+/**
+ * Create a new map.
+ *
+ * @param len initial number of entries we expect
+ * @return the new map
+ */
+struct CadetCidMap *
+GCCM_create (unsigned int len);
+
+
+/**
+ * Destroy a map.  Does not free the values.
+ *
+ * @param map map to destroy
+ */
+void
+GCCM_destroy (struct CadetCidMap *map);
+
+
+/**
+ * Get the number of entries in the map.
+ *
+ * @param map map to inspect
+ * @return number of entries
+ */
+unsigned int
+GCCM_size (const struct CadetCidMap *map);
+
+
+/**
+ * Look up the value for a connection identifier.
+ *
+ * @param map map to search
+ * @param cid identifier to look for
+ * @return NULL if @a cid is not in @a map
+ */
+void *
+GCCM_get (const struct CadetCidMap *map,
+          const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid);
+
+
+/**
+ * Add a value to the map.
+ *
+ * @param map map to modify
+ * @param cid identifier to use as the key
+ * @param value value to store, must not be NULL
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a cid
+ *         is already in @a map
+ */
+int
+GCCM_put (struct CadetCidMap *map,
+          const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid,
+          void *value);
+
+
+/**
+ * Remove a value from the map.
+ *
+ * @param map map to modify
+ * @param cid identifier of the entry to remove
+ * @param value value expected under @a cid
+ * @return #GNUNET_YES if the entry was removed, #GNUNET_NO if
+ *         @a cid was not mapped to @a value
+ */
+int
+GCCM_remove (struct CadetCidMap *map,
+             const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid,
+             const void *value);
+
+
+#endif
+/* end of gnunet-service-cadet-new_cidmap.h */
@@ -177,8 +177,8 @@ struct CadetConnection
 struct CadetConnection *
 GCC_lookup (const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid)
 {
-  return GNUNET_CONTAINER_multishortmap_get (connections,
-                                             &cid->connection_of_tunnel);
+  return GCCM_get (connections,
+                   cid);
 }
 
 
@@ -249,9 +249,9 @@ GCC_destroy (struct CadetConnection *cc)
                                                     i),
                            cc);
   GNUNET_assert (GNUNET_YES ==
-                 GNUNET_CONTAINER_multishortmap_remove (connections,
-                                                        &GCC_get_id (cc)->connection_of_tunnel,
-                                                        cc));
+                 GCCM_remove (connections,
+                              GCC_get_id (cc),
+                              cc));
   GNUNET_free (cc);
 }
 
@@ -817,10 +817,9 @@ connection_create (struct CadetPeer *destination,
   cc->ct = ct;
   cc->cid = *cid;
   GNUNET_assert (GNUNET_OK ==
-                 GNUNET_CONTAINER_multishortmap_put (connections,
-                                                     &GCC_get_id (cc)->connection_of_tunnel,
-                                                     cc,
-                                                     GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+                 GCCM_put (connections,
+                           GCC_get_id (cc),
+                           cc));
   cc->ready_cb = ready_cb;
   cc->ready_cb_cls = ready_cb_cls;
   cc->path = path;
@@ -31,6 +31,7 @@
  */
 #include "platform.h"
 #include "gnunet-service-cadet-new_core.h"
+#include "gnunet-service-cadet-new_cidmap.h"
 #include "gnunet-service-cadet-new_paths.h"
 #include "gnunet-service-cadet-new_peer.h"
 #include "gnunet-service-cadet-new_connection.h"
@@ -195,7 +196,7 @@ static struct GNUNET_CORE_Handle *core;
 /**
  * Routes on which this peer is an intermediate.
  */
-static struct GNUNET_CONTAINER_MultiShortmap *routes;
+static struct CadetCidMap *routes;
 
 /**
  * Heap of routes, MIN-sorted by last activity.
@@ -228,6 +229,11 @@ static unsigned long long max_routes;
  */
 static unsigned long long max_buffers;
 
+/**
+ * Maximum number of envelopes we will buffer per route direction.
+ */
+static unsigned long long max_dir_buffers;
+
 /**
  * Current number of envelopes we have buffered at this peer.
  */
@@ -247,8 +253,8 @@ static struct GNUNET_SCHEDULER_Task *timeout_task;
 static struct CadetRoute *
 get_route (const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid)
 {
-  return GNUNET_CONTAINER_multishortmap_get (routes,
-                                             &cid->connection_of_tunnel);
+  return GCCM_get (routes,
+                   cid);
 }
 
 
@@ -407,6 +413,22 @@ route_message (struct CadetPeer *prev,
     discard_buffer (dir,
                     dir->env_head);
   rung = dir->rung;
+  if (rung->rung_off >= max_dir_buffers)
+  {
+    /* Buffer of this direction is full, drop the new message before
+       we spend a copy on it; the messages already queued are older
+       and thus more likely to still be useful to the tunnel. */
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Buffer of connection %s towards %s full, dropping message of type %u\n",
+         GNUNET_sh2s (&cid->connection_of_tunnel),
+         GCP_2s (dir->hop),
+         ntohs (msg->type));
+    GNUNET_STATISTICS_update (stats,
+                              "# messages dropped due to full route buffer",
+                              1,
+                              GNUNET_NO);
+    return;
+  }
   if (cur_buffers == max_buffers)
   {
     /* Need to make room. */
@@ -550,12 +572,12 @@ destroy_route (struct CadetRoute *route)
   GNUNET_assert (route ==
                  GNUNET_CONTAINER_heap_remove_node (route->hn));
   GNUNET_assert (GNUNET_YES ==
-                 GNUNET_CONTAINER_multishortmap_remove (routes,
-                                                        &route->cid.connection_of_tunnel,
-                                                        route));
+                 GCCM_remove (routes,
+                              &route->cid,
+                              route));
   GNUNET_STATISTICS_set (stats,
                          "# routes",
-                         GNUNET_CONTAINER_multishortmap_size (routes),
+                         GCCM_size (routes),
                          GNUNET_NO);
   destroy_direction (&route->prev);
   destroy_direction (&route->next);
@@ -867,7 +889,7 @@ handle_connection_create (void *cls,
                              &pids[off + 1]);
     return;
   }
-  if (max_routes <= GNUNET_CONTAINER_multishortmap_size (routes))
+  if (max_routes <= GCCM_size (routes))
   {
     LOG (GNUNET_ERROR_TYPE_DEBUG,
          "Received CADET_CONNECTION_CREATE from %s for %s. We have reached our route limit. Sending BROKEN\n",
@@ -897,13 +919,12 @@ handle_connection_create (void *cls,
             route,
             next);
   GNUNET_assert (GNUNET_OK ==
-                 GNUNET_CONTAINER_multishortmap_put (routes,
-                                                     &route->cid.connection_of_tunnel,
-                                                     route,
-                                                     GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+                 GCCM_put (routes,
+                           &route->cid,
+                           route));
   GNUNET_STATISTICS_set (stats,
                          "# routes",
-                         GNUNET_CONTAINER_multishortmap_size (routes),
+                         GCCM_size (routes),
                          GNUNET_NO);
   route->hn = GNUNET_CONTAINER_heap_insert (route_heap,
                                             route,
@@ -1318,8 +1339,14 @@ GCO_init (const struct GNUNET_CONFIGURATION_Handle *c)
                                              "MAX_MSGS_QUEUE",
                                              &max_buffers))
     max_buffers = 10000;
-  routes = GNUNET_CONTAINER_multishortmap_create (1024,
-                                                  GNUNET_NO);
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (c,
+                                               "CADET",
+                                               "MAX_ROUTE_BUFFER",
+                                               &max_dir_buffers)) ||
+       (0 == max_dir_buffers) )
+    max_dir_buffers = 64;
+  routes = GCCM_create (1024);
   route_heap = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
   core = GNUNET_CORE_connect (c,
                               NULL,
@@ -1341,8 +1368,8 @@ GCO_shutdown ()
     GNUNET_CORE_disconnect (core);
     core = NULL;
   }
-  GNUNET_assert (0 == GNUNET_CONTAINER_multishortmap_size (routes));
-  GNUNET_CONTAINER_multishortmap_destroy (routes);
+  GNUNET_assert (0 == GCCM_size (routes));
+  GCCM_destroy (routes);
   routes = NULL;
   GNUNET_CONTAINER_heap_destroy (route_heap);
   route_heap = NULL;
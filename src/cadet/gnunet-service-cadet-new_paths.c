@@ -32,6 +32,11 @@
 
 #define LOG(level, ...) GNUNET_log_from(level,"cadet-pat",__VA_ARGS__)
 
+/**
+ * Number of path entries we allocate at once.
+ */
+#define ENTRIES_PER_CHUNK 256
+
 
 /**
  * Information regarding a possible path to reach a peer.
@@ -65,6 +70,341 @@ struct CadetPeerPath
 };
 
 
+/**
+ * Node in the trie of the prefixes of all known paths.  Entries of
+ * different paths that have the same peers up to and including
+ * their offset share a node, so finding all paths that start with a
+ * given sequence of peers takes one lookup per hop.
+ */
+struct CadetPathTrieNode
+{
+
+  /**
+   * Node of the prefix without the last peer, NULL at offset 0.
+   */
+  struct CadetPathTrieNode *parent;
+
+  /**
+   * Last peer of the prefix.
+   */
+  struct CadetPeer *peer;
+
+  /**
+   * DLL of path entries ending the prefix, linked via their
+   * @e next_prefix and @e prev_prefix fields.
+   */
+  struct CadetPeerPathEntry *entries_head;
+
+  /**
+   * DLL of path entries ending the prefix.
+   */
+  struct CadetPeerPathEntry *entries_tail;
+
+  /**
+   * Number of entries and child nodes referring to this node.
+   */
+  unsigned int rc;
+
+};
+
+
+/**
+ * Block of path entries, allocated together to avoid one allocation
+ * per hop and to keep the entries of paths close to each other.
+ */
+struct EntryChunk
+{
+
+  /**
+   * Chunks are kept in a list.
+   */
+  struct EntryChunk *next;
+
+  /**
+   * The entries.
+   */
+  struct CadetPeerPathEntry entries[ENTRIES_PER_CHUNK];
+
+};
+
+
+/**
+ * Trie of the prefixes of all known paths, maps the key computed by
+ * #trie_key() to `struct CadetPathTrieNode` objects.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap32 *trie;
+
+/**
+ * All chunks of path entries.
+ */
+static struct EntryChunk *chunks;
+
+/**
+ * Entries not in use, linked via their @e next field.
+ */
+static struct CadetPeerPathEntry *free_entries;
+
+
+/**
+ * Allocate a path entry.
+ *
+ * @param path path the entry is for
+ * @param peer peer at the entry
+ * @return the entry
+ */
+static struct CadetPeerPathEntry *
+entry_alloc (struct CadetPeerPath *path,
+             struct CadetPeer *peer)
+{
+  struct CadetPeerPathEntry *entry;
+
+  if (NULL == free_entries)
+  {
+    struct EntryChunk *chunk = GNUNET_new (struct EntryChunk);
+
+    chunk->next = chunks;
+    chunks = chunk;
+    for (unsigned int i=0;i<ENTRIES_PER_CHUNK;i++)
+    {
+      chunk->entries[i].next = free_entries;
+      free_entries = &chunk->entries[i];
+    }
+  }
+  entry = free_entries;
+  free_entries = entry->next;
+  memset (entry,
+          0,
+          sizeof (*entry));
+  entry->peer = peer;
+  entry->path = path;
+  return entry;
+}
+
+
+/**
+ * Return a path entry to the free list.
+ *
+ * @param entry the entry to release
+ */
+static void
+entry_free (struct CadetPeerPathEntry *entry)
+{
+  GNUNET_assert (NULL == entry->node);
+  entry->next = free_entries;
+  free_entries = entry;
+}
+
+
+/**
+ * Compute the key of a trie node in #trie.
+ *
+ * @param parent node of the prefix without @a peer
+ * @param peer last peer of the prefix
+ * @return key for the node
+ */
+static uint32_t
+trie_key (const struct CadetPathTrieNode *parent,
+          const struct CadetPeer *peer)
+{
+  uint64_t k;
+
+  k = ((uint64_t) (uintptr_t) parent) * 0x9E3779B97F4A7C15LLU;
+  k ^= (uint64_t) (uintptr_t) peer;
+  k *= 0xC2B2AE3D27D4EB4FLLU;
+  return (uint32_t) (k >> 32);
+}
+
+
+/**
+ * Closure for #check_trie_node().
+ */
+struct TrieLookupContext
+{
+  /**
+   * Parent of the node we are looking for.
+   */
+  const struct CadetPathTrieNode *parent;
+
+  /**
+   * Peer of the node we are looking for.
+   */
+  const struct CadetPeer *peer;
+
+  /**
+   * Set to the node, if found.
+   */
+  struct CadetPathTrieNode *match;
+};
+
+
+/**
+ * Check if @a value is the trie node we are looking for.
+ *
+ * @param cls the `struct TrieLookupContext`
+ * @param key key of the node
+ * @param value a `struct CadetPathTrieNode`
+ * @return #GNUNET_NO if we found the node
+ */
+static int
+check_trie_node (void *cls,
+                 uint32_t key,
+                 void *value)
+{
+  struct TrieLookupContext *tlc = cls;
+  struct CadetPathTrieNode *node = value;
+
+  if ( (node->parent != tlc->parent) ||
+       (node->peer != tlc->peer) )
+    return GNUNET_YES;
+  tlc->match = node;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Find the node for the prefix @a parent extended by @a peer.
+ *
+ * @param parent node of the prefix without @a peer, NULL for the root
+ * @param peer last peer of the prefix
+ * @return NULL if no known path starts with the prefix
+ */
+static struct CadetPathTrieNode *
+trie_lookup (const struct CadetPathTrieNode *parent,
+             const struct CadetPeer *peer)
+{
+  struct TrieLookupContext tlc;
+
+  if (NULL == trie)
+    return NULL;
+  tlc.parent = parent;
+  tlc.peer = peer;
+  tlc.match = NULL;
+  GNUNET_CONTAINER_multihashmap32_get_multiple (trie,
+                                                trie_key (parent,
+                                                          peer),
+                                                &check_trie_node,
+                                                &tlc);
+  return tlc.match;
+}
+
+
+/**
+ * Drop a reference to a trie node, freeing it (and possibly its
+ * parents) once it is no longer used.
+ *
+ * @param node node to release
+ */
+static void
+trie_release (struct CadetPathTrieNode *node)
+{
+  while (NULL != node)
+  {
+    struct CadetPathTrieNode *parent = node->parent;
+
+    GNUNET_assert (0 < node->rc);
+    if (0 != --node->rc)
+      return;
+    GNUNET_assert (NULL == node->entries_head);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap32_remove (trie,
+                                                           trie_key (parent,
+                                                                     node->peer),
+                                                           node));
+    GNUNET_free (node);
+    node = parent;
+  }
+}
+
+
+/**
+ * Add the entry at offset @a off of @a path to the trie.  The
+ * entries at smaller offsets must already be in the trie.
+ *
+ * @param path path of the entry
+ * @param off offset of the entry
+ */
+static void
+trie_add (struct CadetPeerPath *path,
+          unsigned int off)
+{
+  struct CadetPeerPathEntry *entry = path->entries[off];
+  struct CadetPathTrieNode *parent;
+  struct CadetPathTrieNode *node;
+
+  GNUNET_assert (NULL == entry->node);
+  parent = (0 == off) ? NULL : path->entries[off - 1]->node;
+  GNUNET_assert ( (0 == off) ||
+                  (NULL != parent) );
+  node = trie_lookup (parent,
+                      entry->peer);
+  if (NULL == node)
+  {
+    if (NULL == trie)
+      trie = GNUNET_CONTAINER_multihashmap32_create (256);
+    node = GNUNET_new (struct CadetPathTrieNode);
+    node->parent = parent;
+    node->peer = entry->peer;
+    if (NULL != parent)
+      parent->rc++;
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap32_put (trie,
+                                                        trie_key (parent,
+                                                                  entry->peer),
+                                                        node,
+                                                        GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  }
+  node->rc++;
+  GNUNET_CONTAINER_MDLL_insert (prefix,
+                                node->entries_head,
+                                node->entries_tail,
+                                entry);
+  entry->node = node;
+}
+
+
+/**
+ * Remove @a entry from the trie.
+ *
+ * @param entry entry to remove
+ */
+static void
+trie_remove (struct CadetPeerPathEntry *entry)
+{
+  struct CadetPathTrieNode *node = entry->node;
+
+  if (NULL == node)
+    return;
+  GNUNET_CONTAINER_MDLL_remove (prefix,
+                                node->entries_head,
+                                node->entries_tail,
+                                entry);
+  entry->node = NULL;
+  trie_release (node);
+}
+
+
+/**
+ * Cut the entry at offset @a off off the end of @a path: remove it
+ * from its peer and the trie and free it.
+ *
+ * @param path the path
+ * @param off offset of the last entry of @a path
+ */
+static void
+entry_remove (struct CadetPeerPath *path,
+              unsigned int off)
+{
+  struct CadetPeerPathEntry *entry = path->entries[off];
+
+  GCP_path_entry_remove (entry->peer,
+                         entry,
+                         off);
+  trie_remove (entry);
+  entry_free (entry);
+  path->entries[off] = NULL;
+}
+
+
 /**
  * Calculate the path's desirability score.
  *
@@ -210,7 +550,8 @@ path_destroy (struct CadetPeerPath *path)
         GCT_connection_lost (ct);
       GCC_destroy_without_tunnel (entry->cc);
     }
-    GNUNET_free (entry);
+    trie_remove (entry);
+    entry_free (entry);
   }
   GNUNET_free (path->entries);
   GNUNET_free (path);
@@ -240,12 +581,10 @@ GCPP_release (struct CadetPeerPath *path)
   {
     /* cut 'off' end of path */
     GNUNET_assert (NULL == entry->cc);
-    GCP_path_entry_remove (entry->peer,
-                           entry,
-                           path->entries_length - 1);
+    entry_remove (path,
+                  path->entries_length - 1);
     path->entries_length--; /* We don't bother shrinking the 'entries' array,
                                as it's probably not worth it. */
-    GNUNET_free (entry);
     if (0 == path->entries_length)
       break; /* the end */
 
@@ -305,74 +644,65 @@ GCPP_update_score (struct CadetPeerPath *path,
 
 
 /**
- * Closure for #find_peer_at() and #check_match().
+ * Find the trie nodes of the longest prefix of @a cpath that some
+ * known path starts with.
+ *
+ * @param cpath peers to look up
+ * @param cpath_length length of @a cpath
+ * @param[out] nodes set to the nodes of the prefixes of @a cpath
+ * @return number of elements of @a nodes that were set
  */
-struct CheckMatchContext
+static unsigned int
+lookup_prefix (struct CadetPeer **cpath,
+               unsigned int cpath_length,
+               struct CadetPathTrieNode **nodes)
 {
+  struct CadetPathTrieNode *node = NULL;
+  unsigned int depth;
 
-  /**
-   * Set to a matching path, if any.
-   */
-  struct CadetPeerPath *match;
-
-  /**
-   * Array the combined paths.
-   */
-  struct CadetPeer **cpath;
-
-  /**
-   * How long is the @e cpath array?
-   */
-  unsigned int cpath_length;
-
-};
+  for (depth=0;depth<cpath_length;depth++)
+  {
+    node = trie_lookup (node,
+                        cpath[depth]);
+    if (NULL == node)
+      break;
+    nodes[depth] = node;
+  }
+  return depth;
+}
 
 
 /**
- * Check if the given path is identical on all of the
- * hops until @a off, and not longer than @a off.  If the
- * @a path matches, store it in `match`.
+ * Find a path that is identical to the peers we look for on all of
+ * the hops until @a off, and not longer than @a off unless @a off is
+ * the end of what we look for.
  *
- * @param cls the `struct CheckMatchContext` to check against
- * @param path the path to check
+ * @param node trie node of the prefix up to @a off
  * @param off offset to check at
- * @return #GNUNET_YES (continue to iterate), or if found #GNUNET_NO
+ * @param cpath_length number of peers we look for
+ * @return NULL if there is no such path
  */
-static int
-check_match (void *cls,
-             struct CadetPeerPath *path,
-             unsigned int off)
+static struct CadetPeerPath *
+find_match (const struct CadetPathTrieNode *node,
+            unsigned int off,
+            unsigned int cpath_length)
 {
-  struct CheckMatchContext *cm_ctx = cls;
-
-  GNUNET_assert (path->entries_length > off);
-  if ( (path->entries_length != off + 1) &&
-       (off + 1 != cm_ctx->cpath_length) )
+  for (struct CadetPeerPathEntry *entry = node->entries_head;
+       NULL != entry;
+       entry = entry->next_prefix)
   {
+    struct CadetPeerPath *path = entry->path;
+
+    GNUNET_assert (path->entries_length > off);
+    if ( (path->entries_length != off + 1) &&
+         (off + 1 != cpath_length) )
+      continue; /* too long, goes somewhere else already, thus cannot be useful */
     LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "check_match missmatch because path %s is too long (%u vs. %u vs. %u)\n",
-         GCPP_2s (path),
-         path->entries_length,
-         off + 1,
-         cm_ctx->cpath_length);
-    return GNUNET_YES; /* too long, goes somewhere else already, thus cannot be useful */
+         "find_match found match with path %s\n",
+         GCPP_2s (path));
+    return path;
   }
-  for (unsigned int i=0;i<off;i++)
-    if (cm_ctx->cpath[i] !=
-        GCPP_get_peer_at_offset (path,
-                                 i))
-    {
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "check_match path %s missmatches at offset %u\n",
-           GCPP_2s (path),
-           i);
-      return GNUNET_YES; /* missmatch, ignore */
-    }
-  LOG (GNUNET_ERROR_TYPE_DEBUG,
-       "check_match found match with path %s\n",
-       GCPP_2s (path));
-  cm_ctx->match = path;
-  return GNUNET_NO; /* match, we are done! */
+  return NULL;
 }
 
 
@@ -399,13 +729,12 @@ extend_path (struct CadetPeerPath *path,
   GNUNET_array_grow (path->entries,
                      path->entries_length,
                      old_len + num_peers);
-  for (i=num_peers-1;i >= 0;i--)
+  for (i=0;i < (int) num_peers;i++)
   {
-    struct CadetPeerPathEntry *entry = GNUNET_new (struct CadetPeerPathEntry);
-
-    path->entries[old_len + i] = entry;
-    entry->peer = peers[i];
-    entry->path = path;
+    path->entries[old_len + i] = entry_alloc (path,
+                                              peers[i]);
+    trie_add (path,
+              old_len + i);
   }
   for (i=num_peers-1;i >= 0;i--)
   {
@@ -435,11 +764,8 @@ extend_path (struct CadetPeerPath *path,
     if (NULL != path->hn)
       break;
     GNUNET_assert (NULL == entry->cc);
-    GCP_path_entry_remove (entry->peer,
-                           entry,
-                           old_len + i);
-    GNUNET_free (entry);
-    path->entries[old_len + i] = NULL;
+    entry_remove (path,
+                  old_len + i);
   }
   if (NULL == path->hn)
   {
@@ -480,7 +806,8 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
                         unsigned int put_path_length)
 {
   struct CadetPeer *cpath[get_path_length + put_path_length];
-  struct CheckMatchContext cm_ctx;
+  struct CadetPathTrieNode *nodes[get_path_length + put_path_length];
+  struct CadetPeerPath *match;
   struct CadetPeerPath *path;
   struct GNUNET_CONTAINER_HeapNode *hn;
   int i;
@@ -516,16 +843,14 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
 
   /* First figure out if this path is a subset of an existing path, an
      extension of an existing path, or a new path. */
-  cm_ctx.cpath_length = total_len;
-  cm_ctx.cpath = cpath;
-  cm_ctx.match = NULL;
-  for (i=total_len-1;i>=0;i--)
+  for (i=lookup_prefix (cpath,
+                        total_len,
+                        nodes) - 1;i>=0;i--)
   {
-    GCP_iterate_paths_at (cpath[i],
-                          (unsigned int) i,
-                          &check_match,
-                          &cm_ctx);
-    if (NULL != cm_ctx.match)
+    match = find_match (nodes[i],
+                        (unsigned int) i,
+                        total_len);
+    if (NULL != match)
     {
       if (i == total_len - 1)
       {
@@ -534,13 +859,13 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
              "Path discovered from DHT is already known\n");
         return;
       }
-      if (cm_ctx.match->entries_length == i + 1)
+      if (match->entries_length == i + 1)
       {
         /* Existing path ends in the middle of new path, extend it! */
         LOG (GNUNET_ERROR_TYPE_DEBUG,
              "Trying to extend existing path %s by additional links discovered from DHT\n",
-             GCPP_2s (cm_ctx.match));
-        extend_path (cm_ctx.match,
+             GCPP_2s (match));
+        extend_path (match,
                      &cpath[i + 1],
                      total_len - i - 1,
                      GNUNET_NO);
@@ -554,13 +879,12 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
   path->entries_length = total_len;
   path->entries = GNUNET_new_array (path->entries_length,
                                     struct CadetPeerPathEntry *);
-  for (i=path->entries_length-1;i>=0;i--)
+  for (i=0;i<(int) path->entries_length;i++)
   {
-    struct CadetPeerPathEntry *entry = GNUNET_new (struct CadetPeerPathEntry);
-
-    path->entries[i] = entry;
-    entry->peer = cpath[i];
-    entry->path = path;
+    path->entries[i] = entry_alloc (path,
+                                    cpath[i]);
+    trie_add (path,
+              i);
   }
   for (i=path->entries_length-1;i>=0;i--)
   {
@@ -575,8 +899,6 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
   hn = NULL;
   for (i=total_len-1;i>=0;i--)
   {
-    struct CadetPeerPathEntry *entry = path->entries[i];
-
     path->entries_length = i + 1;
     recalculate_path_desirability (path);
     hn = GCP_attach_path (cpath[i],
@@ -585,11 +907,8 @@ GCPP_try_path_from_dht (const struct GNUNET_PeerIdentity *get_path,
                           GNUNET_NO);
     if (NULL != hn)
       break;
-    GCP_path_entry_remove (entry->peer,
-                           entry,
-                           i);
-    GNUNET_free (entry);
-    path->entries[i] = NULL;
+    entry_remove (path,
+                  i);
   }
   if (NULL == hn)
   {
@@ -622,8 +941,9 @@ struct CadetPeerPath *
 GCPP_get_path_from_route (unsigned int path_length,
                           const struct GNUNET_PeerIdentity *pids)
 {
-  struct CheckMatchContext cm_ctx;
   struct CadetPeer *cpath[path_length];
+  struct CadetPathTrieNode *nodes[path_length];
+  struct CadetPeerPath *match;
   struct CadetPeerPath *path;
 
   /* precompute inverted 'cpath' so we can avoid doing the lookups and
@@ -634,38 +954,36 @@ GCPP_get_path_from_route (unsigned int path_length,
 
   /* First figure out if this path is a subset of an existing path, an
      extension of an existing path, or a new path. */
-  cm_ctx.cpath = cpath;
-  cm_ctx.cpath_length = path_length;
-  cm_ctx.match = NULL;
-  for (int i=path_length-1;i>=0;i--)
+  for (int i=lookup_prefix (cpath,
+                            path_length,
+                            nodes) - 1;i>=0;i--)
   {
-    GCP_iterate_paths_at (cpath[i],
-                          (unsigned int) i,
-                          &check_match,
-                          &cm_ctx);
-    if (NULL != cm_ctx.match)
+    match = find_match (nodes[i],
+                        (unsigned int) i,
+                        path_length);
+    if (NULL != match)
     {
       if (i == path_length - 1)
       {
         /* Existing path includes this one, return the match! */
         LOG (GNUNET_ERROR_TYPE_DEBUG,
              "Returning existing path %s as inverse for incoming connection\n",
-             GCPP_2s (cm_ctx.match));
-        return cm_ctx.match;
+             GCPP_2s (match));
+        return match;
       }
-      if (cm_ctx.match->entries_length == i + 1)
+      if (match->entries_length == i + 1)
       {
         /* Existing path ends in the middle of new path, extend it! */
         LOG (GNUNET_ERROR_TYPE_DEBUG,
              "Extending existing path %s to create inverse for incoming connection\n",
-             GCPP_2s (cm_ctx.match));
-        extend_path (cm_ctx.match,
+             GCPP_2s (match));
+        extend_path (match,
                      &cpath[i + 1],
                      path_length - i - 1,
                      GNUNET_YES);
         /* Check that extension was successful */
-        GNUNET_assert (cm_ctx.match->entries_length == path_length);
-        return cm_ctx.match;
+        GNUNET_assert (match->entries_length == path_length);
+        return match;
       }
       /* Eh, we found a match but couldn't use it? Something is wrong. */
       GNUNET_break (0);
@@ -677,13 +995,12 @@ GCPP_get_path_from_route (unsigned int path_length,
   path->entries_length = path_length;
   path->entries = GNUNET_new_array (path->entries_length,
                                     struct CadetPeerPathEntry *);
-  for (int i=path_length-1;i>=0;i--)
+  for (unsigned int i=0;i<path_length;i++)
   {
-    struct CadetPeerPathEntry *entry = GNUNET_new (struct CadetPeerPathEntry);
-
-    path->entries[i] = entry;
-    entry->peer = cpath[i];
-    entry->path = path;
+    path->entries[i] = entry_alloc (path,
+                                    cpath[i]);
+    trie_add (path,
+              i);
   }
   for (int i=path_length-1;i>=0;i--)
   {
@@ -705,6 +1022,31 @@ GCPP_get_path_from_route (unsigned int path_length,
 }
 
 
+/**
+ * Release the memory of the path store.  All paths must have been
+ * destroyed before.
+ */
+void
+GCPP_shutdown ()
+{
+  if (NULL != trie)
+  {
+    GNUNET_break (0 ==
+                  GNUNET_CONTAINER_multihashmap32_size (trie));
+    GNUNET_CONTAINER_multihashmap32_destroy (trie);
+    trie = NULL;
+  }
+  while (NULL != chunks)
+  {
+    struct EntryChunk *chunk = chunks;
+
+    chunks = chunk->next;
+    GNUNET_free (chunk);
+  }
+  free_entries = NULL;
+}
+
+
 /**
  * Return the length of the path.  Excludes one end of the
  * path, so the loopback path has length 0.
@@ -169,6 +169,14 @@ GCPP_get_peer_at_offset (struct CadetPeerPath *path,
                          unsigned int off);
 
 
+/**
+ * Release the memory of the path store.  All paths must have been
+ * destroyed before.
+ */
+void
+GCPP_shutdown (void);
+
+
 /**
  * Convert a path to a human-readable string.
  *
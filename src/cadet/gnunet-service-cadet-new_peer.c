@@ -414,7 +414,7 @@ consider_peer_activate (struct CadetPeer *cp)
   {
     /* Lacks direct connection, try to create one by querying the DHT */
     if ( (NULL == cp->search_h) &&
-         (DESIRED_CONNECTIONS_PER_TUNNEL > cp->num_paths) )
+         (desired_connections > cp->num_paths) )
       cp->search_h
         = GCD_search (&cp->pid);
   }
@@ -838,7 +838,7 @@ GCP_path_entry_add (struct CadetPeer *cp,
                        off);
 
   if ( (NULL != cp->search_h) &&
-       (DESIRED_CONNECTIONS_PER_TUNNEL <= cp->num_paths) )
+       (desired_connections <= cp->num_paths) )
   {
     /* Now I have enough paths, stop search */
     GCD_search_stop (cp->search_h);
@@ -880,7 +880,7 @@ GCP_path_entry_remove (struct CadetPeer *cp,
   if ( (NULL == cp->core_mq) &&
        (NULL != cp->t) &&
        (NULL == cp->search_h) &&
-       (DESIRED_CONNECTIONS_PER_TUNNEL > cp->num_paths) )
+       (desired_connections > cp->num_paths) )
     cp->search_h
       = GCD_search (&cp->pid);
   if (NULL == cp->destroy_task)
@@ -935,7 +935,7 @@ GCP_attach_path (struct CadetPeer *cp,
       root_desirability = 0;
     }
 
-    if ( (DESIRED_CONNECTIONS_PER_TUNNEL > cp->num_paths) &&
+    if ( (desired_connections > cp->num_paths) &&
          (desirability < root_desirability) )
     {
       LOG (GNUNET_ERROR_TYPE_DEBUG,
@@ -959,7 +959,7 @@ GCP_attach_path (struct CadetPeer *cp,
 
   /* Consider maybe dropping other paths because of the new one */
   if (GNUNET_CONTAINER_heap_get_size (cp->path_heap) >=
-      2 * DESIRED_CONNECTIONS_PER_TUNNEL)
+      2 * desired_connections)
   {
     /* Now we have way too many, drop least desirable UNLESS it is in use!
        (Note that this intentionally keeps highly desireable, but currently
@@ -74,6 +74,55 @@
  */
 #define MAX_KEY_GAP 256
 
+/**
+ * Congestion window of a new tunnel, in DATA messages.
+ */
+#define CC_INITIAL_WINDOW 4
+
+/**
+ * Smallest congestion window, in DATA messages.
+ */
+#define CC_MIN_WINDOW 2
+
+/**
+ * Largest congestion window, in DATA messages.
+ */
+#define CC_MAX_WINDOW 1024
+
+/**
+ * Queueing delay we aim for.  As long as the RTT stays less than this
+ * above the smallest RTT we saw, the congestion window grows; beyond,
+ * it shrinks (like LEDBAT, RFC 6817).
+ */
+#define CC_TARGET_DELAY GNUNET_TIME_relative_multiply(GNUNET_TIME_UNIT_MILLISECONDS, 25)
+
+/**
+ * For how long is a minimum RTT sample used as the base delay?
+ * We keep the minima of the current and the last period, so that
+ * the base delay follows route changes.
+ */
+#define CC_BASE_PERIOD GNUNET_TIME_relative_multiply(GNUNET_TIME_UNIT_MINUTES, 1)
+
+/**
+ * Quantum for the deficit round robin between the channels of a
+ * tunnel, in bytes.
+ */
+#define FLOW_QUANTUM 1024
+
+/**
+ * How long do we hold back a message received on one connection
+ * while we wait for messages sent before it on other connections?
+ * We also do not stripe onto connections whose latency exceeds that
+ * of our fastest connection by more than this.
+ */
+#define REORDER_TIMEOUT GNUNET_TIME_relative_multiply(GNUNET_TIME_UNIT_MILLISECONDS, 50)
+
+/**
+ * Message size we assume when estimating the transmission delay
+ * of a connection.
+ */
+#define STRIPE_NOMINAL_SIZE 1024
+
 
 /**
  * Struct to old keys for skipped messages while advancing the Axolotl ratchet.
@@ -287,6 +336,156 @@ struct CadetTunnelQueueEntry
    * of the message in @e env once we have it?
    */
   struct GNUNET_CADET_ConnectionTunnelIdentifier *cid;
+
+  /**
+   * Flow this DATA message is queued in, NULL if the message
+   * is in the control queue of the tunnel.
+   */
+  struct CadetTunnelFlow *flow;
+
+  /**
+   * Size of the (plaintext) message.
+   */
+  uint16_t size;
+};
+
+
+/**
+ * DATA messages of one channel waiting for transmission.  The
+ * flows of a tunnel are served in deficit round robin, so that a
+ * channel with bulk traffic cannot starve the others.
+ */
+struct CadetTunnelFlow
+{
+  /**
+   * We are entries in a DLL of flows with queued messages.
+   */
+  struct CadetTunnelFlow *next;
+
+  /**
+   * We are entries in a DLL of flows with queued messages.
+   */
+  struct CadetTunnelFlow *prev;
+
+  /**
+   * Head of the DLL of queued messages, never NULL.
+   */
+  struct CadetTunnelQueueEntry *tq_head;
+
+  /**
+   * Tail of the DLL of queued messages.
+   */
+  struct CadetTunnelQueueEntry *tq_tail;
+
+  /**
+   * Number of the channel the messages belong to.
+   */
+  struct GNUNET_CADET_ChannelTunnelNumber ctn;
+
+  /**
+   * How many bytes may this flow still send in this round?
+   */
+  unsigned int deficit;
+};
+
+
+/**
+ * Congestion control state of a tunnel.  We only count reliable
+ * DATA messages, as only those are ever acknowledged, and get
+ * our RTT samples from the channel layer.
+ */
+struct CadetTunnelCongestion
+{
+  /**
+   * Smoothed RTT, zero if we have no sample yet.
+   */
+  struct GNUNET_TIME_Relative srtt;
+
+  /**
+   * Smallest RTT observed in the current #CC_BASE_PERIOD.
+   */
+  struct GNUNET_TIME_Relative base_cur;
+
+  /**
+   * Smallest RTT observed in the previous #CC_BASE_PERIOD.
+   */
+  struct GNUNET_TIME_Relative base_prev;
+
+  /**
+   * When does the current #CC_BASE_PERIOD end?
+   */
+  struct GNUNET_TIME_Absolute base_rollover;
+
+  /**
+   * When did we last shrink the window due to a loss?  We only
+   * react to one loss per RTT.
+   */
+  struct GNUNET_TIME_Absolute last_reduction;
+
+  /**
+   * Earliest time we may send the next DATA message (pacing).
+   */
+  struct GNUNET_TIME_Absolute next_send;
+
+  /**
+   * Congestion window, in DATA messages.
+   */
+  double cwnd;
+
+  /**
+   * Slow start threshold, in DATA messages.
+   */
+  double ssthresh;
+
+  /**
+   * Number of reliable DATA messages sent and not yet acknowledged
+   * or declared lost.
+   */
+  unsigned int in_flight;
+
+  /**
+   * Value of @e cwnd last reported to statistics.
+   */
+  unsigned int cwnd_reported;
+};
+
+
+/**
+ * Decrypted message we hold back because messages sent before it
+ * (likely via other connections) are still missing.  The plaintext
+ * follows this struct.
+ */
+struct CadetTunnelHeldMessage
+{
+  /**
+   * We are entries in a DLL, sorted by @e Kn.
+   */
+  struct CadetTunnelHeldMessage *next;
+
+  /**
+   * We are entries in a DLL, sorted by @e Kn.
+   */
+  struct CadetTunnelHeldMessage *prev;
+
+  /**
+   * Connection the message arrived on.
+   */
+  struct CadetTConnection *ct;
+
+  /**
+   * Header key of the chain the message belongs to.
+   */
+  struct GNUNET_CRYPTO_SymmetricSessionKey HK;
+
+  /**
+   * Number of the message in its chain.
+   */
+  uint32_t Kn;
+
+  /**
+   * Size of the plaintext.
+   */
+  size_t size;
 };
 
 
@@ -392,15 +591,54 @@ struct CadetTunnel
   struct GNUNET_CADET_ChannelTunnelNumber next_ctn;
 
   /**
-   * Queued messages, to transmit once tunnel gets connected.
+   * Queued messages other than DATA (channel control, ACKs and
+   * keepalives).  These are sent before any DATA.
    */
   struct CadetTunnelQueueEntry *tq_head;
 
   /**
-   * Queued messages, to transmit once tunnel gets connected.
+   * Queued messages other than DATA (channel control, ACKs and
+   * keepalives).  These are sent before any DATA.
    */
   struct CadetTunnelQueueEntry *tq_tail;
 
+  /**
+   * Queued DATA messages by channel.  Maps
+   * `struct GNUNET_CADET_ChannelTunnelNumber` to a `struct CadetTunnelFlow`.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap32 *flows;
+
+  /**
+   * DLL of flows with queued DATA messages, in round robin order.
+   */
+  struct CadetTunnelFlow *flow_head;
+
+  /**
+   * DLL of flows with queued DATA messages, in round robin order.
+   */
+  struct CadetTunnelFlow *flow_tail;
+
+  /**
+   * Congestion control state.
+   */
+  struct CadetTunnelCongestion cong;
+
+  /**
+   * Decrypted messages held back for reordering.
+   */
+  struct CadetTunnelHeldMessage *held_head;
+
+  /**
+   * Decrypted messages held back for reordering.
+   */
+  struct CadetTunnelHeldMessage *held_tail;
+
+  /**
+   * Task to release held messages once we stop waiting for
+   * the missing ones.
+   */
+  struct GNUNET_SCHEDULER_Task *reorder_task;
+
   /**
    * Identification of the connection from which we are currently processing
    * a message. Only valid (non-NULL) during #handle_decrypted() and the
@@ -436,10 +674,15 @@ struct CadetTunnel
   unsigned int unverified_attempts;
 
   /**
-   * Number of entries in the @e tq_head DLL.
+   * Number of queued messages (in @e tq_head and all flows).
    */
   unsigned int tq_len;
 
+  /**
+   * Number of entries in the @e held_head DLL.
+   */
+  unsigned int num_held;
+
   /**
    * State of the tunnel encryption.
    */
@@ -594,8 +837,31 @@ GCT_count_any_connections (const struct CadetTunnel *t)
 
 
 /**
- * Find first connection that is ready in the list of
- * our connections.  Picks ready connections round-robin.
+ * Estimate how long a message sent via @a ct now takes to arrive.
+ *
+ * @param ct connection to evaluate
+ * @return estimated delay in microseconds, 0 if we know nothing
+ *         about @a ct yet
+ */
+static uint64_t
+estimate_delay (struct CadetTConnection *ct)
+{
+  uint64_t delay;
+
+  /* half the RTT, plus the time to push the message through */
+  delay = GCC_get_metrics (ct->cc)->aged_latency.rel_value_us / 2;
+  if (0 != ct->throughput)
+    delay += STRIPE_NOMINAL_SIZE * 1000LL * 1000LL / ct->throughput;
+  return delay;
+}
+
+
+/**
+ * Find the ready connection to send the next message on.  We
+ * stripe across all ready connections, preferring the one where the
+ * message is expected to arrive first.  Connections that are so much
+ * slower than our fastest one (even if that one is busy) that the
+ * receiver would give up waiting for the message are not used.
  *
  * @param t tunnel to search
  * @return NULL if we have no connection that is ready
@@ -603,7 +869,48 @@ GCT_count_any_connections (const struct CadetTunnel *t)
 static struct CadetTConnection *
 get_ready_connection (struct CadetTunnel *t)
 {
-  return t->connection_ready_head;
+  struct CadetTConnection *best;
+  uint64_t best_delay;
+  uint64_t fastest;
+
+  if (NULL == t->connection_ready_head)
+    return NULL;
+  fastest = UINT64_MAX;
+  for (struct CadetTConnection *ct = t->connection_busy_head;
+       NULL != ct;
+       ct = ct->next)
+  {
+    uint64_t delay = estimate_delay (ct);
+
+    if (0 != delay)
+      fastest = GNUNET_MIN (fastest,
+                            delay);
+  }
+  best = NULL;
+  best_delay = UINT64_MAX;
+  for (struct CadetTConnection *ct = t->connection_ready_head;
+       NULL != ct;
+       ct = ct->next)
+  {
+    uint64_t delay = estimate_delay (ct);
+
+    if ( (NULL == best) ||
+         (delay < best_delay) )
+    {
+      best = ct;
+      best_delay = delay;
+    }
+  }
+  if ( (UINT64_MAX != fastest) &&
+       (best_delay > fastest + REORDER_TIMEOUT.rel_value_us) )
+  {
+    GNUNET_STATISTICS_update (stats,
+                              "# transmissions deferred to faster connection",
+                              1,
+                              GNUNET_NO);
+    return NULL;
+  }
+  return best;
 }
 
 
@@ -949,13 +1256,17 @@ delete_skipped_key (struct CadetTunnelAxolotl *ax,
  * @param dst Destination for the plaintext.
  * @param src Source of the message. Can overlap with @c dst.
  * @param size Size of the message.
+ * @param[out] HK set to the header key of the chain of the message
+ * @param[out] Kn set to the number of the message in its chain
  * @return Size of the decrypted data, -1 if an error was encountered.
  */
 static ssize_t
 try_old_ax_keys (struct CadetTunnelAxolotl *ax,
                  void *dst,
                  const struct GNUNET_CADET_TunnelEncryptedMessage *src,
-                 size_t size)
+                 size_t size,
+                 struct GNUNET_CRYPTO_SymmetricSessionKey *HK,
+                 uint32_t *Kn)
 {
   struct CadetTunnelSkippedKey *key;
   struct GNUNET_ShortHashCode *hmac;
@@ -1031,6 +1342,8 @@ try_old_ax_keys (struct CadetTunnelAxolotl *ax,
                                          &key->MK,
                                          &iv,
                                          dst);
+  *HK = key->HK;
+  *Kn = N;
   delete_skipped_key (ax,
                       key);
   return res;
@@ -1127,13 +1440,17 @@ store_ax_keys (struct CadetTunnelAxolotl *ax,
  * @param dst Destination for the plaintext.
  * @param src Source of the message. Can overlap with @c dst.
  * @param size Size of the message.
+ * @param[out] HK set to the header key of the chain of the message
+ * @param[out] Kn set to the number of the message in its chain
  * @return Size of the decrypted data, -1 if an error was encountered.
  */
 static ssize_t
 t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
                            void *dst,
                            const struct GNUNET_CADET_TunnelEncryptedMessage *src,
-                           size_t size)
+                           size_t size,
+                           struct GNUNET_CRYPTO_SymmetricSessionKey *HK,
+                           uint32_t *Kn)
 {
   struct GNUNET_ShortHashCode msg_hmac;
   struct GNUNET_HashCode hmac;
@@ -1155,7 +1472,7 @@ t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
   {
     static const char ctx[] = "axolotl ratchet";
     struct GNUNET_CRYPTO_SymmetricSessionKey keys[3]; /* RKp, NHKp, CKp */
-    struct GNUNET_CRYPTO_SymmetricSessionKey HK;
+    struct GNUNET_CRYPTO_SymmetricSessionKey old_HKr;
     struct GNUNET_HashCode dh;
     struct GNUNET_CRYPTO_EcdhePublicKey *DHRp;
 
@@ -1173,9 +1490,11 @@ t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
       return try_old_ax_keys (ax,
                               dst,
                               src,
-                              size);
+                              size,
+                              HK,
+                              Kn);
     }
-    HK = ax->HKr;
+    old_HKr = ax->HKr;
     ax->HKr = ax->NHKr;
     t_h_decrypt (ax,
                  src,
@@ -1184,7 +1503,7 @@ t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
     PNp = ntohl (plaintext_header.ax_header.PNs);
     DHRp = &plaintext_header.ax_header.DHRs;
     store_ax_keys (ax,
-                   &HK,
+                   &old_HKr,
                    PNp);
 
     /* RKp, NHKp, CKp = KDF (HMAC-HASH (RK, DH (DHRp, DHRs))) */
@@ -1224,7 +1543,9 @@ t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
     return try_old_ax_keys (ax,
                             dst,
                             src,
-                            size);
+                            size,
+                            HK,
+                            Kn);
   }
 
   t_ax_decrypt (ax,
@@ -1232,6 +1553,8 @@ t_ax_decrypt_and_validate (struct CadetTunnelAxolotl *ax,
                 &src[1],
                 esize);
   ax->Nr = Np + 1;
+  *HK = ax->HKr;
+  *Kn = Np;
   return esize;
 }
 
@@ -1969,15 +2292,40 @@ void
 GCT_connection_lost (struct CadetTConnection *ct)
 {
   struct CadetTunnel *t = ct->t;
+  struct CadetTunnelHeldMessage *hm;
+  struct CadetTunnelHeldMessage *hmn;
 
   if (GNUNET_YES == ct->is_ready)
+  {
     GNUNET_CONTAINER_DLL_remove (t->connection_ready_head,
                                  t->connection_ready_tail,
                                  ct);
+    t->num_ready_connections--;
+  }
   else
+  {
     GNUNET_CONTAINER_DLL_remove (t->connection_busy_head,
                                  t->connection_busy_tail,
                                  ct);
+    t->num_busy_connections--;
+  }
+  /* Messages held for reordering would need @a ct for delivery;
+     channels retransmit if they need to. */
+  for (hm = t->held_head; NULL != hm; hm = hmn)
+  {
+    hmn = hm->next;
+    if (hm->ct != ct)
+      continue;
+    GNUNET_CONTAINER_DLL_remove (t->held_head,
+                                 t->held_tail,
+                                 hm);
+    t->num_held--;
+    GNUNET_free (hm);
+    GNUNET_STATISTICS_update (stats,
+                              "# held messages discarded",
+                              1,
+                              GNUNET_NO);
+  }
   GNUNET_free (ct);
 }
 
@@ -2022,7 +2370,11 @@ destroy_tunnel (void *cls)
                            t);
   GNUNET_assert (NULL == t->connection_ready_head);
   GNUNET_assert (NULL == t->connection_busy_head);
-  while (NULL != (tq = t->tq_head))
+  while (NULL != (tq = (NULL != t->tq_head)
+                      ? t->tq_head
+                      : ( (NULL != t->flow_head)
+                          ? t->flow_head->tq_head
+                          : NULL)))
   {
     if (NULL != tq->cont)
       tq->cont (tq->cont_cls,
@@ -2032,6 +2384,14 @@ destroy_tunnel (void *cls)
   GCP_drop_tunnel (t->destination,
                    t);
   GNUNET_CONTAINER_multihashmap32_destroy (t->channels);
+  GNUNET_assert (0 == GNUNET_CONTAINER_multihashmap32_size (t->flows));
+  GNUNET_CONTAINER_multihashmap32_destroy (t->flows);
+  GNUNET_assert (NULL == t->held_head);
+  if (NULL != t->reorder_task)
+  {
+    GNUNET_SCHEDULER_cancel (t->reorder_task);
+    t->reorder_task = NULL;
+  }
   if (NULL != t->maintain_connections_task)
   {
     GNUNET_SCHEDULER_cancel (t->maintain_connections_task);
@@ -2136,21 +2496,297 @@ GCT_destroy_tunnel_now (struct CadetTunnel *t)
 }
 
 
+/**
+ * Remove @a tq from the queue it is in, freeing its flow if
+ * @a tq was the last message of the flow.
+ *
+ * @param tq queue entry to remove
+ */
+static void
+dequeue (struct CadetTunnelQueueEntry *tq)
+{
+  struct CadetTunnel *t = tq->t;
+  struct CadetTunnelFlow *flow = tq->flow;
+
+  GNUNET_assert (0 < t->tq_len);
+  t->tq_len--;
+  if (NULL == flow)
+  {
+    GNUNET_CONTAINER_DLL_remove (t->tq_head,
+                                 t->tq_tail,
+                                 tq);
+    return;
+  }
+  GNUNET_CONTAINER_DLL_remove (flow->tq_head,
+                               flow->tq_tail,
+                               tq);
+  flow->deficit -= GNUNET_MIN (flow->deficit,
+                               tq->size);
+  if (NULL != flow->tq_head)
+    return;
+  GNUNET_CONTAINER_DLL_remove (t->flow_head,
+                               t->flow_tail,
+                               flow);
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap32_remove (t->flows,
+                                                         ntohl (flow->ctn.cn),
+                                                         flow));
+  GNUNET_free (flow);
+}
+
+
+/**
+ * Pick the next message to transmit on @a t.  Messages in the
+ * control queue go first.  DATA is subject to the congestion window
+ * and to pacing, and the flows of the channels share the tunnel in
+ * deficit round robin.  If pacing holds back DATA, schedules the
+ * transmission for later.
+ *
+ * @param t tunnel to pick a message from
+ * @return NULL if there is nothing we may send right now
+ */
+static struct CadetTunnelQueueEntry *
+select_queue_entry (struct CadetTunnel *t)
+{
+  struct CadetTunnelFlow *flow;
+
+  if (NULL != t->tq_head)
+    return t->tq_head;
+  if (NULL == t->flow_head)
+    return NULL;
+  if (t->cong.in_flight >= (unsigned int) t->cong.cwnd)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Congestion window of %s full (%u in flight)\n",
+         GCT_2s (t),
+         t->cong.in_flight);
+    return NULL;
+  }
+  if (0 != GNUNET_TIME_absolute_get_remaining (t->cong.next_send).rel_value_us)
+  {
+    if (NULL == t->send_task)
+    {
+      GNUNET_STATISTICS_update (stats,
+                                "# DATA messages delayed by pacing",
+                                1,
+                                GNUNET_NO);
+      t->send_task
+        = GNUNET_SCHEDULER_add_at (t->cong.next_send,
+                                   &trigger_transmissions,
+                                   t);
+    }
+    return NULL;
+  }
+  while (1)
+  {
+    flow = t->flow_head;
+    if (flow->deficit >= flow->tq_head->size)
+      return flow->tq_head;
+    flow->deficit += FLOW_QUANTUM;
+    GNUNET_CONTAINER_DLL_remove (t->flow_head,
+                                 t->flow_tail,
+                                 flow);
+    GNUNET_CONTAINER_DLL_insert_tail (t->flow_head,
+                                      t->flow_tail,
+                                      flow);
+  }
+}
+
+
+/**
+ * We are sending a DATA message on @a t, compute when the next one
+ * may go.  We spread a window's worth of DATA over a bit less than
+ * one RTT.
+ *
+ * @param t tunnel we are sending DATA on
+ */
+static void
+pace (struct CadetTunnel *t)
+{
+  struct GNUNET_TIME_Relative interval;
+
+  if (0 == t->cong.srtt.rel_value_us)
+    return; /* no RTT estimate yet, do not pace */
+  interval.rel_value_us
+    = (uint64_t) (t->cong.srtt.rel_value_us * 0.8 / t->cong.cwnd);
+  t->cong.next_send
+    = GNUNET_TIME_absolute_add (GNUNET_TIME_absolute_max (t->cong.next_send,
+                                                          GNUNET_TIME_absolute_get ()),
+                                interval);
+}
+
+
+/**
+ * Report the congestion state of @a t to statistics, if the
+ * window changed.
+ *
+ * @param t tunnel to report on
+ */
+static void
+report_congestion (struct CadetTunnel *t)
+{
+  if ((unsigned int) t->cong.cwnd == t->cong.cwnd_reported)
+    return;
+  t->cong.cwnd_reported = (unsigned int) t->cong.cwnd;
+  GNUNET_STATISTICS_set (stats,
+                         "# tunnel congestion window",
+                         t->cong.cwnd_reported,
+                         GNUNET_NO);
+  GNUNET_STATISTICS_set (stats,
+                         "# tunnel smoothed RTT (us)",
+                         t->cong.srtt.rel_value_us,
+                         GNUNET_NO);
+}
+
+
+/**
+ * Window or in-flight count of @a t changed, try to send more
+ * DATA if we have some.
+ *
+ * @param t tunnel to check
+ */
+static void
+resume_data (struct CadetTunnel *t)
+{
+  if ( (NULL == t->flow_head) ||
+       (NULL != t->send_task) ||
+       (t->cong.in_flight >= (unsigned int) t->cong.cwnd) )
+    return;
+  t->send_task
+    = GNUNET_SCHEDULER_add_now (&trigger_transmissions,
+                                t);
+}
+
+
+/**
+ * A reliable DATA message was transmitted on @a t and now awaits
+ * its acknowledgement.
+ *
+ * @param t tunnel the message was sent on
+ */
+void
+GCT_congestion_sent (struct CadetTunnel *t)
+{
+  t->cong.in_flight++;
+}
+
+
+/**
+ * A reliable DATA message sent on @a t was acknowledged.  Adjusts
+ * the congestion window based on the queueing delay.
+ *
+ * @param t tunnel the message was sent on
+ * @param rtt round trip time of the message,
+ *        #GNUNET_TIME_UNIT_FOREVER_REL if the message was
+ *        retransmitted and thus gives no valid sample
+ */
+void
+GCT_congestion_acked (struct CadetTunnel *t,
+                      struct GNUNET_TIME_Relative rtt)
+{
+  struct CadetTunnelCongestion *cong = &t->cong;
+  struct GNUNET_TIME_Relative base;
+  uint64_t queueing;
+  double off_target;
+
+  GNUNET_assert (0 < cong->in_flight);
+  cong->in_flight--;
+  if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us != rtt.rel_value_us)
+  {
+    if (0 == GNUNET_TIME_absolute_get_remaining (cong->base_rollover).rel_value_us)
+    {
+      cong->base_prev = cong->base_cur;
+      cong->base_cur = GNUNET_TIME_UNIT_FOREVER_REL;
+      cong->base_rollover = GNUNET_TIME_relative_to_absolute (CC_BASE_PERIOD);
+    }
+    cong->base_cur = GNUNET_TIME_relative_min (cong->base_cur,
+                                               rtt);
+    base = GNUNET_TIME_relative_min (cong->base_cur,
+                                     cong->base_prev);
+    if (0 == cong->srtt.rel_value_us)
+      cong->srtt = rtt;
+    else
+      cong->srtt.rel_value_us
+        = (7 * cong->srtt.rel_value_us + rtt.rel_value_us) / 8;
+    queueing = rtt.rel_value_us - base.rel_value_us;
+    if ( (cong->cwnd < cong->ssthresh) &&
+         (queueing < CC_TARGET_DELAY.rel_value_us / 2) )
+    {
+      /* slow start */
+      cong->cwnd += 1.0;
+    }
+    else
+    {
+      if (cong->cwnd < cong->ssthresh)
+        cong->ssthresh = cong->cwnd;
+      off_target = ((double) CC_TARGET_DELAY.rel_value_us - queueing)
+        / CC_TARGET_DELAY.rel_value_us;
+      if (off_target < -1.0)
+        off_target = -1.0;
+      cong->cwnd += off_target / cong->cwnd;
+    }
+    cong->cwnd = GNUNET_MAX (cong->cwnd,
+                             CC_MIN_WINDOW);
+    cong->cwnd = GNUNET_MIN (cong->cwnd,
+                             CC_MAX_WINDOW);
+    report_congestion (t);
+  }
+  resume_data (t);
+}
+
+
+/**
+ * A reliable DATA message sent on @a t is no longer in flight
+ * without having been acknowledged.
+ *
+ * @param t tunnel the message was sent on
+ * @param congestion #GNUNET_YES if the message is considered lost
+ *        (and will be retransmitted), #GNUNET_NO if the channel
+ *        just gave up on it
+ */
+void
+GCT_congestion_lost (struct CadetTunnel *t,
+                     int congestion)
+{
+  struct CadetTunnelCongestion *cong = &t->cong;
+
+  GNUNET_assert (0 < cong->in_flight);
+  cong->in_flight--;
+  if ( (GNUNET_YES == congestion) &&
+       (GNUNET_TIME_absolute_get_duration (cong->last_reduction).rel_value_us
+        > cong->srtt.rel_value_us) )
+  {
+    /* at most one reduction per RTT */
+    cong->cwnd = GNUNET_MAX (cong->cwnd / 2,
+                             CC_MIN_WINDOW);
+    cong->ssthresh = cong->cwnd;
+    cong->last_reduction = GNUNET_TIME_absolute_get ();
+    GNUNET_STATISTICS_update (stats,
+                              "# congestion window reductions",
+                              1,
+                              GNUNET_NO);
+    report_congestion (t);
+  }
+  resume_data (t);
+}
+
+
 /**
  * Send normal payload from queue in @a t via connection @a ct.
  * Does nothing if our payload queue is empty.
  *
  * @param t tunnel to send data from
  * @param ct connection to use for transmission (is ready)
+ * @return #GNUNET_YES if we sent a message
  */
-static void
+static int
 try_send_normal_payload (struct CadetTunnel *t,
                          struct CadetTConnection *ct)
 {
   struct CadetTunnelQueueEntry *tq;
 
   GNUNET_assert (GNUNET_YES == ct->is_ready);
-  tq = t->tq_head;
+  tq = select_queue_entry (t);
   if (NULL == tq)
   {
     /* no messages pending right now */
@@ -2158,16 +2794,18 @@ try_send_normal_payload (struct CadetTunnel *t,
          "Not sending payload of %s on ready %s (nothing pending)\n",
          GCT_2s (t),
          GCC_2s (ct->cc));
-    return;
+    return GNUNET_NO;
   }
   /* ready to send message 'tq' on tunnel 'ct' */
   GNUNET_assert (t == tq->t);
-  GNUNET_CONTAINER_DLL_remove (t->tq_head,
-                               t->tq_tail,
-                               tq);
+  if (NULL != tq->flow)
+    pace (t);
+  dequeue (tq);
   if (NULL != tq->cid)
     *tq->cid = *GCC_get_id (ct->cc);
   mark_connection_unready (ct);
+  ct->busy_since = GNUNET_TIME_absolute_get ();
+  ct->busy_size = tq->size + sizeof (struct GNUNET_CADET_TunnelEncryptedMessage);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Sending payload of %s on %s\n",
        GCT_2s (t),
@@ -2178,6 +2816,25 @@ try_send_normal_payload (struct CadetTunnel *t,
     tq->cont (tq->cont_cls,
               GCC_get_id (ct->cc));
   GNUNET_free (tq);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Send as many queued messages as we have ready connections for,
+ * striping them across the connections.
+ *
+ * @param t tunnel to send messages on
+ */
+static void
+send_queued (struct CadetTunnel *t)
+{
+  struct CadetTConnection *ct;
+
+  while ( (NULL != (ct = get_ready_connection (t))) &&
+          (GNUNET_YES == try_send_normal_payload (t,
+                                                  ct)) )
+    ;
 }
 
 
@@ -2206,6 +2863,22 @@ connection_ready_cb (void *cls,
     return;
   }
   GNUNET_assert (GNUNET_NO == ct->is_ready);
+  if (0 != ct->busy_since.abs_value_us)
+  {
+    uint64_t elapsed;
+    uint32_t sample;
+
+    /* the connection took 'elapsed' to accept our last message */
+    elapsed = GNUNET_MAX (1,
+                          GNUNET_TIME_absolute_get_duration (ct->busy_since).rel_value_us);
+    sample = (uint32_t) GNUNET_MIN ((uint64_t) UINT32_MAX,
+                                    ct->busy_size * 1000LL * 1000LL / elapsed);
+    if (0 == ct->throughput)
+      ct->throughput = sample;
+    else
+      ct->throughput = (uint32_t) ((7LL * ct->throughput + sample) / 8);
+    ct->busy_since = GNUNET_TIME_UNIT_ZERO_ABS;
+  }
   GNUNET_CONTAINER_DLL_remove (t->connection_busy_head,
                                t->connection_busy_tail,
                                ct);
@@ -2264,8 +2937,7 @@ connection_ready_cb (void *cls,
                     GNUNET_NO);
       return;
     }
-    try_send_normal_payload (t,
-                             ct);
+    send_queued (t);
     break;
   }
 }
@@ -2283,16 +2955,12 @@ static void
 trigger_transmissions (void *cls)
 {
   struct CadetTunnel *t = cls;
-  struct CadetTConnection *ct;
 
   t->send_task = NULL;
-  if (NULL == t->tq_head)
+  if ( (NULL == t->tq_head) &&
+       (NULL == t->flow_head) )
     return; /* no messages pending right now */
-  ct = get_ready_connection (t);
-  if (NULL == ct)
-    return; /* no connections ready */
-  try_send_normal_payload (t,
-                           ct);
+  send_queued (t);
 }
 
 
@@ -2449,7 +3117,7 @@ consider_path_cb (void *cls,
   /* We iterate by increasing path length; if we have enough paths and
      this one is more than twice as long than what we are currently
      using, then ignore all of these super-long ones! */
-  if ( (GCT_count_any_connections (t) > DESIRED_CONNECTIONS_PER_TUNNEL) &&
+  if ( (GCT_count_any_connections (t) > desired_connections) &&
        (es.min_length * 2 < off) &&
        (es.max_length < off) )
   {
@@ -2459,7 +3127,7 @@ consider_path_cb (void *cls,
     return GNUNET_NO;
   }
   /* If we have enough paths and this one looks no better, ignore it. */
-  if ( (GCT_count_any_connections (t) >= DESIRED_CONNECTIONS_PER_TUNNEL) &&
+  if ( (GCT_count_any_connections (t) >= desired_connections) &&
        (es.min_length < GCPP_get_length (path)) &&
        (es.min_desire > GCPP_get_desirability (path)) &&
        (es.max_length < off) )
@@ -2510,7 +3178,7 @@ consider_path_cb (void *cls,
  * Basically, needs to check if there are connections that perform
  * badly, and if so eventually kill them and trigger a replacement.
  * The strategy is to open one more connection than
- * #DESIRED_CONNECTIONS_PER_TUNNEL, and then periodically kick out the
+ * #desired_connections, and then periodically kick out the
  * least-performing one, and then inquire for new ones.
  *
  * @param cls the `struct CadetTunnel`
@@ -2538,7 +3206,7 @@ maintain_connections_cb (void *cls)
                            &evaluate_connection,
                            &es);
   if ( (NULL != es.worst) &&
-       (GCT_count_any_connections (t) > DESIRED_CONNECTIONS_PER_TUNNEL) )
+       (GCT_count_any_connections (t) > desired_connections) )
   {
     /* Clear out worst-performing connection 'es.worst'. */
     destroy_t_connection (t,
@@ -2660,6 +3328,29 @@ handle_plaintext_data (void *cls,
 }
 
 
+/**
+ * Check that @a ack is well-formed.
+ *
+ * @param cls the `struct CadetTunnel` for which we decrypted the message
+ * @param ack the message we received on the tunnel
+ * @return #GNUNET_OK if @a ack is followed by a sane number of SACK ranges
+ */
+static int
+check_plaintext_data_ack (void *cls,
+                          const struct GNUNET_CADET_ChannelDataAckMessage *ack)
+{
+  uint16_t size = ntohs (ack->header.size) - sizeof (*ack);
+
+  if ( (0 != (size % sizeof (struct GNUNET_CADET_ChannelSackRange))) ||
+       (size / sizeof (struct GNUNET_CADET_ChannelSackRange) > GCCH_MAX_SACK_RANGES) )
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
 /**
  * We received an acknowledgement for data we sent on a channel.
  * Locate the channel and process it, or return an error if the
@@ -2728,7 +3419,8 @@ handle_plaintext_channel_open (void *cls,
   ch = GCCH_channel_incoming_new (t,
                                   copen->ctn,
                                   &copen->port,
-                                  ntohl (copen->opt));
+                                  ntohl (copen->opt),
+                                  ntohl (copen->window));
   if (NULL != t->destroy_task)
   {
     GNUNET_SCHEDULER_cancel (t->destroy_task);
@@ -2759,7 +3451,7 @@ GCT_send_channel_destroy (struct CadetTunnel *t,
        ntohl (ctn.cn));
   msg.header.size = htons (sizeof (msg));
   msg.header.type = htons (GNUNET_MESSAGE_TYPE_CADET_CHANNEL_DESTROY);
-  msg.reserved = htonl (0);
+  msg.window = htonl (0);
   msg.ctn = ctn;
   GCT_send (t,
             &msg.header,
@@ -2801,7 +3493,8 @@ handle_plaintext_channel_open_ack (void *cls,
        GCCH_2s (ch),
        GCT_2s (t));
   GCCH_handle_channel_open_ack (ch,
-                                GCC_get_id (t->current_ct->cc));
+                                GCC_get_id (t->current_ct->cc),
+                                ntohl (cm->window));
 }
 
 
@@ -2895,10 +3588,10 @@ GCT_create_tunnel (struct CadetPeer *destination)
                            GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA,
                            struct GNUNET_CADET_ChannelAppDataMessage,
                            t),
-    GNUNET_MQ_hd_fixed_size (plaintext_data_ack,
-                             GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA_ACK,
-                             struct GNUNET_CADET_ChannelDataAckMessage,
-                             t),
+    GNUNET_MQ_hd_var_size (plaintext_data_ack,
+                           GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA_ACK,
+                           struct GNUNET_CADET_ChannelDataAckMessage,
+                           t),
     GNUNET_MQ_hd_fixed_size (plaintext_channel_open,
                              GNUNET_MESSAGE_TYPE_CADET_CHANNEL_OPEN,
                              struct GNUNET_CADET_ChannelOpenMessage,
@@ -2920,6 +3613,12 @@ GCT_create_tunnel (struct CadetPeer *destination)
                  GNUNET_CRYPTO_ecdhe_key_create2 (&t->ax.kx_0));
   t->destination = destination;
   t->channels = GNUNET_CONTAINER_multihashmap32_create (8);
+  t->flows = GNUNET_CONTAINER_multihashmap32_create (8);
+  t->cong.cwnd = CC_INITIAL_WINDOW;
+  t->cong.ssthresh = CC_MAX_WINDOW;
+  t->cong.base_cur = GNUNET_TIME_UNIT_FOREVER_REL;
+  t->cong.base_prev = GNUNET_TIME_UNIT_FOREVER_REL;
+  t->cong.base_rollover = GNUNET_TIME_relative_to_absolute (CC_BASE_PERIOD);
   t->maintain_connections_task
     = GNUNET_SCHEDULER_add_now (&maintain_connections_cb,
                                 t);
@@ -2989,6 +3688,188 @@ GCT_add_inbound_connection (struct CadetTunnel *t,
 }
 
 
+/**
+ * Pass decrypted data to the message dispatcher.
+ *
+ * @param t tunnel the data was received on
+ * @param ct connection the data was received on
+ * @param buf plaintext
+ * @param size number of bytes in @a buf
+ */
+static void
+deliver_decrypted (struct CadetTunnel *t,
+                   struct CadetTConnection *ct,
+                   const char *buf,
+                   size_t size)
+{
+  /* The MST will ultimately call #handle_decrypted() on each message. */
+  t->current_ct = ct;
+  GNUNET_break_op (GNUNET_OK ==
+                   GNUNET_MST_from_buffer (t->mst,
+                                           buf,
+                                           size,
+                                           GNUNET_YES,
+                                           GNUNET_NO));
+  t->current_ct = NULL;
+}
+
+
+/**
+ * Check if a message sent before message @a Kn of the chain with
+ * header key @a HK is missing, and we are still willing to wait for
+ * it.  Missing messages are those for which we stored a skipped key.
+ *
+ * @param t tunnel to check
+ * @param HK header key of the chain
+ * @param Kn number of the message in the chain
+ * @return skipped key of the oldest such missing message, NULL if
+ *         there is none
+ */
+static struct CadetTunnelSkippedKey *
+find_gap (struct CadetTunnel *t,
+          const struct GNUNET_CRYPTO_SymmetricSessionKey *HK,
+          uint32_t Kn)
+{
+  struct CadetTunnelSkippedKey *gap = NULL;
+
+  for (struct CadetTunnelSkippedKey *key = t->ax.skipped_head;
+       NULL != key;
+       key = key->next)
+  {
+    if ( (key->Kn >= Kn) ||
+         (GNUNET_TIME_absolute_get_duration (key->timestamp).rel_value_us
+          >= REORDER_TIMEOUT.rel_value_us) ||
+         (0 != memcmp (&key->HK,
+                       HK,
+                       sizeof (*HK))) )
+      continue;
+    if ( (NULL == gap) ||
+         (key->timestamp.abs_value_us < gap->timestamp.abs_value_us) )
+      gap = key;
+  }
+  return gap;
+}
+
+
+/**
+ * Deliver all held messages that no longer wait for missing ones.
+ * If some remain, schedule #reorder_timeout for when we give up on
+ * the oldest missing message.
+ *
+ * @param t tunnel to process
+ */
+static void
+release_held (struct CadetTunnel *t);
+
+
+/**
+ * We waited long enough for missing messages, deliver what we have.
+ *
+ * @param cls the `struct CadetTunnel`
+ */
+static void
+reorder_timeout (void *cls)
+{
+  struct CadetTunnel *t = cls;
+
+  t->reorder_task = NULL;
+  release_held (t);
+}
+
+
+static void
+release_held (struct CadetTunnel *t)
+{
+  struct CadetTunnelHeldMessage *hm;
+  struct CadetTunnelHeldMessage *hmn;
+  struct CadetTunnelSkippedKey *gap;
+  struct GNUNET_TIME_Absolute give_up;
+
+  give_up = GNUNET_TIME_UNIT_FOREVER_ABS;
+  for (hm = t->held_head; NULL != hm; hm = hmn)
+  {
+    hmn = hm->next;
+    gap = find_gap (t,
+                    &hm->HK,
+                    hm->Kn);
+    if (NULL != gap)
+    {
+      give_up = GNUNET_TIME_absolute_min (give_up,
+                                          GNUNET_TIME_absolute_add (gap->timestamp,
+                                                                    REORDER_TIMEOUT));
+      continue;
+    }
+    GNUNET_CONTAINER_DLL_remove (t->held_head,
+                                 t->held_tail,
+                                 hm);
+    t->num_held--;
+    deliver_decrypted (t,
+                       hm->ct,
+                       (const char *) &hm[1],
+                       hm->size);
+    GNUNET_free (hm);
+  }
+  if (NULL != t->reorder_task)
+  {
+    GNUNET_SCHEDULER_cancel (t->reorder_task);
+    t->reorder_task = NULL;
+  }
+  if (NULL != t->held_head)
+    t->reorder_task = GNUNET_SCHEDULER_add_at (give_up,
+                                               &reorder_timeout,
+                                               t);
+}
+
+
+/**
+ * Hold back a decrypted message until the messages sent before it
+ * arrived, or until we gave up on them.
+ *
+ * @param t tunnel the message was received on
+ * @param ct connection the message was received on
+ * @param HK header key of the chain of the message
+ * @param Kn number of the message in its chain
+ * @param buf plaintext
+ * @param size number of bytes in @a buf
+ */
+static void
+hold_message (struct CadetTunnel *t,
+              struct CadetTConnection *ct,
+              const struct GNUNET_CRYPTO_SymmetricSessionKey *HK,
+              uint32_t Kn,
+              const char *buf,
+              size_t size)
+{
+  struct CadetTunnelHeldMessage *hm;
+  struct CadetTunnelHeldMessage *pos;
+
+  GNUNET_STATISTICS_update (stats,
+                            "# messages held for reordering",
+                            1,
+                            GNUNET_NO);
+  hm = GNUNET_malloc (sizeof (*hm) + size);
+  hm->ct = ct;
+  hm->HK = *HK;
+  hm->Kn = Kn;
+  hm->size = size;
+  GNUNET_memcpy (&hm[1],
+                 buf,
+                 size);
+  for (pos = t->held_tail; NULL != pos; pos = pos->prev)
+    if (pos->Kn < Kn)
+      break;
+  GNUNET_CONTAINER_DLL_insert_after (t->held_head,
+                                     t->held_tail,
+                                     pos,
+                                     hm);
+  t->num_held++;
+  if (NULL == t->reorder_task)
+    t->reorder_task = GNUNET_SCHEDULER_add_delayed (REORDER_TIMEOUT,
+                                                    &reorder_timeout,
+                                                    t);
+}
+
+
 /**
  * Handle encrypted message.
  *
@@ -3003,6 +3884,9 @@ GCT_handle_encrypted (struct CadetTConnection *ct,
   uint16_t size = ntohs (msg->header.size);
   char cbuf [size] GNUNET_ALIGN;
   ssize_t decrypted_size;
+  struct GNUNET_CRYPTO_SymmetricSessionKey HK;
+  uint32_t Kn;
+  int reorder;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "%s received %u bytes of encrypted data in state %d\n",
@@ -3076,6 +3960,7 @@ GCT_handle_encrypted (struct CadetTConnection *ct,
                             1,
                             GNUNET_NO);
   decrypted_size = -1;
+  reorder = GNUNET_NO;
   if (CADET_TUNNEL_KEY_OK == t->estate)
   {
     /* We have well-established key material available,
@@ -3083,7 +3968,10 @@ GCT_handle_encrypted (struct CadetTConnection *ct,
     decrypted_size = t_ax_decrypt_and_validate (&t->ax,
                                                 cbuf,
                                                 msg,
-                                                size);
+                                                size,
+                                                &HK,
+                                                &Kn);
+    reorder = (-1 != decrypted_size);
   }
 
   if ( (-1 == decrypted_size) &&
@@ -3095,7 +3983,9 @@ GCT_handle_encrypted (struct CadetTConnection *ct,
     decrypted_size = t_ax_decrypt_and_validate (t->unverified_ax,
                                                 cbuf,
                                                 msg,
-                                                size);
+                                                size,
+                                                &HK,
+                                                &Kn);
     if (-1 != decrypted_size)
     {
       /* It worked! Treat this as authentication of the AX data! */
@@ -3156,15 +4046,27 @@ GCT_handle_encrypted (struct CadetTConnection *ct,
     return;
   }
 
-  /* The MST will ultimately call #handle_decrypted() on each message. */
-  t->current_ct = ct;
-  GNUNET_break_op (GNUNET_OK ==
-                   GNUNET_MST_from_buffer (t->mst,
-                                           cbuf,
-                                           decrypted_size,
-                                           GNUNET_YES,
-                                           GNUNET_NO));
-  t->current_ct = NULL;
+  if ( (GNUNET_YES == reorder) &&
+       (1 < GCT_count_any_connections (t)) &&
+       (t->num_held < MAX_SKIPPED_KEYS) &&
+       (NULL != find_gap (t,
+                          &HK,
+                          Kn)) )
+  {
+    hold_message (t,
+                  ct,
+                  &HK,
+                  Kn,
+                  cbuf,
+                  decrypted_size);
+    return;
+  }
+  deliver_decrypted (t,
+                     ct,
+                     cbuf,
+                     decrypted_size);
+  if (NULL != t->held_head)
+    release_held (t);
 }
 
 
@@ -3227,9 +4129,40 @@ GCT_send (struct CadetTunnel *t,
   tq->cid = &ax_msg->cid; /* will initialize 'ax_msg->cid' once we know the connection */
   tq->cont = cont;
   tq->cont_cls = cont_cls;
-  GNUNET_CONTAINER_DLL_insert_tail (t->tq_head,
-                                    t->tq_tail,
-                                    tq);
+  tq->size = payload_size;
+  t->tq_len++;
+  if (GNUNET_MESSAGE_TYPE_CADET_CHANNEL_APP_DATA == ntohs (message->type))
+  {
+    const struct GNUNET_CADET_ChannelAppDataMessage *dm
+      = (const struct GNUNET_CADET_ChannelAppDataMessage *) message;
+    struct CadetTunnelFlow *flow;
+
+    flow = GNUNET_CONTAINER_multihashmap32_get (t->flows,
+                                                ntohl (dm->ctn.cn));
+    if (NULL == flow)
+    {
+      flow = GNUNET_new (struct CadetTunnelFlow);
+      flow->ctn = dm->ctn;
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_CONTAINER_multihashmap32_put (t->flows,
+                                                          ntohl (dm->ctn.cn),
+                                                          flow,
+                                                          GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+      GNUNET_CONTAINER_DLL_insert_tail (t->flow_head,
+                                        t->flow_tail,
+                                        flow);
+    }
+    tq->flow = flow;
+    GNUNET_CONTAINER_DLL_insert_tail (flow->tq_head,
+                                      flow->tq_tail,
+                                      tq);
+  }
+  else
+  {
+    GNUNET_CONTAINER_DLL_insert_tail (t->tq_head,
+                                      t->tq_tail,
+                                      tq);
+  }
   if (NULL != t->send_task)
     GNUNET_SCHEDULER_cancel (t->send_task);
   t->send_task
@@ -3251,11 +4184,7 @@ GCT_send (struct CadetTunnel *t,
 void
 GCT_send_cancel (struct CadetTunnelQueueEntry *tq)
 {
-  struct CadetTunnel *t = tq->t;
-
-  GNUNET_CONTAINER_DLL_remove (t->tq_head,
-                               t->tq_tail,
-                               tq);
+  dequeue (tq);
   GNUNET_MQ_discard (tq->env);
   GNUNET_free (tq);
 }
@@ -3404,6 +4333,12 @@ GCT_debug (const struct CadetTunnel *t,
         estate2s (t->estate),
         t->tq_len,
         GCT_count_any_connections (t));
+  LOG2 (level,
+        "TTT cwnd: %.1f in flight: %u srtt: %s\n",
+        t->cong.cwnd,
+        t->cong.in_flight,
+        GNUNET_STRINGS_relative_time_to_string (t->cong.srtt,
+                                                GNUNET_YES));
   LOG2 (level,
         "TTT channels:\n");
   GNUNET_CONTAINER_multihashmap32_iterate (t->channels,
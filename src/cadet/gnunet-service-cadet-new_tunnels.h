@@ -32,12 +32,6 @@
 #include "cadet_protocol.h"
 
 
-/**
- * How many connections would we like to have per tunnel?
- */
-#define DESIRED_CONNECTIONS_PER_TUNNEL 3
-
-
 /**
  * All the encryption states a tunnel can be in.
  */
@@ -244,6 +238,44 @@ void
 GCT_send_cancel (struct CadetTunnelQueueEntry *q);
 
 
+/**
+ * A reliable DATA message was transmitted on @a t and now awaits
+ * its acknowledgement.
+ *
+ * @param t tunnel the message was sent on
+ */
+void
+GCT_congestion_sent (struct CadetTunnel *t);
+
+
+/**
+ * A reliable DATA message sent on @a t was acknowledged.  Adjusts
+ * the congestion window based on the queueing delay.
+ *
+ * @param t tunnel the message was sent on
+ * @param rtt round trip time of the message,
+ *        #GNUNET_TIME_UNIT_FOREVER_REL if the message was
+ *        retransmitted and thus gives no valid sample
+ */
+void
+GCT_congestion_acked (struct CadetTunnel *t,
+                      struct GNUNET_TIME_Relative rtt);
+
+
+/**
+ * A reliable DATA message sent on @a t is no longer in flight
+ * without having been acknowledged.
+ *
+ * @param t tunnel the message was sent on
+ * @param congestion #GNUNET_YES if the message is considered lost
+ *        (and will be retransmitted), #GNUNET_NO if the channel
+ *        just gave up on it
+ */
+void
+GCT_congestion_lost (struct CadetTunnel *t,
+                     int congestion);
+
+
 /**
  * Return the number of channels using a tunnel.
  *
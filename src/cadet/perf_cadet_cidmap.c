@@ -0,0 +1,176 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file cadet/perf_cadet_cidmap.c
+ * @brief measure the connection lookups a relay does for each
+ *        forwarded message, with the flat connection table and
+ *        with a multishortmap
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet-service-cadet-new_cidmap.h"
+#include <gauger.h>
+
+/**
+ * Number of connections the relay carries.
+ */
+#define NUM_CONNECTIONS (1024 * 64)
+
+/**
+ * Number of lookups to measure.
+ */
+#define NUM_LOOKUPS (1024 * 1024 * 8)
+
+/**
+ * Connection identifiers.
+ */
+static struct GNUNET_CADET_ConnectionTunnelIdentifier *cids;
+
+/**
+ * Order in which the connections are looked up.
+ */
+static uint32_t *order;
+
+
+/**
+ * Measure lookups in the flat connection table.
+ *
+ * @return lookups per second, 0 on error
+ */
+static unsigned long long
+measure_cidmap ()
+{
+  struct CadetCidMap *map;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative delta;
+
+  map = GCCM_create (16);
+  for (unsigned int i=0;i<NUM_CONNECTIONS;i++)
+    GNUNET_assert (GNUNET_OK ==
+                   GCCM_put (map,
+                             &cids[i],
+                             &cids[i]));
+  start = GNUNET_TIME_absolute_get ();
+  for (unsigned int i=0;i<NUM_LOOKUPS;i++)
+  {
+    const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid
+      = &cids[order[i % NUM_CONNECTIONS]];
+
+    if (cid != GCCM_get (map,
+                         cid))
+    {
+      GNUNET_break (0);
+      GCCM_destroy (map);
+      return 0;
+    }
+  }
+  delta = GNUNET_TIME_absolute_get_duration (start);
+  for (unsigned int i=0;i<NUM_CONNECTIONS;i++)
+    GNUNET_assert (GNUNET_YES ==
+                   GCCM_remove (map,
+                                &cids[i],
+                                &cids[i]));
+  GNUNET_assert (0 == GCCM_size (map));
+  GCCM_destroy (map);
+  return (1000LL * 1000LL * NUM_LOOKUPS)
+    / GNUNET_MAX (1, delta.rel_value_us);
+}
+
+
+/**
+ * Measure lookups in a multishortmap, as used before.
+ *
+ * @return lookups per second, 0 on error
+ */
+static unsigned long long
+measure_multishortmap ()
+{
+  struct GNUNET_CONTAINER_MultiShortmap *map;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative delta;
+
+  map = GNUNET_CONTAINER_multishortmap_create (16,
+                                               GNUNET_YES);
+  for (unsigned int i=0;i<NUM_CONNECTIONS;i++)
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multishortmap_put (map,
+                                                       &cids[i].connection_of_tunnel,
+                                                       &cids[i],
+                                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  start = GNUNET_TIME_absolute_get ();
+  for (unsigned int i=0;i<NUM_LOOKUPS;i++)
+  {
+    const struct GNUNET_CADET_ConnectionTunnelIdentifier *cid
+      = &cids[order[i % NUM_CONNECTIONS]];
+
+    if (cid != GNUNET_CONTAINER_multishortmap_get (map,
+                                                   &cid->connection_of_tunnel))
+    {
+      GNUNET_break (0);
+      GNUNET_CONTAINER_multishortmap_destroy (map);
+      return 0;
+    }
+  }
+  delta = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_CONTAINER_multishortmap_destroy (map);
+  return (1000LL * 1000LL * NUM_LOOKUPS)
+    / GNUNET_MAX (1, delta.rel_value_us);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned long long flat;
+  unsigned long long shortmap;
+
+  GNUNET_log_setup ("perf-cadet-cidmap",
+                    "WARNING",
+                    NULL);
+  cids = GNUNET_new_array (NUM_CONNECTIONS,
+                           struct GNUNET_CADET_ConnectionTunnelIdentifier);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              cids,
+                              NUM_CONNECTIONS * sizeof (struct GNUNET_CADET_ConnectionTunnelIdentifier));
+  order = GNUNET_CRYPTO_random_permute (GNUNET_CRYPTO_QUALITY_WEAK,
+                                        NUM_CONNECTIONS);
+  flat = measure_cidmap ();
+  shortmap = measure_multishortmap ();
+  GNUNET_free (order);
+  GNUNET_free (cids);
+  if ( (0 == flat) ||
+       (0 == shortmap) )
+    return 1;
+  FPRINTF (stderr,
+           "Flat table: %llu lookups/s, multishortmap: %llu lookups/s\n",
+           flat,
+           shortmap);
+  GAUGER ("CADET",
+          "Connection lookups (flat table)",
+          flat / 1000,
+          "kilo-lookups/s");
+  GAUGER ("CADET",
+          "Connection lookups (multishortmap)",
+          shortmap / 1000,
+          "kilo-lookups/s");
+  return 0;
+}
+
+/* end of perf_cadet_cidmap.c */
@@ -0,0 +1,635 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file cadet/perf_cadet_mixed_new.c
+ * @brief measure the latency of an interactive channel while a bulk
+ *        channel saturates the same tunnel
+ *
+ * Peer 0 opens two reliable channels to the last peer: one that
+ * sends #BULK_MESSAGES as fast as CADET accepts them, and one that
+ * sends a PING every #PING_PERIOD, which is echoed back.  We report
+ * the bulk throughput, the PING round trip times and the congestion
+ * window and RTT estimate of the tunnel.
+ */
+#include "platform.h"
+#include "cadet_test_lib_new.h"
+#include "gnunet_cadet_service.h"
+#include "gnunet_statistics_service.h"
+#include <gauger.h>
+
+#define PING 1
+#define PONG 2
+#define BULK 3
+
+/**
+ * How many bulk messages do we send?
+ */
+#define BULK_MESSAGES 4096
+
+/**
+ * Payload size of a bulk message.
+ */
+#define BULK_SIZE 1024
+
+/**
+ * How often do we PING?
+ */
+#define PING_PERIOD GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 100)
+
+/**
+ * How long until we give up?
+ */
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 120)
+
+
+/**
+ * Message for PING and PONG.
+ */
+struct PingMessage
+{
+  /**
+   * Header. Type PING/PONG.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Time the PING was sent.
+   */
+  struct GNUNET_TIME_AbsoluteNBO timestamp;
+};
+
+
+/**
+ * Number of peers in the line.
+ */
+static unsigned int peers_requested = 2;
+
+/**
+ * Test context (to shut down).
+ */
+static struct GNUNET_CADET_TEST_Context *test_ctx;
+
+/**
+ * Testbed peers.
+ */
+static struct GNUNET_TESTBED_Peer **testbed_peers;
+
+/**
+ * Operation to get the identity of the last peer.
+ */
+static struct GNUNET_TESTBED_Operation *id_op;
+
+/**
+ * Operation to get the statistics.
+ */
+static struct GNUNET_TESTBED_Operation *stats_op;
+
+/**
+ * CADET handle of peer 0.
+ */
+static struct GNUNET_CADET_Handle *h1;
+
+/**
+ * Channel for bulk data.
+ */
+static struct GNUNET_CADET_Channel *bulk_ch;
+
+/**
+ * Channel for PINGs.
+ */
+static struct GNUNET_CADET_Channel *ping_ch;
+
+/**
+ * Port for bulk data.
+ */
+static struct GNUNET_HashCode bulk_port;
+
+/**
+ * Port for PINGs.
+ */
+static struct GNUNET_HashCode ping_port;
+
+/**
+ * Task to send the next PING.
+ */
+static struct GNUNET_SCHEDULER_Task *ping_task;
+
+/**
+ * Task to abort the test.
+ */
+static struct GNUNET_SCHEDULER_Task *timeout_task;
+
+/**
+ * When did we start sending bulk data?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * How long did the bulk transfer take?
+ */
+static struct GNUNET_TIME_Relative bulk_time;
+
+/**
+ * Number of bulk messages sent.
+ */
+static unsigned int bulk_sent;
+
+/**
+ * Number of bulk messages received.
+ */
+static unsigned int bulk_received;
+
+/**
+ * Number of PONGs received.
+ */
+static unsigned int pongs;
+
+/**
+ * Sum of the PING round trip times, in microseconds.
+ */
+static uint64_t rtt_sum;
+
+/**
+ * Largest PING round trip time, in microseconds.
+ */
+static uint64_t rtt_max;
+
+/**
+ * Congestion window reported by peer 0.
+ */
+static uint64_t cwnd;
+
+/**
+ * Smoothed RTT of the tunnel reported by peer 0.
+ */
+static uint64_t srtt;
+
+/**
+ * Result of the test, 0 on success.
+ */
+static int ret = 1;
+
+
+/**
+ * Show the results and log them to GAUGER.
+ */
+static void
+show_end_data (void)
+{
+  double throughput;
+  uint64_t rtt_mean;
+
+  throughput = BULK_MESSAGES * 1000.0 * 1000.0
+    / GNUNET_MAX (1, bulk_time.rel_value_us);
+  rtt_mean = rtt_sum / GNUNET_MAX (1, pongs);
+  FPRINTF (stderr,
+           "Bulk: %.2f messages/s, PING: %u, mean RTT %llu us, max RTT %llu us\n",
+           throughput,
+           pongs,
+           (unsigned long long) rtt_mean,
+           (unsigned long long) rtt_max);
+  FPRINTF (stderr,
+           "Tunnel: congestion window %llu, smoothed RTT %llu us\n",
+           (unsigned long long) cwnd,
+           (unsigned long long) srtt);
+  GAUGER ("CADET",
+          "Bulk throughput with interactive channel",
+          throughput,
+          "packets/s");
+  GAUGER ("CADET",
+          "Interactive RTT under bulk load",
+          rtt_mean / 1000,
+          "ms");
+}
+
+
+/**
+ * Shut down the test.
+ *
+ * @param cls NULL
+ */
+static void
+shutdown_task (void *cls)
+{
+  if (NULL != ping_task)
+  {
+    GNUNET_SCHEDULER_cancel (ping_task);
+    ping_task = NULL;
+  }
+  if (NULL != timeout_task)
+  {
+    GNUNET_SCHEDULER_cancel (timeout_task);
+    timeout_task = NULL;
+  }
+  if (NULL != id_op)
+  {
+    GNUNET_TESTBED_operation_done (id_op);
+    id_op = NULL;
+  }
+  if (NULL != stats_op)
+  {
+    GNUNET_TESTBED_operation_done (stats_op);
+    stats_op = NULL;
+  }
+  if (NULL != bulk_ch)
+  {
+    GNUNET_CADET_channel_destroy (bulk_ch);
+    bulk_ch = NULL;
+  }
+  if (NULL != ping_ch)
+  {
+    GNUNET_CADET_channel_destroy (ping_ch);
+    ping_ch = NULL;
+  }
+  GNUNET_CADET_TEST_cleanup (test_ctx);
+}
+
+
+/**
+ * The test took too long.
+ *
+ * @param cls NULL
+ */
+static void
+do_timeout (void *cls)
+{
+  timeout_task = NULL;
+  GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+              "Timeout after %u/%u bulk messages\n",
+              bulk_received,
+              BULK_MESSAGES);
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Statistics were all iterated, finish the test.
+ *
+ * @param cls NULL
+ * @param op the operation that has been finished
+ * @param emsg error message, NULL on success
+ */
+static void
+stats_cont (void *cls,
+            struct GNUNET_TESTBED_Operation *op,
+            const char *emsg)
+{
+  GNUNET_TESTBED_operation_done (stats_op);
+  stats_op = NULL;
+  show_end_data ();
+  ret = 0;
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Remember the congestion statistics of peer 0.
+ *
+ * @param cls NULL
+ * @param peer the peer the statistic belong to
+ * @param subsystem name of subsystem that created the statistic
+ * @param name the name of the datum
+ * @param value the current value
+ * @param is_persistent #GNUNET_YES if the value is persistent
+ * @return #GNUNET_OK to continue
+ */
+static int
+stats_iterator (void *cls,
+                const struct GNUNET_TESTBED_Peer *peer,
+                const char *subsystem,
+                const char *name,
+                uint64_t value,
+                int is_persistent)
+{
+  if (0 != GNUNET_TESTBED_get_index (peer))
+    return GNUNET_OK;
+  if (0 == strcmp ("# tunnel congestion window",
+                   name))
+    cwnd = value;
+  if (0 == strcmp ("# tunnel smoothed RTT (us)",
+                   name))
+    srtt = value;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Send the next bulk message, once the previous one was passed
+ * to the service.
+ *
+ * @param cls NULL
+ */
+static void
+send_bulk (void *cls)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+
+  if ( (NULL == bulk_ch) ||
+       (bulk_sent >= BULK_MESSAGES) )
+    return;
+  env = GNUNET_MQ_msg_extra (msg,
+                             BULK_SIZE,
+                             BULK);
+  memset (&msg[1],
+          (int) bulk_sent,
+          BULK_SIZE);
+  bulk_sent++;
+  GNUNET_MQ_notify_sent (env,
+                         &send_bulk,
+                         NULL);
+  GNUNET_MQ_send (GNUNET_CADET_get_mq (bulk_ch),
+                  env);
+}
+
+
+/**
+ * Send a PING.
+ *
+ * @param cls NULL
+ */
+static void
+send_ping (void *cls)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct PingMessage *msg;
+
+  ping_task = GNUNET_SCHEDULER_add_delayed (PING_PERIOD,
+                                            &send_ping,
+                                            NULL);
+  env = GNUNET_MQ_msg (msg,
+                       PING);
+  msg->timestamp = GNUNET_TIME_absolute_hton (GNUNET_TIME_absolute_get ());
+  GNUNET_MQ_send (GNUNET_CADET_get_mq (ping_ch),
+                  env);
+}
+
+
+/**
+ * Check bulk data, any size is fine.
+ *
+ * @param cls the channel
+ * @param msg the message
+ * @return #GNUNET_OK
+ */
+static int
+check_bulk (void *cls,
+            const struct GNUNET_MessageHeader *msg)
+{
+  return GNUNET_OK;
+}
+
+
+/**
+ * Bulk data arrived at the last peer.
+ *
+ * @param cls the channel
+ * @param msg the message
+ */
+static void
+handle_bulk (void *cls,
+             const struct GNUNET_MessageHeader *msg)
+{
+  bulk_received++;
+  if (BULK_MESSAGES != bulk_received)
+    return;
+  bulk_time = GNUNET_TIME_absolute_get_duration (start_time);
+  if (NULL != ping_task)
+  {
+    GNUNET_SCHEDULER_cancel (ping_task);
+    ping_task = NULL;
+  }
+  stats_op = GNUNET_TESTBED_get_statistics (peers_requested,
+                                            testbed_peers,
+                                            "cadet",
+                                            NULL,
+                                            &stats_iterator,
+                                            &stats_cont,
+                                            NULL);
+}
+
+
+/**
+ * A PING arrived at the last peer, echo it.
+ *
+ * @param cls the channel
+ * @param msg the PING
+ */
+static void
+handle_ping (void *cls,
+             const struct PingMessage *msg)
+{
+  struct GNUNET_CADET_Channel *channel = cls;
+  struct GNUNET_MQ_Envelope *env;
+  struct PingMessage *pong;
+
+  env = GNUNET_MQ_msg (pong,
+                       PONG);
+  pong->timestamp = msg->timestamp;
+  GNUNET_MQ_send (GNUNET_CADET_get_mq (channel),
+                  env);
+}
+
+
+/**
+ * A PONG arrived at peer 0.
+ *
+ * @param cls NULL
+ * @param msg the PONG
+ */
+static void
+handle_pong (void *cls,
+             const struct PingMessage *msg)
+{
+  struct GNUNET_TIME_Relative rtt;
+
+  if (BULK_MESSAGES == bulk_received)
+    return; /* bulk transfer is over */
+  rtt = GNUNET_TIME_absolute_get_duration (GNUNET_TIME_absolute_ntoh (msg->timestamp));
+  pongs++;
+  rtt_sum += rtt.rel_value_us;
+  rtt_max = GNUNET_MAX (rtt_max,
+                        rtt.rel_value_us);
+}
+
+
+/**
+ * A channel to the last peer was opened.
+ *
+ * @param cls peer number (as long)
+ * @param channel the new channel
+ * @param source peer that started the channel
+ * @return the channel, as closure for the handlers
+ */
+static void *
+connect_handler (void *cls,
+                 struct GNUNET_CADET_Channel *channel,
+                 const struct GNUNET_PeerIdentity *source)
+{
+  return channel;
+}
+
+
+/**
+ * A channel was destroyed.
+ *
+ * @param cls closure of the channel
+ * @param channel the channel
+ */
+static void
+disconnect_handler (void *cls,
+                    const struct GNUNET_CADET_Channel *channel)
+{
+  if (channel == bulk_ch)
+    bulk_ch = NULL;
+  if (channel == ping_ch)
+    ping_ch = NULL;
+}
+
+
+/**
+ * We got the identity of the last peer, open the channels.
+ *
+ * @param cls NULL
+ * @param op the operation
+ * @param pinfo the result, NULL on error
+ * @param emsg error message, NULL on success
+ */
+static void
+pi_cb (void *cls,
+       struct GNUNET_TESTBED_Operation *op,
+       const struct GNUNET_TESTBED_PeerInformation *pinfo,
+       const char *emsg)
+{
+  struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (pong,
+                             PONG,
+                             struct PingMessage,
+                             NULL),
+    GNUNET_MQ_handler_end ()
+  };
+
+  if ( (NULL == pinfo) ||
+       (NULL != emsg) )
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "pi_cb: %s\n",
+                emsg);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  bulk_ch = GNUNET_CADET_channel_creatE (h1,
+                                         NULL,
+                                         pinfo->result.id,
+                                         &bulk_port,
+                                         GNUNET_CADET_OPTION_RELIABLE,
+                                         NULL,
+                                         &disconnect_handler,
+                                         handlers);
+  ping_ch = GNUNET_CADET_channel_creatE (h1,
+                                         NULL,
+                                         pinfo->result.id,
+                                         &ping_port,
+                                         GNUNET_CADET_OPTION_RELIABLE,
+                                         NULL,
+                                         &disconnect_handler,
+                                         handlers);
+  GNUNET_TESTBED_operation_done (id_op);
+  id_op = NULL;
+  start_time = GNUNET_TIME_absolute_get ();
+  send_bulk (NULL);
+  ping_task = GNUNET_SCHEDULER_add_now (&send_ping,
+                                        NULL);
+}
+
+
+/**
+ * Main function once the testbed is up.
+ *
+ * @param cls NULL
+ * @param ctx test context
+ * @param num_peers number of peers
+ * @param peers the peers
+ * @param cadets CADET handles of the peers
+ */
+static void
+tmain (void *cls,
+       struct GNUNET_CADET_TEST_Context *ctx,
+       unsigned int num_peers,
+       struct GNUNET_TESTBED_Peer **peers,
+       struct GNUNET_CADET_Handle **cadets)
+{
+  test_ctx = ctx;
+  testbed_peers = peers;
+  h1 = cadets[0];
+  GNUNET_SCHEDULER_add_shutdown (&shutdown_task,
+                                 NULL);
+  timeout_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
+                                               &do_timeout,
+                                               NULL);
+  id_op = GNUNET_TESTBED_peer_get_information (peers[num_peers - 1],
+                                               GNUNET_TESTBED_PIT_IDENTITY,
+                                               &pi_cb,
+                                               NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (ping,
+                             PING,
+                             struct PingMessage,
+                             NULL),
+    GNUNET_MQ_hd_var_size (bulk,
+                           BULK,
+                           struct GNUNET_MessageHeader,
+                           NULL),
+    GNUNET_MQ_handler_end ()
+  };
+  static const struct GNUNET_HashCode *ports[3];
+
+  GNUNET_log_setup ("perf-cadet-mixed",
+                    "WARNING",
+                    NULL);
+  GNUNET_CRYPTO_hash ("bulk",
+                      strlen ("bulk"),
+                      &bulk_port);
+  GNUNET_CRYPTO_hash ("ping",
+                      strlen ("ping"),
+                      &ping_port);
+  ports[0] = &bulk_port;
+  ports[1] = &ping_port;
+  ports[2] = NULL;
+  GNUNET_CADET_TEST_ruN ("perf_cadet_mixed",
+                         "test_cadet.conf",
+                         peers_requested,
+                         &tmain,
+                         NULL,
+                         &connect_handler,
+                         NULL,
+                         &disconnect_handler,
+                         handlers,
+                         ports);
+  return ret;
+}
+
+/* end of perf_cadet_mixed_new.c */
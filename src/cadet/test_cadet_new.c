@@ -919,6 +919,9 @@ main (int argc, char *argv[])
   initialized = GNUNET_NO;
   static const struct GNUNET_HashCode *ports[2];
   const char *config_file;
+  char *stripe_config_file;
+  const char *stripe;
+  unsigned int paths;
   char port_id[] = "test port";
 
   GNUNET_CRYPTO_hash (port_id, sizeof (port_id), &port);
@@ -929,7 +932,18 @@ main (int argc, char *argv[])
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Start\n");
 
   /* Find out requested size */
-  if (strstr (argv[0], "_2_") != NULL)
+  stripe_config_file = NULL;
+  paths = 0;
+  if (NULL != (stripe = strstr (argv[0], "_stripe_")))
+  {
+    /* 'paths' disjoint two hop paths between the first and the last peer */
+    paths = atoi (stripe + strlen ("_stripe_"));
+    if (0 == paths)
+      paths = 1;
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "%u DISJOINT PATHS\n", paths);
+    peers_requested = paths + 2;
+  }
+  else if (strstr (argv[0], "_2_") != NULL)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "DIRECT CONNECTIONs\n");
     peers_requested = 2;
@@ -939,6 +953,11 @@ main (int argc, char *argv[])
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "5 PEER LINE\n");
     peers_requested = 5;
   }
+  else if (strstr (argv[0], "_4_") != NULL)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "4 PEER LINE (2 RELAYS)\n");
+    peers_requested = 4;
+  }
   else
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR, "SIZE UNKNOWN, USING 2\n");
@@ -989,6 +1008,11 @@ main (int argc, char *argv[])
       test = SPEED_REL;
       test_name = "speed reliable";
       config_file = "test_cadet_drop.conf";
+      if (strstr (argv[0], "_loss") != NULL)
+      {
+        test_name = "speed reliable (5% loss)";
+        config_file = "test_cadet_loss.conf";
+      }
     }
     else
     {
@@ -1019,6 +1043,16 @@ main (int argc, char *argv[])
     test_backwards = GNUNET_YES;
     GNUNET_asprintf (&test_name, "backwards %s", test_name);
   }
+  if (0 != paths)
+  {
+    GNUNET_asprintf (&stripe_config_file,
+                     "test_cadet_stripe_%u.conf",
+                     paths);
+    config_file = stripe_config_file;
+    GNUNET_asprintf (&test_name, "%s over %u paths", test_name, paths);
+  }
+  else if (4 == peers_requested)
+    GNUNET_asprintf (&test_name, "3 hop relay %s", test_name);
 
   p_ids = 0;
   ports[0] = &port;
@@ -1033,6 +1067,7 @@ main (int argc, char *argv[])
                          &disconnect_handler,
                          handlers,
                          ports);
+  GNUNET_free_non_null (stripe_config_file);
   if (NULL != strstr (argv[0], "_reliable"))
     msg_dropped = 0;            /* dropped should be retransmitted */
 
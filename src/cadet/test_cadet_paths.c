@@ -0,0 +1,262 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file cadet/test_cadet_paths.c
+ * @brief testcase for the path store of the CADET service, using
+ *        stand-ins for the peer, connection and tunnel subsystems
+ */
+#include "platform.h"
+#include "gnunet-service-cadet-new_connection.h"
+#include "gnunet-service-cadet-new_tunnels.h"
+#include "gnunet-service-cadet-new_peer.h"
+#include "gnunet-service-cadet-new_paths.h"
+
+/**
+ * Number of peers in the test.
+ */
+#define NUM_PEERS 4
+
+#define CHECK(c) do { if (! (c)) { GNUNET_break (0); return 1; } } while (0)
+
+
+/**
+ * Stand-in for the peer of the CADET service: keeps the path
+ * entries by offset the same way the real one does.
+ */
+struct CadetPeer
+{
+  /**
+   * Identity of the peer.
+   */
+  struct GNUNET_PeerIdentity pid;
+
+  /**
+   * DLLs of path entries by offset, linked via their
+   * @e next and @e prev fields.
+   */
+  struct CadetPeerPathEntry *path_heads[NUM_PEERS];
+
+  /**
+   * DLLs of path entries by offset.
+   */
+  struct CadetPeerPathEntry *path_tails[NUM_PEERS];
+
+  /**
+   * Number of path entries at this peer.
+   */
+  unsigned int num_paths;
+};
+
+
+/**
+ * The peers, "A" to "D".
+ */
+static struct CadetPeer test_peers[NUM_PEERS];
+
+
+struct CadetPeer *
+GCP_get (const struct GNUNET_PeerIdentity *peer_id,
+         int create)
+{
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+    if (0 == memcmp (peer_id,
+                     &test_peers[i].pid,
+                     sizeof (struct GNUNET_PeerIdentity)))
+      return &test_peers[i];
+  GNUNET_assert (0);
+  return NULL;
+}
+
+
+const struct GNUNET_PeerIdentity *
+GCP_get_id (struct CadetPeer *cp)
+{
+  return &cp->pid;
+}
+
+
+void
+GCP_path_entry_add (struct CadetPeer *cp,
+                    struct CadetPeerPathEntry *entry,
+                    unsigned int off)
+{
+  GNUNET_assert (off < NUM_PEERS);
+  GNUNET_CONTAINER_DLL_insert (cp->path_heads[off],
+                               cp->path_tails[off],
+                               entry);
+  cp->num_paths++;
+}
+
+
+void
+GCP_path_entry_remove (struct CadetPeer *cp,
+                       struct CadetPeerPathEntry *entry,
+                       unsigned int off)
+{
+  GNUNET_CONTAINER_DLL_remove (cp->path_heads[off],
+                               cp->path_tails[off],
+                               entry);
+  GNUNET_assert (0 < cp->num_paths);
+  cp->num_paths--;
+}
+
+
+/**
+ * Only the owner of a route wants a path, shorter prefixes are
+ * never of interest.
+ */
+struct GNUNET_CONTAINER_HeapNode *
+GCP_attach_path (struct CadetPeer *cp,
+                 struct CadetPeerPath *path,
+                 unsigned int off,
+                 int force)
+{
+  if (GNUNET_YES != force)
+    return NULL;
+  return (struct GNUNET_CONTAINER_HeapNode *) cp;
+}
+
+
+void
+GCP_detach_path (struct CadetPeer *cp,
+                 struct CadetPeerPath *path,
+                 struct GNUNET_CONTAINER_HeapNode *hn)
+{
+}
+
+
+double
+GCP_get_desirability_of_path (struct CadetPeer *cp,
+                              unsigned int off)
+{
+  return 1.0;
+}
+
+
+const char *
+GCC_2s (const struct CadetConnection *cc)
+{
+  return "cc";
+}
+
+
+struct CadetTConnection *
+GCC_get_ct (struct CadetConnection *cc)
+{
+  GNUNET_assert (0);
+  return NULL;
+}
+
+
+void
+GCC_destroy_without_tunnel (struct CadetConnection *cc)
+{
+  GNUNET_assert (0);
+}
+
+
+void
+GCT_connection_lost (struct CadetTConnection *ct)
+{
+  GNUNET_assert (0);
+}
+
+
+/**
+ * Obtain the path for a route from peer @a first to peer @a second.
+ *
+ * @param first index of the first hop
+ * @param second index of the second hop
+ * @return the path
+ */
+static struct CadetPeerPath *
+route (unsigned int first,
+       unsigned int second)
+{
+  /* routes are given in reverse order */
+  struct GNUNET_PeerIdentity pids[2];
+
+  pids[0] = test_peers[second].pid;
+  pids[1] = test_peers[first].pid;
+  return GCPP_get_path_from_route (2,
+                                   pids);
+}
+
+
+/**
+ * Create two paths sharing their first hop, look them up again and
+ * release them one after the other.
+ *
+ * @return 0 on success
+ */
+static int
+test_shared_prefix ()
+{
+  struct CadetPeerPath *ab;
+  struct CadetPeerPath *ac;
+
+  ab = route (0, 1);
+  ac = route (0, 2);
+  CHECK (ab != ac);
+  CHECK (2 == GCPP_get_length (ab));
+  CHECK (2 == GCPP_get_length (ac));
+  CHECK (2 == test_peers[0].num_paths);
+  /* both paths must be found through the shared prefix */
+  CHECK (ab == route (0, 1));
+  CHECK (ac == route (0, 2));
+
+  GCPP_release (ac);
+  CHECK (1 == test_peers[0].num_paths);
+  CHECK (0 == test_peers[2].num_paths);
+  CHECK (ab == route (0, 1));
+  CHECK (&test_peers[0] == GCPP_get_peer_at_offset (ab, 0));
+  CHECK (&test_peers[1] == GCPP_get_peer_at_offset (ab, 1));
+
+  /* the shared first hop can be used by a new path again */
+  ac = route (0, 3);
+  CHECK (ab != ac);
+  CHECK (2 == test_peers[0].num_paths);
+
+  GCPP_release (ab);
+  GCPP_release (ac);
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+    CHECK (0 == test_peers[i].num_paths);
+  return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  GNUNET_log_setup ("test-cadet-paths",
+                    "WARNING",
+                    NULL);
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+    memset (&test_peers[i].pid,
+            'A' + i,
+            sizeof (struct GNUNET_PeerIdentity));
+  ret = test_shared_prefix ();
+  GCPP_shutdown ();
+  return ret;
+}
+
+/* end of test_cadet_paths.c */
@@ -81,6 +81,16 @@ static struct GNUNET_TIME_Absolute start;
  */
 static struct GNUNET_TIME_Absolute deadline;
 
+/**
+ * When did we ask the peers to conclude?
+ */
+static struct GNUNET_TIME_Absolute conclude_requested;
+
+/**
+ * Time until the slowest peer concluded.
+ */
+static struct GNUNET_TIME_Relative max_latency;
+
 
 /**
  * Signature of the event handler function called by the
@@ -159,6 +169,10 @@ destroy (void *cls)
               i,
               results_for_peer[i],
               num_values);
+    printf ("round latency with %u peers: %s\n",
+            num_peers,
+            GNUNET_STRINGS_relative_time_to_string (max_latency,
+                                                    GNUNET_YES));
     if (NULL != statistics_filename)
       statistics_file = fopen (statistics_filename, "w");
     GNUNET_TESTBED_get_statistics (num_peers, peers, NULL, NULL,
@@ -180,10 +194,16 @@ static void
 conclude_cb (void *cls)
 {
   struct GNUNET_CONSENSUS_Handle **chp = cls;
+  struct GNUNET_TIME_Relative latency;
 
+  latency = GNUNET_TIME_absolute_get_duration (conclude_requested);
+  max_latency = GNUNET_TIME_relative_max (max_latency,
+                                          latency);
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
-              "consensus %d done\n",
-              (int) (chp - consensus_handles));
+              "consensus %d done after %s\n",
+              (int) (chp - consensus_handles),
+              GNUNET_STRINGS_relative_time_to_string (latency,
+                                                      GNUNET_YES));
   GNUNET_SCHEDULER_add_now (destroy, *chp);
 }
 
@@ -243,6 +263,9 @@ do_consensus ()
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "all elements inserted, calling conclude\n");
 
+  /* peers don't start before the agreed start time */
+  conclude_requested = GNUNET_TIME_absolute_max (GNUNET_TIME_absolute_get (),
+                                                 start);
   for (i = 0; i < num_peers; i++)
     GNUNET_CONSENSUS_conclude (consensus_handles[i],
                                conclude_cb, &consensus_handles[i]);
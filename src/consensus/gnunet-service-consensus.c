@@ -36,6 +36,12 @@
 
 #define ELEMENT_TYPE_CONTESTED_MARKER (GNUNET_CONSENSUS_ELEMENT_TYPE_USER_MAX + 1)
 
+/**
+ * Maximum number of set service processes we spread the set
+ * operations of a session over.
+ */
+#define MAX_SET_SHARDS 16
+
 
 enum ReferendumVote
 {
@@ -106,6 +112,12 @@ struct TaskKey {
 
 
 
+/**
+ * Identifies a set of a session.  For #SET_KIND_CURRENT, @e k1 is the
+ * repetition and @e k2 the set service shard that holds this replica
+ * of the current set.  For the sets of a gradecast, @e k1 is the
+ * repetition and @e k2 the leader.
+ */
 struct SetKey
 {
   int set_kind GNUNET_PACKED;
@@ -321,6 +333,24 @@ struct Step
    * it is already running.
    */
   int early_finishable;
+
+  /**
+   * When did the step start running?
+   */
+  struct GNUNET_TIME_Absolute start_time;
+
+  /**
+   * Longest critical path of the prerequisites
+   * that finished so far.
+   */
+  struct GNUNET_TIME_Relative prereq_path;
+
+  /**
+   * Running time of the longest chain of steps that ends with this
+   * step, i.e. @e prereq_path plus the running time of this step.
+   * Only valid once the step is finished.
+   */
+  struct GNUNET_TIME_Relative critical_path;
 };
 
 
@@ -400,6 +430,33 @@ struct DiffEntry
 
 
 
+/**
+ * Listener for set operation requests on one set service shard.
+ */
+struct ShardListener
+{
+  /**
+   * Session we listen for.
+   */
+  struct ConsensusSession *session;
+
+  /**
+   * Listen handle of the shard's set service.
+   */
+  struct GNUNET_SET_ListenHandle *h;
+
+  /**
+   * Application id of the session's operations on this shard.
+   */
+  struct GNUNET_HashCode app_id;
+
+  /**
+   * Index of the shard.
+   */
+  unsigned int shard;
+};
+
+
 /**
  * A consensus session consists of one local client and the remote authorities.
  */
@@ -483,15 +540,36 @@ struct ConsensusSession
   unsigned int local_peer_idx;
 
   /**
-   * Listener for requests from other peers.
-   * Uses the session's global id as app id.
+   * Listeners for requests from other peers, one for each set
+   * service shard.  The listener of shard 0 uses the session's
+   * global id as app id.
    */
-  struct GNUNET_SET_ListenHandle *set_listener;
+  struct ShardListener *set_listeners;
 
   /**
    * State of our early stopping scheme.
    */
   int early_stopping;
+
+  /**
+   * When did the client request the conclusion?
+   */
+  struct GNUNET_TIME_Absolute conclude_requested;
+
+  /**
+   * Longest critical path of all finished steps.
+   */
+  struct GNUNET_TIME_Relative critical_path;
+
+  /**
+   * Number of steps that are running right now.
+   */
+  unsigned int steps_running;
+
+  /**
+   * Largest number of steps that were running at the same time.
+   */
+  unsigned int max_steps_running;
 };
 
 /**
@@ -519,6 +597,21 @@ static struct GNUNET_PeerIdentity my_peer;
  */
 struct GNUNET_STATISTICS_Handle *statistics;
 
+/**
+ * Configurations to reach the set service shards.  The gradecasts of
+ * different leaders are independent, so their set operations are
+ * spread over several set service processes and run on several cores.
+ * Shard 0 is the "set" service itself and uses @e cfg, shard i > 0 is
+ * the set service configured in section "set-i".
+ */
+static struct GNUNET_CONFIGURATION_Handle *shard_cfgs[MAX_SET_SHARDS];
+
+/**
+ * Number of set service shards we use.  All peers of a session
+ * must use the same number.
+ */
+static unsigned int num_shards = 1;
+
 
 static void
 finish_task (struct TaskEntry *task);
@@ -688,11 +781,82 @@ send_to_client_iter (void *cls,
                 session->local_peer_idx);
     ev = GNUNET_MQ_msg_header (GNUNET_MESSAGE_TYPE_CONSENSUS_CLIENT_CONCLUDE_DONE);
     GNUNET_MQ_send (session->client_mq, ev);
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+                "P%u: concluded after %s, critical path %s, at most %u steps at once\n",
+                session->local_peer_idx,
+                GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (session->conclude_requested),
+                                                        GNUNET_YES),
+                GNUNET_STRINGS_relative_time_to_string (session->critical_path,
+                                                        GNUNET_YES),
+                session->max_steps_running);
+    GNUNET_STATISTICS_set (statistics,
+                           "round latency (ms)",
+                           GNUNET_TIME_absolute_get_duration (session->conclude_requested).rel_value_us / 1000LL,
+                           GNUNET_NO);
+    GNUNET_STATISTICS_set (statistics,
+                           "critical path (ms)",
+                           session->critical_path.rel_value_us / 1000LL,
+                           GNUNET_NO);
+    GNUNET_STATISTICS_set (statistics,
+                           "max concurrent steps",
+                           session->max_steps_running,
+                           GNUNET_NO);
   }
   return GNUNET_YES;
 }
 
 
+/**
+ * Get the configuration to connect to a set service shard.
+ *
+ * @param shard index of the shard
+ * @return configuration for the shard
+ */
+static const struct GNUNET_CONFIGURATION_Handle *
+shard_cfg (unsigned int shard)
+{
+  if (0 == shard)
+    return cfg;
+  return shard_cfgs[shard];
+}
+
+
+/**
+ * Get the set service shard that runs the gradecast of a leader.
+ *
+ * @param leader index of the leader
+ * @return index of the shard
+ */
+static unsigned int
+leader_shard (uint16_t leader)
+{
+  return leader % num_shards;
+}
+
+
+/**
+ * Get the set service shard a set lives in.  Operations are run on
+ * the shard of their input set, on both peers.
+ *
+ * @param key key of the set
+ * @return index of the shard
+ */
+static unsigned int
+set_shard (const struct SetKey *key)
+{
+  switch (key->set_kind)
+  {
+    case SET_KIND_CURRENT:
+      return key->k2;
+    case SET_KIND_LEADER_PROPOSAL:
+    case SET_KIND_ECHO_RESULT:
+      return leader_shard (key->k2);
+    default:
+      return 0;
+  }
+}
+
+
 static struct SetEntry *
 lookup_set (struct ConsensusSession *session, struct SetKey *key)
 {
@@ -858,6 +1022,42 @@ task_other_peer (struct TaskEntry *task)
 }
 
 
+/**
+ * Apply a change of a current set on shard 0 to its replicas on the
+ * other shards.
+ *
+ * @param session the session
+ * @param key key of the changed set
+ * @param element the element that was added or removed
+ * @param add #GNUNET_YES if @a element was added, #GNUNET_NO if removed
+ */
+static void
+update_replicas (struct ConsensusSession *session,
+                 const struct SetKey *key,
+                 const struct GNUNET_SET_Element *element,
+                 int add)
+{
+  struct SetKey replica_key;
+  struct SetEntry *replica;
+  unsigned int shard;
+
+  if ( (SET_KIND_CURRENT != key->set_kind) ||
+       (0 != key->k2) )
+    return;
+  replica_key = *key;
+  for (shard = 1; shard < num_shards; shard++)
+  {
+    replica_key.k2 = shard;
+    replica = lookup_set (session, &replica_key);
+    GNUNET_assert (NULL != replica);
+    if (GNUNET_YES == add)
+      GNUNET_SET_add_element (replica->h, element, NULL, NULL);
+    else
+      GNUNET_SET_remove_element (replica->h, element, NULL, NULL);
+  }
+}
+
+
 /**
  * Callback for set operation results. Called for each element
  * in the result set.
@@ -953,6 +1153,7 @@ set_result_cb (void *cls,
                                 element,
                                 NULL,
                                 NULL);
+        update_replicas (session, &setop->output_set, element, GNUNET_YES);
 #ifdef GNUNET_EXTRA_LOGGING
         GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                     "P%u: adding element %s into set {%s} of task {%s}\n",
@@ -1003,6 +1204,7 @@ set_result_cb (void *cls,
                                    element,
                                    NULL,
                                    NULL);
+        update_replicas (session, &setop->output_set, element, GNUNET_NO);
 #ifdef GNUNET_EXTRA_LOGGING
         GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                     "P%u: removing element %s from set {%s} of task {%s}\n",
@@ -1632,10 +1834,15 @@ try_finish_step_early (struct Step *step)
               step->debug_name);
 #endif
 
+  step->critical_path = step->prereq_path;
+
   for (i = 0; i < step->subordinates_len; i++)
   {
     GNUNET_assert (step->subordinates[i]->pending_prereq > 0);
     step->subordinates[i]->pending_prereq--;
+    step->subordinates[i]->prereq_path
+      = GNUNET_TIME_relative_max (step->subordinates[i]->prereq_path,
+                                  step->critical_path);
 #ifdef GNUNET_EXTRA_LOGGING
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Decreased pending_prereq to %u for step `%s'.\n",
@@ -1654,23 +1861,39 @@ try_finish_step_early (struct Step *step)
 static void
 finish_step (struct Step *step)
 {
+  struct ConsensusSession *session = step->session;
   unsigned int i;
 
   GNUNET_assert (step->finished_tasks == step->tasks_len);
   GNUNET_assert (GNUNET_YES == step->is_running);
   GNUNET_assert (GNUNET_NO == step->is_finished);
 
+  GNUNET_assert (session->steps_running > 0);
+  session->steps_running--;
+  step->critical_path
+    = GNUNET_TIME_relative_add (step->prereq_path,
+                                GNUNET_TIME_absolute_get_duration (step->start_time));
+  session->critical_path = GNUNET_TIME_relative_max (session->critical_path,
+                                                     step->critical_path);
+
 #ifdef GNUNET_EXTRA_LOGGING
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "All tasks of step `%s' with %u subordinates finished.\n",
+              "All tasks of step `%s' with %u subordinates finished after %s (critical path %s).\n",
               step->debug_name,
-              step->subordinates_len);
+              step->subordinates_len,
+              GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (step->start_time),
+                                                      GNUNET_YES),
+              GNUNET_STRINGS_relative_time_to_string (step->critical_path,
+                                                      GNUNET_YES));
 #endif
 
   for (i = 0; i < step->subordinates_len; i++)
   {
     GNUNET_assert (step->subordinates[i]->pending_prereq > 0);
     step->subordinates[i]->pending_prereq--;
+    step->subordinates[i]->prereq_path
+      = GNUNET_TIME_relative_max (step->subordinates[i]->prereq_path,
+                                  step->critical_path);
 #ifdef GNUNET_EXTRA_LOGGING
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Decreased pending_prereq to %u for step `%s'.\n",
@@ -1701,22 +1924,28 @@ task_start_apply_round (struct TaskEntry *task)
   struct SetKey sk_in;
   struct SetKey sk_out;
   struct RfnKey rk_in;
-  struct SetEntry *set_out;
+  struct SetEntry *set_out[MAX_SET_SHARDS];
   struct ReferendumEntry *rfn_in;
   struct GNUNET_CONTAINER_MultiHashMapIterator *iter;
   struct RfnElementInfo *ri;
   struct SetMutationProgressCls *progress_cls;
   uint16_t worst_majority = UINT16_MAX;
+  unsigned int shard;
 
-  sk_in = (struct SetKey) { SET_KIND_CURRENT, task->key.repetition };
   rk_in = (struct RfnKey) { RFN_KIND_GRADECAST_RESULT, task->key.repetition };
-  sk_out = (struct SetKey) { SET_KIND_CURRENT, task->key.repetition + 1 };
 
-  set_out = lookup_set (session, &sk_out);
-  if (NULL == set_out)
+  /* The next current set is needed on every shard; we are started
+     again after each copy. */
+  for (shard = 0; shard < num_shards; shard++)
   {
-    create_set_copy_for_task (task, &sk_in, &sk_out);
-    return;
+    sk_in = (struct SetKey) { SET_KIND_CURRENT, task->key.repetition, shard };
+    sk_out = (struct SetKey) { SET_KIND_CURRENT, task->key.repetition + 1, shard };
+    set_out[shard] = lookup_set (session, &sk_out);
+    if (NULL == set_out[shard])
+    {
+      create_set_copy_for_task (task, &sk_in, &sk_out);
+      return;
+    }
   }
 
   rfn_in = lookup_rfn (session, &rk_in);
@@ -1743,24 +1972,30 @@ task_start_apply_round (struct TaskEntry *task)
     switch (majority_vote)
     {
       case VOTE_ADD:
-        progress_cls->num_pending++;
-        GNUNET_assert (GNUNET_OK ==
-                       GNUNET_SET_add_element (set_out->h,
-                                               ri->element,
-                                               &set_mutation_done,
-                                               progress_cls));
+        for (shard = 0; shard < num_shards; shard++)
+        {
+          progress_cls->num_pending++;
+          GNUNET_assert (GNUNET_OK ==
+                         GNUNET_SET_add_element (set_out[shard]->h,
+                                                 ri->element,
+                                                 &set_mutation_done,
+                                                 progress_cls));
+        }
         GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                     "P%u: apply round: adding element %s with %u-majority.\n",
                     session->local_peer_idx,
                     debug_str_element (ri->element), majority_num);
         break;
       case VOTE_REMOVE:
-        progress_cls->num_pending++;
-        GNUNET_assert (GNUNET_OK ==
-                       GNUNET_SET_remove_element (set_out->h,
-                                                  ri->element,
-                                                  &set_mutation_done,
-                                                  progress_cls));
+        for (shard = 0; shard < num_shards; shard++)
+        {
+          progress_cls->num_pending++;
+          GNUNET_assert (GNUNET_OK ==
+                         GNUNET_SET_remove_element (set_out[shard]->h,
+                                                    ri->element,
+                                                    &set_mutation_done,
+                                                    progress_cls));
+        }
         GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                     "P%u: apply round: deleting element %s with %u-majority.\n",
                     session->local_peer_idx,
@@ -2010,7 +2245,7 @@ task_start_reconcile (struct TaskEntry *task)
     // XXX: maybe this should be done while
     // setting up tasks alreays?
     setop->op = GNUNET_SET_prepare (&session->peers[task->key.peer2],
-                                    &session->global_id,
+                                    &session->set_listeners[set_shard (&setop->input_set)].app_id,
                                     &rcm.header,
                                     GNUNET_SET_RESULT_SYMMETRIC,
                                     (struct GNUNET_SET_Option[]) { 0 },
@@ -2178,8 +2413,13 @@ start_task (struct ConsensusSession *session, struct TaskEntry *task)
 
 
 /*
- * Run all steps of the session that don't any
+ * Run all steps of the session that don't have any
  * more dependencies.
+ *
+ * Steps without dependency edges between them are independent, so
+ * all of them are started at once.  The set operations of the
+ * gradecasts of different leaders run in different set service
+ * processes (see #leader_shard()), so they use several cores.
  */
 static void
 run_ready_steps (struct ConsensusSession *session)
@@ -2195,6 +2435,10 @@ run_ready_steps (struct ConsensusSession *session)
       size_t i;
 
       GNUNET_assert (0 == step->finished_tasks);
+      step->start_time = GNUNET_TIME_absolute_get ();
+      session->steps_running++;
+      session->max_steps_running = GNUNET_MAX (session->max_steps_running,
+                                               session->steps_running);
 
 #ifdef GNUNET_EXTRA_LOGGING
       GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: Running step `%s' of round %d with %d tasks and %d subordinates\n",
@@ -2210,14 +2454,9 @@ run_ready_steps (struct ConsensusSession *session)
       /* Sometimes there is no task to trigger finishing the step, so we have to do it here. */
       if ( (step->finished_tasks == step->tasks_len) && (GNUNET_NO == step->is_finished))
         finish_step (step);
-
-      /* Running the next ready steps will be triggered by task completion */
-      return;
     }
     step = step->next;
   }
-
-  return;
 }
 
 
@@ -2281,6 +2520,42 @@ compute_global_id (struct ConsensusSession *session,
 }
 
 
+/**
+ * Compute the application id for the set operations of a session
+ * on a set service shard.
+ *
+ * @param session session with the global id
+ * @param shard index of the shard
+ * @param[out] app_id set to the application id
+ */
+static void
+compute_shard_app_id (const struct ConsensusSession *session,
+                      unsigned int shard,
+                      struct GNUNET_HashCode *app_id)
+{
+  const char *salt = "gnunet-service-consensus/shard";
+  uint32_t shard_nbo;
+
+  if (0 == shard)
+  {
+    /* compatible with peers that do not shard */
+    *app_id = session->global_id;
+    return;
+  }
+  shard_nbo = htonl (shard);
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CRYPTO_kdf (app_id,
+                                    sizeof (struct GNUNET_HashCode),
+                                    salt,
+                                    strlen (salt),
+                                    &session->global_id,
+                                    sizeof (struct GNUNET_HashCode),
+                                    &shard_nbo,
+                                    sizeof (shard_nbo),
+                                    NULL));
+}
+
+
 /**
  * Compare two peer identities.
  *
@@ -2378,7 +2653,8 @@ set_listen_cb (void *cls,
                const struct GNUNET_MessageHeader *context_msg,
                struct GNUNET_SET_Request *request)
 {
-  struct ConsensusSession *session = cls;
+  struct ShardListener *sl = cls;
+  struct ConsensusSession *session = sl->session;
   struct TaskKey tk;
   struct TaskEntry *task;
   struct GNUNET_CONSENSUS_RoundContextMessage *cm;
@@ -2435,6 +2711,14 @@ set_listen_cb (void *cls,
     return;
   }
 
+  if (set_shard (&task->cls.setop.input_set) != sl->shard)
+  {
+    /* Our input set lives in another set service, the other
+       peer must use a different number of shards. */
+    GNUNET_break_op (0);
+    return;
+  }
+
   GNUNET_assert (! ((task->key.peer1 == session->local_peer_idx) &&
                     (task->key.peer2 == session->local_peer_idx)));
 
@@ -2654,7 +2938,7 @@ construct_task_graph_gradecast (struct ConsensusSession *session,
         .cancel = task_cancel_reconcile,
         .key = (struct TaskKey) { PHASE_KIND_GRADECAST_LEADER, p1, p2, rep, me },
       });
-      task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep };
+      task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep, leader_shard (lead) };
       put_task (session->taskmap, &task);
     }
     /* We run this task to make sure that the leader
@@ -2667,7 +2951,7 @@ construct_task_graph_gradecast (struct ConsensusSession *session,
       .start = task_start_reconcile,
       .cancel = task_cancel_reconcile,
     });
-    task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep };
+    task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep, leader_shard (lead) };
     task.cls.setop.output_set = (struct SetKey) { SET_KIND_LEADER_PROPOSAL, rep, me };
     task.cls.setop.output_diff = (struct DiffKey) { DIFF_KIND_LEADER_PROPOSAL, rep, me };
     put_task (session->taskmap, &task);
@@ -2683,7 +2967,7 @@ construct_task_graph_gradecast (struct ConsensusSession *session,
       .start = task_start_reconcile,
       .cancel = task_cancel_reconcile,
     });
-    task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep };
+    task.cls.setop.input_set = (struct SetKey) { SET_KIND_CURRENT, rep, leader_shard (lead) };
     task.cls.setop.output_set = (struct SetKey) { SET_KIND_LEADER_PROPOSAL, rep, lead };
     task.cls.setop.output_diff = (struct DiffKey) { DIFF_KIND_LEADER_PROPOSAL, rep, lead };
     put_task (session->taskmap, &task);
@@ -2934,6 +3218,7 @@ handle_client_join (void *cls,
 {
   struct ConsensusSession *session = cls;
   struct ConsensusSession *other_session;
+  unsigned int shard;
 
   initialize_session_peer_list (session,
                                 m);
@@ -2971,12 +3256,23 @@ handle_client_join (void *cls,
                                                     session->conclude_deadline),
                GNUNET_YES));
 
-  session->set_listener
-    = GNUNET_SET_listen (cfg,
-                         GNUNET_SET_OPERATION_UNION,
-                         &session->global_id,
-                         &set_listen_cb,
-                         session);
+  session->set_listeners = GNUNET_new_array (num_shards,
+                                             struct ShardListener);
+  for (shard = 0; shard < num_shards; shard++)
+  {
+    struct ShardListener *sl = &session->set_listeners[shard];
+
+    sl->session = session;
+    sl->shard = shard;
+    compute_shard_app_id (session,
+                          shard,
+                          &sl->app_id);
+    sl->h = GNUNET_SET_listen (shard_cfg (shard),
+                               GNUNET_SET_OPERATION_UNION,
+                               &sl->app_id,
+                               &set_listen_cb,
+                               sl);
+  }
 
   session->setmap = GNUNET_CONTAINER_multihashmap_create (1,
                                                           GNUNET_NO);
@@ -2987,13 +3283,16 @@ handle_client_join (void *cls,
   session->rfnmap = GNUNET_CONTAINER_multihashmap_create (1,
                                                           GNUNET_NO);
 
+  /* The elements of the client go into a replica of the
+     current set on every shard. */
+  for (shard = 0; shard < num_shards; shard++)
   {
     struct SetEntry *client_set;
 
     client_set = GNUNET_new (struct SetEntry);
-    client_set->h = GNUNET_SET_create (cfg,
+    client_set->h = GNUNET_SET_create (shard_cfg (shard),
                                        GNUNET_SET_OPERATION_UNION);
-    client_set->key = ((struct SetKey) { SET_KIND_CURRENT, 0, 0 });
+    client_set->key = ((struct SetKey) { SET_KIND_CURRENT, 0, shard });
     put_set (session,
              client_set);
   }
@@ -3043,7 +3342,7 @@ handle_client_insert (void *cls,
   struct ConsensusSession *session = cls;
   struct GNUNET_SET_Element *element;
   ssize_t element_size;
-  struct GNUNET_SET_Handle *initial_set;
+  unsigned int shard;
 
   if (GNUNET_YES == session->conclude_started)
   {
@@ -3057,20 +3356,20 @@ handle_client_insert (void *cls,
   element->size = element_size;
   GNUNET_memcpy (&element[1], &msg[1], element_size);
   element->data = &element[1];
+  for (shard = 0; shard < num_shards; shard++)
   {
-    struct SetKey key = { SET_KIND_CURRENT, 0, 0 };
+    struct SetKey key = { SET_KIND_CURRENT, 0, shard };
     struct SetEntry *entry;
 
     entry = lookup_set (session,
                         &key);
     GNUNET_assert (NULL != entry);
-    initial_set = entry->h;
+    session->num_client_insert_pending++;
+    GNUNET_SET_add_element (entry->h,
+                            element,
+                            &client_insert_done,
+                            session);
   }
-  session->num_client_insert_pending++;
-  GNUNET_SET_add_element (initial_set,
-                          element,
-                          &client_insert_done,
-                          session);
 
 #ifdef GNUNET_EXTRA_LOGGING
   {
@@ -3112,6 +3411,7 @@ handle_client_conclude (void *cls,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "conclude requested\n");
   session->conclude_started = GNUNET_YES;
+  session->conclude_requested = GNUNET_TIME_absolute_get ();
   install_step_timeouts (session);
   run_ready_steps (session);
   GNUNET_SERVICE_client_continue (session->client);
@@ -3126,14 +3426,75 @@ handle_client_conclude (void *cls,
 static void
 shutdown_task (void *cls)
 {
+  unsigned int shard;
+
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "shutting down\n");
+  for (shard = 1; shard < num_shards; shard++)
+  {
+    GNUNET_CONFIGURATION_destroy (shard_cfgs[shard]);
+    shard_cfgs[shard] = NULL;
+  }
   GNUNET_STATISTICS_destroy (statistics,
                              GNUNET_NO);
   statistics = NULL;
 }
 
 
+/**
+ * Create the configuration to connect to a set service shard: the
+ * address options of the "set" section are replaced by those of the
+ * shard's section.
+ *
+ * @param shard index of the shard, at least 1
+ * @return the configuration, NULL if the shard is not configured
+ */
+static struct GNUNET_CONFIGURATION_Handle *
+create_shard_cfg (unsigned int shard)
+{
+  static const char *options[] = { "UNIXPATH", "PORT", "HOSTNAME", NULL };
+  struct GNUNET_CONFIGURATION_Handle *scfg;
+  char section[16];
+  char *value;
+  unsigned int i;
+
+  GNUNET_snprintf (section,
+                   sizeof (section),
+                   "set-%u",
+                   shard);
+  if (GNUNET_YES !=
+      GNUNET_CONFIGURATION_have_value (cfg,
+                                       section,
+                                       "BINARY"))
+    return NULL;
+  scfg = GNUNET_CONFIGURATION_dup (cfg);
+  for (i = 0; NULL != options[i]; i++)
+  {
+    if (GNUNET_OK ==
+        GNUNET_CONFIGURATION_get_value_string (cfg,
+                                               section,
+                                               options[i],
+                                               &value))
+    {
+      GNUNET_CONFIGURATION_set_value_string (scfg,
+                                             "set",
+                                             options[i],
+                                             value);
+      GNUNET_free (value);
+    }
+    else
+    {
+      /* never fall back to the address of the main set service */
+      GNUNET_CONFIGURATION_set_value_string (scfg,
+                                             "set",
+                                             options[i],
+                                             (0 == strcmp ("PORT", options[i])) ? "0" : "");
+    }
+  }
+  return scfg;
+}
+
+
 /**
  * Start processing consensus requests.
  *
@@ -3146,6 +3507,8 @@ run (void *cls,
      const struct GNUNET_CONFIGURATION_Handle *c,
      struct GNUNET_SERVICE_Handle *service)
 {
+  unsigned long long shards;
+
   cfg = c;
   if (GNUNET_OK !=
       GNUNET_CRYPTO_get_peer_identity (cfg,
@@ -3160,6 +3523,37 @@ run (void *cls,
                                          cfg);
   GNUNET_SCHEDULER_add_shutdown (&shutdown_task,
                                  NULL);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+                                             "consensus",
+                                             "SET_SHARDS",
+                                             &shards))
+    shards = 1;
+  if ( (0 == shards) ||
+       (shards > MAX_SET_SHARDS) )
+  {
+    GNUNET_log_config_invalid (GNUNET_ERROR_TYPE_WARNING,
+                               "consensus",
+                               "SET_SHARDS",
+                               _("must be between 1 and 16"));
+    shards = GNUNET_MAX (1, GNUNET_MIN (shards, MAX_SET_SHARDS));
+  }
+  for (num_shards = 1; num_shards < shards; num_shards++)
+  {
+    shard_cfgs[num_shards] = create_shard_cfg (num_shards);
+    if (NULL == shard_cfgs[num_shards])
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  "No set service configured in section `set-%u', using %u set service shards\n",
+                  num_shards,
+                  num_shards);
+      break;
+    }
+  }
+  GNUNET_STATISTICS_set (statistics,
+                         "set service shards",
+                         num_shards,
+                         GNUNET_NO);
 }
 
 
@@ -3200,11 +3594,15 @@ client_disconnect_cb (void *cls,
 		      void *internal_cls)
 {
   struct ConsensusSession *session = internal_cls;
+  unsigned int shard;
 
-  if (NULL != session->set_listener)
+  if (NULL != session->set_listeners)
   {
-    GNUNET_SET_listen_cancel (session->set_listener);
-    session->set_listener = NULL;
+    for (shard = 0; shard < num_shards; shard++)
+      if (NULL != session->set_listeners[shard].h)
+        GNUNET_SET_listen_cancel (session->set_listeners[shard].h);
+    GNUNET_free (session->set_listeners);
+    session->set_listeners = NULL;
   }
   GNUNET_CONTAINER_DLL_remove (sessions_head,
                                sessions_tail,
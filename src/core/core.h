@@ -71,6 +71,12 @@
  */
 #define GNUNET_CORE_OPTION_SEND_HDR_OUTBOUND  64
 
+/**
+ * Client can exchange messages with the service over shared
+ * memory.  Not an event option, masked out by the service.
+ */
+#define GNUNET_CORE_OPTION_SHM               128
+
 
 GNUNET_NETWORK_STRUCT_BEGIN
 
@@ -342,6 +348,42 @@ struct MonitorNotifyMessage
 };
 
 
+/**
+ * Message sent by the service to clients that set
+ * #GNUNET_CORE_OPTION_SHM, offering to exchange all further
+ * messages over shared memory.
+ */
+struct ShmOfferMessage
+{
+  /**
+   * Header with type #GNUNET_MESSAGE_TYPE_CORE_SHM_OFFER.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /* Followed by the 0-terminated name of the file to map */
+};
+
+
+/**
+ * Reply of the client to a `struct ShmOfferMessage`.  If accepted,
+ * the client sends all further messages except
+ * #GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY over shared memory.
+ */
+struct ShmAckMessage
+{
+  /**
+   * Header with type #GNUNET_MESSAGE_TYPE_CORE_SHM_ACK.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * #GNUNET_YES if the client mapped the channel, #GNUNET_NO if not.
+   */
+  uint32_t accepted GNUNET_PACKED;
+
+};
+
+
 GNUNET_NETWORK_STRUCT_END
 #endif
 /* end of core.h */
@@ -28,6 +28,7 @@
 #include "gnunet_constants.h"
 #include "gnunet_core_service.h"
 #include "core.h"
+#include "core_shm.h"
 
 #define LOG(kind,...) GNUNET_log_from (kind, "core-api",__VA_ARGS__)
 
@@ -114,6 +115,17 @@ struct GNUNET_CORE_Handle
    */
   struct GNUNET_MQ_Handle *mq;
 
+  /**
+   * Shared memory channel with the service, or NULL.
+   */
+  struct CORE_SHM_Channel *shm;
+
+  /**
+   * Message queue of @e shm, used instead of @e mq for
+   * everything except wake-ups once it is set up.
+   */
+  struct GNUNET_MQ_Handle *shm_mq;
+
   /**
    * Hash map listing all of the peers that we are currently
    * connected to.
@@ -214,6 +226,37 @@ disconnect_and_free_peer_entry (void *cls,
 }
 
 
+/**
+ * Get the message queue to use for messages to the service.
+ *
+ * @param h our handle
+ * @return the queue of the shared memory channel if we have one
+ */
+static struct GNUNET_MQ_Handle *
+get_service_mq (struct GNUNET_CORE_Handle *h)
+{
+  if (NULL != h->shm_mq)
+    return h->shm_mq;
+  return h->mq;
+}
+
+
+/**
+ * Destroy the shared memory channel with the service, if any.
+ *
+ * @param h our handle
+ */
+static void
+destroy_shm (struct GNUNET_CORE_Handle *h)
+{
+  if (NULL == h->shm)
+    return;
+  CORE_SHM_destroy (h->shm);
+  h->shm = NULL;
+  h->shm_mq = NULL;
+}
+
+
 /**
  * Close down any existing connection to the CORE service and
  * try re-establishing it later.
@@ -224,6 +267,7 @@ static void
 reconnect_later (struct GNUNET_CORE_Handle *h)
 {
   GNUNET_assert (NULL == h->reconnect_task);
+  destroy_shm (h);
   if (NULL != h->mq)
   {
     GNUNET_MQ_destroy (h->mq);
@@ -340,7 +384,7 @@ core_mq_send_impl (struct GNUNET_MQ_Handle *mq,
   smr->reserved = htonl (0);
   smr->size = htons (msize);
   smr->smr_id = htons (++pr->smr_id_gen);
-  GNUNET_MQ_send (h->mq,
+  GNUNET_MQ_send (get_service_mq (h),
                   env);
 
   /* prepare message with actual transmission data */
@@ -693,13 +737,146 @@ handle_send_ready (void *cls,
   }
 
   /* ok, all good, send message out! */
-  GNUNET_MQ_send (h->mq,
+  GNUNET_MQ_send (get_service_mq (h),
 		  pr->env);
   pr->env = NULL;
   GNUNET_MQ_impl_send_continue (pr->mq);
 }
 
 
+/**
+ * Wake up the service after we wrote to or read from the shared
+ * memory channel.
+ *
+ * @param cls the `struct GNUNET_CORE_Handle`
+ */
+static void
+notify_service_shm (void *cls)
+{
+  struct GNUNET_CORE_Handle *h = cls;
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+
+  if (NULL == h->mq)
+    return;
+  env = GNUNET_MQ_msg (msg,
+                       GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY);
+  GNUNET_MQ_send (h->mq,
+                  env);
+}
+
+
+/**
+ * Check that the shared memory offer from the CORE service is
+ * well-formed.
+ *
+ * @param cls the `struct GNUNET_CORE_Handle`
+ * @param som the offer
+ * @return #GNUNET_OK if @a som contains a 0-terminated file name
+ */
+static int
+check_shm_offer (void *cls,
+                 const struct ShmOfferMessage *som)
+{
+  uint16_t size = ntohs (som->header.size) - sizeof (*som);
+  const char *fn = (const char *) &som[1];
+
+  if ( (0 == size) ||
+       ('\0' != fn[size - 1]) )
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Handle shared memory offer from the CORE service: map the channel
+ * and use it for all further messages, or tell the service to stay
+ * with the socket.
+ *
+ * @param cls the `struct GNUNET_CORE_Handle`
+ * @param som the offer
+ */
+static void
+handle_shm_offer (void *cls,
+                  const struct ShmOfferMessage *som)
+{
+  struct GNUNET_CORE_Handle *h = cls;
+  struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (connect_notify,
+                             GNUNET_MESSAGE_TYPE_CORE_NOTIFY_CONNECT,
+                             struct ConnectNotifyMessage,
+                             h),
+    GNUNET_MQ_hd_fixed_size (disconnect_notify,
+                             GNUNET_MESSAGE_TYPE_CORE_NOTIFY_DISCONNECT,
+                             struct DisconnectNotifyMessage,
+                             h),
+    GNUNET_MQ_hd_var_size (notify_inbound,
+                           GNUNET_MESSAGE_TYPE_CORE_NOTIFY_INBOUND,
+                           struct NotifyTrafficMessage,
+                           h),
+    GNUNET_MQ_hd_fixed_size (send_ready,
+                             GNUNET_MESSAGE_TYPE_CORE_SEND_READY,
+                             struct SendMessageReady,
+                             h),
+    GNUNET_MQ_handler_end ()
+  };
+  struct GNUNET_MQ_Envelope *env;
+  struct ShmAckMessage *ack;
+
+  if (NULL != h->shm)
+  {
+    GNUNET_break (0);
+    reconnect_later (h);
+    return;
+  }
+  h->shm = CORE_SHM_attach ((const char *) &som[1],
+                            &notify_service_shm,
+                            h);
+  env = GNUNET_MQ_msg (ack,
+                       GNUNET_MESSAGE_TYPE_CORE_SHM_ACK);
+  ack->accepted = htonl ((NULL != h->shm) ? GNUNET_YES : GNUNET_NO);
+  GNUNET_MQ_send (h->mq,
+                  env);
+  if (NULL == h->shm)
+    return;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Using shared memory to talk to CORE service\n");
+  /* the service is trusted, pass messages without copying */
+  h->shm_mq = CORE_SHM_get_mq (h->shm,
+                               handlers,
+                               &handle_mq_error,
+                               h,
+                               GNUNET_NO);
+}
+
+
+/**
+ * Handle wake-up from the CORE service: process the messages it
+ * wrote into the shared memory.
+ *
+ * @param cls the `struct GNUNET_CORE_Handle`
+ * @param msg the wake-up message
+ */
+static void
+handle_shm_notify (void *cls,
+                   const struct GNUNET_MessageHeader *msg)
+{
+  struct GNUNET_CORE_Handle *h = cls;
+
+  if (NULL == h->shm)
+  {
+    GNUNET_break (0);
+    reconnect_later (h);
+    return;
+  }
+  /* may destroy @a h if a handler disconnects */
+  (void) CORE_SHM_receive (h->shm);
+}
+
+
 /**
  * Our current client connection went down.  Clean it up and try to
  * reconnect!
@@ -730,6 +907,14 @@ reconnect (struct GNUNET_CORE_Handle *h)
                              GNUNET_MESSAGE_TYPE_CORE_SEND_READY,
                              struct SendMessageReady,
                              h),
+    GNUNET_MQ_hd_var_size (shm_offer,
+                           GNUNET_MESSAGE_TYPE_CORE_SHM_OFFER,
+                           struct ShmOfferMessage,
+                           h),
+    GNUNET_MQ_hd_fixed_size (shm_notify,
+                             GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY,
+                             struct GNUNET_MessageHeader,
+                             h),
     GNUNET_MQ_handler_end ()
   };
   struct InitMessage *init;
@@ -752,7 +937,16 @@ reconnect (struct GNUNET_CORE_Handle *h)
                              GNUNET_MESSAGE_TYPE_CORE_INIT);
   LOG (GNUNET_ERROR_TYPE_INFO,
        "(Re)connecting to CORE service\n");
-  init->options = htonl (0);
+  /* without handlers, older services would take any option as a
+     request for all messages */
+  if ( (h->hcnt > 0) &&
+       (GNUNET_YES ==
+        GNUNET_CONFIGURATION_get_value_yesno (h->cfg,
+                                              "core",
+                                              "USE_SHM")) )
+    init->options = htonl (GNUNET_CORE_OPTION_SHM);
+  else
+    init->options = htonl (0);
   ts = (uint16_t *) &init[1];
   for (unsigned int hpos = 0; hpos < h->hcnt; hpos++)
     ts[hpos] = htons (h->handlers[hpos].type);
@@ -830,6 +1024,7 @@ GNUNET_CORE_disconnect (struct GNUNET_CORE_Handle *handle)
     GNUNET_SCHEDULER_cancel (handle->reconnect_task);
     handle->reconnect_task = NULL;
   }
+  destroy_shm (handle);
   if (NULL != handle->mq)
   {
     GNUNET_MQ_destroy (handle->mq);
@@ -0,0 +1,866 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file core/core_shm.c
+ * @brief shared memory message rings between the core service
+ *        and its local clients
+ *
+ * Each ring has a head (bytes produced) and a tail (bytes consumed)
+ * that are only ever written by the producer and the consumer
+ * respectively.  Messages are stored as records aligned to
+ * #RECORD_ALIGN bytes, so their headers never wrap around the end of
+ * the ring (the rest of the message may).  A side that finds its
+ * ring empty (consumer) or full (producer) sets a flag in the ring
+ * and re-checks; the other side tests the flag after updating its
+ * index and sends a wake-up over the socket if it is set.
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "core_shm.h"
+
+#define LOG(kind,...) GNUNET_log_from (kind, "core-shm",__VA_ARGS__)
+
+/**
+ * Magic number at the beginning of the shared memory ("CORE").
+ */
+#define SHM_MAGIC 0x434f5245
+
+/**
+ * Version of the shared memory layout.
+ */
+#define SHM_VERSION 1
+
+/**
+ * Alignment of the records in the rings.
+ */
+#define RECORD_ALIGN 8
+
+/**
+ * Number of bytes a message of @a msize bytes occupies in a ring.
+ */
+#define RECORD_SIZE(msize) (((msize) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1))
+
+/**
+ * How many messages do we process at most before giving the
+ * scheduler a chance to run other tasks?
+ */
+#define MAX_BATCH 128
+
+/**
+ * Full memory barrier between the two processes.
+ */
+#define SHM_BARRIER() __sync_synchronize ()
+
+
+/**
+ * Control block of one ring.  Padded to a cache line so that the
+ * two sides do not share lines for the two rings.
+ */
+struct RingHeader
+{
+  /**
+   * Number of bytes produced (modulo 2^32), written by the producer.
+   */
+  volatile uint32_t head;
+
+  /**
+   * Number of bytes consumed (modulo 2^32), written by the consumer.
+   */
+  volatile uint32_t tail;
+
+  /**
+   * Set by the consumer if it found the ring empty and must be
+   * woken up once data is available.
+   */
+  volatile uint32_t consumer_waiting;
+
+  /**
+   * Set by the producer if it found the ring full and must be
+   * woken up once space is available.
+   */
+  volatile uint32_t producer_waiting;
+
+  /**
+   * Padding.
+   */
+  char pad[48];
+};
+
+
+/**
+ * Layout of the beginning of the shared memory.  Followed by the
+ * data of ring 0 (service to client) and ring 1 (client to
+ * service), #CORE_SHM_RING_SIZE bytes each.
+ */
+struct ShmLayout
+{
+  /**
+   * Always #SHM_MAGIC.
+   */
+  uint32_t magic;
+
+  /**
+   * Always #SHM_VERSION.
+   */
+  uint32_t version;
+
+  /**
+   * Size of each ring, #CORE_SHM_RING_SIZE.
+   */
+  uint32_t ring_size;
+
+  /**
+   * Reserved, always zero.
+   */
+  uint32_t reserved;
+
+  /**
+   * Padding.
+   */
+  char pad[48];
+
+  /**
+   * The two rings.
+   */
+  struct RingHeader rings[2];
+};
+
+
+/**
+ * Total size of the shared memory of a channel.
+ */
+#define SHM_TOTAL_SIZE (sizeof (struct ShmLayout) + 2 * CORE_SHM_RING_SIZE)
+
+
+/**
+ * Handle for our side of a shared memory channel.
+ */
+struct CORE_SHM_Channel
+{
+
+  /**
+   * File backing the channel.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Mapping of @e fh.
+   */
+  struct GNUNET_DISK_MapHandle *map;
+
+  /**
+   * Name of the file, if we created it and did not unlink it yet.
+   */
+  char *filename;
+
+  /**
+   * Ring we produce into.
+   */
+  struct RingHeader *tx;
+
+  /**
+   * Data of the ring we produce into.
+   */
+  char *tx_data;
+
+  /**
+   * Ring we consume from.
+   */
+  struct RingHeader *rx;
+
+  /**
+   * Data of the ring we consume from.
+   */
+  char *rx_data;
+
+  /**
+   * Message queue for transmitting over the channel.
+   */
+  struct GNUNET_MQ_Handle *mq;
+
+  /**
+   * Message from @e mq waiting for space in the ring, or NULL.
+   */
+  const struct GNUNET_MessageHeader *pending;
+
+  /**
+   * Function to call to wake up the other side.
+   */
+  CORE_SHM_NotifyCallback notify_cb;
+
+  /**
+   * Closure for @e notify_cb.
+   */
+  void *notify_cls;
+
+  /**
+   * Buffer for messages we copy out of the ring, or NULL.
+   */
+  char *copy_buf;
+
+  /**
+   * Task to continue processing received messages, or NULL.
+   */
+  struct GNUNET_SCHEDULER_Task *receive_task;
+
+  /**
+   * Task to report a corrupted ring to the error handler, or NULL.
+   */
+  struct GNUNET_SCHEDULER_Task *error_task;
+
+  /**
+   * Our copy of the head of @e tx (the shared copy may be
+   * modified by the other side).
+   */
+  uint32_t tx_head;
+
+  /**
+   * Our copy of the tail of @e rx.
+   */
+  uint32_t rx_tail;
+
+  /**
+   * #GNUNET_YES to copy received messages before dispatching them.
+   */
+  int copy_in;
+
+  /**
+   * #GNUNET_YES while we are dispatching received messages.
+   */
+  int in_receive;
+
+  /**
+   * #GNUNET_YES if the channel was destroyed while we were
+   * dispatching received messages.
+   */
+  int destroyed;
+
+};
+
+
+/**
+ * Set up the pointers into the mapped memory.
+ *
+ * @param ch channel to initialize
+ * @param layout the mapped memory
+ * @param tx_ring index of the ring we produce into
+ */
+static void
+setup_rings (struct CORE_SHM_Channel *ch,
+             struct ShmLayout *layout,
+             unsigned int tx_ring)
+{
+  char *data = (char *) &layout[1];
+
+  ch->tx = &layout->rings[tx_ring];
+  ch->tx_data = &data[tx_ring * CORE_SHM_RING_SIZE];
+  ch->rx = &layout->rings[1 - tx_ring];
+  ch->rx_data = &data[(1 - tx_ring) * CORE_SHM_RING_SIZE];
+}
+
+
+/**
+ * Create a new shared memory channel (service side).
+ *
+ * @param unix_match_uid #GNUNET_YES if only our user may map the channel
+ * @param unix_match_gid #GNUNET_YES if our group may map the channel
+ * @param notify_cb function to call to wake up the client
+ * @param notify_cls closure for @a notify_cb
+ * @return NULL on error
+ */
+struct CORE_SHM_Channel *
+CORE_SHM_create (int unix_match_uid,
+                 int unix_match_gid,
+                 CORE_SHM_NotifyCallback notify_cb,
+                 void *notify_cls)
+{
+  struct CORE_SHM_Channel *ch;
+  struct ShmLayout *layout;
+  char zero = 0;
+
+  ch = GNUNET_new (struct CORE_SHM_Channel);
+  ch->notify_cb = notify_cb;
+  ch->notify_cls = notify_cls;
+  ch->filename = GNUNET_DISK_mktemp ("gnunet-core-shm");
+  if (NULL == ch->filename)
+  {
+    GNUNET_free (ch);
+    return NULL;
+  }
+  /* otherwise keep the file private to our user */
+  if ( (GNUNET_YES == unix_match_uid) ||
+       (GNUNET_YES == unix_match_gid) )
+    GNUNET_DISK_fix_permissions (ch->filename,
+                                 unix_match_uid,
+                                 unix_match_gid);
+  ch->fh = GNUNET_DISK_file_open (ch->filename,
+                                  GNUNET_DISK_OPEN_READWRITE,
+                                  GNUNET_DISK_PERM_NONE);
+  if ( (NULL == ch->fh) ||
+       (SHM_TOTAL_SIZE - 1 !=
+        GNUNET_DISK_file_seek (ch->fh,
+                               SHM_TOTAL_SIZE - 1,
+                               GNUNET_DISK_SEEK_SET)) ||
+       (1 != GNUNET_DISK_file_write (ch->fh,
+                                     &zero,
+                                     1)) ||
+       (NULL == (layout = GNUNET_DISK_file_map (ch->fh,
+                                                &ch->map,
+                                                GNUNET_DISK_MAP_TYPE_READWRITE,
+                                                SHM_TOTAL_SIZE))) )
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         "Failed to set up shared memory in `%s'\n",
+         ch->filename);
+    CORE_SHM_destroy (ch);
+    return NULL;
+  }
+  memset (layout,
+          0,
+          sizeof (struct ShmLayout));
+  layout->magic = SHM_MAGIC;
+  layout->version = SHM_VERSION;
+  layout->ring_size = CORE_SHM_RING_SIZE;
+  /* both sides start out idle */
+  layout->rings[0].consumer_waiting = 1;
+  layout->rings[1].consumer_waiting = 1;
+  SHM_BARRIER ();
+  setup_rings (ch,
+               layout,
+               0);
+  return ch;
+}
+
+
+/**
+ * Attach to a shared memory channel created by the service
+ * (client side).
+ *
+ * @param filename name of the file with the channel
+ * @param notify_cb function to call to wake up the service
+ * @param notify_cls closure for @a notify_cb
+ * @return NULL on error (client must continue to use the socket)
+ */
+struct CORE_SHM_Channel *
+CORE_SHM_attach (const char *filename,
+                 CORE_SHM_NotifyCallback notify_cb,
+                 void *notify_cls)
+{
+  struct CORE_SHM_Channel *ch;
+  struct ShmLayout *layout;
+  off_t size;
+
+  ch = GNUNET_new (struct CORE_SHM_Channel);
+  ch->notify_cb = notify_cb;
+  ch->notify_cls = notify_cls;
+  ch->fh = GNUNET_DISK_file_open (filename,
+                                  GNUNET_DISK_OPEN_READWRITE,
+                                  GNUNET_DISK_PERM_NONE);
+  if ( (NULL == ch->fh) ||
+       (GNUNET_OK !=
+        GNUNET_DISK_file_handle_size (ch->fh,
+                                      &size)) ||
+       (SHM_TOTAL_SIZE != size) ||
+       (NULL == (layout = GNUNET_DISK_file_map (ch->fh,
+                                                &ch->map,
+                                                GNUNET_DISK_MAP_TYPE_READWRITE,
+                                                SHM_TOTAL_SIZE))) )
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Failed to map shared memory in `%s', using socket\n",
+         filename);
+    CORE_SHM_destroy (ch);
+    return NULL;
+  }
+  SHM_BARRIER ();
+  if ( (SHM_MAGIC != layout->magic) ||
+       (SHM_VERSION != layout->version) ||
+       (CORE_SHM_RING_SIZE != layout->ring_size) )
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         "Shared memory in `%s' has unexpected format, using socket\n",
+         filename);
+    CORE_SHM_destroy (ch);
+    return NULL;
+  }
+  setup_rings (ch,
+               layout,
+               1);
+  return ch;
+}
+
+
+/**
+ * Get the name of the file backing the channel, to be passed
+ * to #CORE_SHM_attach() by the client.
+ *
+ * @param ch channel created with #CORE_SHM_create()
+ * @return the file name, NULL if it was already unlinked
+ */
+const char *
+CORE_SHM_get_filename (const struct CORE_SHM_Channel *ch)
+{
+  return ch->filename;
+}
+
+
+/**
+ * The client attached to the channel, remove the file name
+ * from the file system.
+ *
+ * @param ch channel created with #CORE_SHM_create()
+ */
+void
+CORE_SHM_unlink (struct CORE_SHM_Channel *ch)
+{
+  if (NULL == ch->filename)
+    return;
+  if (0 != UNLINK (ch->filename))
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                              "unlink",
+                              ch->filename);
+  GNUNET_free (ch->filename);
+  ch->filename = NULL;
+}
+
+
+/**
+ * Try to append a message to the ring we produce into.
+ *
+ * @param ch the channel
+ * @param msg message to append
+ * @return #GNUNET_OK on success, #GNUNET_NO if the ring is full
+ *         (we will be woken up once there is space),
+ *         #GNUNET_SYSERR if the other side corrupted the ring
+ */
+static int
+ring_write (struct CORE_SHM_Channel *ch,
+            const struct GNUNET_MessageHeader *msg)
+{
+  struct RingHeader *r = ch->tx;
+  uint16_t msize = ntohs (msg->size);
+  uint32_t rsize = RECORD_SIZE (msize);
+  uint32_t head = ch->tx_head;
+  uint32_t used;
+  uint32_t off;
+  uint32_t first;
+
+  used = head - r->tail;
+  if (used > CORE_SHM_RING_SIZE)
+    return GNUNET_SYSERR;
+  if (CORE_SHM_RING_SIZE - used < rsize)
+  {
+    r->producer_waiting = 1;
+    SHM_BARRIER ();
+    used = head - r->tail;
+    if (used > CORE_SHM_RING_SIZE)
+      return GNUNET_SYSERR;
+    if (CORE_SHM_RING_SIZE - used < rsize)
+      return GNUNET_NO;
+    r->producer_waiting = 0;
+  }
+  /* do not overwrite data before the consumer released it */
+  SHM_BARRIER ();
+  off = head & (CORE_SHM_RING_SIZE - 1);
+  first = GNUNET_MIN ((uint32_t) msize,
+                      CORE_SHM_RING_SIZE - off);
+  GNUNET_memcpy (&ch->tx_data[off],
+                 msg,
+                 first);
+  if (first < msize)
+    GNUNET_memcpy (ch->tx_data,
+                   &((const char *) msg)[first],
+                   msize - first);
+  /* publish the message only once it is complete */
+  SHM_BARRIER ();
+  ch->tx_head = head + rsize;
+  r->head = ch->tx_head;
+  SHM_BARRIER ();
+  if (0 != r->consumer_waiting)
+  {
+    r->consumer_waiting = 0;
+    ch->notify_cb (ch->notify_cls);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Get the next message from the ring we consume from.
+ *
+ * @param ch the channel
+ * @param[out] rsize set to the size of the record of the message
+ * @param[out] err set to #GNUNET_YES if the other side corrupted
+ *             the ring
+ * @return the message, NULL if the ring is empty or corrupted
+ */
+static const struct GNUNET_MessageHeader *
+ring_peek (struct CORE_SHM_Channel *ch,
+           uint32_t *rsize,
+           int *err)
+{
+  struct RingHeader *r = ch->rx;
+  const struct GNUNET_MessageHeader *hdr;
+  uint32_t tail = ch->rx_tail;
+  uint32_t used;
+  uint32_t off;
+  uint32_t first;
+  uint16_t msize;
+
+  *err = GNUNET_NO;
+  if (r->head == tail)
+  {
+    r->consumer_waiting = 1;
+    SHM_BARRIER ();
+    if (r->head == tail)
+      return NULL;
+    r->consumer_waiting = 0;
+  }
+  used = r->head - tail;
+  /* read the data only after the head */
+  SHM_BARRIER ();
+  off = tail & (CORE_SHM_RING_SIZE - 1);
+  hdr = (const struct GNUNET_MessageHeader *) &ch->rx_data[off];
+  msize = ntohs (hdr->size);
+  if ( (used > CORE_SHM_RING_SIZE) ||
+       (msize < sizeof (struct GNUNET_MessageHeader)) ||
+       (RECORD_SIZE (msize) > used) )
+  {
+    GNUNET_break_op (0);
+    *err = GNUNET_YES;
+    return NULL;
+  }
+  *rsize = RECORD_SIZE (msize);
+  first = GNUNET_MIN ((uint32_t) msize,
+                      CORE_SHM_RING_SIZE - off);
+  if ( (GNUNET_NO == ch->copy_in) &&
+       (first == msize) )
+    return hdr;
+  if (NULL == ch->copy_buf)
+    ch->copy_buf = GNUNET_malloc (GNUNET_SERVER_MAX_MESSAGE_SIZE);
+  GNUNET_memcpy (ch->copy_buf,
+                 hdr,
+                 first);
+  if (first < msize)
+    GNUNET_memcpy (&ch->copy_buf[first],
+                   ch->rx_data,
+                   msize - first);
+  /* the other side may have changed the size since we checked it */
+  ((struct GNUNET_MessageHeader *) ch->copy_buf)->size = htons (msize);
+  return (const struct GNUNET_MessageHeader *) ch->copy_buf;
+}
+
+
+/**
+ * We are done with the message returned by #ring_peek(), release
+ * its space in the ring.
+ *
+ * @param ch the channel
+ * @param rsize size of the record of the message
+ */
+static void
+ring_consume (struct CORE_SHM_Channel *ch,
+              uint32_t rsize)
+{
+  struct RingHeader *r = ch->rx;
+
+  SHM_BARRIER ();
+  ch->rx_tail += rsize;
+  r->tail = ch->rx_tail;
+  SHM_BARRIER ();
+  if (0 != r->producer_waiting)
+  {
+    r->producer_waiting = 0;
+    ch->notify_cb (ch->notify_cls);
+  }
+}
+
+
+/**
+ * Task to tell the error handler of @e mq that the other side
+ * corrupted the ring we produce into.  Not done directly from
+ * #transmit_pending() as the caller of #GNUNET_MQ_send() may not
+ * expect the queue to be destroyed.
+ *
+ * @param cls our `struct CORE_SHM_Channel`
+ */
+static void
+error_task (void *cls)
+{
+  struct CORE_SHM_Channel *ch = cls;
+
+  ch->error_task = NULL;
+  if (NULL == ch->mq)
+    return;
+  GNUNET_MQ_inject_error (ch->mq,
+                          GNUNET_MQ_ERROR_WRITE);
+}
+
+
+/**
+ * Try to append the message @e mq is waiting to send to the ring.
+ *
+ * @param ch the channel
+ */
+static void
+transmit_pending (struct CORE_SHM_Channel *ch)
+{
+  int ret;
+
+  if (NULL == ch->pending)
+    return;
+  ret = ring_write (ch,
+                    ch->pending);
+  if (GNUNET_NO == ret)
+    return;
+  ch->pending = NULL;
+  if (GNUNET_SYSERR == ret)
+  {
+    GNUNET_break_op (0);
+    if (NULL == ch->error_task)
+      ch->error_task = GNUNET_SCHEDULER_add_now (&error_task,
+                                                 ch);
+    return;
+  }
+  GNUNET_MQ_impl_send_continue (ch->mq);
+}
+
+
+/**
+ * Implement sending functionality of the message queue of the
+ * channel.
+ *
+ * @param mq the message queue
+ * @param msg the message to send
+ * @param impl_state our `struct CORE_SHM_Channel`
+ */
+static void
+shm_mq_send (struct GNUNET_MQ_Handle *mq,
+             const struct GNUNET_MessageHeader *msg,
+             void *impl_state)
+{
+  struct CORE_SHM_Channel *ch = impl_state;
+
+  GNUNET_assert (NULL == ch->pending);
+  ch->pending = msg;
+  transmit_pending (ch);
+}
+
+
+/**
+ * Handle destruction of the message queue of the channel.
+ *
+ * @param mq the message queue to destroy
+ * @param impl_state our `struct CORE_SHM_Channel`
+ */
+static void
+shm_mq_destroy (struct GNUNET_MQ_Handle *mq,
+                void *impl_state)
+{
+  struct CORE_SHM_Channel *ch = impl_state;
+
+  ch->pending = NULL;
+  ch->mq = NULL;
+}
+
+
+/**
+ * Cancel the message waiting for space in the ring.
+ *
+ * @param mq message queue
+ * @param impl_state our `struct CORE_SHM_Channel`
+ */
+static void
+shm_mq_cancel (struct GNUNET_MQ_Handle *mq,
+               void *impl_state)
+{
+  struct CORE_SHM_Channel *ch = impl_state;
+
+  GNUNET_assert (NULL != ch->pending);
+  ch->pending = NULL;
+}
+
+
+/**
+ * Create the message queue for transmitting over the channel.
+ * Messages read from the channel are passed to @a handlers.
+ *
+ * @param ch the channel
+ * @param handlers handlers for messages received over the channel
+ * @param error_handler called if the other side violated the protocol
+ * @param error_handler_cls closure for @a error_handler
+ * @param copy_in #GNUNET_YES to copy each message out of the ring
+ *        before passing it to @a handlers, for when the other side
+ *        is not trusted
+ * @return the message queue, owned by the channel
+ */
+struct GNUNET_MQ_Handle *
+CORE_SHM_get_mq (struct CORE_SHM_Channel *ch,
+                 const struct GNUNET_MQ_MessageHandler *handlers,
+                 GNUNET_MQ_ErrorHandler error_handler,
+                 void *error_handler_cls,
+                 int copy_in)
+{
+  GNUNET_assert (NULL == ch->mq);
+  ch->copy_in = copy_in;
+  ch->mq = GNUNET_MQ_queue_for_callbacks (&shm_mq_send,
+                                          &shm_mq_destroy,
+                                          &shm_mq_cancel,
+                                          ch,
+                                          handlers,
+                                          error_handler,
+                                          error_handler_cls);
+  return ch->mq;
+}
+
+
+/**
+ * Release the resources of the channel.
+ *
+ * @param ch channel to free
+ */
+static void
+free_channel (struct CORE_SHM_Channel *ch)
+{
+  if (NULL != ch->receive_task)
+  {
+    GNUNET_SCHEDULER_cancel (ch->receive_task);
+    ch->receive_task = NULL;
+  }
+  if (NULL != ch->error_task)
+  {
+    GNUNET_SCHEDULER_cancel (ch->error_task);
+    ch->error_task = NULL;
+  }
+  if (NULL != ch->map)
+  {
+    GNUNET_DISK_file_unmap (ch->map);
+    ch->map = NULL;
+  }
+  if (NULL != ch->fh)
+  {
+    GNUNET_DISK_file_close (ch->fh);
+    ch->fh = NULL;
+  }
+  CORE_SHM_unlink (ch);
+  GNUNET_free_non_null (ch->copy_buf);
+  GNUNET_free (ch);
+}
+
+
+/**
+ * Task to continue processing messages received over the channel.
+ *
+ * @param cls our `struct CORE_SHM_Channel`
+ */
+static void
+receive_task (void *cls)
+{
+  struct CORE_SHM_Channel *ch = cls;
+
+  ch->receive_task = NULL;
+  (void) CORE_SHM_receive (ch);
+}
+
+
+/**
+ * The other side woke us up: process all messages waiting in the
+ * channel and continue transmitting if we were waiting for space.
+ *
+ * @param ch the channel
+ * @return #GNUNET_OK on success, #GNUNET_NO if @a ch was destroyed
+ *         by one of the handlers, #GNUNET_SYSERR if the other side
+ *         violated the protocol (error handler was called)
+ */
+int
+CORE_SHM_receive (struct CORE_SHM_Channel *ch)
+{
+  const struct GNUNET_MessageHeader *msg;
+  uint32_t rsize;
+  unsigned int n;
+  int err;
+
+  GNUNET_assert (GNUNET_NO == ch->in_receive);
+  ch->in_receive = GNUNET_YES;
+  transmit_pending (ch);
+  err = GNUNET_NO;
+  n = 0;
+  while ( (GNUNET_NO == ch->destroyed) &&
+          (NULL != ch->mq) &&
+          (n < MAX_BATCH) &&
+          (NULL != (msg = ring_peek (ch,
+                                     &rsize,
+                                     &err))) )
+  {
+    GNUNET_MQ_inject_message (ch->mq,
+                              msg);
+    if (GNUNET_YES == ch->destroyed)
+      break;
+    ring_consume (ch,
+                  rsize);
+    n++;
+  }
+  if ( (GNUNET_YES == err) &&
+       (GNUNET_NO == ch->destroyed) &&
+       (NULL != ch->mq) )
+    GNUNET_MQ_inject_error (ch->mq,
+                            GNUNET_MQ_ERROR_MALFORMED);
+  ch->in_receive = GNUNET_NO;
+  if (GNUNET_YES == ch->destroyed)
+  {
+    free_channel (ch);
+    return GNUNET_NO;
+  }
+  if (GNUNET_YES == err)
+    return GNUNET_SYSERR;
+  if ( (MAX_BATCH == n) &&
+       (NULL == ch->receive_task) )
+  {
+    /* more may be waiting, but let others run first */
+    ch->receive_task = GNUNET_SCHEDULER_add_now (&receive_task,
+                                                 ch);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Destroy our side of the channel and its message queue.
+ *
+ * @param ch channel to destroy
+ */
+void
+CORE_SHM_destroy (struct CORE_SHM_Channel *ch)
+{
+  if (NULL != ch->mq)
+    GNUNET_MQ_destroy (ch->mq);
+  GNUNET_assert (NULL == ch->mq);
+  if (GNUNET_YES == ch->in_receive)
+  {
+    /* free once the handler returns */
+    ch->destroyed = GNUNET_YES;
+    return;
+  }
+  free_channel (ch);
+}
+
+
+/* end of core_shm.c */
@@ -0,0 +1,156 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file core/core_shm.h
+ * @brief shared memory message rings between the core service
+ *        and its local clients
+ *
+ * A channel consists of two single-producer, single-consumer rings
+ * in a file mapped by both processes, one for each direction.  The
+ * rings are lock-free; the socket between client and service is
+ * only used to wake up the other side if it went idle (ring empty
+ * for the consumer, ring full for the producer).
+ */
+#ifndef CORE_SHM_H
+#define CORE_SHM_H
+
+#include "gnunet_util_lib.h"
+
+/**
+ * Size of each of the two rings of a channel, must be a power of two.
+ */
+#define CORE_SHM_RING_SIZE (256 * 1024)
+
+
+/**
+ * Handle for our side of a shared memory channel.
+ */
+struct CORE_SHM_Channel;
+
+
+/**
+ * Function called whenever the other side of the channel must be
+ * woken up, by sending it a #GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY
+ * over the socket.
+ *
+ * @param cls closure
+ */
+typedef void
+(*CORE_SHM_NotifyCallback) (void *cls);
+
+
+/**
+ * Create a new shared memory channel (service side).
+ *
+ * @param unix_match_uid #GNUNET_YES if only our user may map the channel
+ * @param unix_match_gid #GNUNET_YES if our group may map the channel
+ * @param notify_cb function to call to wake up the client
+ * @param notify_cls closure for @a notify_cb
+ * @return NULL on error
+ */
+struct CORE_SHM_Channel *
+CORE_SHM_create (int unix_match_uid,
+                 int unix_match_gid,
+                 CORE_SHM_NotifyCallback notify_cb,
+                 void *notify_cls);
+
+
+/**
+ * Attach to a shared memory channel created by the service
+ * (client side).
+ *
+ * @param filename name of the file with the channel
+ * @param notify_cb function to call to wake up the service
+ * @param notify_cls closure for @a notify_cb
+ * @return NULL on error (client must continue to use the socket)
+ */
+struct CORE_SHM_Channel *
+CORE_SHM_attach (const char *filename,
+                 CORE_SHM_NotifyCallback notify_cb,
+                 void *notify_cls);
+
+
+/**
+ * Get the name of the file backing the channel, to be passed
+ * to #CORE_SHM_attach() by the client.
+ *
+ * @param ch channel created with #CORE_SHM_create()
+ * @return the file name, NULL if it was already unlinked
+ */
+const char *
+CORE_SHM_get_filename (const struct CORE_SHM_Channel *ch);
+
+
+/**
+ * The client attached to the channel, remove the file name
+ * from the file system.
+ *
+ * @param ch channel created with #CORE_SHM_create()
+ */
+void
+CORE_SHM_unlink (struct CORE_SHM_Channel *ch);
+
+
+/**
+ * Create the message queue for transmitting over the channel.
+ * Messages read from the channel are passed to @a handlers.
+ *
+ * @param ch the channel
+ * @param handlers handlers for messages received over the channel
+ * @param error_handler called if the other side violated the protocol
+ * @param error_handler_cls closure for @a error_handler
+ * @param copy_in #GNUNET_YES to copy each message out of the ring
+ *        before passing it to @a handlers, for when the other side
+ *        is not trusted
+ * @return the message queue, owned by the channel
+ */
+struct GNUNET_MQ_Handle *
+CORE_SHM_get_mq (struct CORE_SHM_Channel *ch,
+                 const struct GNUNET_MQ_MessageHandler *handlers,
+                 GNUNET_MQ_ErrorHandler error_handler,
+                 void *error_handler_cls,
+                 int copy_in);
+
+
+/**
+ * The other side woke us up: process all messages waiting in the
+ * channel and continue transmitting if we were waiting for space.
+ *
+ * @param ch the channel
+ * @return #GNUNET_OK on success, #GNUNET_NO if @a ch was destroyed
+ *         by one of the handlers, #GNUNET_SYSERR if the other side
+ *         violated the protocol (error handler was called)
+ */
+int
+CORE_SHM_receive (struct CORE_SHM_Channel *ch);
+
+
+/**
+ * Destroy our side of the channel and its message queue.
+ *
+ * @param ch channel to destroy
+ */
+void
+CORE_SHM_destroy (struct CORE_SHM_Channel *ch);
+
+
+#endif
+/* end of core_shm.h */
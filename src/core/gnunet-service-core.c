@@ -30,6 +30,7 @@
 #include "gnunet-service-core_kx.h"
 #include "gnunet-service-core_sessions.h"
 #include "gnunet-service-core_typemap.h"
+#include "core_shm.h"
 
 /**
  * How many messages do we queue up at most for any client? This can
@@ -60,10 +61,21 @@ struct GSC_Client
   struct GNUNET_SERVICE_Client *client;
 
   /**
-   * Message queue to talk to @e client.
+   * Message queue to talk to @e client, either @e socket_mq or
+   * the queue of @e shm.
    */
   struct GNUNET_MQ_Handle *mq;
 
+  /**
+   * Message queue of the socket of @e client.
+   */
+  struct GNUNET_MQ_Handle *socket_mq;
+
+  /**
+   * Shared memory channel with @e client, or NULL.
+   */
+  struct CORE_SHM_Channel *shm;
+
   /**
    * Array of the types of messages this peer cares
    * about (with @e tcnt entries).  Allocated as part
@@ -133,6 +145,46 @@ static struct GSC_Client *client_head;
  */
 static struct GSC_Client *client_tail;
 
+/**
+ * Handlers for messages from clients received over shared memory,
+ * set in #run().
+ */
+static struct GNUNET_MQ_MessageHandler *shm_handlers;
+
+/**
+ * Do we offer shared memory channels to our clients?
+ */
+static int use_shm;
+
+/**
+ * Value of the UNIX_MATCH_UID option.
+ */
+static int shm_match_uid;
+
+/**
+ * Value of the UNIX_MATCH_GID option.
+ */
+static int shm_match_gid;
+
+
+/**
+ * Wake up the client of a shared memory channel.
+ *
+ * @param cls the `struct GSC_Client`
+ */
+static void
+notify_client_shm (void *cls)
+{
+  struct GSC_Client *c = cls;
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+
+  env = GNUNET_MQ_msg (msg,
+                       GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY);
+  GNUNET_MQ_send (c->socket_mq,
+                  env);
+}
+
 
 /**
  * Test if the client is interested in messages of the given type.
@@ -193,7 +245,7 @@ handle_client_init (void *cls,
   msize = ntohs (im->header.size) - sizeof (struct InitMessage);
   types = (const uint16_t *) &im[1];
   c->tcnt = msize / sizeof (uint16_t);
-  c->options = ntohl (im->options);
+  c->options = ntohl (im->options) & ~GNUNET_CORE_OPTION_SHM;
   c->got_init = GNUNET_YES;
   all_client_options |= c->options;
   c->types = GNUNET_malloc (msize);
@@ -217,10 +269,122 @@ handle_client_init (void *cls,
   GNUNET_MQ_send (c->mq,
 		  env);
   GSC_SESSIONS_notify_client_about_sessions (c);
+  if ( (GNUNET_YES == use_shm) &&
+       (NULL == c->shm) &&
+       (0 != (ntohl (im->options) & GNUNET_CORE_OPTION_SHM)) &&
+       (NULL != (c->shm = CORE_SHM_create (shm_match_uid,
+                                           shm_match_gid,
+                                           &notify_client_shm,
+                                           c))) )
+  {
+    struct ShmOfferMessage *som;
+    const char *fn = CORE_SHM_get_filename (c->shm);
+    size_t slen = strlen (fn) + 1;
+
+    env = GNUNET_MQ_msg_extra (som,
+                               slen,
+                               GNUNET_MESSAGE_TYPE_CORE_SHM_OFFER);
+    GNUNET_memcpy (&som[1],
+                   fn,
+                   slen);
+    GNUNET_MQ_send (c->socket_mq,
+                    env);
+  }
+  GNUNET_SERVICE_client_continue (c->client);
+}
+
+
+/**
+ * The client of a shared memory channel violated the protocol.
+ *
+ * @param cls the `struct GSC_Client`
+ * @param error error code
+ */
+static void
+shm_error_cb (void *cls,
+              enum GNUNET_MQ_Error error)
+{
+  struct GSC_Client *c = cls;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+              "Shared memory channel with client failed (%d), dropping client\n",
+              error);
+  GNUNET_SERVICE_client_drop (c->client);
+}
+
+
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SHM_ACK message.
+ *
+ * @param cls client that sent the #GNUNET_MESSAGE_TYPE_CORE_SHM_ACK
+ * @param ack the `struct ShmAckMessage`
+ */
+static void
+handle_client_shm_ack (void *cls,
+                       const struct ShmAckMessage *ack)
+{
+  struct GSC_Client *c = cls;
+
+  if ( (NULL == c->shm) ||
+       (c->mq != c->socket_mq) )
+  {
+    GNUNET_break_op (0);
+    GNUNET_SERVICE_client_drop (c->client);
+    return;
+  }
+  if (GNUNET_YES != ntohl (ack->accepted))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Client declined shared memory channel\n");
+    CORE_SHM_destroy (c->shm);
+    c->shm = NULL;
+    GNUNET_SERVICE_client_continue (c->client);
+    return;
+  }
+  GNUNET_STATISTICS_update (GSC_stats,
+                            gettext_noop ("# clients using shared memory"),
+                            1,
+                            GNUNET_NO);
+  CORE_SHM_unlink (c->shm);
+  /* the client is not trusted, copy messages out of the ring before
+     checking them */
+  c->mq = CORE_SHM_get_mq (c->shm,
+                           shm_handlers,
+                           &shm_error_cb,
+                           c,
+                           GNUNET_YES);
+  GNUNET_MQ_set_handlers_closure (c->mq,
+                                  c);
   GNUNET_SERVICE_client_continue (c->client);
 }
 
 
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY message: process the
+ * messages the client wrote into the shared memory.
+ *
+ * @param cls client that sent the #GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY
+ * @param msg the wake-up message
+ */
+static void
+handle_client_shm_notify (void *cls,
+                          const struct GNUNET_MessageHeader *msg)
+{
+  struct GSC_Client *c = cls;
+
+  if ( (NULL == c->shm) ||
+       (c->mq == c->socket_mq) )
+  {
+    GNUNET_break_op (0);
+    GNUNET_SERVICE_client_drop (c->client);
+    return;
+  }
+  /* if not OK, the client was dropped and @a c is gone */
+  if (GNUNET_OK == CORE_SHM_receive (c->shm))
+    GNUNET_SERVICE_client_continue (c->client);
+}
+
+
 /**
  * We will never be ready to transmit the given message in (disconnect
  * or invalid request).  Frees resources associated with @a car.  We
@@ -302,16 +466,17 @@ GSC_CLIENTS_solicit_request (struct GSC_ClientActiveRequest *car)
 
 
 /**
- * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST message.
+ * Process #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST message.
  *
- * @param cls client that sent a #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST
+ * @param c client that sent a #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST
  * @param req the `struct SendMessageRequest`
+ * @param from_socket #GNUNET_YES if @a req was received over the socket
  */
 static void
-handle_client_send_request (void *cls,
-                            const struct SendMessageRequest *req)
+process_send_request (struct GSC_Client *c,
+                      const struct SendMessageRequest *req,
+                      int from_socket)
 {
-  struct GSC_Client *c = cls;
   struct GSC_ClientActiveRequest *car;
   int is_loopback;
 
@@ -338,7 +503,8 @@ handle_client_send_request (void *cls,
                               gettext_noop
                               ("# send requests dropped (disconnected)"), 1,
                               GNUNET_NO);
-    GNUNET_SERVICE_client_continue (c->client);
+    if (GNUNET_YES == from_socket)
+      GNUNET_SERVICE_client_continue (c->client);
     return;
   }
 
@@ -375,7 +541,8 @@ handle_client_send_request (void *cls,
   car->msize = ntohs (req->size);
   car->smr_id = req->smr_id;
   car->was_solicited = GNUNET_NO;
-  GNUNET_SERVICE_client_continue (c->client);
+  if (GNUNET_YES == from_socket)
+    GNUNET_SERVICE_client_continue (c->client);
   if (is_loopback)
   {
     /* loopback, satisfy immediately */
@@ -386,6 +553,39 @@ handle_client_send_request (void *cls,
 }
 
 
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST message.
+ *
+ * @param cls client that sent a #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST
+ * @param req the `struct SendMessageRequest`
+ */
+static void
+handle_client_send_request (void *cls,
+                            const struct SendMessageRequest *req)
+{
+  process_send_request (cls,
+                        req,
+                        GNUNET_YES);
+}
+
+
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST message received
+ * over shared memory.
+ *
+ * @param cls client that sent a #GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST
+ * @param req the `struct SendMessageRequest`
+ */
+static void
+handle_shm_send_request (void *cls,
+                         const struct SendMessageRequest *req)
+{
+  process_send_request (cls,
+                        req,
+                        GNUNET_NO);
+}
+
+
 /**
  * Closure for the #client_tokenizer_callback().
  */
@@ -500,16 +700,17 @@ check_client_send (void *cls,
 
 
 /**
- * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND request.
+ * Process #GNUNET_MESSAGE_TYPE_CORE_SEND request.
  *
- * @param cls the `struct GSC_Client`
+ * @param c the client
  * @param sm the `struct SendMessage`
+ * @param from_socket #GNUNET_YES if @a sm was received over the socket
  */
 static void
-handle_client_send (void *cls,
-		    const struct SendMessage *sm)
+process_send (struct GSC_Client *c,
+              const struct SendMessage *sm,
+              int from_socket)
 {
-  struct GSC_Client *c = cls;
   struct TokenizerContext tc;
   uint16_t msize;
   struct GNUNET_TIME_Relative delay;
@@ -530,7 +731,8 @@ handle_client_send (void *cls,
                               gettext_noop ("# messages discarded (session disconnected)"),
                               1,
 			      GNUNET_NO);
-    GNUNET_SERVICE_client_continue (c->client);
+    if (GNUNET_YES == from_socket)
+      GNUNET_SERVICE_client_continue (c->client);
     return;
   }
   delay = GNUNET_TIME_absolute_get_duration (tc.car->received_time);
@@ -567,7 +769,58 @@ handle_client_send (void *cls,
   GNUNET_MST_destroy (mst);
   GSC_SESSIONS_dequeue_request (tc.car);
   GNUNET_free (tc.car);
-  GNUNET_SERVICE_client_continue (c->client);
+  if (GNUNET_YES == from_socket)
+    GNUNET_SERVICE_client_continue (c->client);
+}
+
+
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND request.
+ *
+ * @param cls the `struct GSC_Client`
+ * @param sm the `struct SendMessage`
+ */
+static void
+handle_client_send (void *cls,
+		    const struct SendMessage *sm)
+{
+  process_send (cls,
+                sm,
+                GNUNET_YES);
+}
+
+
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_SEND request received over
+ * shared memory.
+ *
+ * @param cls the `struct GSC_Client`
+ * @param sm the `struct SendMessage`
+ */
+static void
+handle_shm_send (void *cls,
+                 const struct SendMessage *sm)
+{
+  process_send (cls,
+                sm,
+                GNUNET_NO);
+}
+
+
+/**
+ * Check #GNUNET_MESSAGE_TYPE_CORE_SEND request received over
+ * shared memory.
+ *
+ * @param cls the `struct GSC_Client`
+ * @param sm the `struct SendMessage`
+ * @return #GNUNET_OK if @a sm is well-formed
+ */
+static int
+check_shm_send (void *cls,
+                const struct SendMessage *sm)
+{
+  return check_client_send (cls,
+                            sm);
 }
 
 
@@ -615,6 +868,7 @@ client_connect_cb (void *cls,
   c = GNUNET_new (struct GSC_Client);
   c->client = client;
   c->mq = mq;
+  c->socket_mq = mq;
   c->connectmap = GNUNET_CONTAINER_multipeermap_create (16,
 							GNUNET_NO);
   GNUNET_CONTAINER_DLL_insert (client_head,
@@ -644,6 +898,12 @@ client_disconnect_cb (void *cls,
   GNUNET_CONTAINER_DLL_remove (client_head,
 			       client_tail,
 			       c);
+  if (NULL != c->shm)
+  {
+    CORE_SHM_destroy (c->shm);
+    c->shm = NULL;
+    c->mq = NULL;
+  }
   if (NULL != c->requests)
   {
     GNUNET_CONTAINER_multipeermap_iterate (c->requests,
@@ -899,6 +1159,8 @@ shutdown_task (void *cls)
   GSC_SESSIONS_done ();
   GSC_KX_done ();
   GSC_TYPEMAP_done ();
+  GNUNET_free_non_null (shm_handlers);
+  shm_handlers = NULL;
   if (NULL != GSC_stats)
   {
     GNUNET_STATISTICS_destroy (GSC_stats,
@@ -929,6 +1191,23 @@ handle_client_monitor_peers (void *cls,
 }
 
 
+/**
+ * Handle #GNUNET_MESSAGE_TYPE_CORE_MONITOR_PEERS request received
+ * over shared memory.
+ *
+ * @param cls client sending the iteration request
+ * @param message iteration request message
+ */
+static void
+handle_shm_monitor_peers (void *cls,
+                          const struct GNUNET_MessageHeader *message)
+{
+  struct GSC_Client *c = cls;
+
+  GSC_KX_handle_client_monitor_peers (c->mq);
+}
+
+
 /**
  * Initiate core service.
  *
@@ -944,6 +1223,22 @@ run (void *cls,
   struct GNUNET_CRYPTO_EddsaPrivateKey *pk;
   char *keyfile;
 
+  struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (shm_monitor_peers,
+                             GNUNET_MESSAGE_TYPE_CORE_MONITOR_PEERS,
+                             struct GNUNET_MessageHeader,
+                             NULL),
+    GNUNET_MQ_hd_fixed_size (shm_send_request,
+                             GNUNET_MESSAGE_TYPE_CORE_SEND_REQUEST,
+                             struct SendMessageRequest,
+                             NULL),
+    GNUNET_MQ_hd_var_size (shm_send,
+                           GNUNET_MESSAGE_TYPE_CORE_SEND,
+                           struct SendMessage,
+                           NULL),
+    GNUNET_MQ_handler_end ()
+  };
+
   GSC_cfg = c;
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_filename (GSC_cfg,
@@ -958,6 +1253,16 @@ run (void *cls,
   }
   GSC_stats = GNUNET_STATISTICS_create ("core",
 					GSC_cfg);
+  use_shm = GNUNET_CONFIGURATION_get_value_yesno (GSC_cfg,
+                                                  "core",
+                                                  "USE_SHM");
+  shm_match_uid = GNUNET_CONFIGURATION_get_value_yesno (GSC_cfg,
+                                                        "core",
+                                                        "UNIX_MATCH_UID");
+  shm_match_gid = GNUNET_CONFIGURATION_get_value_yesno (GSC_cfg,
+                                                        "core",
+                                                        "UNIX_MATCH_GID");
+  shm_handlers = GNUNET_MQ_copy_handlers (handlers);
   GNUNET_SCHEDULER_add_shutdown (&shutdown_task,
 				 NULL);
   GNUNET_SERVICE_suspend (service);
@@ -1004,6 +1309,14 @@ GNUNET_SERVICE_MAIN
 			GNUNET_MESSAGE_TYPE_CORE_SEND,
 			struct SendMessage,
 			NULL),
+ GNUNET_MQ_hd_fixed_size (client_shm_ack,
+			  GNUNET_MESSAGE_TYPE_CORE_SHM_ACK,
+			  struct ShmAckMessage,
+			  NULL),
+ GNUNET_MQ_hd_fixed_size (client_shm_notify,
+			  GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY,
+			  struct GNUNET_MessageHeader,
+			  NULL),
  GNUNET_MQ_handler_end ());
 
 
@@ -64,6 +64,12 @@
  */
 #define MAX_MESSAGE_AGE GNUNET_TIME_UNIT_DAYS
 
+/**
+ * Flag in the @e flags of a PONG: the sender of the PONG accepts
+ * #GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE_AEAD messages.
+ */
+#define PONG_FLAG_AEAD 1
+
 
 
 GNUNET_NETWORK_STRUCT_BEGIN
@@ -171,9 +177,10 @@ struct PongMessage
   uint32_t challenge GNUNET_PACKED;
 
   /**
-   * Reserved, always zero.
+   * Capabilities of the sender (#PONG_FLAG_AEAD), in NBO.  Peers
+   * without such capabilities always set this to zero.
    */
-  uint32_t reserved;
+  uint32_t flags GNUNET_PACKED;
 
   /**
    * Intended target of the PING, used primarily to check
@@ -226,6 +233,50 @@ struct EncryptedMessage
   struct GNUNET_TIME_AbsoluteNBO timestamp;
 
 };
+
+
+/**
+ * Encapsulation for encrypted messages exchanged between peers that
+ * both support authenticated encryption.  Encryption and integrity
+ * protection are done in a single pass.  Followed by the actual
+ * encrypted data.
+ */
+struct AeadEncryptedMessage
+{
+  /**
+   * Message type is #GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE_AEAD.
+   * Authenticated, but not encrypted.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Random nonce for the encryption.
+   */
+  struct GNUNET_CRYPTO_AeadNonce nonce;
+
+  /**
+   * Authentication tag of the header and the encrypted data.
+   */
+  struct GNUNET_CRYPTO_AeadTag tag;
+
+  /**
+   * Sequence number, in network byte order.  This field
+   * must be the first encrypted/decrypted field
+   */
+  uint32_t sequence_number GNUNET_PACKED;
+
+  /**
+   * Reserved, always zero.
+   */
+  uint32_t reserved GNUNET_PACKED;
+
+  /**
+   * Timestamp.  Used to prevent replay of ancient messages
+   * (recent messages are caught with the sequence number).
+   */
+  struct GNUNET_TIME_AbsoluteNBO timestamp;
+
+};
 GNUNET_NETWORK_STRUCT_END
 
 
@@ -235,6 +286,12 @@ GNUNET_NETWORK_STRUCT_END
  */
 #define ENCRYPTED_HEADER_SIZE (offsetof(struct EncryptedMessage, sequence_number))
 
+/**
+ * Number of bytes (at the beginning) of `struct AeadEncryptedMessage`
+ * that are NOT encrypted.
+ */
+#define AEAD_HEADER_SIZE (offsetof(struct AeadEncryptedMessage, sequence_number))
+
 
 /**
  * Information about the status of a key exchange with another peer.
@@ -284,6 +341,18 @@ struct GSC_KeyExchangeInfo
    */
   struct GNUNET_CRYPTO_SymmetricSessionKey decrypt_key;
 
+  /**
+   * Key we use for authenticated encryption of our messages
+   * for the other peer.
+   */
+  struct GNUNET_CRYPTO_SymmetricSessionKey encrypt_aead_key;
+
+  /**
+   * Key we use for authenticated decryption of messages
+   * from the other peer.
+   */
+  struct GNUNET_CRYPTO_SymmetricSessionKey decrypt_aead_key;
+
   /**
    * At what time did the other peer generate the decryption key?
    */
@@ -314,6 +383,17 @@ struct GSC_KeyExchangeInfo
    */
   struct GNUNET_SCHEDULER_Task *keep_alive_task;
 
+  /**
+   * When did we last transmit our PING?
+   */
+  struct GNUNET_TIME_Absolute ping_time;
+
+  /**
+   * Smoothed round-trip time to the peer, measured from PING to
+   * PONG; #GNUNET_TIME_UNIT_FOREVER_REL until we have a sample.
+   */
+  struct GNUNET_TIME_Relative rtt;
+
   /**
    * Bit map indicating which of the 32 sequence numbers before the
    * last were received (good for accepting out-of-order packets and
@@ -341,6 +421,12 @@ struct GSC_KeyExchangeInfo
    */
   int has_excess_bandwidth;
 
+  /**
+   * #GNUNET_YES if the other peer confirmed (in a PONG for the
+   * current key) that it accepts authenticated encryption.
+   */
+  int peer_accepts_aead;
+
   /**
    * What is our connection status?
    */
@@ -395,6 +481,11 @@ static struct GNUNET_SCHEDULER_Task *rekey_task;
  */
 static struct GNUNET_NotificationContext *nc;
 
+/**
+ * #GNUNET_YES if we offer (and use) authenticated encryption.
+ */
+static int use_aead;
+
 
 /**
  * Calculate seed value we should use for a message.
@@ -533,6 +624,31 @@ derive_aes_key (const struct GNUNET_PeerIdentity *sender,
 }
 
 
+/**
+ * Derive a key for authenticated encryption from key material
+ *
+ * @param sender peer identity of the sender
+ * @param receiver peer identity of the sender
+ * @param key_material high entropy key material to use
+ * @param skey set to derived session key
+ */
+static void
+derive_aead_key (const struct GNUNET_PeerIdentity *sender,
+                 const struct GNUNET_PeerIdentity *receiver,
+                 const struct GNUNET_HashCode *key_material,
+                 struct GNUNET_CRYPTO_SymmetricSessionKey *skey)
+{
+  static const char ctx[] = "aead key generation vector";
+
+  GNUNET_CRYPTO_kdf (skey, sizeof (struct GNUNET_CRYPTO_SymmetricSessionKey),
+		     ctx, sizeof (ctx),
+		     key_material, sizeof (struct GNUNET_HashCode),
+		     sender, sizeof (struct GNUNET_PeerIdentity),
+		     receiver, sizeof (struct GNUNET_PeerIdentity),
+		     NULL);
+}
+
+
 /**
  * Encrypt size bytes from @a in and write the result to @a out.  Use the
  * @a kx key for outbound traffic of the given neighbour.
@@ -730,6 +846,7 @@ handle_transport_notify_connect (void *cls,
   kx->mq = mq;
   kx->peer = pid;
   kx->set_key_retry_frequency = INITIAL_SET_KEY_RETRY_FREQUENCY;
+  kx->rtt = GNUNET_TIME_UNIT_FOREVER_REL;
   GNUNET_CONTAINER_DLL_insert (kx_head,
 			       kx_tail,
 			       kx);
@@ -819,12 +936,32 @@ send_ping (struct GSC_KeyExchangeInfo *kx)
                             gettext_noop ("# PING messages transmitted"),
                             1,
                             GNUNET_NO);
+  kx->ping_time = GNUNET_TIME_absolute_get ();
   env = GNUNET_MQ_msg_copy (&kx->ping.header);
   GNUNET_MQ_send (kx->mq,
 		  env);
 }
 
 
+/**
+ * We got the PONG for our last PING, update the RTT estimate.
+ *
+ * @param kx key exchange context
+ */
+static void
+update_rtt (struct GSC_KeyExchangeInfo *kx)
+{
+  struct GNUNET_TIME_Relative sample;
+
+  sample = GNUNET_TIME_absolute_get_duration (kx->ping_time);
+  if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us == kx->rtt.rel_value_us)
+    kx->rtt = sample;
+  else
+    kx->rtt.rel_value_us
+      = (7 * kx->rtt.rel_value_us + sample.rel_value_us) / 8;
+}
+
+
 /**
  * Derive fresh session keys from the current ephemeral keys.
  *
@@ -851,10 +988,20 @@ derive_session_keys (struct GSC_KeyExchangeInfo *kx)
 		  &GSC_my_identity,
 		  &key_material,
 		  &kx->decrypt_key);
+  derive_aead_key (&GSC_my_identity,
+                   kx->peer,
+                   &key_material,
+                   &kx->encrypt_aead_key);
+  derive_aead_key (kx->peer,
+                   &GSC_my_identity,
+                   &key_material,
+                   &kx->decrypt_aead_key);
   memset (&key_material, 0, sizeof (key_material));
   /* fresh key, reset sequence numbers */
   kx->last_sequence_number_received = 0;
   kx->last_packets_bitmap = 0;
+  /* the other peer must confirm AEAD support for this key */
+  kx->peer_accepts_aead = GNUNET_NO;
   setup_fresh_ping (kx);
 }
 
@@ -1085,7 +1232,7 @@ handle_ping (void *cls,
     return;
   }
   /* construct PONG */
-  tx.reserved = 0;
+  tx.flags = (GNUNET_YES == use_aead) ? htonl (PONG_FLAG_AEAD) : 0;
   tx.challenge = t.challenge;
   tx.target = t.target;
   env = GNUNET_MQ_msg (tp,
@@ -1275,6 +1422,10 @@ handle_pong (void *cls,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received PONG from `%s'\n",
               GNUNET_i2s (kx->peer));
+  update_rtt (kx);
+  kx->peer_accepts_aead
+    = ( (GNUNET_YES == use_aead) &&
+        (0 != (ntohl (t.flags) & PONG_FLAG_AEAD)) ) ? GNUNET_YES : GNUNET_NO;
   /* no need to resend key any longer */
   if (NULL != kx->retry_set_key_task)
   {
@@ -1358,16 +1509,33 @@ send_key (struct GSC_KeyExchangeInfo *kx)
 
 
 /**
- * Encrypt and transmit a message with the given payload.
+ * An encrypted message left our queue towards the transport
+ * service; the session may assemble the next one.
+ *
+ * @param cls the `struct GSC_KeyExchangeInfo`
+ */
+static void
+encrypted_message_sent (void *cls)
+{
+  struct GSC_KeyExchangeInfo *kx = cls;
+
+  GSC_SESSIONS_solicit (kx->peer);
+}
+
+
+/**
+ * Encrypt a message with the given payload, using the legacy
+ * cipher and a separate HMAC.
  *
  * @param kx key exchange context
  * @param payload payload of the message
  * @param payload_size number of bytes in @a payload
+ * @return envelope with the encrypted message
  */
-void
-GSC_KX_encrypt_and_transmit (struct GSC_KeyExchangeInfo *kx,
-                             const void *payload,
-                             size_t payload_size)
+static struct GNUNET_MQ_Envelope *
+encrypt_legacy (struct GSC_KeyExchangeInfo *kx,
+                const void *payload,
+                size_t payload_size)
 {
   size_t used = payload_size + sizeof (struct EncryptedMessage);
   char pbuf[used];              /* plaintext */
@@ -1410,7 +1578,88 @@ GSC_KX_encrypt_and_transmit (struct GSC_KeyExchangeInfo *kx,
                       &em->sequence_number,
                       used - ENCRYPTED_HEADER_SIZE,
                       &em->hmac);
+  return env;
+}
+
+
+/**
+ * Encrypt a message with the given payload using authenticated
+ * encryption.  The payload is copied once into the envelope and
+ * encrypted in place.
+ *
+ * @param kx key exchange context
+ * @param payload payload of the message
+ * @param payload_size number of bytes in @a payload
+ * @return envelope with the encrypted message
+ */
+static struct GNUNET_MQ_Envelope *
+encrypt_aead (struct GSC_KeyExchangeInfo *kx,
+              const void *payload,
+              size_t payload_size)
+{
+  size_t used = payload_size + sizeof (struct AeadEncryptedMessage);
+  struct AeadEncryptedMessage *em;
+  struct GNUNET_MQ_Envelope *env;
+
+  env = GNUNET_MQ_msg_extra (em,
+			     payload_size,
+			     GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE_AEAD);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_NONCE,
+                              &em->nonce,
+                              sizeof (em->nonce));
+  em->sequence_number = htonl (++kx->last_sequence_number_sent);
+  em->reserved = 0;
+  em->timestamp = GNUNET_TIME_absolute_hton (GNUNET_TIME_absolute_get ());
+  GNUNET_memcpy (&em[1],
+		 payload,
+		 payload_size);
+  GNUNET_assert (used - AEAD_HEADER_SIZE ==
+                 GNUNET_CRYPTO_symmetric_aead_encrypt (&em->sequence_number,
+                                                       used - AEAD_HEADER_SIZE,
+                                                       &em->header,
+                                                       sizeof (em->header),
+                                                       &kx->encrypt_aead_key,
+                                                       &em->nonce,
+                                                       &em->sequence_number,
+                                                       &em->tag));
+  GNUNET_STATISTICS_update (GSC_stats,
+			    gettext_noop ("# bytes encrypted"),
+			    used - AEAD_HEADER_SIZE,
+                            GNUNET_NO);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Encrypted %u bytes for %s (AEAD)\n",
+              (unsigned int) (used - AEAD_HEADER_SIZE),
+              GNUNET_i2s (kx->peer));
+  return env;
+}
+
+
+/**
+ * Encrypt and transmit a message with the given payload.
+ *
+ * @param kx key exchange context
+ * @param payload payload of the message
+ * @param payload_size number of bytes in @a payload
+ */
+void
+GSC_KX_encrypt_and_transmit (struct GSC_KeyExchangeInfo *kx,
+                             const void *payload,
+                             size_t payload_size)
+{
+  struct GNUNET_MQ_Envelope *env;
+
+  if (GNUNET_YES == kx->peer_accepts_aead)
+    env = encrypt_aead (kx,
+                        payload,
+                        payload_size);
+  else
+    env = encrypt_legacy (kx,
+                          payload,
+                          payload_size);
   kx->has_excess_bandwidth = GNUNET_NO;
+  GNUNET_MQ_notify_sent (env,
+                         &encrypted_message_sent,
+                         kx);
   GNUNET_MQ_send (kx->mq,
 		  env);
 }
@@ -1435,57 +1684,23 @@ struct DeliverMessageContext
 
 
 /**
- * We received an encrypted message.  Check that it is
- * well-formed (size-wise).
+ * Check that the session with the other peer is up and its key
+ * still valid, so that we can accept encrypted messages.  If
+ * the key expired, restart the key exchange.
  *
- * @param cls key exchange context for encrypting the message
- * @param m encrypted message
- * @return #GNUNET_OK if @a msg is well-formed (size-wise)
+ * @param kx key exchange context
+ * @return #GNUNET_OK if encrypted messages can be processed
  */
 static int
-check_encrypted (void *cls,
-		 const struct EncryptedMessage *m)
+check_session_up (struct GSC_KeyExchangeInfo *kx)
 {
-  uint16_t size = ntohs (m->header.size) - sizeof (*m);
-
-  if (size < sizeof (struct GNUNET_MessageHeader))
-  {
-    GNUNET_break_op (0);
-    return GNUNET_SYSERR;
-  }
-  return GNUNET_OK;
-}
-
-
-/**
- * We received an encrypted message.  Decrypt, validate and
- * pass on to the appropriate clients.
- *
- * @param cls key exchange context for encrypting the message
- * @param m encrypted message
- */
-static void
-handle_encrypted (void *cls,
-		  const struct EncryptedMessage *m)
-{
-  struct GSC_KeyExchangeInfo *kx = cls;
-  struct EncryptedMessage *pt;  /* plaintext */
-  struct GNUNET_HashCode ph;
-  uint32_t snum;
-  struct GNUNET_TIME_Absolute t;
-  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
-  struct GNUNET_CRYPTO_AuthKey auth_key;
-  struct DeliverMessageContext dmc;
-  uint16_t size = ntohs (m->header.size);
-  char buf[size] GNUNET_ALIGN;
-
   if (GNUNET_CORE_KX_STATE_UP != kx->status)
   {
     GNUNET_STATISTICS_update (GSC_stats,
                               gettext_noop ("# DATA message dropped (out of order)"),
                               1,
                               GNUNET_NO);
-    return;
+    return GNUNET_NO;
   }
   if (0 == GNUNET_TIME_absolute_get_remaining (kx->foreign_key_expires).rel_value_us)
   {
@@ -1504,50 +1719,36 @@ handle_encrypted (void *cls,
     kx->status = GNUNET_CORE_KX_STATE_KEY_SENT;
     monitor_notify_all (kx);
     send_key (kx);
-    return;
+    return GNUNET_NO;
   }
+  return GNUNET_OK;
+}
 
-  /* validate hash */
-  derive_auth_key (&auth_key,
-                   &kx->decrypt_key,
-                   m->iv_seed);
-  GNUNET_CRYPTO_hmac (&auth_key,
-                      &m->sequence_number,
-                      size - ENCRYPTED_HEADER_SIZE,
-                      &ph);
-  if (0 != memcmp (&ph,
-                   &m->hmac,
-                   sizeof (struct GNUNET_HashCode)))
-  {
-    /* checksum failed */
-    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-		"Failed checksum validation for a message from `%s'\n",
-		GNUNET_i2s (kx->peer));
-    return;
-  }
-  derive_iv (&iv,
-             &kx->decrypt_key,
-             m->iv_seed,
-             &GSC_my_identity);
-  /* decrypt */
-  if (GNUNET_OK !=
-      do_decrypt (kx,
-                  &iv,
-                  &m->sequence_number,
-                  &buf[ENCRYPTED_HEADER_SIZE],
-                  size - ENCRYPTED_HEADER_SIZE))
-  {
-    GNUNET_break_op (0);
-    return;
-  }
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Decrypted %u bytes from %s\n",
-              (unsigned int) (size - ENCRYPTED_HEADER_SIZE),
-              GNUNET_i2s (kx->peer));
-  pt = (struct EncryptedMessage *) buf;
+
+/**
+ * We decrypted and authenticated a message from the other peer.
+ * Check sequence number and timestamp and pass the payload on to
+ * the appropriate clients.
+ *
+ * @param kx key exchange context
+ * @param snum sequence number of the message
+ * @param timestamp timestamp of the message
+ * @param payload the decrypted payload
+ * @param payload_size number of bytes in @a payload
+ * @param size size of the encrypted message (for statistics)
+ */
+static void
+deliver_plaintext (struct GSC_KeyExchangeInfo *kx,
+                   uint32_t snum,
+                   struct GNUNET_TIME_AbsoluteNBO timestamp,
+                   const char *payload,
+                   size_t payload_size,
+                   uint16_t size)
+{
+  struct GNUNET_TIME_Absolute t;
+  struct DeliverMessageContext dmc;
 
   /* validate sequence number */
-  snum = ntohl (pt->sequence_number);
   if (kx->last_sequence_number_received == snum)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -1599,7 +1800,7 @@ handle_encrypted (void *cls,
   }
 
   /* check timestamp */
-  t = GNUNET_TIME_absolute_ntoh (pt->timestamp);
+  t = GNUNET_TIME_absolute_ntoh (timestamp);
   if (GNUNET_TIME_absolute_get_duration (t).rel_value_us >
       MAX_MESSAGE_AGE.rel_value_us)
   {
@@ -1618,21 +1819,188 @@ handle_encrypted (void *cls,
   update_timeout (kx);
   GNUNET_STATISTICS_update (GSC_stats,
                             gettext_noop ("# bytes of payload decrypted"),
-                            size - sizeof (struct EncryptedMessage),
+                            payload_size,
                             GNUNET_NO);
   dmc.kx = kx;
   dmc.peer = kx->peer;
   if (GNUNET_OK !=
       GNUNET_SERVER_mst_receive (mst,
 				 &dmc,
-                                 &buf[sizeof (struct EncryptedMessage)],
-                                 size - sizeof (struct EncryptedMessage),
+                                 payload,
+                                 payload_size,
                                  GNUNET_YES,
                                  GNUNET_NO))
     GNUNET_break_op (0);
 }
 
 
+/**
+ * We received an encrypted message.  Check that it is
+ * well-formed (size-wise).
+ *
+ * @param cls key exchange context for encrypting the message
+ * @param m encrypted message
+ * @return #GNUNET_OK if @a msg is well-formed (size-wise)
+ */
+static int
+check_encrypted (void *cls,
+		 const struct EncryptedMessage *m)
+{
+  uint16_t size = ntohs (m->header.size) - sizeof (*m);
+
+  if (size < sizeof (struct GNUNET_MessageHeader))
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * We received an encrypted message.  Decrypt, validate and
+ * pass on to the appropriate clients.
+ *
+ * @param cls key exchange context for encrypting the message
+ * @param m encrypted message
+ */
+static void
+handle_encrypted (void *cls,
+		  const struct EncryptedMessage *m)
+{
+  struct GSC_KeyExchangeInfo *kx = cls;
+  struct EncryptedMessage *pt;  /* plaintext */
+  struct GNUNET_HashCode ph;
+  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+  struct GNUNET_CRYPTO_AuthKey auth_key;
+  uint16_t size = ntohs (m->header.size);
+  char buf[size] GNUNET_ALIGN;
+
+  if (GNUNET_OK != check_session_up (kx))
+    return;
+
+  /* validate hash */
+  derive_auth_key (&auth_key,
+                   &kx->decrypt_key,
+                   m->iv_seed);
+  GNUNET_CRYPTO_hmac (&auth_key,
+                      &m->sequence_number,
+                      size - ENCRYPTED_HEADER_SIZE,
+                      &ph);
+  if (0 != memcmp (&ph,
+                   &m->hmac,
+                   sizeof (struct GNUNET_HashCode)))
+  {
+    /* checksum failed */
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+		"Failed checksum validation for a message from `%s'\n",
+		GNUNET_i2s (kx->peer));
+    return;
+  }
+  derive_iv (&iv,
+             &kx->decrypt_key,
+             m->iv_seed,
+             &GSC_my_identity);
+  /* decrypt */
+  if (GNUNET_OK !=
+      do_decrypt (kx,
+                  &iv,
+                  &m->sequence_number,
+                  &buf[ENCRYPTED_HEADER_SIZE],
+                  size - ENCRYPTED_HEADER_SIZE))
+  {
+    GNUNET_break_op (0);
+    return;
+  }
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Decrypted %u bytes from %s\n",
+              (unsigned int) (size - ENCRYPTED_HEADER_SIZE),
+              GNUNET_i2s (kx->peer));
+  pt = (struct EncryptedMessage *) buf;
+  deliver_plaintext (kx,
+                     ntohl (pt->sequence_number),
+                     pt->timestamp,
+                     &buf[sizeof (struct EncryptedMessage)],
+                     size - sizeof (struct EncryptedMessage),
+                     size);
+}
+
+
+/**
+ * We received a message encrypted with authenticated encryption.
+ * Check that it is well-formed (size-wise).
+ *
+ * @param cls key exchange context for encrypting the message
+ * @param m encrypted message
+ * @return #GNUNET_OK if @a msg is well-formed (size-wise)
+ */
+static int
+check_encrypted_aead (void *cls,
+                      const struct AeadEncryptedMessage *m)
+{
+  uint16_t size = ntohs (m->header.size) - sizeof (*m);
+
+  if (size < sizeof (struct GNUNET_MessageHeader))
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * We received a message encrypted with authenticated encryption.
+ * Decrypt and authenticate it in one pass and pass it on to the
+ * appropriate clients.
+ *
+ * @param cls key exchange context for encrypting the message
+ * @param m encrypted message
+ */
+static void
+handle_encrypted_aead (void *cls,
+                       const struct AeadEncryptedMessage *m)
+{
+  struct GSC_KeyExchangeInfo *kx = cls;
+  struct AeadEncryptedMessage *pt;  /* plaintext */
+  uint16_t size = ntohs (m->header.size);
+  char buf[size] GNUNET_ALIGN;
+
+  if (GNUNET_OK != check_session_up (kx))
+    return;
+  if (size - AEAD_HEADER_SIZE !=
+      GNUNET_CRYPTO_symmetric_aead_decrypt (&m->sequence_number,
+                                            size - AEAD_HEADER_SIZE,
+                                            &m->header,
+                                            sizeof (m->header),
+                                            &kx->decrypt_aead_key,
+                                            &m->nonce,
+                                            &m->tag,
+                                            &buf[AEAD_HEADER_SIZE]))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+		"Failed authentication of a message from `%s'\n",
+		GNUNET_i2s (kx->peer));
+    return;
+  }
+  GNUNET_STATISTICS_update (GSC_stats,
+                            gettext_noop ("# bytes decrypted"),
+                            size - AEAD_HEADER_SIZE,
+                            GNUNET_NO);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Decrypted %u bytes from %s (AEAD)\n",
+              (unsigned int) (size - AEAD_HEADER_SIZE),
+              GNUNET_i2s (kx->peer));
+  pt = (struct AeadEncryptedMessage *) buf;
+  deliver_plaintext (kx,
+                     ntohl (pt->sequence_number),
+                     pt->timestamp,
+                     &buf[sizeof (struct AeadEncryptedMessage)],
+                     size - sizeof (struct AeadEncryptedMessage),
+                     size);
+}
+
+
 /**
  * One of our neighbours has excess bandwidth, remember this.
  *
@@ -1810,9 +2178,18 @@ GSC_KX_init (struct GNUNET_CRYPTO_EddsaPrivateKey *pk)
                            GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE,
                            struct EncryptedMessage,
                            NULL),
+    GNUNET_MQ_hd_var_size (encrypted_aead,
+                           GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE_AEAD,
+                           struct AeadEncryptedMessage,
+                           NULL),
     GNUNET_MQ_handler_end()
   };
 
+  use_aead = GNUNET_CONFIGURATION_get_value_yesno (GSC_cfg,
+                                                   "core",
+                                                   "USE_AEAD");
+  if (GNUNET_SYSERR == use_aead)
+    use_aead = GNUNET_YES;
   my_private_key = pk;
   GNUNET_CRYPTO_eddsa_key_get_public (my_private_key,
                                       &GSC_my_identity.public_key);
@@ -1900,6 +2277,19 @@ GSC_NEIGHBOURS_get_queue_length (const struct GSC_KeyExchangeInfo *kxinfo)
 }
 
 
+/**
+ * Get the smoothed round-trip time to the given neighbour.
+ *
+ * @param kxinfo key exchange of the neighbour
+ * @return RTT estimate, #GNUNET_TIME_UNIT_FOREVER_REL if unknown
+ */
+struct GNUNET_TIME_Relative
+GSC_NEIGHBOURS_get_rtt (const struct GSC_KeyExchangeInfo *kxinfo)
+{
+  return kxinfo->rtt;
+}
+
+
 /**
  * Check if the given neighbour has excess bandwidth available.
  *
@@ -76,6 +76,16 @@ int
 GSC_NEIGHBOURS_check_excess_bandwidth (const struct GSC_KeyExchangeInfo *target);
 
 
+/**
+ * Get the smoothed round-trip time to the given neighbour.
+ *
+ * @param target neighbour to check
+ * @return RTT estimate, #GNUNET_TIME_UNIT_FOREVER_REL if unknown
+ */
+struct GNUNET_TIME_Relative
+GSC_NEIGHBOURS_get_rtt (const struct GSC_KeyExchangeInfo *target);
+
+
 /**
  * Check how many messages are queued for the given neighbour.
  *
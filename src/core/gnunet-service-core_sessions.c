@@ -38,6 +38,14 @@
  */
 #define MAX_ENCRYPTED_MESSAGE_QUEUE_SIZE 4
 
+/**
+ * Largest plaintext we can put into one encrypted message: 64k
+ * minus the headers of core and transport, that is 65399 bytes.
+ */
+#define MAX_FRAME_SIZE (GNUNET_SERVER_MAX_MESSAGE_SIZE - 1 \
+                        - GNUNET_CONSTANTS_CORE_SIZE_ENCRYPTED_MESSAGE \
+                        - 48 /* struct OutboundMessage of transport */)
+
 
 /**
  * Message ready for encryption.  This struct is followed by the
@@ -194,6 +202,13 @@ GNUNET_NETWORK_STRUCT_END
  */
 static struct GNUNET_CONTAINER_MultiPeerMap *sessions;
 
+/**
+ * How many bytes of messages do we combine into one encrypted
+ * message at most?  Messages larger than this are sent on
+ * their own.
+ */
+static unsigned long long frame_size;
+
 
 /**
  * Find the session for the given peer.
@@ -588,7 +603,8 @@ solicit_messages (struct Session *session,
     nxt = car->next;
     if (car->priority < pmax)
       continue;
-    if (so_size + car->msize > GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE)
+    if ( (so_size > 0) &&
+         (so_size + car->msize > frame_size) )
       break;
     so_size += car->msize;
     if (GNUNET_YES == car->was_solicited)
@@ -623,6 +639,48 @@ pop_cork_task (void *cls)
 }
 
 
+/**
+ * How long may messages that allow corking wait for others to
+ * join them?  Half the RTT, as waiting much longer would
+ * noticeably add to the latency the application sees anyway.
+ *
+ * @param session session to compute the cork delay for
+ * @return cork delay to use
+ */
+static struct GNUNET_TIME_Relative
+get_cork_delay (const struct Session *session)
+{
+  struct GNUNET_TIME_Relative rtt;
+
+  rtt = GSC_NEIGHBOURS_get_rtt (session->kx);
+  if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us == rtt.rel_value_us)
+    return GNUNET_CONSTANTS_MAX_CORK_DELAY;
+  return GNUNET_TIME_relative_min (GNUNET_CONSTANTS_MAX_CORK_DELAY,
+                                   GNUNET_TIME_relative_divide (rtt,
+                                                                2));
+}
+
+
+/**
+ * How many bytes must be ready before we transmit corked messages
+ * ahead of their deadline?  Half a frame if the transport is idle;
+ * the more encrypted messages are still waiting at the transport,
+ * the longer a new one would wait anyway, so we ask for a fuller
+ * frame.
+ *
+ * @param session session to compute the threshold for
+ * @return number of bytes
+ */
+static size_t
+get_cork_threshold (const struct Session *session)
+{
+  unsigned int qlen;
+
+  qlen = GSC_NEIGHBOURS_get_queue_length (session->kx);
+  return frame_size * (qlen + 1) / (qlen + 2);
+}
+
+
 /**
  * Try to perform a transmission on the given session. Will solicit
  * additional messages if the 'sme' queue is not full enough or has
@@ -666,8 +724,9 @@ try_transmission (struct Session *session)
     maxp = GNUNET_CORE_PRIO_BEST_EFFORT;
   /* determine highest priority of 'ready' messages we already solicited from clients */
   pos = session->sme_head;
-  while ((NULL != pos) &&
-         (msize + pos->size <= GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE))
+  while ( (NULL != pos) &&
+          ( (0 == msize) ||
+            (msize + pos->size <= frame_size) ) )
   {
     GNUNET_assert (pos->size < GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE);
     msize += pos->size;
@@ -721,7 +780,7 @@ try_transmission (struct Session *session)
   if ( ( (GNUNET_YES == excess) ||
          (maxpc >= GNUNET_CORE_PRIO_BEST_EFFORT) ) &&
        ( (0 == msize) ||
-         ( (msize < GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE / 2) &&
+         ( (msize < get_cork_threshold (session)) &&
            (min_deadline.abs_value_us > now.abs_value_us))) )
   {
     /* not enough ready yet (tiny message & cork possible), or no messages at all,
@@ -746,6 +805,11 @@ try_transmission (struct Session *session)
                                                           GNUNET_YES));
       if (NULL != session->cork_task)
         GNUNET_SCHEDULER_cancel (session->cork_task);
+      else
+        GNUNET_STATISTICS_update (GSC_stats,
+                                  gettext_noop ("# encrypted messages corked"),
+                                  1,
+                                  GNUNET_NO);
       session->cork_task
         = GNUNET_SCHEDULER_add_at (min_deadline,
                                    &pop_cork_task,
@@ -929,7 +993,7 @@ GSC_SESSIONS_transmit (struct GSC_ClientActiveRequest *car,
   if (GNUNET_YES == cork)
   {
     sme->deadline =
-        GNUNET_TIME_relative_to_absolute (GNUNET_CONSTANTS_MAX_CORK_DELAY);
+        GNUNET_TIME_relative_to_absolute (get_cork_delay (session));
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
 		"Mesage corked, delaying transmission\n");
   }
@@ -1059,6 +1123,23 @@ GSC_SESSIONS_init ()
 {
   sessions = GNUNET_CONTAINER_multipeermap_create (128,
                                                    GNUNET_YES);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_size (GSC_cfg,
+                                           "CORE",
+                                           "MAX_FRAME_SIZE",
+                                           &frame_size))
+    frame_size = GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE;
+  if ( (frame_size < 1024) ||
+       (frame_size > MAX_FRAME_SIZE) )
+  {
+    GNUNET_log_config_invalid (GNUNET_ERROR_TYPE_WARNING,
+                               "CORE",
+                               "MAX_FRAME_SIZE",
+                               _("must be between 1 KiB and 64 KiB"));
+    frame_size = GNUNET_MIN (MAX_FRAME_SIZE,
+                             GNUNET_MAX (1024,
+                                         frame_size));
+  }
 }
 
 
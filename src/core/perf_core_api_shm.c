@@ -0,0 +1,352 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file core/perf_core_api_shm.c
+ * @brief measure the rate of small messages a client can send to
+ *        itself via CORE, over shared memory and over the socket
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_testing_lib.h"
+#include "gnunet_protocols.h"
+#include "gnunet_core_service.h"
+#include <gauger.h>
+
+/**
+ * Number of messages to send in each round.
+ */
+#define TOTAL_MSGS (1024 * 32)
+
+/**
+ * Number of messages in flight.
+ */
+#define WINDOW 64
+
+/**
+ * Size of the payload of each message.
+ */
+#define PAYLOAD_SIZE 64
+
+/**
+ * How long until we give up?
+ */
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 5)
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+struct TestMessage
+{
+  /**
+   * Header with type #GNUNET_MESSAGE_TYPE_DUMMY.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Sequence number.
+   */
+  uint32_t num GNUNET_PACKED;
+
+  /**
+   * Payload.
+   */
+  char payload[PAYLOAD_SIZE];
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+/**
+ * Final status code.
+ */
+static int ret;
+
+/**
+ * Configuration of the peer.
+ */
+static const struct GNUNET_CONFIGURATION_Handle *peer_cfg;
+
+/**
+ * Configuration of the client in the current round.
+ */
+static struct GNUNET_CONFIGURATION_Handle *client_cfg;
+
+/**
+ * Handle to the cleanup task.
+ */
+static struct GNUNET_SCHEDULER_Task *die_task;
+
+/**
+ * Identity of this peer.
+ */
+static struct GNUNET_PeerIdentity myself;
+
+/**
+ * The handle to core.
+ */
+static struct GNUNET_CORE_Handle *core;
+
+/**
+ * Queue to send to ourselves.
+ */
+static struct GNUNET_MQ_Handle *self_mq;
+
+/**
+ * When did we start the current round?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * Round we are in, 0 for shared memory, 1 for the socket.
+ */
+static unsigned int round_num;
+
+/**
+ * Messages sent in the current round.
+ */
+static unsigned int sent;
+
+/**
+ * Messages received in the current round.
+ */
+static unsigned int received;
+
+/**
+ * Message rate measured in each round.
+ */
+static unsigned long long rates[2];
+
+
+/**
+ * Function scheduled as very last function, cleans up after us
+ */
+static void
+cleanup (void *cls)
+{
+  if (NULL != die_task)
+  {
+    GNUNET_SCHEDULER_cancel (die_task);
+    die_task = NULL;
+  }
+  if (NULL != core)
+  {
+    GNUNET_CORE_disconnect (core);
+    core = NULL;
+  }
+  if (NULL != client_cfg)
+  {
+    GNUNET_CONFIGURATION_destroy (client_cfg);
+    client_cfg = NULL;
+  }
+}
+
+
+static void
+do_timeout (void *cls)
+{
+  GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+              "Test timeout.\n");
+  die_task = NULL;
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Send the next message to ourselves.
+ */
+static void
+send_message ()
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct TestMessage *tm;
+
+  env = GNUNET_MQ_msg (tm,
+                       GNUNET_MESSAGE_TYPE_DUMMY);
+  tm->num = htonl (sent++);
+  memset (tm->payload,
+          (int) sent,
+          sizeof (tm->payload));
+  GNUNET_MQ_send (self_mq,
+                  env);
+}
+
+
+/**
+ * Start the next round.
+ *
+ * @param cls NULL
+ */
+static void
+start_round (void *cls);
+
+
+static void
+handle_test (void *cls,
+             const struct TestMessage *tm)
+{
+  if (ntohl (tm->num) != received)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Expected message %u, got %u\n",
+                received,
+                ntohl (tm->num));
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  received++;
+  if (0 == (received % (TOTAL_MSGS / 100)))
+    FPRINTF (stderr, "%s", ".");
+  if (sent < TOTAL_MSGS)
+  {
+    send_message ();
+    return;
+  }
+  if (received < TOTAL_MSGS)
+    return;
+  rates[round_num] = (1000LL * 1000LL * TOTAL_MSGS)
+    / GNUNET_MAX (1, GNUNET_TIME_absolute_get_duration (start_time).rel_value_us);
+  round_num++;
+  if (2 == round_num)
+  {
+    ret = 0;
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  GNUNET_SCHEDULER_add_now (&start_round,
+                            NULL);
+}
+
+
+static void
+init (void *cls,
+      const struct GNUNET_PeerIdentity *my_identity)
+{
+  if (NULL == my_identity)
+  {
+    GNUNET_break (0);
+    return;
+  }
+  myself = *my_identity;
+}
+
+
+static void *
+connect_cb (void *cls,
+            const struct GNUNET_PeerIdentity *peer,
+            struct GNUNET_MQ_Handle *mq)
+{
+  if (0 != memcmp (peer,
+                   &myself,
+                   sizeof (struct GNUNET_PeerIdentity)))
+    return NULL;
+  self_mq = mq;
+  start_time = GNUNET_TIME_absolute_get ();
+  while ( (sent < WINDOW) &&
+          (sent < TOTAL_MSGS) )
+    send_message ();
+  return NULL;
+}
+
+
+static void
+start_round (void *cls)
+{
+  struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (test,
+                             GNUNET_MESSAGE_TYPE_DUMMY,
+                             struct TestMessage,
+                             NULL),
+    GNUNET_MQ_handler_end ()
+  };
+
+  if (NULL != core)
+  {
+    GNUNET_CORE_disconnect (core);
+    core = NULL;
+  }
+  if (NULL != client_cfg)
+    GNUNET_CONFIGURATION_destroy (client_cfg);
+  client_cfg = GNUNET_CONFIGURATION_dup (peer_cfg);
+  GNUNET_CONFIGURATION_set_value_string (client_cfg,
+                                         "core",
+                                         "USE_SHM",
+                                         (0 == round_num) ? "YES" : "NO");
+  sent = 0;
+  received = 0;
+  self_mq = NULL;
+  core = GNUNET_CORE_connect (client_cfg,
+                              NULL,
+                              &init,
+                              &connect_cb,
+                              NULL,
+                              handlers);
+  if (NULL == core)
+    GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Main function that will be run by the scheduler.
+ *
+ * @param cls closure
+ * @param cfg configuration
+ * @param peer handle to the peer
+ */
+static void
+run (void *cls,
+     const struct GNUNET_CONFIGURATION_Handle *cfg,
+     struct GNUNET_TESTING_Peer *peer)
+{
+  peer_cfg = cfg;
+  GNUNET_SCHEDULER_add_shutdown (&cleanup,
+                                 NULL);
+  die_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
+                                           &do_timeout,
+                                           NULL);
+  start_round (NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  ret = 1;
+  if (0 != GNUNET_TESTING_peer_run ("perf-core-api-shm",
+                                    "test_core_api_peer1.conf",
+                                    &run, NULL))
+    return 1;
+  if (0 != ret)
+    return ret;
+  FPRINTF (stderr,
+           "\nShared memory: %llu messages/s, socket: %llu messages/s\n",
+           rates[0],
+           rates[1]);
+  GAUGER ("CORE",
+          "Loopback message rate (shared memory)",
+          rates[0],
+          "messages/s");
+  GAUGER ("CORE",
+          "Loopback message rate (socket)",
+          rates[1],
+          "messages/s");
+  return 0;
+}
+
+/* end of perf_core_api_shm.c */
@@ -26,6 +26,19 @@
 #include "gnunet_fragmentation_lib.h"
 #include "fragmentation.h"
 
+/**
+ * Reassembly buffers are allocated in multiples of this size, so
+ * that a released buffer fits many of the messages that follow.
+ */
+#define MC_BUFFER_GRANULARITY 4096
+
+/**
+ * How many bytes of reassembly buffers do we keep around for
+ * reuse at most?
+ */
+#define MC_POOL_MAX_BYTES (1024 * 1024)
+
+
 /**
  * Timestamps for fragments.
  */
@@ -72,6 +85,12 @@ struct MessageContext
    */
   const struct GNUNET_MessageHeader *msg;
 
+  /**
+   * Number of bytes available for the message at the end
+   * of this struct.
+   */
+  size_t buf_size;
+
   /**
    * Last time we received any update for this message
    * (least-recently updated message will be discarded
@@ -194,6 +213,98 @@ struct GNUNET_DEFRAGMENT_Context
 };
 
 
+/**
+ * Message contexts that are not in use, kept for reuse (singly
+ * linked via @e next).  Shared by all defragmentation contexts of
+ * the process, as those come and go with the peers we talk to.
+ */
+static struct MessageContext *mc_pool;
+
+/**
+ * Sum of the @e buf_size of the contexts in #mc_pool.
+ */
+static size_t mc_pool_bytes;
+
+
+/**
+ * Get a message context able to reassemble a message of
+ * @a msize bytes, reusing a released one if possible.
+ *
+ * @param msize size of the message to reassemble
+ * @return a zeroed message context
+ */
+static struct MessageContext *
+mc_alloc (uint16_t msize)
+{
+  struct MessageContext *mc;
+  struct MessageContext **prev;
+  size_t buf_size;
+
+  for (prev = &mc_pool; NULL != (mc = *prev); prev = &mc->next)
+  {
+    if (mc->buf_size < msize)
+      continue;
+    *prev = mc->next;
+    mc_pool_bytes -= mc->buf_size;
+    buf_size = mc->buf_size;
+    memset (mc,
+            0,
+            sizeof (struct MessageContext));
+    mc->buf_size = buf_size;
+    mc->msg = (const struct GNUNET_MessageHeader *) &mc[1];
+    return mc;
+  }
+  buf_size = ((msize + MC_BUFFER_GRANULARITY - 1) / MC_BUFFER_GRANULARITY)
+    * MC_BUFFER_GRANULARITY;
+  mc = GNUNET_malloc (sizeof (struct MessageContext) + buf_size);
+  mc->buf_size = buf_size;
+  mc->msg = (const struct GNUNET_MessageHeader *) &mc[1];
+  return mc;
+}
+
+
+/**
+ * Release a message context, keeping it for reuse unless we
+ * already have enough of those.
+ *
+ * @param mc the message context, no longer in any list
+ */
+static void
+mc_release (struct MessageContext *mc)
+{
+  if (NULL != mc->ack_task)
+  {
+    GNUNET_SCHEDULER_cancel (mc->ack_task);
+    mc->ack_task = NULL;
+  }
+  if (mc_pool_bytes + mc->buf_size > MC_POOL_MAX_BYTES)
+  {
+    GNUNET_free (mc);
+    return;
+  }
+  mc->next = mc_pool;
+  mc_pool = mc;
+  mc_pool_bytes += mc->buf_size;
+}
+
+
+/**
+ * Free the message contexts kept for reuse.
+ */
+void __attribute__ ((destructor))
+GNUNET_DEFRAGMENT_pool_fini ()
+{
+  struct MessageContext *mc;
+
+  while (NULL != (mc = mc_pool))
+  {
+    mc_pool = mc->next;
+    GNUNET_free (mc);
+  }
+  mc_pool_bytes = 0;
+}
+
+
 /**
  * Create a defragmentation context.
  *
@@ -242,12 +353,7 @@ GNUNET_DEFRAGMENT_context_destroy (struct GNUNET_DEFRAGMENT_Context *dc)
   {
     GNUNET_CONTAINER_DLL_remove (dc->head, dc->tail, mc);
     dc->list_size--;
-    if (NULL != mc->ack_task)
-    {
-      GNUNET_SCHEDULER_cancel (mc->ack_task);
-      mc->ack_task = NULL;
-    }
-    GNUNET_free (mc);
+    mc_release (mc);
   }
   GNUNET_assert (0 == dc->list_size);
   GNUNET_free (dc);
@@ -397,12 +503,7 @@ discard_oldest_mc (struct GNUNET_DEFRAGMENT_Context *dc)
   GNUNET_assert (NULL != old);
   GNUNET_CONTAINER_DLL_remove (dc->head, dc->tail, old);
   dc->list_size--;
-  if (NULL != old->ack_task)
-  {
-    GNUNET_SCHEDULER_cancel (old->ack_task);
-    old->ack_task = NULL;
-  }
-  GNUNET_free (old);
+  mc_release (old);
 }
 
 
@@ -494,8 +595,9 @@ GNUNET_DEFRAGMENT_process_fragment (struct GNUNET_DEFRAGMENT_Context *dc,
   now = GNUNET_TIME_absolute_get ();
   if (NULL == mc)
   {
-    mc = GNUNET_malloc (sizeof (struct MessageContext) + msize);
-    mc->msg = (const struct GNUNET_MessageHeader *) &mc[1];
+    if (dc->list_size >= dc->num_msgs)
+      discard_oldest_mc (dc);
+    mc = mc_alloc (msize);
     mc->dc = dc;
     mc->total_size = msize;
     mc->fragment_id = fid;
@@ -507,8 +609,6 @@ GNUNET_DEFRAGMENT_process_fragment (struct GNUNET_DEFRAGMENT_Context *dc,
       mc->bits = UINT64_MAX;    /* set all 64 bit */
     else
       mc->bits = (1LLU << n) - 1;        /* set lowest 'bits' bit */
-    if (dc->list_size >= dc->num_msgs)
-      discard_oldest_mc (dc);
     GNUNET_CONTAINER_DLL_insert (dc->head,
                                  dc->tail,
                                  mc);
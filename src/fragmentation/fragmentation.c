@@ -70,9 +70,13 @@ struct GNUNET_FRAGMENT_Context
   struct GNUNET_TIME_Absolute last_round;
 
   /**
-   * Message to fragment (allocated at the end of this struct).
+   * The fragments of the message, allocated at the end of this
+   * struct.  Fragment i starts at offset i * @e mtu; the message
+   * payload is copied in once, leaving room for a
+   * `struct FragmentHeader` in front of each piece, so that
+   * fragments can be handed to @e proc without copying.
    */
-  const struct GNUNET_MessageHeader *msg;
+  char *frags;
 
   /**
    * Function to call for transmissions.
@@ -135,6 +139,11 @@ struct GNUNET_FRAGMENT_Context
    */
   uint16_t mtu;
 
+  /**
+   * Size of the message we are fragmenting (in host byte order).
+   */
+  uint16_t msg_size;
+
 };
 
 
@@ -172,8 +181,6 @@ static void
 transmit_next (void *cls)
 {
   struct GNUNET_FRAGMENT_Context *fc = cls;
-  char msg[fc->mtu];
-  const char *mbuf;
   struct FragmentHeader *fh;
   struct GNUNET_TIME_Relative delay;
   unsigned int bit;
@@ -193,7 +200,7 @@ transmit_next (void *cls)
     wrap |= (0 == fc->next_transmission);
   }
   bit = fc->next_transmission;
-  size = ntohs (fc->msg->size);
+  size = fc->msg_size;
   if (bit == size / (fc->mtu - sizeof (struct FragmentHeader)))
     fsize =
         (size % (fc->mtu - sizeof (struct FragmentHeader))) +
@@ -224,16 +231,13 @@ transmit_next (void *cls)
     wrap |= (0 == fc->next_transmission);
   }
 
-  /* assemble fragmentation message */
-  mbuf = (const char *) &fc[1];
-  fh = (struct FragmentHeader *) msg;
+  /* assemble fragmentation message; the payload is already in place */
+  fh = (struct FragmentHeader *) &fc->frags[bit * fc->mtu];
   fh->header.size = htons (fsize);
   fh->header.type = htons (GNUNET_MESSAGE_TYPE_FRAGMENT);
   fh->fragment_id = htonl (fc->fragment_id);
-  fh->total_size = fc->msg->size;       /* already in big-endian */
+  fh->total_size = htons (fc->msg_size);
   fh->offset = htons ((fc->mtu - sizeof (struct FragmentHeader)) * bit);
-  GNUNET_memcpy (&fh[1], &mbuf[bit * (fc->mtu - sizeof (struct FragmentHeader))],
-          fsize - sizeof (struct FragmentHeader));
   if (NULL != fc->tracker)
     GNUNET_BANDWIDTH_tracker_consume (fc->tracker, fsize);
   GNUNET_STATISTICS_update (fc->stats,
@@ -248,7 +252,7 @@ transmit_next (void *cls)
 
   /* select next message to calculate delay */
   bit = fc->next_transmission;
-  size = ntohs (fc->msg->size);
+  size = fc->msg_size;
   if (bit == size / (fc->mtu - sizeof (struct FragmentHeader)))
     fsize = size % (fc->mtu - sizeof (struct FragmentHeader));
   else
@@ -318,8 +322,12 @@ GNUNET_FRAGMENT_context_create (struct GNUNET_STATISTICS_Handle *stats,
                                 void *proc_cls)
 {
   struct GNUNET_FRAGMENT_Context *fc;
+  const char *mbuf;
   size_t size;
+  size_t psize;
+  size_t off;
   uint64_t bits;
+  unsigned int i;
 
   GNUNET_STATISTICS_update (stats,
                             _("# messages fragmented"),
@@ -331,24 +339,31 @@ GNUNET_FRAGMENT_context_create (struct GNUNET_STATISTICS_Handle *stats,
                             _("# total size of fragmented messages"),
                             size, GNUNET_NO);
   GNUNET_assert (size >= sizeof (struct GNUNET_MessageHeader));
-  fc = GNUNET_malloc (sizeof (struct GNUNET_FRAGMENT_Context) + size);
+  psize = mtu - sizeof (struct FragmentHeader);
+  bits = (size + psize - 1) / psize;
+  GNUNET_assert (bits <= 64);
+  fc = GNUNET_malloc (sizeof (struct GNUNET_FRAGMENT_Context)
+                      + size + bits * sizeof (struct FragmentHeader));
   fc->stats = stats;
   fc->mtu = mtu;
+  fc->msg_size = (uint16_t) size;
   fc->tracker = tracker;
   fc->ack_delay = ack_delay;
   fc->msg_delay = msg_delay;
-  fc->msg = (const struct GNUNET_MessageHeader *) &fc[1];
+  fc->frags = (char *) &fc[1];
   fc->proc = proc;
   fc->proc_cls = proc_cls;
   fc->fragment_id =
       GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
                                 UINT32_MAX);
-  GNUNET_memcpy (&fc[1], msg, size);
-  bits =
-      (size + mtu - sizeof (struct FragmentHeader) - 1) / (mtu -
-                                                           sizeof (struct
-                                                                   FragmentHeader));
-  GNUNET_assert (bits <= 64);
+  mbuf = (const char *) msg;
+  for (i = 0; i < bits; i++)
+  {
+    off = i * psize;
+    GNUNET_memcpy (&fc->frags[i * mtu + sizeof (struct FragmentHeader)],
+                   &mbuf[off],
+                   GNUNET_MIN (psize, size - off));
+  }
   if (bits == 64)
     fc->acks_mask = UINT64_MAX; /* set all 64 bit */
   else
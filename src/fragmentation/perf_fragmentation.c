@@ -0,0 +1,256 @@
+/*
+     This file is part of GNUnet
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file fragmentation/perf_fragmentation.c
+ * @brief measure throughput of fragmentation and reassembly
+ *        of 64 KiB messages
+ */
+#include "platform.h"
+#include "gnunet_fragmentation_lib.h"
+#include <gauger.h>
+
+/**
+ * Number of messages to transmit.
+ */
+#define NUM_MSGS 2000
+
+/**
+ * How many messages are being fragmented at the same time?
+ */
+#define PARALLEL 8
+
+/**
+ * MTU to use, the one of the UDP transport.
+ */
+#define MTU 1400
+
+/**
+ * Size of the messages to transmit.
+ */
+#define MSG_SIZE (GNUNET_SERVER_MAX_MESSAGE_SIZE - 1)
+
+static int ret = 1;
+
+static unsigned int started;
+
+static unsigned int completed;
+
+static struct GNUNET_TIME_Absolute start_time;
+
+static struct GNUNET_DEFRAGMENT_Context *defrag;
+
+static struct GNUNET_FRAGMENT_Context *frags[PARALLEL];
+
+static char msg_buf[MSG_SIZE];
+
+
+/**
+ * Process fragment (by passing to defrag).
+ */
+static void
+proc_frac (void *cls,
+           const struct GNUNET_MessageHeader *hdr);
+
+
+/**
+ * Start fragmenting the next message in slot @a i, if any.
+ *
+ * @param i slot to use
+ */
+static void
+start_message (unsigned int i)
+{
+  if (started == NUM_MSGS)
+    return;
+  started++;
+  frags[i] = GNUNET_FRAGMENT_context_create (NULL /* no stats */ ,
+                                             MTU,
+                                             NULL,
+                                             GNUNET_TIME_UNIT_ZERO,
+                                             GNUNET_TIME_UNIT_MILLISECONDS,
+                                             (const struct GNUNET_MessageHeader *) msg_buf,
+                                             &proc_frac,
+                                             &frags[i]);
+}
+
+
+static void
+do_shutdown (void *cls)
+{
+  unsigned int i;
+
+  GNUNET_DEFRAGMENT_context_destroy (defrag);
+  defrag = NULL;
+  for (i = 0; i < PARALLEL; i++)
+  {
+    if (NULL == frags[i])
+      continue;
+    GNUNET_FRAGMENT_context_destroy (frags[i],
+                                     NULL,
+                                     NULL);
+    frags[i] = NULL;
+  }
+}
+
+
+static void
+proc_msgs (void *cls,
+           const struct GNUNET_MessageHeader *hdr)
+{
+  if ( (MSG_SIZE != ntohs (hdr->size)) ||
+       (0 != memcmp (hdr,
+                     msg_buf,
+                     MSG_SIZE)) )
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  completed++;
+  if (0 == (completed % (NUM_MSGS / 100)))
+    FPRINTF (stderr, "%s", ".");
+  if (NUM_MSGS == completed)
+  {
+    ret = 0;
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+/**
+ * Process ACK (by passing to fragmenter)
+ */
+static void
+proc_acks (void *cls,
+           uint32_t msg_id,
+           const struct GNUNET_MessageHeader *hdr)
+{
+  unsigned int i;
+
+  for (i = 0; i < PARALLEL; i++)
+  {
+    if (NULL == frags[i])
+      continue;
+    switch (GNUNET_FRAGMENT_process_ack (frags[i],
+                                         hdr))
+    {
+    case GNUNET_OK:
+      GNUNET_FRAGMENT_context_destroy (frags[i],
+                                       NULL,
+                                       NULL);
+      frags[i] = NULL;
+      start_message (i);
+      return;
+    case GNUNET_NO:
+      return;
+    default:
+      break;
+    }
+  }
+}
+
+
+static void
+proc_frac (void *cls,
+           const struct GNUNET_MessageHeader *hdr)
+{
+  struct GNUNET_FRAGMENT_Context **fc = cls;
+
+  GNUNET_FRAGMENT_context_transmission_done (*fc);
+  GNUNET_break (GNUNET_SYSERR !=
+                GNUNET_DEFRAGMENT_process_fragment (defrag,
+                                                    hdr));
+}
+
+
+/**
+ * Main function run with scheduler.
+ */
+static void
+run (void *cls,
+     char *const *args,
+     const char *cfgfile,
+     const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+  unsigned int i;
+
+  defrag = GNUNET_DEFRAGMENT_context_create (NULL,
+                                             MTU,
+                                             2 * PARALLEL,
+                                             NULL,
+                                             &proc_msgs,
+                                             &proc_acks);
+  GNUNET_SCHEDULER_add_shutdown (&do_shutdown,
+                                 NULL);
+  start_time = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < PARALLEL; i++)
+    start_message (i);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_GETOPT_CommandLineOption options[] = {
+    GNUNET_GETOPT_OPTION_END
+  };
+  char *const argv_prog[] = {
+    "perf-fragmentation",
+    "-c",
+    "test_fragmentation_data.conf",
+    "-L",
+    "WARNING",
+    NULL
+  };
+  struct GNUNET_MessageHeader *msg;
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+  unsigned int i;
+
+  GNUNET_log_setup ("perf-fragmentation",
+                    "WARNING",
+                    NULL);
+  for (i = 0; i < MSG_SIZE; i++)
+    msg_buf[i] = (char) i;
+  msg = (struct GNUNET_MessageHeader *) msg_buf;
+  msg->type = htons (42);
+  msg->size = htons (MSG_SIZE);
+  GNUNET_PROGRAM_run (5, argv_prog,
+                      "perf-fragmentation", "nohelp",
+                      options,
+                      &run, NULL);
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  rate = (1000LL * 1000LL * completed * (MSG_SIZE / 1024))
+    / GNUNET_MAX (1, duration.rel_value_us);
+  FPRINTF (stderr,
+           "\nFragmented and reassembled %u messages of %u bytes in %s (%llu KiB/s)\n",
+           completed,
+           (unsigned int) MSG_SIZE,
+           GNUNET_STRINGS_relative_time_to_string (duration,
+                                                   GNUNET_YES),
+           rate);
+  GAUGER ("FRAGMENTATION",
+          "Fragmentation and reassembly of 64 KiB messages",
+          rate,
+          "KiB/s");
+  return ret;
+}
+
+/* end of perf_fragmentation.c */
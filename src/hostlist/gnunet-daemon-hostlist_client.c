@@ -1043,6 +1043,9 @@ download_hostlist ()
   CURL_EASY_SETOPT (curl, CURLOPT_VERBOSE, 1);
 #endif
   CURL_EASY_SETOPT (curl, CURLOPT_BUFFERSIZE, GNUNET_SERVER_MAX_MESSAGE_SIZE);
+  /* ask for the compressed hostlist; (g)nurl inflates it as it
+     arrives, so #callback_download() still sees plain HELLOs */
+  CURL_EASY_SETOPT (curl, CURLOPT_ACCEPT_ENCODING, "gzip");
   if (0 == strncmp (current_url, "http", 4))
     CURL_EASY_SETOPT (curl, CURLOPT_USERAGENT, "GNUnet");
   CURL_EASY_SETOPT (curl, CURLOPT_CONNECTTIMEOUT, 60L);
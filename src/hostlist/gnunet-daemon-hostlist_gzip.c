@@ -0,0 +1,210 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file hostlist/gnunet-daemon-hostlist_gzip.c
+ * @brief assemble a gzip-compressed hostlist from individually
+ *        compressed HELLOs
+ *
+ * Each chunk is compressed with a fresh raw deflate stream and ended
+ * with a sync flush, so it consists of complete, non-final blocks
+ * ending on a byte boundary that only refer back into the chunk
+ * itself.  Such chunks can be concatenated in any order; closing
+ * them with an empty final block and wrapping them in a gzip header
+ * and trailer (with the CRC-32 computed by combining the CRCs of the
+ * chunks) yields a valid gzip stream.  Thus a changed HELLO only
+ * needs to be compressed once, not the whole hostlist.
+ */
+#include "platform.h"
+#include "gnunet-daemon-hostlist_gzip.h"
+#include <zlib.h>
+
+/**
+ * Size of the gzip header we use.
+ */
+#define GZIP_HEADER_SIZE 10
+
+/**
+ * Size of the gzip trailer (CRC-32 and size).
+ */
+#define GZIP_TRAILER_SIZE 8
+
+/**
+ * gzip header: magic, deflate, no flags, no time, no extra flags,
+ * OS Unix.
+ */
+static const char gzip_header[GZIP_HEADER_SIZE] = {
+  0x1f, (char) 0x8b, 8, 0, 0, 0, 0, 0, 0, 3
+};
+
+/**
+ * An empty final deflate block (fixed Huffman codes).
+ */
+static const char final_block[] = { 3, 0 };
+
+
+/**
+ * Compress a piece of data on its own.
+ *
+ * @param[out] chunk where to store the compressed data
+ * @param raw data to compress
+ * @param raw_size number of bytes in @a raw
+ * @return #GNUNET_OK on success
+ */
+int
+GNUNET_HOSTLIST_gzip_chunk_init (struct GNUNET_HOSTLIST_GzipChunk *chunk,
+                                 const void *raw,
+                                 size_t raw_size)
+{
+  z_stream z;
+  size_t bound;
+
+  memset (chunk,
+          0,
+          sizeof (*chunk));
+  memset (&z,
+          0,
+          sizeof (z));
+  if (Z_OK !=
+      deflateInit2 (&z,
+                    Z_BEST_COMPRESSION,
+                    Z_DEFLATED,
+                    - MAX_WBITS /* raw deflate */,
+                    8,
+                    Z_DEFAULT_STRATEGY))
+    return GNUNET_SYSERR;
+  /* deflateBound() covers the end of the stream, the sync flush
+     needs at most the 5 bytes of an empty stored block on top */
+  bound = deflateBound (&z,
+                        raw_size) + 16;
+  chunk->data = GNUNET_malloc (bound);
+  z.next_in = (Bytef *) raw;
+  z.avail_in = raw_size;
+  z.next_out = (Bytef *) chunk->data;
+  z.avail_out = bound;
+  if ( (Z_OK !=
+        deflate (&z,
+                 Z_SYNC_FLUSH)) ||
+       (0 != z.avail_in) )
+  {
+    GNUNET_break (0);
+    deflateEnd (&z);
+    GNUNET_free (chunk->data);
+    chunk->data = NULL;
+    return GNUNET_SYSERR;
+  }
+  chunk->size = bound - z.avail_out;
+  chunk->raw_size = raw_size;
+  chunk->crc = (uint32_t) crc32 (0L,
+                                 raw,
+                                 raw_size);
+  deflateEnd (&z);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Release the compressed data of a chunk.
+ *
+ * @param chunk chunk to clear
+ */
+void
+GNUNET_HOSTLIST_gzip_chunk_clear (struct GNUNET_HOSTLIST_GzipChunk *chunk)
+{
+  GNUNET_free_non_null (chunk->data);
+  memset (chunk,
+          0,
+          sizeof (*chunk));
+}
+
+
+/**
+ * Write a 32-bit value in little endian byte order.
+ *
+ * @param buf where to write
+ * @param v value to write
+ */
+static void
+put_le32 (char *buf,
+          uint32_t v)
+{
+  for (unsigned int i=0;i<4;i++)
+    buf[i] = (char) ((v >> (8 * i)) & 0xFF);
+}
+
+
+/**
+ * Build a gzip stream from chunks; this only copies the compressed
+ * data.
+ *
+ * @param chunks array of chunks, in order
+ * @param num_chunks number of entries in @a chunks
+ * @param[out] size set to the number of bytes in the result
+ * @return the gzip stream, free with #GNUNET_free()
+ */
+char *
+GNUNET_HOSTLIST_gzip_assemble (const struct GNUNET_HOSTLIST_GzipChunk **chunks,
+                               unsigned int num_chunks,
+                               size_t *size)
+{
+  char *buf;
+  size_t total;
+  size_t off;
+  uLong crc;
+  uint64_t raw_size;
+
+  total = GZIP_HEADER_SIZE + sizeof (final_block) + GZIP_TRAILER_SIZE;
+  for (unsigned int i=0;i<num_chunks;i++)
+    total += chunks[i]->size;
+  buf = GNUNET_malloc (total);
+  GNUNET_memcpy (buf,
+                 gzip_header,
+                 GZIP_HEADER_SIZE);
+  off = GZIP_HEADER_SIZE;
+  crc = crc32 (0L,
+               Z_NULL,
+               0);
+  raw_size = 0;
+  for (unsigned int i=0;i<num_chunks;i++)
+  {
+    GNUNET_memcpy (&buf[off],
+                   chunks[i]->data,
+                   chunks[i]->size);
+    off += chunks[i]->size;
+    crc = crc32_combine (crc,
+                         chunks[i]->crc,
+                         chunks[i]->raw_size);
+    raw_size += chunks[i]->raw_size;
+  }
+  GNUNET_memcpy (&buf[off],
+                 final_block,
+                 sizeof (final_block));
+  off += sizeof (final_block);
+  put_le32 (&buf[off],
+            (uint32_t) crc);
+  put_le32 (&buf[off + 4],
+            (uint32_t) raw_size);
+  off += GZIP_TRAILER_SIZE;
+  GNUNET_assert (off == total);
+  *size = total;
+  return buf;
+}
+
+
+/* end of gnunet-daemon-hostlist_gzip.c */
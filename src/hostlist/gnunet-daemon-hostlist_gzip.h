@@ -0,0 +1,98 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file hostlist/gnunet-daemon-hostlist_gzip.h
+ * @brief assemble a gzip-compressed hostlist from individually
+ *        compressed HELLOs
+ */
+#ifndef GNUNET_DAEMON_HOSTLIST_GZIP_H
+#define GNUNET_DAEMON_HOSTLIST_GZIP_H
+
+#include "gnunet_util_lib.h"
+
+
+/**
+ * A piece of data compressed on its own, ready to be placed
+ * anywhere in a gzip stream.
+ */
+struct GNUNET_HOSTLIST_GzipChunk
+{
+  /**
+   * Compressed data (raw deflate blocks, not final).
+   */
+  char *data;
+
+  /**
+   * Number of bytes in @e data.
+   */
+  size_t size;
+
+  /**
+   * Number of bytes of uncompressed data.
+   */
+  size_t raw_size;
+
+  /**
+   * CRC-32 of the uncompressed data.
+   */
+  uint32_t crc;
+};
+
+
+/**
+ * Compress a piece of data on its own.
+ *
+ * @param[out] chunk where to store the compressed data
+ * @param raw data to compress
+ * @param raw_size number of bytes in @a raw
+ * @return #GNUNET_OK on success
+ */
+int
+GNUNET_HOSTLIST_gzip_chunk_init (struct GNUNET_HOSTLIST_GzipChunk *chunk,
+                                 const void *raw,
+                                 size_t raw_size);
+
+
+/**
+ * Release the compressed data of a chunk.
+ *
+ * @param chunk chunk to clear
+ */
+void
+GNUNET_HOSTLIST_gzip_chunk_clear (struct GNUNET_HOSTLIST_GzipChunk *chunk);
+
+
+/**
+ * Build a gzip stream from chunks; this only copies the compressed
+ * data.
+ *
+ * @param chunks array of chunks, in order
+ * @param num_chunks number of entries in @a chunks
+ * @param[out] size set to the number of bytes in the result
+ * @return the gzip stream, free with #GNUNET_free()
+ */
+char *
+GNUNET_HOSTLIST_gzip_assemble (const struct GNUNET_HOSTLIST_GzipChunk **chunks,
+                               unsigned int num_chunks,
+                               size_t *size);
+
+
+#endif
+/* end of gnunet-daemon-hostlist_gzip.h */
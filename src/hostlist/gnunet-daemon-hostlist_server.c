@@ -31,6 +31,7 @@
 #include "gnunet_hello_lib.h"
 #include "gnunet_peerinfo_service.h"
 #include "gnunet-daemon-hostlist.h"
+#include "gnunet-daemon-hostlist_gzip.h"
 #include "gnunet_resolver_service.h"
 
 
@@ -40,6 +41,12 @@
  */
 #define GNUNET_ADV_TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 5)
 
+/**
+ * How long do we wait after a change to a HELLO before rebuilding
+ * our response?  Coalesces the burst of notifications at startup.
+ */
+#define REBUILD_DELAY GNUNET_TIME_UNIT_SECONDS
+
 
 /**
  * Handle to the HTTP server as provided by libmicrohttpd for IPv6.
@@ -87,9 +94,14 @@ static struct GNUNET_SCHEDULER_Task *hostlist_task_v6;
 static struct MHD_Response *response;
 
 /**
- * Handle for accessing peerinfo service.
+ * Our canonical response, gzip-compressed.
  */
-static struct GNUNET_PEERINFO_Handle *peerinfo;
+static struct MHD_Response *response_gzip;
+
+/**
+ * Task to rebuild the responses after HELLOs changed.
+ */
+static struct GNUNET_SCHEDULER_Task *rebuild_task;
 
 /**
  * Set if we are allowed to advertise our hostlist to others.
@@ -103,15 +115,34 @@ static char *hostlist_uri;
 
 
 /**
- * Context for #host_processor().
+ * A HELLO that might go into our hostlist.
  */
-struct HostSet
+struct HostEntry
 {
   /**
-   * Iterator used to build @e data (NULL when done).
+   * The HELLO.
    */
-  struct GNUNET_PEERINFO_IteratorContext *pitr;
+  struct GNUNET_HELLO_Message *hello;
+
+  /**
+   * The HELLO, compressed for the gzip response.
+   */
+  struct GNUNET_HOSTLIST_GzipChunk chunk;
+};
+
+
+/**
+ * Map from peer identities to `struct HostEntry`, the HELLOs with
+ * addresses peerinfo told us about.
+ */
+static struct GNUNET_CONTAINER_MultiPeerMap *hosts;
+
 
+/**
+ * Context for #add_to_response().
+ */
+struct BuildContext
+{
   /**
    * Place where we accumulate all of the HELLO messages.
    */
@@ -120,15 +151,23 @@ struct HostSet
   /**
    * Number of bytes in @e data.
    */
-  unsigned int size;
+  size_t size;
 
-};
+  /**
+   * Number of bytes allocated for @e data.
+   */
+  size_t max;
 
+  /**
+   * Compressed HELLOs for the gzip response, in the same order.
+   */
+  const struct GNUNET_HOSTLIST_GzipChunk **chunks;
 
-/**
- * NULL if we are not currenlty iterating over peer information.
- */
-static struct HostSet *builder;
+  /**
+   * Number of entries in @e chunks.
+   */
+  unsigned int num_chunks;
+};
 
 
 /**
@@ -152,34 +191,6 @@ add_cors_headers (struct MHD_Response *response)
 }
 
 
-/**
- * Function that assembles our response.
- */
-static void
-finish_response ()
-{
-  if (NULL != response)
-    MHD_destroy_response (response);
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Creating hostlist response with %u bytes\n",
-              (unsigned int) builder->size);
-  response =
-      MHD_create_response_from_buffer (builder->size,
-                                       builder->data,
-                                       MHD_RESPMEM_MUST_FREE);
-  add_cors_headers (response);
-  if ((NULL == daemon_handle_v4) && (NULL == daemon_handle_v6))
-  {
-    MHD_destroy_response (response);
-    response = NULL;
-  }
-  GNUNET_STATISTICS_set (stats, gettext_noop ("bytes in hostlist"),
-                         builder->size, GNUNET_YES);
-  GNUNET_free (builder);
-  builder = NULL;
-}
-
-
 /**
  * Set @a cls to #GNUNET_YES (we have an address!).
  *
@@ -208,50 +219,43 @@ check_has_addr (void *cls,
 
 
 /**
- * Callback that processes each of the known HELLOs for the
- * hostlist response construction.
+ * Check if a HELLO has an address that did not expire yet.
  *
- * @param cls closure, NULL
- * @param peer id of the peer, NULL for last call
- * @param hello hello message for the peer (can be NULL)
- * @param err_msg message
+ * @param hello HELLO to check
+ * @return #GNUNET_YES if @a hello has a valid address
  */
-static void
-host_processor (void *cls,
-                const struct GNUNET_PeerIdentity *peer,
-                const struct GNUNET_HELLO_Message *hello,
-                const char *err_msg)
+static int
+has_address (const struct GNUNET_HELLO_Message *hello)
 {
-  size_t old;
-  size_t s;
   int has_addr;
 
-  if (NULL != err_msg)
-  {
-    GNUNET_assert (NULL == peer);
-    builder->pitr = NULL;
-    GNUNET_free_non_null (builder->data);
-    GNUNET_free (builder);
-    builder = NULL;
-    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
-                _("Error in communication with PEERINFO service: %s\n"),
-                err_msg);
-    return;
-  }
-  if (NULL == peer)
-  {
-    builder->pitr = NULL;
-    finish_response ();
-    return;
-  }
-  if (NULL == hello)
-    return;
   has_addr = GNUNET_NO;
   GNUNET_HELLO_iterate_addresses (hello,
                                   GNUNET_NO,
                                   &check_has_addr,
                                   &has_addr);
-  if (GNUNET_NO == has_addr)
+  return has_addr;
+}
+
+
+/**
+ * Add a HELLO to the responses we are building.
+ *
+ * @param cls the `struct BuildContext`
+ * @param peer identity of the peer
+ * @param value the `struct HostEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+add_to_response (void *cls,
+                 const struct GNUNET_PeerIdentity *peer,
+                 void *value)
+{
+  struct BuildContext *bc = cls;
+  struct HostEntry *he = value;
+  size_t s;
+
+  if (GNUNET_NO == has_address (he->hello))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "HELLO for peer `%4s' has no address, not suitable for hostlist!\n",
@@ -260,35 +264,284 @@ host_processor (void *cls,
                               gettext_noop
                               ("HELLOs without addresses encountered (ignored)"),
                               1, GNUNET_NO);
-    return;
+    return GNUNET_YES;
   }
-  old = builder->size;
-  s = GNUNET_HELLO_size (hello);
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Received %u bytes of `%s' from peer `%s' for hostlist.\n",
-              (unsigned int) s,
-              "HELLO",
-              GNUNET_i2s (peer));
-  if ( (old + s >= GNUNET_MAX_MALLOC_CHECKED) ||
-       (old + s >= MAX_BYTES_PER_HOSTLISTS) )
+  s = GNUNET_HELLO_size (he->hello);
+  if (bc->size + s > bc->max)
   {
     /* too large, skip! */
     GNUNET_STATISTICS_update (stats,
                               gettext_noop
                               ("bytes not included in hostlist (size limit)"),
                               s, GNUNET_NO);
-    return;
+    return GNUNET_YES;
   }
-  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Adding peer `%s' to hostlist (%u bytes)\n",
               GNUNET_i2s (peer),
               (unsigned int) s);
-  GNUNET_array_grow (builder->data,
-                     builder->size,
-                     old + s);
-  GNUNET_memcpy (&builder->data[old],
-          hello,
-          s);
+  GNUNET_memcpy (&bc->data[bc->size],
+                 he->hello,
+                 s);
+  bc->size += s;
+  if (NULL != he->chunk.data)
+    bc->chunks[bc->num_chunks++] = &he->chunk;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Create a response from a buffer, which the response takes over.
+ * The buffer is sent as it is to every client, without copying.
+ *
+ * @param data the buffer
+ * @param size number of bytes in @a data
+ * @param encoding content encoding of @a data, NULL for none
+ * @return the response
+ */
+static struct MHD_Response *
+make_response (char *data,
+               size_t size,
+               const char *encoding)
+{
+  struct MHD_Response *r;
+
+  r = MHD_create_response_from_buffer (size,
+                                       data,
+                                       MHD_RESPMEM_MUST_FREE);
+  add_cors_headers (r);
+  MHD_add_response_header (r,
+                           MHD_HTTP_HEADER_VARY,
+                           MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  if (NULL != encoding)
+    MHD_add_response_header (r,
+                             MHD_HTTP_HEADER_CONTENT_ENCODING,
+                             encoding);
+  return r;
+}
+
+
+/**
+ * Rebuild our responses from the HELLOs we know.  Only the HELLOs
+ * are copied; each was compressed when peerinfo told us about it.
+ *
+ * @param cls NULL
+ */
+static void
+rebuild_response (void *cls)
+{
+  struct BuildContext bc;
+  char *zdata;
+  size_t zsize;
+
+  rebuild_task = NULL;
+  if (NULL != response)
+  {
+    MHD_destroy_response (response);
+    response = NULL;
+  }
+  if (NULL != response_gzip)
+  {
+    MHD_destroy_response (response_gzip);
+    response_gzip = NULL;
+  }
+  memset (&bc,
+          0,
+          sizeof (bc));
+  bc.max = MAX_BYTES_PER_HOSTLISTS;
+  bc.data = GNUNET_malloc (bc.max);
+  bc.chunks = GNUNET_new_array (GNUNET_CONTAINER_multipeermap_size (hosts) + 1,
+                                const struct GNUNET_HOSTLIST_GzipChunk *);
+  GNUNET_CONTAINER_multipeermap_iterate (hosts,
+                                         &add_to_response,
+                                         &bc);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Creating hostlist response with %u bytes\n",
+              (unsigned int) bc.size);
+  GNUNET_STATISTICS_set (stats,
+                         gettext_noop ("bytes in hostlist"),
+                         bc.size,
+                         GNUNET_YES);
+  if ((NULL == daemon_handle_v4) && (NULL == daemon_handle_v6))
+  {
+    GNUNET_free (bc.chunks);
+    GNUNET_free (bc.data);
+    return;
+  }
+  response = make_response (bc.data,
+                            bc.size,
+                            NULL);
+  /* we only compress HELLOs that fit, so the gzip response has the
+     same content unless a compression failed */
+  zdata = GNUNET_HOSTLIST_gzip_assemble (bc.chunks,
+                                         bc.num_chunks,
+                                         &zsize);
+  GNUNET_free (bc.chunks);
+  if (zsize >= bc.size)
+  {
+    /* compression does not help, serve everyone uncompressed */
+    GNUNET_free (zdata);
+    return;
+  }
+  response_gzip = make_response (zdata,
+                                 zsize,
+                                 "gzip");
+  GNUNET_STATISTICS_set (stats,
+                         gettext_noop ("bytes in compressed hostlist"),
+                         zsize,
+                         GNUNET_YES);
+}
+
+
+/**
+ * Free a host entry.
+ *
+ * @param he entry to free
+ */
+static void
+free_host_entry (struct HostEntry *he)
+{
+  GNUNET_HOSTLIST_gzip_chunk_clear (&he->chunk);
+  GNUNET_free (he->hello);
+  GNUNET_free (he);
+}
+
+
+/**
+ * Free a host entry, called when stopping.
+ *
+ * @param cls NULL
+ * @param peer identity of the peer
+ * @param value the `struct HostEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+free_host_entry_it (void *cls,
+                    const struct GNUNET_PeerIdentity *peer,
+                    void *value)
+{
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multipeermap_remove (hosts,
+                                                       peer,
+                                                       value));
+  free_host_entry (value);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Update what we know about the HELLO of a peer.
+ *
+ * @param peer the peer
+ * @param hello its HELLO, NULL if it has none
+ * @return #GNUNET_YES if our hostlist needs to be rebuilt
+ */
+static int
+update_host (const struct GNUNET_PeerIdentity *peer,
+             const struct GNUNET_HELLO_Message *hello)
+{
+  struct HostEntry *he;
+  size_t s;
+
+  he = GNUNET_CONTAINER_multipeermap_get (hosts,
+                                          peer);
+  if ( (NULL == hello) ||
+       (GNUNET_NO == has_address (hello)) )
+  {
+    if (NULL == he)
+      return GNUNET_NO;
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multipeermap_remove (hosts,
+                                                         peer,
+                                                         he));
+    free_host_entry (he);
+    return GNUNET_YES;
+  }
+  s = GNUNET_HELLO_size (hello);
+  if ( (NULL != he) &&
+       (GNUNET_HELLO_size (he->hello) == s) &&
+       (0 == memcmp (he->hello,
+                     hello,
+                     s)) )
+    return GNUNET_NO;
+  if (NULL == he)
+  {
+    he = GNUNET_new (struct HostEntry);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multipeermap_put (hosts,
+                                                      peer,
+                                                      he,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST));
+  }
+  else
+  {
+    GNUNET_HOSTLIST_gzip_chunk_clear (&he->chunk);
+    GNUNET_free (he->hello);
+  }
+  he->hello = GNUNET_malloc (s);
+  GNUNET_memcpy (he->hello,
+                 hello,
+                 s);
+  if (GNUNET_OK !=
+      GNUNET_HOSTLIST_gzip_chunk_init (&he->chunk,
+                                       hello,
+                                       s))
+    GNUNET_STATISTICS_update (stats,
+                              gettext_noop ("HELLOs that failed to compress"),
+                              1,
+                              GNUNET_NO);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Check if a client accepts gzip-compressed responses.
+ *
+ * @param accept_encoding value of the Accept-Encoding header, can be NULL
+ * @return #GNUNET_YES if gzip is acceptable
+ */
+static int
+accepts_gzip (const char *accept_encoding)
+{
+  char *ae;
+  char *tok;
+  char *params;
+  int ret;
+
+  if (NULL == accept_encoding)
+    return GNUNET_NO;
+  ret = GNUNET_NO;
+  ae = GNUNET_strdup (accept_encoding);
+  for (tok = strtok (ae, ","); NULL != tok; tok = strtok (NULL, ","))
+  {
+    while (isspace ((unsigned char) *tok))
+      tok++;
+    params = strchr (tok, ';');
+    if (NULL != params)
+      *(params++) = '\0';
+    for (size_t len = strlen (tok);
+         (len > 0) && isspace ((unsigned char) tok[len - 1]);
+         len--)
+      tok[len - 1] = '\0';
+    if ( (0 != strcasecmp (tok, "gzip")) &&
+         (0 != strcasecmp (tok, "x-gzip")) )
+      continue;
+    ret = GNUNET_YES;
+    /* "gzip;q=0" means the client does NOT want gzip */
+    if (NULL != params)
+    {
+      while (isspace ((unsigned char) *params))
+        params++;
+      if ( ( ('q' == params[0]) ||
+             ('Q' == params[0]) ) &&
+           ('=' == params[1]) &&
+           (0.0 == strtod (&params[2], NULL)) )
+        ret = GNUNET_NO;
+    }
+    break;
+  }
+  GNUNET_free (ae);
+  return ret;
 }
 
 
@@ -417,6 +670,17 @@ access_handler_callback (void *cls,
   GNUNET_STATISTICS_update (stats,
                             gettext_noop ("hostlist requests processed"),
                             1, GNUNET_YES);
+  if ( (NULL != response_gzip) &&
+       (GNUNET_YES ==
+        accepts_gzip (MHD_lookup_connection_value (connection,
+                                                   MHD_HEADER_KIND,
+                                                   MHD_HTTP_HEADER_ACCEPT_ENCODING))) )
+  {
+    GNUNET_STATISTICS_update (stats,
+                              gettext_noop ("hostlist requests served compressed"),
+                              1, GNUNET_YES);
+    return MHD_queue_response (connection, MHD_HTTP_OK, response_gzip);
+  }
   return MHD_queue_response (connection, MHD_HTTP_OK, response);
 }
 
@@ -510,11 +774,11 @@ connect_handler (void *cls,
 
 
 /**
- * PEERINFO calls this function to let us know about a possible peer
- * that we might want to connect to.
+ * PEERINFO calls this function to let us know about a new or changed
+ * HELLO of a peer; first for all peers it knows, then on changes.
  *
  * @param cls closure (not used)
- * @param peer potential peer to connect to
+ * @param peer the peer
  * @param hello HELLO for this peer (or NULL)
  * @param err_msg NULL if successful, otherwise contains error message
  */
@@ -524,33 +788,26 @@ process_notify (void *cls,
                 const struct GNUNET_HELLO_Message *hello,
                 const char *err_msg)
 {
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Peerinfo is notifying us to rebuild our hostlist\n");
   if (NULL != err_msg)
+  {
     GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                 _("Error in communication with PEERINFO service: %s\n"),
 		err_msg);
-  if (NULL != builder)
-  {
-    /* restart re-build already in progress ... */
-    if (NULL != builder->pitr)
-    {
-      GNUNET_PEERINFO_iterate_cancel (builder->pitr);
-      builder->pitr = NULL;
-    }
-    GNUNET_free_non_null (builder->data);
-    builder->size = 0;
-    builder->data = NULL;
-  }
-  else
-  {
-    builder = GNUNET_new (struct HostSet);
+    return;
   }
-  GNUNET_assert (NULL != peerinfo);
-  builder->pitr
-    = GNUNET_PEERINFO_iterate (peerinfo,
-                               GNUNET_NO, NULL,
-                               &host_processor, NULL);
+  if (NULL == peer)
+    return;
+  if (GNUNET_NO ==
+      update_host (peer,
+                   hello))
+    return;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "HELLO of `%s' changed, rebuilding our hostlist\n",
+              GNUNET_i2s (peer));
+  if (NULL == rebuild_task)
+    rebuild_task = GNUNET_SCHEDULER_add_delayed (REBUILD_DELAY,
+                                                 &rebuild_response,
+                                                 NULL);
 }
 
 
@@ -672,13 +929,6 @@ GNUNET_HOSTLIST_server_start (const struct GNUNET_CONFIGURATION_Handle *c,
   }
   cfg = c;
   stats = st;
-  peerinfo = GNUNET_PEERINFO_connect (cfg);
-  if (NULL == peerinfo)
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _("Could not access PEERINFO service.  Exiting.\n"));
-    return GNUNET_SYSERR;
-  }
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_number (cfg,
                                              "HOSTLIST",
@@ -791,6 +1041,22 @@ GNUNET_HOSTLIST_server_start (const struct GNUNET_CONFIGURATION_Handle *c,
     GNUNET_free (ipv6);
   }
 
+  /* subscribe before serving, so that we do not have to stop the
+     daemons again if PEERINFO is not available */
+  hosts = GNUNET_CONTAINER_multipeermap_create (128,
+                                                GNUNET_NO);
+  notify = GNUNET_PEERINFO_notify (cfg,
+                                   GNUNET_NO,
+                                   &process_notify, NULL);
+  if (NULL == notify)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _("Could not access PEERINFO service.  Exiting.\n"));
+    GNUNET_CONTAINER_multipeermap_destroy (hosts);
+    hosts = NULL;
+    return GNUNET_SYSERR;
+  }
+
   daemon_handle_v6 = MHD_start_daemon (MHD_USE_IPv6 | MHD_USE_DEBUG,
                                        (uint16_t) port,
                                        &accept_policy_callback, NULL,
@@ -828,6 +1094,13 @@ GNUNET_HOSTLIST_server_start (const struct GNUNET_CONFIGURATION_Handle *c,
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                 _("Could not start hostlist HTTP server on port %u\n"),
                 (unsigned short) port);
+    GNUNET_PEERINFO_notify_cancel (notify);
+    notify = NULL;
+    GNUNET_CONTAINER_multipeermap_iterate (hosts,
+                                           &free_host_entry_it,
+                                           NULL);
+    GNUNET_CONTAINER_multipeermap_destroy (hosts);
+    hosts = NULL;
     return GNUNET_SYSERR;
   }
 
@@ -837,9 +1110,6 @@ GNUNET_HOSTLIST_server_start (const struct GNUNET_CONFIGURATION_Handle *c,
     hostlist_task_v4 = prepare_daemon (daemon_handle_v4);
   if (NULL != daemon_handle_v6)
     hostlist_task_v6 = prepare_daemon (daemon_handle_v6);
-  notify = GNUNET_PEERINFO_notify (cfg,
-                                   GNUNET_NO,
-                                   &process_notify, NULL);
   return GNUNET_OK;
 }
 
@@ -882,21 +1152,23 @@ GNUNET_HOSTLIST_server_stop ()
     GNUNET_PEERINFO_notify_cancel (notify);
     notify = NULL;
   }
-  if (NULL != builder)
+  if (NULL != rebuild_task)
   {
-    if (NULL != builder->pitr)
-    {
-      GNUNET_PEERINFO_iterate_cancel (builder->pitr);
-      builder->pitr = NULL;
-    }
-    GNUNET_free_non_null (builder->data);
-    GNUNET_free (builder);
-    builder = NULL;
+    GNUNET_SCHEDULER_cancel (rebuild_task);
+    rebuild_task = NULL;
+  }
+  if (NULL != response_gzip)
+  {
+    MHD_destroy_response (response_gzip);
+    response_gzip = NULL;
   }
-  if (NULL != peerinfo)
+  if (NULL != hosts)
   {
-    GNUNET_PEERINFO_disconnect (peerinfo);
-    peerinfo = NULL;
+    GNUNET_CONTAINER_multipeermap_iterate (hosts,
+                                           &free_host_entry_it,
+                                           NULL);
+    GNUNET_CONTAINER_multipeermap_destroy (hosts);
+    hosts = NULL;
   }
   cfg = NULL;
   stats = NULL;
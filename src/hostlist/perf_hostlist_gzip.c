@@ -0,0 +1,463 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file hostlist/perf_hostlist_gzip.c
+ * @brief measure the cost of keeping a compressed hostlist up to date
+ *        and the bytes and time needed to download it from a local
+ *        HTTP server, with and without gzip
+ */
+#include "platform.h"
+#include <microhttpd.h>
+#if HAVE_CURL_CURL_H
+#include <curl/curl.h>
+#elif HAVE_GNURL_CURL_H
+#include <gnurl/curl.h>
+#endif
+#include <zlib.h>
+#include "gnunet_util_lib.h"
+#include "gnunet_hello_lib.h"
+#include "gnunet-daemon-hostlist.h"
+#include "gnunet-daemon-hostlist_gzip.h"
+#include <gauger.h>
+
+/**
+ * Number of HELLOs in the hostlist.
+ */
+#define NUM_PEERS 2000
+
+/**
+ * Number of HELLO updates to simulate.
+ */
+#define NUM_UPDATES 100
+
+/**
+ * Number of downloads of the hostlist for each encoding.
+ */
+#define NUM_DOWNLOADS 100
+
+/**
+ * Port for the HTTP server.
+ */
+#define PORT 12981
+
+/**
+ * The HELLOs.
+ */
+static struct GNUNET_HELLO_Message *hellos[NUM_PEERS];
+
+/**
+ * The compressed HELLOs.
+ */
+static struct GNUNET_HOSTLIST_GzipChunk chunks[NUM_PEERS];
+
+/**
+ * The hostlist.
+ */
+static char *raw;
+
+/**
+ * Number of bytes in @e raw.
+ */
+static size_t raw_size;
+
+/**
+ * The compressed hostlist.
+ */
+static char *gz;
+
+/**
+ * Number of bytes in @e gz.
+ */
+static size_t gz_size;
+
+/**
+ * Buffer for downloads.
+ */
+static char *download;
+
+/**
+ * Number of bytes in @e download.
+ */
+static size_t download_size;
+
+
+/**
+ * Generate some addresses for a HELLO.
+ *
+ * @param cls pointer to the number of addresses left to generate
+ * @param max maximum number of bytes to write to @a buf
+ * @param buf where to write the address
+ * @return number of bytes written, #GNUNET_SYSERR when done
+ */
+static ssize_t
+address_generator (void *cls,
+                   size_t max,
+                   void *buf)
+{
+  unsigned int *agc = cls;
+  struct GNUNET_HELLO_Address address;
+  char caddress[32];
+
+  if (0 == *agc)
+    return GNUNET_SYSERR;
+  GNUNET_snprintf (caddress,
+                   sizeof (caddress),
+                   "192.168.%u.%u:2086",
+                   *agc,
+                   (unsigned int) GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                                            256));
+  memset (&address,
+          0,
+          sizeof (address));
+  address.address_length = strlen (caddress) + 1;
+  address.address = caddress;
+  address.transport_name = (0 == *agc % 2) ? "tcp" : "udp";
+  (*agc)--;
+  return GNUNET_HELLO_add_address (&address,
+                                   GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS),
+                                   buf,
+                                   max);
+}
+
+
+/**
+ * Create the HELLO of peer @a i.
+ *
+ * @param i index of the peer
+ */
+static void
+make_hello (unsigned int i)
+{
+  struct GNUNET_CRYPTO_EddsaPublicKey pub;
+  unsigned int agc;
+
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &pub,
+                              sizeof (pub));
+  agc = 4;
+  GNUNET_free_non_null (hellos[i]);
+  hellos[i] = GNUNET_HELLO_create (&pub,
+                                   &address_generator,
+                                   &agc,
+                                   GNUNET_NO);
+}
+
+
+/**
+ * Build the hostlist and its compressed form from the chunks.
+ */
+static void
+assemble ()
+{
+  const struct GNUNET_HOSTLIST_GzipChunk *cp[NUM_PEERS];
+  size_t s;
+
+  raw_size = 0;
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    s = GNUNET_HELLO_size (hellos[i]);
+    GNUNET_assert (raw_size + s <= MAX_BYTES_PER_HOSTLISTS);
+    GNUNET_memcpy (&raw[raw_size],
+                   hellos[i],
+                   s);
+    raw_size += s;
+    cp[i] = &chunks[i];
+  }
+  GNUNET_free_non_null (gz);
+  gz = GNUNET_HOSTLIST_gzip_assemble (cp,
+                                      NUM_PEERS,
+                                      &gz_size);
+}
+
+
+/**
+ * Serve the hostlist, compressed if the client accepts gzip.
+ */
+static int
+access_handler (void *cls,
+                struct MHD_Connection *connection,
+                const char *url,
+                const char *method,
+                const char *version,
+                const char *upload_data,
+                size_t *upload_data_size,
+                void **con_cls)
+{
+  static int dummy;
+  struct MHD_Response *response;
+  const char *ae;
+  int ret;
+
+  if (NULL == *con_cls)
+  {
+    *con_cls = &dummy;
+    return MHD_YES;
+  }
+  ae = MHD_lookup_connection_value (connection,
+                                    MHD_HEADER_KIND,
+                                    MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  if ( (NULL != ae) &&
+       (NULL != strstr (ae, "gzip")) )
+  {
+    response = MHD_create_response_from_buffer (gz_size,
+                                                gz,
+                                                MHD_RESPMEM_PERSISTENT);
+    MHD_add_response_header (response,
+                             MHD_HTTP_HEADER_CONTENT_ENCODING,
+                             "gzip");
+  }
+  else
+  {
+    response = MHD_create_response_from_buffer (raw_size,
+                                                raw,
+                                                MHD_RESPMEM_PERSISTENT);
+  }
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Store downloaded (and decompressed) data.
+ */
+static size_t
+write_cb (void *ptr,
+          size_t size,
+          size_t nmemb,
+          void *ctx)
+{
+  size_t total = size * nmemb;
+
+  if (download_size + total > MAX_BYTES_PER_HOSTLISTS)
+    return 0;
+  GNUNET_memcpy (&download[download_size],
+                 ptr,
+                 total);
+  download_size += total;
+  return total;
+}
+
+
+/**
+ * Download the hostlist #NUM_DOWNLOADS times.
+ *
+ * @param encoding value for Accept-Encoding, NULL for none
+ * @param[out] duration set to the time it took
+ * @param[out] transferred set to the number of bytes received per download
+ * @return #GNUNET_OK if all downloads returned the hostlist
+ */
+static int
+download_all (const char *encoding,
+              struct GNUNET_TIME_Relative *duration,
+              double *transferred)
+{
+  struct GNUNET_TIME_Absolute start;
+  CURL *curl;
+  char url[64];
+
+  GNUNET_snprintf (url,
+                   sizeof (url),
+                   "http://127.0.0.1:%u/",
+                   PORT);
+  curl = curl_easy_init ();
+  if (NULL == curl)
+    return GNUNET_SYSERR;
+  curl_easy_setopt (curl, CURLOPT_URL, url);
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, &write_cb);
+  curl_easy_setopt (curl, CURLOPT_FAILONERROR, 1L);
+  if (NULL != encoding)
+    curl_easy_setopt (curl, CURLOPT_ACCEPT_ENCODING, encoding);
+  start = GNUNET_TIME_absolute_get ();
+  for (unsigned int i=0;i<NUM_DOWNLOADS;i++)
+  {
+    download_size = 0;
+    if ( (CURLE_OK != curl_easy_perform (curl)) ||
+         (download_size != raw_size) ||
+         (0 != memcmp (download,
+                       raw,
+                       raw_size)) )
+    {
+      GNUNET_break (0);
+      curl_easy_cleanup (curl);
+      return GNUNET_SYSERR;
+    }
+  }
+  *duration = GNUNET_TIME_absolute_get_duration (start);
+  curl_easy_getinfo (curl, CURLINFO_SIZE_DOWNLOAD, transferred);
+  curl_easy_cleanup (curl);
+  return GNUNET_OK;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative full;
+  struct GNUNET_TIME_Relative incremental;
+  struct GNUNET_TIME_Relative plain_time;
+  struct GNUNET_TIME_Relative gzip_time;
+  struct MHD_Daemon *daemon;
+  double plain_bytes;
+  double gzip_bytes;
+  uLongf zlen;
+  char *zbuf;
+  unsigned int k;
+  int ret;
+
+  GNUNET_log_setup ("perf-hostlist-gzip",
+                    "WARNING",
+                    NULL);
+  raw = GNUNET_malloc (MAX_BYTES_PER_HOSTLISTS);
+  download = GNUNET_malloc (MAX_BYTES_PER_HOSTLISTS);
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    make_hello (i);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_HOSTLIST_gzip_chunk_init (&chunks[i],
+                                                    hellos[i],
+                                                    GNUNET_HELLO_size (hellos[i])));
+  }
+  assemble ();
+
+  /* a HELLO changes: compress the whole hostlist again ... */
+  zbuf = GNUNET_malloc (compressBound (MAX_BYTES_PER_HOSTLISTS));
+  start = GNUNET_TIME_absolute_get ();
+  for (unsigned int i=0;i<NUM_UPDATES;i++)
+  {
+    k = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                  NUM_PEERS);
+    make_hello (k);
+    assemble ();
+    zlen = compressBound (raw_size);
+    GNUNET_assert (Z_OK ==
+                   compress2 ((Bytef *) zbuf,
+                              &zlen,
+                              (const Bytef *) raw,
+                              raw_size,
+                              Z_BEST_COMPRESSION));
+  }
+  full = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_free (zbuf);
+
+  /* ... or only that HELLO */
+  start = GNUNET_TIME_absolute_get ();
+  for (unsigned int i=0;i<NUM_UPDATES;i++)
+  {
+    k = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                  NUM_PEERS);
+    make_hello (k);
+    GNUNET_HOSTLIST_gzip_chunk_clear (&chunks[k]);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_HOSTLIST_gzip_chunk_init (&chunks[k],
+                                                    hellos[k],
+                                                    GNUNET_HELLO_size (hellos[k])));
+    assemble ();
+  }
+  incremental = GNUNET_TIME_absolute_get_duration (start);
+
+  ret = 1;
+  daemon = MHD_start_daemon (MHD_USE_SELECT_INTERNALLY,
+                             PORT,
+                             NULL, NULL,
+                             &access_handler, NULL,
+                             MHD_OPTION_END);
+  if (NULL == daemon)
+  {
+    FPRINTF (stderr,
+             "Failed to start HTTP server on port %u\n",
+             PORT);
+    goto cleanup;
+  }
+  curl_global_init (CURL_GLOBAL_ALL);
+  if ( (GNUNET_OK !=
+        download_all (NULL,
+                      &plain_time,
+                      &plain_bytes)) ||
+       (GNUNET_OK !=
+        download_all ("gzip",
+                      &gzip_time,
+                      &gzip_bytes)) )
+  {
+    curl_global_cleanup ();
+    MHD_stop_daemon (daemon);
+    goto cleanup;
+  }
+  curl_global_cleanup ();
+  MHD_stop_daemon (daemon);
+  ret = 0;
+
+  FPRINTF (stderr,
+           "%u HELLOs, %u bytes (%u compressed)\n",
+           NUM_PEERS,
+           (unsigned int) raw_size,
+           (unsigned int) gz_size);
+  FPRINTF (stderr,
+           "%u updates: %s recompressing everything, ",
+           NUM_UPDATES,
+           GNUNET_STRINGS_relative_time_to_string (full,
+                                                   GNUNET_YES));
+  FPRINTF (stderr,
+           "%s recompressing the changed HELLO\n",
+           GNUNET_STRINGS_relative_time_to_string (incremental,
+                                                   GNUNET_YES));
+  FPRINTF (stderr,
+           "%u downloads: %s for %.0f bytes each without gzip, ",
+           NUM_DOWNLOADS,
+           GNUNET_STRINGS_relative_time_to_string (plain_time,
+                                                   GNUNET_YES),
+           plain_bytes);
+  FPRINTF (stderr,
+           "%s for %.0f bytes each with gzip\n",
+           GNUNET_STRINGS_relative_time_to_string (gzip_time,
+                                                   GNUNET_YES),
+           gzip_bytes);
+  GAUGER ("HOSTLIST",
+          "Hostlist update (recompress all)",
+          full.rel_value_us / NUM_UPDATES,
+          "us/update");
+  GAUGER ("HOSTLIST",
+          "Hostlist update (incremental)",
+          incremental.rel_value_us / NUM_UPDATES,
+          "us/update");
+  GAUGER ("HOSTLIST",
+          "Hostlist download size (gzip)",
+          (unsigned long long) (100.0 * gzip_bytes / plain_bytes),
+          "% of uncompressed");
+  GAUGER ("HOSTLIST",
+          "Hostlist download (gzip)",
+          gzip_time.rel_value_us / NUM_DOWNLOADS,
+          "us/download");
+cleanup:
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    GNUNET_HOSTLIST_gzip_chunk_clear (&chunks[i]);
+    GNUNET_free (hellos[i]);
+  }
+  GNUNET_free_non_null (gz);
+  GNUNET_free (raw);
+  GNUNET_free (download);
+  return ret;
+}
+
+/* end of perf_hostlist_gzip.c */
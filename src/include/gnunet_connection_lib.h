@@ -364,6 +364,31 @@ GNUNET_CONNECTION_notify_transmit_ready_cancel (struct
                                                 *th);
 
 
+#ifndef MINGW
+/**
+ * Try to send data from several buffers directly on the socket,
+ * bypassing the write buffer.  This is only possible while the
+ * connection is established, has no buffered data and no
+ * transmission request is pending, as data would be reordered
+ * otherwise.
+ *
+ * @param connection connection to send on
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, which may be less than requested;
+ *         0 if the socket is not writable right now or direct
+ *         sending is not possible at this time (use
+ *         #GNUNET_CONNECTION_notify_transmit_ready() instead);
+ *         #GNUNET_SYSERR if sending failed, in which case the
+ *         connection should be destroyed
+ */
+ssize_t
+GNUNET_CONNECTION_sendv (struct GNUNET_CONNECTION_Handle *connection,
+                         const struct iovec *iov,
+                         unsigned int iovcnt);
+#endif
+
+
 /**
  * Create a connection to be proxied using a given connection.
  *
@@ -77,6 +77,7 @@ struct GNUNET_ShortHashCode
 struct GNUNET_PeerIdentity;
 
 #include "gnunet_common.h"
+#include "gnunet_time_lib.h"
 #include <gcrypt.h>
 
 
@@ -343,6 +344,25 @@ struct GNUNET_CRYPTO_AuthKey
 };
 
 
+/**
+ * @brief nonce for authenticated encryption; must never be used
+ * twice with the same key
+ */
+struct GNUNET_CRYPTO_AeadNonce
+{
+  unsigned char nonce[96 / 8];
+};
+
+
+/**
+ * @brief authentication tag produced by authenticated encryption
+ */
+struct GNUNET_CRYPTO_AeadTag
+{
+  unsigned char tag[128 / 8];
+};
+
+
 /**
  * Size of paillier plain texts and public keys.
  * Private keys and ciphertexts are twice this size.
@@ -576,6 +596,61 @@ GNUNET_CRYPTO_symmetric_decrypt (const void *block,
                                  void *result);
 
 
+/**
+ * @ingroup crypto
+ * Encrypt and authenticate a block in a single pass (AES-256-GCM).
+ * Only the @e aes_key of @a sessionkey is used.
+ *
+ * @param block the block to encrypt
+ * @param size the size of the @a block
+ * @param aad additional data to authenticate (but not encrypt), can be NULL
+ * @param aad_size number of bytes in @a aad
+ * @param sessionkey the key used to encrypt
+ * @param nonce the nonce to use, must be unique for @a sessionkey
+ * @param result where to store the encrypted result, can be @a block
+ * @param[out] tag set to the authentication tag
+ * @return the size of the encrypted block (@a size), -1 for errors
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_aead_encrypt (const void *block,
+                                      size_t size,
+                                      const void *aad,
+                                      size_t aad_size,
+                                      const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
+                                      const struct GNUNET_CRYPTO_AeadNonce *nonce,
+                                      void *result,
+                                      struct GNUNET_CRYPTO_AeadTag *tag);
+
+
+/**
+ * @ingroup crypto
+ * Decrypt a block encrypted with
+ * #GNUNET_CRYPTO_symmetric_aead_encrypt() and check its
+ * authentication tag.
+ *
+ * @param block the data to decrypt
+ * @param size the size of the @a block
+ * @param aad additional authenticated data, can be NULL
+ * @param aad_size number of bytes in @a aad
+ * @param sessionkey the key used to decrypt
+ * @param nonce the nonce used for encryption
+ * @param tag the authentication tag to check
+ * @param result where to store the plaintext, can be @a block
+ * @return the size of the decrypted block (@a size), -1 if the
+ *         tag does not match (the contents of @a result are
+ *         then undefined)
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_aead_decrypt (const void *block,
+                                      size_t size,
+                                      const void *aad,
+                                      size_t aad_size,
+                                      const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
+                                      const struct GNUNET_CRYPTO_AeadNonce *nonce,
+                                      const struct GNUNET_CRYPTO_AeadTag *tag,
+                                      void *result);
+
+
 /**
  * @ingroup crypto
  * @brief Derive an IV
@@ -2125,6 +2200,121 @@ GNUNET_CRYPTO_rsa_verify (const struct GNUNET_HashCode *hash,
 			  const struct GNUNET_CRYPTO_RsaPublicKey *public_key);
 
 
+/**
+ * @ingroup hash
+ * Calculate the 'proof-of-work' hash (an expensive hash) of a
+ * buffer, using SCRYPT keyed with @a salt.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param buf data to hash
+ * @param buf_len number of bytes in @a buf
+ * @param result where to write the resulting hash
+ */
+void
+GNUNET_CRYPTO_pow_hash (const char *salt,
+                        const void *buf,
+                        size_t buf_len,
+                        struct GNUNET_HashCode *result);
+
+
+/**
+ * @ingroup hash
+ * Count the leading zeroes in a hash.
+ *
+ * @param hash hash to count leading zeros in
+ * @return the number of leading zero bits
+ */
+unsigned int
+GNUNET_CRYPTO_hash_count_leading_zeros (const struct GNUNET_HashCode *hash);
+
+
+/**
+ * @ingroup hash
+ * Check if a nonce is a valid proof of work for some data.  The
+ * proof-of-work hash is computed over the nonce (in host byte order)
+ * followed by @a data.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param data data the proof is for, usually a public key
+ * @param data_size number of bytes in @a data
+ * @param nonce the proof to check
+ * @param bits number of leading zero bits required
+ * @return #GNUNET_YES if @a nonce is valid, #GNUNET_NO if not
+ */
+int
+GNUNET_CRYPTO_pow_check (const char *salt,
+                         const void *data,
+                         size_t data_size,
+                         uint64_t nonce,
+                         unsigned int bits);
+
+
+/**
+ * Handle for a proof-of-work search.
+ */
+struct GNUNET_CRYPTO_PowSearch;
+
+
+/**
+ * Function called with the progress and the result of a
+ * proof-of-work search.
+ *
+ * @param cls closure
+ * @param nonce if @a found is #GNUNET_YES, a valid proof; otherwise
+ *        all nonces from the start of the search up to (excluding)
+ *        @a nonce have been tried, so a later search can resume here
+ * @param found #GNUNET_YES if the search is over, in which case the
+ *        search handle must no longer be used
+ */
+typedef void
+(*GNUNET_CRYPTO_PowCallback) (void *cls,
+                              uint64_t nonce,
+                              int found);
+
+
+/**
+ * @ingroup hash
+ * Start searching for a proof of work, see #GNUNET_CRYPTO_pow_check().
+ * The nonce space is split across @a workers threads; results and
+ * progress are reported from the scheduler.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param data data the proof is for, usually a public key
+ * @param data_size number of bytes in @a data
+ * @param start first nonce to try
+ * @param bits number of leading zero bits required
+ * @param workers number of threads to use, 0 for one per CPU
+ * @param delay how long each thread pauses after every few hashes,
+ *        to limit the CPU load
+ * @param checkpoint_freq how often to report progress to @a cb
+ * @param cb function to call with progress and the result
+ * @param cb_cls closure for @a cb
+ * @return NULL on error
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_CRYPTO_pow_search_start (const char *salt,
+                                const void *data,
+                                size_t data_size,
+                                uint64_t start,
+                                unsigned int bits,
+                                unsigned int workers,
+                                struct GNUNET_TIME_Relative delay,
+                                struct GNUNET_TIME_Relative checkpoint_freq,
+                                GNUNET_CRYPTO_PowCallback cb,
+                                void *cb_cls);
+
+
+/**
+ * @ingroup hash
+ * Stop a proof-of-work search.
+ *
+ * @param ps search to stop
+ * @return nonce to resume the search at, see #GNUNET_CRYPTO_PowCallback
+ */
+uint64_t
+GNUNET_CRYPTO_pow_search_cancel (struct GNUNET_CRYPTO_PowSearch *ps);
+
+
 #if 0                           /* keep Emacsens' auto-indent happy */
 {
 #endif
@@ -58,6 +58,8 @@ struct GNUNET_FRAGMENT_Context;
  * module.  In the case of the 'proc' callback of the
  * #GNUNET_FRAGMENT_context_create() function, this function must
  * eventually call #GNUNET_FRAGMENT_context_transmission_done().
+ * Fragments point into the fragmentation context and remain valid
+ * until it is destroyed.
  *
  * @param cls closure
  * @param msg the message that was created
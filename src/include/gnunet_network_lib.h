@@ -45,6 +45,14 @@ extern "C"
  */
 struct GNUNET_NETWORK_Handle;
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+/**
+ * Message header for batched datagram I/O, from <sys/socket.h>
+ * (only defined there with _GNU_SOURCE).
+ */
+struct mmsghdr;
+#endif
+
 
 /**
  * @brief collection of IO descriptors
@@ -312,6 +320,61 @@ GNUNET_NETWORK_socket_send (const struct GNUNET_NETWORK_Handle *desc,
                             size_t length);
 
 
+#ifndef MINGW
+/**
+ * Send data from several buffers with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, #GNUNET_SYSERR on error
+ */
+ssize_t
+GNUNET_NETWORK_socket_sendv (const struct GNUNET_NETWORK_Handle *desc,
+                             const struct iovec *iov,
+                             unsigned int iovcnt);
+#endif
+
+
+#if HAVE_RECVMMSG
+/**
+ * Read several datagrams with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param msgs array of @a vlen message headers with the buffers
+ *        to receive into; the length of each datagram received is
+ *        stored in its `msg_len`
+ * @param vlen number of entries in @a msgs
+ * @return number of datagrams received, #GNUNET_SYSERR on error
+ */
+int
+GNUNET_NETWORK_socket_recvmmsg (const struct GNUNET_NETWORK_Handle *desc,
+                                struct mmsghdr *msgs,
+                                unsigned int vlen);
+#endif
+
+
+#if HAVE_SENDMMSG
+/**
+ * Send several datagrams with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param msgs array of @a vlen messages to send, each with
+ *        its destination address
+ * @param vlen number of entries in @a msgs
+ * @return number of datagrams sent, #GNUNET_SYSERR if
+ *         the first one could not be sent
+ */
+int
+GNUNET_NETWORK_socket_sendmmsg (const struct GNUNET_NETWORK_Handle *desc,
+                                struct mmsghdr *msgs,
+                                unsigned int vlen);
+#endif
+
+
 /**
  * Send data to a particular destination (always non-blocking).
  * This function only works for UDP sockets.
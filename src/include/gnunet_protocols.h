@@ -330,6 +330,16 @@ extern "C"
  */
 #define GNUNET_MESSAGE_TYPE_CORE_NOTIFY_OUTBOUND 71
 
+/**
+ * Service offering a shared memory channel to a client.
+ */
+#define GNUNET_MESSAGE_TYPE_CORE_SHM_OFFER 72
+
+/**
+ * Client accepting or declining the shared memory channel.
+ */
+#define GNUNET_MESSAGE_TYPE_CORE_SHM_ACK 73
+
 /**
  * Request from client to transmit message.
  */
@@ -346,6 +356,11 @@ extern "C"
  */
 #define GNUNET_MESSAGE_TYPE_CORE_SEND 76
 
+/**
+ * Wake up the other side of a shared memory channel.
+ */
+#define GNUNET_MESSAGE_TYPE_CORE_SHM_NOTIFY 77
+
 /**
  * Request for connection monitoring from CORE service.
  */
@@ -396,6 +411,12 @@ extern "C"
  */
 #define GNUNET_MESSAGE_TYPE_CORE_CONFIRM_TYPE_MAP 89
 
+/**
+ * Encapsulation for an encrypted message between peers, using
+ * authenticated encryption (AEAD).
+ */
+#define GNUNET_MESSAGE_TYPE_CORE_ENCRYPTED_MESSAGE_AEAD 90
+
 
 /*******************************************************************************
  * DATASTORE message types
@@ -1636,6 +1657,29 @@ extern "C"
  * SET message types
  ******************************************************************************/
 
+/**
+ * Keys of the smaller set for intersection, sent instead of
+ * a Bloom filter if the set sizes are very different or small.
+ */
+#define GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS 562
+
+/**
+ * Bitmap telling which of the received intersection keys
+ * are in the other peer's set.
+ */
+#define GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP 563
+
+/**
+ * Coded symbols of a rateless invertible bloom filter.
+ */
+#define GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF 564
+
+/**
+ * Tell the other peer to stop sending rateless IBF symbols,
+ * as the difference has been decoded.
+ */
+#define GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP 565
+
 /**
  * Demand the whole element from the other
  * peer, given only the hash code.
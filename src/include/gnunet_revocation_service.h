@@ -145,6 +145,28 @@ GNUNET_REVOCATION_check_pow (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
 			     unsigned int matching_bits);
 
 
+/**
+ * Start searching for a proof-of-work for revoking the given key,
+ * using one thread per CPU.  Stop the search with
+ * #GNUNET_CRYPTO_pow_search_cancel().
+ *
+ * @param key key to revoke
+ * @param start first proof-of-work value to try
+ * @param matching_bits how many bits must match (configuration)
+ * @param checkpoint_freq how often to report progress to @a cb
+ * @param cb function to call with progress and the result
+ * @param cb_cls closure for @a cb
+ * @return NULL on error
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_REVOCATION_pow_start (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
+                             uint64_t start,
+                             unsigned int matching_bits,
+                             struct GNUNET_TIME_Relative checkpoint_freq,
+                             GNUNET_CRYPTO_PowCallback cb,
+                             void *cb_cls);
+
+
 /**
  * Create a revocation signature.
  *
@@ -567,6 +567,27 @@ int
 GNUNET_SERVER_client_disable_corking (struct GNUNET_SERVER_Client *client);
 
 
+#ifndef MINGW
+/**
+ * Try to send data from several buffers to the given client
+ * directly, without copying it into the write buffer first.
+ * Only possible while no transmission request is pending.
+ *
+ * @param client client to transmit to
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, which may be less than requested;
+ *         0 if nothing could be sent right now (use
+ *         #GNUNET_SERVER_notify_transmit_ready() instead);
+ *         #GNUNET_SYSERR on errors
+ */
+ssize_t
+GNUNET_SERVER_client_sendv (struct GNUNET_SERVER_Client *client,
+                            const struct iovec *iov,
+                            unsigned int iovcnt);
+#endif
+
+
 /**
  * The tansmit context is the key datastructure for a conveniance API
  * used for transmission of complex results to the client followed
@@ -238,6 +238,13 @@ enum GNUNET_SET_OptionType
    * Might trigger Byzantine fault detection.
    */
   GNUNET_SET_OPTION_FORCE_DELTA=4,
+  /**
+   * For set union, do not estimate the size of the difference
+   * with a strata estimator, but let the other peer stream coded
+   * symbols of a rateless IBF until we have decoded the difference.
+   * Saves retransmissions of IBFs for badly estimated differences.
+   */
+  GNUNET_SET_OPTION_RATELESS=8,
 };
 
 
@@ -84,6 +84,7 @@
 #ifndef MINGW
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #if HAVE_NETINET_IN_H
 #include <netinet/in.h>
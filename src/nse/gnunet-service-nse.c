@@ -48,7 +48,7 @@
 #include "gnunet_testbed_logger_service.h"
 #endif
 #include "nse.h"
-#include <gcrypt.h>
+#include "gnunet-service-nse_verify.h"
 
 
 
@@ -73,6 +73,21 @@
  */
 #define NSE_PRIORITY GNUNET_CORE_PRIO_CRITICAL_CONTROL
 
+/**
+ * Salt for the proof-of-work hash.
+ */
+#define POW_SALT GNV_POW_SALT
+
+/**
+ * For how many origins do we remember verified proofs and signatures?
+ */
+#define VERIFY_CACHE_SIZE (16 * 1024)
+
+/**
+ * How often do we save the progress of the search for our proof?
+ */
+#define PROOF_CHECKPOINT_FREQUENCY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 1)
+
 #if FREEBSD
 #define log2(a) (log(a)/log(2))
 #endif
@@ -92,6 +107,11 @@ static struct GNUNET_TIME_Relative gnunet_nse_interval;
  */
 static struct GNUNET_TIME_Relative proof_find_delay;
 
+/**
+ * Number of threads to search for our proof with, 0 for one per CPU.
+ */
+static unsigned long long proof_workers;
+
 #if ENABLE_NSE_HISTOGRAM
 
 /**
@@ -162,60 +182,6 @@ struct NSEPeerEntry
 };
 
 
-GNUNET_NETWORK_STRUCT_BEGIN
-
-/**
- * Network size estimate reply; sent when "this"
- * peer's timer has run out before receiving a
- * valid reply from another peer.
- */
-struct GNUNET_NSE_FloodMessage
-{
-  /**
-   * Type: #GNUNET_MESSAGE_TYPE_NSE_P2P_FLOOD
-   */
-  struct GNUNET_MessageHeader header;
-
-  /**
-   * Number of hops this message has taken so far.
-   */
-  uint32_t hop_count GNUNET_PACKED;
-
-  /**
-   * Purpose.
-   */
-  struct GNUNET_CRYPTO_EccSignaturePurpose purpose;
-
-  /**
-   * The current timestamp value (which all
-   * peers should agree on).
-   */
-  struct GNUNET_TIME_AbsoluteNBO timestamp;
-
-  /**
-   * Number of matching bits between the hash
-   * of timestamp and the initiator's public
-   * key.
-   */
-  uint32_t matching_bits GNUNET_PACKED;
-
-  /**
-   * Public key of the originator.
-   */
-  struct GNUNET_PeerIdentity origin;
-
-  /**
-   * Proof of work, causing leading zeros when hashed with pkey.
-   */
-  uint64_t proof_of_work GNUNET_PACKED;
-
-  /**
-   * Signature (over range specified in purpose).
-   */
-  struct GNUNET_CRYPTO_EddsaSignature signature;
-};
-GNUNET_NETWORK_STRUCT_END
-
 /**
  * Handle to our current configuration.
  */
@@ -279,9 +245,14 @@ static unsigned int estimate_count;
 static struct GNUNET_SCHEDULER_Task *flood_task;
 
 /**
- * Task scheduled to compute our proof.
+ * Proofs of work and signatures of other peers we checked already.
  */
-static struct GNUNET_SCHEDULER_Task *proof_task;
+static struct GNV_Cache *verify_cache;
+
+/**
+ * Search for our proof, NULL once we have it.
+ */
+static struct GNUNET_CRYPTO_PowSearch *proof_search;
 
 /**
  * Notification context, simplifies client broadcasts.
@@ -493,30 +464,6 @@ get_delay_randomization (uint32_t matching_bits)
 }
 
 
-/**
- * Calculate the 'proof-of-work' hash (an expensive hash).
- *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
- */
-static void
-pow_hash (const void *buf,
-	  size_t buf_len,
-	  struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-		gcry_kdf_derive (buf, buf_len,
-				 GCRY_KDF_SCRYPT,
-				 1 /* subalgo */,
-				 "gnunet-proof-of-work",
-				 strlen ("gnunet-proof-of-work"),
-				 2 /* iterations; keep cost of individual op small */,
-				 sizeof (struct GNUNET_HashCode),
-				 result));
-}
-
-
 /**
  * Get the number of matching bits that the given timestamp has to the given peer ID.
  *
@@ -620,7 +567,7 @@ transmit_task_cb (void *cls)
 				      peer_entry);
   }
   if ((0 == ntohl (size_estimate_messages[idx].hop_count)) &&
-      (NULL != proof_task))
+      (NULL != proof_search))
   {
     GNUNET_STATISTICS_update (stats,
                               "# flood messages not generated (no proof yet)",
@@ -818,25 +765,6 @@ update_flood_message (void *cls)
 }
 
 
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
-{
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while (0 == GNUNET_CRYPTO_hash_get_bit (hash,
-					  hash_count))
-    hash_count++;
-  return hash_count;
-}
-
-
 /**
  * Check whether the given public key and integer are a valid proof of
  * work.
@@ -849,21 +777,11 @@ static int
 check_proof_of_work (const struct GNUNET_CRYPTO_EddsaPublicKey *pkey,
                      uint64_t val)
 {
-  char buf[sizeof (struct GNUNET_CRYPTO_EddsaPublicKey) +
-           sizeof (val)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-
-  GNUNET_memcpy (buf,
-		 &val,
-		 sizeof (val));
-  GNUNET_memcpy (&buf[sizeof (val)],
-		 pkey,
-		 sizeof (struct GNUNET_CRYPTO_EddsaPublicKey));
-  pow_hash (buf,
-	    sizeof (buf),
-	    &result);
-  return (count_leading_zeroes (&result) >=
-          nse_work_required) ? GNUNET_YES : GNUNET_NO;
+  return GNUNET_CRYPTO_pow_check (POW_SALT,
+                                  pkey,
+                                  sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                                  val,
+                                  nse_work_required);
 }
 
 
@@ -895,58 +813,33 @@ write_proof ()
 
 
 /**
- * Find our proof of work.
+ * Called by the search for our proof of work with its progress
+ * and with the result.
  *
  * @param cls closure (unused)
+ * @param nonce the proof found, or the nonce to resume the search at
+ * @param found #GNUNET_YES if @a nonce is our proof
  */
 static void
-find_proof (void *cls)
+proof_cb (void *cls,
+          uint64_t nonce,
+          int found)
 {
-#define ROUND_SIZE 10
-  uint64_t counter;
-  char buf[sizeof (struct GNUNET_CRYPTO_EddsaPublicKey) +
-           sizeof (uint64_t)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-  unsigned int i;
-
-  proof_task = NULL;
-  GNUNET_memcpy (&buf[sizeof (uint64_t)], &my_identity,
-          sizeof (struct GNUNET_PeerIdentity));
-  i = 0;
-  counter = my_proof;
-  while ((counter != UINT64_MAX) && (i < ROUND_SIZE))
-  {
-    GNUNET_memcpy (buf, &counter, sizeof (uint64_t));
-    pow_hash (buf, sizeof (buf), &result);
-    if (nse_work_required <= count_leading_zeroes (&result))
-    {
-      my_proof = counter;
-      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Proof of work found: %llu!\n",
-                  (unsigned long long) GNUNET_ntohll (counter));
-      write_proof ();
-      setup_flood_message (estimate_index, current_timestamp);
-      return;
-    }
-    counter++;
-    i++;
-  }
-  if (my_proof / (100 * ROUND_SIZE) < counter / (100 * ROUND_SIZE))
+  my_proof = nonce;
+  write_proof ();
+  if (GNUNET_YES != found)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Testing proofs currently at %llu\n",
-                (unsigned long long) counter);
-    /* remember progress every 100 rounds */
-    my_proof = counter;
-    write_proof ();
-  }
-  else
-  {
-    my_proof = counter;
+                (unsigned long long) nonce);
+    return;
   }
-  proof_task =
-      GNUNET_SCHEDULER_add_delayed_with_priority (proof_find_delay,
-						  GNUNET_SCHEDULER_PRIORITY_IDLE,
-						  &find_proof, NULL);
+  proof_search = NULL;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Proof of work found: %llu!\n",
+              (unsigned long long) GNUNET_ntohll (nonce));
+  setup_flood_message (estimate_index,
+                       current_timestamp);
 }
 
 
@@ -963,8 +856,9 @@ static int
 verify_message_crypto (const struct GNUNET_NSE_FloodMessage *incoming_flood)
 {
   if (GNUNET_YES !=
-      check_proof_of_work (&incoming_flood->origin.public_key,
-                           incoming_flood->proof_of_work))
+      GNV_check_proof (verify_cache,
+                       &incoming_flood->origin,
+                       incoming_flood->proof_of_work))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Proof of work invalid: %llu!\n",
@@ -975,10 +869,10 @@ verify_message_crypto (const struct GNUNET_NSE_FloodMessage *incoming_flood)
   }
   if ((nse_work_required > 0) &&
       (GNUNET_OK !=
-       GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_NSE_SEND,
-                                 &incoming_flood->purpose,
-                                 &incoming_flood->signature,
-                                 &incoming_flood->origin.public_key)))
+       GNV_check_signature (verify_cache,
+                            &incoming_flood->origin,
+                            &incoming_flood->purpose,
+                            &incoming_flood->signature)))
   {
     GNUNET_break_op (0);
     return GNUNET_NO;
@@ -1332,10 +1226,10 @@ shutdown_task (void *cls)
     GNUNET_SCHEDULER_cancel (flood_task);
     flood_task = NULL;
   }
-  if (NULL != proof_task)
+  if (NULL != proof_search)
   {
-    GNUNET_SCHEDULER_cancel (proof_task);
-    proof_task = NULL;
+    my_proof = GNUNET_CRYPTO_pow_search_cancel (proof_search);
+    proof_search = NULL;
     write_proof ();             /* remember progress */
   }
   if (NULL != nc)
@@ -1348,6 +1242,11 @@ shutdown_task (void *cls)
     GNUNET_CORE_disconnect (core_api);
     core_api = NULL;
   }
+  if (NULL != verify_cache)
+  {
+    GNV_cache_destroy (verify_cache);
+    verify_cache = NULL;
+  }
   if (NULL != stats)
   {
     GNUNET_STATISTICS_destroy (stats, GNUNET_NO);
@@ -1535,6 +1434,12 @@ run (void *cls,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+					     "NSE",
+					     "WORKERS",
+					     &proof_workers))
+    proof_workers = 0;
 
 #if ENABLE_NSE_HISTOGRAM
   {
@@ -1596,10 +1501,29 @@ run (void *cls,
 			    sizeof (my_proof))))
     my_proof = 0;
   GNUNET_free (proof);
-  proof_task =
-      GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
-                                          &find_proof,
-					  NULL);
+  if (GNUNET_YES !=
+      check_proof_of_work (&my_identity.public_key,
+                           my_proof))
+  {
+    proof_search
+      = GNUNET_CRYPTO_pow_search_start (POW_SALT,
+                                        &my_identity.public_key,
+                                        sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                                        my_proof,
+                                        nse_work_required,
+                                        (unsigned int) proof_workers,
+                                        proof_find_delay,
+                                        PROOF_CHECKPOINT_FREQUENCY,
+                                        &proof_cb,
+                                        NULL);
+    if (NULL == proof_search)
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  _("Failed to start searching for proof of work\n"));
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+  }
 
   peers = GNUNET_CONTAINER_multipeermap_create (128,
 						GNUNET_YES);
@@ -1618,6 +1542,9 @@ run (void *cls,
   }
   stats = GNUNET_STATISTICS_create ("nse",
 				    cfg);
+  verify_cache = GNV_cache_create ((unsigned int) nse_work_required,
+                                   VERIFY_CACHE_SIZE,
+                                   stats);
 }
 
 
@@ -0,0 +1,339 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file nse/gnunet-service-nse_verify.c
+ * @brief cache of verified proofs of work and signatures of flood
+ *        messages
+ *
+ * A peer's proof of work never changes, and during a round every
+ * neighbour relays the same signed flood message of an origin to us.
+ * So we remember, per origin, the last valid proof and a hash of the
+ * last valid signed message.  Only successful checks are remembered:
+ * a proof (or a signed message including its signature) that fails
+ * the check is rejected without replacing the valid one, so a forged
+ * message relayed by some neighbour neither evicts the result for
+ * the genuine one nor, when alternating with it, forces us to check
+ * the genuine one again.  The least recently used origins are evicted.
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_signatures.h"
+#include "gnunet-service-nse_verify.h"
+
+
+/**
+ * What we know about an origin.
+ */
+struct CacheEntry
+{
+
+  /**
+   * The origin.
+   */
+  struct GNUNET_PeerIdentity origin;
+
+  /**
+   * Hash over the last valid signed message and its signature.
+   */
+  struct GNUNET_HashCode signed_hash;
+
+  /**
+   * Last valid proof of work.
+   */
+  uint64_t proof;
+
+  /**
+   * Entry in the LRU heap of the cache.
+   */
+  struct GNUNET_CONTAINER_HeapNode *hn;
+
+  /**
+   * #GNUNET_YES if @e proof is set, #GNUNET_NO if we did not
+   * see a valid proof yet.
+   */
+  int have_proof;
+
+  /**
+   * #GNUNET_YES if @e signed_hash is set, #GNUNET_NO if we did
+   * not see a valid signature yet.
+   */
+  int have_sig;
+
+};
+
+
+/**
+ * Handle to a verification cache.
+ */
+struct GNV_Cache
+{
+
+  /**
+   * Map from origins to `struct CacheEntry`.
+   */
+  struct GNUNET_CONTAINER_MultiPeerMap *entries;
+
+  /**
+   * Entries by time of last use, least recent at the root.
+   */
+  struct GNUNET_CONTAINER_Heap *lru;
+
+  /**
+   * Where to count cache hits, can be NULL.
+   */
+  struct GNUNET_STATISTICS_Handle *stats;
+
+  /**
+   * Incremented on every use, used as the cost in @e lru.
+   */
+  uint64_t clock;
+
+  /**
+   * Number of leading zero bits a proof needs.
+   */
+  unsigned int work_required;
+
+  /**
+   * Maximum number of entries.
+   */
+  unsigned int max_entries;
+
+};
+
+
+/**
+ * Create a verification cache.
+ *
+ * @param work_required number of leading zero bits a proof needs
+ * @param max_entries how many origins to remember at most
+ * @param stats where to count cache hits, can be NULL
+ * @return the cache
+ */
+struct GNV_Cache *
+GNV_cache_create (unsigned int work_required,
+                  unsigned int max_entries,
+                  struct GNUNET_STATISTICS_Handle *stats)
+{
+  struct GNV_Cache *cache;
+
+  GNUNET_assert (0 < max_entries);
+  cache = GNUNET_new (struct GNV_Cache);
+  cache->entries = GNUNET_CONTAINER_multipeermap_create (GNUNET_MIN (max_entries,
+                                                                     1024),
+                                                         GNUNET_NO);
+  cache->lru = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  cache->stats = stats;
+  cache->work_required = work_required;
+  cache->max_entries = max_entries;
+  return cache;
+}
+
+
+/**
+ * Count a hit or miss of the cache.
+ *
+ * @param cache the cache
+ * @param name name of the statistic
+ */
+static void
+count (struct GNV_Cache *cache,
+       const char *name)
+{
+  if (NULL == cache->stats)
+    return;
+  GNUNET_STATISTICS_update (cache->stats,
+                            name,
+                            1,
+                            GNUNET_NO);
+}
+
+
+/**
+ * Remove an entry from the cache.
+ *
+ * @param cache the cache
+ * @param ce entry to remove
+ */
+static void
+remove_entry (struct GNV_Cache *cache,
+              struct CacheEntry *ce)
+{
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multipeermap_remove (cache->entries,
+                                                       &ce->origin,
+                                                       ce));
+  GNUNET_CONTAINER_heap_remove_node (ce->hn);
+  GNUNET_free (ce);
+}
+
+
+/**
+ * Find the entry of an origin, creating it if needed, and mark it
+ * as most recently used.
+ *
+ * @param cache the cache
+ * @param origin origin to look up
+ * @return the entry
+ */
+static struct CacheEntry *
+get_entry (struct GNV_Cache *cache,
+           const struct GNUNET_PeerIdentity *origin)
+{
+  struct CacheEntry *ce;
+
+  cache->clock++;
+  ce = GNUNET_CONTAINER_multipeermap_get (cache->entries,
+                                          origin);
+  if (NULL != ce)
+  {
+    GNUNET_CONTAINER_heap_update_cost (ce->hn,
+                                       cache->clock);
+    return ce;
+  }
+  while (GNUNET_CONTAINER_heap_get_size (cache->lru) >= cache->max_entries)
+    remove_entry (cache,
+                  GNUNET_CONTAINER_heap_peek (cache->lru));
+  ce = GNUNET_new (struct CacheEntry);
+  ce->origin = *origin;
+  ce->have_proof = GNUNET_NO;
+  ce->have_sig = GNUNET_NO;
+  ce->hn = GNUNET_CONTAINER_heap_insert (cache->lru,
+                                         ce,
+                                         cache->clock);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multipeermap_put (cache->entries,
+                                                    &ce->origin,
+                                                    ce,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST));
+  return ce;
+}
+
+
+/**
+ * Check the proof of work of a peer.  The expensive hash is only
+ * computed if this is not the last valid proof of this peer.
+ *
+ * @param cache the cache
+ * @param origin peer the proof is for
+ * @param proof the proof
+ * @return #GNUNET_YES if @a proof is valid, #GNUNET_NO if not
+ */
+int
+GNV_check_proof (struct GNV_Cache *cache,
+                 const struct GNUNET_PeerIdentity *origin,
+                 uint64_t proof)
+{
+  struct CacheEntry *ce;
+
+  ce = get_entry (cache,
+                  origin);
+  if ( (GNUNET_YES == ce->have_proof) &&
+       (proof == ce->proof) )
+  {
+    count (cache,
+           "# proofs of work found in cache");
+    return GNUNET_YES;
+  }
+  if (GNUNET_YES !=
+      GNUNET_CRYPTO_pow_check (GNV_POW_SALT,
+                               &origin->public_key,
+                               sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                               proof,
+                               cache->work_required))
+    return GNUNET_NO;
+  ce->proof = proof;
+  ce->have_proof = GNUNET_YES;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Check the signature of a peer over a flood message.  A valid
+ * message repeated by several neighbours is only verified once.
+ *
+ * @param cache the cache
+ * @param origin peer that signed the message
+ * @param purpose start of the signed part of the message
+ * @param sig the signature
+ * @return #GNUNET_OK if @a sig is valid, #GNUNET_SYSERR if not
+ */
+int
+GNV_check_signature (struct GNV_Cache *cache,
+                     const struct GNUNET_PeerIdentity *origin,
+                     const struct GNUNET_CRYPTO_EccSignaturePurpose *purpose,
+                     const struct GNUNET_CRYPTO_EddsaSignature *sig)
+{
+  struct CacheEntry *ce;
+  struct GNUNET_HashContext *hc;
+  struct GNUNET_HashCode signed_hash;
+
+  hc = GNUNET_CRYPTO_hash_context_start ();
+  GNUNET_CRYPTO_hash_context_read (hc,
+                                   purpose,
+                                   ntohl (purpose->size));
+  GNUNET_CRYPTO_hash_context_read (hc,
+                                   sig,
+                                   sizeof (*sig));
+  GNUNET_CRYPTO_hash_context_finish (hc,
+                                     &signed_hash);
+  ce = get_entry (cache,
+                  origin);
+  if ( (GNUNET_YES == ce->have_sig) &&
+       (0 == memcmp (&signed_hash,
+                     &ce->signed_hash,
+                     sizeof (signed_hash))) )
+  {
+    count (cache,
+           "# flood signatures found in cache");
+    return GNUNET_OK;
+  }
+  if (GNUNET_OK !=
+      GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_NSE_SEND,
+                                  purpose,
+                                  sig,
+                                  &origin->public_key))
+    return GNUNET_SYSERR;
+  ce->signed_hash = signed_hash;
+  ce->have_sig = GNUNET_YES;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Destroy a verification cache.
+ *
+ * @param cache cache to destroy
+ */
+void
+GNV_cache_destroy (struct GNV_Cache *cache)
+{
+  struct CacheEntry *ce;
+
+  while (NULL != (ce = GNUNET_CONTAINER_heap_peek (cache->lru)))
+    remove_entry (cache,
+                  ce);
+  GNUNET_CONTAINER_heap_destroy (cache->lru);
+  GNUNET_CONTAINER_multipeermap_destroy (cache->entries);
+  GNUNET_free (cache);
+}
+
+
+/* end of gnunet-service-nse_verify.c */
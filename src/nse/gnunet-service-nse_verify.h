@@ -0,0 +1,104 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file nse/gnunet-service-nse_verify.h
+ * @brief cache of verified proofs of work and signatures of flood
+ *        messages
+ *
+ * All functions in this file should use the prefix GNV (Gnunet Nse
+ * Verify)
+ */
+#ifndef GNUNET_SERVICE_NSE_VERIFY_H
+#define GNUNET_SERVICE_NSE_VERIFY_H
+
+#include "gnunet_util_lib.h"
+#include "gnunet_statistics_service.h"
+
+
+/**
+ * Salt for the proof-of-work hash of NSE.
+ */
+#define GNV_POW_SALT "gnunet-proof-of-work"
+
+
+/**
+ * Handle to a verification cache.
+ */
+struct GNV_Cache;
+
+
+/**
+ * Create a verification cache.
+ *
+ * @param work_required number of leading zero bits a proof needs
+ * @param max_entries how many origins to remember at most
+ * @param stats where to count cache hits, can be NULL
+ * @return the cache
+ */
+struct GNV_Cache *
+GNV_cache_create (unsigned int work_required,
+                  unsigned int max_entries,
+                  struct GNUNET_STATISTICS_Handle *stats);
+
+
+/**
+ * Check the proof of work of a peer.  The expensive hash is only
+ * computed if this is not the last valid proof of this peer.
+ *
+ * @param cache the cache
+ * @param origin peer the proof is for
+ * @param proof the proof
+ * @return #GNUNET_YES if @a proof is valid, #GNUNET_NO if not
+ */
+int
+GNV_check_proof (struct GNV_Cache *cache,
+                 const struct GNUNET_PeerIdentity *origin,
+                 uint64_t proof);
+
+
+/**
+ * Check the signature of a peer over a flood message.  A valid
+ * message repeated by several neighbours is only verified once.
+ *
+ * @param cache the cache
+ * @param origin peer that signed the message
+ * @param purpose start of the signed part of the message
+ * @param sig the signature
+ * @return #GNUNET_OK if @a sig is valid, #GNUNET_SYSERR if not
+ */
+int
+GNV_check_signature (struct GNV_Cache *cache,
+                     const struct GNUNET_PeerIdentity *origin,
+                     const struct GNUNET_CRYPTO_EccSignaturePurpose *purpose,
+                     const struct GNUNET_CRYPTO_EddsaSignature *sig);
+
+
+/**
+ * Destroy a verification cache.
+ *
+ * @param cache cache to destroy
+ */
+void
+GNV_cache_destroy (struct GNV_Cache *cache);
+
+
+#endif
+/* end of gnunet-service-nse_verify.h */
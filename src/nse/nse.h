@@ -29,6 +29,7 @@
 #define NSE_H
 
 #include "gnunet_common.h"
+#include "gnunet_crypto_lib.h"
 
 GNUNET_NETWORK_STRUCT_BEGIN
 
@@ -68,6 +69,57 @@ struct GNUNET_NSE_ClientMessage
    */
   double std_deviation GNUNET_PACKED;
 };
+
+/**
+ * Network size estimate reply; sent when "this"
+ * peer's timer has run out before receiving a
+ * valid reply from another peer.
+ */
+struct GNUNET_NSE_FloodMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_NSE_P2P_FLOOD
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Number of hops this message has taken so far.
+   */
+  uint32_t hop_count GNUNET_PACKED;
+
+  /**
+   * Purpose.
+   */
+  struct GNUNET_CRYPTO_EccSignaturePurpose purpose;
+
+  /**
+   * The current timestamp value (which all
+   * peers should agree on).
+   */
+  struct GNUNET_TIME_AbsoluteNBO timestamp;
+
+  /**
+   * Number of matching bits between the hash
+   * of timestamp and the initiator's public
+   * key.
+   */
+  uint32_t matching_bits GNUNET_PACKED;
+
+  /**
+   * Public key of the originator.
+   */
+  struct GNUNET_PeerIdentity origin;
+
+  /**
+   * Proof of work, causing leading zeros when hashed with pkey.
+   */
+  uint64_t proof_of_work GNUNET_PACKED;
+
+  /**
+   * Signature (over range specified in purpose).
+   */
+  struct GNUNET_CRYPTO_EddsaSignature signature;
+};
 GNUNET_NETWORK_STRUCT_END
 
 #endif
@@ -0,0 +1,262 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file nse/perf_nse_verify.c
+ * @brief measure how long it takes to verify the flood messages of
+ *        10k peers in one round, each relayed to us by several
+ *        neighbours, with and without the verification cache
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_signatures.h"
+#include "nse.h"
+#include "gnunet-service-nse_verify.h"
+#include <gauger.h>
+
+/**
+ * Number of peers flooding.
+ */
+#define NUM_PEERS (10 * 1000)
+
+/**
+ * How many neighbours relay each flood message to us.
+ */
+#define DUPLICATES 4
+
+/**
+ * Number of bits the proofs of work need; low, as we only care
+ * about the cost of checking them.
+ */
+#define WORK_BITS 2
+
+/**
+ * The flood messages of all peers.
+ */
+static struct GNUNET_NSE_FloodMessage *floods;
+
+
+/**
+ * Create a signed flood message with a valid proof for each peer.
+ */
+static void
+make_floods ()
+{
+  struct GNUNET_CRYPTO_EddsaPrivateKey *pk;
+  struct GNUNET_TIME_Absolute ts;
+  struct GNUNET_NSE_FloodMessage *fm;
+
+  ts = GNUNET_TIME_absolute_get ();
+  floods = GNUNET_new_array (NUM_PEERS,
+                             struct GNUNET_NSE_FloodMessage);
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    fm = &floods[i];
+    pk = GNUNET_CRYPTO_eddsa_key_create ();
+    GNUNET_CRYPTO_eddsa_key_get_public (pk,
+                                        &fm->origin.public_key);
+    fm->header.size = htons (sizeof (struct GNUNET_NSE_FloodMessage));
+    fm->header.type = htons (GNUNET_MESSAGE_TYPE_NSE_P2P_FLOOD);
+    fm->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_NSE_SEND);
+    fm->purpose.size
+      = htonl (sizeof (struct GNUNET_NSE_FloodMessage) -
+               sizeof (struct GNUNET_MessageHeader) -
+               sizeof (uint32_t) -
+               sizeof (struct GNUNET_CRYPTO_EddsaSignature));
+    fm->timestamp = GNUNET_TIME_absolute_hton (ts);
+    fm->matching_bits = htonl (i % 32);
+    fm->proof_of_work = 0;
+    while (GNUNET_YES !=
+           GNUNET_CRYPTO_pow_check (GNV_POW_SALT,
+                                    &fm->origin.public_key,
+                                    sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                                    fm->proof_of_work,
+                                    WORK_BITS))
+      fm->proof_of_work++;
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CRYPTO_eddsa_sign (pk,
+                                             &fm->purpose,
+                                             &fm->signature));
+    GNUNET_free (pk);
+  }
+}
+
+
+/**
+ * Verify all flood messages the way the service did before it had
+ * a cache.
+ *
+ * @return number of messages that verified
+ */
+static unsigned int
+verify_uncached ()
+{
+  const struct GNUNET_NSE_FloodMessage *fm;
+  unsigned int ok;
+
+  ok = 0;
+  for (unsigned int d=0;d<DUPLICATES;d++)
+    for (unsigned int i=0;i<NUM_PEERS;i++)
+    {
+      fm = &floods[i];
+      if ( (GNUNET_YES ==
+            GNUNET_CRYPTO_pow_check (GNV_POW_SALT,
+                                     &fm->origin.public_key,
+                                     sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                                     fm->proof_of_work,
+                                     WORK_BITS)) &&
+           (GNUNET_OK ==
+            GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_NSE_SEND,
+                                        &fm->purpose,
+                                        &fm->signature,
+                                        &fm->origin.public_key)) )
+        ok++;
+    }
+  return ok;
+}
+
+
+/**
+ * Verify all flood messages using a verification cache.
+ *
+ * @param cache the cache to use
+ * @return number of messages that verified
+ */
+static unsigned int
+verify_cached (struct GNV_Cache *cache)
+{
+  const struct GNUNET_NSE_FloodMessage *fm;
+  unsigned int ok;
+
+  ok = 0;
+  for (unsigned int d=0;d<DUPLICATES;d++)
+    for (unsigned int i=0;i<NUM_PEERS;i++)
+    {
+      fm = &floods[i];
+      if ( (GNUNET_YES ==
+            GNV_check_proof (cache,
+                             &fm->origin,
+                             fm->proof_of_work)) &&
+           (GNUNET_OK ==
+            GNV_check_signature (cache,
+                                 &fm->origin,
+                                 &fm->purpose,
+                                 &fm->signature)) )
+        ok++;
+    }
+  return ok;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative uncached;
+  struct GNUNET_TIME_Relative cached;
+  struct GNV_Cache *cache;
+  struct GNUNET_NSE_FloodMessage forged;
+  int ret;
+
+  GNUNET_log_setup ("perf-nse-verify",
+                    "WARNING",
+                    NULL);
+  make_floods ();
+  ret = 1;
+
+  start = GNUNET_TIME_absolute_get ();
+  if (NUM_PEERS * DUPLICATES != verify_uncached ())
+  {
+    GNUNET_break (0);
+    goto cleanup;
+  }
+  uncached = GNUNET_TIME_absolute_get_duration (start);
+
+  cache = GNV_cache_create (WORK_BITS,
+                            NUM_PEERS,
+                            NULL);
+  start = GNUNET_TIME_absolute_get ();
+  if (NUM_PEERS * DUPLICATES != verify_cached (cache))
+  {
+    GNUNET_break (0);
+    GNV_cache_destroy (cache);
+    goto cleanup;
+  }
+  cached = GNUNET_TIME_absolute_get_duration (start);
+  /* a tampered copy of a cached message must still be rejected */
+  forged = floods[0];
+  forged.matching_bits = htonl (ntohl (forged.matching_bits) + 1);
+  if (GNUNET_OK ==
+      GNV_check_signature (cache,
+                           &forged.origin,
+                           &forged.purpose,
+                           &forged.signature))
+  {
+    GNUNET_break (0);
+    GNV_cache_destroy (cache);
+    goto cleanup;
+  }
+  /* a forged proof must be rejected without losing the valid one */
+  do
+    forged.proof_of_work++;
+  while (GNUNET_YES ==
+         GNUNET_CRYPTO_pow_check (GNV_POW_SALT,
+                                  &forged.origin.public_key,
+                                  sizeof (struct GNUNET_CRYPTO_EddsaPublicKey),
+                                  forged.proof_of_work,
+                                  WORK_BITS));
+  if ( (GNUNET_NO !=
+        GNV_check_proof (cache,
+                         &forged.origin,
+                         forged.proof_of_work)) ||
+       (GNUNET_YES !=
+        GNV_check_proof (cache,
+                         &floods[0].origin,
+                         floods[0].proof_of_work)) )
+  {
+    GNUNET_break (0);
+    GNV_cache_destroy (cache);
+    goto cleanup;
+  }
+  GNV_cache_destroy (cache);
+  ret = 0;
+  FPRINTF (stderr,
+           "Verifying %u flood messages from %u peers: %s without cache, ",
+           NUM_PEERS * DUPLICATES,
+           NUM_PEERS,
+           GNUNET_STRINGS_relative_time_to_string (uncached,
+                                                   GNUNET_YES));
+  FPRINTF (stderr,
+           "%s with cache\n",
+           GNUNET_STRINGS_relative_time_to_string (cached,
+                                                   GNUNET_YES));
+  GAUGER ("NSE",
+          "Flood verification of 10k peers (no cache)",
+          uncached.rel_value_us / 1000LL,
+          "ms");
+  GAUGER ("NSE",
+          "Flood verification of 10k peers (cache)",
+          cached.rel_value_us / 1000LL,
+          "ms");
+cleanup:
+  GNUNET_free (floods);
+  return ret;
+}
+
+/* end of perf_nse_verify.c */
@@ -23,7 +23,9 @@
  * @brief maintains list of known peers
  *
  * Code to maintain the list of currently known hosts (in memory
- * structure of data/hosts/).
+ * structure of data/hosts/).  HELLOs are kept on disk either in one
+ * file per peer or in a single log-structured file (see
+ * gnunet-service-peerinfo_store.c), depending on the STORE option.
  *
  * @author Christian Grothoff
  */
@@ -34,6 +36,7 @@
 #include "gnunet_protocols.h"
 #include "gnunet_statistics_service.h"
 #include "peerinfo.h"
+#include "gnunet-service-peerinfo_store.h"
 
 /**
  * How often do we scan the HOST_DIR for new entries?
@@ -45,6 +48,13 @@
  */
 #define DATA_HOST_CLEAN_FREQ GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 60)
 
+/**
+ * HELLOs that only extend the expiration of known addresses by at
+ * most this much are not stored and not passed on to clients
+ * (unless the known expiration is about as close as this).
+ */
+#define EXPIRATION_TOLERANCE GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 15)
+
 
 /**
  * In-memory cache of known hosts.
@@ -67,6 +77,18 @@ struct HostEntry
    */
   struct GNUNET_HELLO_Message *friend_only_hello;
 
+  /**
+   * Addresses in @e hello, mapping hashes of the addresses to their
+   * expiration (`struct GNUNET_TIME_Absolute *`), NULL if @e hello
+   * is NULL.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *addresses;
+
+  /**
+   * Addresses in @e friend_only_hello, like @e addresses.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *friend_only_addresses;
+
 };
 
 
@@ -109,6 +131,12 @@ static struct GNUNET_NotificationContext *notify_friend_only_list;
  */
 static char *networkIdDirectory;
 
+/**
+ * Single-file store for the HELLOs, NULL if we use one file per
+ * peer in #networkIdDirectory (or no disk IO at all).
+ */
+static struct GPS_Store *store;
+
 /**
  * Handle for reporting statistics.
  */
@@ -711,82 +739,284 @@ update_friend_hello (const struct GNUNET_HELLO_Message *hello,
 
 
 /**
- * Bind a host address (hello) to a hostId.
+ * Compute the key of an address in the address index of a host.
  *
- * @param peer the peer for which this is a hello
- * @param hello the verified (!) hello message
+ * @param address the address
+ * @param key set to the key
  */
 static void
-update_hello (const struct GNUNET_PeerIdentity *peer,
-              const struct GNUNET_HELLO_Message *hello)
+hash_address (const struct GNUNET_HELLO_Address *address,
+              struct GNUNET_HashCode *key)
+{
+  size_t tlen = strlen (address->transport_name) + 1;
+  char buf[tlen + address->address_length];
+
+  GNUNET_memcpy (buf,
+                 address->transport_name,
+                 tlen);
+  GNUNET_memcpy (&buf[tlen],
+                 address->address,
+                 address->address_length);
+  GNUNET_CRYPTO_hash (buf,
+                      sizeof (buf),
+                      key);
+}
+
+
+/**
+ * Add an address to an address index.
+ *
+ * @param cls the `struct GNUNET_CONTAINER_MultiHashMap` to add to
+ * @param address the address
+ * @param expiration expiration time for the address
+ * @return #GNUNET_OK (always)
+ */
+static int
+index_address (void *cls,
+               const struct GNUNET_HELLO_Address *address,
+               struct GNUNET_TIME_Absolute expiration)
+{
+  struct GNUNET_CONTAINER_MultiHashMap *map = cls;
+  struct GNUNET_TIME_Absolute *exp;
+  struct GNUNET_HashCode key;
+
+  hash_address (address,
+                &key);
+  exp = GNUNET_CONTAINER_multihashmap_get (map,
+                                           &key);
+  if (NULL == exp)
+  {
+    exp = GNUNET_new (struct GNUNET_TIME_Absolute);
+    *exp = expiration;
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (map,
+                                                      &key,
+                                                      exp,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  }
+  else
+  {
+    *exp = GNUNET_TIME_absolute_max (*exp,
+                                     expiration);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Free an entry of an address index.
+ *
+ * @param cls NULL
+ * @param key hash of the address
+ * @param value the expiration to free
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+free_address (void *cls,
+              const struct GNUNET_HashCode *key,
+              void *value)
+{
+  GNUNET_free (value);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Replace the public or friend-only HELLO of a host and rebuild
+ * the respective address index.
+ *
+ * @param host the host to update
+ * @param friend_only #GNUNET_YES to set the friend-only HELLO
+ * @param hello the new HELLO, can be NULL; ownership is taken
+ */
+static void
+set_hello (struct HostEntry *host,
+           int friend_only,
+           struct GNUNET_HELLO_Message *hello)
 {
-  char *fn;
-  struct HostEntry *host;
-  struct GNUNET_HELLO_Message *mrg;
   struct GNUNET_HELLO_Message **dest;
-  struct GNUNET_TIME_Absolute delta;
-  unsigned int cnt;
-  unsigned int size;
-  int friend_hello_type;
-  int store_hello;
-  int store_friend_hello;
-  int pos;
-  char *buffer;
+  struct GNUNET_CONTAINER_MultiHashMap **index;
+
+  if (GNUNET_YES == friend_only)
+  {
+    dest = &host->friend_only_hello;
+    index = &host->friend_only_addresses;
+  }
+  else
+  {
+    dest = &host->hello;
+    index = &host->addresses;
+  }
+  GNUNET_free_non_null (*dest);
+  *dest = hello;
+  if (NULL != *index)
+  {
+    GNUNET_CONTAINER_multihashmap_iterate (*index,
+                                           &free_address,
+                                           NULL);
+    GNUNET_CONTAINER_multihashmap_destroy (*index);
+    *index = NULL;
+  }
+  if (NULL == hello)
+    return;
+  *index = GNUNET_CONTAINER_multihashmap_create (4,
+                                                 GNUNET_NO);
+  (void) GNUNET_HELLO_iterate_addresses (hello,
+                                         GNUNET_NO,
+                                         &index_address,
+                                         *index);
+}
 
-  host = GNUNET_CONTAINER_multipeermap_get (hostmap, peer);
-  GNUNET_assert (NULL != host);
+
+/**
+ * Closure for #check_address().
+ */
+struct CheckAddressContext
+{
+  /**
+   * Address index of the HELLO we know.
+   */
+  const struct GNUNET_CONTAINER_MultiHashMap *index;
+
+  /**
+   * The current time.
+   */
+  struct GNUNET_TIME_Absolute now;
+
+  /**
+   * Set to #GNUNET_YES if the new HELLO has addresses we do not know
+   * or extends an expiration by more than #EXPIRATION_TOLERANCE.
+   */
+  int changed;
+
+  /**
+   * Set to #GNUNET_YES if the new HELLO extends expirations within
+   * #EXPIRATION_TOLERANCE.
+   */
+  int refreshed;
+};
+
+
+/**
+ * Check if an address of a new HELLO would change what we know.
+ *
+ * @param cls the `struct CheckAddressContext`
+ * @param address the address
+ * @param expiration expiration time for the address
+ * @return #GNUNET_SYSERR to stop once a change was found
+ */
+static int
+check_address (void *cls,
+               const struct GNUNET_HELLO_Address *address,
+               struct GNUNET_TIME_Absolute expiration)
+{
+  struct CheckAddressContext *cac = cls;
+  const struct GNUNET_TIME_Absolute *exp;
+  struct GNUNET_HashCode key;
+
+  if (expiration.abs_value_us < cac->now.abs_value_us)
+    return GNUNET_OK; /* expired addresses do not count */
+  hash_address (address,
+                &key);
+  exp = GNUNET_CONTAINER_multihashmap_get (cac->index,
+                                           &key);
+  if ( (NULL == exp) ||
+       ( (expiration.abs_value_us > exp->abs_value_us) &&
+         ( (GNUNET_TIME_absolute_get_difference (*exp,
+                                                 expiration).rel_value_us >
+            EXPIRATION_TOLERANCE.rel_value_us) ||
+           (GNUNET_TIME_absolute_get_difference (cac->now,
+                                                 *exp).rel_value_us <
+            EXPIRATION_TOLERANCE.rel_value_us) ) ) )
+  {
+    cac->changed = GNUNET_YES;
+    return GNUNET_SYSERR;
+  }
+  if (expiration.abs_value_us > exp->abs_value_us)
+    cac->refreshed = GNUNET_YES;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Merge a HELLO into the HELLOs we know for a host.
+ *
+ * @param host the host the HELLO is for
+ * @param hello the verified (!) hello message
+ * @return #GNUNET_YES if the HELLOs of @a host changed
+ */
+static int
+merge_hello (struct HostEntry *host,
+             const struct GNUNET_HELLO_Message *hello)
+{
+  struct GNUNET_HELLO_Message *mrg;
+  struct GNUNET_HELLO_Message *dest;
+  struct CheckAddressContext cac;
+  int friend_hello_type;
 
   friend_hello_type = GNUNET_HELLO_is_friend_only (hello);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Updating %s HELLO for `%s'\n",
               (GNUNET_YES == friend_hello_type) ? "friend-only" : "public",
-              GNUNET_i2s (peer));
+              GNUNET_i2s (&host->identity));
 
-  dest = NULL;
   if (GNUNET_YES == friend_hello_type)
   {
-    dest = &host->friend_only_hello;
+    dest = host->friend_only_hello;
+    cac.index = host->friend_only_addresses;
   }
   else
   {
-    dest = &host->hello;
+    dest = host->hello;
+    cac.index = host->addresses;
   }
 
-  if (NULL == (*dest))
+  if (NULL == dest)
   {
-    (*dest) = GNUNET_malloc (GNUNET_HELLO_size (hello));
-    GNUNET_memcpy ((*dest), hello, GNUNET_HELLO_size (hello));
+    mrg = GNUNET_malloc (GNUNET_HELLO_size (hello));
+    GNUNET_memcpy (mrg, hello, GNUNET_HELLO_size (hello));
   }
   else
   {
-    mrg = GNUNET_HELLO_merge ((*dest),
-                              hello);
-    delta = GNUNET_HELLO_equals (mrg,
-                                 (*dest),
-                                 GNUNET_TIME_absolute_get ());
-    if (delta.abs_value_us == GNUNET_TIME_UNIT_FOREVER_ABS.abs_value_us)
+    /* look up the addresses in the index instead of merging first,
+       peers send us the same HELLO over and over again */
+    cac.now = GNUNET_TIME_absolute_get ();
+    cac.changed = GNUNET_NO;
+    cac.refreshed = GNUNET_NO;
+    (void) GNUNET_HELLO_iterate_addresses (hello,
+                                           GNUNET_NO,
+                                           &check_address,
+                                           &cac);
+    if (GNUNET_NO == cac.changed)
     {
-      /* no differences, just ignore the update */
+      /* no (relevant) differences, just ignore the update */
       GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                   "No change in %s HELLO for `%s'\n",
                   (GNUNET_YES == friend_hello_type) ? "friend-only" : "public",
-                  GNUNET_i2s (peer));
-      GNUNET_free (mrg);
-      return;
+                  GNUNET_i2s (&host->identity));
+      GNUNET_STATISTICS_update (stats,
+                                (GNUNET_YES == cac.refreshed)
+                                ? gettext_noop ("# HELLO expiration refreshes suppressed")
+                                : gettext_noop ("# unchanged HELLOs suppressed"),
+                                1,
+                                GNUNET_NO);
+      return GNUNET_NO;
     }
-    GNUNET_free ((*dest));
-    (*dest) = mrg;
+    mrg = GNUNET_HELLO_merge (dest,
+                              hello);
   }
+  set_hello (host,
+             friend_hello_type,
+             mrg);
 
   if ( (NULL != (host->hello)) &&
        (GNUNET_NO == friend_hello_type) )
   {
     /* Update friend only hello */
-    mrg = update_friend_hello (host->hello,
-                               host->friend_only_hello);
-    if (NULL != host->friend_only_hello)
-      GNUNET_free (host->friend_only_hello);
-    host->friend_only_hello = mrg;
+    set_hello (host,
+               GNUNET_YES,
+               update_friend_hello (host->hello,
+                                    host->friend_only_hello));
   }
 
   if (NULL != host->hello)
@@ -795,87 +1025,346 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
   if (NULL != host->friend_only_hello)
     GNUNET_assert ((GNUNET_YES ==
                     GNUNET_HELLO_is_friend_only (host->friend_only_hello)));
+  return GNUNET_YES;
+}
+
+
+/**
+ * Write the HELLOs of a host to disk.  HELLOs without addresses
+ * are not written; if neither HELLO has any, the host is removed
+ * from disk.
+ *
+ * @param host the host to write
+ */
+static void
+write_host_entry (const struct HostEntry *host)
+{
+  char *fn;
+  unsigned int cnt;
+  unsigned int size;
+  int store_hello;
+  int store_friend_hello;
+  int pos;
+  char *buffer;
+
+  store_hello = GNUNET_NO;
+  size = 0;
+  cnt = 0;
+  if (NULL != host->hello)
+    (void) GNUNET_HELLO_iterate_addresses (host->hello,
+                                           GNUNET_NO,
+                                           &count_addresses,
+                                           &cnt);
+  if (cnt > 0)
+  {
+    store_hello = GNUNET_YES;
+    size += GNUNET_HELLO_size (host->hello);
+  }
+  cnt = 0;
+  if (NULL != host->friend_only_hello)
+    (void) GNUNET_HELLO_iterate_addresses (host->friend_only_hello,
+                                           GNUNET_NO,
+                                           &count_addresses,
+                                           &cnt);
+  store_friend_hello = GNUNET_NO;
+  if (0 < cnt)
+  {
+    store_friend_hello = GNUNET_YES;
+    size += GNUNET_HELLO_size (host->friend_only_hello);
+  }
 
-  fn = get_host_filename (peer);
-  if ( (NULL != fn) &&
-       (GNUNET_OK ==
+  if (NULL != store)
+  {
+    (void) GPS_store_put (store,
+                          &host->identity,
+                          (GNUNET_YES == store_hello) ? host->hello : NULL,
+                          (GNUNET_YES == store_friend_hello) ? host->friend_only_hello : NULL);
+    return;
+  }
+  fn = get_host_filename (&host->identity);
+  if ( (NULL == fn) ||
+       (GNUNET_OK !=
         GNUNET_DISK_directory_create_for_file (fn)) )
   {
-    store_hello = GNUNET_NO;
-    size = 0;
-    cnt = 0;
-    if (NULL != host->hello)
-      (void) GNUNET_HELLO_iterate_addresses (host->hello,
-					     GNUNET_NO,
-                                             &count_addresses,
-                                             &cnt);
-    if (cnt > 0)
-    {
-      store_hello = GNUNET_YES;
-      size += GNUNET_HELLO_size (host->hello);
-    }
-    cnt = 0;
-    if (NULL != host->friend_only_hello)
-      (void) GNUNET_HELLO_iterate_addresses (host->friend_only_hello,
-                                             GNUNET_NO,
-					     &count_addresses,
-                                             &cnt);
-    store_friend_hello = GNUNET_NO;
-    if (0 < cnt)
-    {
-      store_friend_hello = GNUNET_YES;
-      size += GNUNET_HELLO_size (host->friend_only_hello);
-    }
+    GNUNET_free_non_null (fn);
+    return;
+  }
+  if ( (GNUNET_NO == store_hello) &&
+       (GNUNET_NO == store_friend_hello) )
+  {
+    /* no valid addresses, don't put HELLO on disk; in fact,
+       if one exists on disk, remove it */
+    (void) UNLINK (fn);
+  }
+  else
+  {
+    buffer = GNUNET_malloc (size);
+    pos = 0;
 
-    if ( (GNUNET_NO == store_hello) &&
-         (GNUNET_NO == store_friend_hello) )
+    if (GNUNET_YES == store_hello)
     {
-      /* no valid addresses, don't put HELLO on disk; in fact,
-	 if one exists on disk, remove it */
-      (void) UNLINK (fn);
+      GNUNET_memcpy (buffer,
+                     host->hello,
+                     GNUNET_HELLO_size (host->hello));
+      pos += GNUNET_HELLO_size (host->hello);
     }
-    else
+    if (GNUNET_YES == store_friend_hello)
     {
-      buffer = GNUNET_malloc (size);
-      pos = 0;
-
-      if (GNUNET_YES == store_hello)
-      {
-	GNUNET_memcpy (buffer,
-                       host->hello,
-                       GNUNET_HELLO_size (host->hello));
-	pos += GNUNET_HELLO_size (host->hello);
-      }
-      if (GNUNET_YES == store_friend_hello)
-      {
-	GNUNET_memcpy (&buffer[pos],
-                host->friend_only_hello,
-                GNUNET_HELLO_size (host->friend_only_hello));
-	pos += GNUNET_HELLO_size (host->friend_only_hello);
-      }
-      GNUNET_assert (pos == size);
-
-      if (GNUNET_SYSERR == GNUNET_DISK_fn_write (fn, buffer, size,
-						 GNUNET_DISK_PERM_USER_READ |
-						 GNUNET_DISK_PERM_USER_WRITE |
-						 GNUNET_DISK_PERM_GROUP_READ |
-						 GNUNET_DISK_PERM_OTHER_READ))
-	GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "write", fn);
-      else
-	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                    "Stored %s %s HELLO in %s  with total size %u\n",
-		    (GNUNET_YES == store_friend_hello) ? "friend-only": "",
-		    (GNUNET_YES == store_hello) ? "public": "",
-		    fn,
-                    size);
-      GNUNET_free (buffer);
+      GNUNET_memcpy (&buffer[pos],
+                     host->friend_only_hello,
+                     GNUNET_HELLO_size (host->friend_only_hello));
+      pos += GNUNET_HELLO_size (host->friend_only_hello);
     }
+    GNUNET_assert (pos == size);
+
+    if (GNUNET_SYSERR == GNUNET_DISK_fn_write (fn, buffer, size,
+                                               GNUNET_DISK_PERM_USER_READ |
+                                               GNUNET_DISK_PERM_USER_WRITE |
+                                               GNUNET_DISK_PERM_GROUP_READ |
+                                               GNUNET_DISK_PERM_OTHER_READ))
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "write", fn);
+    else
+      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                  "Stored %s %s HELLO in %s  with total size %u\n",
+                  (GNUNET_YES == store_friend_hello) ? "friend-only": "",
+                  (GNUNET_YES == store_hello) ? "public": "",
+                  fn,
+                  size);
+    GNUNET_free (buffer);
   }
-  GNUNET_free_non_null (fn);
+  GNUNET_free (fn);
+}
+
+
+/**
+ * Bind a host address (hello) to a hostId.
+ *
+ * @param peer the peer for which this is a hello
+ * @param hello the verified (!) hello message
+ */
+static void
+update_hello (const struct GNUNET_PeerIdentity *peer,
+              const struct GNUNET_HELLO_Message *hello)
+{
+  struct HostEntry *host;
+
+  host = GNUNET_CONTAINER_multipeermap_get (hostmap, peer);
+  GNUNET_assert (NULL != host);
+  if (GNUNET_NO == merge_hello (host,
+                                hello))
+    return;
+  write_host_entry (host);
   notify_all (host);
 }
 
 
+/**
+ * Drop the expired addresses from a HELLO.
+ *
+ * @param hello the HELLO, can be NULL
+ * @param now the current time
+ * @return HELLO with the remaining addresses, NULL if none are left
+ */
+static struct GNUNET_HELLO_Message *
+clean_hello (const struct GNUNET_HELLO_Message *hello,
+             struct GNUNET_TIME_Absolute *now)
+{
+  struct GNUNET_HELLO_Message *hello_clean;
+  unsigned int cnt;
+
+  if (NULL == hello)
+    return NULL;
+  hello_clean = GNUNET_HELLO_iterate_addresses (hello,
+                                                GNUNET_YES,
+                                                &discard_expired,
+                                                now);
+  if (NULL == hello_clean)
+    return NULL;
+  cnt = 0;
+  (void) GNUNET_HELLO_iterate_addresses (hello_clean,
+                                         GNUNET_NO,
+                                         &count_addresses,
+                                         &cnt);
+  if (0 == cnt)
+  {
+    GNUNET_free (hello_clean);
+    return NULL;
+  }
+  return hello_clean;
+}
+
+
+/**
+ * Check if a HELLO lost addresses in #clean_hello().
+ *
+ * @param hello the original HELLO, can be NULL
+ * @param hello_clean the result of #clean_hello() for @a hello
+ * @return #GNUNET_YES if addresses were dropped
+ */
+static int
+hello_shrunk (const struct GNUNET_HELLO_Message *hello,
+              const struct GNUNET_HELLO_Message *hello_clean)
+{
+  if (NULL == hello)
+    return GNUNET_NO;
+  if (NULL == hello_clean)
+    return GNUNET_YES;
+  return (GNUNET_HELLO_size (hello) != GNUNET_HELLO_size (hello_clean))
+    ? GNUNET_YES
+    : GNUNET_NO;
+}
+
+
+/**
+ * Closure for #store_load_cb().
+ */
+struct StoreLoadContext
+{
+  /**
+   * Peers whose records in the store must be rewritten as
+   * addresses expired while we were not running.
+   */
+  struct GNUNET_PeerIdentity *dirty;
+
+  /**
+   * Length of the @e dirty array.
+   */
+  unsigned int num_dirty;
+
+  /**
+   * Number of peers added to our list.
+   */
+  unsigned int matched;
+};
+
+
+/**
+ * Add the HELLOs of a peer found in the store to our list.
+ *
+ * @param cls the `struct StoreLoadContext`
+ * @param peer identity of the peer
+ * @param hello public HELLO of the peer, can be NULL
+ * @param friend_only_hello friend-only HELLO of the peer, can be NULL
+ */
+static void
+store_load_cb (void *cls,
+               const struct GNUNET_PeerIdentity *peer,
+               const struct GNUNET_HELLO_Message *hello,
+               const struct GNUNET_HELLO_Message *friend_only_hello)
+{
+  struct StoreLoadContext *slc = cls;
+  struct GNUNET_TIME_Absolute now;
+  struct GNUNET_HELLO_Message *hello_clean;
+  struct GNUNET_HELLO_Message *friend_clean;
+  struct HostEntry *host;
+
+  if ( ( (NULL != hello) &&
+         (GNUNET_NO != GNUNET_HELLO_is_friend_only (hello)) ) ||
+       ( (NULL != friend_only_hello) &&
+         (GNUNET_YES != GNUNET_HELLO_is_friend_only (friend_only_hello)) ) )
+  {
+    GNUNET_break (0);
+    return;
+  }
+  now = GNUNET_TIME_absolute_get ();
+  hello_clean = clean_hello (hello,
+                             &now);
+  friend_clean = clean_hello (friend_only_hello,
+                              &now);
+  if ( (GNUNET_YES == hello_shrunk (hello,
+                                    hello_clean)) ||
+       (GNUNET_YES == hello_shrunk (friend_only_hello,
+                                    friend_clean)) )
+    GNUNET_array_append (slc->dirty,
+                         slc->num_dirty,
+                         *peer);
+  if ( (NULL == hello_clean) &&
+       (NULL == friend_clean) )
+    return;
+  host = add_host_to_known_hosts (peer);
+  if (NULL != friend_clean)
+    (void) merge_hello (host,
+                        friend_clean);
+  if (NULL != hello_clean)
+    (void) merge_hello (host,
+                        hello_clean);
+  GNUNET_free_non_null (hello_clean);
+  GNUNET_free_non_null (friend_clean);
+  slc->matched++;
+}
+
+
+/**
+ * Open the single-file store and load the HELLOs in it.  If the
+ * store is empty, the HELLOs in the per-peer files in @a hostdir
+ * (if any) are imported.
+ *
+ * @param fn name of the file of the store
+ * @param hostdir directory with the per-peer files
+ * @return #GNUNET_OK on success
+ */
+static int
+load_store (const char *fn,
+            const char *hostdir)
+{
+  struct StoreLoadContext slc;
+  struct DirScanContext dsc;
+  struct HostEntry *host;
+
+  if (GNUNET_OK !=
+      GNUNET_DISK_directory_create_for_file (fn))
+    return GNUNET_SYSERR;
+  memset (&slc,
+          0,
+          sizeof (slc));
+  store = GPS_store_open (fn,
+                          &store_load_cb,
+                          &slc);
+  if (NULL == store)
+  {
+    GNUNET_array_grow (slc.dirty,
+                       slc.num_dirty,
+                       0);
+    return GNUNET_SYSERR;
+  }
+  /* rewrite (or remove) records that lost addresses */
+  for (unsigned int i=0;i<slc.num_dirty;i++)
+  {
+    host = GNUNET_CONTAINER_multipeermap_get (hostmap,
+                                              &slc.dirty[i]);
+    if (NULL != host)
+      write_host_entry (host);
+    else
+      (void) GPS_store_put (store,
+                            &slc.dirty[i],
+                            NULL,
+                            NULL);
+  }
+  GNUNET_array_grow (slc.dirty,
+                     slc.num_dirty,
+                     0);
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              _("Loaded %u peers from `%s'\n"),
+              slc.matched,
+              fn);
+  if ( (0 == slc.matched) &&
+       (GNUNET_YES ==
+        GNUNET_DISK_directory_test (hostdir,
+                                    GNUNET_YES)) )
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+                _("Importing HELLOs from `%s'\n"),
+                hostdir);
+    dsc.matched = 0;
+    dsc.remove_files = GNUNET_NO;
+    GNUNET_DISK_directory_scan (hostdir,
+                                &hosts_directory_scan_callback,
+                                &dsc);
+  }
+  return GNUNET_OK;
+}
+
+
 /**
  * Closure for #add_to_tc()
  */
@@ -1059,6 +1548,51 @@ discard_hosts_helper (void *cls,
 }
 
 
+/**
+ * Drop the expired addresses of a host and update the store if
+ * that changed anything.
+ *
+ * @param cls pointer to current time (`struct GNUNET_TIME_Absolute *`)
+ * @param key identity of the host
+ * @param value the `struct HostEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+discard_hosts_store_helper (void *cls,
+                            const struct GNUNET_PeerIdentity *key,
+                            void *value)
+{
+  struct GNUNET_TIME_Absolute *now = cls;
+  struct HostEntry *he = value;
+  struct GNUNET_HELLO_Message *hello_clean;
+  struct GNUNET_HELLO_Message *friend_clean;
+  int changed;
+
+  hello_clean = clean_hello (he->hello,
+                             now);
+  friend_clean = clean_hello (he->friend_only_hello,
+                              now);
+  changed = ( (GNUNET_YES == hello_shrunk (he->hello,
+                                           hello_clean)) ||
+              (GNUNET_YES == hello_shrunk (he->friend_only_hello,
+                                           friend_clean)) );
+  if (! changed)
+  {
+    GNUNET_free_non_null (hello_clean);
+    GNUNET_free_non_null (friend_clean);
+    return GNUNET_YES;
+  }
+  set_hello (he,
+             GNUNET_NO,
+             hello_clean);
+  set_hello (he,
+             GNUNET_YES,
+             friend_clean);
+  write_host_entry (he);
+  return GNUNET_YES;
+}
+
+
 /**
  * Call this method periodically to scan peerinfo/ for ancient
  * HELLOs to expire.
@@ -1072,6 +1606,21 @@ cron_clean_data_hosts (void *cls)
 
   cron_clean = NULL;
   now = GNUNET_TIME_absolute_get ();
+  if (NULL != store)
+  {
+    GNUNET_CONTAINER_multipeermap_iterate (hostmap,
+                                           &discard_hosts_store_helper,
+                                           &now);
+    if (GNUNET_OK == GPS_store_compact (store))
+      GNUNET_STATISTICS_update (stats,
+                                gettext_noop ("# HELLO store compactions"),
+                                1,
+                                GNUNET_NO);
+    cron_clean = GNUNET_SCHEDULER_add_delayed (DATA_HOST_CLEAN_FREQ,
+                                               &cron_clean_data_hosts,
+                                               NULL);
+    return;
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_INFO | GNUNET_ERROR_TYPE_BULK,
               _("Cleaning up directory `%s'\n"),
               networkIdDirectory);
@@ -1283,8 +1832,12 @@ free_host_entry (void *cls,
 {
   struct HostEntry *he = value;
 
-  GNUNET_free_non_null (he->hello);
-  GNUNET_free_non_null (he->friend_only_hello);
+  set_hello (he,
+             GNUNET_NO,
+             NULL);
+  set_hello (he,
+             GNUNET_YES,
+             NULL);
   GNUNET_free (he);
   return GNUNET_YES;
 }
@@ -1302,6 +1855,8 @@ shutdown_task (void *cls)
   notify_list = NULL;
   GNUNET_notification_context_destroy (notify_friend_only_list);
   notify_friend_only_list = NULL;
+  if (NULL != store)
+    (void) GPS_store_compact (store);
 
   GNUNET_CONTAINER_multipeermap_iterate (hostmap,
                                          &free_host_entry,
@@ -1323,6 +1878,11 @@ shutdown_task (void *cls)
     GNUNET_SCHEDULER_cancel (cron_scan);
     cron_scan = NULL;
   }
+  if (NULL != store)
+  {
+    GPS_store_close (store);
+    store = NULL;
+  }
   if (NULL != networkIdDirectory)
   {
     GNUNET_free (networkIdDirectory);
@@ -1343,11 +1903,20 @@ run (void *cls,
      const struct GNUNET_CONFIGURATION_Handle *cfg,
      struct GNUNET_SERVICE_Handle *service)
 {
+  static const char *store_choices[] = {
+    "FILES",
+    "LOG",
+    NULL
+  };
+  const char *store_type;
   char *peerdir;
+  char *storefn;
+  char *hostdir;
   char *ip;
   struct DirScanContext dsc;
   int noio;
   int use_included;
+  int ret;
 
   hostmap
     = GNUNET_CONTAINER_multipeermap_create (1024,
@@ -1378,16 +1947,54 @@ run (void *cls,
 							    "HOSTS",
 							    &networkIdDirectory));
     if (GNUNET_OK !=
-	GNUNET_DISK_directory_create (networkIdDirectory))
+        GNUNET_CONFIGURATION_get_value_choice (cfg,
+                                               "peerinfo",
+                                               "STORE",
+                                               store_choices,
+                                               &store_type))
+      store_type = store_choices[0];
+    if (0 == strcmp (store_type,
+                     "LOG"))
     {
-      GNUNET_SCHEDULER_shutdown ();
-      return;
+      if (GNUNET_OK !=
+          GNUNET_CONFIGURATION_get_value_filename (cfg,
+                                                   "peerinfo",
+                                                   "HOSTS_FILE",
+                                                   &storefn))
+      {
+        GNUNET_log_config_missing (GNUNET_ERROR_TYPE_ERROR,
+                                   "peerinfo",
+                                   "HOSTS_FILE");
+        GNUNET_SCHEDULER_shutdown ();
+        return;
+      }
+      /* the per-peer files are only imported, never written */
+      hostdir = networkIdDirectory;
+      networkIdDirectory = NULL;
+      ret = load_store (storefn,
+                        hostdir);
+      GNUNET_free (hostdir);
+      GNUNET_free (storefn);
+      if (GNUNET_OK != ret)
+      {
+        GNUNET_SCHEDULER_shutdown ();
+        return;
+      }
     }
+    else
+    {
+      if (GNUNET_OK !=
+          GNUNET_DISK_directory_create (networkIdDirectory))
+      {
+        GNUNET_SCHEDULER_shutdown ();
+        return;
+      }
 
-    cron_scan
-      = GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
-                                            &cron_scan_directory_data_hosts,
-                                            NULL);
+      cron_scan
+        = GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
+                                              &cron_scan_directory_data_hosts,
+                                              NULL);
+    }
 
     cron_clean
       = GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
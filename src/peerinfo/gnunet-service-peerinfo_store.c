@@ -0,0 +1,821 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file peerinfo/gnunet-service-peerinfo_store.c
+ * @brief log-structured single-file store for HELLOs
+ *
+ * All HELLOs live in one file.  Each update appends a record with
+ * the public and friend-only HELLO of a peer; the latest record of
+ * a peer wins, a record without HELLOs removes the peer.  When the
+ * store is opened the file is mapped into memory and scanned once,
+ * which is much cheaper than opening one file per peer.  Records
+ * that were superseded stay in the file until the store is
+ * compacted, which rewrites the file with the current records only.
+ *
+ * Every record carries a CRC, so a record that was only partially
+ * written before a crash is detected and cut off when the store is
+ * opened the next time.
+ */
+#include "platform.h"
+#include "gnunet-service-peerinfo_store.h"
+
+#define LOG(kind,...) GNUNET_log_from (kind, "peerinfo-store",__VA_ARGS__)
+
+/**
+ * Magic number at the beginning of the file ("GPS1").
+ */
+#define STORE_MAGIC 0x47505331
+
+/**
+ * Do not bother compacting stores with less garbage than this.
+ */
+#define MIN_GARBAGE (64 * 1024)
+
+/**
+ * Permissions for the file.
+ */
+#define STORE_PERM (GNUNET_DISK_PERM_USER_READ | GNUNET_DISK_PERM_USER_WRITE \
+                    | GNUNET_DISK_PERM_GROUP_READ | GNUNET_DISK_PERM_OTHER_READ)
+
+/**
+ * Round @a s up so that HELLOs in the mapped file are 8-byte aligned.
+ */
+#define ALIGN_HELLO(s) (((s) + 7) & ~((size_t) 7))
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Header at the beginning of the file.
+ */
+struct StoreHeader
+{
+  /**
+   * Always #STORE_MAGIC, in NBO.
+   */
+  uint32_t magic GNUNET_PACKED;
+
+  /**
+   * Always zero.
+   */
+  uint32_t reserved GNUNET_PACKED;
+};
+
+
+/**
+ * Header of a record.  Followed by the public HELLO and the
+ * friend-only HELLO, each padded with zeros to a multiple of 8 bytes.
+ */
+struct StoreRecord
+{
+  /**
+   * CRC32 over the rest of the record, in NBO.
+   */
+  uint32_t crc GNUNET_PACKED;
+
+  /**
+   * Size of the public HELLO, 0 for none, in NBO.
+   */
+  uint16_t hello_size GNUNET_PACKED;
+
+  /**
+   * Size of the friend-only HELLO, 0 for none, in NBO.
+   */
+  uint16_t friend_only_hello_size GNUNET_PACKED;
+
+  /**
+   * Peer the record is for.
+   */
+  struct GNUNET_PeerIdentity peer;
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+/**
+ * Location of the current record of a peer.
+ */
+struct IndexEntry
+{
+  /**
+   * Offset of the record in the file.
+   */
+  uint64_t off;
+
+  /**
+   * Offset of the record in the file being written by a compaction.
+   */
+  uint64_t new_off;
+
+  /**
+   * Size of the record.
+   */
+  size_t size;
+};
+
+
+/**
+ * Handle to a HELLO store.
+ */
+struct GPS_Store
+{
+  /**
+   * Name of the file.
+   */
+  char *fn;
+
+  /**
+   * The file, opened for appending.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Map from peer identities to `struct IndexEntry`.
+   */
+  struct GNUNET_CONTAINER_MultiPeerMap *index;
+
+  /**
+   * Size of the file.
+   */
+  uint64_t size;
+
+  /**
+   * Sum of the sizes of all current records.
+   */
+  uint64_t live;
+};
+
+
+/**
+ * Compute the size of a record.
+ *
+ * @param hs size of the public HELLO
+ * @param fs size of the friend-only HELLO
+ * @return size of the record
+ */
+static size_t
+record_size (uint16_t hs,
+             uint16_t fs)
+{
+  return sizeof (struct StoreRecord) + ALIGN_HELLO (hs) + ALIGN_HELLO (fs);
+}
+
+
+/**
+ * Compute the checksum of a record.
+ *
+ * @param rec the record
+ * @param len size of the record
+ * @return checksum in NBO
+ */
+static uint32_t
+record_crc (const struct StoreRecord *rec,
+            size_t len)
+{
+  return htonl ((uint32_t) GNUNET_CRYPTO_crc32_n (&rec->hello_size,
+                                                  len - sizeof (uint32_t)));
+}
+
+
+/**
+ * Check that a well-formed record starts at @a data.
+ *
+ * @param data the record
+ * @param avail number of bytes available at @a data
+ * @return size of the record, 0 if it is damaged or incomplete
+ */
+static size_t
+check_record (const char *data,
+              uint64_t avail)
+{
+  const struct StoreRecord *rec = (const struct StoreRecord *) data;
+  const char *hellos = (const char *) &rec[1];
+  uint16_t hs;
+  uint16_t fs;
+  size_t len;
+
+  if (avail < sizeof (struct StoreRecord))
+    return 0;
+  hs = ntohs (rec->hello_size);
+  fs = ntohs (rec->friend_only_hello_size);
+  len = record_size (hs, fs);
+  if ( (len > avail) ||
+       (rec->crc != record_crc (rec,
+                                len)) )
+    return 0;
+  if ( (0 != hs) &&
+       (hs != GNUNET_HELLO_size ((const struct GNUNET_HELLO_Message *) hellos)) )
+    return 0;
+  if ( (0 != fs) &&
+       (fs != GNUNET_HELLO_size ((const struct GNUNET_HELLO_Message *) &hellos[ALIGN_HELLO (hs)])) )
+    return 0;
+  return len;
+}
+
+
+/**
+ * Make a record the current one of its peer.
+ *
+ * @param store store to update
+ * @param rec the record
+ * @param off offset of @a rec in the file
+ * @param len size of @a rec
+ */
+static void
+index_record (struct GPS_Store *store,
+              const struct StoreRecord *rec,
+              uint64_t off,
+              size_t len)
+{
+  struct IndexEntry *entry;
+  int removal;
+
+  removal = ( (0 == rec->hello_size) &&
+              (0 == rec->friend_only_hello_size) );
+  entry = GNUNET_CONTAINER_multipeermap_get (store->index,
+                                             &rec->peer);
+  if (NULL != entry)
+  {
+    store->live -= entry->size;
+    if (removal)
+    {
+      GNUNET_assert (GNUNET_YES ==
+                     GNUNET_CONTAINER_multipeermap_remove (store->index,
+                                                           &rec->peer,
+                                                           entry));
+      GNUNET_free (entry);
+      return;
+    }
+  }
+  else
+  {
+    if (removal)
+      return;
+    entry = GNUNET_new (struct IndexEntry);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multipeermap_put (store->index,
+                                                      &rec->peer,
+                                                      entry,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  }
+  entry->off = off;
+  entry->size = len;
+  store->live += len;
+}
+
+
+/**
+ * Closure for #call_iterator().
+ */
+struct IteratorContext
+{
+  /**
+   * Function to call.
+   */
+  GPS_StoreIterator it;
+
+  /**
+   * Closure for @e it.
+   */
+  void *it_cls;
+
+  /**
+   * Mapping of the file.
+   */
+  const char *data;
+};
+
+
+/**
+ * Pass the current record of a peer to the iterator.
+ *
+ * @param cls the `struct IteratorContext`
+ * @param key the peer
+ * @param value the `struct IndexEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+call_iterator (void *cls,
+               const struct GNUNET_PeerIdentity *key,
+               void *value)
+{
+  struct IteratorContext *ic = cls;
+  const struct IndexEntry *entry = value;
+  const struct StoreRecord *rec;
+  const char *hellos;
+  uint16_t hs;
+  uint16_t fs;
+
+  rec = (const struct StoreRecord *) &ic->data[entry->off];
+  hellos = (const char *) &rec[1];
+  hs = ntohs (rec->hello_size);
+  fs = ntohs (rec->friend_only_hello_size);
+  ic->it (ic->it_cls,
+          key,
+          (0 == hs) ? NULL : (const struct GNUNET_HELLO_Message *) hellos,
+          (0 == fs) ? NULL : (const struct GNUNET_HELLO_Message *) &hellos[ALIGN_HELLO (hs)]);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Create an empty file for the store.
+ *
+ * @param store the store
+ * @return #GNUNET_OK on success
+ */
+static int
+create_file (struct GPS_Store *store)
+{
+  struct StoreHeader hdr;
+
+  hdr.magic = htonl (STORE_MAGIC);
+  hdr.reserved = htonl (0);
+  if ((ssize_t) sizeof (hdr) !=
+      GNUNET_DISK_fn_write (store->fn,
+                            &hdr,
+                            sizeof (hdr),
+                            STORE_PERM))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "write",
+                              store->fn);
+    return GNUNET_SYSERR;
+  }
+  store->size = sizeof (hdr);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Build the index of an existing file and pass the current records
+ * to the iterator.
+ *
+ * @param store the store
+ * @param it function to call on each peer, can be NULL
+ * @param it_cls closure for @a it
+ * @return #GNUNET_OK on success
+ */
+static int
+load_file (struct GPS_Store *store,
+           GPS_StoreIterator it,
+           void *it_cls)
+{
+  struct GNUNET_DISK_FileHandle *fh;
+  struct GNUNET_DISK_MapHandle *map;
+  const struct StoreHeader *hdr;
+  struct IteratorContext ic;
+  const char *data;
+  off_t fsize;
+  uint64_t pos;
+  size_t len;
+
+  fh = GNUNET_DISK_file_open (store->fn,
+                              GNUNET_DISK_OPEN_READ,
+                              GNUNET_DISK_PERM_NONE);
+  if (NULL == fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "open",
+                              store->fn);
+    return GNUNET_SYSERR;
+  }
+  if ( (GNUNET_OK !=
+        GNUNET_DISK_file_handle_size (fh,
+                                      &fsize)) ||
+       (fsize < (off_t) sizeof (struct StoreHeader)) )
+  {
+    /* nothing useful in there (yet) */
+    GNUNET_DISK_file_close (fh);
+    return create_file (store);
+  }
+  data = GNUNET_DISK_file_map (fh,
+                               &map,
+                               GNUNET_DISK_MAP_TYPE_READ,
+                               fsize);
+  if (NULL == data)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "mmap",
+                              store->fn);
+    GNUNET_DISK_file_close (fh);
+    return GNUNET_SYSERR;
+  }
+  hdr = (const struct StoreHeader *) data;
+  if (STORE_MAGIC != ntohl (hdr->magic))
+  {
+    LOG (GNUNET_ERROR_TYPE_ERROR,
+         _("File `%s' is not a HELLO store\n"),
+         store->fn);
+    GNUNET_DISK_file_unmap (map);
+    GNUNET_DISK_file_close (fh);
+    return GNUNET_SYSERR;
+  }
+  pos = sizeof (struct StoreHeader);
+  while (0 != (len = check_record (&data[pos],
+                                   fsize - pos)))
+  {
+    index_record (store,
+                  (const struct StoreRecord *) &data[pos],
+                  pos,
+                  len);
+    pos += len;
+  }
+  if (NULL != it)
+  {
+    ic.it = it;
+    ic.it_cls = it_cls;
+    ic.data = data;
+    GNUNET_CONTAINER_multipeermap_iterate (store->index,
+                                           &call_iterator,
+                                           &ic);
+  }
+  GNUNET_DISK_file_unmap (map);
+  GNUNET_DISK_file_close (fh);
+  if (pos < (uint64_t) fsize)
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         _("Discarding %llu damaged bytes at the end of `%s'\n"),
+         (unsigned long long) (fsize - pos),
+         store->fn);
+    if (0 != TRUNCATE (store->fn,
+                       pos))
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "truncate",
+                                store->fn);
+      return GNUNET_SYSERR;
+    }
+  }
+  store->size = pos;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Loaded %u peers (%llu of %llu bytes live) from `%s'\n",
+       GNUNET_CONTAINER_multipeermap_size (store->index),
+       (unsigned long long) store->live,
+       (unsigned long long) store->size,
+       store->fn);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Free an entry of the index.
+ *
+ * @param cls NULL
+ * @param key the peer
+ * @param value the `struct IndexEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+free_entry (void *cls,
+            const struct GNUNET_PeerIdentity *key,
+            void *value)
+{
+  GNUNET_free (value);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Open a store, creating the file if it does not exist yet, and
+ * pass the latest HELLOs of every peer in it to @a it.  A damaged
+ * tail (from a crash during an append) is cut off.
+ *
+ * @param fn name of the file to use
+ * @param it function to call on each peer in the store, can be NULL
+ * @param it_cls closure for @a it
+ * @return NULL on error
+ */
+struct GPS_Store *
+GPS_store_open (const char *fn,
+                GPS_StoreIterator it,
+                void *it_cls)
+{
+  struct GPS_Store *store;
+  int ret;
+
+  store = GNUNET_new (struct GPS_Store);
+  store->fn = GNUNET_strdup (fn);
+  store->index = GNUNET_CONTAINER_multipeermap_create (1024,
+                                                       GNUNET_NO);
+  if (GNUNET_YES == GNUNET_DISK_file_test (fn))
+    ret = load_file (store,
+                     it,
+                     it_cls);
+  else
+    ret = create_file (store);
+  if (GNUNET_OK == ret)
+  {
+    store->fh = GNUNET_DISK_file_open (fn,
+                                       GNUNET_DISK_OPEN_WRITE | GNUNET_DISK_OPEN_APPEND,
+                                       GNUNET_DISK_PERM_NONE);
+    if (NULL == store->fh)
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "open",
+                                fn);
+      ret = GNUNET_SYSERR;
+    }
+  }
+  if (GNUNET_OK != ret)
+  {
+    GPS_store_close (store);
+    return NULL;
+  }
+  return store;
+}
+
+
+/**
+ * Replace the HELLOs stored for a peer.  The new record is
+ * appended to the file, the old one becomes garbage.
+ *
+ * @param store store to modify
+ * @param peer peer the HELLOs are for
+ * @param hello public HELLO to store, NULL for none
+ * @param friend_only_hello friend-only HELLO to store, NULL for none;
+ *        if both are NULL, the peer is removed from the store
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ */
+int
+GPS_store_put (struct GPS_Store *store,
+               const struct GNUNET_PeerIdentity *peer,
+               const struct GNUNET_HELLO_Message *hello,
+               const struct GNUNET_HELLO_Message *friend_only_hello)
+{
+  struct StoreRecord *rec;
+  char *hellos;
+  uint16_t hs;
+  uint16_t fs;
+  size_t len;
+  ssize_t ret;
+
+  hs = (NULL == hello) ? 0 : GNUNET_HELLO_size (hello);
+  fs = (NULL == friend_only_hello) ? 0 : GNUNET_HELLO_size (friend_only_hello);
+  if ( (0 == hs) &&
+       (0 == fs) &&
+       (GNUNET_NO ==
+        GNUNET_CONTAINER_multipeermap_contains (store->index,
+                                                peer)) )
+    return GNUNET_OK; /* nothing to remove */
+  len = record_size (hs, fs);
+  rec = GNUNET_malloc (len);
+  hellos = (char *) &rec[1];
+  rec->hello_size = htons (hs);
+  rec->friend_only_hello_size = htons (fs);
+  rec->peer = *peer;
+  GNUNET_memcpy (hellos,
+                 hello,
+                 hs);
+  GNUNET_memcpy (&hellos[ALIGN_HELLO (hs)],
+                 friend_only_hello,
+                 fs);
+  rec->crc = record_crc (rec,
+                         len);
+  ret = GNUNET_DISK_file_write (store->fh,
+                                rec,
+                                len);
+  if ((ssize_t) len != ret)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "write",
+                              store->fn);
+    /* do not leave a partial record in front of the next one */
+    if ( (0 < ret) &&
+         (0 != TRUNCATE (store->fn,
+                         store->size)) )
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "truncate",
+                                store->fn);
+    GNUNET_free (rec);
+    return GNUNET_SYSERR;
+  }
+  index_record (store,
+                rec,
+                store->size,
+                len);
+  store->size += len;
+  GNUNET_free (rec);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Closure for #copy_record().
+ */
+struct CompactContext
+{
+  /**
+   * File being written.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Mapping of the old file.
+   */
+  const char *data;
+
+  /**
+   * Size of the new file so far.
+   */
+  uint64_t pos;
+};
+
+
+/**
+ * Copy the current record of a peer to the new file.
+ *
+ * @param cls the `struct CompactContext`
+ * @param key the peer
+ * @param value the `struct IndexEntry`
+ * @return #GNUNET_YES to continue, #GNUNET_NO on write errors
+ */
+static int
+copy_record (void *cls,
+             const struct GNUNET_PeerIdentity *key,
+             void *value)
+{
+  struct CompactContext *cc = cls;
+  struct IndexEntry *entry = value;
+
+  if ((ssize_t) entry->size !=
+      GNUNET_DISK_file_write (cc->fh,
+                              &cc->data[entry->off],
+                              entry->size))
+    return GNUNET_NO;
+  entry->new_off = cc->pos;
+  cc->pos += entry->size;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Switch the index over to the offsets in the compacted file.
+ *
+ * @param cls NULL
+ * @param key the peer
+ * @param value the `struct IndexEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+commit_offset (void *cls,
+               const struct GNUNET_PeerIdentity *key,
+               void *value)
+{
+  struct IndexEntry *entry = value;
+
+  entry->off = entry->new_off;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Rewrite the file with only the current records if it holds more
+ * garbage than live data.
+ *
+ * @param store store to compact
+ * @return #GNUNET_OK if the store was compacted, #GNUNET_NO if
+ *         there was not enough garbage, #GNUNET_SYSERR on error
+ */
+int
+GPS_store_compact (struct GPS_Store *store)
+{
+  struct GNUNET_DISK_FileHandle *fh;
+  struct GNUNET_DISK_MapHandle *map;
+  struct CompactContext cc;
+  struct StoreHeader hdr;
+  uint64_t garbage;
+  char *tmp;
+  int ret;
+
+  garbage = store->size - sizeof (struct StoreHeader) - store->live;
+  if ( (garbage < MIN_GARBAGE) ||
+       (garbage < store->live) )
+    return GNUNET_NO;
+  fh = GNUNET_DISK_file_open (store->fn,
+                              GNUNET_DISK_OPEN_READ,
+                              GNUNET_DISK_PERM_NONE);
+  if (NULL == fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "open",
+                              store->fn);
+    return GNUNET_SYSERR;
+  }
+  cc.data = GNUNET_DISK_file_map (fh,
+                                  &map,
+                                  GNUNET_DISK_MAP_TYPE_READ,
+                                  store->size);
+  if (NULL == cc.data)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "mmap",
+                              store->fn);
+    GNUNET_DISK_file_close (fh);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_asprintf (&tmp,
+                   "%s.tmp",
+                   store->fn);
+  cc.fh = GNUNET_DISK_file_open (tmp,
+                                 GNUNET_DISK_OPEN_WRITE | GNUNET_DISK_OPEN_CREATE
+                                 | GNUNET_DISK_OPEN_TRUNCATE,
+                                 STORE_PERM);
+  ret = GNUNET_SYSERR;
+  if (NULL != cc.fh)
+  {
+    hdr.magic = htonl (STORE_MAGIC);
+    hdr.reserved = htonl (0);
+    cc.pos = sizeof (hdr);
+    if ( ((ssize_t) sizeof (hdr) ==
+          GNUNET_DISK_file_write (cc.fh,
+                                  &hdr,
+                                  sizeof (hdr))) &&
+         (GNUNET_SYSERR !=
+          GNUNET_CONTAINER_multipeermap_iterate (store->index,
+                                                 &copy_record,
+                                                 &cc)) &&
+         (cc.pos == sizeof (hdr) + store->live) &&
+         (GNUNET_OK ==
+          GNUNET_DISK_file_sync (cc.fh)) )
+      ret = GNUNET_OK;
+    GNUNET_DISK_file_close (cc.fh);
+  }
+  GNUNET_DISK_file_unmap (map);
+  GNUNET_DISK_file_close (fh);
+  if ( (GNUNET_OK == ret) &&
+       (0 != RENAME (tmp,
+                     store->fn)) )
+    ret = GNUNET_SYSERR;
+  if (GNUNET_OK != ret)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "write",
+                              tmp);
+    (void) UNLINK (tmp);
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_free (tmp);
+  GNUNET_CONTAINER_multipeermap_iterate (store->index,
+                                         &commit_offset,
+                                         NULL);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Compacted `%s' from %llu to %llu bytes\n",
+       store->fn,
+       (unsigned long long) store->size,
+       (unsigned long long) cc.pos);
+  store->size = cc.pos;
+  GNUNET_DISK_file_close (store->fh);
+  store->fh = GNUNET_DISK_file_open (store->fn,
+                                     GNUNET_DISK_OPEN_WRITE | GNUNET_DISK_OPEN_APPEND,
+                                     GNUNET_DISK_PERM_NONE);
+  if (NULL == store->fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "open",
+                              store->fn);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Close a store.
+ *
+ * @param store store to close
+ */
+void
+GPS_store_close (struct GPS_Store *store)
+{
+  if (NULL != store->fh)
+    GNUNET_DISK_file_close (store->fh);
+  GNUNET_CONTAINER_multipeermap_iterate (store->index,
+                                         &free_entry,
+                                         NULL);
+  GNUNET_CONTAINER_multipeermap_destroy (store->index);
+  GNUNET_free (store->fn);
+  GNUNET_free (store);
+}
+
+
+/* end of gnunet-service-peerinfo_store.c */
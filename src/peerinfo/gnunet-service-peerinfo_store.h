@@ -0,0 +1,114 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file peerinfo/gnunet-service-peerinfo_store.h
+ * @brief log-structured single-file store for HELLOs
+ *
+ * All functions in this file should use the prefix GPS (Gnunet
+ * Peerinfo Store)
+ */
+#ifndef GNUNET_SERVICE_PEERINFO_STORE_H
+#define GNUNET_SERVICE_PEERINFO_STORE_H
+
+#include "gnunet_util_lib.h"
+#include "gnunet_hello_lib.h"
+
+
+/**
+ * Handle to a HELLO store.
+ */
+struct GPS_Store;
+
+
+/**
+ * Function called for each peer found in the store when it is
+ * opened.  The HELLOs point into a mapping of the file and are only
+ * valid for the duration of the call.
+ *
+ * @param cls closure
+ * @param peer identity of the peer
+ * @param hello public HELLO of the peer, can be NULL
+ * @param friend_only_hello friend-only HELLO of the peer, can be NULL
+ */
+typedef void
+(*GPS_StoreIterator) (void *cls,
+                      const struct GNUNET_PeerIdentity *peer,
+                      const struct GNUNET_HELLO_Message *hello,
+                      const struct GNUNET_HELLO_Message *friend_only_hello);
+
+
+/**
+ * Open a store, creating the file if it does not exist yet, and
+ * pass the latest HELLOs of every peer in it to @a it.  A damaged
+ * tail (from a crash during an append) is cut off.
+ *
+ * @param fn name of the file to use
+ * @param it function to call on each peer in the store, can be NULL
+ * @param it_cls closure for @a it
+ * @return NULL on error
+ */
+struct GPS_Store *
+GPS_store_open (const char *fn,
+                GPS_StoreIterator it,
+                void *it_cls);
+
+
+/**
+ * Replace the HELLOs stored for a peer.  The new record is
+ * appended to the file, the old one becomes garbage.
+ *
+ * @param store store to modify
+ * @param peer peer the HELLOs are for
+ * @param hello public HELLO to store, NULL for none
+ * @param friend_only_hello friend-only HELLO to store, NULL for none;
+ *        if both are NULL, the peer is removed from the store
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ */
+int
+GPS_store_put (struct GPS_Store *store,
+               const struct GNUNET_PeerIdentity *peer,
+               const struct GNUNET_HELLO_Message *hello,
+               const struct GNUNET_HELLO_Message *friend_only_hello);
+
+
+/**
+ * Rewrite the file with only the current records if it holds more
+ * garbage than live data.
+ *
+ * @param store store to compact
+ * @return #GNUNET_OK if the store was compacted, #GNUNET_NO if
+ *         there was not enough garbage, #GNUNET_SYSERR on error
+ */
+int
+GPS_store_compact (struct GPS_Store *store);
+
+
+/**
+ * Close a store.
+ *
+ * @param store store to close
+ */
+void
+GPS_store_close (struct GPS_Store *store);
+
+
+#endif
+/* end of gnunet-service-peerinfo_store.h */
@@ -0,0 +1,365 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file peerinfo/perf_peerinfo_store.c
+ * @brief measure how long the peerinfo service needs to load the
+ *        HELLOs of 100k peers at startup, from one file per peer
+ *        and from the single-file store
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_hello_lib.h"
+#include "gnunet-service-peerinfo_store.h"
+#include <gauger.h>
+
+/**
+ * Number of peers to store.
+ */
+#define NUM_PEERS (100 * 1000)
+
+/**
+ * Every FRIEND_RATIO-th peer also has a friend-only HELLO.
+ */
+#define FRIEND_RATIO 4
+
+/**
+ * Public HELLOs of the peers.
+ */
+static struct GNUNET_HELLO_Message **hellos;
+
+/**
+ * Friend-only HELLOs of the peers, NULL for most.
+ */
+static struct GNUNET_HELLO_Message **friend_hellos;
+
+/**
+ * Identities of the peers.
+ */
+static struct GNUNET_PeerIdentity *pids;
+
+/**
+ * Number of HELLOs found while loading.
+ */
+static unsigned int found;
+
+
+/**
+ * Generate two addresses for a HELLO.
+ *
+ * @param cls pointer to the number of addresses left to generate
+ * @param max maximum number of bytes to write to @a buf
+ * @param buf where to write the address
+ * @return number of bytes written, #GNUNET_SYSERR when done
+ */
+static ssize_t
+address_generator (void *cls,
+                   size_t max,
+                   void *buf)
+{
+  unsigned int *agc = cls;
+  struct GNUNET_HELLO_Address address;
+  char caddress[16];
+
+  if (0 == *agc)
+    return GNUNET_SYSERR;
+  GNUNET_snprintf (caddress,
+                   sizeof (caddress),
+                   "Address%u",
+                   *agc);
+  memset (&address,
+          0,
+          sizeof (address));
+  address.address_length = strlen (caddress) + 1;
+  address.address = caddress;
+  address.transport_name = "tcp";
+  (*agc)--;
+  return GNUNET_HELLO_add_address (&address,
+                                   GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS),
+                                   buf,
+                                   max);
+}
+
+
+/**
+ * Create the HELLOs of all peers.
+ */
+static void
+make_hellos ()
+{
+  unsigned int agc;
+
+  pids = GNUNET_new_array (NUM_PEERS,
+                           struct GNUNET_PeerIdentity);
+  hellos = GNUNET_new_array (NUM_PEERS,
+                             struct GNUNET_HELLO_Message *);
+  friend_hellos = GNUNET_new_array (NUM_PEERS,
+                                    struct GNUNET_HELLO_Message *);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              pids,
+                              NUM_PEERS * sizeof (struct GNUNET_PeerIdentity));
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    agc = 2;
+    hellos[i] = GNUNET_HELLO_create (&pids[i].public_key,
+                                     &address_generator,
+                                     &agc,
+                                     GNUNET_NO);
+    if (0 != i % FRIEND_RATIO)
+      continue;
+    agc = 2;
+    friend_hellos[i] = GNUNET_HELLO_create (&pids[i].public_key,
+                                            &address_generator,
+                                            &agc,
+                                            GNUNET_YES);
+  }
+}
+
+
+/**
+ * Write one file per peer, as the service does with STORE = FILES.
+ *
+ * @param dir directory to write to
+ * @return #GNUNET_OK on success
+ */
+static int
+write_files (const char *dir)
+{
+  char buf[GNUNET_SERVER_MAX_MESSAGE_SIZE - 1];
+  char *fn;
+  size_t hs;
+  size_t fs;
+
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    hs = GNUNET_HELLO_size (hellos[i]);
+    fs = (NULL == friend_hellos[i]) ? 0 : GNUNET_HELLO_size (friend_hellos[i]);
+    GNUNET_memcpy (buf,
+                   hellos[i],
+                   hs);
+    GNUNET_memcpy (&buf[hs],
+                   friend_hellos[i],
+                   fs);
+    GNUNET_asprintf (&fn,
+                     "%s%s%s",
+                     dir,
+                     DIR_SEPARATOR_STR,
+                     GNUNET_i2s_full (&pids[i]));
+    if ((ssize_t) (hs + fs) !=
+        GNUNET_DISK_fn_write (fn,
+                              buf,
+                              hs + fs,
+                              GNUNET_DISK_PERM_USER_READ |
+                              GNUNET_DISK_PERM_USER_WRITE))
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "write",
+                                fn);
+      GNUNET_free (fn);
+      return GNUNET_SYSERR;
+    }
+    GNUNET_free (fn);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Read a per-peer file and count the HELLOs in it.
+ *
+ * @param cls NULL
+ * @param fn name of the file
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+read_file (void *cls,
+           const char *fn)
+{
+  char buf[GNUNET_SERVER_MAX_MESSAGE_SIZE - 1] GNUNET_ALIGN;
+  ssize_t size;
+  ssize_t pos;
+  uint16_t hs;
+
+  size = GNUNET_DISK_fn_read (fn,
+                              buf,
+                              sizeof (buf));
+  pos = 0;
+  while (pos < size)
+  {
+    hs = GNUNET_HELLO_size ((const struct GNUNET_HELLO_Message *) &buf[pos]);
+    if (0 == hs)
+      break;
+    found++;
+    pos += hs;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Count the HELLOs of a peer in the store.
+ *
+ * @param cls NULL
+ * @param peer identity of the peer
+ * @param hello public HELLO of the peer, can be NULL
+ * @param friend_only_hello friend-only HELLO of the peer, can be NULL
+ */
+static void
+count_hellos (void *cls,
+              const struct GNUNET_PeerIdentity *peer,
+              const struct GNUNET_HELLO_Message *hello,
+              const struct GNUNET_HELLO_Message *friend_only_hello)
+{
+  if (NULL != hello)
+    found++;
+  if (NULL != friend_only_hello)
+    found++;
+}
+
+
+/**
+ * Write all peers to the single-file store.
+ *
+ * @param fn name of the file of the store
+ * @return #GNUNET_OK on success
+ */
+static int
+write_store (const char *fn)
+{
+  struct GPS_Store *store;
+
+  store = GPS_store_open (fn,
+                          NULL,
+                          NULL);
+  if (NULL == store)
+    return GNUNET_SYSERR;
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+    if (GNUNET_OK !=
+        GPS_store_put (store,
+                       &pids[i],
+                       hellos[i],
+                       friend_hellos[i]))
+    {
+      GPS_store_close (store);
+      return GNUNET_SYSERR;
+    }
+  GPS_store_close (store);
+  return GNUNET_OK;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative files;
+  struct GNUNET_TIME_Relative log;
+  struct GPS_Store *store;
+  unsigned int expected;
+  char *tmp;
+  char *dir;
+  char *fn;
+  int ret;
+
+  GNUNET_log_setup ("perf-peerinfo-store",
+                    "WARNING",
+                    NULL);
+  tmp = GNUNET_DISK_mkdtemp ("perf-peerinfo-store");
+  if (NULL == tmp)
+    return 1;
+  GNUNET_asprintf (&dir,
+                   "%s%shosts",
+                   tmp,
+                   DIR_SEPARATOR_STR);
+  GNUNET_asprintf (&fn,
+                   "%s%shosts.log",
+                   tmp,
+                   DIR_SEPARATOR_STR);
+  make_hellos ();
+  expected = NUM_PEERS + (NUM_PEERS + FRIEND_RATIO - 1) / FRIEND_RATIO;
+  ret = 1;
+  if ( (GNUNET_OK !=
+        GNUNET_DISK_directory_create (dir)) ||
+       (GNUNET_OK !=
+        write_files (dir)) ||
+       (GNUNET_OK !=
+        write_store (fn)) )
+    goto cleanup;
+
+  found = 0;
+  start = GNUNET_TIME_absolute_get ();
+  GNUNET_DISK_directory_scan (dir,
+                              &read_file,
+                              NULL);
+  files = GNUNET_TIME_absolute_get_duration (start);
+  if (expected != found)
+  {
+    GNUNET_break (0);
+    goto cleanup;
+  }
+
+  found = 0;
+  start = GNUNET_TIME_absolute_get ();
+  store = GPS_store_open (fn,
+                          &count_hellos,
+                          NULL);
+  log = GNUNET_TIME_absolute_get_duration (start);
+  if (NULL == store)
+    goto cleanup;
+  GPS_store_close (store);
+  if (expected != found)
+  {
+    GNUNET_break (0);
+    goto cleanup;
+  }
+  ret = 0;
+  FPRINTF (stderr,
+           "Loading %u peers: %s from files, ",
+           NUM_PEERS,
+           GNUNET_STRINGS_relative_time_to_string (files,
+                                                   GNUNET_YES));
+  FPRINTF (stderr,
+           "%s from the log\n",
+           GNUNET_STRINGS_relative_time_to_string (log,
+                                                   GNUNET_YES));
+  GAUGER ("PEERINFO",
+          "Startup with 100k peers (one file per peer)",
+          files.rel_value_us / 1000LL,
+          "ms");
+  GAUGER ("PEERINFO",
+          "Startup with 100k peers (single-file store)",
+          log.rel_value_us / 1000LL,
+          "ms");
+cleanup:
+  for (unsigned int i=0;i<NUM_PEERS;i++)
+  {
+    GNUNET_free (hellos[i]);
+    GNUNET_free_non_null (friend_hellos[i]);
+  }
+  GNUNET_free (hellos);
+  GNUNET_free (friend_hellos);
+  GNUNET_free (pids);
+  GNUNET_DISK_directory_remove (tmp);
+  GNUNET_free (tmp);
+  GNUNET_free (dir);
+  GNUNET_free (fn);
+  return ret;
+}
+
+/* end of perf_peerinfo_store.c */
@@ -319,6 +319,26 @@ static char * regex_prefix;
  */
 static struct GNUNET_TIME_Relative reannounce_period_max;
 
+/**
+ * How many matching edges do searches follow in parallel.
+ */
+static unsigned int search_fanout = 3;
+
+/**
+ * Sum of the durations of all successful searches.
+ */
+static struct GNUNET_TIME_Relative search_time_total;
+
+/**
+ * Duration of the fastest successful search.
+ */
+static struct GNUNET_TIME_Relative search_time_min = { UINT64_MAX };
+
+/**
+ * Duration of the slowest successful search.
+ */
+static struct GNUNET_TIME_Relative search_time_max;
+
 
 /******************************************************************************/
 /******************************  DECLARATIONS  ********************************/
@@ -711,6 +731,28 @@ static void
 find_string (void *cls);
 
 
+/**
+ * Print the latency of the searches that succeeded so far.
+ */
+static void
+report_search_latency ()
+{
+  if (0 == strings_found)
+    return;
+  printf ("Search latency over %u strings: min %s, ",
+          strings_found,
+          GNUNET_STRINGS_relative_time_to_string (search_time_min,
+                                                  GNUNET_NO));
+  printf ("avg %s, ",
+          GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_relative_divide (search_time_total,
+                                                                               strings_found),
+                                                  GNUNET_NO));
+  printf ("max %s\n",
+          GNUNET_STRINGS_relative_time_to_string (search_time_max,
+                                                  GNUNET_NO));
+}
+
+
 /**
  * Method called when we've found a peer that announced a regex
  * that matches our search string. Now get the statistics.
@@ -764,6 +806,12 @@ regex_found_handler (void *cls,
   else
   {
     prof_time = GNUNET_TIME_absolute_get_duration (peer->prof_start_time);
+    search_time_total = GNUNET_TIME_relative_add (search_time_total,
+                                                  prof_time);
+    search_time_min = GNUNET_TIME_relative_min (search_time_min,
+                                                prof_time);
+    search_time_max = GNUNET_TIME_relative_max (search_time_max,
+                                                prof_time);
 
     GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                 "String %s found on peer %u after %s (%i/%i) (%u||)\n",
@@ -801,6 +849,7 @@ regex_found_handler (void *cls,
     GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                 "All strings successfully matched in %s\n",
                 GNUNET_STRINGS_relative_time_to_string (prof_time, GNUNET_NO));
+    report_search_latency ();
 
     if (NULL != search_timeout_task)
     {
@@ -831,6 +880,7 @@ search_timed_out (void *cls)
                                                       GNUNET_NO));
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Found %i of %i strings\n", strings_found, num_peers);
+  report_search_latency ();
 
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Search timed out after %s."
@@ -1056,6 +1106,8 @@ dht_connect_cb (void *cls,
   peer->search_str_matched = GNUNET_NO;
   peer->search_handle = REGEX_INTERNAL_search (peer->dht_handle,
                                              peer->search_str,
+                                             search_fanout,
+                                             NULL,
                                              &regex_found_handler, peer,
                                              NULL);
   peer->prof_start_time = GNUNET_TIME_absolute_get ();
@@ -1315,6 +1367,13 @@ run (void *cls,
     GNUNET_SCHEDULER_add_now (&do_shutdown, NULL);
     return;
   }
+  if (0 == search_fanout)
+  {
+    fprintf (stderr,
+             _("Fanout must be at least 1. Exiting\n"));
+    GNUNET_SCHEDULER_add_now (&do_shutdown, NULL);
+    return;
+  }
   cfg = GNUNET_CONFIGURATION_dup (config);
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_string (cfg, "REGEXPROFILER",
@@ -1493,6 +1552,9 @@ main (int argc, char *const *argv)
     {'H', "hosts-file", "FILENAME",
       gettext_noop ("name of file with hosts' names"),
       GNUNET_YES, &GNUNET_GETOPT_set_filename, &hosts_file},
+    {'F', "fanout", "EDGES",
+      gettext_noop ("number of matching edges to follow in parallel in each state"),
+      GNUNET_YES, &GNUNET_GETOPT_set_uint, &search_fanout},
     GNUNET_GETOPT_OPTION_END
   };
   int ret;
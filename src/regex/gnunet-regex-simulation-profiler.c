@@ -31,6 +31,7 @@
 #include "platform.h"
 #include "gnunet_util_lib.h"
 #include "regex_internal_lib.h"
+#include "regex_internal.h"
 #include "gnunet_mysql_lib.h"
 #include "gnunet_my_lib.h"
 #include <mysql/mysql.h>
@@ -151,6 +152,21 @@ static unsigned long long num_merged_transitions;
  */
 static unsigned long long num_merged_states;
 
+/**
+ * Total time spent constructing DFAs.
+ */
+static struct GNUNET_TIME_Relative dfa_time;
+
+/**
+ * Total time spent creating proofs, part of #dfa_time.
+ */
+static struct GNUNET_TIME_Relative proof_time;
+
+/**
+ * Number of states of all DFAs announced.
+ */
+static unsigned long long num_states;
+
 /**
  * Prefix to add before every regex we're announcing.
  */
@@ -455,11 +471,15 @@ static int
 announce_regex (const char *regex)
 {
   struct REGEX_INTERNAL_Automaton *dfa;
+  struct GNUNET_TIME_Absolute start;
 
+  start = GNUNET_TIME_absolute_get ();
   dfa =
       REGEX_INTERNAL_construct_dfa (regex,
 				    strlen (regex),
 				    max_path_compression);
+  dfa_time = GNUNET_TIME_relative_add (dfa_time,
+                                       GNUNET_TIME_absolute_get_duration (start));
 
   if (NULL == dfa)
   {
@@ -469,6 +489,9 @@ announce_regex (const char *regex)
     GNUNET_SCHEDULER_add_now (&do_abort, NULL);
     return GNUNET_SYSERR;
   }
+  proof_time = GNUNET_TIME_relative_add (proof_time,
+                                         dfa->proof_time);
+  num_states += dfa->state_count;
   REGEX_INTERNAL_iterate_all_edges (dfa,
 				    &regex_iterator, NULL);
   REGEX_INTERNAL_automaton_destroy (dfa);
@@ -605,6 +628,20 @@ do_directory_scan (void *cls)
           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO),
           num_merged_transitions,
 	  num_merged_states);
+  printf ("Constructed DFAs with %llu states in %s\n",
+          num_states,
+          GNUNET_STRINGS_relative_time_to_string (dfa_time, GNUNET_NO));
+  printf ("Creating proofs took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (proof_time, GNUNET_NO));
+#if HAVE_GETRUSAGE
+  {
+    struct rusage ru;
+
+    if (0 == getrusage (RUSAGE_SELF, &ru))
+      printf ("Peak memory use: %llu KiB\n",
+              (unsigned long long) ru.ru_maxrss);
+  }
+#endif
   result = GNUNET_OK;
   GNUNET_SCHEDULER_shutdown ();
 }
@@ -104,6 +104,16 @@ static struct GNUNET_SERVER_NotificationContext *nc;
  */
 static struct GNUNET_CRYPTO_EddsaPrivateKey *my_private_key;
 
+/**
+ * Blocks found by the searches of our clients.
+ */
+static struct REGEX_INTERNAL_BlockCache *block_cache;
+
+/**
+ * How many matching edges do searches follow in parallel?
+ */
+static unsigned long long search_fanout;
+
 
 /**
  * A client disconnected.  Remove all of its data structure entries.
@@ -161,6 +171,8 @@ cleanup_task (void *cls)
   while (NULL != (ce = client_head))
     handle_client_disconnect (NULL,
                               ce->client);
+  REGEX_INTERNAL_block_cache_destroy (block_cache);
+  block_cache = NULL;
   GNUNET_DHT_disconnect (dht);
   dht = NULL;
   GNUNET_STATISTICS_destroy (stats, GNUNET_NO);
@@ -335,6 +347,8 @@ handle_search (void *cls,
   ce->client = client;
   ce->sh = REGEX_INTERNAL_search (dht,
                                   string,
+                                  (unsigned int) search_fanout,
+                                  block_cache,
                                   &handle_search_result,
                                   ce,
                                   stats);
@@ -369,6 +383,7 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
     {&handle_search, NULL, GNUNET_MESSAGE_TYPE_REGEX_SEARCH, 0},
     {NULL, NULL, 0, 0}
   };
+  unsigned long long cache_size;
 
   my_private_key = GNUNET_CRYPTO_eddsa_key_create_from_configuration (cfg);
   if (NULL == my_private_key)
@@ -384,6 +399,23 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (cfg,
+                                               "REGEX",
+                                               "SEARCH_FANOUT",
+                                               &search_fanout)) ||
+       (0 == search_fanout) ||
+       (search_fanout > 16) )
+    search_fanout = 3;
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (cfg,
+                                               "REGEX",
+                                               "BLOCK_CACHE_SIZE",
+                                               &cache_size)) ||
+       (0 == cache_size) ||
+       (cache_size > UINT_MAX) )
+    cache_size = 4096;
+  block_cache = REGEX_INTERNAL_block_cache_create ((unsigned int) cache_size);
   GNUNET_SCHEDULER_add_shutdown (&cleanup_task,
 				 NULL);
   nc = GNUNET_SERVER_notification_context_create (server, 1);
@@ -27,6 +27,7 @@
 #include <time.h>
 #include "platform.h"
 #include "regex_internal_lib.h"
+#include "regex_internal.h"
 #include "regex_test_lib.h"
 
 
@@ -66,7 +67,8 @@ print_edge (void *cls,
  * The main function of the regex performace test.
  *
  * Read a set of regex from a file, combine them and create a DFA from the
- * resulting combined regex.
+ * resulting combined regex.  Reports how long building the DFA and
+ * creating the proofs took and the peak memory use of the process.
  *
  * @param argc number of arguments from the command line
  * @param argv command line arguments
@@ -81,6 +83,8 @@ main (int argc, char *const *argv)
   char *regex;
   int compression;
   long size;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
 
   GNUNET_log_setup ("perf-regex", "DEBUG", NULL);
   if (3 != argc)
@@ -108,7 +112,38 @@ main (int argc, char *const *argv)
 	   "Combined regex (%ld bytes):\n%s\n",
 	   size,
 	   regex);
+  start = GNUNET_TIME_absolute_get ();
   dfa = REGEX_INTERNAL_construct_dfa (regex, size, compression);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  if (NULL == dfa)
+  {
+    fprintf (stderr,
+             "Failed to construct DFA\n");
+    GNUNET_free (buffer);
+    REGEX_TEST_free_from_file (regexes);
+    GNUNET_free (regex);
+    return 3;
+  }
+  fprintf (stderr,
+           "Constructed DFA with %u states and %u transitions in %s\n",
+           dfa->state_count,
+           REGEX_INTERNAL_get_transition_count (dfa),
+           GNUNET_STRINGS_relative_time_to_string (duration,
+                                                   GNUNET_NO));
+  fprintf (stderr,
+           "Creating proofs took %s\n",
+           GNUNET_STRINGS_relative_time_to_string (dfa->proof_time,
+                                                   GNUNET_NO));
+#if HAVE_GETRUSAGE
+  {
+    struct rusage ru;
+
+    if (0 == getrusage (RUSAGE_SELF, &ru))
+      fprintf (stderr,
+               "Peak memory use: %llu KiB\n",
+               (unsigned long long) ru.ru_maxrss);
+  }
+#endif
   printf ("********* ALL EDGES *********'\n");
   REGEX_INTERNAL_iterate_all_edges (dfa, &print_edge, NULL);
   printf ("\n\n********* REACHABLE EDGES *********'\n");
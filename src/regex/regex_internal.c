@@ -58,6 +58,191 @@ struct REGEX_INTERNAL_StateSet_MDLL
 };
 
 
+/**
+ * Minimum size of an arena chunk.
+ */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Alignment of the memory handed out by an arena.
+ */
+#define ARENA_ALIGN (2 * sizeof (void *))
+
+
+/**
+ * Chunk of memory of an arena.
+ */
+struct ArenaChunk
+{
+  /**
+   * This is a linked list.
+   */
+  struct ArenaChunk *next;
+
+  /**
+   * Usable size of the chunk, in bytes.
+   */
+  size_t size;
+
+  /**
+   * Number of bytes handed out so far.
+   */
+  size_t off;
+
+  /* followed by the chunk's memory, at offset #ARENA_CHUNK_HEADER */
+};
+
+
+/**
+ * Size of the header of an arena chunk, rounded up to the alignment.
+ */
+#define ARENA_CHUNK_HEADER \
+  ((sizeof (struct ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+
+/**
+ * Memory pool for the states, transitions and labels of an automaton.
+ * Memory is only given back when the whole arena is destroyed; removed
+ * states and transitions are kept in free lists for reuse.
+ */
+struct REGEX_INTERNAL_Arena
+{
+  /**
+   * Chunk that memory is currently handed out from, head of the list
+   * of all chunks.
+   */
+  struct ArenaChunk *head;
+
+  /**
+   * Transitions that were removed and can be reused.
+   */
+  struct REGEX_INTERNAL_Transition *free_transitions;
+
+  /**
+   * States that were destroyed and can be reused.
+   */
+  struct REGEX_INTERNAL_State *free_states;
+
+  /**
+   * Total size of all chunks, in bytes.
+   */
+  size_t size;
+};
+
+
+/**
+ * Create an empty arena.
+ *
+ * @return new arena
+ */
+static struct REGEX_INTERNAL_Arena *
+arena_create ()
+{
+  return GNUNET_new (struct REGEX_INTERNAL_Arena);
+}
+
+
+/**
+ * Allocate zeroed memory from an arena.
+ *
+ * @param arena arena to allocate from
+ * @param size number of bytes to allocate
+ * @return pointer to the memory, valid until @a arena is destroyed
+ */
+static void *
+arena_alloc (struct REGEX_INTERNAL_Arena *arena,
+             size_t size)
+{
+  struct ArenaChunk *chunk;
+  size_t chunk_size;
+  void *ret;
+
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  chunk = arena->head;
+  if ( (NULL == chunk) ||
+       (chunk->size - chunk->off < size) )
+  {
+    chunk_size = GNUNET_MAX (ARENA_CHUNK_SIZE, size);
+    chunk = GNUNET_malloc_large (ARENA_CHUNK_HEADER + chunk_size);
+    GNUNET_assert (NULL != chunk);
+    chunk->size = chunk_size;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    arena->size += chunk_size;
+  }
+  ret = ((char *) chunk) + ARENA_CHUNK_HEADER + chunk->off;
+  chunk->off += size;
+  return ret;
+}
+
+
+/**
+ * Copy a string into an arena.
+ *
+ * @param arena arena to allocate from
+ * @param str string to copy
+ * @return the copy, valid until @a arena is destroyed
+ */
+static char *
+arena_strdup (struct REGEX_INTERNAL_Arena *arena,
+              const char *str)
+{
+  size_t len;
+  char *ret;
+
+  len = strlen (str) + 1;
+  ret = arena_alloc (arena, len);
+  GNUNET_memcpy (ret, str, len);
+  return ret;
+}
+
+
+/**
+ * Allocate a zeroed state from an arena, reusing a destroyed one
+ * if possible.
+ *
+ * @param arena arena to allocate from
+ * @return new state
+ */
+static struct REGEX_INTERNAL_State *
+arena_state_alloc (struct REGEX_INTERNAL_Arena *arena)
+{
+  struct REGEX_INTERNAL_State *s;
+
+  s = arena->free_states;
+  if (NULL == s)
+    s = arena_alloc (arena, sizeof (struct REGEX_INTERNAL_State));
+  else
+  {
+    arena->free_states = s->next;
+    memset (s, 0, sizeof (struct REGEX_INTERNAL_State));
+  }
+  s->arena = arena;
+  return s;
+}
+
+
+/**
+ * Free an arena and everything allocated from it.
+ *
+ * @param arena arena to destroy, can be NULL
+ */
+static void
+arena_destroy (struct REGEX_INTERNAL_Arena *arena)
+{
+  struct ArenaChunk *chunk;
+
+  if (NULL == arena)
+    return;
+  while (NULL != (chunk = arena->head))
+  {
+    arena->head = chunk->next;
+    GNUNET_free (chunk);
+  }
+  GNUNET_free (arena);
+}
+
+
 /**
  * Append state to the given StateSet.
  *
@@ -134,11 +319,19 @@ state_add_transition (struct REGEX_INTERNAL_Context *ctx,
       break;
   }
 
-  t = GNUNET_new (struct REGEX_INTERNAL_Transition);
+  t = from_state->arena->free_transitions;
+  if (NULL == t)
+    t = arena_alloc (from_state->arena,
+                     sizeof (struct REGEX_INTERNAL_Transition));
+  else
+  {
+    from_state->arena->free_transitions = t->next;
+    memset (t, 0, sizeof (struct REGEX_INTERNAL_Transition));
+  }
   if (NULL != ctx)
     t->id = ctx->transition_id++;
   if (NULL != label)
-    t->label = GNUNET_strdup (label);
+    t->label = arena_strdup (from_state->arena, label);
   else
     t->label = NULL;
   t->to_state = to_state;
@@ -167,13 +360,13 @@ state_remove_transition (struct REGEX_INTERNAL_State *state,
   if (transition->from_state != state)
     return;
 
-  GNUNET_free_non_null (transition->label);
-
   state->transition_count--;
   GNUNET_CONTAINER_DLL_remove (state->transitions_head, state->transitions_tail,
                                transition);
 
-  GNUNET_free (transition);
+  /* the label stays in the arena, the transition itself can be reused */
+  transition->next = state->arena->free_transitions;
+  state->arena->free_transitions = transition;
 }
 
 
@@ -296,7 +489,8 @@ automaton_fragment_clear (struct REGEX_INTERNAL_Automaton *a)
 
 
 /**
- * Frees the memory used by State @a s
+ * Frees the memory used by State @a s, except for the state itself
+ * and its transitions, which belong to the arena of the automaton.
  *
  * @param s state that should be destroyed
  */
@@ -317,8 +511,8 @@ automaton_destroy_state (struct REGEX_INTERNAL_State *s)
     next_t = t->next;
     state_remove_transition (s, t);
   }
-
-  GNUNET_free (s);
+  s->next = s->arena->free_states;
+  s->arena->free_states = s;
 }
 
 
@@ -361,77 +555,6 @@ automaton_remove_state (struct REGEX_INTERNAL_Automaton *a,
 }
 
 
-/**
- * Merge two states into one. Will merge 's1' and 's2' into 's1' and destroy
- * 's2'. 's1' will contain all (non-duplicate) outgoing transitions of 's2'.
- *
- * @param ctx context
- * @param a automaton
- * @param s1 first state
- * @param s2 second state, will be destroyed
- */
-static void
-automaton_merge_states (struct REGEX_INTERNAL_Context *ctx,
-                        struct REGEX_INTERNAL_Automaton *a,
-                        struct REGEX_INTERNAL_State *s1,
-                        struct REGEX_INTERNAL_State *s2)
-{
-  struct REGEX_INTERNAL_State *s_check;
-  struct REGEX_INTERNAL_Transition *t_check;
-  struct REGEX_INTERNAL_Transition *t;
-  struct REGEX_INTERNAL_Transition *t_next;
-  int is_dup;
-
-  if (s1 == s2)
-    return;
-
-  /* 1. Make all transitions pointing to s2 point to s1, unless this transition
-   * does not already exists, if it already exists remove transition. */
-  for (s_check = a->states_head; NULL != s_check; s_check = s_check->next)
-  {
-    for (t_check = s_check->transitions_head; NULL != t_check; t_check = t_next)
-    {
-      t_next = t_check->next;
-
-      if (s2 == t_check->to_state)
-      {
-        is_dup = GNUNET_NO;
-        for (t = t_check->from_state->transitions_head; NULL != t; t = t->next)
-        {
-          if (t->to_state == s1 && 0 == strcmp (t_check->label, t->label))
-            is_dup = GNUNET_YES;
-        }
-        if (GNUNET_NO == is_dup)
-          t_check->to_state = s1;
-        else
-          state_remove_transition (t_check->from_state, t_check);
-      }
-    }
-  }
-
-  /* 2. Add all transitions from s2 to sX to s1 */
-  for (t_check = s2->transitions_head; NULL != t_check; t_check = t_check->next)
-  {
-    if (t_check->to_state != s1)
-      state_add_transition (ctx, s1, t_check->label, t_check->to_state);
-  }
-
-  /* 3. Rename s1 to {s1,s2} */
-#if REGEX_DEBUG_DFA
-  char *new_name;
-
-  new_name = s1->name;
-  GNUNET_asprintf (&s1->name, "{%s,%s}", new_name, s2->name);
-  GNUNET_free (new_name);
-#endif
-
-  /* remove state */
-  GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s2);
-  a->state_count--;
-  automaton_destroy_state (s2);
-}
-
-
 /**
  * Add a state to the automaton 'a', always use this function to alter the
  * states DLL of the automaton.
@@ -572,17 +695,6 @@ struct StringBuffer
    */
   int16_t null_flag;
 
-  /**
-   * If this entry is part of the last/current generation array,
-   * this flag is #GNUNET_YES if the last and current generation are
-   * identical (and thus copying is unnecessary if the value didn't
-   * change).  This is used in an optimization that improves
-   * performance by about 1% --- if we use int16_t here.  With just
-   * "int" for both flags, performance drops (on my system) significantly,
-   * most likely due to increased cache misses.
-   */
-  int16_t synced;
-
 };
 
 
@@ -1055,6 +1167,7 @@ remove_epsilon (const struct StringBuffer *str,
   if (GNUNET_YES == str->null_flag)
   {
     ret->null_flag = GNUNET_YES;
+    ret->slen = 0;
     return;
   }
   if ( (str->slen > 1) &&
@@ -1063,6 +1176,7 @@ remove_epsilon (const struct StringBuffer *str,
        (')' == str->sbuf[str->slen - 1]) )
   {
     /* remove epsilon */
+    ret->null_flag = GNUNET_NO;
     if (ret->blen < str->slen - 3)
     {
       GNUNET_array_grow (ret->abuf,
@@ -1194,28 +1308,35 @@ number_states (void *cls, const unsigned int count,
  * $R^{(k)}_{ij} = R^{(k-1)}_{ij} | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^*
  * R^{(k-1)}_{kj}, and simplify the resulting expression saved in R_cur_ij.
  *
+ * The variants of ik, kk and kj without epsilon and surrounding
+ * parentheses only depend on the row and on the pivot, so they are
+ * computed once by the caller and not for every pair of states.
+ *
  * @param R_last_ij value of  $R^{(k-1)_{ij}.
- * @param R_last_ik value of  $R^{(k-1)_{ik}.
+ * @param R_last_ik value of  $R^{(k-1)_{ik}, must not be NULL.
  * @param R_last_kk value of  $R^{(k-1)_{kk}.
- * @param R_last_kj value of  $R^{(k-1)_{kj}.
- * @param R_cur_ij result for this inductive step is saved in R_cur_ij, R_cur_ij
- *                 is expected to be NULL when called!
+ * @param R_last_kj value of  $R^{(k-1)_{kj}, must not be NULL.
+ * @param R_temp_ik @a R_last_ik without epsilon and parentheses
+ * @param R_temp_kk @a R_last_kk without epsilon and parentheses
+ * @param R_temp_kj @a R_last_kj without epsilon and parentheses
+ * @param R_cur_ij result for this inductive step is saved in R_cur_ij
  * @param R_cur_l optimization -- kept between iterations to avoid realloc
  * @param R_cur_r optimization -- kept between iterations to avoid realloc
+ * @param R_temp_ij optimization -- kept between iterations to avoid realloc
  */
 static void
 automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
 				  const struct StringBuffer *R_last_ik,
                                   const struct StringBuffer *R_last_kk,
 				  const struct StringBuffer *R_last_kj,
+				  const struct StringBuffer *R_temp_ik,
+				  const struct StringBuffer *R_temp_kk,
+				  const struct StringBuffer *R_temp_kj,
                                   struct StringBuffer *R_cur_ij,
 				  struct StringBuffer *R_cur_l,
-				  struct StringBuffer *R_cur_r)
+				  struct StringBuffer *R_cur_r,
+				  struct StringBuffer *R_temp_ij)
 {
-  struct StringBuffer R_temp_ij;
-  struct StringBuffer R_temp_ik;
-  struct StringBuffer R_temp_kj;
-  struct StringBuffer R_temp_kk;
   int eps_check;
   int ij_ik_cmp;
   int ij_kj_cmp;
@@ -1233,33 +1354,12 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
    * R_cur_ij = R_cur_l | R_cur_r
    * R_cur_l == R^{(k-1)}_{ij}
    * R_cur_r == R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj}
+   *
+   * If ik or kj is NULL, $R^{(k)}_{ij} = R^{(k-1)}_{ij}; the caller
+   * does not call us for those.
    */
-
-  if ( (GNUNET_YES == R_last_ij->null_flag) &&
-       ( (GNUNET_YES == R_last_ik->null_flag) ||
-	 (GNUNET_YES == R_last_kj->null_flag)))
-  {
-    /* R^{(k)}_{ij} = N | N */
-    R_cur_ij->null_flag = GNUNET_YES;
-    R_cur_ij->synced = GNUNET_NO;
-    return;
-  }
-
-  if ( (GNUNET_YES == R_last_ik->null_flag) ||
-       (GNUNET_YES == R_last_kj->null_flag) )
-  {
-    /*  R^{(k)}_{ij} = R^{(k-1)}_{ij} | N */
-    if (GNUNET_YES == R_last_ij->synced)
-    {
-      R_cur_ij->synced = GNUNET_YES;
-      R_cur_ij->null_flag = GNUNET_NO;
-      return;
-    }
-    R_cur_ij->synced = GNUNET_YES;
-    sb_strdup (R_cur_ij, R_last_ij);
-    return;
-  }
-  R_cur_ij->synced = GNUNET_NO;
+  GNUNET_assert ( (GNUNET_YES != R_last_ik->null_flag) &&
+                  (GNUNET_YES != R_last_kj->null_flag) );
 
   /* $R^{(k)}_{ij} = N | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj} OR
    * $R^{(k)}_{ij} = R^{(k-1)}_{ij} | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj} */
@@ -1274,36 +1374,22 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
   ij_ik_cmp = sb_nullstrcmp (R_last_ij, R_last_ik);
   ik_kk_cmp = sb_nullstrcmp (R_last_ik, R_last_kk);
   kk_kj_cmp = sb_nullstrcmp (R_last_kk, R_last_kj);
-
-  /* Assign R_temp_(ik|kk|kj) to R_last[][] and remove epsilon as well
-   * as parentheses, so we can better compare the contents */
-
-  memset (&R_temp_ij, 0, sizeof (struct StringBuffer));
-  memset (&R_temp_ik, 0, sizeof (struct StringBuffer));
-  memset (&R_temp_kk, 0, sizeof (struct StringBuffer));
-  memset (&R_temp_kj, 0, sizeof (struct StringBuffer));
-  remove_epsilon (R_last_ik, &R_temp_ik);
-  remove_epsilon (R_last_kk, &R_temp_kk);
-  remove_epsilon (R_last_kj, &R_temp_kj);
-  remove_parentheses (&R_temp_ik);
-  remove_parentheses (&R_temp_kk);
-  remove_parentheses (&R_temp_kj);
-  clean_ik_kk_cmp = sb_nullstrcmp (R_last_ik, &R_temp_kk);
-  clean_kk_kj_cmp = sb_nullstrcmp (&R_temp_kk, R_last_kj);
+  clean_ik_kk_cmp = sb_nullstrcmp (R_last_ik, R_temp_kk);
+  clean_kk_kj_cmp = sb_nullstrcmp (R_temp_kk, R_last_kj);
 
   /* construct R_cur_l (and, if necessary R_cur_r) */
   if (GNUNET_YES != R_last_ij->null_flag)
   {
     /* Assign R_temp_ij to R_last_ij and remove epsilon as well
      * as parentheses, so we can better compare the contents */
-    remove_epsilon (R_last_ij, &R_temp_ij);
-    remove_parentheses (&R_temp_ij);
+    remove_epsilon (R_last_ij, R_temp_ij);
+    remove_parentheses (R_temp_ij);
 
-    if ( (0 == sb_strcmp (&R_temp_ij, &R_temp_ik)) &&
-	 (0 == sb_strcmp (&R_temp_ik, &R_temp_kk)) &&
-	 (0 == sb_strcmp (&R_temp_kk, &R_temp_kj)) )
+    if ( (0 == sb_strcmp (R_temp_ij, R_temp_ik)) &&
+	 (0 == sb_strcmp (R_temp_ik, R_temp_kk)) &&
+	 (0 == sb_strcmp (R_temp_kk, R_temp_kj)) )
     {
-      if (0 == R_temp_ij.slen)
+      if (0 == R_temp_ij->slen)
       {
         R_cur_r->null_flag = GNUNET_NO;
       }
@@ -1320,10 +1406,10 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
          * (e|a)|(e|a)a*(e|a) = a*
          * (e|a)|(e|a)(e|a)*(e|a) = a*
          */
-        if (GNUNET_YES == needs_parentheses (&R_temp_ij))
-          sb_printf1 (R_cur_r, "(%.*s)*", 3, &R_temp_ij);
+        if (GNUNET_YES == needs_parentheses (R_temp_ij))
+          sb_printf1 (R_cur_r, "(%.*s)*", 3, R_temp_ij);
         else
-          sb_printf1 (R_cur_r, "%.*s*", 1, &R_temp_ij);
+          sb_printf1 (R_cur_r, "%.*s*", 1, R_temp_ij);
       }
       else
       {
@@ -1334,10 +1420,10 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
          * a|(e|a)(e|a)*a = a+
          * a|a(e|a)*(e|a) = a+
          */
-        if (GNUNET_YES == needs_parentheses (&R_temp_ij))
-          sb_printf1 (R_cur_r, "(%.*s)+", 3, &R_temp_ij);
+        if (GNUNET_YES == needs_parentheses (R_temp_ij))
+          sb_printf1 (R_cur_r, "(%.*s)+", 3, R_temp_ij);
         else
-          sb_printf1 (R_cur_r, "%.*s+", 1, &R_temp_ij);
+          sb_printf1 (R_cur_r, "%.*s+", 1, R_temp_ij);
       }
     }
     else if ( (0 == ij_ik_cmp) && (0 == clean_kk_kj_cmp) && (0 != clean_ik_kk_cmp) )
@@ -1345,8 +1431,8 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
       /* a|ab*b = ab* */
       if (0 == R_last_kk->slen)
         sb_strdup (R_cur_r, R_last_ij);
-      else if (GNUNET_YES == needs_parentheses (&R_temp_kk))
-        sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ij, &R_temp_kk);
+      else if (GNUNET_YES == needs_parentheses (R_temp_kk))
+        sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ij, R_temp_kk);
       else
         sb_printf2 (R_cur_r, "%.*s%.*s*", 1, R_last_ij, R_last_kk);
       R_cur_l->null_flag = GNUNET_YES;
@@ -1358,10 +1444,10 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
       {
         sb_strdup (R_cur_r, R_last_kj);
       }
-      else if (GNUNET_YES == needs_parentheses (&R_temp_kk))
-        sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, &R_temp_kk, R_last_kj);
+      else if (GNUNET_YES == needs_parentheses (R_temp_kk))
+        sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, R_temp_kk, R_last_kj);
       else
-        sb_printf2 (R_cur_r, "%.*s*%.*s", 1, &R_temp_kk, R_last_kj);
+        sb_printf2 (R_cur_r, "%.*s*%.*s", 1, R_temp_kk, R_last_kj);
 
       R_cur_l->null_flag = GNUNET_YES;
     }
@@ -1369,20 +1455,20 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
 	      has_epsilon (R_last_kk))
     {
       /* a|a(e|b)*(e|b) = a|ab* = a|a|ab|abb|abbb|... = ab* */
-      if (needs_parentheses (&R_temp_kk))
-        sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ij, &R_temp_kk);
+      if (needs_parentheses (R_temp_kk))
+        sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ij, R_temp_kk);
       else
-        sb_printf2 (R_cur_r, "%.*s%.*s*", 1, R_last_ij, &R_temp_kk);
+        sb_printf2 (R_cur_r, "%.*s%.*s*", 1, R_last_ij, R_temp_kk);
       R_cur_l->null_flag = GNUNET_YES;
     }
     else if ( (0 == ij_kj_cmp) && (0 == ik_kk_cmp) && (! has_epsilon (R_last_ij)) &&
              has_epsilon (R_last_kk))
     {
       /* a|(e|b)(e|b)*a = a|b*a = a|a|ba|bba|bbba|...  = b*a */
-      if (needs_parentheses (&R_temp_kk))
-        sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, &R_temp_kk, R_last_ij);
+      if (needs_parentheses (R_temp_kk))
+        sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, R_temp_kk, R_last_ij);
       else
-        sb_printf2 (R_cur_r, "%.*s*%.*s", 1, &R_temp_kk, R_last_ij);
+        sb_printf2 (R_cur_r, "%.*s*%.*s", 1, R_temp_kk, R_last_ij);
       R_cur_l->null_flag = GNUNET_YES;
     }
     else
@@ -1400,7 +1486,7 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
   /* construct R_cur_r, if not already constructed */
   if (GNUNET_YES == R_cur_r->null_flag)
   {
-    length = R_temp_kk.slen - R_last_ik->slen;
+    length = R_temp_kk->slen - R_last_ik->slen;
 
     /* a(ba)*bx = (ab)+x */
     if ( (length > 0) &&
@@ -1410,8 +1496,8 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
 	 (0 < R_last_kj->slen) &&
 	 (GNUNET_YES != R_last_ik->null_flag) &&
 	 (0 < R_last_ik->slen) &&
-	 (0 == sb_strkcmp (&R_temp_kk, R_last_ik, length)) &&
-	 (0 == sb_strncmp (&R_temp_kk, R_last_kj, length)) )
+	 (0 == sb_strkcmp (R_temp_kk, R_last_ik, length)) &&
+	 (0 == sb_strncmp (R_temp_kk, R_last_kj, length)) )
     {
       struct StringBuffer temp_a;
       struct StringBuffer temp_b;
@@ -1445,8 +1531,8 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
       sb_free (&temp_a);
       sb_free (&temp_b);
     }
-    else if (0 == sb_strcmp (&R_temp_ik, &R_temp_kk) &&
-             0 == sb_strcmp (&R_temp_kk, &R_temp_kj))
+    else if (0 == sb_strcmp (R_temp_ik, R_temp_kk) &&
+             0 == sb_strcmp (R_temp_kk, R_temp_kj))
     {
       /*
        * (e|a)a*(e|a) = a*
@@ -1454,20 +1540,20 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
        */
       if (has_epsilon (R_last_ik) && has_epsilon (R_last_kj))
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf1 (R_cur_r, "(%.*s)*", 3, &R_temp_kk);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf1 (R_cur_r, "(%.*s)*", 3, R_temp_kk);
         else
-          sb_printf1 (R_cur_r, "%.*s*", 1, &R_temp_kk);
+          sb_printf1 (R_cur_r, "%.*s*", 1, R_temp_kk);
       }
       /* aa*a = a+a */
       else if ( (0 == clean_ik_kk_cmp) &&
 		(0 == clean_kk_kj_cmp) &&
 		(! has_epsilon (R_last_ik)) )
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, &R_temp_kk, &R_temp_kk);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, R_temp_kk, R_temp_kk);
         else
-          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, &R_temp_kk, &R_temp_kk);
+          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, R_temp_kk, R_temp_kk);
       }
       /*
        * (e|a)a*a = a+
@@ -1483,10 +1569,10 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
 
         if (1 == eps_check)
         {
-          if (needs_parentheses (&R_temp_kk))
-            sb_printf1 (R_cur_r, "(%.*s)+", 3, &R_temp_kk);
+          if (needs_parentheses (R_temp_kk))
+            sb_printf1 (R_cur_r, "(%.*s)+", 3, R_temp_kk);
           else
-            sb_printf1 (R_cur_r, "%.*s+", 1, &R_temp_kk);
+            sb_printf1 (R_cur_r, "%.*s+", 1, R_temp_kk);
         }
       }
     }
@@ -1494,56 +1580,56 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
      * aa*b = a+b
      * (e|a)(e|a)*b = a*b
      */
-    else if (0 == sb_strcmp (&R_temp_ik, &R_temp_kk))
+    else if (0 == sb_strcmp (R_temp_ik, R_temp_kk))
     {
       if (has_epsilon (R_last_ik))
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, &R_temp_kk, R_last_kj);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf2 (R_cur_r, "(%.*s)*%.*s", 3, R_temp_kk, R_last_kj);
         else
-          sb_printf2 (R_cur_r, "%.*s*%.*s", 1, &R_temp_kk, R_last_kj);
+          sb_printf2 (R_cur_r, "%.*s*%.*s", 1, R_temp_kk, R_last_kj);
       }
       else
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, &R_temp_kk, R_last_kj);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, R_temp_kk, R_last_kj);
         else
-          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, &R_temp_kk, R_last_kj);
+          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, R_temp_kk, R_last_kj);
       }
     }
     /*
      * ba*a = ba+
      * b(e|a)*(e|a) = ba*
      */
-    else if (0 == sb_strcmp (&R_temp_kk, &R_temp_kj))
+    else if (0 == sb_strcmp (R_temp_kk, R_temp_kj))
     {
       if (has_epsilon (R_last_kj))
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ik, &R_temp_kk);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf2 (R_cur_r, "%.*s(%.*s)*", 3, R_last_ik, R_temp_kk);
         else
-          sb_printf2 (R_cur_r, "%.*s%.*s*", 1, R_last_ik, &R_temp_kk);
+          sb_printf2 (R_cur_r, "%.*s%.*s*", 1, R_last_ik, R_temp_kk);
       }
       else
       {
-        if (needs_parentheses (&R_temp_kk))
-          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, R_last_ik, &R_temp_kk);
+        if (needs_parentheses (R_temp_kk))
+          sb_printf2 (R_cur_r, "(%.*s)+%.*s", 3, R_last_ik, R_temp_kk);
         else
-          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, R_last_ik, &R_temp_kk);
+          sb_printf2 (R_cur_r, "%.*s+%.*s", 1, R_last_ik, R_temp_kk);
       }
     }
     else
     {
-      if (0 < R_temp_kk.slen)
+      if (0 < R_temp_kk->slen)
       {
-        if (needs_parentheses (&R_temp_kk))
+        if (needs_parentheses (R_temp_kk))
         {
-          sb_printf3 (R_cur_r, "%.*s(%.*s)*%.*s", 3, R_last_ik, &R_temp_kk,
+          sb_printf3 (R_cur_r, "%.*s(%.*s)*%.*s", 3, R_last_ik, R_temp_kk,
 		      R_last_kj);
         }
         else
         {
-          sb_printf3 (R_cur_r, "%.*s%.*s*%.*s", 1, R_last_ik, &R_temp_kk,
+          sb_printf3 (R_cur_r, "%.*s%.*s*%.*s", 1, R_last_ik, R_temp_kk,
 		      R_last_kj);
         }
       }
@@ -1553,11 +1639,6 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
       }
     }
   }
-  sb_free (&R_temp_ij);
-  sb_free (&R_temp_ik);
-  sb_free (&R_temp_kk);
-  sb_free (&R_temp_kj);
-
   if ( (GNUNET_YES == R_cur_l->null_flag) &&
        (GNUNET_YES == R_cur_r->null_flag) )
   {
@@ -1609,6 +1690,14 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
  * proof) fields. The starting state will only have a valid proof/hash if it has
  * any incoming transitions.
  *
+ * In the end only the row of the start state is needed.  Any other row
+ * i is only needed up to step i, where it is the pivot row, and is
+ * dropped afterwards.  The matrix is updated in place: $R^{(k)}_{ij}$
+ * only differs from $R^{(k-1)}_{ij}$ if both ik and kj are non-NULL, so
+ * each step only visits the non-NULL entries of column k and row k.
+ * Column k is updated last in each row, and the start row last in each
+ * step, so the pivot entries used are still those of step k-1.
+ *
  * @param a automaton for which to assign proofs and hashes, must not be NULL
  */
 static int
@@ -1616,25 +1705,40 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
 {
   unsigned int n = a->state_count;
   struct REGEX_INTERNAL_State *states[n];
-  struct StringBuffer *R_last;
-  struct StringBuffer *R_cur;
+  struct StringBuffer *R;
+  struct StringBuffer *R_temp_k;
+  struct StringBuffer *R_start;
+  struct StringBuffer *R_ik;
+  struct StringBuffer R_cur_ij;
   struct StringBuffer R_cur_r;
   struct StringBuffer R_cur_l;
-  struct StringBuffer *R_swap;
+  struct StringBuffer R_temp_ij;
+  struct StringBuffer R_temp_ik;
+  struct StringBuffer R_swap;
   struct REGEX_INTERNAL_Transition *t;
   struct StringBuffer complete_regex;
+  struct GNUNET_TIME_Absolute start_time;
+  unsigned int *cols;
+  unsigned int num_cols;
+  unsigned int start;
+  unsigned int row;
+  unsigned int c;
   unsigned int i;
   unsigned int j;
   unsigned int k;
 
-  R_last = GNUNET_malloc_large (sizeof (struct StringBuffer) * n * n);
-  R_cur = GNUNET_malloc_large (sizeof (struct StringBuffer) * n * n);
-  if ( (NULL == R_last) ||
-       (NULL == R_cur) )
+  start_time = GNUNET_TIME_absolute_get ();
+  R = GNUNET_malloc_large (sizeof (struct StringBuffer) * n * n);
+  R_temp_k = GNUNET_malloc_large (sizeof (struct StringBuffer) * n);
+  cols = GNUNET_malloc_large (sizeof (unsigned int) * n);
+  if ( (NULL == R) ||
+       (NULL == R_temp_k) ||
+       (NULL == cols) )
   {
     GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
-    GNUNET_free_non_null (R_cur);
-    GNUNET_free_non_null (R_last);
+    GNUNET_free_non_null (cols);
+    GNUNET_free_non_null (R_temp_k);
+    GNUNET_free_non_null (R);
     return GNUNET_SYSERR;
   }
 
@@ -1646,7 +1750,7 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
     GNUNET_assert (NULL != states[i]);
   for (i = 0; i < n; i++)
     for (j = 0; j < n; j++)
-      R_last[i *n + j].null_flag = GNUNET_YES;
+      R[i * n + j].null_flag = GNUNET_YES;
 
   /* Compute regular expressions of length "1" between each pair of states */
   for (i = 0; i < n; i++)
@@ -1654,71 +1758,114 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
     for (t = states[i]->transitions_head; NULL != t; t = t->next)
     {
       j = t->to_state->dfs_id;
-      if (GNUNET_YES == R_last[i * n + j].null_flag)
+      if (GNUNET_YES == R[i * n + j].null_flag)
       {
-        sb_strdup_cstr (&R_last[i * n + j], t->label);
+        sb_strdup_cstr (&R[i * n + j], t->label);
       }
       else
       {
-	sb_append_cstr (&R_last[i * n + j], "|");
-	sb_append_cstr (&R_last[i * n + j], t->label);
+	sb_append_cstr (&R[i * n + j], "|");
+	sb_append_cstr (&R[i * n + j], t->label);
       }
     }
     /* add self-loop: i is reachable from i via epsilon-transition */
-    if (GNUNET_YES == R_last[i * n + i].null_flag)
+    if (GNUNET_YES == R[i * n + i].null_flag)
     {
-      R_last[i * n + i].slen = 0;
-      R_last[i * n + i].null_flag = GNUNET_NO;
+      R[i * n + i].slen = 0;
+      R[i * n + i].null_flag = GNUNET_NO;
     }
     else
     {
-      sb_wrap (&R_last[i * n + i], "(|%.*s)", 3);
+      sb_wrap (&R[i * n + i], "(|%.*s)", 3);
     }
   }
   for (i = 0; i < n; i++)
     for (j = 0; j < n; j++)
-      if (needs_parentheses (&R_last[i * n + j]))
-        sb_wrap (&R_last[i * n + j], "(%.*s)", 2);
+      if (needs_parentheses (&R[i * n + j]))
+        sb_wrap (&R[i * n + j], "(%.*s)", 2);
   /* Compute regular expressions of length "k" between each pair of states per
    * induction */
+  memset (&R_cur_ij, 0, sizeof (struct StringBuffer));
   memset (&R_cur_l, 0, sizeof (struct StringBuffer));
   memset (&R_cur_r, 0, sizeof (struct StringBuffer));
+  memset (&R_temp_ij, 0, sizeof (struct StringBuffer));
+  memset (&R_temp_ik, 0, sizeof (struct StringBuffer));
+  start = a->start->dfs_id;
   for (k = 0; k < n; k++)
   {
-    for (i = 0; i < n; i++)
+    /* non-NULL entries of the pivot row, with kk last, and their
+     * variants without epsilon and parentheses */
+    num_cols = 0;
+    for (j = 0; j < n; j++)
     {
-      for (j = 0; j < n; j++)
+      if ( (j == k) ||
+           (GNUNET_YES == R[k * n + j].null_flag) )
+        continue;
+      cols[num_cols++] = j;
+      remove_epsilon (&R[k * n + j], &R_temp_k[j]);
+      remove_parentheses (&R_temp_k[j]);
+    }
+    remove_epsilon (&R[k * n + k], &R_temp_k[k]);
+    remove_parentheses (&R_temp_k[k]);
+    if (GNUNET_YES != R[k * n + k].null_flag)
+      cols[num_cols++] = k;
+
+    /* rows that are still needed: all after k, and the start row */
+    for (i = k + 1; i <= n; i++)
+    {
+      row = i;
+      if (n == i)
+      {
+        if (start > k)
+          break;
+        row = start;
+      }
+      R_ik = &R[row * n + k];
+      if (GNUNET_YES == R_ik->null_flag)
+        continue;
+      remove_epsilon (R_ik, &R_temp_ik);
+      remove_parentheses (&R_temp_ik);
+      for (c = 0; c < num_cols; c++)
       {
         /* Basis for the recursion:
          * $R^{(k)}_{ij} = R^{(k-1)}_{ij} | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj}
-         * R_last == R^{(k-1)}, R_cur == R^{(k)}
          */
-
-        /* Create R_cur[i][j] and simplify the expression */
-        automaton_create_proofs_simplify (&R_last[i * n + j], &R_last[i * n + k],
-                                          &R_last[k * n + k], &R_last[k * n + j],
-                                          &R_cur[i * n + j],
-					  &R_cur_l, &R_cur_r);
+        j = cols[c];
+        automaton_create_proofs_simplify (&R[row * n + j], R_ik,
+                                          &R[k * n + k], &R[k * n + j],
+                                          &R_temp_ik, &R_temp_k[k],
+                                          &R_temp_k[j],
+                                          &R_cur_ij,
+					  &R_cur_l, &R_cur_r,
+                                          &R_temp_ij);
+        R_swap = R[row * n + j];
+        R[row * n + j] = R_cur_ij;
+        R_cur_ij = R_swap;
       }
     }
-    /* set R_last = R_cur */
-    R_swap = R_last;
-    R_last = R_cur;
-    R_cur = R_swap;
-    /* clear 'R_cur' for next iteration */
-    for (i = 0; i < n; i++)
+    /* row k is not needed anymore */
+    if (k != start)
       for (j = 0; j < n; j++)
-        R_cur[i * n + j].null_flag = GNUNET_YES;
+        sb_free (&R[k * n + j]);
   }
+  sb_free (&R_cur_ij);
   sb_free (&R_cur_l);
   sb_free (&R_cur_r);
+  sb_free (&R_temp_ij);
+  sb_free (&R_temp_ik);
+  for (j = 0; j < n; j++)
+    sb_free (&R_temp_k[j]);
+  GNUNET_free (R_temp_k);
+  GNUNET_free (cols);
+
   /* assign proofs and hashes */
+  R_start = &R[start * n];
   for (i = 0; i < n; i++)
   {
-    if (GNUNET_YES != R_last[a->start->dfs_id * n + i].null_flag)
+    if (GNUNET_YES != R_start[i].null_flag)
     {
-      states[i]->proof = GNUNET_strndup (R_last[a->start->dfs_id * n + i].sbuf,
-					 R_last[a->start->dfs_id * n + i].slen);
+      states[i]->proof = GNUNET_strndup (R_start[i].sbuf,
+					 R_start[i].slen);
       GNUNET_CRYPTO_hash (states[i]->proof, strlen (states[i]->proof),
                           &states[i]->hash);
     }
@@ -1732,17 +1879,17 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
     if (states[i]->accepting)
     {
       if ( (0 == complete_regex.slen) &&
-	   (0 < R_last[a->start->dfs_id * n + i].slen) )
+	   (0 < R_start[i].slen) )
       {
 	sb_append (&complete_regex,
-		   &R_last[a->start->dfs_id * n + i]);
+		   &R_start[i]);
       }
-      else if ( (GNUNET_YES != R_last[a->start->dfs_id * n + i].null_flag) &&
-		(0 < R_last[a->start->dfs_id * n + i].slen) )
+      else if ( (GNUNET_YES != R_start[i].null_flag) &&
+		(0 < R_start[i].slen) )
       {
 	sb_append_cstr (&complete_regex, "|");
 	sb_append (&complete_regex,
-		   &R_last[a->start->dfs_id * n + i]);
+		   &R_start[i]);
       }
     }
   }
@@ -1750,14 +1897,15 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
 
   /* cleanup */
   sb_free (&complete_regex);
-  for (i = 0; i < n; i++)
-    for (j = 0; j < n; j++)
-    {
-      sb_free (&R_cur[i * n + j]);
-      sb_free (&R_last[i * n + j]);
-    }
-  GNUNET_free (R_cur);
-  GNUNET_free (R_last);
+  for (j = 0; j < n; j++)
+    sb_free (&R_start[j]);
+  GNUNET_free (R);
+  a->proof_time = GNUNET_TIME_absolute_get_duration (start_time);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Created proofs for %u states in %s\n",
+              n,
+              GNUNET_STRINGS_relative_time_to_string (a->proof_time,
+                                                      GNUNET_YES));
   return GNUNET_OK;
 }
 
@@ -1782,7 +1930,7 @@ dfa_state_create (struct REGEX_INTERNAL_Context *ctx,
   struct REGEX_INTERNAL_Transition *ctran;
   unsigned int i;
 
-  s = GNUNET_new (struct REGEX_INTERNAL_State);
+  s = arena_state_alloc (ctx->arena);
   s->id = ctx->state_id++;
   s->index = -1;
   s->lowlink = -1;
@@ -1965,9 +2113,224 @@ dfa_remove_dead_states (struct REGEX_INTERNAL_Automaton *a)
 }
 
 
+/**
+ * Incoming transition of a state, used for minimization.
+ */
+struct InEdge
+{
+  /**
+   * Label of the transition.
+   */
+  const char *label;
+
+  /**
+   * Index of the state the transition starts at.
+   */
+  unsigned int src;
+};
+
+
+/**
+ * Signature of a state, used for the initial partition when minimizing.
+ */
+struct StateSignature
+{
+  /**
+   * Hash over whether the state accepts and over its labels.
+   */
+  struct GNUNET_HashCode hash;
+
+  /**
+   * Index of the state.
+   */
+  unsigned int state;
+};
+
+
+/**
+ * Compare two state signatures. Used for sorting.
+ *
+ * @param a first `struct StateSignature`
+ * @param b second `struct StateSignature`
+ * @return result of GNUNET_CRYPTO_hash_cmp() on the hashes
+ */
+static int
+state_signature_compare (const void *a, const void *b)
+{
+  const struct StateSignature *s1 = a;
+  const struct StateSignature *s2 = b;
+
+  return GNUNET_CRYPTO_hash_cmp (&s1->hash, &s2->hash);
+}
+
+
+/**
+ * Compare two incoming transitions by label. Used for sorting.
+ *
+ * @param a first `struct InEdge`
+ * @param b second `struct InEdge`
+ * @return result of strcmp() on the labels
+ */
+static int
+in_edge_compare (const void *a, const void *b)
+{
+  const struct InEdge *e1 = a;
+  const struct InEdge *e2 = b;
+
+  return strcmp (e1->label, e2->label);
+}
+
+
+/**
+ * Partition of the states of a DFA into blocks of possibly equivalent
+ * states, refined by #dfa_merge_nondistinguishable_states().
+ *
+ * The states of each block are stored contiguously in @e elems, from
+ * @e first to @e end of the block.  While splitting, marked states are
+ * moved to the front of their block, up to @e mid.
+ */
+struct Partition
+{
+  /**
+   * State indices, grouped by block.
+   */
+  unsigned int *elems;
+
+  /**
+   * Position of each state in @e elems.
+   */
+  unsigned int *loc;
+
+  /**
+   * Block of each state.
+   */
+  unsigned int *block_of;
+
+  /**
+   * Start of each block in @e elems.
+   */
+  unsigned int *first;
+
+  /**
+   * End of each block in @e elems (exclusive).
+   */
+  unsigned int *end;
+
+  /**
+   * End of the marked states of each block.
+   */
+  unsigned int *mid;
+
+  /**
+   * Blocks with marked states.
+   */
+  unsigned int *touched;
+
+  /**
+   * Number of entries in @e touched.
+   */
+  unsigned int touched_len;
+
+  /**
+   * Blocks still to be used as splitters.
+   */
+  unsigned int *queue;
+
+  /**
+   * Number of entries in @e queue.
+   */
+  unsigned int queue_len;
+
+  /**
+   * Number of blocks.
+   */
+  unsigned int num_blocks;
+};
+
+
+/**
+ * Mark a state, moving it to the marked part of its block.
+ *
+ * @param p partition
+ * @param state index of the state to mark
+ */
+static void
+partition_mark (struct Partition *p,
+                unsigned int state)
+{
+  unsigned int b;
+  unsigned int pos;
+  unsigned int other;
+
+  b = p->block_of[state];
+  pos = p->loc[state];
+  if (pos < p->mid[b])
+    return; /* already marked */
+  if (p->mid[b] == p->first[b])
+    p->touched[p->touched_len++] = b;
+  other = p->elems[p->mid[b]];
+  p->elems[pos] = other;
+  p->loc[other] = pos;
+  p->elems[p->mid[b]] = state;
+  p->loc[state] = p->mid[b];
+  p->mid[b]++;
+}
+
+
+/**
+ * Split all blocks with marked states into their marked and unmarked
+ * states.  The smaller part becomes a new block and is queued as a
+ * splitter; if the old block is still queued both parts are, else
+ * skipping the larger part is what makes this O(n log n).
+ *
+ * @param p partition
+ */
+static void
+partition_split (struct Partition *p)
+{
+  unsigned int b;
+  unsigned int nb;
+  unsigned int i;
+
+  while (p->touched_len > 0)
+  {
+    b = p->touched[--p->touched_len];
+    if (p->mid[b] == p->end[b])
+    {
+      /* all states marked, nothing to split */
+      p->mid[b] = p->first[b];
+      continue;
+    }
+    nb = p->num_blocks++;
+    if (p->mid[b] - p->first[b] <= p->end[b] - p->mid[b])
+    {
+      p->first[nb] = p->first[b];
+      p->end[nb] = p->mid[b];
+      p->first[b] = p->mid[b];
+    }
+    else
+    {
+      p->first[nb] = p->mid[b];
+      p->end[nb] = p->end[b];
+      p->end[b] = p->mid[b];
+    }
+    p->mid[b] = p->first[b];
+    p->mid[nb] = p->first[nb];
+    for (i = p->first[nb]; i < p->end[nb]; i++)
+      p->block_of[p->elems[i]] = nb;
+    p->queue[p->queue_len++] = nb;
+  }
+}
+
+
 /**
  * Merge all non distinguishable states in the DFA 'a'
  *
+ * Uses Hopcroft's partition refinement, which takes O(n log n) steps for
+ * n states instead of comparing all pairs of states.  The DFA is partial,
+ * so the initial partition separates states by whether they accept and
+ * by the labels of their transitions.
+ *
  * @param ctx context
  * @param a DFA automaton
  * @return #GNUNET_OK on success
@@ -1976,19 +2339,24 @@ static int
 dfa_merge_nondistinguishable_states (struct REGEX_INTERNAL_Context *ctx,
                                      struct REGEX_INTERNAL_Automaton *a)
 {
-  uint32_t *table;
-  struct REGEX_INTERNAL_State *s1;
-  struct REGEX_INTERNAL_State *s2;
-  struct REGEX_INTERNAL_Transition *t1;
-  struct REGEX_INTERNAL_Transition *t2;
-  struct REGEX_INTERNAL_State *s1_next;
-  struct REGEX_INTERNAL_State *s2_next;
-  int change;
-  unsigned int num_equal_edges;
-  unsigned int i;
+  struct REGEX_INTERNAL_State **states;
+  struct REGEX_INTERNAL_State **rep;
+  struct REGEX_INTERNAL_State *s;
+  struct REGEX_INTERNAL_State *s_next;
+  struct REGEX_INTERNAL_Transition *t;
+  struct StateSignature *sig;
+  struct GNUNET_HashContext *hc;
+  struct InEdge *in_edges;
+  struct InEdge *splitter_edges;
+  unsigned int *in_start;
+  struct Partition p;
   unsigned int state_cnt;
-  unsigned long long idx;
-  unsigned long long idx1;
+  unsigned int edge_cnt;
+  unsigned int splitter_len;
+  unsigned int b;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
 
   if ( (NULL == a) || (0 == a->state_count) )
   {
@@ -1998,85 +2366,165 @@ dfa_merge_nondistinguishable_states (struct REGEX_INTERNAL_Context *ctx,
   }
 
   state_cnt = a->state_count;
-  table = GNUNET_malloc_large ((sizeof (uint32_t) * state_cnt * state_cnt / 32)  + sizeof (uint32_t));
-  if (NULL == table)
+  states = GNUNET_new_array (state_cnt,
+                             struct REGEX_INTERNAL_State *);
+  edge_cnt = 0;
+  for (i = 0, s = a->states_head; NULL != s; s = s->next)
   {
-    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
-    return GNUNET_SYSERR;
+    s->marked = i;
+    states[i++] = s;
+    edge_cnt += s->transition_count;
   }
 
-  for (i = 0, s1 = a->states_head; NULL != s1; s1 = s1->next)
-    s1->marked = i++;
-
-  /* Mark all pairs of accepting/!accepting states */
-  for (s1 = a->states_head; NULL != s1; s1 = s1->next)
-    for (s2 = a->states_head; NULL != s2; s2 = s2->next)
-      if ( (s1->accepting && !s2->accepting) ||
-	   (!s1->accepting && s2->accepting) )
-      {
-	idx = (unsigned long long) s1->marked * state_cnt + s2->marked;
-        table[idx / 32] |= (1U << (idx % 32));
-      }
+  /* Incoming transitions of each state, those of states[i] are
+     in_edges[in_start[i]] to in_edges[in_start[i + 1] - 1]. */
+  in_start = GNUNET_new_array (state_cnt + 1,
+                               unsigned int);
+  in_edges = GNUNET_new_array (edge_cnt + 1,
+                               struct InEdge);
+  splitter_edges = GNUNET_new_array (edge_cnt + 1,
+                                     struct InEdge);
+  for (i = 0; i < state_cnt; i++)
+    for (t = states[i]->transitions_head; NULL != t; t = t->next)
+      in_start[t->to_state->marked + 1]++;
+  for (i = 0; i < state_cnt; i++)
+    in_start[i + 1] += in_start[i];
+  for (i = 0; i < state_cnt; i++)
+    for (t = states[i]->transitions_head; NULL != t; t = t->next)
+    {
+      /* use in_start[j] as insertion cursor, shifted back below */
+      j = t->to_state->marked;
+      in_edges[in_start[j]].label = t->label;
+      in_edges[in_start[j]].src = i;
+      in_start[j]++;
+    }
+  for (i = state_cnt; i > 0; i--)
+    in_start[i] = in_start[i - 1];
+  in_start[0] = 0;
+
+  memset (&p, 0, sizeof (p));
+  p.elems = GNUNET_new_array (state_cnt, unsigned int);
+  p.loc = GNUNET_new_array (state_cnt, unsigned int);
+  p.block_of = GNUNET_new_array (state_cnt, unsigned int);
+  p.first = GNUNET_new_array (state_cnt, unsigned int);
+  p.end = GNUNET_new_array (state_cnt, unsigned int);
+  p.mid = GNUNET_new_array (state_cnt, unsigned int);
+  p.touched = GNUNET_new_array (state_cnt, unsigned int);
+  p.queue = GNUNET_new_array (state_cnt, unsigned int);
+
+  /* Initial partition: states that accept alike and have the same
+     labels (transitions are sorted by label) get the same signature. */
+  sig = GNUNET_new_array (state_cnt,
+                          struct StateSignature);
+  for (i = 0; i < state_cnt; i++)
+  {
+    hc = GNUNET_CRYPTO_hash_context_start ();
+    GNUNET_CRYPTO_hash_context_read (hc,
+                                     &states[i]->accepting,
+                                     sizeof (int));
+    for (t = states[i]->transitions_head; NULL != t; t = t->next)
+      GNUNET_CRYPTO_hash_context_read (hc,
+                                       t->label,
+                                       strlen (t->label) + 1);
+    GNUNET_CRYPTO_hash_context_finish (hc,
+                                       &sig[i].hash);
+    sig[i].state = i;
+  }
+  qsort (sig,
+         state_cnt,
+         sizeof (struct StateSignature),
+         &state_signature_compare);
+  for (i = 0; i < state_cnt; i++)
+  {
+    if ( (0 == i) ||
+         (0 != GNUNET_CRYPTO_hash_cmp (&sig[i - 1].hash,
+                                       &sig[i].hash)) )
+    {
+      b = p.num_blocks++;
+      p.first[b] = i;
+      p.mid[b] = i;
+      p.queue[p.queue_len++] = b;
+    }
+    p.end[b] = i + 1;
+    p.elems[i] = sig[i].state;
+    p.loc[sig[i].state] = i;
+    p.block_of[sig[i].state] = b;
+  }
+  GNUNET_free (sig);
 
-  /* Find all equal states */
-  change = 1;
-  while (0 != change)
+  /* Refine: split the blocks by the predecessors of each splitter block,
+     one label at a time. */
+  while (p.queue_len > 0)
   {
-    change = 0;
-    for (s1 = a->states_head; NULL != s1; s1 = s1->next)
+    b = p.queue[--p.queue_len];
+    splitter_len = 0;
+    for (i = p.first[b]; i < p.end[b]; i++)
     {
-      for (s2 = a->states_head; NULL != s2 && s1 != s2; s2 = s2->next)
-      {
-	idx = (unsigned long long) s1->marked * state_cnt + s2->marked;
-        if (0 != (table[idx / 32] & (1U << (idx % 32))))
-          continue;
-        num_equal_edges = 0;
-        for (t1 = s1->transitions_head; NULL != t1; t1 = t1->next)
-        {
-          for (t2 = s2->transitions_head; NULL != t2; t2 = t2->next)
-          {
-            if (0 == strcmp (t1->label, t2->label))
-	    {
-	      num_equal_edges++;
-	      /* same edge, but targets definitively different, so we're different
-		 as well */
-	      if (t1->to_state->marked > t2->to_state->marked)
-		idx1 = (unsigned long long) t1->to_state->marked * state_cnt + t2->to_state->marked;
-	      else
-		idx1 = (unsigned long long) t2->to_state->marked * state_cnt + t1->to_state->marked;
-	      if (0 != (table[idx1 / 32] & (1U << (idx1 % 32))))
-	      {
-		table[idx / 32] |= (1U << (idx % 32));
-		change = 1; /* changed a marker, need to run again */
-	      }
-	    }
-	  }
-        }
-        if ( (num_equal_edges != s1->transition_count) ||
-	     (num_equal_edges != s2->transition_count) )
-        {
-          /* Make sure ALL edges of possible equal states are the same */
-	  table[idx / 32] |= (1U << (idx % 32));
-	  change = 1;  /* changed a marker, need to run again */
-        }
-      }
+      j = p.elems[i];
+      for (k = in_start[j]; k < in_start[j + 1]; k++)
+        splitter_edges[splitter_len++] = in_edges[k];
+    }
+    qsort (splitter_edges,
+           splitter_len,
+           sizeof (struct InEdge),
+           &in_edge_compare);
+    for (i = 0; i < splitter_len; i = j)
+    {
+      for (j = i;
+           (j < splitter_len) &&
+           (0 == strcmp (splitter_edges[i].label,
+                         splitter_edges[j].label));
+           j++)
+        partition_mark (&p, splitter_edges[j].src);
+      partition_split (&p);
     }
   }
 
-  /* Merge states that are equal */
-  for (s1 = a->states_head; NULL != s1; s1 = s1_next)
+  /* Merge each block into one representative, keeping the start state */
+  rep = GNUNET_new_array (p.num_blocks,
+                          struct REGEX_INTERNAL_State *);
+  if (NULL != a->start)
+    rep[p.block_of[a->start->marked]] = a->start;
+  for (i = 0; i < state_cnt; i++)
+    if (NULL == rep[p.block_of[i]])
+      rep[p.block_of[i]] = states[i];
+  for (i = 0; i < state_cnt; i++)
+    for (t = states[i]->transitions_head; NULL != t; t = t->next)
+      t->to_state = rep[p.block_of[t->to_state->marked]];
+  for (s = a->states_head; NULL != s; s = s_next)
   {
-    s1_next = s1->next;
-    for (s2 = a->states_head; NULL != s2 && s1 != s2; s2 = s2_next)
+    s_next = s->next;
+    if (rep[p.block_of[s->marked]] == s)
+      continue;
+#if REGEX_DEBUG_DFA
     {
-      s2_next = s2->next;
-      idx = (unsigned long long) s1->marked * state_cnt + s2->marked;
-      if (0 == (table[idx / 32] & (1U << (idx % 32))))
-        automaton_merge_states (ctx, a, s1, s2);
+      struct REGEX_INTERNAL_State *s1 = rep[p.block_of[s->marked]];
+      char *new_name;
+
+      new_name = s1->name;
+      GNUNET_asprintf (&s1->name, "{%s,%s}", new_name, s->name);
+      GNUNET_free (new_name);
     }
+#endif
+    /* all transitions of 's' also exist at its representative */
+    GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s);
+    a->state_count--;
+    automaton_destroy_state (s);
   }
 
-  GNUNET_free (table);
+  GNUNET_free (rep);
+  GNUNET_free (p.elems);
+  GNUNET_free (p.loc);
+  GNUNET_free (p.block_of);
+  GNUNET_free (p.first);
+  GNUNET_free (p.end);
+  GNUNET_free (p.mid);
+  GNUNET_free (p.touched);
+  GNUNET_free (p.queue);
+  GNUNET_free (splitter_edges);
+  GNUNET_free (in_edges);
+  GNUNET_free (in_start);
+  GNUNET_free (states);
   return GNUNET_OK;
 }
 
@@ -2448,7 +2896,8 @@ nfa_add_states (struct REGEX_INTERNAL_Automaton *n,
 
 
 /**
- * Creates a new NFA state. Needs to be freed using automaton_destroy_state.
+ * Creates a new NFA state in the arena of @a ctx. Needs to be cleaned up
+ * using automaton_destroy_state.
  *
  * @param ctx context
  * @param accepting is it an accepting state or not
@@ -2460,7 +2909,7 @@ nfa_state_create (struct REGEX_INTERNAL_Context *ctx, int accepting)
 {
   struct REGEX_INTERNAL_State *s;
 
-  s = GNUNET_new (struct REGEX_INTERNAL_State);
+  s = arena_state_alloc (ctx->arena);
   s->id = ctx->state_id++;
   s->accepting = accepting;
   s->marked = GNUNET_NO;
@@ -2775,6 +3224,7 @@ REGEX_INTERNAL_context_init (struct REGEX_INTERNAL_Context *ctx)
   ctx->transition_id = 0;
   ctx->stack_head = NULL;
   ctx->stack_tail = NULL;
+  ctx->arena = arena_create ();
 }
 
 
@@ -2933,6 +3383,7 @@ REGEX_INTERNAL_construct_nfa (const char *regex, const size_t len)
 
   /* Remember the regex that was used to generate this NFA */
   nfa->regex = GNUNET_strdup (regex);
+  nfa->arena = ctx.arena;
 
   /* create depth-first numbering of the states for pretty printing */
   REGEX_INTERNAL_automaton_traverse (nfa, NULL, NULL, NULL, &number_states, NULL);
@@ -2954,6 +3405,7 @@ error:
     GNUNET_CONTAINER_DLL_remove (ctx.stack_head, ctx.stack_tail, nfa);
     REGEX_INTERNAL_automaton_destroy (nfa);
   }
+  arena_destroy (ctx.arena);
 
   return NULL;
 }
@@ -3052,12 +3504,14 @@ REGEX_INTERNAL_construct_dfa (const char *regex, const size_t len,
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                 "Could not create DFA, because NFA creation failed\n");
+    arena_destroy (ctx.arena);
     return NULL;
   }
 
   dfa = GNUNET_new (struct REGEX_INTERNAL_Automaton);
   dfa->type = DFA;
   dfa->regex = GNUNET_strdup (regex);
+  dfa->arena = ctx.arena;
 
   /* Create DFA start state from epsilon closure */
   memset (&singleton_set, 0, sizeof (struct REGEX_INTERNAL_StateSet));
@@ -3116,6 +3570,7 @@ REGEX_INTERNAL_automaton_destroy (struct REGEX_INTERNAL_Automaton *a)
     GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s);
     automaton_destroy_state (s);
   }
+  arena_destroy (a->arena);
 
   GNUNET_free (a);
 }
@@ -87,6 +87,14 @@ struct REGEX_INTERNAL_Transition
 struct REGEX_INTERNAL_State;
 
 
+/**
+ * Memory pool that the states and transitions of an automaton, and the
+ * transition labels, are allocated from.  Everything in it is freed at
+ * once when the automaton is destroyed.
+ */
+struct REGEX_INTERNAL_Arena;
+
+
 /**
  * Set of states.
  */
@@ -239,6 +247,11 @@ struct REGEX_INTERNAL_State
    * of several NFA states.
    */
   struct REGEX_INTERNAL_StateSet nfa_set;
+
+  /**
+   * Arena this state and its transitions are allocated from.
+   */
+  struct REGEX_INTERNAL_Arena *arena;
 };
 
 
@@ -312,6 +325,17 @@ struct REGEX_INTERNAL_Automaton
    * GNUNET_YES, if multi strides have been added to the Automaton.
    */
   int is_multistrided;
+
+  /**
+   * How long it took to create the proofs of the states.
+   */
+  struct GNUNET_TIME_Relative proof_time;
+
+  /**
+   * Arena the states of this automaton are allocated from, owned by the
+   * automaton.  NULL for NFA fragments during construction.
+   */
+  struct REGEX_INTERNAL_Arena *arena;
 };
 
 
@@ -428,6 +452,11 @@ struct REGEX_INTERNAL_Context
    * DLL of REGEX_INTERNAL_Automaton's used as a stack.
    */
   struct REGEX_INTERNAL_Automaton *stack_tail;
+
+  /**
+   * Arena new states are allocated from.
+   */
+  struct REGEX_INTERNAL_Arena *arena;
 };
 
 
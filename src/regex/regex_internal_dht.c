@@ -49,6 +49,71 @@
  */
 #define DHT_OPT         GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE
 
+/**
+ * How many DHT PUTs of an announcement may be waiting for their
+ * transmission to the DHT service at the same time.
+ */
+#define ANNOUNCE_WINDOW 64
+
+/**
+ * How long do we keep blocks found in the DHT in a block cache at most?
+ */
+#define BLOCK_CACHE_TTL GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 5)
+
+
+/**
+ * Block of one state of an announced automaton.
+ */
+struct AnnounceBlock
+{
+  /**
+   * Key of the state.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * The block to put in the DHT.
+   */
+  struct RegexBlock *block;
+
+  /**
+   * Size of @e block.
+   */
+  size_t size;
+
+  /**
+   * #GNUNET_YES if the state is accepting.
+   */
+  int accepting;
+};
+
+
+/**
+ * DHT PUT of an announcement that was not transmitted yet.
+ */
+struct AnnouncePut
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct AnnouncePut *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct AnnouncePut *prev;
+
+  /**
+   * Announcement the PUT belongs to.
+   */
+  struct REGEX_INTERNAL_Announcement *h;
+
+  /**
+   * Handle of the PUT.
+   */
+  struct GNUNET_DHT_PutHandle *ph;
+};
+
 
 /**
  * Handle to store cached data about a regex announce.
@@ -79,11 +144,42 @@ struct REGEX_INTERNAL_Announcement
    * Optional statistics handle to report usage. Can be NULL.
    */
   struct GNUNET_STATISTICS_Handle *stats;
+
+  /**
+   * Blocks of all reachable states, created on the first announce.
+   */
+  struct AnnounceBlock *blocks;
+
+  /**
+   * Number of entries in @e blocks.
+   */
+  unsigned int num_blocks;
+
+  /**
+   * Index of the next block in @e blocks to put in the DHT.
+   * Equal to @e num_blocks if the announce round is complete.
+   */
+  unsigned int next_block;
+
+  /**
+   * Number of PUTs in the DLL.
+   */
+  unsigned int num_puts;
+
+  /**
+   * Head of DLL of PUTs that were not transmitted yet.
+   */
+  struct AnnouncePut *put_head;
+
+  /**
+   * Tail of DLL of PUTs that were not transmitted yet.
+   */
+  struct AnnouncePut *put_tail;
 };
 
 
 /**
- * Regex callback iterator to store own service description in the DHT.
+ * Regex callback iterator to create the block of a state for the DHT.
  *
  * @param cls closure.
  * @param key hash for current state.
@@ -101,12 +197,11 @@ regex_iterator (void *cls,
                 const struct REGEX_BLOCK_Edge *edges)
 {
   struct REGEX_INTERNAL_Announcement *h = cls;
-  struct RegexBlock *block;
-  size_t size;
+  struct AnnounceBlock ab;
   unsigned int i;
 
   LOG (GNUNET_ERROR_TYPE_INFO,
-       "DHT PUT for state %s with proof `%s' and %u edges:\n",
+       "Block for state %s with proof `%s' and %u edges:\n",
        GNUNET_h2s (key),
        proof,
        num_edges);
@@ -118,60 +213,183 @@ regex_iterator (void *cls,
          edges[i].label,
          GNUNET_h2s (&edges[i].destination));
   }
-  if (GNUNET_YES == accepting)
+  ab.key = *key;
+  ab.accepting = accepting;
+  ab.block = REGEX_BLOCK_create (proof,
+                                 num_edges, edges,
+                                 accepting,
+                                 &ab.size);
+  GNUNET_array_append (h->blocks,
+                       h->num_blocks,
+                       ab);
+}
+
+
+/**
+ * Put more blocks of an announcement in the DHT.
+ *
+ * @param h the announcement
+ */
+static void
+announce_next_blocks (struct REGEX_INTERNAL_Announcement *h);
+
+
+/**
+ * Called when a DHT PUT of an announcement was transmitted to the
+ * DHT service.  Continues with the next blocks.
+ *
+ * @param cls the `struct AnnouncePut`
+ * @param success #GNUNET_OK if the PUT was transmitted,
+ *                #GNUNET_SYSERR if we lost the connection to the DHT
+ */
+static void
+announce_put_cont (void *cls,
+                   int success)
+{
+  struct AnnouncePut *ap = cls;
+  struct REGEX_INTERNAL_Announcement *h = ap->h;
+
+  GNUNET_CONTAINER_DLL_remove (h->put_head,
+                               h->put_tail,
+                               ap);
+  h->num_puts--;
+  GNUNET_free (ap);
+  if (GNUNET_OK != success)
+  {
+    /* DHT is reconnecting; stop this round, the next
+       reannounce will start over */
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         "DHT PUT failed, announcing `%s' again later\n",
+         h->regex);
+    h->next_block = h->num_blocks;
+    return;
+  }
+  announce_next_blocks (h);
+}
+
+
+/**
+ * Start a DHT PUT for an announcement.
+ *
+ * @param h the announcement
+ * @param key key to put the block under
+ * @param type type of the block
+ * @param options additional routing options
+ * @param size number of bytes in @a data
+ * @param data the block
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if we are
+ *         not connected to the DHT
+ */
+static int
+announce_put (struct REGEX_INTERNAL_Announcement *h,
+              const struct GNUNET_HashCode *key,
+              enum GNUNET_BLOCK_Type type,
+              enum GNUNET_DHT_RouteOption options,
+              size_t size,
+              const void *data)
+{
+  struct AnnouncePut *ap;
+
+  ap = GNUNET_new (struct AnnouncePut);
+  ap->h = h;
+  ap->ph = GNUNET_DHT_put (h->dht, key,
+                           DHT_REPLICATION,
+                           DHT_OPT | options,
+                           type,
+                           size,
+                           data,
+                           GNUNET_TIME_relative_to_absolute (DHT_TTL),
+                           &announce_put_cont, ap);
+  if (NULL == ap->ph)
   {
-    struct RegexAcceptBlock ab;
+    GNUNET_free (ap);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_CONTAINER_DLL_insert_tail (h->put_head,
+                                    h->put_tail,
+                                    ap);
+  h->num_puts++;
+  return GNUNET_OK;
+}
 
-    LOG (GNUNET_ERROR_TYPE_INFO,
-         "State %s is accepting, putting own id\n",
-         GNUNET_h2s (key));
-    size = sizeof (struct RegexAcceptBlock);
-    ab.purpose.size = ntohl (sizeof (struct GNUNET_CRYPTO_EccSignaturePurpose) +
-                             sizeof (struct GNUNET_TIME_AbsoluteNBO) +
-                             sizeof (struct GNUNET_HashCode));
-    ab.purpose.purpose = ntohl (GNUNET_SIGNATURE_PURPOSE_REGEX_ACCEPT);
-    ab.expiration_time = GNUNET_TIME_absolute_hton (GNUNET_TIME_relative_to_absolute (GNUNET_CONSTANTS_DHT_MAX_EXPIRATION));
-    ab.key = *key;
-    GNUNET_CRYPTO_eddsa_key_get_public (h->priv,
-                                        &ab.peer.public_key);
-    GNUNET_assert (GNUNET_OK ==
-                   GNUNET_CRYPTO_eddsa_sign (h->priv,
-                                           &ab.purpose,
-                                           &ab.signature));
-
-    GNUNET_STATISTICS_update (h->stats, "# regex accepting blocks stored",
+
+/**
+ * Put more blocks of an announcement in the DHT, keeping at most
+ * #ANNOUNCE_WINDOW PUTs waiting for the DHT service.  Accepting states
+ * also get a signed accept block with our identity.
+ *
+ * @param h the announcement
+ */
+static void
+announce_next_blocks (struct REGEX_INTERNAL_Announcement *h)
+{
+  const struct AnnounceBlock *ab;
+  struct RegexAcceptBlock accept;
+
+  while ( (h->num_puts < ANNOUNCE_WINDOW) &&
+          (h->next_block < h->num_blocks) )
+  {
+    ab = &h->blocks[h->next_block];
+    if (GNUNET_YES == ab->accepting)
+    {
+      LOG (GNUNET_ERROR_TYPE_INFO,
+           "State %s is accepting, putting own id\n",
+           GNUNET_h2s (&ab->key));
+      accept.purpose.size = ntohl (sizeof (struct GNUNET_CRYPTO_EccSignaturePurpose) +
+                                   sizeof (struct GNUNET_TIME_AbsoluteNBO) +
+                                   sizeof (struct GNUNET_HashCode));
+      accept.purpose.purpose = ntohl (GNUNET_SIGNATURE_PURPOSE_REGEX_ACCEPT);
+      accept.expiration_time = GNUNET_TIME_absolute_hton (GNUNET_TIME_relative_to_absolute (GNUNET_CONSTANTS_DHT_MAX_EXPIRATION));
+      accept.key = ab->key;
+      GNUNET_CRYPTO_eddsa_key_get_public (h->priv,
+                                          &accept.peer.public_key);
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_CRYPTO_eddsa_sign (h->priv,
+                                               &accept.purpose,
+                                               &accept.signature));
+      if (GNUNET_OK !=
+          announce_put (h, &ab->key,
+                        GNUNET_BLOCK_TYPE_REGEX_ACCEPT,
+                        GNUNET_DHT_RO_RECORD_ROUTE,
+                        sizeof (struct RegexAcceptBlock),
+                        &accept))
+        break;
+      GNUNET_STATISTICS_update (h->stats, "# regex accepting blocks stored",
+                                1, GNUNET_NO);
+      GNUNET_STATISTICS_update (h->stats, "# regex accepting block bytes stored",
+                                sizeof (struct RegexAcceptBlock), GNUNET_NO);
+    }
+    if (GNUNET_OK !=
+        announce_put (h, &ab->key,
+                      GNUNET_BLOCK_TYPE_REGEX,
+                      GNUNET_DHT_RO_NONE,
+                      ab->size,
+                      ab->block))
+      break;
+    GNUNET_STATISTICS_update (h->stats,
+                              "# regex blocks stored",
                               1, GNUNET_NO);
-    GNUNET_STATISTICS_update (h->stats, "# regex accepting block bytes stored",
-                              sizeof (struct RegexAcceptBlock), GNUNET_NO);
-    (void)
-    GNUNET_DHT_put (h->dht, key,
-                    DHT_REPLICATION,
-                    DHT_OPT | GNUNET_DHT_RO_RECORD_ROUTE,
-                    GNUNET_BLOCK_TYPE_REGEX_ACCEPT,
-                    size,
-                    &ab,
-                    GNUNET_TIME_relative_to_absolute (DHT_TTL),
-                    NULL, NULL);
+    GNUNET_STATISTICS_update (h->stats,
+                              "# regex block bytes stored",
+                              ab->size, GNUNET_NO);
+    h->next_block++;
   }
-  block = REGEX_BLOCK_create (proof,
-                              num_edges, edges,
-                              accepting,
-                              &size);
-  (void)
-  GNUNET_DHT_put (h->dht, key,
-                  DHT_REPLICATION,
-                  DHT_OPT,
-                  GNUNET_BLOCK_TYPE_REGEX,
-                  size, block,
-                  GNUNET_TIME_relative_to_absolute (DHT_TTL),
-                  NULL, NULL);
-  GNUNET_STATISTICS_update (h->stats,
-                            "# regex blocks stored",
-                            1, GNUNET_NO);
-  GNUNET_STATISTICS_update (h->stats,
-                            "# regex block bytes stored",
-                            size, GNUNET_NO);
-  GNUNET_free (block);
+  if (h->next_block < h->num_blocks)
+  {
+    if (0 == h->num_puts)
+    {
+      /* not connected to the DHT right now; nobody will continue */
+      LOG (GNUNET_ERROR_TYPE_WARNING,
+           "Not connected to the DHT, announcing `%s' again later\n",
+           h->regex);
+      h->next_block = h->num_blocks;
+    }
+    return;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "All %u blocks of `%s' handed to the DHT\n",
+       h->num_blocks,
+       h->regex);
 }
 
 
@@ -210,7 +428,10 @@ REGEX_INTERNAL_announce (struct GNUNET_DHT_Handle *dht,
 
 /**
  * Announce again a regular expression previously announced.
- * Does use caching to speed up process.
+ * Does use caching to speed up process: the blocks of the states are
+ * only created once, and are put in the DHT in a sliding window of
+ * #ANNOUNCE_WINDOW PUTs.  If the previous round is still running, it
+ * starts over with the first block.
  *
  * @param h Handle returned by a previous #REGEX_INTERNAL_announce call().
  */
@@ -221,9 +442,12 @@ REGEX_INTERNAL_reannounce (struct REGEX_INTERNAL_Announcement *h)
   LOG (GNUNET_ERROR_TYPE_INFO,
        "REGEX_INTERNAL_reannounce: %s\n",
        h->regex);
-  REGEX_INTERNAL_iterate_reachable_edges (h->dfa,
-                                          &regex_iterator,
-                                          h);
+  if (NULL == h->blocks)
+    REGEX_INTERNAL_iterate_reachable_edges (h->dfa,
+                                            &regex_iterator,
+                                            h);
+  h->next_block = 0;
+  announce_next_blocks (h);
 }
 
 
@@ -236,6 +460,22 @@ REGEX_INTERNAL_reannounce (struct REGEX_INTERNAL_Announcement *h)
 void
 REGEX_INTERNAL_announce_cancel (struct REGEX_INTERNAL_Announcement *h)
 {
+  struct AnnouncePut *ap;
+  unsigned int i;
+
+  while (NULL != (ap = h->put_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (h->put_head,
+                                 h->put_tail,
+                                 ap);
+    GNUNET_DHT_put_cancel (ap->ph);
+    GNUNET_free (ap);
+  }
+  for (i = 0; i < h->num_blocks; i++)
+    GNUNET_free (h->blocks[i].block);
+  GNUNET_array_grow (h->blocks,
+                     h->num_blocks,
+                     0);
   REGEX_INTERNAL_automaton_destroy (h->dfa);
   GNUNET_free (h);
 }
@@ -244,6 +484,61 @@ REGEX_INTERNAL_announce_cancel (struct REGEX_INTERNAL_Announcement *h)
 /******************************************************************************/
 
 
+/**
+ * Block found in the DHT, kept in a block cache.
+ */
+struct CacheEntry
+{
+  /**
+   * Key of the entry in the cache, derived from @e state and the
+   * query the block was found with, see #cache_key().
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * Key of the state the block belongs to.
+   */
+  struct GNUNET_HashCode state;
+
+  /**
+   * Node of the entry in the expiration heap.
+   */
+  struct GNUNET_CONTAINER_HeapNode *hn;
+
+  /**
+   * When does the entry expire?
+   */
+  struct GNUNET_TIME_Absolute expiration;
+
+  /**
+   * Number of bytes of the block, which follows this struct.
+   */
+  size_t size;
+};
+
+
+/**
+ * Cache of blocks found in the DHT, shared by searches.
+ */
+struct REGEX_INTERNAL_BlockCache
+{
+  /**
+   * Cached blocks, values are of type `struct CacheEntry`.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *blocks;
+
+  /**
+   * Cached blocks by expiration time, soonest first.
+   */
+  struct GNUNET_CONTAINER_Heap *expiration_heap;
+
+  /**
+   * Maximum number of blocks in the cache.
+   */
+  unsigned int max_blocks;
+};
+
+
 /**
  * Struct to keep state of running searches that have consumed a part of
  * the inital string.
@@ -260,20 +555,48 @@ struct RegexSearchContext
    * Information about the search.
    */
   struct REGEX_INTERNAL_Search *info;
+};
 
+
+/**
+ * Edge matching the rest of the description.
+ */
+struct RegexMatch
+{
   /**
-   * We just want to look for one edge, the longer the better.
-   * Keep its length.
+   * Length of the token of the edge.
    */
-  unsigned int longest_match;
+  size_t len;
 
   /**
-   * Destination hash of the longest match.
+   * Destination of the edge.
    */
   struct GNUNET_HashCode hash;
 };
 
 
+/**
+ * Closure for #regex_edge_iterator().
+ */
+struct RegexMatchContext
+{
+  /**
+   * Search context of the block.
+   */
+  struct RegexSearchContext *ctx;
+
+  /**
+   * Longest matching edges found so far, longest first.
+   */
+  struct RegexMatch *matches;
+
+  /**
+   * Number of entries in @e matches.
+   */
+  unsigned int num_matches;
+};
+
+
 /**
  * Type of values in `dht_get_results`.
  */
@@ -307,6 +630,11 @@ struct REGEX_INTERNAL_Search
    */
   struct GNUNET_STATISTICS_Handle *stats;
 
+  /**
+   * Optional cache of blocks found in the DHT.  Can be NULL.
+   */
+  struct REGEX_INTERNAL_BlockCache *cache;
+
   /**
    * User provided description of the searched service.
    */
@@ -318,8 +646,8 @@ struct REGEX_INTERNAL_Search
   struct GNUNET_CONTAINER_MultiHashMap *dht_get_handles;
 
   /**
-   * Results from running DHT GETs, values are of type
-   * 'struct Result'.
+   * Results from running DHT GETs and from the block cache,
+   * values are of type 'struct Result'.
    */
   struct GNUNET_CONTAINER_MultiHashMap *dht_get_results;
 
@@ -333,6 +661,11 @@ struct REGEX_INTERNAL_Search
    */
   unsigned int n_contexts;
 
+  /**
+   * How many matching edges of a block to follow at most.
+   */
+  unsigned int fanout;
+
   /**
    * @param callback Callback for found peers.
    */
@@ -346,7 +679,309 @@ struct REGEX_INTERNAL_Search
 
 
 /**
- * Jump to the next edge, with the longest matching token.
+ * Create a cache for blocks found by searches in the DHT.  Searches
+ * using the cache look up blocks in it before asking the DHT, if the
+ * blocks were found for the same rest of a search string.
+ *
+ * @param max_blocks maximum number of blocks to keep
+ * @return the cache, free with #REGEX_INTERNAL_block_cache_destroy()
+ */
+struct REGEX_INTERNAL_BlockCache *
+REGEX_INTERNAL_block_cache_create (unsigned int max_blocks)
+{
+  struct REGEX_INTERNAL_BlockCache *cache;
+
+  GNUNET_assert (0 < max_blocks);
+  cache = GNUNET_new (struct REGEX_INTERNAL_BlockCache);
+  cache->max_blocks = max_blocks;
+  cache->blocks = GNUNET_CONTAINER_multihashmap_create (GNUNET_MIN (max_blocks,
+                                                                    1024),
+                                                        GNUNET_NO);
+  cache->expiration_heap
+    = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  return cache;
+}
+
+
+/**
+ * Remove an entry from a block cache and free it.
+ *
+ * @param cache the cache
+ * @param entry the entry to remove
+ */
+static void
+cache_entry_remove (struct REGEX_INTERNAL_BlockCache *cache,
+                    struct CacheEntry *entry)
+{
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (cache->blocks,
+                                                       &entry->key,
+                                                       entry));
+  GNUNET_CONTAINER_heap_remove_node (entry->hn);
+  GNUNET_free (entry);
+}
+
+
+/**
+ * Remove all expired entries from a block cache.
+ *
+ * @param cache the cache
+ */
+static void
+cache_expire (struct REGEX_INTERNAL_BlockCache *cache)
+{
+  struct CacheEntry *entry;
+
+  while ( (NULL != (entry = GNUNET_CONTAINER_heap_peek (cache->expiration_heap))) &&
+          (0 == GNUNET_TIME_absolute_get_remaining (entry->expiration).rel_value_us) )
+    cache_entry_remove (cache, entry);
+}
+
+
+/**
+ * Closure for #cache_find_block().
+ */
+struct CacheFindContext
+{
+  /**
+   * Block to look for.
+   */
+  const void *data;
+
+  /**
+   * Size of @e data.
+   */
+  size_t size;
+
+  /**
+   * Set to the entry with the block, if there is one.
+   */
+  struct CacheEntry *found;
+};
+
+
+/**
+ * Check whether a cache entry contains a certain block.
+ *
+ * @param cls the `struct CacheFindContext`
+ * @param key key of the entry
+ * @param value the `struct CacheEntry`
+ * @return #GNUNET_NO if the block was found, #GNUNET_YES to continue
+ */
+static int
+cache_find_block (void *cls,
+                  const struct GNUNET_HashCode *key,
+                  void *value)
+{
+  struct CacheFindContext *fc = cls;
+  struct CacheEntry *entry = value;
+
+  if ( (entry->size != fc->size) ||
+       (0 != memcmp (&entry[1], fc->data, fc->size)) )
+    return GNUNET_YES;
+  fc->found = entry;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Compute the key of the blocks of a state in a block cache.  The
+ * DHT only returns the blocks of a state with an edge matching the
+ * query of the GET, so the blocks found for one query are not all
+ * blocks of the state and must not answer a different query.
+ *
+ * @param state key of the state
+ * @param xquery rest of the description the blocks were looked up for
+ * @param key set to the key in the cache
+ */
+static void
+cache_key (const struct GNUNET_HashCode *state,
+           const char *xquery,
+           struct GNUNET_HashCode *key)
+{
+  struct GNUNET_HashCode hc[2];
+
+  hc[0] = *state;
+  GNUNET_CRYPTO_hash (xquery,
+                      strlen (xquery),
+                      &hc[1]);
+  GNUNET_CRYPTO_hash (hc,
+                      sizeof (hc),
+                      key);
+}
+
+
+/**
+ * Add a block found in the DHT to a block cache.  If the cache is
+ * full, the entry expiring first is dropped.
+ *
+ * @param cache the cache
+ * @param state key of the block
+ * @param xquery query of the GET that found the block
+ * @param exp when does the block expire in the DHT
+ * @param size number of bytes in @a data
+ * @param data the block
+ */
+static void
+cache_put (struct REGEX_INTERNAL_BlockCache *cache,
+           const struct GNUNET_HashCode *state,
+           const char *xquery,
+           struct GNUNET_TIME_Absolute exp,
+           size_t size,
+           const void *data)
+{
+  struct GNUNET_HashCode key;
+  struct CacheFindContext fc;
+  struct CacheEntry *entry;
+
+  cache_expire (cache);
+  cache_key (state, xquery, &key);
+  exp = GNUNET_TIME_absolute_min (exp,
+                                  GNUNET_TIME_relative_to_absolute (BLOCK_CACHE_TTL));
+  fc.data = data;
+  fc.size = size;
+  fc.found = NULL;
+  GNUNET_CONTAINER_multihashmap_get_multiple (cache->blocks,
+                                              &key,
+                                              &cache_find_block,
+                                              &fc);
+  if (NULL != fc.found)
+  {
+    /* same block from another replica */
+    fc.found->expiration = GNUNET_TIME_absolute_max (fc.found->expiration,
+                                                     exp);
+    GNUNET_CONTAINER_heap_update_cost (fc.found->hn,
+                                       fc.found->expiration.abs_value_us);
+    return;
+  }
+  if (GNUNET_CONTAINER_multihashmap_size (cache->blocks) >= cache->max_blocks)
+    cache_entry_remove (cache,
+                        GNUNET_CONTAINER_heap_peek (cache->expiration_heap));
+  entry = GNUNET_malloc (sizeof (struct CacheEntry) + size);
+  entry->key = key;
+  entry->state = *state;
+  entry->expiration = exp;
+  entry->size = size;
+  GNUNET_memcpy (&entry[1], data, size);
+  entry->hn = GNUNET_CONTAINER_heap_insert (cache->expiration_heap,
+                                            entry,
+                                            exp.abs_value_us);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (cache->blocks,
+                                                    &key,
+                                                    entry,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+}
+
+
+/**
+ * Destroy a block cache.  All searches using it must have been
+ * cancelled.
+ *
+ * @param cache the cache to destroy
+ */
+void
+REGEX_INTERNAL_block_cache_destroy (struct REGEX_INTERNAL_BlockCache *cache)
+{
+  struct CacheEntry *entry;
+
+  while (NULL != (entry = GNUNET_CONTAINER_heap_peek (cache->expiration_heap)))
+    cache_entry_remove (cache, entry);
+  GNUNET_CONTAINER_heap_destroy (cache->expiration_heap);
+  GNUNET_CONTAINER_multihashmap_destroy (cache->blocks);
+  GNUNET_free (cache);
+}
+
+
+/**
+ * Store a block in the results of a search.
+ *
+ * @param info the search
+ * @param key key of the block
+ * @param size number of bytes in @a data
+ * @param data the block
+ */
+static void
+store_result (struct REGEX_INTERNAL_Search *info,
+              const struct GNUNET_HashCode *key,
+              size_t size,
+              const void *data)
+{
+  struct Result *copy;
+
+  copy = GNUNET_malloc (sizeof (struct Result) + size);
+  copy->size = size;
+  copy->data = &copy[1];
+  GNUNET_memcpy (&copy[1], data, size);
+  GNUNET_break (GNUNET_OK ==
+		GNUNET_CONTAINER_multihashmap_put (info->dht_get_results,
+						   key, copy,
+						   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+}
+
+
+/**
+ * Copy a cached block to the results of a search.
+ *
+ * @param cls the `struct REGEX_INTERNAL_Search`
+ * @param key key of the entry in the cache
+ * @param value the `struct CacheEntry`
+ * @return #GNUNET_YES to continue
+ */
+static int
+copy_cached_result (void *cls,
+                    const struct GNUNET_HashCode *key,
+                    void *value)
+{
+  struct REGEX_INTERNAL_Search *info = cls;
+  struct CacheEntry *entry = value;
+
+  store_result (info, &entry->state, entry->size, &entry[1]);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Look up the blocks of a state in the block cache of a search, and
+ * add them to its results.  Only blocks found by a GET with the same
+ * query are used, as the DHT filters the blocks by the query.
+ *
+ * @param info the search
+ * @param state key of the state
+ * @param xquery rest of the description to look up the blocks for
+ * @return #GNUNET_YES if the blocks were found in the cache,
+ *         #GNUNET_NO if we need to ask the DHT
+ */
+static int
+lookup_cached_results (struct REGEX_INTERNAL_Search *info,
+                       const struct GNUNET_HashCode *state,
+                       const char *xquery)
+{
+  struct GNUNET_HashCode key;
+  int found;
+
+  if (NULL == info->cache)
+    return GNUNET_NO;
+  cache_expire (info->cache);
+  cache_key (state, xquery, &key);
+  found = GNUNET_CONTAINER_multihashmap_get_multiple (info->cache->blocks,
+                                                      &key,
+                                                      &copy_cached_result,
+                                                      info);
+  if (0 >= found)
+  {
+    GNUNET_STATISTICS_update (info->stats, "# regex block cache misses",
+                              1, GNUNET_NO);
+    return GNUNET_NO;
+  }
+  GNUNET_STATISTICS_update (info->stats, "# regex block cache hits",
+                            1, GNUNET_NO);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Jump to the next edges, with the longest matching tokens.
  *
  * @param block Block found in the DHT.
  * @param size Size of the block.
@@ -468,19 +1103,15 @@ dht_get_string_handler (void *cls, struct GNUNET_TIME_Absolute exp,
   struct RegexSearchContext *ctx = cls;
   struct REGEX_INTERNAL_Search *info = ctx->info;
   size_t len;
-  struct Result *copy;
 
   LOG (GNUNET_ERROR_TYPE_INFO,
        "DHT GET result for %s (%s)\n",
        GNUNET_h2s (key), ctx->info->description);
-  copy = GNUNET_malloc (sizeof (struct Result) + size);
-  copy->size = size;
-  copy->data = &copy[1];
-  GNUNET_memcpy (&copy[1], block, size);
-  GNUNET_break (GNUNET_OK ==
-		GNUNET_CONTAINER_multihashmap_put (info->dht_get_results,
-						   key, copy,
-						   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  store_result (info, key, size, block);
+  if (NULL != info->cache)
+    cache_put (info->cache, key,
+               &info->description[ctx->position],
+               exp, size, block);
   len = strlen (info->description);
   if (len == ctx->position) // String processed
   {
@@ -539,10 +1170,85 @@ regex_result_iterator (void *cls,
 }
 
 
+/**
+ * Closure for #collect_result().
+ */
+struct CollectContext
+{
+  /**
+   * Array to store the results in.
+   */
+  struct Result **results;
+
+  /**
+   * Number of results stored so far.
+   */
+  unsigned int n_results;
+};
+
+
+/**
+ * Store a result of a search in an array.
+ *
+ * @param cls the `struct CollectContext`
+ * @param key key of the result
+ * @param value the `struct Result`
+ * @return #GNUNET_YES to continue
+ */
+static int
+collect_result (void *cls,
+                const struct GNUNET_HashCode *key,
+                void *value)
+{
+  struct CollectContext *cc = cls;
+
+  cc->results[cc->n_results++] = value;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Continue a search with the blocks of a state we already know.
+ * Processing them may add more results, so we work on a copy of
+ * the list.
+ *
+ * @param key key of the state
+ * @param ctx context of the search at the state
+ */
+static void
+regex_process_known_results (const struct GNUNET_HashCode *key,
+                             struct RegexSearchContext *ctx)
+{
+  struct REGEX_INTERNAL_Search *info = ctx->info;
+  struct CollectContext cc;
+  unsigned int n;
+  unsigned int i;
+
+  n = GNUNET_CONTAINER_multihashmap_get_multiple (info->dht_get_results,
+                                                  key,
+                                                  NULL, NULL);
+  if (0 == n)
+    return;
+  {
+    struct Result *results[n];
+
+    cc.results = results;
+    cc.n_results = 0;
+    GNUNET_CONTAINER_multihashmap_get_multiple (info->dht_get_results,
+                                                key,
+                                                &collect_result,
+                                                &cc);
+    for (i = 0; i < cc.n_results; i++)
+      regex_result_iterator (ctx, key, results[i]);
+  }
+}
+
+
 /**
  * Iterator over edges in a regex block retrieved from the DHT.
+ * Keeps the longest matching edges, up to the fanout of the search.
  *
- * @param cls Closure (context of the search).
+ * @param cls Closure (`struct RegexMatchContext`).
  * @param token Token that follows to next state.
  * @param len Lenght of token.
  * @param key Hash of next state.
@@ -554,10 +1260,12 @@ regex_edge_iterator (void *cls,
                      size_t len,
                      const struct GNUNET_HashCode *key)
 {
-  struct RegexSearchContext *ctx = cls;
+  struct RegexMatchContext *mc = cls;
+  struct RegexSearchContext *ctx = mc->ctx;
   struct REGEX_INTERNAL_Search *info = ctx->info;
   const char *current;
   size_t current_len;
+  unsigned int i;
 
   GNUNET_STATISTICS_update (info->stats, "# regex edges iterated",
                             1, GNUNET_NO);
@@ -573,17 +1281,30 @@ regex_edge_iterator (void *cls,
     LOG (GNUNET_ERROR_TYPE_DEBUG, "Token doesn't match, END\n");
     return GNUNET_YES;
   }
+  if (0 == len)
+    return GNUNET_YES;
 
-  if (len > ctx->longest_match)
+  /* insert into the matches, which are sorted by length */
+  i = mc->num_matches;
+  if ( (i == info->fanout) &&
+       (len <= mc->matches[i - 1].len) )
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is longer, KEEP\n");
-    ctx->longest_match = len;
-    ctx->hash = *key;
+    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is not longer, IGNORE\n");
+    return GNUNET_YES;
   }
+  LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is longer, KEEP\n");
+  if (i == info->fanout)
+    i--;
   else
+    mc->num_matches++;
+  while ( (i > 0) &&
+          (mc->matches[i - 1].len < len) )
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is not longer, IGNORE\n");
+    mc->matches[i] = mc->matches[i - 1];
+    i--;
   }
+  mc->matches[i].len = len;
+  mc->matches[i].hash = *key;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG, "*    End of regex edge iterator\n");
   return GNUNET_YES;
@@ -591,57 +1312,41 @@ regex_edge_iterator (void *cls,
 
 
 /**
- * Jump to the next edge, with the longest matching token.
+ * Continue a search at the destination of a matching edge.
  *
- * @param block Block found in the DHT.
- * @param size Size of the block.
- * @param ctx Context of the search.
+ * @param ctx Context of the search at the source of the edge.
+ * @param match The matching edge.
  */
 static void
-regex_next_edge (const struct RegexBlock *block,
-                 size_t size,
-                 struct RegexSearchContext *ctx)
+regex_follow_edge (struct RegexSearchContext *ctx,
+                   const struct RegexMatch *match)
 {
   struct RegexSearchContext *new_ctx;
   struct REGEX_INTERNAL_Search *info = ctx->info;
   struct GNUNET_DHT_GetHandle *get_h;
-  struct GNUNET_HashCode *hash;
+  const struct GNUNET_HashCode *hash;
   const char *rest;
-  int result;
 
-  LOG (GNUNET_ERROR_TYPE_DEBUG, "Next edge\n");
-  /* Find the longest match for the current string position,
-   * among tokens in the given block */
-  ctx->longest_match = 0;
-  result = REGEX_BLOCK_iterate (block, size,
-                                &regex_edge_iterator, ctx);
-  GNUNET_break (GNUNET_OK == result);
-
-  /* Did anything match? */
-  if (0 == ctx->longest_match)
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-	 "no match in block\n");
-    return;
-  }
-
-  hash = &ctx->hash;
+  hash = &match->hash;
   new_ctx = GNUNET_new (struct RegexSearchContext);
   new_ctx->info = info;
-  new_ctx->position = ctx->position + ctx->longest_match;
+  new_ctx->position = ctx->position + match->len;
   GNUNET_array_append (info->contexts, info->n_contexts, new_ctx);
+  rest = &info->description[new_ctx->position];
 
-  /* Check whether we already have a DHT GET running for it */
-  if (GNUNET_YES ==
-      GNUNET_CONTAINER_multihashmap_contains (info->dht_get_handles, hash))
+  /* Check whether we already have a DHT GET running for it,
+     or know its blocks already */
+  if ( (GNUNET_YES ==
+        GNUNET_CONTAINER_multihashmap_contains (info->dht_get_handles, hash)) ||
+       (GNUNET_YES ==
+        GNUNET_CONTAINER_multihashmap_contains (info->dht_get_results, hash)) ||
+       (GNUNET_YES ==
+        lookup_cached_results (info, hash, rest)) )
   {
     LOG (GNUNET_ERROR_TYPE_DEBUG,
-	 "GET for %s running, END\n",
+	 "GET for %s running or cached, END\n",
          GNUNET_h2s (hash));
-    GNUNET_CONTAINER_multihashmap_get_multiple (info->dht_get_results,
-                                                hash,
-                                                &regex_result_iterator,
-                                                new_ctx);
+    regex_process_known_results (hash, new_ctx);
     return; /* We are already looking for it */
   }
 
@@ -653,7 +1358,6 @@ regex_next_edge (const struct RegexBlock *block,
        GNUNET_h2s (hash),
        (unsigned int) ctx->position,
        info->description);
-  rest = &new_ctx->info->description[new_ctx->position];
   get_h =
       GNUNET_DHT_get_start (info->dht,    /* handle */
                             GNUNET_BLOCK_TYPE_REGEX, /* type */
@@ -675,6 +1379,52 @@ regex_next_edge (const struct RegexBlock *block,
 }
 
 
+/**
+ * Jump to the next edges, with the longest matching tokens.  Up to
+ * the fanout of the search, the destinations of the longest matching
+ * edges are looked up in parallel, so a dead end on the longest match
+ * does not cost another round trip.
+ *
+ * @param block Block found in the DHT.
+ * @param size Size of the block.
+ * @param ctx Context of the search.
+ */
+static void
+regex_next_edge (const struct RegexBlock *block,
+                 size_t size,
+                 struct RegexSearchContext *ctx)
+{
+  struct REGEX_INTERNAL_Search *info = ctx->info;
+  struct RegexMatch matches[info->fanout];
+  struct RegexMatchContext mc;
+  unsigned int i;
+  int result;
+
+  LOG (GNUNET_ERROR_TYPE_DEBUG, "Next edge\n");
+  /* Find the longest matches for the current string position,
+   * among tokens in the given block */
+  mc.ctx = ctx;
+  mc.matches = matches;
+  mc.num_matches = 0;
+  result = REGEX_BLOCK_iterate (block, size,
+                                &regex_edge_iterator, &mc);
+  GNUNET_break (GNUNET_OK == result);
+
+  /* Did anything match? */
+  if (0 == mc.num_matches)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+	 "no match in block\n");
+    return;
+  }
+  if (1 < mc.num_matches)
+    GNUNET_STATISTICS_update (info->stats, "# regex speculative edges followed",
+                              mc.num_matches - 1, GNUNET_NO);
+  for (i = 0; i < mc.num_matches; i++)
+    regex_follow_edge (ctx, &matches[i]);
+}
+
+
 /**
  * Search for a peer offering a regex matching certain string in the DHT.
  * The search runs until #REGEX_INTERNAL_search_cancel() is called, even if results
@@ -682,6 +1432,10 @@ regex_next_edge (const struct RegexBlock *block,
  *
  * @param dht An existing and valid DHT service handle.
  * @param string String to match against the regexes in the DHT.
+ * @param fanout How many of the longest matching edges of each state
+ *        to follow in parallel, at least 1.
+ * @param cache Optional cache of blocks to use and to fill, shared with
+ *        other searches.  Can be NULL.
  * @param callback Callback for found peers.
  * @param callback_cls Closure for @c callback.
  * @param stats Optional statistics handle to report usage. Can be NULL.
@@ -691,6 +1445,8 @@ regex_next_edge (const struct RegexBlock *block,
 struct REGEX_INTERNAL_Search *
 REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
                        const char *string,
+                       unsigned int fanout,
+                       struct REGEX_INTERNAL_BlockCache *cache,
                        REGEX_INTERNAL_Found callback,
                        void *callback_cls,
                        struct GNUNET_STATISTICS_Handle *stats)
@@ -705,8 +1461,11 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
   /* Initialize handle */
   GNUNET_assert (NULL != dht);
   GNUNET_assert (NULL != callback);
+  GNUNET_assert (0 < fanout);
   h = GNUNET_new (struct REGEX_INTERNAL_Search);
   h->dht = dht;
+  h->fanout = fanout;
+  h->cache = cache;
   h->description = GNUNET_strdup (string);
   h->callback = callback;
   h->callback_cls = callback_cls;
@@ -729,6 +1488,11 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
   GNUNET_array_append (h->contexts,
                        h->n_contexts,
                        ctx);
+  if (GNUNET_YES == lookup_cached_results (h, &key, &h->description[size]))
+  {
+    regex_process_known_results (&key, ctx);
+    return h;
+  }
   /* Start search in DHT */
   get_h = GNUNET_DHT_get_start (h->dht,    /* handle */
                                 GNUNET_BLOCK_TYPE_REGEX, /* type */
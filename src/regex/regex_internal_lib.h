@@ -168,6 +168,11 @@ struct REGEX_INTERNAL_Announcement;
  */
 struct REGEX_INTERNAL_Search;
 
+/**
+ * Cache of blocks found by regex searches.
+ */
+struct REGEX_INTERNAL_BlockCache;
+
 
 /**
  * Announce a regular expression: put all states of the automaton in the DHT.
@@ -235,6 +240,10 @@ typedef void
  *
  * @param dht An existing and valid DHT service handle.
  * @param string String to match against the regexes in the DHT.
+ * @param fanout How many of the longest matching edges of each state
+ *        to follow in parallel, at least 1.
+ * @param cache Optional cache of blocks to use and to fill, shared with
+ *        other searches.  Can be NULL.
  * @param callback Callback for found peers.
  * @param callback_cls Closure for @c callback.
  * @param stats Optional statistics handle to report usage. Can be NULL.
@@ -244,6 +253,8 @@ typedef void
 struct REGEX_INTERNAL_Search *
 REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
                        const char *string,
+                       unsigned int fanout,
+                       struct REGEX_INTERNAL_BlockCache *cache,
                        REGEX_INTERNAL_Found callback,
                        void *callback_cls,
                        struct GNUNET_STATISTICS_Handle *stats);
@@ -258,6 +269,28 @@ void
 REGEX_INTERNAL_search_cancel (struct REGEX_INTERNAL_Search *h);
 
 
+/**
+ * Create a cache for blocks found by searches in the DHT.  Searches
+ * using the cache look up blocks in it before asking the DHT, if the
+ * blocks were found for the same rest of a search string.
+ *
+ * @param max_blocks maximum number of blocks to keep
+ * @return the cache, free with #REGEX_INTERNAL_block_cache_destroy()
+ */
+struct REGEX_INTERNAL_BlockCache *
+REGEX_INTERNAL_block_cache_create (unsigned int max_blocks);
+
+
+/**
+ * Destroy a block cache.  All searches using it must have been
+ * cancelled.
+ *
+ * @param cache the cache to destroy
+ */
+void
+REGEX_INTERNAL_block_cache_destroy (struct REGEX_INTERNAL_BlockCache *cache);
+
+
 #if 0                           /* keep Emacsens' auto-indent happy */
 {
 #endif
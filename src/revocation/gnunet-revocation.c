@@ -80,9 +80,15 @@ static const struct GNUNET_CONFIGURATION_Handle *cfg;
 static unsigned long long matching_bits;
 
 /**
- * Task used for proof-of-work calculation.
+ * Search for the proof-of-work.
  */
-static struct GNUNET_SCHEDULER_Task *pow_task;
+static struct GNUNET_CRYPTO_PowSearch *pow_search;
+
+/**
+ * How often do we save and display the progress of the proof-of-work
+ * calculation?
+ */
+#define POW_CHECKPOINT_FREQUENCY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 10)
 
 
 /**
@@ -240,10 +246,10 @@ static void
 sync_rd (const struct RevocationData *rd)
 {
   if ( (NULL != filename) &&
-       (sizeof (struct RevocationData) ==
+       (sizeof (struct RevocationData) !=
 	GNUNET_DISK_fn_write (filename,
-			      &rd,
-			      sizeof (rd),
+			      rd,
+			      sizeof (struct RevocationData),
 			      GNUNET_DISK_PERM_USER_READ |
 			      GNUNET_DISK_PERM_USER_WRITE)) )
     GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
@@ -253,7 +259,7 @@ sync_rd (const struct RevocationData *rd)
 
 
 /**
- * Perform the proof-of-work calculation.
+ * Stop the proof-of-work calculation, saving our progress.
  *
  * @param cls the `struct RevocationData`
  */
@@ -262,10 +268,10 @@ calculate_pow_shutdown (void *cls)
 {
   struct RevocationData *rd = cls;
 
-  if (NULL != pow_task)
+  if (NULL != pow_search)
   {
-    GNUNET_SCHEDULER_cancel (pow_task);
-    pow_task = NULL;
+    rd->pow = GNUNET_CRYPTO_pow_search_cancel (pow_search);
+    pow_search = NULL;
   }
   sync_rd (rd);
   GNUNET_free (rd);
@@ -273,62 +279,73 @@ calculate_pow_shutdown (void *cls)
 
 
 /**
- * Perform the proof-of-work calculation.
+ * Called by the proof-of-work calculation with its progress and
+ * with the result.
  *
  * @param cls the `struct RevocationData`
+ * @param nonce the proof found, or the value to resume the search at
+ * @param found #GNUNET_YES if @a nonce is the proof
  */
 static void
-calculate_pow (void *cls)
+calculate_pow_cb (void *cls,
+                  uint64_t nonce,
+                  int found)
 {
   struct RevocationData *rd = cls;
 
   /* store temporary results */
-  pow_task = NULL;
-  if (0 == (rd->pow % 128))
-    sync_rd (rd);
-  /* display progress estimate */
-  if ( (0 == ((1 << matching_bits) / 100 / 50)) ||
-       (0 == (rd->pow % ((1 << matching_bits) / 100 / 50))) )
-    FPRINTF (stderr, "%s", ".");
-  if ( (0 != rd->pow) &&
-       ( (0 == ((1 << matching_bits) / 100)) ||
-         (0 == (rd->pow % ((1 << matching_bits) / 100))) ) )
-    FPRINTF (stderr, " - @ %3u%% (estimate)\n",
-             (unsigned int) (rd->pow * 100) / (1 << matching_bits));
-  /* actually do POW calculation */
-  rd->pow++;
-  if (GNUNET_OK ==
-      GNUNET_REVOCATION_check_pow (&rd->key,
-                                   rd->pow,
-                                   (unsigned int) matching_bits))
+  rd->pow = nonce;
+  sync_rd (rd);
+  if (GNUNET_YES != found)
   {
-    if ( (NULL != filename) &&
-         (sizeof (struct RevocationData) !=
-          GNUNET_DISK_fn_write (filename,
-                                rd,
-                                sizeof (struct RevocationData),
-                                GNUNET_DISK_PERM_USER_READ |
-                                GNUNET_DISK_PERM_USER_WRITE)) )
-      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
-                                "write",
-                                filename);
-    if (perform)
-    {
-      perform_revocation (rd);
-    }
-    else
-    {
-      FPRINTF (stderr, "%s", "\n");
-      FPRINTF (stderr,
-               _("Revocation certificate for `%s' stored in `%s'\n"),
-               revoke_ego,
-               filename);
-      GNUNET_SCHEDULER_shutdown ();
-    }
+    /* display progress estimate */
+    FPRINTF (stderr,
+             " - @ %3u%% (estimate)\n",
+             (unsigned int) (rd->pow * 100 / (1LLU << matching_bits)));
+    return;
+  }
+  pow_search = NULL;
+  if (perform)
+  {
+    perform_revocation (rd);
+  }
+  else
+  {
+    FPRINTF (stderr, "%s", "\n");
+    FPRINTF (stderr,
+             _("Revocation certificate for `%s' stored in `%s'\n"),
+             revoke_ego,
+             filename);
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+/**
+ * Start the proof-of-work calculation, using all CPUs.
+ *
+ * @param rd revocation data to complete, freed on shutdown
+ */
+static void
+calculate_pow (struct RevocationData *rd)
+{
+  pow_search = GNUNET_REVOCATION_pow_start (&rd->key,
+                                            rd->pow,
+                                            (unsigned int) matching_bits,
+                                            POW_CHECKPOINT_FREQUENCY,
+                                            &calculate_pow_cb,
+                                            rd);
+  if (NULL == pow_search)
+  {
+    FPRINTF (stderr,
+             "%s",
+             _("Failed to start calculating proof of work\n"));
+    GNUNET_free (rd);
+    GNUNET_SCHEDULER_shutdown ();
     return;
   }
-  pow_task = GNUNET_SCHEDULER_add_now (&calculate_pow,
-				       rd);
+  GNUNET_SCHEDULER_add_shutdown (&calculate_pow_shutdown,
+				 rd);
 }
 
 
@@ -401,10 +418,7 @@ ego_callback (void *cls,
   FPRINTF (stderr,
            "%s",
            _("Revocation certificate not ready, calculating proof of work\n"));
-  pow_task = GNUNET_SCHEDULER_add_now (&calculate_pow,
-				       rd);
-  GNUNET_SCHEDULER_add_shutdown (&calculate_pow_shutdown,
-				 rd);
+  calculate_pow (rd);
 }
 
 
@@ -502,10 +516,7 @@ run (void *cls,
       struct RevocationData *cp = GNUNET_new (struct RevocationData);
 
       *cp = rd;
-      pow_task = GNUNET_SCHEDULER_add_now (&calculate_pow,
-					   cp);
-      GNUNET_SCHEDULER_add_shutdown (&calculate_pow_shutdown,
-				     cp);
+      calculate_pow (cp);
       return;
     }
     perform_revocation (&rd);
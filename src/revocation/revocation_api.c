@@ -27,7 +27,11 @@
 #include "gnunet_signatures.h"
 #include "gnunet_protocols.h"
 #include "revocation.h"
-#include <gcrypt.h>
+
+/**
+ * Salt for the proof-of-work hash.
+ */
+#define POW_SALT "gnunet-revocation-proof-of-work"
 
 
 /**
@@ -327,47 +331,6 @@ GNUNET_REVOCATION_revoke_cancel (struct GNUNET_REVOCATION_Handle *h)
 }
 
 
-/**
- * Calculate the 'proof-of-work' hash (an expensive hash).
- *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
- */
-static void
-pow_hash (const void *buf,
-	  size_t buf_len,
-	  struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-		gcry_kdf_derive (buf, buf_len,
-				 GCRY_KDF_SCRYPT,
-				 1 /* subalgo */,
-				 "gnunet-revocation-proof-of-work",
-				 strlen ("gnunet-revocation-proof-of-work"),
-				 2 /* iterations; keep cost of individual op small */,
-				 sizeof (struct GNUNET_HashCode), result));
-}
-
-
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
-{
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while ((0 == GNUNET_CRYPTO_hash_get_bit (hash, hash_count)))
-    hash_count++;
-  return hash_count;
-}
-
-
 /**
  * Check if the given proof-of-work value
  * would be acceptable for revoking the given key.
@@ -382,16 +345,45 @@ GNUNET_REVOCATION_check_pow (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
 			     uint64_t pow,
 			     unsigned int matching_bits)
 {
-  char buf[sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey) +
-           sizeof (pow)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-
-  GNUNET_memcpy (buf, &pow, sizeof (pow));
-  GNUNET_memcpy (&buf[sizeof (pow)], key,
-          sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey));
-  pow_hash (buf, sizeof (buf), &result);
-  return (count_leading_zeroes (&result) >=
-          matching_bits) ? GNUNET_YES : GNUNET_NO;
+  return GNUNET_CRYPTO_pow_check (POW_SALT,
+                                  key,
+                                  sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey),
+                                  pow,
+                                  matching_bits);
+}
+
+
+/**
+ * Start searching for a proof-of-work for revoking the given key,
+ * using one thread per CPU.  Stop the search with
+ * #GNUNET_CRYPTO_pow_search_cancel().
+ *
+ * @param key key to revoke
+ * @param start first proof-of-work value to try
+ * @param matching_bits how many bits must match (configuration)
+ * @param checkpoint_freq how often to report progress to @a cb
+ * @param cb function to call with progress and the result
+ * @param cb_cls closure for @a cb
+ * @return NULL on error
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_REVOCATION_pow_start (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
+                             uint64_t start,
+                             unsigned int matching_bits,
+                             struct GNUNET_TIME_Relative checkpoint_freq,
+                             GNUNET_CRYPTO_PowCallback cb,
+                             void *cb_cls)
+{
+  return GNUNET_CRYPTO_pow_search_start (POW_SALT,
+                                         key,
+                                         sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey),
+                                         start,
+                                         matching_bits,
+                                         0 /* one per CPU */,
+                                         GNUNET_TIME_UNIT_ZERO,
+                                         checkpoint_freq,
+                                         cb,
+                                         cb_cls);
 }
 
 
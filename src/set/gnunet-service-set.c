@@ -238,194 +238,28 @@ listener_destroy (struct Listener *listener)
 
 
 /**
- * Context for the #garbage_collect_cb().
- */
-struct GarbageContext
-{
-
-  /**
-   * Map for which we are garbage collecting removed elements.
-   */
-  struct GNUNET_CONTAINER_MultiHashMap *map;
-
-  /**
-   * Lowest generation for which an operation is still pending.
-   */
-  unsigned int min_op_generation;
-
-  /**
-   * Largest generation for which an operation is still pending.
-   */
-  unsigned int max_op_generation;
-
-};
-
-
-/**
- * Function invoked to check if an element can be removed from
- * the set's history because it is no longer needed.
+ * Called for each element that is not in an element snapshot
+ * anymore.  Frees the element once no snapshot refers to it.
  *
- * @param cls the `struct GarbageContext *`
- * @param key key of the element in the map
+ * @param cls the `struct SetContent *` of the element
  * @param value the `struct ElementEntry *`
- * @return #GNUNET_OK (continue to iterate)
- */
-static int
-garbage_collect_cb (void *cls,
-                    const struct GNUNET_HashCode *key,
-                    void *value)
-{
-  //struct GarbageContext *gc = cls;
-  //struct ElementEntry *ee = value;
-
-  //if (GNUNET_YES != ee->removed)
-  //  return GNUNET_OK;
-  //if ( (gc->max_op_generation < ee->generation_added) ||
-  //     (ee->generation_removed > gc->min_op_generation) )
-  //{
-  //  GNUNET_assert (GNUNET_YES ==
-  //                 GNUNET_CONTAINER_multihashmap_remove (gc->map,
-  //                                                       key,
-  //                                                       ee));
-  //  GNUNET_free (ee);
-  //}
-  return GNUNET_OK;
-}
-
-
-/**
- * Collect and destroy elements that are not needed anymore, because
- * their lifetime (as determined by their generation) does not overlap
- * with any active set operation.
- *
- * @param set set to garbage collect
  */
 static void
-collect_generation_garbage (struct Set *set)
-{
-  struct Operation *op;
-  struct GarbageContext gc;
-
-  gc.min_op_generation = UINT_MAX;
-  gc.max_op_generation = 0;
-  for (op = set->ops_head; NULL != op; op = op->next)
-  {
-    gc.min_op_generation = GNUNET_MIN (gc.min_op_generation,
-                                       op->generation_created);
-    gc.max_op_generation = GNUNET_MAX (gc.max_op_generation,
-                                       op->generation_created);
-  }
-  gc.map = set->content->elements;
-  GNUNET_CONTAINER_multihashmap_iterate (set->content->elements,
-                                         &garbage_collect_cb,
-                                         &gc);
-}
-
-
-static int
-is_excluded_generation (unsigned int generation,
-                        struct GenerationRange *excluded,
-                        unsigned int excluded_size)
+release_element (void *cls,
+                 void *value)
 {
-  unsigned int i;
-
-  for (i = 0; i < excluded_size; i++)
-  {
-    if ( (generation >= excluded[i].start) && (generation < excluded[i].end) )
-      return GNUNET_YES;
-  }
-
-  return GNUNET_NO;
-}
-
-
-static int
-is_element_of_generation (struct ElementEntry *ee,
-                          unsigned int query_generation,
-                          struct GenerationRange *excluded,
-                          unsigned int excluded_size)
-{
-  struct MutationEvent *mut;
-  int is_present;
-  unsigned int i;
-
-  GNUNET_assert (NULL != ee->mutations);
-
-  if (GNUNET_YES == is_excluded_generation (query_generation, excluded, excluded_size))
-  {
-    GNUNET_break (0);
-    return GNUNET_NO;
-  }
-
-  is_present = GNUNET_NO;
-
-  /* Could be made faster with binary search, but lists
-     are small, so why bother. */
-  for (i = 0; i < ee->mutations_size; i++)
-  {
-    mut = &ee->mutations[i];
-
-    if (mut->generation > query_generation)
-    {
-      /* The mutation doesn't apply to our generation
-         anymore.  We can'b break here, since mutations aren't
-         sorted by generation. */
-      continue;
-    }
-
-    if (GNUNET_YES == is_excluded_generation (mut->generation, excluded, excluded_size))
-    {
-      /* The generation is excluded (because it belongs to another
-         fork via a lazy copy) and thus mutations aren't considered
-         for membership testing. */
-      continue;
-    }
-
-    /* This would be an inconsistency in how we manage mutations. */
-    if ( (GNUNET_YES == is_present) && (GNUNET_YES == mut->added) )
-      GNUNET_assert (0);
-
-    /* Likewise. */
-    if ( (GNUNET_NO == is_present) && (GNUNET_NO == mut->added) )
-      GNUNET_assert (0);
-
-    is_present = mut->added;
-  }
-
-  return is_present;
-}
-
-
-int
-_GSS_is_element_of_set (struct ElementEntry *ee,
-                        struct Set *set)
-{
-  return is_element_of_generation (ee,
-                                   set->current_generation,
-                                   set->excluded_generations,
-                                   set->excluded_generations_size);
-}
-
-
-static int
-is_element_of_iteration (struct ElementEntry *ee,
-                         struct Set *set)
-{
-  return is_element_of_generation (ee,
-                                   set->iter_generation,
-                                   set->excluded_generations,
-                                   set->excluded_generations_size);
-}
-
+  struct SetContent *content = cls;
+  struct ElementEntry *ee = value;
 
-int
-_GSS_is_element_of_operation (struct ElementEntry *ee,
-                              struct Operation *op)
-{
-  return is_element_of_generation (ee,
-                                   op->generation_created,
-                                   op->spec->set->excluded_generations,
-                                   op->spec->set->excluded_generations_size);
+  GNUNET_assert (0 < ee->refcount);
+  ee->refcount--;
+  if (0 != ee->refcount)
+    return;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (content->elements,
+                                                       &ee->element_hash,
+                                                       ee));
+  GNUNET_free (ee);
 }
 
 
@@ -433,14 +267,13 @@ _GSS_is_element_of_operation (struct ElementEntry *ee,
  * Destroy the given operation.  Call the implementation-specific
  * cancel function of the operation.  Disconnects from the remote
  * peer.  Does not disconnect the client, as there may be multiple
- * operations per set.
+ * operations per set.  Elements only referenced by the operation's
+ * snapshot are freed.
  *
  * @param op operation to destroy
- * @param gc #GNUNET_YES to perform garbage collection on the set
  */
 void
-_GSS_operation_destroy (struct Operation *op,
-                        int gc)
+_GSS_operation_destroy (struct Operation *op)
 {
   struct Set *set;
   struct GNUNET_CADET_Channel *channel;
@@ -458,6 +291,10 @@ _GSS_operation_destroy (struct Operation *op,
                                op);
   op->vt->cancel (op);
   op->vt = NULL;
+  hamt_release (op->elements,
+                &release_element,
+                set->content);
+  op->elements = NULL;
   if (NULL != op->spec)
   {
     if (NULL != op->spec->context_msg)
@@ -473,8 +310,6 @@ _GSS_operation_destroy (struct Operation *op,
     op->channel = NULL;
     GNUNET_CADET_channel_destroy (channel);
   }
-  if (GNUNET_YES == gc)
-    collect_generation_garbage (set);
   /* We rely on the channel end handler to free 'op'. When 'op->channel' was NULL,
    * there was a channel end handler that will free 'op' on the call stack. */
 }
@@ -495,8 +330,6 @@ destroy_elements_iterator (void *cls,
 {
   struct ElementEntry *ee = value;
 
-  GNUNET_free_non_null (ee->mutations);
-
   GNUNET_free (ee);
   return GNUNET_YES;
 }
@@ -524,41 +357,35 @@ set_destroy (struct Set *set)
   }
   GNUNET_assert (NULL != set->state);
   while (NULL != set->ops_head)
-    _GSS_operation_destroy (set->ops_head, GNUNET_NO);
+    _GSS_operation_destroy (set->ops_head);
   set->vt->destroy_set (set->state);
   set->state = NULL;
   if (NULL != set->iter)
   {
-    GNUNET_CONTAINER_multihashmap_iterator_destroy (set->iter);
+    hamt_iterator_destroy (set->iter);
     set->iter = NULL;
+    hamt_release (set->iter_elements,
+                  &release_element,
+                  set->content);
+    set->iter_elements = NULL;
     set->iteration_id++;
   }
+  hamt_release (set->elements,
+                &release_element,
+                set->content);
+  set->elements = NULL;
   {
     struct SetContent *content;
-    struct PendingMutation *pm;
-    struct PendingMutation *pm_current;
 
     content = set->content;
-
-    // discard any pending mutations that reference this set
-    pm = content->pending_mutations_head;
-    while (NULL != pm)
-    {
-      pm_current = pm;
-      pm = pm->next;
-      if (pm_current-> set == set)
-        GNUNET_CONTAINER_DLL_remove (content->pending_mutations_head,
-                                     content->pending_mutations_tail,
-                                     pm_current);
-
-    }
-
     set->content = NULL;
     GNUNET_assert (0 != content->refcount);
     content->refcount -= 1;
     if (0 == content->refcount)
     {
       GNUNET_assert (NULL != content->elements);
+      /* all snapshots are gone, so should be the elements */
+      GNUNET_break (0 == GNUNET_CONTAINER_multihashmap_size (content->elements));
       GNUNET_CONTAINER_multihashmap_iterate (content->elements,
                                              &destroy_elements_iterator,
                                              NULL);
@@ -567,8 +394,6 @@ set_destroy (struct Set *set)
       GNUNET_free (content);
     }
   }
-  GNUNET_free_non_null (set->excluded_generations);
-  set->excluded_generations = NULL;
   GNUNET_CONTAINER_DLL_remove (sets_head,
                                sets_tail,
                                set);
@@ -776,6 +601,7 @@ handle_incoming_msg (struct Operation *op,
                                          UINT32_MAX);
   spec->peer = op->peer;
   spec->remote_element_count = ntohl (msg->element_count);
+  spec->rateless = ntohl (msg->rateless);
   op->spec = spec;
 
   listener = op->listener;
@@ -797,6 +623,7 @@ execute_add (struct Set *set,
   struct GNUNET_SET_Element el;
   struct ElementEntry *ee;
   struct GNUNET_HashCode hash;
+  struct HamtNode *elements;
 
   GNUNET_assert (GNUNET_MESSAGE_TYPE_SET_ADD == ntohs (m->type));
 
@@ -806,9 +633,19 @@ execute_add (struct Set *set,
   el.element_type = ntohs (msg->element_type);
   GNUNET_SET_element_hash (&el, &hash);
 
+  if (NULL != hamt_get (set->elements,
+                        &hash))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Client inserted element %s of size %u twice (ignored)\n",
+                GNUNET_h2s (&hash),
+                el.size);
+
+    /* same element inserted twice */
+    return;
+  }
   ee = GNUNET_CONTAINER_multihashmap_get (set->content->elements,
                                           &hash);
-
   if (NULL == ee)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -823,8 +660,7 @@ execute_add (struct Set *set,
     ee->element.data = &ee[1];
     ee->element.element_type = el.element_type;
     ee->remote = GNUNET_NO;
-    ee->mutations = NULL;
-    ee->mutations_size = 0;
+    ee->refcount = 0;
     ee->element_hash = hash;
     GNUNET_break (GNUNET_YES ==
                   GNUNET_CONTAINER_multihashmap_put (set->content->elements,
@@ -832,27 +668,14 @@ execute_add (struct Set *set,
                                                      ee,
                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
   }
-  else if (GNUNET_YES == _GSS_is_element_of_set (ee, set))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Client inserted element %s of size %u twice (ignored)\n",
-                GNUNET_h2s (&hash),
-                el.size);
-
-    /* same element inserted twice */
-    return;
-  }
-
-  {
-    struct MutationEvent mut = {
-      .generation = set->current_generation,
-      .added = GNUNET_YES
-    };
-    GNUNET_array_append (ee->mutations,
-                         ee->mutations_size,
-                         mut);
-  }
-
+  ee->refcount++;
+  elements = hamt_put (set->elements,
+                       &ee->element_hash,
+                       ee);
+  hamt_release (set->elements,
+                &release_element,
+                set->content);
+  set->elements = elements;
   set->vt->add (set->state, ee);
 }
 
@@ -865,6 +688,7 @@ execute_remove (struct Set *set,
   struct GNUNET_SET_Element el;
   struct ElementEntry *ee;
   struct GNUNET_HashCode hash;
+  struct HamtNode *elements;
 
   GNUNET_assert (GNUNET_MESSAGE_TYPE_SET_REMOVE == ntohs (m->type));
 
@@ -873,40 +697,28 @@ execute_remove (struct Set *set,
   el.data = &msg[1];
   el.element_type = ntohs (msg->element_type);
   GNUNET_SET_element_hash (&el, &hash);
-  ee = GNUNET_CONTAINER_multihashmap_get (set->content->elements,
-                                          &hash);
+  ee = hamt_get (set->elements,
+                 &hash);
   if (NULL == ee)
   {
-    /* Client tried to remove non-existing element. */
+    /* Client tried to remove non-existing element,
+       or removed it twice. */
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Client removes non-existing element of size %u\n",
                 el.size);
     return;
   }
-  if (GNUNET_NO == _GSS_is_element_of_set (ee, set))
-  {
-    /* Client tried to remove element twice */
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Client removed element of size %u twice (ignored)\n",
-                el.size);
-    return;
-  }
-  else
-  {
-    struct MutationEvent mut = {
-      .generation = set->current_generation,
-      .added = GNUNET_NO
-    };
-
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Client removes element of size %u\n",
-                el.size);
-
-    GNUNET_array_append (ee->mutations,
-                         ee->mutations_size,
-                         mut);
-  }
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Client removes element of size %u\n",
+              el.size);
   set->vt->remove (set->state, ee);
+  /* may free @a ee, unless an operation or copy still has it */
+  elements = hamt_remove (set->elements,
+                          &hash);
+  hamt_release (set->elements,
+                &release_element,
+                set->content);
+  set->elements = elements;
 }
 
 
@@ -952,52 +764,26 @@ send_client_element (struct Set *set)
   struct GNUNET_SET_IterResponseMessage *msg;
 
   GNUNET_assert (NULL != set->iter);
-
-again:
-
-  ret = GNUNET_CONTAINER_multihashmap_iterator_next (set->iter,
-                                                     NULL,
-                                                     (const void **) &ee);
+  ret = hamt_iterator_next (set->iter,
+                            NULL,
+                            (const void **) &ee);
   if (GNUNET_NO == ret)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Iteration on %p done.\n",
                 (void *) set);
     ev = GNUNET_MQ_msg_header (GNUNET_MESSAGE_TYPE_SET_ITER_DONE);
-    GNUNET_CONTAINER_multihashmap_iterator_destroy (set->iter);
+    hamt_iterator_destroy (set->iter);
     set->iter = NULL;
+    hamt_release (set->iter_elements,
+                  &release_element,
+                  set->content);
+    set->iter_elements = NULL;
     set->iteration_id++;
-
-    GNUNET_assert (set->content->iterator_count > 0);
-    set->content->iterator_count -= 1;
-
-    if (0 == set->content->iterator_count)
-    {
-      while (NULL != set->content->pending_mutations_head)
-      {
-        struct PendingMutation *pm;
-
-        pm = set->content->pending_mutations_head;
-        GNUNET_CONTAINER_DLL_remove (set->content->pending_mutations_head,
-                                     set->content->pending_mutations_tail,
-                                     pm);
-        GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                    "Executing pending mutation on %p.\n",
-                    (void *) pm->set);
-        execute_mutation (pm->set, pm->mutation_message);
-        GNUNET_free (pm->mutation_message);
-        GNUNET_free (pm);
-      }
-    }
-
   }
   else
   {
     GNUNET_assert (NULL != ee);
-
-    if (GNUNET_NO == is_element_of_iteration (ee, set))
-      goto again;
-
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Sending iteration element on %p.\n",
                 (void *) set);
@@ -1046,14 +832,13 @@ handle_client_iterate (void *cls,
     return;
   }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Iterating set %p in gen %u with %u content elements\n",
+              "Iterating set %p with %u elements\n",
               (void *) set,
-              set->current_generation,
-              GNUNET_CONTAINER_multihashmap_size (set->content->elements));
+              hamt_size (set->elements));
   GNUNET_SERVICE_client_continue (client);
-  set->content->iterator_count += 1;
-  set->iter = GNUNET_CONTAINER_multihashmap_iterator_create (set->content->elements);
-  set->iter_generation = set->current_generation;
+  /* iterate over a snapshot, so mutations can go on meanwhile */
+  set->iter_elements = hamt_ref (set->elements);
+  set->iter = hamt_iterator_create (set->iter_elements);
   send_client_element (set);
 }
 
@@ -1386,6 +1171,14 @@ handle_client_listen (void *cls,
                            GNUNET_MESSAGE_TYPE_SET_UNION_P2P_FULL_ELEMENT,
                            struct GNUNET_MessageHeader,
                            NULL),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF,
+                           struct GNUNET_MessageHeader,
+                           NULL),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP,
+                           struct GNUNET_MessageHeader,
+                           NULL),
     GNUNET_MQ_hd_var_size (p2p_message,
                            GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_ELEMENT_INFO,
                            struct GNUNET_MessageHeader,
@@ -1398,6 +1191,14 @@ handle_client_listen (void *cls,
                            GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_DONE,
                            struct GNUNET_MessageHeader,
                            NULL),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS,
+                           struct GNUNET_MessageHeader,
+                           NULL),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP,
+                           struct GNUNET_MessageHeader,
+                           NULL),
     GNUNET_MQ_handler_end ()
   };
   struct Listener *listener;
@@ -1519,58 +1320,10 @@ handle_client_mutation (void *cls,
   }
 
   GNUNET_SERVICE_client_continue (client);
-
-  if (0 != set->content->iterator_count)
-  {
-    struct PendingMutation *pm;
-
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Scheduling mutation on set\n");
-
-    pm = GNUNET_new (struct PendingMutation);
-    pm->mutation_message = GNUNET_copy_message (m);
-    pm->set = set;
-    GNUNET_CONTAINER_DLL_insert_tail (set->content->pending_mutations_head,
-                                      set->content->pending_mutations_tail,
-                                      pm);
-    return;
-  }
   execute_mutation (set, m);
 }
 
 
-/**
- * Advance the current generation of a set,
- * adding exclusion ranges if necessary.
- *
- * @param set the set where we want to advance the generation
- */
-static void
-advance_generation (struct Set *set)
-{
-  struct GenerationRange r;
-
-  if (set->current_generation == set->content->latest_generation)
-  {
-    set->content->latest_generation += 1;
-    set->current_generation += 1;
-    return;
-  }
-
-  GNUNET_assert (set->current_generation < set->content->latest_generation);
-
-  r.start = set->current_generation + 1;
-  r.end = set->content->latest_generation + 1;
-
-  set->content->latest_generation = r.end;
-  set->current_generation = r.end;
-
-  GNUNET_array_append (set->excluded_generations,
-                       set->excluded_generations_size,
-                       r);
-}
-
-
 /**
  * Called when a client wants to initiate a set operation with another
  * peer.  Initiates the CADET connection to the listener and sends the
@@ -1649,6 +1402,14 @@ handle_client_evaluate (void *cls,
                            GNUNET_MESSAGE_TYPE_SET_UNION_P2P_FULL_ELEMENT,
                            struct GNUNET_MessageHeader,
                            op),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF,
+                           struct GNUNET_MessageHeader,
+                           op),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP,
+                           struct GNUNET_MessageHeader,
+                           op),
     GNUNET_MQ_hd_var_size (p2p_message,
                            GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_ELEMENT_INFO,
                            struct GNUNET_MessageHeader,
@@ -1661,6 +1422,14 @@ handle_client_evaluate (void *cls,
                            GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_DONE,
                            struct GNUNET_MessageHeader,
                            op),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS,
+                           struct GNUNET_MessageHeader,
+                           op),
+    GNUNET_MQ_hd_var_size (p2p_message,
+                           GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP,
+                           struct GNUNET_MessageHeader,
+                           op),
     GNUNET_MQ_handler_end ()
   };
   struct Set *set;
@@ -1684,13 +1453,10 @@ handle_client_evaluate (void *cls,
   spec->set = set;
   spec->result_mode = ntohl (msg->result_mode);
   spec->client_request_id = ntohl (msg->request_id);
+  spec->rateless = ntohl (msg->rateless);
   context = GNUNET_MQ_extract_nested_mh (msg);
   op->spec = spec;
-
-  // Advance generation values, so that
-  // mutations won't interfer with the running operation.
-  op->generation_created = set->current_generation;
-  advance_generation (set);
+  op->elements = hamt_ref (set->elements);
 
   op->vt = set->vt;
   GNUNET_CONTAINER_DLL_insert (set->ops_head,
@@ -1752,8 +1518,12 @@ handle_client_iter_ack (void *cls,
   }
   else
   {
-    GNUNET_CONTAINER_multihashmap_iterator_destroy (set->iter);
+    hamt_iterator_destroy (set->iter);
     set->iter = NULL;
+    hamt_release (set->iter_elements,
+                  &release_element,
+                  set->content);
+    set->iter_elements = NULL;
     set->iteration_id++;
   }
 }
@@ -1883,15 +1653,9 @@ handle_client_copy_lazy_connect (void *cls,
   set->state = set->vt->copy_state (cr->source_set);
   set->content = cr->source_set->content;
   set->content->refcount += 1;
-
-  set->current_generation = cr->source_set->current_generation;
-  set->excluded_generations_size = cr->source_set->excluded_generations_size;
-  set->excluded_generations = GNUNET_memdup (cr->source_set->excluded_generations,
-                                             set->excluded_generations_size * sizeof (struct GenerationRange));
-
-  /* Advance the generation of the new set, so that mutations to the
-     of the cloned set and the source set are independent. */
-  advance_generation (set);
+  /* Mutations replace the root of the element HAMT, so sharing
+     it keeps the copy and the source set independent. */
+  set->elements = hamt_ref (cr->source_set->elements);
 
 
   set->client = client;
@@ -1956,8 +1720,7 @@ handle_client_cancel (void *cls,
   }
   else
   {
-    _GSS_operation_destroy (op,
-                            GNUNET_YES);
+    _GSS_operation_destroy (op);
   }
   GNUNET_SERVICE_client_continue (client);
 }
@@ -2020,11 +1783,7 @@ handle_client_accept (void *cls,
                                op);
   op->spec->client_request_id = ntohl (msg->request_id);
   op->spec->result_mode = ntohl (msg->result_mode);
-
-  // Advance generation values, so that
-  // mutations won't interfer with the running operation.
-  op->generation_created = set->current_generation;
-  advance_generation (set);
+  op->elements = hamt_ref (set->elements);
 
   op->vt = set->vt;
   op->vt->accept (op);
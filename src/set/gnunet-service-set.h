@@ -34,6 +34,7 @@
 #include "gnunet_cadet_service.h"
 #include "gnunet_set_service.h"
 #include "set.h"
+#include "hamt.h"
 
 
 /**
@@ -119,6 +120,12 @@ struct OperationSpecification
    * When are elements sent to the client, and which elements are sent?
    */
   enum GNUNET_SET_ResultMode result_mode;
+
+  /**
+   * For union: #GNUNET_YES if the difference is reconciled
+   * with a rateless IBF instead of strata estimator and IBFs.
+   */
+  int rateless;
 };
 
 
@@ -270,28 +277,6 @@ struct SetVT
 };
 
 
-/**
- * MutationEvent gives information about changes
- * to an element (removal / addition) in a set content.
- */
-struct MutationEvent
-{
-  /**
-   * First generation affected by this mutation event.
-   *
-   * If @a generation is 0, this mutation event is a list
-   * sentinel element.
-   */
-  unsigned int generation;
-
-  /**
-   * If @a added is #GNUNET_YES, then this is a
-   * `remove` event, otherwise it is an `add` event.
-   */
-  int added;
-};
-
-
 /**
  * Information about an element element in the set.  All elements are
  * stored in a hash-table from their hash-code to their `struct
@@ -313,20 +298,11 @@ struct ElementEntry
   struct GNUNET_HashCode element_hash;
 
   /**
-   * If @a mutations is not NULL, it contains
-   * a list of mutations, ordered by increasing generation.
-   * The list is terminated by a sentinel event with `generation`
-   * set to 0.
-   *
-   * If @a mutations is NULL, then this element exists in all generations
-   * of the respective set content this element belongs to.
+   * Number of leaves of element snapshots (see `struct Set`) that
+   * refer to this element.  Once this drops to zero, the element is
+   * not part of any set or operation anymore and is freed.
    */
-  struct MutationEvent *mutations;
-
-  /**
-   * Number of elements in the array @a mutations.
-   */
-  unsigned int mutations_size;
+  unsigned int refcount;
 
   /**
    * #GNUNET_YES if the element is a remote element, and does not belong
@@ -416,10 +392,12 @@ struct Operation
   int is_incoming;
 
   /**
-   * Generation in which the operation handle
-   * was created.
+   * Snapshot of the set's elements, taken when the operation was
+   * created, so that mutations won't interfere with the running
+   * operation.  NULL for an empty set or if the operation is not
+   * yet associated with a set.
    */
-  unsigned int generation_created;
+  struct HamtNode *elements;
 
   /**
    * Incremented whenever (during shutdown) some component still
@@ -432,8 +410,8 @@ struct Operation
 
 /**
  * SetContent stores the actual set elements,
- * which may be shared by multiple generations derived
- * from one set.
+ * which may be shared by multiple sets derived
+ * from one set by lazy copies.
  */
 struct SetContent
 {
@@ -443,60 +421,11 @@ struct SetContent
   unsigned int refcount;
 
   /**
-   * Maps `struct GNUNET_HashCode *` to `struct ElementEntry *`.
+   * Maps `struct GNUNET_HashCode *` to `struct ElementEntry *`,
+   * for all elements in any snapshot of the sets sharing
+   * this content.
    */
   struct GNUNET_CONTAINER_MultiHashMap *elements;
-
-  unsigned int latest_generation;
-
-  /**
-   * Mutations requested by the client that we're
-   * unable to execute right now because we're iterating
-   * over the underlying hash map of elements.
-   */
-  struct PendingMutation *pending_mutations_head;
-
-  /**
-   * Mutations requested by the client that we're
-   * unable to execute right now because we're iterating
-   * over the underlying hash map of elements.
-   */
-  struct PendingMutation *pending_mutations_tail;
-
-  /**
-   * Number of concurrently active iterators.
-   */
-  int iterator_count;
-};
-
-
-struct GenerationRange
-{
-  /**
-   * First generation that is excluded.
-   */
-  unsigned int start;
-
-  /**
-   * Generation after the last excluded generation.
-   */
-  unsigned int end;
-};
-
-
-struct PendingMutation
-{
-  struct PendingMutation *prev;
-  struct PendingMutation *next;
-
-  struct Set *set;
-
-  /**
-   * Message that describes the desired mutation.
-   * May only be a #GNUNET_MESSAGE_TYPE_SET_ADD or
-   * #GNUNET_MESSAGE_TYPE_SET_REMOVE.
-   */
-  struct GNUNET_MessageHeader *mutation_message;
 };
 
 
@@ -545,33 +474,31 @@ struct Set
    * Current state of iterating elements for the client.
    * NULL if we are not currently iterating.
    */
-  struct GNUNET_CONTAINER_MultiHashMapIterator *iter;
-
-  /**
-   * Evaluate operations are held in a linked list.
-   */
-  struct Operation *ops_head;
+  struct HamtIterator *iter;
 
   /**
-   * Evaluate operations are held in a linked list.
+   * Snapshot of the elements we are iterating over.
    */
-  struct Operation *ops_tail;
+  struct HamtNode *iter_elements;
 
   /**
-   * Current generation, that is, number of previously executed
-   * operations and lazy copies on the underlying set content.
+   * Elements currently in the set, a persistent HAMT mapping
+   * element hashes to `struct ElementEntry *`.  Mutations replace
+   * the root, so lazy copies and operations can share the elements
+   * by just keeping a reference to the root at the time they were
+   * created.
    */
-  unsigned int current_generation;
+  struct HamtNode *elements;
 
   /**
-   * List of generations we have to exclude, due to lazy copies.
+   * Evaluate operations are held in a linked list.
    */
-  struct GenerationRange *excluded_generations;
+  struct Operation *ops_head;
 
   /**
-   * Number of elements in array @a excluded_generations.
+   * Evaluate operations are held in a linked list.
    */
-  unsigned int excluded_generations_size;
+  struct Operation *ops_tail;
 
   /**
    * Type of operation supported for this set
@@ -584,11 +511,6 @@ struct Set
    */
   uint16_t iteration_id;
 
-  /**
-   * Generation we're currently iteration over.
-   */
-  unsigned int iter_generation;
-
   /**
    * Content, possibly shared by multiple sets,
    * and thus reference counted.
@@ -604,14 +526,13 @@ extern struct GNUNET_STATISTICS_Handle *_GSS_statistics;
  * Destroy the given operation.  Call the implementation-specific
  * cancel function of the operation.  Disconnects from the remote
  * peer.  Does not disconnect the client, as there may be multiple
- * operations per set.
+ * operations per set.  Elements only referenced by the operation's
+ * snapshot are freed.
  *
  * @param op operation to destroy
- * @param gc #GNUNET_YES to perform garbage collection on the set
  */
 void
-_GSS_operation_destroy (struct Operation *op,
-                        int gc);
+_GSS_operation_destroy (struct Operation *op);
 
 
 /**
@@ -632,13 +553,4 @@ const struct SetVT *
 _GSS_intersection_vt (void);
 
 
-int
-_GSS_is_element_of_set (struct ElementEntry *ee,
-                        struct Set *set);
-
-int
-_GSS_is_element_of_operation (struct ElementEntry *ee,
-                              struct Operation *op);
-
-
 #endif
@@ -25,12 +25,42 @@
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
+#include "gnunet_statistics_service.h"
 #include "gnunet-service-set.h"
 #include "gnunet_block_lib.h"
 #include "gnunet-service-set_protocol.h"
 #include <gcrypt.h>
 
 
+/**
+ * If the other peer has at least this many times more elements than
+ * we do, we send it the keys of our elements instead of a Bloom
+ * filter.  The other peer can then compute the intersection exactly,
+ * so the operation finishes after a single exchange.
+ */
+#define KEYS_MIN_RATIO 4
+
+/**
+ * If the set sizes are similar and we have at most this many
+ * elements, we send our keys in sorted order and the other peer
+ * intersects them with its own sorted keys in a single merge pass.
+ * Larger similar-sized sets are reduced with Bloom filters.
+ */
+#define SORTED_MAX_ELEMENTS (1 << 16)
+
+/**
+ * Maximum number of keys we send or accept in a key list.  The
+ * receiver allocates memory for all of them up front, so larger
+ * sets are always reduced with Bloom filters.
+ */
+#define KEYS_MAX_ELEMENTS (1 << 20)
+
+/**
+ * Maximum size of the payload of a message with keys or a bitmap.
+ */
+#define MAX_PAYLOAD_SIZE (60 * 1024)
+
+
 /**
  * Current phase we are in for a intersection operation.
  */
@@ -54,6 +84,13 @@ enum IntersectionOperationPhase
    */
   PHASE_BF_EXCHANGE,
 
+  /**
+   * Instead of Bloom filters, the peer with fewer elements sends its
+   * keys and the other peer answers with a bitmap of the keys that
+   * are in the intersection.
+   */
+  PHASE_KEYS_EXCHANGE,
+
   /**
    * The protocol is over.  Results may still have to be sent to the
    * client.
@@ -63,6 +100,47 @@ enum IntersectionOperationPhase
 };
 
 
+/**
+ * How the peer with fewer elements decided to reduce the sets.
+ */
+enum IntersectionMode
+{
+  /**
+   * Exchange Bloom filters until both sets are equal.
+   */
+  MODE_BLOOMFILTER,
+
+  /**
+   * Send the keys of the smaller set, the other peer looks
+   * up its elements among them.
+   */
+  MODE_KEYS,
+
+  /**
+   * Send the keys of the smaller set in sorted order, the other
+   * peer merges them with its own sorted keys.
+   */
+  MODE_SORTED
+};
+
+
+/**
+ * Key of an element, used instead of Bloom filters.
+ */
+struct IntersectionKey
+{
+  /**
+   * First 64 bits of the element hash, mingled with the salt.
+   */
+  uint64_t key;
+
+  /**
+   * The element.
+   */
+  struct ElementEntry *ee;
+};
+
+
 /**
  * State of an evaluate operation with another peer.
  */
@@ -105,6 +183,49 @@ struct OperationState
    */
   char *bf_data;
 
+  /**
+   * Keys of our elements.  If we sent our keys, in the order we
+   * sent them.  If we receive sorted keys, sorted for the merge.
+   */
+  struct IntersectionKey *keys;
+
+  /**
+   * Keys received from the other peer in #MODE_KEYS.
+   */
+  uint64_t *remote_keys;
+
+  /**
+   * If we receive keys, bitmap of the received keys that
+   * are in our set.  NULL if we sent our keys.
+   */
+  char *key_bitmap;
+
+  /**
+   * Number of entries in @e keys.
+   */
+  uint32_t keys_length;
+
+  /**
+   * Number of keys we received, or number of bits of the
+   * bitmap we received if we sent our keys.
+   */
+  uint32_t keys_received;
+
+  /**
+   * Position of the merge in @e keys in #MODE_SORTED.
+   */
+  uint32_t merge_pos;
+
+  /**
+   * Last key we received in #MODE_SORTED, to check the order.
+   */
+  uint64_t last_key;
+
+  /**
+   * How we reduce the sets.
+   */
+  enum IntersectionMode mode;
+
   /**
    * XOR of the keys of all of the elements (remaining) in my set.
    * Always updated when elements are added or removed to
@@ -152,15 +273,15 @@ struct OperationState
   enum IntersectionOperationPhase phase;
 
   /**
-   * Generation in which the operation handle
-   * was created.
+   * Did we send the client that we are done?
    */
-  unsigned int generation_created;
+  int client_done_sent;
 
   /**
-   * Did we send the client that we are done?
+   * #GNUNET_YES if the other peer told us its element count in the
+   * operation request, so its keys must come with the same count.
    */
-  int client_done_sent;
+  int remote_count_announced;
 };
 
 
@@ -240,15 +361,6 @@ filtered_map_initialization (void *cls,
               GNUNET_h2s (&ee->element_hash),
               ee->element.size);
 
-  if (GNUNET_NO == _GSS_is_element_of_operation (ee, op))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Reduced initialization, not starting with %s:%u (wrong generation)\n",
-                GNUNET_h2s (&ee->element_hash),
-                ee->element.size);
-    return GNUNET_YES; /* element not valid in our operation's generation */
-  }
-
   /* Test if element is in other peer's bloomfilter */
   GNUNET_BLOCK_mingle_hash (&ee->element_hash,
                             op->state->salt,
@@ -400,8 +512,7 @@ fail_intersection_operation (struct Operation *op)
   msg->element_type = htons (0);
   GNUNET_MQ_send (op->spec->set->client_mq,
                   ev);
-  _GSS_operation_destroy (op,
-                          GNUNET_YES);
+  _GSS_operation_destroy (op);
 }
 
 
@@ -465,6 +576,10 @@ send_bloomfilter (struct Operation *op)
     msg->bits_per_element = htonl (bf_elementbits);
     msg->sender_mutator = htonl (op->state->salt);
     msg->element_xor_hash = op->state->my_xor;
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# bytes of Bloom filters sent",
+                              ntohs (msg->header.size),
+                              GNUNET_NO);
     GNUNET_MQ_send (op->mq, ev);
   }
   else
@@ -492,6 +607,10 @@ send_bloomfilter (struct Operation *op)
       msg->bits_per_element = htonl (bf_elementbits);
       msg->sender_mutator = htonl (op->state->salt);
       msg->element_xor_hash = op->state->my_xor;
+      GNUNET_STATISTICS_update (_GSS_statistics,
+                                "# bytes of Bloom filters sent",
+                                ntohs (msg->header.size),
+                                GNUNET_NO);
       GNUNET_MQ_send (op->mq, ev);
     }
     GNUNET_free (bf_data);
@@ -521,8 +640,7 @@ send_client_done_and_destroy (void *cls)
   rm->element_type = htons (0);
   GNUNET_MQ_send (op->spec->set->client_mq,
                   ev);
-  _GSS_operation_destroy (op,
-                          GNUNET_YES);
+  _GSS_operation_destroy (op);
 }
 
 
@@ -617,7 +735,7 @@ process_bf (struct Operation *op)
               op->state->phase,
               op->spec->remote_element_count,
               op->state->my_element_count,
-              GNUNET_CONTAINER_multihashmap_size (op->spec->set->content->elements));
+              hamt_size (op->elements));
   switch (op->state->phase)
   {
   case PHASE_INITIAL:
@@ -631,9 +749,9 @@ process_bf (struct Operation *op)
       = GNUNET_CONTAINER_multihashmap_create (op->spec->remote_element_count,
                                               GNUNET_YES);
     op->state->my_element_count = 0;
-    GNUNET_CONTAINER_multihashmap_iterate (op->spec->set->content->elements,
-                                           &filtered_map_initialization,
-                                           op);
+    hamt_iterate (op->elements,
+                  &filtered_map_initialization,
+                  op);
     break;
   case PHASE_BF_EXCHANGE:
     /* Update our set by reduction */
@@ -641,6 +759,7 @@ process_bf (struct Operation *op)
                                            &iterator_bf_reduce,
                                            op);
     break;
+  case PHASE_KEYS_EXCHANGE:
   case PHASE_FINISHED:
     GNUNET_break_op (0);
     fail_intersection_operation(op);
@@ -769,6 +888,575 @@ handle_p2p_bf (void *cls,
 }
 
 
+/**
+ * Decide how to reduce the sets, based on their sizes.
+ *
+ * @param my_count number of elements in our (smaller) set
+ * @param remote_count number of elements in the other peer's set
+ * @return the mode to use
+ */
+static enum IntersectionMode
+select_mode (uint32_t my_count,
+             uint32_t remote_count)
+{
+  if ( (my_count <= KEYS_MAX_ELEMENTS) &&
+       ((uint64_t) remote_count >= (uint64_t) KEYS_MIN_RATIO * my_count) )
+    return MODE_KEYS;
+  if (my_count <= SORTED_MAX_ELEMENTS)
+    return MODE_SORTED;
+  return MODE_BLOOMFILTER;
+}
+
+
+/**
+ * Compute the key of an element for a salt.  The key does not depend
+ * on the byte order of the host, as both peers must agree on it.
+ *
+ * @param ee the element
+ * @param salt salt to mingle the element hash with
+ * @return the key
+ */
+static uint64_t
+element_key (const struct ElementEntry *ee,
+             uint32_t salt)
+{
+  struct GNUNET_HashCode mutated_hash;
+  uint64_t key;
+
+  GNUNET_BLOCK_mingle_hash (&ee->element_hash,
+                            salt,
+                            &mutated_hash);
+  GNUNET_memcpy (&key,
+                 &mutated_hash,
+                 sizeof (key));
+  return GNUNET_ntohll (key);
+}
+
+
+/**
+ * Compare two keys, for sorting them with qsort().
+ *
+ * @param a pointer to the first `struct IntersectionKey`
+ * @param b pointer to the second `struct IntersectionKey`
+ * @return -1, 0 or 1
+ */
+static int
+cmp_keys (const void *a,
+          const void *b)
+{
+  const struct IntersectionKey *ka = a;
+  const struct IntersectionKey *kb = b;
+
+  if (ka->key < kb->key)
+    return -1;
+  if (ka->key > kb->key)
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Append the key of an element to the operation's key array.
+ *
+ * @param cls the `struct Operation *`
+ * @param key current key code
+ * @param value the `struct ElementEntry` to process
+ * @return #GNUNET_YES (we should continue to iterate)
+ */
+static int
+iterator_keys_create (void *cls,
+                      const struct GNUNET_HashCode *key,
+                      void *value)
+{
+  struct Operation *op = cls;
+  struct ElementEntry *ee = value;
+  struct IntersectionKey *ik;
+
+  ik = &op->state->keys[op->state->keys_length++];
+  ik->key = element_key (ee,
+                         op->state->salt);
+  ik->ee = ee;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Send the keys of all of our elements to the other peer.
+ *
+ * @param op intersection operation
+ */
+static void
+send_keys (struct Operation *op)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct IntersectionKeysMessage *msg;
+  uint64_t *wire_keys;
+  uint32_t max_keys;
+  uint32_t offset;
+  uint32_t chunk;
+  uint32_t i;
+
+  op->state->salt = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_NONCE,
+                                              UINT32_MAX);
+  op->state->keys
+    = GNUNET_new_array (GNUNET_CONTAINER_multihashmap_size (op->state->my_elements) + 1,
+                        struct IntersectionKey);
+  op->state->keys_length = 0;
+  GNUNET_CONTAINER_multihashmap_iterate (op->state->my_elements,
+                                         &iterator_keys_create,
+                                         op);
+  if (MODE_SORTED == op->state->mode)
+    qsort (op->state->keys,
+           op->state->keys_length,
+           sizeof (struct IntersectionKey),
+           &cmp_keys);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Sending %u keys (sorted: %d)\n",
+              (unsigned int) op->state->keys_length,
+              MODE_SORTED == op->state->mode);
+  max_keys = (MAX_PAYLOAD_SIZE - sizeof (struct IntersectionKeysMessage))
+    / sizeof (uint64_t);
+  offset = 0;
+  do
+  {
+    chunk = GNUNET_MIN (max_keys,
+                        op->state->keys_length - offset);
+    ev = GNUNET_MQ_msg_extra (msg,
+                              chunk * sizeof (uint64_t),
+                              GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS);
+    msg->sender_element_count = htonl (op->state->keys_length);
+    msg->sender_mutator = htonl (op->state->salt);
+    msg->offset = htonl (offset);
+    msg->sorted = htonl ((MODE_SORTED == op->state->mode) ? GNUNET_YES : GNUNET_NO);
+    msg->element_xor_hash = op->state->my_xor;
+    wire_keys = (uint64_t *) &msg[1];
+    for (i = 0; i < chunk; i++)
+      wire_keys[i] = GNUNET_htonll (op->state->keys[offset + i].key);
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# bytes of intersection keys sent",
+                              ntohs (msg->header.size),
+                              GNUNET_NO);
+    GNUNET_MQ_send (op->mq, ev);
+    offset += chunk;
+  } while (offset < op->state->keys_length);
+}
+
+
+/**
+ * Mark the received key with index @a idx as being in our set, and
+ * add the respective element to the intersection.
+ *
+ * @param op intersection operation
+ * @param idx index of the key in the other peer's key list
+ * @param ee our element with that key
+ */
+static void
+key_matched (struct Operation *op,
+             uint32_t idx,
+             struct ElementEntry *ee)
+{
+  if (GNUNET_OK !=
+      GNUNET_CONTAINER_multihashmap_put (op->state->my_elements,
+                                         &ee->element_hash,
+                                         ee,
+                                         GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY))
+    return; /* key collision, the element is already in */
+  op->state->key_bitmap[idx / 8] |= (1 << (idx % 8));
+  op->state->my_element_count++;
+  GNUNET_CRYPTO_hash_xor (&op->state->my_xor,
+                          &ee->element_hash,
+                          &op->state->my_xor);
+}
+
+
+/**
+ * Closure for #lookup_remote_key().
+ */
+struct LookupContext
+{
+  /**
+   * The operation.
+   */
+  struct Operation *op;
+
+  /**
+   * Index of the received keys by their lower 32 bits.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap32 *index;
+
+  /**
+   * Our element we look up.
+   */
+  struct ElementEntry *ee;
+
+  /**
+   * Key of @e ee.
+   */
+  uint64_t key;
+};
+
+
+/**
+ * Check if a received key with the same lower 32 bits is
+ * the key of the element we look up.
+ *
+ * @param cls the `struct LookupContext`
+ * @param key lower 32 bits of the key
+ * @param value pointer into the operation's remote keys
+ * @return #GNUNET_YES (we should continue to iterate)
+ */
+static int
+lookup_remote_key (void *cls,
+                   uint32_t key,
+                   void *value)
+{
+  struct LookupContext *lc = cls;
+  const uint64_t *remote_key = value;
+
+  if (*remote_key != lc->key)
+    return GNUNET_YES;
+  key_matched (lc->op,
+               remote_key - lc->op->state->remote_keys,
+               lc->ee);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Look up one of our elements among the keys we received, and add it
+ * to the intersection if we got its key.  Otherwise, the element is
+ * removed.
+ *
+ * @param cls the `struct LookupContext`
+ * @param key current key code
+ * @param value the `struct ElementEntry` to process
+ * @return #GNUNET_YES (we should continue to iterate)
+ */
+static int
+iterator_keys_lookup (void *cls,
+                      const struct GNUNET_HashCode *key,
+                      void *value)
+{
+  struct LookupContext *lc = cls;
+  struct ElementEntry *ee = value;
+
+  lc->ee = ee;
+  lc->key = element_key (ee,
+                         lc->op->state->salt);
+  GNUNET_CONTAINER_multihashmap32_get_multiple (lc->index,
+                                                (uint32_t) lc->key,
+                                                &lookup_remote_key,
+                                                lc);
+  if (GNUNET_NO ==
+      GNUNET_CONTAINER_multihashmap_contains (lc->op->state->my_elements,
+                                              &ee->element_hash))
+    send_client_removed_element (lc->op,
+                                 &ee->element);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Intersect the keys of the other peer with our set, after we
+ * received all of them in #MODE_KEYS.
+ *
+ * @param op intersection operation
+ */
+static void
+intersect_remote_keys (struct Operation *op)
+{
+  struct LookupContext lc;
+  uint32_t i;
+
+  lc.op = op;
+  lc.index = GNUNET_CONTAINER_multihashmap32_create (op->state->keys_received + 1);
+  for (i = 0; i < op->state->keys_received; i++)
+    GNUNET_CONTAINER_multihashmap32_put (lc.index,
+                                         (uint32_t) op->state->remote_keys[i],
+                                         &op->state->remote_keys[i],
+                                         GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+  hamt_iterate (op->elements,
+                &iterator_keys_lookup,
+                &lc);
+  GNUNET_CONTAINER_multihashmap32_destroy (lc.index);
+}
+
+
+/**
+ * Prepare to receive the keys of the other peer.  In #MODE_SORTED,
+ * we sort our own keys for the merge.
+ *
+ * @param op intersection operation
+ * @param msg the first keys message
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the element
+ *         count of the other peer is not acceptable
+ */
+static int
+begin_keys_receiving (struct Operation *op,
+                      const struct IntersectionKeysMessage *msg)
+{
+  uint32_t count;
+
+  count = ntohl (msg->sender_element_count);
+  /* The peer with fewer elements sends its keys, and we allocate
+     space for all of them right away, so check the count first. */
+  if ( ( (GNUNET_YES == op->state->remote_count_announced) &&
+         (count != op->spec->remote_element_count) ) ||
+       (count > op->state->my_element_count) ||
+       (count > KEYS_MAX_ELEMENTS) )
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  op->spec->remote_element_count = count;
+  op->state->salt = ntohl (msg->sender_mutator);
+  op->state->other_xor = msg->element_xor_hash;
+  op->state->mode = (GNUNET_YES == ntohl (msg->sorted)) ? MODE_SORTED : MODE_KEYS;
+  op->state->phase = PHASE_KEYS_EXCHANGE;
+  if (NULL != op->state->my_elements)
+    GNUNET_CONTAINER_multihashmap_destroy (op->state->my_elements);
+  op->state->my_elements
+    = GNUNET_CONTAINER_multihashmap_create (op->spec->remote_element_count + 1,
+                                            GNUNET_YES);
+  op->state->my_element_count = 0;
+  memset (&op->state->my_xor,
+          0,
+          sizeof (struct GNUNET_HashCode));
+  op->state->key_bitmap = GNUNET_malloc (op->spec->remote_element_count / 8 + 1);
+  op->state->keys_received = 0;
+  if (MODE_KEYS == op->state->mode)
+  {
+    op->state->remote_keys = GNUNET_new_array (op->spec->remote_element_count + 1,
+                                               uint64_t);
+    return GNUNET_OK;
+  }
+  count = hamt_size (op->elements);
+  op->state->keys = GNUNET_new_array (count + 1,
+                                      struct IntersectionKey);
+  op->state->keys_length = 0;
+  hamt_iterate (op->elements,
+                &iterator_keys_create,
+                op);
+  qsort (op->state->keys,
+         op->state->keys_length,
+         sizeof (struct IntersectionKey),
+         &cmp_keys);
+  op->state->merge_pos = 0;
+  return GNUNET_OK;
+}
+
+
+/**
+ * We received all keys and know the intersection.  Tell the
+ * other peer which of its keys are in it, and that we are done.
+ *
+ * @param op intersection operation
+ */
+static void
+finish_keys_receiving (struct Operation *op)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct IntersectionKeyBitmapMessage *msg;
+  uint32_t bitmap_size;
+  uint32_t offset;
+  uint32_t chunk;
+  uint32_t i;
+
+  if (MODE_KEYS == op->state->mode)
+  {
+    intersect_remote_keys (op);
+  }
+  else
+  {
+    for (i = 0; i < op->state->keys_length; i++)
+      if (GNUNET_NO ==
+          GNUNET_CONTAINER_multihashmap_contains (op->state->my_elements,
+                                                  &op->state->keys[i].ee->element_hash))
+        send_client_removed_element (op,
+                                     &op->state->keys[i].ee->element);
+  }
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Received all %u keys, %u elements in intersection\n",
+              (unsigned int) op->state->keys_received,
+              (unsigned int) op->state->my_element_count);
+  bitmap_size = (op->state->keys_received + 7) / 8;
+  offset = 0;
+  do
+  {
+    chunk = GNUNET_MIN (MAX_PAYLOAD_SIZE - sizeof (struct IntersectionKeyBitmapMessage),
+                        bitmap_size - offset);
+    ev = GNUNET_MQ_msg_extra (msg,
+                              chunk,
+                              GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP);
+    msg->offset = htonl (offset * 8);
+    GNUNET_memcpy (&msg[1],
+                   &op->state->key_bitmap[offset],
+                   chunk);
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# bytes of intersection key bitmaps sent",
+                              ntohs (msg->header.size),
+                              GNUNET_NO);
+    GNUNET_MQ_send (op->mq, ev);
+    offset += chunk;
+  } while (offset < bitmap_size);
+  GNUNET_free_non_null (op->state->remote_keys);
+  op->state->remote_keys = NULL;
+  GNUNET_free_non_null (op->state->keys);
+  op->state->keys = NULL;
+  op->state->keys_length = 0;
+  GNUNET_free (op->state->key_bitmap);
+  op->state->key_bitmap = NULL;
+  send_peer_done (op);
+}
+
+
+/**
+ * Handle the keys of the other peer's (smaller) set.
+ *
+ * @param cls the intersection operation
+ * @param mh the header of the message
+ */
+static void
+handle_p2p_keys (void *cls,
+                 const struct GNUNET_MessageHeader *mh)
+{
+  struct Operation *op = cls;
+  const struct IntersectionKeysMessage *msg;
+  const uint64_t *wire_keys;
+  uint16_t msize;
+  uint32_t num_keys;
+  uint32_t i;
+  uint64_t key;
+
+  msize = ntohs (mh->size);
+  if ( (msize < sizeof (struct IntersectionKeysMessage)) ||
+       (0 != (msize - sizeof (struct IntersectionKeysMessage)) % sizeof (uint64_t)) )
+  {
+    GNUNET_break_op (0);
+    fail_intersection_operation (op);
+    return;
+  }
+  msg = (const struct IntersectionKeysMessage *) mh;
+  num_keys = (msize - sizeof (struct IntersectionKeysMessage)) / sizeof (uint64_t);
+  if (PHASE_COUNT_SENT == op->state->phase)
+  {
+    if (GNUNET_OK !=
+        begin_keys_receiving (op,
+                              msg))
+    {
+      fail_intersection_operation (op);
+      return;
+    }
+  }
+  else if ( (PHASE_KEYS_EXCHANGE != op->state->phase) ||
+            (NULL == op->state->key_bitmap) )
+  {
+    GNUNET_break_op (0);
+    fail_intersection_operation (op);
+    return;
+  }
+  if ( (op->spec->remote_element_count != ntohl (msg->sender_element_count)) ||
+       (op->state->salt != ntohl (msg->sender_mutator)) ||
+       (op->state->keys_received != ntohl (msg->offset)) ||
+       ((MODE_SORTED == op->state->mode) != (GNUNET_YES == ntohl (msg->sorted))) ||
+       (num_keys > op->spec->remote_element_count - op->state->keys_received) )
+  {
+    GNUNET_break_op (0);
+    fail_intersection_operation (op);
+    return;
+  }
+  wire_keys = (const uint64_t *) &msg[1];
+  for (i = 0; i < num_keys; i++)
+  {
+    key = GNUNET_ntohll (wire_keys[i]);
+    if (MODE_KEYS == op->state->mode)
+    {
+      op->state->remote_keys[op->state->keys_received++] = key;
+      continue;
+    }
+    if ( (0 != op->state->keys_received) &&
+         (key <= op->state->last_key) )
+    {
+      /* keys must be strictly ascending for the merge */
+      GNUNET_break_op (0);
+      fail_intersection_operation (op);
+      return;
+    }
+    op->state->last_key = key;
+    while ( (op->state->merge_pos < op->state->keys_length) &&
+            (op->state->keys[op->state->merge_pos].key < key) )
+      op->state->merge_pos++;
+    if ( (op->state->merge_pos < op->state->keys_length) &&
+         (op->state->keys[op->state->merge_pos].key == key) )
+      key_matched (op,
+                   op->state->keys_received,
+                   op->state->keys[op->state->merge_pos].ee);
+    op->state->keys_received++;
+  }
+  if (op->state->keys_received == op->spec->remote_element_count)
+    finish_keys_receiving (op);
+}
+
+
+/**
+ * Handle the bitmap telling us which of our keys are in the
+ * other peer's set.
+ *
+ * @param cls the intersection operation
+ * @param mh the header of the message
+ */
+static void
+handle_p2p_key_bitmap (void *cls,
+                       const struct GNUNET_MessageHeader *mh)
+{
+  struct Operation *op = cls;
+  const struct IntersectionKeyBitmapMessage *msg;
+  const unsigned char *bitmap;
+  struct ElementEntry *ee;
+  uint32_t num_bits;
+  uint32_t i;
+
+  if ( (ntohs (mh->size) < sizeof (struct IntersectionKeyBitmapMessage)) ||
+       (PHASE_KEYS_EXCHANGE != op->state->phase) ||
+       (NULL != op->state->key_bitmap) )
+  {
+    GNUNET_break_op (0);
+    fail_intersection_operation (op);
+    return;
+  }
+  msg = (const struct IntersectionKeyBitmapMessage *) mh;
+  num_bits = 8 * (ntohs (mh->size) - sizeof (struct IntersectionKeyBitmapMessage));
+  if ( (ntohl (msg->offset) != op->state->keys_received) ||
+       (num_bits > op->state->keys_length - op->state->keys_received + 7) )
+  {
+    GNUNET_break_op (0);
+    fail_intersection_operation (op);
+    return;
+  }
+  num_bits = GNUNET_MIN (num_bits,
+                         op->state->keys_length - op->state->keys_received);
+  bitmap = (const unsigned char *) &msg[1];
+  for (i = 0; i < num_bits; i++)
+  {
+    if (0 != (bitmap[i / 8] & (1 << (i % 8))))
+      continue;
+    ee = op->state->keys[op->state->keys_received + i].ee;
+    GNUNET_break (0 < op->state->my_element_count);
+    op->state->my_element_count--;
+    GNUNET_CRYPTO_hash_xor (&op->state->my_xor,
+                            &ee->element_hash,
+                            &op->state->my_xor);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (op->state->my_elements,
+                                                         &ee->element_hash,
+                                                         ee));
+    send_client_removed_element (op,
+                                 &ee->element);
+  }
+  op->state->keys_received += num_bits;
+}
+
+
 /**
  * Fills the "my_elements" hashmap with the initial set of
  * (non-deleted) elements from the set of the specification.
@@ -786,8 +1474,6 @@ initialize_map_unfiltered (void *cls,
   struct ElementEntry *ee = value;
   struct Operation *op = cls;
 
-  if (GNUNET_NO == _GSS_is_element_of_operation (ee, op))
-    return GNUNET_YES; /* element not live in operation's generation */
   GNUNET_CRYPTO_hash_xor (&op->state->my_xor,
                           &ee->element_hash,
                           &op->state->my_xor);
@@ -835,14 +1521,43 @@ send_element_count (struct Operation *op)
 static void
 begin_bf_exchange (struct Operation *op)
 {
-  op->state->phase = PHASE_BF_EXCHANGE;
+  if (NULL != op->state->my_elements)
+    GNUNET_CONTAINER_multihashmap_destroy (op->state->my_elements);
   op->state->my_elements
     = GNUNET_CONTAINER_multihashmap_create (op->state->my_element_count,
                                             GNUNET_YES);
-  GNUNET_CONTAINER_multihashmap_iterate (op->spec->set->content->elements,
-                                         &initialize_map_unfiltered,
-                                         op);
-  send_bloomfilter (op);
+  hamt_iterate (op->elements,
+                &initialize_map_unfiltered,
+                op);
+  op->state->mode = select_mode (op->state->my_element_count,
+                                 op->spec->remote_element_count);
+  switch (op->state->mode)
+  {
+  case MODE_BLOOMFILTER:
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# intersections using Bloom filters",
+                              1,
+                              GNUNET_NO);
+    op->state->phase = PHASE_BF_EXCHANGE;
+    send_bloomfilter (op);
+    break;
+  case MODE_KEYS:
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# intersections using key lists",
+                              1,
+                              GNUNET_NO);
+    op->state->phase = PHASE_KEYS_EXCHANGE;
+    send_keys (op);
+    break;
+  case MODE_SORTED:
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# intersections using sorted keys",
+                              1,
+                              GNUNET_NO);
+    op->state->phase = PHASE_KEYS_EXCHANGE;
+    send_keys (op);
+    break;
+  }
 }
 
 
@@ -962,7 +1677,10 @@ handle_p2p_done (void *cls,
   struct Operation *op = cls;
   const struct IntersectionDoneMessage *idm;
 
-  if (PHASE_BF_EXCHANGE != op->state->phase)
+  if ( (PHASE_BF_EXCHANGE != op->state->phase) &&
+       ( (PHASE_KEYS_EXCHANGE != op->state->phase) ||
+         (NULL != op->state->key_bitmap) ||
+         (op->state->keys_received != op->state->keys_length) ) )
   {
     /* wrong phase to conclude? FIXME: Or should we allow this
        if the other peer has _initially_ already an empty set? */
@@ -1062,6 +1780,7 @@ intersection_accept (struct Operation *op)
               "Accepting set intersection operation\n");
   op->state = GNUNET_new (struct OperationState);
   op->state->phase = PHASE_INITIAL;
+  op->state->remote_count_announced = GNUNET_YES;
   op->state->my_element_count
     = op->spec->set->state->current_set_element_count;
   op->state->my_elements
@@ -1111,6 +1830,12 @@ intersection_handle_p2p_message (struct Operation *op,
   case GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_DONE:
     handle_p2p_done (op, mh);
     break;
+  case GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS:
+    handle_p2p_keys (op, mh);
+    break;
+  case GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP:
+    handle_p2p_key_bitmap (op, mh);
+    break;
   default:
     /* something wrong with cadet's message handlers? */
     GNUNET_assert (0);
@@ -1168,6 +1893,9 @@ intersection_op_cancel (struct Operation *op)
     GNUNET_CONTAINER_multihashmap_destroy (op->state->my_elements);
     op->state->my_elements = NULL;
   }
+  GNUNET_free_non_null (op->state->keys);
+  GNUNET_free_non_null (op->state->remote_keys);
+  GNUNET_free_non_null (op->state->key_bitmap);
   GNUNET_free (op->state);
   op->state = NULL;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -49,6 +49,12 @@ struct OperationRequestMessage
    */
   uint32_t element_count GNUNET_PACKED;
 
+  /**
+   * For Union: #GNUNET_YES if the receiver should stream
+   * rateless IBF symbols instead of sending a strata estimator.
+   */
+  uint32_t rateless GNUNET_PACKED;
+
   /**
    * Application-specific identifier of the request.
    */
@@ -101,6 +107,51 @@ struct IBFMessage
 };
 
 
+/**
+ * Message containing coded symbols of a rateless IBF.
+ *
+ * The symbols of the (infinite) stream are sent in order,
+ * until the receiver tells us to stop.
+ */
+struct RIBFMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Index of the first symbol in this message.
+   */
+  uint32_t offset GNUNET_PACKED;
+
+  /**
+   * Salt used when hashing elements for the symbols.
+   */
+  uint32_t salt GNUNET_PACKED;
+
+  /* rest: symbols */
+};
+
+
+/**
+ * Sent by the receiver of a rateless IBF once it
+ * decoded the difference.
+ */
+struct RIBFStopMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Number of symbols that were needed to decode the difference.
+   */
+  uint32_t symbols_used GNUNET_PACKED;
+};
+
+
 struct InquiryMessage
 {
   /**
@@ -208,6 +259,74 @@ struct IntersectionDoneMessage
   struct GNUNET_HashCode element_xor_hash;
 };
 
+/**
+ * Keys of the elements of the smaller set, sent by the peer with fewer
+ * elements instead of a Bloom filter.  The keys are the first 64 bits
+ * of the element hashes mingled with @e sender_mutator, in network
+ * byte order.  If the keys are sorted, they must be in ascending
+ * order over all parts.
+ */
+struct IntersectionKeysMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEYS
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Number of elements the sender has in the set, which is
+   * also the total number of keys sent.
+   */
+  uint32_t sender_element_count GNUNET_PACKED;
+
+  /**
+   * Mutator used for the keys.
+   */
+  uint32_t sender_mutator GNUNET_PACKED;
+
+  /**
+   * Index of the first key in this message.
+   */
+  uint32_t offset GNUNET_PACKED;
+
+  /**
+   * #GNUNET_YES if the keys are sorted, #GNUNET_NO if not.
+   */
+  uint32_t sorted GNUNET_PACKED;
+
+  /**
+   * XOR of all hashes over all elements in the sender's set.
+   */
+  struct GNUNET_HashCode element_xor_hash;
+
+  /**
+   * rest: the keys (uint64_t)
+   */
+};
+
+
+/**
+ * Reply to the keys of the smaller set.  Bit i is set if the
+ * key with index i is in the receiver's set.
+ */
+struct IntersectionKeyBitmapMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_KEY_BITMAP
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Index of the key the first bit in this message refers to,
+   * always a multiple of 8.
+   */
+  uint32_t offset GNUNET_PACKED;
+
+  /**
+   * rest: the bitmap
+   */
+};
+
 GNUNET_NETWORK_STRUCT_END
 
 #endif
@@ -28,6 +28,7 @@
 #include "gnunet_statistics_service.h"
 #include "gnunet-service-set.h"
 #include "ibf.h"
+#include "ribf.h"
 #include "gnunet-service-set_union_strata_estimator.h"
 #include "gnunet-service-set_protocol.h"
 #include <gcrypt.h>
@@ -69,6 +70,23 @@
  */
 #define IBF_ALPHA 4
 
+/**
+ * Number of rateless IBF symbols that can be transmitted in one message.
+ */
+#define MAX_RIBF_SYMBOLS_PER_MESSAGE ((1<<15) / RIBF_SYMBOL_SIZE)
+
+/**
+ * Number of rateless IBF symbols in the first message of the stream.
+ * Later messages get larger, up to #MAX_RIBF_SYMBOLS_PER_MESSAGE.
+ */
+#define RIBF_INITIAL_BATCH 16
+
+/**
+ * Maximum number of rateless IBF symbols we send or accept,
+ * same limit as for the size of fixed IBFs.
+ */
+#define MAX_RIBF_SYMBOLS (1 << MAX_IBF_ORDER)
+
 
 /**
  * Current phase we are in for a union operation.
@@ -131,6 +149,13 @@ enum UnionOperationPhase
    * that the local peer is missing.
    */
   PHASE_FULL_SENDING,
+
+  /**
+   * We sent the request message for a rateless operation, and expect
+   * the first symbols of the rateless IBF.  Once they arrive, we
+   * decode while receiving in #PHASE_INVENTORY_ACTIVE.
+   */
+  PHASE_EXPECT_RIBF,
 };
 
 
@@ -155,6 +180,28 @@ struct OperationState
    */
   struct InvertibleBloomFilter *local_ibf;
 
+  /**
+   * Encoder for the rateless IBF symbols we stream to the other peer,
+   * NULL if we are not (or no longer) streaming.
+   */
+  struct RIBF_Encoder *ribf_encoder;
+
+  /**
+   * Decoder for the rateless IBF symbols we receive, NULL
+   * if we are not decoding (anymore).
+   */
+  struct RIBF_Decoder *ribf_decoder;
+
+  /**
+   * Task to send the next message of rateless IBF symbols.
+   */
+  struct GNUNET_SCHEDULER_Task *ribf_send_task;
+
+  /**
+   * Number of symbols to put into the next rateless IBF message.
+   */
+  unsigned int ribf_batch_size;
+
   /**
    * Maps unsalted IBF-Keys to elements.
    * Used as a multihashmap, the keys being the lower 32bit of the IBF-Key.
@@ -329,6 +376,21 @@ union_op_cancel (struct Operation *op)
     strata_estimator_destroy (op->state->se);
     op->state->se = NULL;
   }
+  if (NULL != op->state->ribf_send_task)
+  {
+    GNUNET_SCHEDULER_cancel (op->state->ribf_send_task);
+    op->state->ribf_send_task = NULL;
+  }
+  if (NULL != op->state->ribf_encoder)
+  {
+    ribf_encoder_destroy (op->state->ribf_encoder);
+    op->state->ribf_encoder = NULL;
+  }
+  if (NULL != op->state->ribf_decoder)
+  {
+    ribf_decoder_destroy (op->state->ribf_decoder);
+    op->state->ribf_decoder = NULL;
+  }
   if (NULL != op->state->key_to_element)
   {
     GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
@@ -363,7 +425,7 @@ fail_union_operation (struct Operation *op)
   msg->request_id = htonl (op->spec->client_request_id);
   msg->element_type = htons (0);
   GNUNET_MQ_send (op->spec->set->client_mq, ev);
-  _GSS_operation_destroy (op, GNUNET_YES);
+  _GSS_operation_destroy (op);
 }
 
 
@@ -566,11 +628,6 @@ init_key_to_element_iterator (void *cls,
   struct Operation *op = cls;
   struct ElementEntry *ee = value;
 
-  /* make sure that the element belongs to the set at the time
-   * of creating the operation */
-  if (GNUNET_NO == _GSS_is_element_of_operation (ee, op))
-    return GNUNET_YES;
-
   GNUNET_assert (GNUNET_NO == ee->remote);
 
   op_register_element (op, ee, GNUNET_NO);
@@ -590,9 +647,11 @@ initialize_key_to_element (struct Operation *op)
   unsigned int len;
 
   GNUNET_assert (NULL == op->state->key_to_element);
-  len = GNUNET_CONTAINER_multihashmap_size (op->spec->set->content->elements);
+  len = hamt_size (op->elements);
   op->state->key_to_element = GNUNET_CONTAINER_multihashmap32_create (len + 1);
-  GNUNET_CONTAINER_multihashmap_iterate (op->spec->set->content->elements, init_key_to_element_iterator, op);
+  (void) hamt_iterate (op->elements,
+                       &init_key_to_element_iterator,
+                       op);
 }
 
 
@@ -626,6 +685,52 @@ prepare_ibf (struct Operation *op,
 }
 
 
+/**
+ * Insert a key into the rateless IBF encoder of an operation.
+ *
+ * @param cls the union operation
+ * @param key unused
+ * @param value the key entry to get the key from
+ * @return #GNUNET_YES (to continue iterating)
+ */
+static int
+prepare_ribf_encoder_iterator (void *cls,
+                               uint32_t key,
+                               void *value)
+{
+  struct Operation *op = cls;
+  struct KeyEntry *ke = value;
+  struct IBF_Key salted_key;
+
+  salt_key (&ke->ibf_key, op->state->salt_send, &salted_key);
+  ribf_encoder_insert (op->state->ribf_encoder, salted_key);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Insert a key into the rateless IBF decoder of an operation.
+ *
+ * @param cls the union operation
+ * @param key unused
+ * @param value the key entry to get the key from
+ * @return #GNUNET_YES (to continue iterating)
+ */
+static int
+prepare_ribf_decoder_iterator (void *cls,
+                               uint32_t key,
+                               void *value)
+{
+  struct Operation *op = cls;
+  struct KeyEntry *ke = value;
+  struct IBF_Key salted_key;
+
+  salt_key (&ke->ibf_key, op->state->salt_receive, &salted_key);
+  ribf_decoder_insert_local (op->state->ribf_decoder, salted_key);
+  return GNUNET_YES;
+}
+
+
 /**
  * Send an ibf of appropriate size.
  *
@@ -688,6 +793,10 @@ send_ibf (struct Operation *op,
          buckets_in_message,
          buckets_sent,
          1<<ibf_order);
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# bytes of IBF sent",
+                              ntohs (msg->header.size),
+                              GNUNET_NO);
     GNUNET_MQ_send (op->mq, ev);
   }
 
@@ -791,8 +900,8 @@ send_full_set (struct Operation *op)
 
   op->state->phase = PHASE_FULL_SENDING;
 
-  (void) GNUNET_CONTAINER_multihashmap_iterate (op->spec->set->content->elements,
-                                                &send_element_iterator, op);
+  (void) hamt_iterate (op->elements,
+                       &send_element_iterator, op);
   ev = GNUNET_MQ_msg_header (GNUNET_MESSAGE_TYPE_SET_UNION_P2P_FULL_DONE);
   GNUNET_MQ_send (op->mq, ev);
 }
@@ -857,6 +966,10 @@ handle_p2p_strata_estimator (void *cls,
     return GNUNET_SYSERR;
   }
   GNUNET_assert (NULL != op->state->se);
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# of union reconciliation round trips",
+                            1,
+                            GNUNET_NO);
   diff = strata_estimator_difference (remote_se,
                                       op->state->se);
   strata_estimator_destroy (remote_se);
@@ -867,12 +980,12 @@ handle_p2p_strata_estimator (void *cls,
        diff,
        1<<get_order_from_difference (diff));
 
-  if (diff > GNUNET_CONTAINER_multihashmap_size (op->spec->set->content->elements) / 2)
+  if (diff > hamt_size (op->elements) / 2)
   {
     LOG (GNUNET_ERROR_TYPE_INFO,
          "Sending full set (diff=%d, own set=%u)\n",
          diff,
-         GNUNET_CONTAINER_multihashmap_size (op->spec->set->content->elements));
+         hamt_size (op->elements));
     send_full_set (op);
   }
   else
@@ -951,6 +1064,36 @@ send_offers_for_key (struct Operation *op,
 }
 
 
+/**
+ * Ask the other peer for the hashes of the elements
+ * matching an IBF key.
+ *
+ * @param op union operation
+ * @param key salted IBF key we decoded
+ */
+static void
+send_inquiry (struct Operation *op,
+              struct IBF_Key key)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct InquiryMessage *msg;
+
+  /* It may be nice to merge multiple requests, but with CADET's corking it is not worth
+   * the effort additional complexity. */
+  ev = GNUNET_MQ_msg_extra (msg,
+                            sizeof (struct IBF_Key),
+                            GNUNET_MESSAGE_TYPE_SET_UNION_P2P_INQUIRY);
+  msg->salt = htonl (op->state->salt_receive);
+  GNUNET_memcpy (&msg[1],
+          &key,
+          sizeof (struct IBF_Key));
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "sending element inquiry for IBF key %lx\n",
+       (unsigned long) key.key_val);
+  GNUNET_MQ_send (op->mq, ev);
+}
+
+
 /**
  * Decode which elements are missing on each side, and
  * send the appropriate offers and inquiries.
@@ -1079,22 +1222,7 @@ decode_and_send (struct Operation *op)
     }
     else if (-1 == side)
     {
-      struct GNUNET_MQ_Envelope *ev;
-      struct InquiryMessage *msg;
-
-      /* It may be nice to merge multiple requests, but with CADET's corking it is not worth
-       * the effort additional complexity. */
-      ev = GNUNET_MQ_msg_extra (msg,
-                                sizeof (struct IBF_Key),
-                                GNUNET_MESSAGE_TYPE_SET_UNION_P2P_INQUIRY);
-      msg->salt = htonl (op->state->salt_receive);
-      GNUNET_memcpy (&msg[1],
-              &key,
-              sizeof (struct IBF_Key));
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "sending element inquiry for IBF key %lx\n",
-           (unsigned long) key.key_val);
-      GNUNET_MQ_send (op->mq, ev);
+      send_inquiry (op, key);
     }
     else
     {
@@ -1212,6 +1340,10 @@ handle_p2p_ibf (void *cls,
   {
     LOG (GNUNET_ERROR_TYPE_DEBUG,
          "received full ibf\n");
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# of union reconciliation round trips",
+                              1,
+                              GNUNET_NO);
     op->state->phase = PHASE_INVENTORY_ACTIVE;
     if (GNUNET_OK !=
         decode_and_send (op))
@@ -1226,6 +1358,323 @@ handle_p2p_ibf (void *cls,
 }
 
 
+/**
+ * Send the next message of rateless IBF symbols.
+ *
+ * @param cls the union operation
+ */
+static void
+send_ribf_symbols (void *cls);
+
+
+/**
+ * Called once a message of rateless IBF symbols was passed on by
+ * the message queue, so that we only produce symbols as fast as
+ * the channel takes them.
+ *
+ * @param cls the union operation
+ */
+static void
+ribf_sent_cb (void *cls)
+{
+  struct Operation *op = cls;
+
+  if ( (NULL == op->state) ||
+       (NULL == op->state->ribf_encoder) ||
+       (NULL != op->state->ribf_send_task) )
+    return;
+  op->state->ribf_send_task = GNUNET_SCHEDULER_add_now (&send_ribf_symbols,
+                                                        op);
+}
+
+
+static void
+send_ribf_symbols (void *cls)
+{
+  struct Operation *op = cls;
+  struct RIBF_Encoder *enc = op->state->ribf_encoder;
+  struct GNUNET_MQ_Envelope *ev;
+  struct RIBFMessage *msg;
+  struct RIBF_Symbol *symbols;
+  uint32_t offset;
+  uint32_t count;
+
+  op->state->ribf_send_task = NULL;
+  GNUNET_assert (NULL != enc);
+  offset = ribf_encoder_position (enc);
+  count = op->state->ribf_batch_size;
+  if (count > MAX_RIBF_SYMBOLS - offset)
+    count = MAX_RIBF_SYMBOLS - offset;
+  if (0 == count)
+  {
+    /* The other peer will fail once it sees that
+     * it cannot decode with what we sent. */
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "reached rateless IBF limit, stop sending symbols\n");
+    return;
+  }
+  symbols = GNUNET_new_array (count,
+                              struct RIBF_Symbol);
+  ribf_encoder_produce (enc,
+                        count,
+                        symbols);
+  ev = GNUNET_MQ_msg_extra (msg,
+                            count * RIBF_SYMBOL_SIZE,
+                            GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF);
+  msg->offset = htonl (offset);
+  msg->salt = htonl (op->state->salt_send);
+  ribf_write_symbols (symbols,
+                      count,
+                      &msg[1]);
+  GNUNET_free (symbols);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "sending rateless ibf symbols %u-%u\n",
+       offset,
+       offset + count - 1);
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# bytes of rateless IBF sent",
+                            ntohs (msg->header.size),
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# rateless IBF symbols sent",
+                            count,
+                            GNUNET_NO);
+  GNUNET_MQ_notify_sent (ev,
+                         &ribf_sent_cb,
+                         op);
+  GNUNET_MQ_send (op->mq, ev);
+  op->state->ribf_batch_size *= 2;
+  if (op->state->ribf_batch_size > MAX_RIBF_SYMBOLS_PER_MESSAGE)
+    op->state->ribf_batch_size = MAX_RIBF_SYMBOLS_PER_MESSAGE;
+}
+
+
+/**
+ * Start streaming rateless IBF symbols for the operation's
+ * elements to the other peer.  We stream until the other peer
+ * tells us to stop, so we are the passive side.
+ *
+ * @param op the union operation
+ */
+static void
+start_ribf_stream (struct Operation *op)
+{
+  GNUNET_assert (NULL == op->state->ribf_encoder);
+  op->state->ribf_encoder = ribf_encoder_create ();
+  GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
+                                           &prepare_ribf_encoder_iterator,
+                                           op);
+  op->state->ribf_batch_size = RIBF_INITIAL_BATCH;
+  op->state->phase = PHASE_INVENTORY_PASSIVE;
+  op->state->ribf_send_task = GNUNET_SCHEDULER_add_now (&send_ribf_symbols,
+                                                        op);
+}
+
+
+/**
+ * Peel what we can from the received rateless IBF symbols and send
+ * the appropriate offers and inquiries.  Once the whole difference is
+ * decoded, tell the other peer to stop streaming.
+ *
+ * @param op union operation
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on failure
+ */
+static int
+decode_ribf_and_send (struct Operation *op)
+{
+  struct RIBF_Decoder *dec = op->state->ribf_decoder;
+  struct GNUNET_MQ_Envelope *ev;
+  struct RIBFStopMessage *msg;
+  struct IBF_Key key;
+  int side;
+
+  GNUNET_assert (PHASE_INVENTORY_ACTIVE == op->state->phase);
+  while (GNUNET_YES == ribf_decoder_decode (dec, &side, &key))
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "decoded rateless ibf key %lx\n",
+         (unsigned long) key.key_val);
+    if (1 == side)
+    {
+      struct IBF_Key unsalted_key;
+
+      unsalt_key (&key, op->state->salt_receive, &unsalted_key);
+      send_offers_for_key (op, unsalted_key);
+    }
+    else if (-1 == side)
+    {
+      send_inquiry (op, key);
+    }
+    else
+    {
+      GNUNET_assert (0);
+    }
+  }
+  if (GNUNET_YES != ribf_decoder_is_complete (dec))
+  {
+    if (ribf_decoder_position (dec) < MAX_RIBF_SYMBOLS)
+      return GNUNET_OK;
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# of failed union operations (too large)",
+                              1,
+                              GNUNET_NO);
+    LOG (GNUNET_ERROR_TYPE_ERROR,
+         "set union failed: reached rateless ibf limit\n");
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "decoded rateless ibf with %u symbols, sending DONE\n",
+       ribf_decoder_position (dec));
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# rateless IBF symbols needed",
+                            ribf_decoder_position (dec),
+                            GNUNET_NO);
+  ev = GNUNET_MQ_msg (msg,
+                      GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP);
+  msg->symbols_used = htonl (ribf_decoder_position (dec));
+  GNUNET_MQ_send (op->mq, ev);
+  ribf_decoder_destroy (dec);
+  op->state->ribf_decoder = NULL;
+  /* As with fixed IBFs, we now wait until we get a DONE message back
+   * and then wait for our MQ to be flushed and all our
+   * demands be delivered. */
+  ev = GNUNET_MQ_msg_header (GNUNET_MESSAGE_TYPE_SET_UNION_P2P_DONE);
+  GNUNET_MQ_send (op->mq, ev);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Handle a message with rateless IBF symbols from a remote peer.
+ *
+ * @param cls the union operation
+ * @param mh the header of the message
+ * @return #GNUNET_SYSERR if the tunnel should be disconnected,
+ *         #GNUNET_OK otherwise
+ */
+static int
+handle_p2p_ribf (void *cls,
+                 const struct GNUNET_MessageHeader *mh)
+{
+  struct Operation *op = cls;
+  const struct RIBFMessage *msg;
+  struct RIBF_Symbol *symbols;
+  unsigned int num_symbols;
+  unsigned int i;
+
+  if ( (GNUNET_YES != op->spec->rateless) ||
+       (ntohs (mh->size) < sizeof (struct RIBFMessage)) )
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  msg = (const struct RIBFMessage *) mh;
+  if (PHASE_EXPECT_RIBF == op->state->phase)
+  {
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# of union reconciliation round trips",
+                              1,
+                              GNUNET_NO);
+    op->state->salt_receive = ntohl (msg->salt);
+    op->state->phase = PHASE_INVENTORY_ACTIVE;
+    /* our keys must be salted like the other peer's */
+    op->state->ribf_decoder = ribf_decoder_create ();
+    GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
+                                             &prepare_ribf_decoder_iterator,
+                                             op);
+  }
+  else if (NULL == op->state->ribf_decoder)
+  {
+    /* Symbols that were in flight while we told the
+     * other peer to stop. */
+    if ( (PHASE_INVENTORY_ACTIVE == op->state->phase) ||
+         (PHASE_FINISH_CLOSING == op->state->phase) ||
+         (PHASE_DONE == op->state->phase) )
+    {
+      GNUNET_STATISTICS_update (_GSS_statistics,
+                                "# rateless IBF symbols discarded",
+                                (ntohs (mh->size) - sizeof *msg) / RIBF_SYMBOL_SIZE,
+                                GNUNET_NO);
+      return GNUNET_OK;
+    }
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  num_symbols = (ntohs (mh->size) - sizeof *msg) / RIBF_SYMBOL_SIZE;
+  if ( (0 == num_symbols) ||
+       ((ntohs (mh->size) - sizeof *msg) != num_symbols * RIBF_SYMBOL_SIZE) ||
+       (ntohl (msg->salt) != op->state->salt_receive) ||
+       (ntohl (msg->offset) != ribf_decoder_position (op->state->ribf_decoder)) )
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  symbols = GNUNET_new_array (num_symbols,
+                              struct RIBF_Symbol);
+  ribf_read_symbols (&msg[1],
+                     num_symbols,
+                     symbols);
+  for (i = 0; i < num_symbols; i++)
+    ribf_decoder_add_symbol (op->state->ribf_decoder,
+                             &symbols[i]);
+  GNUNET_free (symbols);
+  return decode_ribf_and_send (op);
+}
+
+
+/**
+ * Handle the message of the remote peer that tells us
+ * to stop streaming rateless IBF symbols.
+ *
+ * @param cls the union operation
+ * @param mh the message
+ * @return #GNUNET_SYSERR if the tunnel should be disconnected,
+ *         #GNUNET_OK otherwise
+ */
+static int
+handle_p2p_ribf_stop (void *cls,
+                      const struct GNUNET_MessageHeader *mh)
+{
+  struct Operation *op = cls;
+  const struct RIBFStopMessage *msg;
+  uint32_t sent;
+
+  if ( (ntohs (mh->size) != sizeof (struct RIBFStopMessage)) ||
+       (NULL == op->state->ribf_encoder) ||
+       (PHASE_INVENTORY_PASSIVE != op->state->phase) )
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  msg = (const struct RIBFStopMessage *) mh;
+  sent = ribf_encoder_position (op->state->ribf_encoder);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "other peer decoded after %u of %u rateless ibf symbols\n",
+       ntohl (msg->symbols_used),
+       sent);
+  if (ntohl (msg->symbols_used) > sent)
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return GNUNET_SYSERR;
+  }
+  if (NULL != op->state->ribf_send_task)
+  {
+    GNUNET_SCHEDULER_cancel (op->state->ribf_send_task);
+    op->state->ribf_send_task = NULL;
+  }
+  ribf_encoder_destroy (op->state->ribf_encoder);
+  op->state->ribf_encoder = NULL;
+  /* we stay passive, the other peer now sends offers and inquiries */
+  return GNUNET_OK;
+}
+
+
 /**
  * Send a result message to the client indicating
  * that there is a new element.
@@ -1280,7 +1729,7 @@ send_done_and_destroy (void *cls)
   rm->element_type = htons (0);
   GNUNET_MQ_send (op->spec->set->client_mq, ev);
   /* Will also call the union-specific cancel function. */
-  _GSS_operation_destroy (op, GNUNET_YES);
+  _GSS_operation_destroy (op);
 }
 
 
@@ -1688,17 +2137,10 @@ handle_p2p_demand (void *cls,
        num_hashes > 0;
        hash++, num_hashes--)
   {
-    ee = GNUNET_CONTAINER_multihashmap_get (op->spec->set->content->elements, hash);
+    ee = hamt_get (op->elements, hash);
     if (NULL == ee)
     {
-      /* Demand for non-existing element. */
-      GNUNET_break_op (0);
-      fail_union_operation (op);
-      return;
-    }
-    if (GNUNET_NO == _GSS_is_element_of_operation (ee, op))
-    {
-      /* Probably confused lazily copied sets. */
+      /* Demand for element not in the operation's snapshot. */
       GNUNET_break_op (0);
       fail_union_operation (op);
       return;
@@ -1776,11 +2218,10 @@ handle_p2p_offer (void *cls,
     struct GNUNET_MessageHeader *demands;
     struct GNUNET_MQ_Envelope *ev;
 
-    ee = GNUNET_CONTAINER_multihashmap_get (op->spec->set->content->elements,
-                                            hash);
+    ee = hamt_get (op->elements,
+                   hash);
     if (NULL != ee)
-      if (GNUNET_YES == _GSS_is_element_of_operation (ee, op))
-        continue;
+      continue;
 
     if (GNUNET_YES ==
         GNUNET_CONTAINER_multihashmap_contains (op->state->demanded_hashes,
@@ -1878,11 +2319,19 @@ union_evaluate (struct Operation *op,
   GNUNET_assert (NULL == op->state);
   op->state = GNUNET_new (struct OperationState);
   op->state->demanded_hashes = GNUNET_CONTAINER_multihashmap_create (32, GNUNET_NO);
-  /* copy the current generation's strata estimator for this operation */
-  op->state->se = strata_estimator_dup (op->spec->set->state->se);
-  /* we started the operation, thus we have to send the operation request */
-  op->state->phase = PHASE_EXPECT_SE;
   op->state->salt_receive = op->state->salt_send = 42;
+  if (GNUNET_YES == op->spec->rateless)
+  {
+    /* the other peer streams symbols right away, no estimate needed */
+    op->state->phase = PHASE_EXPECT_RIBF;
+  }
+  else
+  {
+    /* copy the current generation's strata estimator for this operation */
+    op->state->se = strata_estimator_dup (op->spec->set->state->se);
+    /* we started the operation, thus we have to send the operation request */
+    op->state->phase = PHASE_EXPECT_SE;
+  }
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Initiating union operation evaluation\n");
   GNUNET_STATISTICS_update (_GSS_statistics,
@@ -1904,6 +2353,7 @@ union_evaluate (struct Operation *op,
     return;
   }
   msg->operation = htonl (GNUNET_SET_OPERATION_UNION);
+  msg->rateless = htonl (op->spec->rateless);
   GNUNET_MQ_send (op->mq,
                   ev);
 
@@ -1941,11 +2391,16 @@ union_accept (struct Operation *op)
                             GNUNET_NO);
 
   op->state = GNUNET_new (struct OperationState);
-  op->state->se = strata_estimator_dup (op->spec->set->state->se);
   op->state->demanded_hashes = GNUNET_CONTAINER_multihashmap_create (32, GNUNET_NO);
   op->state->salt_receive = op->state->salt_send = 42;
   initialize_key_to_element (op);
   /* kick off the operation */
+  if (GNUNET_YES == op->spec->rateless)
+  {
+    start_ribf_stream (op);
+    return;
+  }
+  op->state->se = strata_estimator_dup (op->spec->set->state->se);
   send_strata_estimator (op);
 }
 
@@ -2049,6 +2504,10 @@ union_handle_p2p_message (struct Operation *op,
       return handle_p2p_strata_estimator (op, mh, GNUNET_NO);
     case GNUNET_MESSAGE_TYPE_SET_UNION_P2P_SEC:
       return handle_p2p_strata_estimator (op, mh, GNUNET_YES);
+    case GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF:
+      return handle_p2p_ribf (op, mh);
+    case GNUNET_MESSAGE_TYPE_SET_UNION_P2P_RIBF_STOP:
+      return handle_p2p_ribf_stop (op, mh);
     case GNUNET_MESSAGE_TYPE_SET_P2P_ELEMENTS:
       handle_p2p_elements (op, mh);
       break;
@@ -2102,8 +2561,7 @@ union_peer_disconnect (struct Operation *op)
     LOG (GNUNET_ERROR_TYPE_WARNING,
          "other peer disconnected prematurely, phase %u\n",
          op->state->phase);
-    _GSS_operation_destroy (op,
-                            GNUNET_YES);
+    _GSS_operation_destroy (op);
     return;
   }
   // else: the session has already been concluded
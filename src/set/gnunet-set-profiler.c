@@ -38,6 +38,42 @@ static unsigned int num_c = 20;
 
 static char *op_str = "union";
 
+/**
+ * Operation to execute, parsed from @e op_str.
+ */
+static enum GNUNET_SET_OperationType op_type;
+
+/**
+ * Use the rateless IBF mode for the union.
+ */
+static int use_rateless;
+
+/**
+ * When did we start the operation?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * Number of lazy copies of the first set to create
+ * before starting the operation.
+ */
+static unsigned int num_copies;
+
+/**
+ * Lazy copies created so far.
+ */
+static struct GNUNET_SET_Handle **copies;
+
+/**
+ * Number of entries in @e copies.
+ */
+static unsigned int copies_length;
+
+/**
+ * When did we request the first lazy copy?
+ */
+static struct GNUNET_TIME_Absolute copy_start_time;
+
 const static struct GNUNET_CONFIGURATION_Handle *config;
 
 struct SetInfo
@@ -115,6 +151,12 @@ statistics_result (void *cls,
   {
     fprintf (statistics_file, "%s\t%s\t%lu\n", subsystem, name, (unsigned long) value);
   }
+  /* the numbers we want to compare between the IBF modes */
+  if ( (0 == strncmp (name, "# bytes of", strlen ("# bytes of"))) ||
+       (NULL != strstr (name, "round trips")) ||
+       (NULL != strstr (name, "rateless")) ||
+       (NULL != strstr (name, "intersections using")) )
+    printf ("%s: %lu\n", name, (unsigned long) value);
   return GNUNET_OK;
 }
 
@@ -130,26 +172,58 @@ statistics_done (void *cls,
 }
 
 
+static int
+map_count_iterator (void *cls,
+                    const struct GNUNET_HashCode *key,
+                    void *value)
+{
+  unsigned int *count = cls;
+
+  if (GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains (common_sent, key))
+    (*count)++;
+  return GNUNET_YES;
+}
+
+
 static void
 check_all_done (void)
 {
+  unsigned int common_received;
+
   if (info1.done == GNUNET_NO || info2.done == GNUNET_NO)
     return;
 
-  GNUNET_CONTAINER_multihashmap_iterate (info1.received, map_remove_iterator, info2.sent);
-  GNUNET_CONTAINER_multihashmap_iterate (info2.received, map_remove_iterator, info1.sent);
-
-  printf ("set a: %d missing elements\n", GNUNET_CONTAINER_multihashmap_size (info1.sent));
-  printf ("set b: %d missing elements\n", GNUNET_CONTAINER_multihashmap_size (info2.sent));
-
-  if (NULL == statistics_filename)
+  if (GNUNET_SET_OPERATION_INTERSECTION == op_type)
   {
-    GNUNET_SCHEDULER_shutdown ();
-    return;
+    /* the full result must be exactly the common elements */
+    common_received = 0;
+    GNUNET_CONTAINER_multihashmap_iterate (info1.received, map_count_iterator, &common_received);
+    printf ("set a: %d missing elements\n",
+            GNUNET_CONTAINER_multihashmap_size (common_sent) - common_received);
+    printf ("set a: %d spurious elements\n",
+            GNUNET_CONTAINER_multihashmap_size (info1.received) - common_received);
+    common_received = 0;
+    GNUNET_CONTAINER_multihashmap_iterate (info2.received, map_count_iterator, &common_received);
+    printf ("set b: %d missing elements\n",
+            GNUNET_CONTAINER_multihashmap_size (common_sent) - common_received);
+    printf ("set b: %d spurious elements\n",
+            GNUNET_CONTAINER_multihashmap_size (info2.received) - common_received);
   }
+  else
+  {
+    GNUNET_CONTAINER_multihashmap_iterate (info1.received, map_remove_iterator, info2.sent);
+    GNUNET_CONTAINER_multihashmap_iterate (info2.received, map_remove_iterator, info1.sent);
+
+    printf ("set a: %d missing elements\n", GNUNET_CONTAINER_multihashmap_size (info1.sent));
+    printf ("set b: %d missing elements\n", GNUNET_CONTAINER_multihashmap_size (info2.sent));
+  }
+  printf ("duration: %s\n",
+          GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (start_time),
+                                                  GNUNET_NO));
 
-  statistics_file = fopen (statistics_filename, "w");
-  GNUNET_STATISTICS_get (statistics, NULL, NULL,
+  if (NULL != statistics_filename)
+    statistics_file = fopen (statistics_filename, "w");
+  GNUNET_STATISTICS_get (statistics, "set", NULL,
                          &statistics_done,
                          &statistics_result, NULL);
 }
@@ -178,6 +252,9 @@ set_result_cb (void *cls,
       GNUNET_log (GNUNET_ERROR_TYPE_ERROR, "failure\n");
       GNUNET_SCHEDULER_shutdown ();
       return;
+    case GNUNET_SET_STATUS_OK:
+      /* element of the full intersection */
+      break;
     case GNUNET_SET_STATUS_ADD_LOCAL:
       GNUNET_log (GNUNET_ERROR_TYPE_INFO, "set %s: local element\n", info->id);
       break;
@@ -224,7 +301,10 @@ set_listen_cb (void *cls,
   GNUNET_assert (NULL == info2.oh);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "set listen cb called\n");
-  info2.oh = GNUNET_SET_accept (request, GNUNET_SET_RESULT_SYMMETRIC,
+  info2.oh = GNUNET_SET_accept (request,
+                                (GNUNET_SET_OPERATION_INTERSECTION == op_type)
+                                ? GNUNET_SET_RESULT_FULL
+                                : GNUNET_SET_RESULT_SYMMETRIC,
                                 (struct GNUNET_SET_Option[]) { 0 },
                                 set_result_cb, &info2);
   GNUNET_SET_commit (info2.oh, info2.set);
@@ -254,6 +334,8 @@ set_insert_iterator (void *cls,
 static void
 handle_shutdown (void *cls)
 {
+  unsigned int i;
+
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Shutting down set profiler\n");
   if (NULL != set_listener)
@@ -281,10 +363,74 @@ handle_shutdown (void *cls)
     GNUNET_SET_destroy (info2.set);
     info2.set = NULL;
   }
+  for (i = 0; i < copies_length; i++)
+    GNUNET_SET_destroy (copies[i]);
+  GNUNET_free_non_null (copies);
+  copies = NULL;
+  copies_length = 0;
   GNUNET_STATISTICS_destroy (statistics, GNUNET_NO);
 }
 
 
+/**
+ * Start the operation between the two sets.
+ */
+static void
+start_operation (void)
+{
+  set_listener = GNUNET_SET_listen (config, op_type,
+                                    &app_id, set_listen_cb, NULL);
+
+  {
+    struct GNUNET_SET_Option options[] = {
+      { .type = GNUNET_SET_OPTION_RATELESS },
+      { 0 }
+    };
+
+    start_time = GNUNET_TIME_absolute_get ();
+    info1.oh = GNUNET_SET_prepare (&local_peer, &app_id, NULL,
+                                   (GNUNET_SET_OPERATION_INTERSECTION == op_type)
+                                   ? GNUNET_SET_RESULT_FULL
+                                   : GNUNET_SET_RESULT_SYMMETRIC,
+                                   use_rateless ? options : &options[1],
+                                   set_result_cb, &info1);
+  }
+  GNUNET_SET_commit (info1.oh, info1.set);
+  GNUNET_SET_destroy (info1.set);
+  info1.set = NULL;
+}
+
+
+/**
+ * Called when a lazy copy of the first set is ready.  Requests the
+ * next copy, each one from the copy before, and starts the operation
+ * once all #num_copies copies exist.
+ *
+ * @param cls NULL
+ * @param copy the new copy
+ */
+static void
+copy_ready_cb (void *cls,
+               struct GNUNET_SET_Handle *copy)
+{
+  GNUNET_array_append (copies,
+                       copies_length,
+                       copy);
+  if (copies_length < num_copies)
+  {
+    GNUNET_SET_copy_lazy (copy,
+                          &copy_ready_cb,
+                          NULL);
+    return;
+  }
+  printf ("lazy copies: %u in %s\n",
+          copies_length,
+          GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (copy_start_time),
+                                                  GNUNET_NO));
+  start_operation ();
+}
+
+
 static void
 run (void *cls,
      const struct GNUNET_CONFIGURATION_Handle *cfg,
@@ -339,25 +485,27 @@ run (void *cls,
 
   GNUNET_CRYPTO_hash_create_random (GNUNET_CRYPTO_QUALITY_STRONG, &app_id);
 
-  /* FIXME: also implement intersection etc. */
-  info1.set = GNUNET_SET_create (config, GNUNET_SET_OPERATION_UNION);
-  info2.set = GNUNET_SET_create (config, GNUNET_SET_OPERATION_UNION);
+  if (0 == strcasecmp (op_str, "intersection"))
+    op_type = GNUNET_SET_OPERATION_INTERSECTION;
+  else
+    op_type = GNUNET_SET_OPERATION_UNION;
+  info1.set = GNUNET_SET_create (config, op_type);
+  info2.set = GNUNET_SET_create (config, op_type);
 
   GNUNET_CONTAINER_multihashmap_iterate (info1.sent, set_insert_iterator, info1.set);
   GNUNET_CONTAINER_multihashmap_iterate (info2.sent, set_insert_iterator, info2.set);
   GNUNET_CONTAINER_multihashmap_iterate (common_sent, set_insert_iterator, info1.set);
   GNUNET_CONTAINER_multihashmap_iterate (common_sent, set_insert_iterator, info2.set);
 
-  set_listener = GNUNET_SET_listen (config, GNUNET_SET_OPERATION_UNION,
-                                    &app_id, set_listen_cb, NULL);
-
-  info1.oh = GNUNET_SET_prepare (&local_peer, &app_id, NULL,
-                                 GNUNET_SET_RESULT_SYMMETRIC,
-                                 (struct GNUNET_SET_Option[]) { 0 },
-                                 set_result_cb, &info1);
-  GNUNET_SET_commit (info1.oh, info1.set);
-  GNUNET_SET_destroy (info1.set);
-  info1.set = NULL;
+  if (0 == num_copies)
+  {
+    start_operation ();
+    return;
+  }
+  copy_start_time = GNUNET_TIME_absolute_get ();
+  GNUNET_SET_copy_lazy (info1.set,
+                        &copy_ready_cb,
+                        NULL);
 }
 
 
@@ -386,11 +534,17 @@ main (int argc, char **argv)
         gettext_noop ("number of values"),
         GNUNET_YES, &GNUNET_GETOPT_set_uint, &num_c },
       { 'x', "operation", NULL,
-        gettext_noop ("operation to execute"),
+        gettext_noop ("operation to execute (union or intersection)"),
         GNUNET_YES, &GNUNET_GETOPT_set_string, &op_str },
       { 's', "statistics", NULL,
         gettext_noop ("write statistics to file"),
         GNUNET_YES, &GNUNET_GETOPT_set_filename, &statistics_filename },
+      { 'r', "rateless", NULL,
+        gettext_noop ("use rateless IBFs for the union"),
+        GNUNET_NO, &GNUNET_GETOPT_set_one, &use_rateless },
+      { 'L', "lazy-copies", NULL,
+        gettext_noop ("number of chained lazy copies to create before the operation"),
+        GNUNET_YES, &GNUNET_GETOPT_set_uint, &num_copies },
       GNUNET_GETOPT_OPTION_END
   };
   GNUNET_PROGRAM_run2 (argc, argv, "gnunet-set-profiler",
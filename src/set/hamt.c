@@ -0,0 +1,571 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2016 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/hamt.c
+ * @brief implementation of the persistent hash array mapped trie
+ */
+
+#include "hamt.h"
+
+/**
+ * Number of bits of the key used to select a child on each level.
+ */
+#define HAMT_BITS 5
+
+/**
+ * Maximum number of children of a node.
+ */
+#define HAMT_FANOUT (1 << HAMT_BITS)
+
+/**
+ * Maximum number of levels, after that all bits of the key are used.
+ */
+#define HAMT_MAX_DEPTH ((8 * sizeof (struct GNUNET_HashCode) + HAMT_BITS - 1) / HAMT_BITS)
+
+
+/**
+ * Node of a HAMT.  Inner nodes are followed by an array of
+ * pointers to their children, one for each bit set in @e bitmap.
+ */
+struct HamtNode
+{
+  /**
+   * Number of references to this node, from parents or
+   * from users of the HAMT.
+   */
+  unsigned int rc;
+
+  /**
+   * Number of entries below this node.
+   */
+  unsigned int size;
+
+  /**
+   * Which children are present.  0 for leaves.
+   */
+  uint32_t bitmap;
+
+  /**
+   * Key of the entry, only for leaves.
+   */
+  const struct GNUNET_HashCode *key;
+
+  /**
+   * Value of the entry, only for leaves.
+   */
+  void *value;
+};
+
+
+/**
+ * Iterator over the entries of a HAMT, walks the trie depth-first.
+ */
+struct HamtIterator
+{
+  /**
+   * Nodes on the path from the root to the current node.
+   */
+  const struct HamtNode *path[HAMT_MAX_DEPTH + 1];
+
+  /**
+   * For each node in @e path, the index of the next child to visit.
+   */
+  unsigned int pos[HAMT_MAX_DEPTH + 1];
+
+  /**
+   * Number of nodes in @e path.
+   */
+  unsigned int depth;
+};
+
+
+/**
+ * Count the bits set in a bitmap.
+ *
+ * @param x the bitmap
+ * @return number of bits set in @a x
+ */
+static unsigned int
+popcount (uint32_t x)
+{
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0F0F0F0F;
+  return (x * 0x01010101) >> 24;
+}
+
+
+/**
+ * Get the children array of an inner node.
+ *
+ * @param node the inner node
+ * @return the children of @a node
+ */
+static struct HamtNode **
+children_of (const struct HamtNode *node)
+{
+  return (struct HamtNode **) &node[1];
+}
+
+
+/**
+ * Get the index of the child to follow for a key on some level.
+ *
+ * @param key the key
+ * @param depth the level of the node, 0 for the root
+ * @return the index, in [0, HAMT_FANOUT)
+ */
+static unsigned int
+get_index (const struct GNUNET_HashCode *key,
+           unsigned int depth)
+{
+  const unsigned char *bytes = (const unsigned char *) key;
+  unsigned int bit = depth * HAMT_BITS;
+  unsigned int byte = bit / 8;
+  uint16_t window;
+
+  GNUNET_assert (depth < HAMT_MAX_DEPTH);
+  window = (uint16_t) bytes[byte] << 8;
+  if (byte + 1 < sizeof (struct GNUNET_HashCode))
+    window |= bytes[byte + 1];
+  return (window >> (16 - HAMT_BITS - bit % 8)) & (HAMT_FANOUT - 1);
+}
+
+
+/**
+ * Create a leaf.
+ *
+ * @param key key of the entry
+ * @param value value of the entry
+ * @return the new leaf, with one reference
+ */
+static struct HamtNode *
+leaf_create (const struct GNUNET_HashCode *key,
+             void *value)
+{
+  struct HamtNode *leaf;
+
+  leaf = GNUNET_new (struct HamtNode);
+  leaf->rc = 1;
+  leaf->size = 1;
+  leaf->key = key;
+  leaf->value = value;
+  return leaf;
+}
+
+
+/**
+ * Allocate an inner node.
+ *
+ * @param bitmap the children that will be present
+ * @return the new node, with one reference and no children set
+ */
+static struct HamtNode *
+branch_create (uint32_t bitmap)
+{
+  struct HamtNode *node;
+
+  node = GNUNET_malloc (sizeof (struct HamtNode) +
+                        popcount (bitmap) * sizeof (struct HamtNode *));
+  node->rc = 1;
+  node->bitmap = bitmap;
+  return node;
+}
+
+
+/**
+ * Create the inner nodes needed to hold two leaves with
+ * different keys below some level.
+ *
+ * @param a first leaf, the reference is taken over
+ * @param b second leaf, the reference is taken over
+ * @param depth level of the node to create
+ * @return the new node
+ */
+static struct HamtNode *
+merge_leaves (struct HamtNode *a,
+              struct HamtNode *b,
+              unsigned int depth)
+{
+  struct HamtNode *node;
+  unsigned int idx_a;
+  unsigned int idx_b;
+
+  idx_a = get_index (a->key, depth);
+  idx_b = get_index (b->key, depth);
+  if (idx_a == idx_b)
+  {
+    node = branch_create (1U << idx_a);
+    children_of (node)[0] = merge_leaves (a, b, depth + 1);
+  }
+  else
+  {
+    node = branch_create ((1U << idx_a) | (1U << idx_b));
+    children_of (node)[(idx_a < idx_b) ? 0 : 1] = a;
+    children_of (node)[(idx_a < idx_b) ? 1 : 0] = b;
+  }
+  node->size = 2;
+  return node;
+}
+
+
+/**
+ * Copy an inner node, replacing, inserting or dropping one child.
+ * All other children get another reference.
+ *
+ * @param node the node to copy
+ * @param idx index of the child to change
+ * @param child new child at @a idx, reference is taken over;
+ *        NULL to drop the child
+ * @return the new node
+ */
+static struct HamtNode *
+branch_copy (const struct HamtNode *node,
+             unsigned int idx,
+             struct HamtNode *child)
+{
+  struct HamtNode *copy;
+  struct HamtNode **src;
+  struct HamtNode **dst;
+  uint32_t bitmap;
+  unsigned int i;
+
+  bitmap = node->bitmap;
+  if (NULL == child)
+    bitmap &= ~(1U << idx);
+  else
+    bitmap |= (1U << idx);
+  copy = branch_create (bitmap);
+  copy->size = 0;
+  src = children_of (node);
+  dst = children_of (copy);
+  for (i = 0; i < HAMT_FANOUT; i++)
+  {
+    if (i == idx)
+    {
+      if (0 != (node->bitmap & (1U << i)))
+        src++;
+      if (NULL != child)
+      {
+        *dst++ = child;
+        copy->size += child->size;
+      }
+      continue;
+    }
+    if (0 == (node->bitmap & (1U << i)))
+      continue;
+    *dst = hamt_ref (*src++);
+    copy->size += (*dst)->size;
+    dst++;
+  }
+  return copy;
+}
+
+
+/**
+ * Insert an entry below a node.
+ *
+ * @param node the node, not modified
+ * @param key key of the entry
+ * @param value value of the entry
+ * @param depth level of @a node
+ * @return the new node
+ */
+static struct HamtNode *
+put_rec (struct HamtNode *node,
+         const struct GNUNET_HashCode *key,
+         void *value,
+         unsigned int depth)
+{
+  unsigned int idx;
+
+  if (NULL == node)
+    return leaf_create (key, value);
+  if (0 == node->bitmap)
+  {
+    if (0 == GNUNET_CRYPTO_hash_cmp (node->key, key))
+      return leaf_create (key, value);
+    return merge_leaves (hamt_ref (node),
+                         leaf_create (key, value),
+                         depth);
+  }
+  idx = get_index (key, depth);
+  if (0 == (node->bitmap & (1U << idx)))
+    return branch_copy (node,
+                        idx,
+                        leaf_create (key, value));
+  return branch_copy (node,
+                      idx,
+                      put_rec (children_of (node)[popcount (node->bitmap & ((1U << idx) - 1))],
+                               key,
+                               value,
+                               depth + 1));
+}
+
+
+struct HamtNode *
+hamt_put (struct HamtNode *root,
+          const struct GNUNET_HashCode *key,
+          void *value)
+{
+  return put_rec (root, key, value, 0);
+}
+
+
+/**
+ * Remove an entry below a node.
+ *
+ * @param node the node, not modified
+ * @param key key of the entry
+ * @param depth level of @a node
+ * @return the new node, @a node with another reference
+ *         if there was no entry with @a key
+ */
+static struct HamtNode *
+remove_rec (struct HamtNode *node,
+            const struct GNUNET_HashCode *key,
+            unsigned int depth)
+{
+  struct HamtNode *child;
+  struct HamtNode *new_child;
+  unsigned int idx;
+  unsigned int num_children;
+
+  if (NULL == node)
+    return NULL;
+  if (0 == node->bitmap)
+  {
+    if (0 == GNUNET_CRYPTO_hash_cmp (node->key, key))
+      return NULL;
+    return hamt_ref (node);
+  }
+  idx = get_index (key, depth);
+  if (0 == (node->bitmap & (1U << idx)))
+    return hamt_ref (node);
+  child = children_of (node)[popcount (node->bitmap & ((1U << idx) - 1))];
+  new_child = remove_rec (child, key, depth + 1);
+  if (new_child == child)
+  {
+    /* key not found, nothing changed */
+    child->rc--;
+    return hamt_ref (node);
+  }
+  num_children = popcount (node->bitmap);
+  /* Keep the trie canonical: inner nodes never hold just one leaf. */
+  if ( (1 == num_children) &&
+       ( (NULL == new_child) ||
+         (0 == new_child->bitmap) ) )
+    return new_child;
+  if ( (2 == num_children) &&
+       (NULL == new_child) )
+  {
+    struct HamtNode *other;
+
+    other = children_of (node)[(child == children_of (node)[0]) ? 1 : 0];
+    if (0 == other->bitmap)
+      return hamt_ref (other);
+  }
+  return branch_copy (node, idx, new_child);
+}
+
+
+struct HamtNode *
+hamt_remove (struct HamtNode *root,
+             const struct GNUNET_HashCode *key)
+{
+  return remove_rec (root, key, 0);
+}
+
+
+void *
+hamt_get (const struct HamtNode *root,
+          const struct GNUNET_HashCode *key)
+{
+  const struct HamtNode *node;
+  unsigned int depth;
+  unsigned int idx;
+
+  node = root;
+  depth = 0;
+  while (NULL != node)
+  {
+    if (0 == node->bitmap)
+    {
+      if (0 == GNUNET_CRYPTO_hash_cmp (node->key, key))
+        return node->value;
+      return NULL;
+    }
+    idx = get_index (key, depth);
+    if (0 == (node->bitmap & (1U << idx)))
+      return NULL;
+    node = children_of (node)[popcount (node->bitmap & ((1U << idx) - 1))];
+    depth++;
+  }
+  return NULL;
+}
+
+
+unsigned int
+hamt_size (const struct HamtNode *root)
+{
+  if (NULL == root)
+    return 0;
+  return root->size;
+}
+
+
+struct HamtNode *
+hamt_ref (struct HamtNode *root)
+{
+  if (NULL != root)
+    root->rc++;
+  return root;
+}
+
+
+void
+hamt_release (struct HamtNode *root,
+              HamtReleaseCallback cb,
+              void *cb_cls)
+{
+  unsigned int i;
+  unsigned int num_children;
+
+  if (NULL == root)
+    return;
+  GNUNET_assert (0 < root->rc);
+  root->rc--;
+  if (0 != root->rc)
+    return;
+  if (0 == root->bitmap)
+  {
+    if (NULL != cb)
+      cb (cb_cls, root->value);
+  }
+  else
+  {
+    num_children = popcount (root->bitmap);
+    for (i = 0; i < num_children; i++)
+      hamt_release (children_of (root)[i], cb, cb_cls);
+  }
+  GNUNET_free (root);
+}
+
+
+/**
+ * Iterate over all entries below a node.
+ *
+ * @param node the node
+ * @param it function to call on each entry
+ * @param it_cls closure for @a it
+ * @return #GNUNET_OK to continue, #GNUNET_NO if @a it aborted
+ */
+static int
+iterate_rec (const struct HamtNode *node,
+             GNUNET_CONTAINER_HashMapIterator it,
+             void *it_cls)
+{
+  unsigned int i;
+  unsigned int num_children;
+
+  if (0 == node->bitmap)
+    return (GNUNET_OK == it (it_cls, node->key, node->value)) ? GNUNET_OK : GNUNET_NO;
+  num_children = popcount (node->bitmap);
+  for (i = 0; i < num_children; i++)
+    if (GNUNET_OK != iterate_rec (children_of (node)[i], it, it_cls))
+      return GNUNET_NO;
+  return GNUNET_OK;
+}
+
+
+int
+hamt_iterate (const struct HamtNode *root,
+              GNUNET_CONTAINER_HashMapIterator it,
+              void *it_cls)
+{
+  if (NULL == root)
+    return 0;
+  if (NULL == it)
+    return root->size;
+  if (GNUNET_OK != iterate_rec (root, it, it_cls))
+    return GNUNET_SYSERR;
+  return root->size;
+}
+
+
+struct HamtIterator *
+hamt_iterator_create (const struct HamtNode *root)
+{
+  struct HamtIterator *iter;
+
+  iter = GNUNET_new (struct HamtIterator);
+  if (NULL != root)
+  {
+    iter->path[0] = root;
+    iter->pos[0] = 0;
+    iter->depth = 1;
+  }
+  return iter;
+}
+
+
+int
+hamt_iterator_next (struct HamtIterator *iter,
+                    const struct GNUNET_HashCode **key,
+                    const void **value)
+{
+  const struct HamtNode *node;
+  unsigned int *pos;
+
+  while (0 < iter->depth)
+  {
+    node = iter->path[iter->depth - 1];
+    pos = &iter->pos[iter->depth - 1];
+    if (0 == node->bitmap)
+    {
+      iter->depth--;
+      if (NULL != key)
+        *key = node->key;
+      if (NULL != value)
+        *value = node->value;
+      return GNUNET_YES;
+    }
+    if (*pos == popcount (node->bitmap))
+    {
+      iter->depth--;
+      continue;
+    }
+    GNUNET_assert (iter->depth <= HAMT_MAX_DEPTH);
+    iter->path[iter->depth] = children_of (node)[(*pos)++];
+    iter->pos[iter->depth] = 0;
+    iter->depth++;
+  }
+  return GNUNET_NO;
+}
+
+
+void
+hamt_iterator_destroy (struct HamtIterator *iter)
+{
+  GNUNET_free (iter);
+}
+
+/* end of hamt.c */
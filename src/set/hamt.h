@@ -0,0 +1,206 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2016 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/hamt.h
+ * @brief persistent hash array mapped trie
+ *
+ * A HAMT maps hash codes to values.  It is never modified in place:
+ * inserting or removing an entry returns a new root that shares all
+ * unchanged nodes with the old one.  A reference to a root thus is an
+ * immutable snapshot, and taking a snapshot is O(1).
+ *
+ * Nodes are reference counted.  All functions returning a root return
+ * a new reference that must be given back with #hamt_release().  The
+ * empty HAMT is represented by NULL.
+ */
+
+#ifndef GNUNET_SET_HAMT_H
+#define GNUNET_SET_HAMT_H
+
+#include "platform.h"
+#include "gnunet_util_lib.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#if 0                           /* keep Emacsens' auto-indent happy */
+}
+#endif
+#endif
+
+
+/**
+ * Node of a HAMT, a HAMT is given by its root node.
+ */
+struct HamtNode;
+
+
+/**
+ * Iterator over the entries of a HAMT.
+ */
+struct HamtIterator;
+
+
+/**
+ * Called for the value of every entry that is freed
+ * because no HAMT refers to it anymore.
+ *
+ * @param cls closure
+ * @param value the value of the entry
+ */
+typedef void
+(*HamtReleaseCallback) (void *cls,
+                        void *value);
+
+
+/**
+ * Get a HAMT with an entry added.  If there already is an entry with
+ * the same key, it is replaced.  The key is not copied, it must stay
+ * valid as long as the entry is in any HAMT.
+ *
+ * @param root the HAMT, not modified
+ * @param key key of the new entry
+ * @param value value of the new entry
+ * @return reference to the new HAMT
+ */
+struct HamtNode *
+hamt_put (struct HamtNode *root,
+          const struct GNUNET_HashCode *key,
+          void *value);
+
+
+/**
+ * Get a HAMT with an entry removed.
+ *
+ * @param root the HAMT, not modified
+ * @param key key of the entry to remove
+ * @return reference to the new HAMT, which is @a root
+ *         if there is no entry with @a key
+ */
+struct HamtNode *
+hamt_remove (struct HamtNode *root,
+             const struct GNUNET_HashCode *key);
+
+
+/**
+ * Look up the value of an entry.
+ *
+ * @param root the HAMT
+ * @param key key to look up
+ * @return the value, NULL if there is no entry with @a key
+ */
+void *
+hamt_get (const struct HamtNode *root,
+          const struct GNUNET_HashCode *key);
+
+
+/**
+ * Get the number of entries of a HAMT.
+ *
+ * @param root the HAMT
+ * @return the number of entries
+ */
+unsigned int
+hamt_size (const struct HamtNode *root);
+
+
+/**
+ * Get another reference to a HAMT.
+ *
+ * @param root the HAMT
+ * @return @a root
+ */
+struct HamtNode *
+hamt_ref (struct HamtNode *root);
+
+
+/**
+ * Give back a reference to a HAMT.  Nodes that are not referenced
+ * anymore are freed.
+ *
+ * @param root the HAMT
+ * @param cb function to call for the value of each freed entry, or NULL
+ * @param cb_cls closure for @a cb
+ */
+void
+hamt_release (struct HamtNode *root,
+              HamtReleaseCallback cb,
+              void *cb_cls);
+
+
+/**
+ * Iterate over all entries of a HAMT.
+ *
+ * @param root the HAMT
+ * @param it function to call on each entry
+ * @param it_cls closure for @a it
+ * @return the number of entries iterated,
+ *         #GNUNET_SYSERR if @a it aborted the iteration
+ */
+int
+hamt_iterate (const struct HamtNode *root,
+              GNUNET_CONTAINER_HashMapIterator it,
+              void *it_cls);
+
+
+/**
+ * Create an iterator over the entries of a HAMT.  The caller
+ * must hold a reference to @a root while the iterator is used.
+ *
+ * @param root the HAMT
+ * @return the iterator
+ */
+struct HamtIterator *
+hamt_iterator_create (const struct HamtNode *root);
+
+
+/**
+ * Get the next entry of an iteration.
+ *
+ * @param iter the iterator
+ * @param[out] key set to the key of the entry, can be NULL
+ * @param[out] value set to the value of the entry, can be NULL
+ * @return #GNUNET_YES if an entry was returned,
+ *         #GNUNET_NO if the iteration is over
+ */
+int
+hamt_iterator_next (struct HamtIterator *iter,
+                    const struct GNUNET_HashCode **key,
+                    const void **value);
+
+
+/**
+ * Destroy an iterator.
+ *
+ * @param iter the iterator to destroy
+ */
+void
+hamt_iterator_destroy (struct HamtIterator *iter);
+
+
+#if 0                           /* keep Emacsens' auto-indent happy */
+{
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,667 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2016 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/ribf.c
+ * @brief implementation of the rateless invertible bloom filter
+ */
+
+#include "ribf.h"
+#include <math.h>
+
+/**
+ * Compute the key's hash from the key.
+ * Redefine to use a different hash function.
+ */
+#define RIBF_KEY_HASH_VAL(k) (key_hash ((k).key_val))
+
+/**
+ * Initial number of slots allocated for received symbols
+ * and pure symbol candidates in a decoder.
+ */
+#define RIBF_INITIAL_SYMBOLS 64
+
+
+/**
+ * A key together with the state of its pseudo-random
+ * mapping to symbol indices.
+ */
+struct RIBF_Source
+{
+  /**
+   * The key.
+   */
+  struct IBF_Key key;
+
+  /**
+   * Hash of @e key.
+   */
+  struct IBF_KeyHash key_hash;
+
+  /**
+   * State of the index generator, seeded with the key.
+   */
+  uint64_t prng;
+
+  /**
+   * Next symbol index the key is mapped to.
+   */
+  uint64_t next_index;
+
+  /**
+   * Value added to the count of each symbol the key is mapped to.
+   */
+  int sign;
+
+  /**
+   * Node of the source in the heap of its encoder or decoder.
+   */
+  struct GNUNET_CONTAINER_HeapNode *hn;
+};
+
+
+/**
+ * Produces the coded symbols for a set of keys.
+ */
+struct RIBF_Encoder
+{
+  /**
+   * Sources, ordered by their next symbol index.
+   */
+  struct GNUNET_CONTAINER_Heap *sources;
+
+  /**
+   * Index of the next symbol to produce.
+   */
+  uint32_t position;
+};
+
+
+/**
+ * Peels the difference between a remote symbol stream and
+ * the local set.
+ */
+struct RIBF_Decoder
+{
+  /**
+   * Encoder for the local set, produces the symbols that are
+   * subtracted from the remote ones.
+   */
+  struct RIBF_Encoder *local;
+
+  /**
+   * Keys that were already decoded, ordered by their next symbol
+   * index, so that they can be removed from symbols received later.
+   */
+  struct GNUNET_CONTAINER_Heap *decoded;
+
+  /**
+   * Difference symbols (local minus remote) received so far.
+   */
+  struct RIBF_Symbol *symbols;
+
+  /**
+   * Indices of symbols that might be pure.  Used as a stack,
+   * may contain stale or duplicate entries.
+   */
+  uint32_t *pure;
+
+  /**
+   * Allocated length of @e symbols.
+   */
+  unsigned int symbols_size;
+
+  /**
+   * Allocated length of @e pure.
+   */
+  unsigned int pure_size;
+
+  /**
+   * Number of symbols received.
+   */
+  uint32_t num_symbols;
+
+  /**
+   * Number of entries on the @e pure stack.
+   */
+  uint32_t num_pure;
+};
+
+
+/**
+ * Hash a key for the purity check of symbols.  Unlike with fixed
+ * size IBFs, symbol 0 contains every key, so we cannot rely on the
+ * "key hits its own bucket" test to reject symbols that only look
+ * pure.  The hash must therefore not be linear over xor (like CRC32
+ * is), otherwise the xor of any odd number of keys would pass.
+ *
+ * @param k the key value
+ * @return 32-bit hash of @a k
+ */
+static uint32_t
+key_hash (uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdLLU;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53LLU;
+  k ^= k >> 33;
+  return (uint32_t) k;
+}
+
+
+/**
+ * Create a source for the given key, mapped to symbol 0.
+ *
+ * @param key the key
+ * @param sign value to add to the count of mapped symbols
+ * @return the new source
+ */
+static struct RIBF_Source *
+source_create (struct IBF_Key key,
+               int sign)
+{
+  struct RIBF_Source *src;
+
+  src = GNUNET_new (struct RIBF_Source);
+  src->key = key;
+  src->key_hash.key_hash_val = RIBF_KEY_HASH_VAL (key);
+  src->prng = key.key_val;
+  src->next_index = 0;
+  src->sign = sign;
+  return src;
+}
+
+
+/**
+ * Advance a source to the next symbol index it is mapped to.
+ * The gap after index i is distributed such that the key is
+ * mapped to index i with probability of about 1/(1+i/2).
+ *
+ * @param src the source to advance
+ */
+static void
+source_advance (struct RIBF_Source *src)
+{
+  uint64_t r;
+  double step;
+
+  r = src->prng * 0xda942042e4dd58b5LLU;
+  src->prng = r;
+  step = ceil (((double) src->next_index + 1.5) *
+               ((double) (1LLU << 32) / sqrt ((double) r + 1) - 1));
+  if (step < 1)
+    step = 1;
+  if (step >= (double) (UINT64_MAX - src->next_index))
+    src->next_index = UINT64_MAX;
+  else
+    src->next_index += (uint64_t) step;
+}
+
+
+/**
+ * Add a source to a symbol.
+ *
+ * @param sym the symbol to modify
+ * @param src the source to add, with its sign
+ */
+static void
+symbol_apply (struct RIBF_Symbol *sym,
+              const struct RIBF_Source *src)
+{
+  sym->key_sum.key_val ^= src->key.key_val;
+  sym->key_hash_sum.key_hash_val ^= src->key_hash.key_hash_val;
+  sym->count += src->sign;
+}
+
+
+/**
+ * Check if a symbol contains exactly one key.
+ *
+ * @param sym the symbol
+ * @return #GNUNET_YES if the symbol is pure
+ */
+static int
+symbol_is_pure (const struct RIBF_Symbol *sym)
+{
+  if ( (1 != sym->count) &&
+       (-1 != sym->count) )
+    return GNUNET_NO;
+  if (RIBF_KEY_HASH_VAL (sym->key_sum) != sym->key_hash_sum.key_hash_val)
+    return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Apply all sources of a heap that are mapped to the given
+ * symbol index, and advance them.
+ *
+ * @param heap heap of sources
+ * @param index index of @a sym
+ * @param sym symbol to apply the sources to
+ */
+static void
+heap_apply (struct GNUNET_CONTAINER_Heap *heap,
+            uint64_t index,
+            struct RIBF_Symbol *sym)
+{
+  struct RIBF_Source *src;
+  GNUNET_CONTAINER_HeapCostType cost;
+
+  while ( (GNUNET_YES ==
+           GNUNET_CONTAINER_heap_peek2 (heap,
+                                        (void **) &src,
+                                        &cost)) &&
+          (cost == index) )
+  {
+    symbol_apply (sym, src);
+    source_advance (src);
+    GNUNET_CONTAINER_heap_update_cost (src->hn,
+                                       src->next_index);
+  }
+}
+
+
+/**
+ * Free all sources stored in a heap, and the heap itself.
+ *
+ * @param heap the heap to destroy
+ */
+static void
+heap_destroy (struct GNUNET_CONTAINER_Heap *heap)
+{
+  struct RIBF_Source *src;
+
+  while (NULL != (src = GNUNET_CONTAINER_heap_remove_root (heap)))
+    GNUNET_free (src);
+  GNUNET_CONTAINER_heap_destroy (heap);
+}
+
+
+/**
+ * Create an encoder without any keys.
+ *
+ * @return the new encoder
+ */
+struct RIBF_Encoder *
+ribf_encoder_create (void)
+{
+  struct RIBF_Encoder *enc;
+
+  enc = GNUNET_new (struct RIBF_Encoder);
+  enc->sources = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  return enc;
+}
+
+
+/**
+ * Add a key to the encoder.  Must only be called before
+ * the first symbol is produced.
+ *
+ * @param enc the encoder
+ * @param key the key to add
+ */
+void
+ribf_encoder_insert (struct RIBF_Encoder *enc,
+                     struct IBF_Key key)
+{
+  struct RIBF_Source *src;
+
+  GNUNET_assert (0 == enc->position);
+  src = source_create (key, 1);
+  src->hn = GNUNET_CONTAINER_heap_insert (enc->sources,
+                                          src,
+                                          src->next_index);
+}
+
+
+/**
+ * Produce the next @a count coded symbols of the stream.
+ *
+ * @param enc the encoder
+ * @param count number of symbols to produce
+ * @param[out] dst array of @a count symbols to write to
+ */
+void
+ribf_encoder_produce (struct RIBF_Encoder *enc,
+                      uint32_t count,
+                      struct RIBF_Symbol *dst)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    memset (&dst[i], 0, sizeof (struct RIBF_Symbol));
+    heap_apply (enc->sources,
+                enc->position++,
+                &dst[i]);
+  }
+}
+
+
+/**
+ * Get the index of the next symbol the encoder will produce.
+ *
+ * @param enc the encoder
+ * @return number of symbols produced so far
+ */
+uint32_t
+ribf_encoder_position (const struct RIBF_Encoder *enc)
+{
+  return enc->position;
+}
+
+
+/**
+ * Destroy an encoder.
+ *
+ * @param enc the encoder to destroy
+ */
+void
+ribf_encoder_destroy (struct RIBF_Encoder *enc)
+{
+  heap_destroy (enc->sources);
+  GNUNET_free (enc);
+}
+
+
+/**
+ * Create a decoder.  The local keys must be inserted with
+ * #ribf_decoder_insert_local() before any symbol is added.
+ *
+ * @return the new decoder
+ */
+struct RIBF_Decoder *
+ribf_decoder_create (void)
+{
+  struct RIBF_Decoder *dec;
+
+  dec = GNUNET_new (struct RIBF_Decoder);
+  dec->local = ribf_encoder_create ();
+  dec->decoded = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  GNUNET_array_grow (dec->symbols,
+                     dec->symbols_size,
+                     RIBF_INITIAL_SYMBOLS);
+  GNUNET_array_grow (dec->pure,
+                     dec->pure_size,
+                     RIBF_INITIAL_SYMBOLS);
+  return dec;
+}
+
+
+/**
+ * Add a key of the local set to the decoder.
+ *
+ * @param dec the decoder
+ * @param key the local key
+ */
+void
+ribf_decoder_insert_local (struct RIBF_Decoder *dec,
+                           struct IBF_Key key)
+{
+  ribf_encoder_insert (dec->local,
+                       key);
+}
+
+
+/**
+ * Remember that the symbol with the given index might be pure.
+ *
+ * @param dec the decoder
+ * @param index index of the symbol
+ */
+static void
+push_pure (struct RIBF_Decoder *dec,
+           uint32_t index)
+{
+  if (dec->num_pure == dec->pure_size)
+    GNUNET_array_grow (dec->pure,
+                       dec->pure_size,
+                       dec->pure_size * 2);
+  dec->pure[dec->num_pure++] = index;
+}
+
+
+/**
+ * Add the next coded symbol received from the remote peer.
+ *
+ * @param dec the decoder
+ * @param remote the remote symbol, its index must be the number
+ *        of symbols added before
+ */
+void
+ribf_decoder_add_symbol (struct RIBF_Decoder *dec,
+                         const struct RIBF_Symbol *remote)
+{
+  struct RIBF_Symbol *sym;
+
+  if (dec->num_symbols == dec->symbols_size)
+    GNUNET_array_grow (dec->symbols,
+                       dec->symbols_size,
+                       dec->symbols_size * 2);
+  sym = &dec->symbols[dec->num_symbols];
+  ribf_encoder_produce (dec->local,
+                        1,
+                        sym);
+  sym->count -= remote->count;
+  sym->key_sum.key_val ^= remote->key_sum.key_val;
+  sym->key_hash_sum.key_hash_val ^= remote->key_hash_sum.key_hash_val;
+  /* remove keys we already know to be part of the difference */
+  heap_apply (dec->decoded,
+              dec->num_symbols,
+              sym);
+  if (GNUNET_YES == symbol_is_pure (sym))
+    push_pure (dec,
+               dec->num_symbols);
+  dec->num_symbols++;
+}
+
+
+/**
+ * Check if a key is mapped to the given symbol index.
+ * Guards against pure-looking symbols caused by
+ * collisions of the key hash.
+ *
+ * @param key the key
+ * @param index the symbol index
+ * @return #GNUNET_YES if @a key is mapped to @a index
+ */
+static int
+key_maps_to (struct IBF_Key key,
+             uint32_t index)
+{
+  struct RIBF_Source src;
+
+  memset (&src, 0, sizeof (src));
+  src.prng = key.key_val;
+  while (src.next_index < index)
+    source_advance (&src);
+  return (src.next_index == index) ? GNUNET_YES : GNUNET_NO;
+}
+
+
+/**
+ * Decode and remove one key of the difference, if possible.
+ *
+ * @param dec the decoder
+ * @param[out] ret_side 1 if the key is only in the local set,
+ *             -1 if it is only in the remote set
+ * @param[out] ret_key the decoded key
+ * @return #GNUNET_YES if a key was decoded,
+ *         #GNUNET_NO if more symbols are needed or decoding is complete
+ */
+int
+ribf_decoder_decode (struct RIBF_Decoder *dec,
+                     int *ret_side,
+                     struct IBF_Key *ret_key)
+{
+  while (0 != dec->num_pure)
+  {
+    uint32_t index;
+    struct RIBF_Symbol *sym;
+    struct RIBF_Source *src;
+
+    index = dec->pure[--dec->num_pure];
+    sym = &dec->symbols[index];
+    /* the symbol might have been peeled since it was pushed */
+    if (GNUNET_NO == symbol_is_pure (sym))
+      continue;
+    if (GNUNET_NO == key_maps_to (sym->key_sum, index))
+      continue;
+    if (NULL != ret_side)
+      *ret_side = sym->count;
+    if (NULL != ret_key)
+      *ret_key = sym->key_sum;
+    /* remove the key from all symbols received so far,
+     * including @a sym itself */
+    src = source_create (sym->key_sum,
+                         - sym->count);
+    while (src->next_index < dec->num_symbols)
+    {
+      struct RIBF_Symbol *other = &dec->symbols[src->next_index];
+
+      symbol_apply (other, src);
+      if (GNUNET_YES == symbol_is_pure (other))
+        push_pure (dec,
+                   (uint32_t) src->next_index);
+      source_advance (src);
+    }
+    src->hn = GNUNET_CONTAINER_heap_insert (dec->decoded,
+                                            src,
+                                            src->next_index);
+    return GNUNET_YES;
+  }
+  return GNUNET_NO;
+}
+
+
+/**
+ * Check whether the whole difference has been decoded.
+ * As every key is mapped to symbol 0, the difference is
+ * fully decoded once symbol 0 is empty.
+ *
+ * @param dec the decoder
+ * @return #GNUNET_YES if decoding is complete
+ */
+int
+ribf_decoder_is_complete (const struct RIBF_Decoder *dec)
+{
+  if (0 == dec->num_symbols)
+    return GNUNET_NO;
+  if ( (0 != dec->symbols[0].count) ||
+       (0 != dec->symbols[0].key_sum.key_val) ||
+       (0 != dec->symbols[0].key_hash_sum.key_hash_val) )
+    return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Get the number of symbols added to the decoder.
+ *
+ * @param dec the decoder
+ * @return number of symbols received so far
+ */
+uint32_t
+ribf_decoder_position (const struct RIBF_Decoder *dec)
+{
+  return dec->num_symbols;
+}
+
+
+/**
+ * Destroy a decoder.
+ *
+ * @param dec the decoder to destroy
+ */
+void
+ribf_decoder_destroy (struct RIBF_Decoder *dec)
+{
+  ribf_encoder_destroy (dec->local);
+  heap_destroy (dec->decoded);
+  GNUNET_array_grow (dec->symbols,
+                     dec->symbols_size,
+                     0);
+  GNUNET_array_grow (dec->pure,
+                     dec->pure_size,
+                     0);
+  GNUNET_free (dec);
+}
+
+
+/**
+ * Write coded symbols to a buffer.
+ * Exactly (RIBF_SYMBOL_SIZE*count) bytes are written to buf.
+ *
+ * @param symbols the symbols to write
+ * @param count how many symbols to write
+ * @param buf buffer to write the data to
+ */
+void
+ribf_write_symbols (const struct RIBF_Symbol *symbols,
+                    uint32_t count,
+                    void *buf)
+{
+  struct IBF_Key *key_dst;
+  struct IBF_KeyHash *key_hash_dst;
+  int32_t *count_dst;
+  uint32_t i;
+
+  /* same layout as IBF slices: keys, then key hashes, then counts */
+  key_dst = (struct IBF_Key *) buf;
+  key_hash_dst = (struct IBF_KeyHash *) &key_dst[count];
+  count_dst = (int32_t *) &key_hash_dst[count];
+  for (i = 0; i < count; i++)
+  {
+    key_dst[i] = symbols[i].key_sum;
+    key_hash_dst[i] = symbols[i].key_hash_sum;
+    count_dst[i] = (int32_t) htonl ((uint32_t) symbols[i].count);
+  }
+}
+
+
+/**
+ * Read coded symbols from a buffer.
+ *
+ * @param buf pointer to the buffer to read from
+ * @param count how many symbols to read
+ * @param[out] symbols array of @a count symbols
+ */
+void
+ribf_read_symbols (const void *buf,
+                   uint32_t count,
+                   struct RIBF_Symbol *symbols)
+{
+  const struct IBF_Key *key_src;
+  const struct IBF_KeyHash *key_hash_src;
+  const int32_t *count_src;
+  uint32_t i;
+
+  key_src = (const struct IBF_Key *) buf;
+  key_hash_src = (const struct IBF_KeyHash *) &key_src[count];
+  count_src = (const int32_t *) &key_hash_src[count];
+  for (i = 0; i < count; i++)
+  {
+    symbols[i].key_sum = key_src[i];
+    symbols[i].key_hash_sum = key_hash_src[i];
+    symbols[i].count = (int32_t) ntohl ((uint32_t) count_src[i]);
+  }
+}
@@ -0,0 +1,259 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2016 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/ribf.h
+ * @brief rateless invertible bloom filter
+ *
+ * A rateless IBF encodes a set of keys into an infinite sequence of
+ * coded symbols.  Every key is mapped into symbol 0 and into a sparse,
+ * pseudo-random subset of the following symbols, with a density that
+ * decreases with the symbol index.  The receiver subtracts the coded
+ * symbols of its own set and peels the difference; any prefix of the
+ * sequence can be decoded once it is long enough for the actual
+ * difference, so no size estimate is needed up front.
+ */
+
+#ifndef GNUNET_SET_RIBF_H
+#define GNUNET_SET_RIBF_H
+
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "ibf.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#if 0                           /* keep Emacsens' auto-indent happy */
+}
+#endif
+#endif
+
+
+/**
+ * One coded symbol of a rateless IBF.
+ */
+struct RIBF_Symbol
+{
+  /**
+   * Xor sum of the keys mapped to this symbol.
+   */
+  struct IBF_Key key_sum;
+
+  /**
+   * Xor sum of the hashes of the keys mapped to this symbol.
+   */
+  struct IBF_KeyHash key_hash_sum;
+
+  /**
+   * Number of keys mapped to this symbol.  Unlike with fixed size
+   * IBFs, symbol 0 contains every key, so this needs more than 8 bits.
+   * Can be negative after subtraction.
+   */
+  int32_t count;
+};
+
+
+/**
+ * Size of one coded symbol on the wire, in bytes.
+ */
+#define RIBF_SYMBOL_SIZE (sizeof (struct IBF_Key) + \
+    sizeof (struct IBF_KeyHash) + sizeof (int32_t))
+
+
+/**
+ * Produces the coded symbols for a set of keys.
+ */
+struct RIBF_Encoder;
+
+
+/**
+ * Peels the difference between a remote symbol stream and
+ * the local set.
+ */
+struct RIBF_Decoder;
+
+
+/**
+ * Create an encoder without any keys.
+ *
+ * @return the new encoder
+ */
+struct RIBF_Encoder *
+ribf_encoder_create (void);
+
+
+/**
+ * Add a key to the encoder.  Must only be called before
+ * the first symbol is produced.
+ *
+ * @param enc the encoder
+ * @param key the key to add
+ */
+void
+ribf_encoder_insert (struct RIBF_Encoder *enc,
+                     struct IBF_Key key);
+
+
+/**
+ * Produce the next @a count coded symbols of the stream.
+ *
+ * @param enc the encoder
+ * @param count number of symbols to produce
+ * @param[out] dst array of @a count symbols to write to
+ */
+void
+ribf_encoder_produce (struct RIBF_Encoder *enc,
+                      uint32_t count,
+                      struct RIBF_Symbol *dst);
+
+
+/**
+ * Get the index of the next symbol the encoder will produce.
+ *
+ * @param enc the encoder
+ * @return number of symbols produced so far
+ */
+uint32_t
+ribf_encoder_position (const struct RIBF_Encoder *enc);
+
+
+/**
+ * Destroy an encoder.
+ *
+ * @param enc the encoder to destroy
+ */
+void
+ribf_encoder_destroy (struct RIBF_Encoder *enc);
+
+
+/**
+ * Create a decoder.  The local keys must be inserted with
+ * #ribf_decoder_insert_local() before any symbol is added.
+ *
+ * @return the new decoder
+ */
+struct RIBF_Decoder *
+ribf_decoder_create (void);
+
+
+/**
+ * Add a key of the local set to the decoder.
+ *
+ * @param dec the decoder
+ * @param key the local key
+ */
+void
+ribf_decoder_insert_local (struct RIBF_Decoder *dec,
+                           struct IBF_Key key);
+
+
+/**
+ * Add the next coded symbol received from the remote peer.
+ *
+ * @param dec the decoder
+ * @param remote the remote symbol, its index must be the number
+ *        of symbols added before
+ */
+void
+ribf_decoder_add_symbol (struct RIBF_Decoder *dec,
+                         const struct RIBF_Symbol *remote);
+
+
+/**
+ * Decode and remove one key of the difference, if possible.
+ *
+ * @param dec the decoder
+ * @param[out] ret_side 1 if the key is only in the local set,
+ *             -1 if it is only in the remote set
+ * @param[out] ret_key the decoded key
+ * @return #GNUNET_YES if a key was decoded,
+ *         #GNUNET_NO if more symbols are needed or decoding is complete
+ */
+int
+ribf_decoder_decode (struct RIBF_Decoder *dec,
+                     int *ret_side,
+                     struct IBF_Key *ret_key);
+
+
+/**
+ * Check whether the whole difference has been decoded.
+ *
+ * @param dec the decoder
+ * @return #GNUNET_YES if decoding is complete
+ */
+int
+ribf_decoder_is_complete (const struct RIBF_Decoder *dec);
+
+
+/**
+ * Get the number of symbols added to the decoder.
+ *
+ * @param dec the decoder
+ * @return number of symbols received so far
+ */
+uint32_t
+ribf_decoder_position (const struct RIBF_Decoder *dec);
+
+
+/**
+ * Destroy a decoder.
+ *
+ * @param dec the decoder to destroy
+ */
+void
+ribf_decoder_destroy (struct RIBF_Decoder *dec);
+
+
+/**
+ * Write coded symbols to a buffer.
+ * Exactly (RIBF_SYMBOL_SIZE*count) bytes are written to buf.
+ *
+ * @param symbols the symbols to write
+ * @param count how many symbols to write
+ * @param buf buffer to write the data to
+ */
+void
+ribf_write_symbols (const struct RIBF_Symbol *symbols,
+                    uint32_t count,
+                    void *buf);
+
+
+/**
+ * Read coded symbols from a buffer.
+ *
+ * @param buf pointer to the buffer to read from
+ * @param count how many symbols to read
+ * @param[out] symbols array of @a count symbols
+ */
+void
+ribf_read_symbols (const void *buf,
+                   uint32_t count,
+                   struct RIBF_Symbol *symbols);
+
+
+#if 0                           /* keep Emacsens' auto-indent happy */
+{
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+#endif
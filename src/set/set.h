@@ -184,6 +184,12 @@ struct GNUNET_SET_EvaluateMessage
    */
   uint32_t request_id GNUNET_PACKED;
 
+  /**
+   * #GNUNET_YES to reconcile with a rateless IBF,
+   * see #GNUNET_SET_OPTION_RATELESS.
+   */
+  uint32_t rateless GNUNET_PACKED;
+
   /* rest: context message, that is, application-specific
      message to convince listener to pick up */
 };
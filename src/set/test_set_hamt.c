@@ -0,0 +1,238 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2017 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/test_set_hamt.c
+ * @brief testcase for the persistent hash array mapped trie
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "hamt.h"
+
+/**
+ * Number of random keys to insert.
+ */
+#define NUM_KEYS 2000
+
+/**
+ * Number of keys that only differ in their last byte.
+ */
+#define NUM_COLLIDING 8
+
+#define CHECK(c) do { if (! (c)) { GNUNET_break (0); return 1; } } while (0)
+
+/**
+ * The random keys.
+ */
+static struct GNUNET_HashCode keys[NUM_KEYS];
+
+/**
+ * Values for the random keys, the value of key i is &values[i].
+ */
+static int values[NUM_KEYS];
+
+/**
+ * Keys that share all bits but those of the last byte.
+ */
+static struct GNUNET_HashCode colliding[NUM_COLLIDING];
+
+/**
+ * Number of values freed by #hamt_release().
+ */
+static unsigned int released;
+
+
+/**
+ * Count the values freed by #hamt_release().
+ *
+ * @param cls NULL
+ * @param value value of a freed entry
+ */
+static void
+count_released (void *cls,
+                void *value)
+{
+  released++;
+}
+
+
+/**
+ * Count the entries seen by #hamt_iterate() and check their values.
+ *
+ * @param cls pointer to the counter
+ * @param key key of the entry
+ * @param value value of the entry
+ * @return #GNUNET_YES to continue, #GNUNET_NO if the value is wrong
+ */
+static int
+count_entries (void *cls,
+               const struct GNUNET_HashCode *key,
+               void *value)
+{
+  unsigned int *cnt = cls;
+  unsigned int i = (int *) value - values;
+
+  if ( (i >= NUM_KEYS) ||
+       (0 != GNUNET_CRYPTO_hash_cmp (key,
+                                     &keys[i])) )
+    return GNUNET_NO;
+  (*cnt)++;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Insert, look up and remove random keys, checking that older
+ * snapshots are not affected.
+ *
+ * @return 0 on success
+ */
+static int
+test_basic ()
+{
+  struct HamtNode *root;
+  struct HamtNode *next;
+  struct HamtNode *snapshot;
+  struct HamtIterator *iter;
+  const struct GNUNET_HashCode *key;
+  const void *value;
+  unsigned int cnt;
+
+  root = NULL;
+  CHECK (0 == hamt_size (root));
+  CHECK (NULL == hamt_get (root, &keys[0]));
+  for (unsigned int i=0;i<NUM_KEYS;i++)
+  {
+    next = hamt_put (root, &keys[i], &values[i]);
+    hamt_release (root, NULL, NULL);
+    root = next;
+  }
+  CHECK (NUM_KEYS == hamt_size (root));
+  for (unsigned int i=0;i<NUM_KEYS;i++)
+    CHECK (&values[i] == hamt_get (root, &keys[i]));
+
+  cnt = 0;
+  CHECK (NUM_KEYS == hamt_iterate (root, &count_entries, &cnt));
+  CHECK (NUM_KEYS == cnt);
+  cnt = 0;
+  iter = hamt_iterator_create (root);
+  while (GNUNET_YES == hamt_iterator_next (iter, &key, &value))
+  {
+    CHECK (value == hamt_get (root, key));
+    cnt++;
+  }
+  hamt_iterator_destroy (iter);
+  CHECK (NUM_KEYS == cnt);
+
+  /* replacing a value does not change the size */
+  next = hamt_put (root, &keys[0], &values[1]);
+  CHECK (NUM_KEYS == hamt_size (next));
+  CHECK (&values[1] == hamt_get (next, &keys[0]));
+  CHECK (&values[0] == hamt_get (root, &keys[0]));
+  hamt_release (next, NULL, NULL);
+
+  /* remove every other key, the snapshot keeps all of them */
+  snapshot = hamt_ref (root);
+  for (unsigned int i=0;i<NUM_KEYS;i+=2)
+  {
+    next = hamt_remove (root, &keys[i]);
+    hamt_release (root, NULL, NULL);
+    root = next;
+  }
+  CHECK (NUM_KEYS / 2 == hamt_size (root));
+  CHECK (NUM_KEYS == hamt_size (snapshot));
+  for (unsigned int i=0;i<NUM_KEYS;i++)
+  {
+    CHECK (((0 == i % 2) ? NULL : &values[i]) == hamt_get (root, &keys[i]));
+    CHECK (&values[i] == hamt_get (snapshot, &keys[i]));
+  }
+  /* removing a missing key gives back the same HAMT */
+  next = hamt_remove (root, &keys[0]);
+  CHECK (next == root);
+  hamt_release (next, NULL, NULL);
+
+  /* entries are freed once no HAMT refers to them anymore */
+  released = 0;
+  hamt_release (snapshot, &count_released, NULL);
+  CHECK (NUM_KEYS / 2 == released);
+  released = 0;
+  hamt_release (root, &count_released, NULL);
+  CHECK (NUM_KEYS / 2 == released);
+  return 0;
+}
+
+
+/**
+ * Check keys that can only be told apart on the deepest level.
+ *
+ * @return 0 on success
+ */
+static int
+test_collisions ()
+{
+  struct HamtNode *root;
+  struct HamtNode *next;
+
+  root = NULL;
+  for (unsigned int i=0;i<NUM_COLLIDING;i++)
+  {
+    colliding[i] = keys[0];
+    ((unsigned char *) &colliding[i])[sizeof (struct GNUNET_HashCode) - 1] = i;
+    next = hamt_put (root, &colliding[i], &values[i]);
+    hamt_release (root, NULL, NULL);
+    root = next;
+  }
+  CHECK (NUM_COLLIDING == hamt_size (root));
+  for (unsigned int i=0;i<NUM_COLLIDING;i++)
+    CHECK (&values[i] == hamt_get (root, &colliding[i]));
+  CHECK (NULL == hamt_get (root, &keys[1]));
+  for (unsigned int i=0;i<NUM_COLLIDING;i++)
+  {
+    next = hamt_remove (root, &colliding[i]);
+    hamt_release (root, NULL, NULL);
+    root = next;
+    CHECK (NUM_COLLIDING - i - 1 == hamt_size (root));
+    CHECK (NULL == hamt_get (root, &colliding[i]));
+    for (unsigned int j=i+1;j<NUM_COLLIDING;j++)
+      CHECK (&values[j] == hamt_get (root, &colliding[j]));
+  }
+  CHECK (NULL == root);
+  return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  GNUNET_log_setup ("test-set-hamt",
+                    "WARNING",
+                    NULL);
+  for (unsigned int i=0;i<NUM_KEYS;i++)
+    GNUNET_CRYPTO_hash_create_random (GNUNET_CRYPTO_QUALITY_WEAK,
+                                      &keys[i]);
+  ret = 0;
+  ret |= test_basic ();
+  ret |= test_collisions ();
+  return ret;
+}
+
+/* end of test_set_hamt.c */
@@ -0,0 +1,282 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2017 GNUnet e.V.
+
+      GNUnet is free software; you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published
+      by the Free Software Foundation; either version 3, or (at your
+      option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with GNUnet; see the file COPYING.  If not, write to the
+      Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+      Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file set/test_set_ribf.c
+ * @brief testcase for the rateless invertible bloom filter
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "ribf.h"
+
+/**
+ * Number of keys both sets have.
+ */
+#define NUM_SHARED 1000
+
+/**
+ * Number of keys only the local set has.
+ */
+#define NUM_LOCAL 20
+
+/**
+ * Number of keys only the remote set has.
+ */
+#define NUM_REMOTE 30
+
+/**
+ * Symbols to add per round; the stream is received in pieces.
+ */
+#define SYMBOLS_PER_ROUND 16
+
+/**
+ * Stop if decoding needs more symbols than this.
+ */
+#define MAX_SYMBOLS 4096
+
+/**
+ * All keys, the shared ones first, then the local and remote ones.
+ */
+static struct IBF_Key keys[NUM_SHARED + NUM_LOCAL + NUM_REMOTE];
+
+
+/**
+ * Find a key in a range of @e keys.
+ *
+ * @param key key to look for
+ * @param off first index to look at
+ * @param len number of keys to look at
+ * @return index of @a key, -1 if not found
+ */
+static int
+find_key (struct IBF_Key key,
+          unsigned int off,
+          unsigned int len)
+{
+  for (unsigned int i=off;i<off+len;i++)
+    if (keys[i].key_val == key.key_val)
+      return i;
+  return -1;
+}
+
+
+/**
+ * Create the decoder for the local set and an encoder for
+ * the remote set.
+ *
+ * @param num_local number of keys only in the local set
+ * @param num_remote number of keys only in the remote set
+ * @param[out] enc set to the remote encoder
+ * @return the local decoder
+ */
+static struct RIBF_Decoder *
+setup (unsigned int num_local,
+       unsigned int num_remote,
+       struct RIBF_Encoder **enc)
+{
+  struct RIBF_Decoder *dec;
+
+  *enc = ribf_encoder_create ();
+  dec = ribf_decoder_create ();
+  for (unsigned int i=0;i<NUM_SHARED;i++)
+  {
+    ribf_encoder_insert (*enc, keys[i]);
+    ribf_decoder_insert_local (dec, keys[i]);
+  }
+  for (unsigned int i=0;i<num_local;i++)
+    ribf_decoder_insert_local (dec, keys[NUM_SHARED + i]);
+  for (unsigned int i=0;i<num_remote;i++)
+    ribf_encoder_insert (*enc, keys[NUM_SHARED + NUM_LOCAL + i]);
+  return dec;
+}
+
+
+/**
+ * Move symbols from the encoder to the decoder, passing them
+ * through the wire format.
+ *
+ * @param enc encoder to take symbols from
+ * @param dec decoder to give the symbols to
+ * @param count number of symbols
+ */
+static void
+transfer (struct RIBF_Encoder *enc,
+          struct RIBF_Decoder *dec,
+          unsigned int count)
+{
+  struct RIBF_Symbol sent[count];
+  struct RIBF_Symbol received[count];
+  char buf[count * RIBF_SYMBOL_SIZE];
+
+  ribf_encoder_produce (enc, count, sent);
+  ribf_write_symbols (sent, count, buf);
+  ribf_read_symbols (buf, count, received);
+  for (unsigned int i=0;i<count;i++)
+  {
+    GNUNET_assert (sent[i].key_sum.key_val == received[i].key_sum.key_val);
+    GNUNET_assert (sent[i].count == received[i].count);
+    ribf_decoder_add_symbol (dec, &received[i]);
+  }
+}
+
+
+/**
+ * Decode the difference of the two sets symbol by symbol and check
+ * that every key that is in only one of them is found exactly once,
+ * on the right side.
+ *
+ * @return 0 on success
+ */
+static int
+test_roundtrip ()
+{
+  struct RIBF_Encoder *enc;
+  struct RIBF_Decoder *dec;
+  struct IBF_Key key;
+  int found[NUM_LOCAL + NUM_REMOTE];
+  unsigned int num_found;
+  int side;
+  int idx;
+  int ret;
+
+  memset (found, 0, sizeof (found));
+  num_found = 0;
+  ret = 0;
+  dec = setup (NUM_LOCAL, NUM_REMOTE, &enc);
+  while (GNUNET_YES != ribf_decoder_is_complete (dec))
+  {
+    if (ribf_decoder_position (dec) >= MAX_SYMBOLS)
+    {
+      GNUNET_break (0);
+      ret = 1;
+      break;
+    }
+    transfer (enc, dec, SYMBOLS_PER_ROUND);
+    GNUNET_assert (ribf_encoder_position (enc) == ribf_decoder_position (dec));
+    while (GNUNET_YES == ribf_decoder_decode (dec, &side, &key))
+    {
+      if (1 == side)
+        idx = find_key (key, NUM_SHARED, NUM_LOCAL);
+      else
+        idx = find_key (key, NUM_SHARED + NUM_LOCAL, NUM_REMOTE);
+      if ( (-1 == idx) ||
+           (found[idx - NUM_SHARED]) )
+      {
+        GNUNET_break (0);
+        ret = 1;
+        continue;
+      }
+      found[idx - NUM_SHARED] = 1;
+      num_found++;
+    }
+  }
+  if (NUM_LOCAL + NUM_REMOTE != num_found)
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  ribf_encoder_destroy (enc);
+  ribf_decoder_destroy (dec);
+  return ret;
+}
+
+
+/**
+ * Check that identical sets are recognized after the first symbol.
+ *
+ * @return 0 on success
+ */
+static int
+test_identical ()
+{
+  struct RIBF_Encoder *enc;
+  struct RIBF_Decoder *dec;
+  struct IBF_Key key;
+  int side;
+  int ret;
+
+  ret = 0;
+  dec = setup (0, 0, &enc);
+  transfer (enc, dec, 1);
+  if ( (GNUNET_NO != ribf_decoder_decode (dec, &side, &key)) ||
+       (GNUNET_YES != ribf_decoder_is_complete (dec)) )
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  ribf_encoder_destroy (enc);
+  ribf_decoder_destroy (dec);
+  return ret;
+}
+
+
+/**
+ * Check that a difference much larger than the number of symbols
+ * received is not reported as decoded.
+ *
+ * @return 0 on success
+ */
+static int
+test_overloaded ()
+{
+  struct RIBF_Encoder *enc;
+  struct RIBF_Decoder *dec;
+  struct IBF_Key key;
+  unsigned int num_found;
+  int side;
+  int ret;
+
+  ret = 0;
+  num_found = 0;
+  dec = setup (NUM_LOCAL, NUM_REMOTE, &enc);
+  transfer (enc, dec, (NUM_LOCAL + NUM_REMOTE) / 5);
+  while (GNUNET_YES == ribf_decoder_decode (dec, &side, &key))
+    num_found++;
+  if ( (GNUNET_NO != ribf_decoder_is_complete (dec)) ||
+       (num_found >= NUM_LOCAL + NUM_REMOTE) )
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  ribf_encoder_destroy (enc);
+  ribf_decoder_destroy (dec);
+  return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  GNUNET_log_setup ("test-set-ribf",
+                    "WARNING",
+                    NULL);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              keys,
+                              sizeof (keys));
+  ret = 0;
+  ret |= test_roundtrip ();
+  ret |= test_identical ();
+  ret |= test_overloaded ();
+  return ret;
+}
+
+/* end of test_set_ribf.c */
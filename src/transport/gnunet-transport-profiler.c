@@ -31,6 +31,7 @@
 #include "gnunet_util_lib.h"
 #include "gnunet_protocols.h"
 #include "gnunet_ats_service.h"
+#include "gnunet_statistics_service.h"
 #include "gnunet_transport_service.h"
 #include "gnunet_transport_core_service.h"
 
@@ -51,6 +52,28 @@ struct Iteration
 };
 
 
+/**
+ * Counters of the TCP plugin of our transport service.
+ */
+struct TcpCounters
+{
+  /**
+   * Bytes transmitted via TCP.
+   */
+  uint64_t bytes;
+
+  /**
+   * Bytes written directly to the socket, without copying.
+   */
+  uint64_t direct_bytes;
+
+  /**
+   * Number of system calls used for the direct writes.
+   */
+  uint64_t direct_writes;
+};
+
+
 /**
  * Timeout for a connections
  */
@@ -153,6 +176,26 @@ static struct GNUNET_PeerIdentity pid;
  */
 static int verbosity;
 
+/**
+ * Handle to the statistics service.
+ */
+static struct GNUNET_STATISTICS_Handle *stats;
+
+/**
+ * Pending request for the TCP counters, NULL for none.
+ */
+static struct GNUNET_STATISTICS_GetHandle *stats_get;
+
+/**
+ * TCP counters before the benchmark.
+ */
+static struct TcpCounters tcp_start;
+
+/**
+ * TCP counters after the benchmark.
+ */
+static struct TcpCounters tcp_end;
+
 
 /**
  * Task run in monitor mode when the user presses CTRL-C to abort.
@@ -193,6 +236,17 @@ shutdown_task (void *cls)
     GNUNET_TRANSPORT_core_disconnect (handle);
     handle = NULL;
   }
+  if (NULL != stats_get)
+  {
+    GNUNET_STATISTICS_get_cancel (stats_get);
+    stats_get = NULL;
+  }
+  if (NULL != stats)
+  {
+    GNUNET_STATISTICS_destroy (stats,
+                               GNUNET_NO);
+    stats = NULL;
+  }
 
   if (verbosity > 0)
     FPRINTF (stdout, "\n");
@@ -278,6 +332,22 @@ shutdown_task (void *cls)
       GNUNET_free (icur);
     }
   }
+  if ( (benchmark_send) &&
+       (verbosity > 0) &&
+       (tcp_end.bytes > tcp_start.bytes) )
+  {
+    uint64_t bytes = tcp_end.bytes - tcp_start.bytes;
+    uint64_t direct_bytes = tcp_end.direct_bytes - tcp_start.direct_bytes;
+    uint64_t direct_writes = tcp_end.direct_writes - tcp_start.direct_writes;
+
+    FPRINTF (stdout,
+             _("\nTCP: %llu of %llu bytes written without copying, %llu bytes per write\n"),
+             (unsigned long long) direct_bytes,
+             (unsigned long long) bytes,
+             (unsigned long long) ((0 == direct_writes)
+                                   ? 0
+                                   : direct_bytes / direct_writes));
+  }
 #if 0
   if (benchmark_receive)
   {
@@ -297,6 +367,71 @@ static void
 iteration_done ();
 
 
+/**
+ * Called for each statistic of the transport service,
+ * picks out the counters of the TCP plugin.
+ *
+ * @param cls the `struct TcpCounters` to fill
+ * @param subsystem name of subsystem that created the statistic
+ * @param name the name of the datum
+ * @param value the current value
+ * @param is_persistent #GNUNET_YES if the value is persistent, #GNUNET_NO if not
+ * @return #GNUNET_OK to continue
+ */
+static int
+tcp_counter_iterator (void *cls,
+                      const char *subsystem,
+                      const char *name,
+                      uint64_t value,
+                      int is_persistent)
+{
+  struct TcpCounters *tc = cls;
+
+  if (0 == strcmp (name,
+                   "# bytes transmitted via TCP"))
+    tc->bytes = value;
+  else if (0 == strcmp (name,
+                        "# bytes transmitted directly via TCP"))
+    tc->direct_bytes = value;
+  else if (0 == strcmp (name,
+                        "# TCP direct writes"))
+    tc->direct_writes = value;
+  return GNUNET_OK;
+}
+
+
+/**
+ * We got the TCP counters from before the benchmark.
+ *
+ * @param cls NULL
+ * @param success #GNUNET_OK if statistics were
+ *        successfully obtained, #GNUNET_SYSERR if not.
+ */
+static void
+start_counters_done (void *cls,
+                     int success)
+{
+  stats_get = NULL;
+}
+
+
+/**
+ * We got the TCP counters from after the benchmark,
+ * we are done.
+ *
+ * @param cls NULL
+ * @param success #GNUNET_OK if statistics were
+ *        successfully obtained, #GNUNET_SYSERR if not.
+ */
+static void
+end_counters_done (void *cls,
+                   int success)
+{
+  stats_get = NULL;
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
 /**
  * Function called to notify a client about the socket
  * begin ready to queue more data.  @a buf will be
@@ -374,7 +509,16 @@ iteration_done ()
   if (it_count == benchmark_iterations)
   {
     benchmark_running = GNUNET_NO;
-    GNUNET_SCHEDULER_shutdown ();
+    if (NULL != stats_get)
+      GNUNET_STATISTICS_get_cancel (stats_get);
+    stats_get = GNUNET_STATISTICS_get (stats,
+                                       "transport",
+                                       NULL,
+                                       &end_counters_done,
+                                       &tcp_counter_iterator,
+                                       &tcp_end);
+    if (NULL == stats_get)
+      GNUNET_SCHEDULER_shutdown ();
     return;
   }
   iteration_start ();
@@ -590,6 +734,14 @@ run (void *cls,
     return;
   }
 
+  stats = GNUNET_STATISTICS_create ("transport-profiler",
+                                    cfg);
+  stats_get = GNUNET_STATISTICS_get (stats,
+                                     "transport",
+                                     NULL,
+                                     &start_counters_done,
+                                     &tcp_counter_iterator,
+                                     &tcp_start);
   bl_handle = GNUNET_TRANSPORT_blacklist (cfg,
                                           &blacklist_cb,
                                           NULL);
@@ -45,6 +45,12 @@
  */
 #define NAT_TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 10)
 
+/**
+ * Maximum number of pending messages we write to the socket
+ * with a single system call.
+ */
+#define MAX_WRITE_IOV 64
+
 GNUNET_NETWORK_STRUCT_BEGIN
 
 
@@ -231,6 +237,12 @@ struct PendingMessage
    */
   void *transmit_cont_cls;
 
+  /**
+   * Entry in the expiration heap of the session, NULL if
+   * the message does not expire (anymore).
+   */
+  struct GNUNET_CONTAINER_HeapNode *hn;
+
   /**
    * Timeout value for the pending message.
    */
@@ -243,6 +255,12 @@ struct PendingMessage
    */
   size_t message_size;
 
+  /**
+   * Number of bytes of the message that were already
+   * written to the socket.
+   */
+  size_t bytes_sent;
+
 };
 
 /**
@@ -288,6 +306,21 @@ struct GNUNET_ATS_Session
    */
   struct GNUNET_SERVER_TransmitHandle *transmit_handle;
 
+  /**
+   * Pending messages that can expire, ordered by their timeout.
+   */
+  struct GNUNET_CONTAINER_Heap *expiration_heap;
+
+  /**
+   * Task discarding messages that have expired.
+   */
+  struct GNUNET_SCHEDULER_Task *expire_task;
+
+  /**
+   * Task writing the pending messages directly to the socket.
+   */
+  struct GNUNET_SCHEDULER_Task *write_task;
+
   /**
    * Address of the other peer.
    */
@@ -518,6 +551,13 @@ struct Plugin
    */
   uint16_t adv_port;
 
+  /**
+   * Do we write pending messages directly to the socket
+   * (#GNUNET_YES), or copy them into the buffer of the
+   * connection first (#GNUNET_NO)?
+   */
+  int direct_write;
+
 };
 
 
@@ -1204,6 +1244,31 @@ lookup_session_by_client (struct Plugin *plugin,
 }
 
 
+/**
+ * Remove a message from the queue of a session.
+ *
+ * @param session session the message is queued for
+ * @param pm the message to remove
+ */
+static void
+dequeue_message (struct GNUNET_ATS_Session *session,
+                 struct PendingMessage *pm)
+{
+  GNUNET_CONTAINER_DLL_remove (session->pending_messages_head,
+                               session->pending_messages_tail,
+                               pm);
+  if (NULL != pm->hn)
+  {
+    GNUNET_CONTAINER_heap_remove_node (pm->hn);
+    pm->hn = NULL;
+  }
+  GNUNET_assert (0 < session->msgs_in_queue);
+  session->msgs_in_queue--;
+  GNUNET_assert (pm->message_size <= session->bytes_in_queue);
+  session->bytes_in_queue -= pm->message_size;
+}
+
+
 /**
  * Functions with this signature are called whenever we need
  * to close a session due to a disconnect or failure to
@@ -1270,6 +1335,16 @@ tcp_plugin_disconnect_session (void *cls,
     GNUNET_SCHEDULER_cancel (session->nat_connection_timeout);
     session->nat_connection_timeout = NULL;
   }
+  if (NULL != session->expire_task)
+  {
+    GNUNET_SCHEDULER_cancel (session->expire_task);
+    session->expire_task = NULL;
+  }
+  if (NULL != session->write_task)
+  {
+    GNUNET_SCHEDULER_cancel (session->write_task);
+    session->write_task = NULL;
+  }
 
   while (NULL != (pm = session->pending_messages_head))
   {
@@ -1288,13 +1363,8 @@ tcp_plugin_disconnect_session (void *cls,
                               gettext_noop ("# bytes discarded by TCP (disconnect)"),
                               pm->message_size,
                               GNUNET_NO);
-    GNUNET_CONTAINER_DLL_remove (session->pending_messages_head,
-                                 session->pending_messages_tail,
-                                 pm);
-    GNUNET_assert (0 < session->msgs_in_queue);
-    session->msgs_in_queue--;
-    GNUNET_assert (pm->message_size <= session->bytes_in_queue);
-    session->bytes_in_queue -= pm->message_size;
+    dequeue_message (session,
+                     pm);
     if (NULL != pm->transmit_cont)
       pm->transmit_cont (pm->transmit_cont_cls,
                          &session->target,
@@ -1305,6 +1375,7 @@ tcp_plugin_disconnect_session (void *cls,
   }
   GNUNET_assert (0 == session->msgs_in_queue);
   GNUNET_assert (0 == session->bytes_in_queue);
+  GNUNET_CONTAINER_heap_destroy (session->expiration_heap);
   notify_session_monitor (session->plugin,
                           session,
                           GNUNET_TRANSPORT_SS_DONE);
@@ -1437,6 +1508,8 @@ create_session (struct Plugin *plugin,
   session->target = address->peer;
   session->expecting_welcome = GNUNET_YES;
   session->scope = scope;
+  session->expiration_heap
+    = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
   pm = GNUNET_malloc (sizeof (struct PendingMessage) +
 		      sizeof (struct WelcomeMessage));
   pm->msg = (const char *) &pm[1];
@@ -1491,6 +1564,298 @@ static void
 process_pending_messages (struct GNUNET_ATS_Session *session);
 
 
+/**
+ * Discard all pending messages of a session whose
+ * timeout has passed.
+ *
+ * @param cls the `struct GNUNET_ATS_Session`
+ */
+static void
+expire_messages (void *cls)
+{
+  struct GNUNET_ATS_Session *session = cls;
+  struct GNUNET_PeerIdentity pid;
+  struct Plugin *plugin;
+  struct PendingMessage *pos;
+  struct PendingMessage *hd;
+  struct PendingMessage *tl;
+  struct GNUNET_TIME_Absolute now;
+  size_t ret;
+
+  session->expire_task = NULL;
+  plugin = session->plugin;
+  hd = NULL;
+  tl = NULL;
+  ret = 0;
+  now = GNUNET_TIME_absolute_get ();
+  while ( (NULL != (pos = GNUNET_CONTAINER_heap_peek (session->expiration_heap))) &&
+          (pos->timeout.abs_value_us <= now.abs_value_us) )
+  {
+    if ( (pos == session->pending_messages_head) &&
+         (NULL != session->transmit_handle) )
+    {
+      /* the transmission request was made for this message */
+      GNUNET_SERVER_notify_transmit_ready_cancel (session->transmit_handle);
+      session->transmit_handle = NULL;
+    }
+    dequeue_message (session,
+                     pos);
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Failed to transmit %u byte message to `%s'.\n",
+         pos->message_size,
+         GNUNET_i2s (&session->target));
+    ret += pos->message_size;
+    GNUNET_CONTAINER_DLL_insert_tail (hd,
+                                      tl,
+                                      pos);
+  }
+  if (NULL != pos)
+    session->expire_task = GNUNET_SCHEDULER_add_at (pos->timeout,
+                                                    &expire_messages,
+                                                    session);
+  /* do this call before callbacks (so that if callbacks destroy
+   * session, they have a chance to cancel actions done by this
+   * call) */
+  if (NULL != session->client)
+    process_pending_messages (session);
+  if (0 == ret)
+    return;
+  notify_session_monitor (session->plugin,
+                          session,
+                          GNUNET_TRANSPORT_SS_UPDATE);
+  pid = session->target;
+  /* no do callbacks and do not use session again since
+   * the callbacks may abort the session */
+  while (NULL != (pos = hd))
+  {
+    GNUNET_CONTAINER_DLL_remove (hd,
+                                 tl,
+                                 pos);
+    if (NULL != pos->transmit_cont)
+      pos->transmit_cont (pos->transmit_cont_cls,
+                          &pid,
+                          GNUNET_SYSERR,
+                          pos->message_size,
+                          0);
+    GNUNET_free (pos);
+  }
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# bytes currently in TCP buffers"), -(int64_t) ret,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# bytes discarded by TCP (timeout)"),
+                            ret,
+                            GNUNET_NO);
+}
+
+
+/**
+ * Append a message to the queue of a session.
+ *
+ * @param session session to queue the message for
+ * @param pm the message
+ */
+static void
+enqueue_message (struct GNUNET_ATS_Session *session,
+                 struct PendingMessage *pm)
+{
+  GNUNET_CONTAINER_DLL_insert_tail (session->pending_messages_head,
+                                    session->pending_messages_tail,
+                                    pm);
+  session->msgs_in_queue++;
+  session->bytes_in_queue += pm->message_size;
+  if (GNUNET_TIME_UNIT_FOREVER_ABS.abs_value_us == pm->timeout.abs_value_us)
+    return;
+  pm->hn = GNUNET_CONTAINER_heap_insert (session->expiration_heap,
+                                         pm,
+                                         pm->timeout.abs_value_us);
+  if (pm != GNUNET_CONTAINER_heap_peek (session->expiration_heap))
+    return; /* an earlier message keeps the expiration task scheduled */
+  if (NULL != session->expire_task)
+    GNUNET_SCHEDULER_cancel (session->expire_task);
+  session->expire_task = GNUNET_SCHEDULER_add_at (pm->timeout,
+                                                  &expire_messages,
+                                                  session);
+}
+
+
+/**
+ * Function called to notify a client about the socket
+ * being ready to queue more data.  "buf" will be
+ * NULL and "size" zero if the socket was closed for
+ * writing in the meantime.
+ *
+ * @param cls closure
+ * @param size number of bytes available in @a buf
+ * @param buf where the callee should write the message
+ * @return number of bytes written to @a buf
+ */
+static size_t
+do_transmit (void *cls,
+	     size_t size,
+	     void *buf);
+
+
+/**
+ * Ask the server to call us once the socket of the
+ * session can take the first pending message.
+ *
+ * @param session session to transmit for
+ */
+static void
+request_transmit (struct GNUNET_ATS_Session *session)
+{
+  struct PendingMessage *pm = session->pending_messages_head;
+
+  session->transmit_handle
+    = GNUNET_SERVER_notify_transmit_ready (session->client,
+                                           pm->message_size - pm->bytes_sent,
+                                           GNUNET_TIME_absolute_get_remaining (pm->timeout),
+                                           &do_transmit,
+                                           session);
+}
+
+
+/**
+ * Write as many pending messages of a session to its socket as
+ * it accepts, with a single system call and without copying them
+ * into the buffer of the connection.  If the socket is busy or
+ * only part of the queue was written, ask the server to tell us
+ * once the socket can take more.
+ *
+ * @param session session to transmit for
+ */
+static void
+transmit_direct (struct GNUNET_ATS_Session *session)
+{
+#ifdef MINGW
+  request_transmit (session);
+#else
+  struct iovec iov[MAX_WRITE_IOV];
+  struct GNUNET_PeerIdentity pid;
+  struct Plugin *plugin;
+  struct PendingMessage *pos;
+  struct PendingMessage *hd;
+  struct PendingMessage *tl;
+  unsigned int cnt;
+  ssize_t sent;
+  size_t left;
+  size_t ret;
+
+  plugin = session->plugin;
+  cnt = 0;
+  for (pos = session->pending_messages_head;
+       (NULL != pos) && (cnt < MAX_WRITE_IOV);
+       pos = pos->next)
+  {
+    iov[cnt].iov_base = (void *) &pos->msg[pos->bytes_sent];
+    iov[cnt].iov_len = pos->message_size - pos->bytes_sent;
+    cnt++;
+  }
+  if (0 == cnt)
+    return;
+  sent = GNUNET_SERVER_client_sendv (session->client,
+                                     iov,
+                                     cnt);
+  if (0 >= sent)
+  {
+    /* socket busy; errors will be reported by the regular
+       transmission as well */
+    request_transmit (session);
+    return;
+  }
+  hd = NULL;
+  tl = NULL;
+  ret = 0;
+  left = (size_t) sent;
+  while (0 < left)
+  {
+    pos = session->pending_messages_head;
+    if (left < pos->message_size - pos->bytes_sent)
+    {
+      /* the rest of this message must follow before anything
+         else, so it can no longer be discarded */
+      pos->bytes_sent += left;
+      if (NULL != pos->hn)
+      {
+        GNUNET_CONTAINER_heap_remove_node (pos->hn);
+        pos->hn = NULL;
+      }
+      pos->timeout = GNUNET_TIME_UNIT_FOREVER_ABS;
+      break;
+    }
+    left -= pos->message_size - pos->bytes_sent;
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Transmitted message of type %u size %u to peer %s at %s\n",
+         ntohs (((struct GNUNET_MessageHeader *) pos->msg)->type),
+         pos->message_size,
+         GNUNET_i2s (&session->target),
+         tcp_plugin_address_to_string (session->plugin,
+                                       session->address->address,
+                                       session->address->address_length));
+    dequeue_message (session,
+                     pos);
+    ret += pos->message_size;
+    GNUNET_CONTAINER_DLL_insert_tail (hd,
+                                      tl,
+                                      pos);
+  }
+  if (NULL != session->pending_messages_head)
+    request_transmit (session);
+  notify_session_monitor (session->plugin,
+                          session,
+                          GNUNET_TRANSPORT_SS_UPDATE);
+  session->last_activity = GNUNET_TIME_absolute_get ();
+  pid = session->target;
+  /* we'll now call callbacks that may cancel the session; hence
+   * we should not use 'session' after this point */
+  while (NULL != (pos = hd))
+  {
+    GNUNET_CONTAINER_DLL_remove (hd, tl, pos);
+    if (NULL != pos->transmit_cont)
+      pos->transmit_cont (pos->transmit_cont_cls,
+                          &pid,
+                          GNUNET_OK,
+                          pos->message_size,
+                          pos->message_size); /* FIXME: include TCP overhead */
+    GNUNET_free (pos);
+  }
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# bytes currently in TCP buffers"),
+                            - (int64_t) ret,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# bytes transmitted via TCP"),
+                            sent,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# bytes transmitted directly via TCP"),
+                            sent,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            gettext_noop ("# TCP direct writes"),
+                            1,
+                            GNUNET_NO);
+#endif
+}
+
+
+/**
+ * Task writing the messages queued for a session
+ * directly to its socket.
+ *
+ * @param cls the `struct GNUNET_ATS_Session`
+ */
+static void
+transmit_direct_task (void *cls)
+{
+  struct GNUNET_ATS_Session *session = cls;
+
+  session->write_task = NULL;
+  transmit_direct (session);
+}
+
+
 /**
  * Function called to notify a client about the socket
  * being ready to queue more data.  "buf" will be
@@ -1513,7 +1878,6 @@ do_transmit (void *cls,
   struct PendingMessage *pos;
   struct PendingMessage *hd;
   struct PendingMessage *tl;
-  struct GNUNET_TIME_Absolute now;
   char *cbuf;
   size_t ret;
 
@@ -1522,64 +1886,18 @@ do_transmit (void *cls,
   if (NULL == buf)
   {
     LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "Timeout trying to transmit to peer `%s', discarding message queue.\n",
+         "Timeout trying to transmit to peer `%s', discarding expired messages.\n",
          GNUNET_i2s (&session->target));
     /* timeout; cancel all messages that have already expired */
-    hd = NULL;
-    tl = NULL;
-    ret = 0;
-    now = GNUNET_TIME_absolute_get ();
-    while ( (NULL != (pos = session->pending_messages_head)) &&
-            (pos->timeout.abs_value_us <= now.abs_value_us) )
-    {
-      GNUNET_CONTAINER_DLL_remove (session->pending_messages_head,
-                                   session->pending_messages_tail,
-                                   pos);
-      GNUNET_assert (0 < session->msgs_in_queue);
-      session->msgs_in_queue--;
-      GNUNET_assert (pos->message_size <= session->bytes_in_queue);
-      session->bytes_in_queue -= pos->message_size;
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "Failed to transmit %u byte message to `%s'.\n",
-           pos->message_size,
-           GNUNET_i2s (&session->target));
-      ret += pos->message_size;
-      GNUNET_CONTAINER_DLL_insert_after (hd,
-                                         tl,
-                                         tl,
-                                         pos);
-    }
-    /* do this call before callbacks (so that if callbacks destroy
-     * session, they have a chance to cancel actions done by this
-     * call) */
-    process_pending_messages (session);
-    pid = session->target;
-    /* no do callbacks and do not use session again since
-     * the callbacks may abort the session */
-    while (NULL != (pos = hd))
-    {
-      GNUNET_CONTAINER_DLL_remove (hd,
-                                   tl,
-                                   pos);
-      if (NULL != pos->transmit_cont)
-        pos->transmit_cont (pos->transmit_cont_cls,
-                            &pid,
-                            GNUNET_SYSERR,
-                            pos->message_size,
-                            0);
-      GNUNET_free (pos);
-    }
-    GNUNET_STATISTICS_update (plugin->env->stats,
-                              gettext_noop ("# bytes currently in TCP buffers"), -(int64_t) ret,
-                              GNUNET_NO);
-    GNUNET_STATISTICS_update (plugin->env->stats,
-                              gettext_noop ("# bytes discarded by TCP (timeout)"),
-                              ret,
-                              GNUNET_NO);
-    if (0 < ret)
-      notify_session_monitor (session->plugin,
-                              session,
-                              GNUNET_TRANSPORT_SS_UPDATE);
+    if (NULL != session->expire_task)
+      GNUNET_SCHEDULER_cancel (session->expire_task);
+    expire_messages (session);
+    return 0;
+  }
+  if (GNUNET_YES == plugin->direct_write)
+  {
+    /* the socket is writable, no need to copy anything */
+    transmit_direct (session);
     return 0;
   }
   /* copy all pending messages that would fit */
@@ -1591,13 +1909,8 @@ do_transmit (void *cls,
   {
     if (ret + pos->message_size > size)
       break;
-    GNUNET_CONTAINER_DLL_remove (session->pending_messages_head,
-                                 session->pending_messages_tail,
-                                 pos);
-    GNUNET_assert (0 < session->msgs_in_queue);
-    session->msgs_in_queue--;
-    GNUNET_assert (pos->message_size <= session->bytes_in_queue);
-    session->bytes_in_queue -= pos->message_size;
+    dequeue_message (session,
+                     pos);
     GNUNET_assert(size >= pos->message_size);
     LOG (GNUNET_ERROR_TYPE_DEBUG,
          "Transmitting message of type %u size %u to peer %s at %s\n",
@@ -1607,7 +1920,6 @@ do_transmit (void *cls,
          tcp_plugin_address_to_string (session->plugin,
                                        session->address->address,
                                        session->address->address_length));
-    /* FIXME: this GNUNET_memcpy can be up to 7% of our total runtime */
     GNUNET_memcpy (cbuf,
             pos->msg,
             pos->message_size);
@@ -1663,20 +1975,21 @@ do_transmit (void *cls,
 static void
 process_pending_messages (struct GNUNET_ATS_Session *session)
 {
-  struct PendingMessage *pm;
-
   GNUNET_assert (NULL != session->client);
-  if (NULL != session->transmit_handle)
+  if ( (NULL != session->transmit_handle) ||
+       (NULL != session->write_task) )
     return;
-  if (NULL == (pm = session->pending_messages_head))
+  if (NULL == session->pending_messages_head)
     return;
-
-  session->transmit_handle
-    = GNUNET_SERVER_notify_transmit_ready (session->client,
-                                           pm->message_size,
-                                           GNUNET_TIME_absolute_get_remaining (pm->timeout),
-                                           &do_transmit,
-                                           session);
+  if (GNUNET_YES == session->plugin->direct_write)
+  {
+    /* write everything queued until the task runs with
+       a single system call */
+    session->write_task = GNUNET_SCHEDULER_add_now (&transmit_direct_task,
+                                                    session);
+    return;
+  }
+  request_transmit (session);
 }
 
 
@@ -1748,14 +2061,11 @@ tcp_plugin_send (void *cls,
                               GNUNET_NO);
 
     /* append pm to pending_messages list */
-    GNUNET_CONTAINER_DLL_insert_tail (session->pending_messages_head,
-                                      session->pending_messages_tail,
-                                      pm);
+    enqueue_message (session,
+                     pm);
     notify_session_monitor (session->plugin,
                             session,
                             GNUNET_TRANSPORT_SS_UPDATE);
-    session->msgs_in_queue++;
-    session->bytes_in_queue += pm->message_size;
     process_pending_messages (session);
     return msgbuf_size;
   }
@@ -1771,11 +2081,8 @@ tcp_plugin_send (void *cls,
                               gettext_noop ("# bytes currently in TCP buffers"), msgbuf_size,
                               GNUNET_NO);
     /* append pm to pending_messages list */
-    GNUNET_CONTAINER_DLL_insert_tail (session->pending_messages_head,
-                                      session->pending_messages_tail,
-                                      pm);
-    session->msgs_in_queue++;
-    session->bytes_in_queue += pm->message_size;
+    enqueue_message (session,
+                     pm);
     notify_session_monitor (session->plugin,
                             session,
                             GNUNET_TRANSPORT_SS_HANDSHAKE);
@@ -3368,6 +3675,16 @@ libgnunet_plugin_transport_tcp_init (void *cls)
   plugin->my_welcome.header.size = htons (sizeof(struct WelcomeMessage));
   plugin->my_welcome.header.type = htons (GNUNET_MESSAGE_TYPE_TRANSPORT_TCP_WELCOME);
   plugin->my_welcome.clientIdentity = *plugin->env->my_identity;
+#ifdef MINGW
+  plugin->direct_write = GNUNET_NO;
+#else
+  plugin->direct_write
+    = (GNUNET_NO == GNUNET_CONFIGURATION_get_value_yesno (env->cfg,
+                                                          "transport-tcp",
+                                                          "DIRECT_WRITE"))
+    ? GNUNET_NO
+    : GNUNET_YES;
+#endif
 
   if ( (NULL != service) &&
        (GNUNET_YES ==
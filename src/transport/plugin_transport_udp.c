@@ -3063,67 +3063,34 @@ read_process_fragment (struct Plugin *plugin,
 
 
 /**
- * Read and process a message from the given socket.
+ * Process a datagram we received.
  *
  * @param plugin the overall plugin
- * @param rsock socket to read from
+ * @param buf the datagram
+ * @param size number of bytes in @a buf
+ * @param sa address of the sender
+ * @param fromlen number of bytes in @a sa
  */
 static void
-udp_select_read (struct Plugin *plugin,
-                 struct GNUNET_NETWORK_Handle *rsock)
+process_datagram (struct Plugin *plugin,
+                  const char *buf,
+                  ssize_t size,
+                  const struct sockaddr *sa,
+                  socklen_t fromlen)
 {
-  socklen_t fromlen;
-  struct sockaddr_storage addr;
-  char buf[65536] GNUNET_ALIGN;
-  ssize_t size;
   const struct GNUNET_MessageHeader *msg;
   struct IPv4UdpAddress v4;
   struct IPv6UdpAddress v6;
-  const struct sockaddr *sa;
   const struct sockaddr_in *sa4;
   const struct sockaddr_in6 *sa6;
   const union UdpAddress *int_addr;
   size_t int_addr_len;
   enum GNUNET_ATS_Network_Type network_type;
 
-  fromlen = sizeof (addr);
-  memset (&addr,
-          0,
-          sizeof(addr));
-  size = GNUNET_NETWORK_socket_recvfrom (rsock,
-                                         buf,
-                                         sizeof (buf),
-                                         (struct sockaddr *) &addr,
-                                         &fromlen);
-  sa = (const struct sockaddr *) &addr;
-#if MINGW
-  /* On SOCK_DGRAM UDP sockets recvfrom might fail with a
-   * WSAECONNRESET error to indicate that previous sendto() (yes, sendto!)
-   * on this socket has failed.
-   * Quote from MSDN:
-   *   WSAECONNRESET - The virtual circuit was reset by the remote side
-   *   executing a hard or abortive close. The application should close
-   *   the socket; it is no longer usable. On a UDP-datagram socket this
-   *   error indicates a previous send operation resulted in an ICMP Port
-   *   Unreachable message.
-   */
-  if ( (-1 == size) &&
-       (ECONNRESET == errno) )
-    return;
-#endif
-  if (-1 == size)
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-         "UDP failed to receive data: %s\n",
-         STRERROR (errno));
-    /* Connection failure or something. Not a protocol violation. */
-    return;
-  }
-
   /* Check if this is a STUN packet */
   if (GNUNET_NO !=
       GNUNET_NAT_stun_handle_packet (plugin->nat,
-				     (const struct sockaddr *) &addr,
+				     sa,
 				     fromlen,
 				     buf,
 				     size))
@@ -3169,7 +3136,7 @@ udp_select_read (struct Plugin *plugin,
   switch (sa->sa_family)
   {
   case AF_INET:
-    sa4 = (const struct sockaddr_in *) &addr;
+    sa4 = (const struct sockaddr_in *) sa;
     v4.options = 0;
     v4.ipv4_addr = sa4->sin_addr.s_addr;
     v4.u4_port = sa4->sin_port;
@@ -3177,7 +3144,7 @@ udp_select_read (struct Plugin *plugin,
     int_addr_len = sizeof (v4);
     break;
   case AF_INET6:
-    sa6 = (const struct sockaddr_in6 *) &addr;
+    sa6 = (const struct sockaddr_in6 *) sa;
     v6.options = 0;
     v6.ipv6_addr = sa6->sin6_addr;
     v6.u6_port = sa6->sin6_port;
@@ -3232,6 +3199,130 @@ udp_select_read (struct Plugin *plugin,
 }
 
 
+/**
+ * Read and process the datagrams waiting on the given socket.
+ * Where supported, up to #UDP_BATCH_SIZE datagrams are read
+ * with a single system call.
+ *
+ * @param plugin the overall plugin
+ * @param rsock socket to read from
+ */
+static void
+udp_select_read (struct Plugin *plugin,
+                 struct GNUNET_NETWORK_Handle *rsock)
+{
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[UDP_BATCH_SIZE];
+  struct iovec iov[UDP_BATCH_SIZE];
+  struct sockaddr_storage addrs[UDP_BATCH_SIZE];
+  int ret;
+  int i;
+
+  memset (msgs,
+          0,
+          sizeof (msgs));
+  for (i = 0; i < UDP_BATCH_SIZE; i++)
+  {
+    iov[i].iov_base = &plugin->batch_buf[i * UDP_BATCH_SLOT_SIZE];
+    iov[i].iov_len = UDP_BATCH_SLOT_SIZE;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &addrs[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof (addrs[i]);
+  }
+  ret = GNUNET_NETWORK_socket_recvmmsg (rsock,
+                                        msgs,
+                                        UDP_BATCH_SIZE);
+  if (-1 == ret)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "UDP failed to receive data: %s\n",
+         STRERROR (errno));
+    /* Connection failure or something. Not a protocol violation. */
+    return;
+  }
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            "# UDP, receive system calls",
+                            1,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            "# UDP, datagrams received",
+                            ret,
+                            GNUNET_NO);
+  for (i = 0; i < ret; i++)
+  {
+    if (0 != (msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+    {
+      /* we fragment everything larger than UDP_MTU,
+         so this is not from one of us */
+      LOG (GNUNET_ERROR_TYPE_WARNING,
+           "UDP got oversized datagram from %s, dropping it\n",
+           GNUNET_a2s ((const struct sockaddr *) &addrs[i],
+                       msgs[i].msg_hdr.msg_namelen));
+      GNUNET_break_op (0);
+      continue;
+    }
+    process_datagram (plugin,
+                      iov[i].iov_base,
+                      msgs[i].msg_len,
+                      (const struct sockaddr *) &addrs[i],
+                      msgs[i].msg_hdr.msg_namelen);
+  }
+#else
+  socklen_t fromlen;
+  struct sockaddr_storage addr;
+  char buf[65536] GNUNET_ALIGN;
+  ssize_t size;
+
+  fromlen = sizeof (addr);
+  memset (&addr,
+          0,
+          sizeof(addr));
+  size = GNUNET_NETWORK_socket_recvfrom (rsock,
+                                         buf,
+                                         sizeof (buf),
+                                         (struct sockaddr *) &addr,
+                                         &fromlen);
+#if MINGW
+  /* On SOCK_DGRAM UDP sockets recvfrom might fail with a
+   * WSAECONNRESET error to indicate that previous sendto() (yes, sendto!)
+   * on this socket has failed.
+   * Quote from MSDN:
+   *   WSAECONNRESET - The virtual circuit was reset by the remote side
+   *   executing a hard or abortive close. The application should close
+   *   the socket; it is no longer usable. On a UDP-datagram socket this
+   *   error indicates a previous send operation resulted in an ICMP Port
+   *   Unreachable message.
+   */
+  if ( (-1 == size) &&
+       (ECONNRESET == errno) )
+    return;
+#endif
+  if (-1 == size)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "UDP failed to receive data: %s\n",
+         STRERROR (errno));
+    /* Connection failure or something. Not a protocol violation. */
+    return;
+  }
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            "# UDP, receive system calls",
+                            1,
+                            GNUNET_NO);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            "# UDP, datagrams received",
+                            1,
+                            GNUNET_NO);
+  process_datagram (plugin,
+                    buf,
+                    size,
+                    (const struct sockaddr *) &addr,
+                    fromlen);
+#endif
+}
+
+
 /**
  * Removes messages from the transmission queue that have
  * timed out, and then selects a message that should be
@@ -3385,132 +3476,303 @@ analyze_send_error (struct Plugin *plugin,
 
 
 /**
- * It is time to try to transmit a UDP message.  Select one
- * and send.
+ * Get the socket address of the peer a message is for.
  *
- * @param plugin the plugin
- * @param sock which socket (v4/v6) to send on
+ * @param udpw the message
+ * @param[out] addr set to the address
+ * @param[out] slen set to the length of @a addr
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the
+ *         address of the session is malformed
  */
-static void
-udp_select_send (struct Plugin *plugin,
-                 struct GNUNET_NETWORK_Handle *sock)
+static int
+get_target_address (const struct UDP_MessageWrapper *udpw,
+                    struct sockaddr_storage *addr,
+                    socklen_t *slen)
 {
-  ssize_t sent;
-  socklen_t slen;
-  const struct sockaddr *a;
   const struct IPv4UdpAddress *u4;
-  struct sockaddr_in a4;
+  struct sockaddr_in *a4;
   const struct IPv6UdpAddress *u6;
-  struct sockaddr_in6 a6;
-  struct UDP_MessageWrapper *udpw;
+  struct sockaddr_in6 *a6;
 
-  /* Find message(s) to send */
-  while (NULL != (udpw = remove_timeout_messages_and_select (plugin,
-                                                             sock)))
+  memset (addr,
+          0,
+          sizeof (*addr));
+  if (sizeof (struct IPv4UdpAddress) == udpw->session->address->address_length)
   {
-    if (sizeof (struct IPv4UdpAddress) == udpw->session->address->address_length)
-    {
-      u4 = udpw->session->address->address;
-      memset (&a4,
-              0,
-              sizeof(a4));
-      a4.sin_family = AF_INET;
+    u4 = udpw->session->address->address;
+    a4 = (struct sockaddr_in *) addr;
+    a4->sin_family = AF_INET;
 #if HAVE_SOCKADDR_IN_SIN_LEN
-      a4.sin_len = sizeof (a4);
+    a4->sin_len = sizeof (*a4);
 #endif
-      a4.sin_port = u4->u4_port;
-      a4.sin_addr.s_addr = u4->ipv4_addr;
-      a = (const struct sockaddr *) &a4;
-      slen = sizeof (a4);
-    }
-    else if (sizeof (struct IPv6UdpAddress) == udpw->session->address->address_length)
-    {
-      u6 = udpw->session->address->address;
-      memset (&a6,
-              0,
-              sizeof(a6));
-      a6.sin6_family = AF_INET6;
+    a4->sin_port = u4->u4_port;
+    a4->sin_addr.s_addr = u4->ipv4_addr;
+    *slen = sizeof (*a4);
+    return GNUNET_OK;
+  }
+  if (sizeof (struct IPv6UdpAddress) == udpw->session->address->address_length)
+  {
+    u6 = udpw->session->address->address;
+    a6 = (struct sockaddr_in6 *) addr;
+    a6->sin6_family = AF_INET6;
 #if HAVE_SOCKADDR_IN_SIN_LEN
-      a6.sin6_len = sizeof (a6);
+    a6->sin6_len = sizeof (*a6);
 #endif
-      a6.sin6_port = u6->u6_port;
-      a6.sin6_addr = u6->ipv6_addr;
-      a = (const struct sockaddr *) &a6;
-      slen = sizeof (a6);
-    }
-    else
-    {
-      GNUNET_break (0);
-      dequeue (plugin,
-               udpw);
+    a6->sin6_port = u6->u6_port;
+    a6->sin6_addr = u6->ipv6_addr;
+    *slen = sizeof (*a6);
+    return GNUNET_OK;
+  }
+  GNUNET_break (0);
+  return GNUNET_SYSERR;
+}
+
+
+/**
+ * We tried to transmit a message, report the outcome and
+ * release the message.
+ *
+ * @param plugin the plugin
+ * @param udpw the message, already removed from the queue
+ * @param a address we sent the message to
+ * @param slen number of bytes in @a a
+ * @param sent number of bytes sent, #GNUNET_SYSERR on failure
+ * @param error the errno value of the failure
+ */
+static void
+finish_send (struct Plugin *plugin,
+             struct UDP_MessageWrapper *udpw,
+             const struct sockaddr *a,
+             socklen_t slen,
+             ssize_t sent,
+             int error)
+{
+  struct GNUNET_ATS_Session *session = udpw->session;
+
+  if (GNUNET_YES == session->in_destroy)
+  {
+    /* The session was destroyed while we were sending the batch;
+       this also finished (and freed) any fragmented message this
+       one belonged to, so only tell the owner of plain messages. */
+    if (NULL == udpw->frag_ctx)
       udpw->qc (udpw->qc_cls,
                 udpw,
                 GNUNET_SYSERR);
-      notify_session_monitor (plugin,
-                              udpw->session,
-                              GNUNET_TRANSPORT_SS_UPDATE);
-      GNUNET_free (udpw);
+    GNUNET_free (udpw);
+    session->rc--;
+    if (0 == session->rc)
+      free_session (session);
+    return;
+  }
+  session->last_transmit_time
+    = GNUNET_TIME_absolute_max (GNUNET_TIME_absolute_get (),
+                                session->last_transmit_time);
+  if (GNUNET_SYSERR == sent)
+  {
+    /* Failure */
+    analyze_send_error (plugin,
+                        a,
+                        slen,
+                        error);
+    udpw->qc (udpw->qc_cls,
+              udpw,
+              GNUNET_SYSERR);
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, total, bytes, sent, failure",
+                              sent,
+                              GNUNET_NO);
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, total, messages, sent, failure",
+                              1,
+                              GNUNET_NO);
+  }
+  else
+  {
+    /* Success */
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "UDP transmitted %u-byte message to  `%s' `%s' (%d: %s)\n",
+         (unsigned int) (udpw->msg_size),
+         GNUNET_i2s (&session->target),
+         GNUNET_a2s (a,
+                     slen),
+         (int ) sent,
+         (sent < 0) ? STRERROR (errno) : "ok");
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, total, bytes, sent, success",
+                              sent,
+                              GNUNET_NO);
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, total, messages, sent, success",
+                              1,
+                              GNUNET_NO);
+    if (NULL != udpw->frag_ctx)
+      udpw->frag_ctx->on_wire_size += udpw->msg_size;
+    udpw->qc (udpw->qc_cls,
+              udpw,
+              GNUNET_OK);
+  }
+  notify_session_monitor (plugin,
+                          session,
+                          GNUNET_TRANSPORT_SS_UPDATE);
+  GNUNET_free (udpw);
+  session->rc--;
+  if ( (0 == session->rc) &&
+       (GNUNET_YES == session->in_destroy) )
+    free_session (session);
+}
+
+
+/**
+ * Transmit a batch of messages, with a single system call
+ * where supported.
+ *
+ * @param plugin the plugin
+ * @param sock which socket (v4/v6) to send on
+ * @param batch the messages, already removed from the queue
+ * @param addrs target addresses of the messages
+ * @param slens lengths of the target addresses
+ * @param cnt number of messages in @a batch
+ */
+static void
+transmit_batch (struct Plugin *plugin,
+                struct GNUNET_NETWORK_Handle *sock,
+                struct UDP_MessageWrapper **batch,
+                const struct sockaddr_storage *addrs,
+                const socklen_t *slens,
+                unsigned int cnt)
+{
+#if HAVE_SENDMMSG
+  struct mmsghdr msgs[UDP_BATCH_SIZE];
+  struct iovec iov[UDP_BATCH_SIZE];
+  unsigned int off;
+  unsigned int i;
+  int ret;
+
+  memset (msgs,
+          0,
+          sizeof (msgs));
+  for (i = 0; i < cnt; i++)
+  {
+    iov[i].iov_base = batch[i]->msg_buf;
+    iov[i].iov_len = batch[i]->msg_size;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = (void *) &addrs[i];
+    msgs[i].msg_hdr.msg_namelen = slens[i];
+  }
+  off = 0;
+  while (off < cnt)
+  {
+    ret = GNUNET_NETWORK_socket_sendmmsg (sock,
+                                          &msgs[off],
+                                          cnt - off);
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, send system calls",
+                              1,
+                              GNUNET_NO);
+    if (-1 == ret)
+    {
+      /* the first message failed, go on with the others */
+      finish_send (plugin,
+                   batch[off],
+                   (const struct sockaddr *) &addrs[off],
+                   slens[off],
+                   GNUNET_SYSERR,
+                   errno);
+      off++;
       continue;
     }
+    for (i = off; i < off + ret; i++)
+      finish_send (plugin,
+                   batch[i],
+                   (const struct sockaddr *) &addrs[i],
+                   slens[i],
+                   msgs[i].msg_len,
+                   0);
+    off += ret;
+  }
+#else
+  unsigned int i;
+  ssize_t sent;
+
+  for (i = 0; i < cnt; i++)
+  {
     sent = GNUNET_NETWORK_socket_sendto (sock,
-                                         udpw->msg_buf,
-                                         udpw->msg_size,
-                                         a,
-                                         slen);
-    udpw->session->last_transmit_time
-      = GNUNET_TIME_absolute_max (GNUNET_TIME_absolute_get (),
-                                  udpw->session->last_transmit_time);
-    dequeue (plugin,
-             udpw);
-    if (GNUNET_SYSERR == sent)
-    {
-      /* Failure */
-      analyze_send_error (plugin,
-                          a,
-                          slen,
-                          errno);
-      udpw->qc (udpw->qc_cls,
-                udpw,
-                GNUNET_SYSERR);
-      GNUNET_STATISTICS_update (plugin->env->stats,
-                                "# UDP, total, bytes, sent, failure",
-                                sent,
-                                GNUNET_NO);
-      GNUNET_STATISTICS_update (plugin->env->stats,
-                                "# UDP, total, messages, sent, failure",
-                                1,
-                                GNUNET_NO);
-    }
-    else
+                                         batch[i]->msg_buf,
+                                         batch[i]->msg_size,
+                                         (const struct sockaddr *) &addrs[i],
+                                         slens[i]);
+    GNUNET_STATISTICS_update (plugin->env->stats,
+                              "# UDP, send system calls",
+                              1,
+                              GNUNET_NO);
+    finish_send (plugin,
+                 batch[i],
+                 (const struct sockaddr *) &addrs[i],
+                 slens[i],
+                 sent,
+                 errno);
+  }
+#endif
+}
+
+
+/**
+ * It is time to try to transmit UDP messages.  Select the
+ * messages that are due and send them, in batches of up to
+ * #UDP_BATCH_SIZE.
+ *
+ * @param plugin the plugin
+ * @param sock which socket (v4/v6) to send on
+ */
+static void
+udp_select_send (struct Plugin *plugin,
+                 struct GNUNET_NETWORK_Handle *sock)
+{
+  struct UDP_MessageWrapper *batch[UDP_BATCH_SIZE];
+  struct sockaddr_storage addrs[UDP_BATCH_SIZE];
+  socklen_t slens[UDP_BATCH_SIZE];
+  struct UDP_MessageWrapper *udpw;
+  unsigned int cnt;
+
+  do
+  {
+    /* Find message(s) to send */
+    cnt = 0;
+    while ( (cnt < UDP_BATCH_SIZE) &&
+            (NULL != (udpw = remove_timeout_messages_and_select (plugin,
+                                                                 sock))) )
     {
-      /* Success */
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "UDP transmitted %u-byte message to  `%s' `%s' (%d: %s)\n",
-           (unsigned int) (udpw->msg_size),
-           GNUNET_i2s (&udpw->session->target),
-           GNUNET_a2s (a,
-                       slen),
-           (int ) sent,
-           (sent < 0) ? STRERROR (errno) : "ok");
-      GNUNET_STATISTICS_update (plugin->env->stats,
-                                "# UDP, total, bytes, sent, success",
-                                sent,
-                                GNUNET_NO);
-      GNUNET_STATISTICS_update (plugin->env->stats,
-                                "# UDP, total, messages, sent, success",
-                                1,
-                                GNUNET_NO);
-      if (NULL != udpw->frag_ctx)
-        udpw->frag_ctx->on_wire_size += udpw->msg_size;
-      udpw->qc (udpw->qc_cls,
-                udpw,
-                GNUNET_OK);
+      dequeue (plugin,
+               udpw);
+      if (GNUNET_OK !=
+          get_target_address (udpw,
+                              &addrs[cnt],
+                              &slens[cnt]))
+      {
+        udpw->qc (udpw->qc_cls,
+                  udpw,
+                  GNUNET_SYSERR);
+        notify_session_monitor (plugin,
+                                udpw->session,
+                                GNUNET_TRANSPORT_SS_UPDATE);
+        GNUNET_free (udpw);
+        continue;
+      }
+      /* keep the session around until we are done with the batch */
+      udpw->session->rc++;
+      batch[cnt++] = udpw;
     }
-    notify_session_monitor (plugin,
-                            udpw->session,
-                            GNUNET_TRANSPORT_SS_UPDATE);
-    GNUNET_free (udpw);
+    if (0 == cnt)
+      return;
+    transmit_batch (plugin,
+                    sock,
+                    batch,
+                    addrs,
+                    slens,
+                    cnt);
   }
+  while (UDP_BATCH_SIZE == cnt);
 }
 
 
@@ -4014,6 +4276,9 @@ libgnunet_plugin_transport_udp_init (void *cls)
     GNUNET_free (p);
     return NULL;
   }
+#if HAVE_RECVMMSG
+  p->batch_buf = GNUNET_malloc (UDP_BATCH_SIZE * UDP_BATCH_SLOT_SIZE);
+#endif
 
   /* Setup broadcasting and receiving beacons */
   setup_broadcast (p,
@@ -4162,6 +4427,7 @@ libgnunet_plugin_transport_udp_done (void *cls)
     }
     GNUNET_free (cur);
   }
+  GNUNET_free_non_null (plugin->batch_buf);
   GNUNET_free (plugin);
   GNUNET_free (api);
   return NULL;
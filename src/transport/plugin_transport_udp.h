@@ -55,6 +55,19 @@
  */
 #define UDP_MTU 1400
 
+/**
+ * How many datagrams do we read or write with a single system
+ * call (if the platform has recvmmsg/sendmmsg)?
+ */
+#define UDP_BATCH_SIZE 32
+
+/**
+ * Size of each receive buffer of a batch.  Larger than #UDP_MTU
+ * as we do not know the overhead other peers add, but anything
+ * that does not fit is certainly not from a peer of ours.
+ */
+#define UDP_BATCH_SLOT_SIZE 4096
+
 
 GNUNET_NETWORK_STRUCT_BEGIN
 /**
@@ -283,6 +296,13 @@ struct Plugin
    */
   int enable_ipv6;
 
+  /**
+   * Receive buffers for batched reads, #UDP_BATCH_SIZE slots
+   * of #UDP_BATCH_SLOT_SIZE bytes each.  NULL if the platform
+   * does not support reading datagrams in batches.
+   */
+  char *batch_buf;
+
   /**
    * Is IPv4 enabled: #GNUNET_YES or #GNUNET_NO
    */
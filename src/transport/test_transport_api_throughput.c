@@ -0,0 +1,168 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file transport/test_transport_api_throughput.c
+ * @brief measure the packet rate of a transport implementation
+ *
+ * This test sends TOTAL_MSGS small messages of MSG_SIZE bytes from
+ * peer 1 to peer 2 over loopback, each fitting into a single
+ * datagram, and reports how many packets per second were received.
+ */
+#include "platform.h"
+#include "gnunet_transport_service.h"
+#include "gauger.h"
+#include "transport-testing.h"
+
+/**
+ * Total number of messages to send.
+ */
+#define TOTAL_MSGS (1024 * 8)
+
+/**
+ * Size of each message, small enough to never be fragmented.
+ */
+#define MSG_SIZE 1024
+
+/**
+ * Testcase timeout
+ */
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 300)
+
+
+static struct GNUNET_TRANSPORT_TESTING_ConnectCheckContext *ccc;
+
+/**
+ * Time of start
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * Number of messages received.
+ */
+static unsigned int msg_recv;
+
+
+/**
+ * Implementation of the callback for obtaining the
+ * size of messages for transmission.
+ *
+ * @param cnt_down count down from `TOTAL_MSGS - 1`
+ * @return message size of the message
+ */
+static size_t
+get_size_cnt (unsigned int cnt_down)
+{
+  return MSG_SIZE;
+}
+
+
+static void
+custom_shutdown (void *cls)
+{
+  unsigned long long delta;
+  unsigned long long pps;
+  unsigned long long rate;
+  char *value_name;
+
+  delta = GNUNET_TIME_absolute_get_duration (start_time).rel_value_us;
+  if (0 == delta)
+    delta = 1;
+  pps = (1000LL * 1000LL * msg_recv) / delta;
+  rate = (1000LL * 1000LL * msg_recv * MSG_SIZE) / (1024 * delta);
+  FPRINTF (stderr,
+           "\nReceived %u of %u messages, %llu packets/s, %llu KiBytes/s\n",
+           msg_recv,
+           TOTAL_MSGS,
+           pps,
+           rate);
+  GNUNET_asprintf (&value_name,
+                   "packet_rate_%s",
+                   ccc->test_plugin);
+  GAUGER ("TRANSPORT",
+          value_name,
+          (int) pps,
+          "packets/s");
+  GNUNET_free (value_name);
+}
+
+
+static void
+notify_receive (void *cls,
+                struct GNUNET_TRANSPORT_TESTING_PeerContext *receiver,
+                const struct GNUNET_PeerIdentity *sender,
+                const struct GNUNET_TRANSPORT_TESTING_TestMessage *hdr)
+{
+  if (GNUNET_TRANSPORT_TESTING_SIMPLE_MTYPE != ntohs (hdr->header.type))
+    return;
+  if (MSG_SIZE != ntohs (hdr->header.size))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Expected message %u of size %u, got %u bytes\n",
+                ntohl (hdr->num),
+                MSG_SIZE,
+                ntohs (hdr->header.size));
+    ccc->global_ret = GNUNET_SYSERR;
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  msg_recv++;
+  if (0 == (msg_recv % (TOTAL_MSGS / 100)))
+    FPRINTF (stderr, "%s", ".");
+  if (TOTAL_MSGS == msg_recv)
+  {
+    /* end testcase with success */
+    ccc->global_ret = GNUNET_OK;
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_TRANSPORT_TESTING_SendClosure sc = {
+    .num_messages = TOTAL_MSGS,
+    .get_size_cb = &get_size_cnt
+  };
+  struct GNUNET_TRANSPORT_TESTING_ConnectCheckContext my_ccc = {
+    .connect_continuation = &GNUNET_TRANSPORT_TESTING_simple_send,
+    .connect_continuation_cls = &sc,
+    .config_file = "test_transport_api_data.conf",
+    .rec = &notify_receive,
+    .nc = &GNUNET_TRANSPORT_TESTING_log_connect,
+    .nd = &GNUNET_TRANSPORT_TESTING_log_disconnect,
+    .shutdown_task = &custom_shutdown,
+    .timeout = TIMEOUT,
+    .global_ret = GNUNET_SYSERR
+  };
+
+  ccc = &my_ccc;
+  sc.ccc = ccc;
+  start_time = GNUNET_TIME_absolute_get ();
+  if (GNUNET_OK !=
+      GNUNET_TRANSPORT_TESTING_main (2,
+                                     &GNUNET_TRANSPORT_TESTING_connect_check,
+                                     ccc))
+    return 1;
+  return 0;
+}
+
+
+/* end of test_transport_api_throughput.c */
@@ -1604,6 +1604,66 @@ GNUNET_CONNECTION_notify_transmit_ready_cancel (struct GNUNET_CONNECTION_Transmi
 }
 
 
+#ifndef MINGW
+/**
+ * Try to send data from several buffers directly on the socket,
+ * bypassing the write buffer.  This is only possible while the
+ * connection is established, has no buffered data and no
+ * transmission request is pending, as data would be reordered
+ * otherwise.
+ *
+ * @param connection connection to send on
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, which may be less than requested;
+ *         0 if the socket is not writable right now or direct
+ *         sending is not possible at this time (use
+ *         #GNUNET_CONNECTION_notify_transmit_ready() instead);
+ *         #GNUNET_SYSERR if sending failed, in which case the
+ *         connection should be destroyed
+ */
+ssize_t
+GNUNET_CONNECTION_sendv (struct GNUNET_CONNECTION_Handle *connection,
+                         const struct iovec *iov,
+                         unsigned int iovcnt)
+{
+  ssize_t ret;
+
+  if ( (NULL == connection->sock) ||
+       (NULL != connection->write_task) ||
+       (NULL != connection->nth.notify_ready) ||
+       (connection->write_buffer_off != connection->write_buffer_pos) )
+    return 0;
+RETRY:
+  ret = GNUNET_NETWORK_socket_sendv (connection->sock,
+                                     iov,
+                                     iovcnt);
+  if (-1 == ret)
+  {
+    if (EINTR == errno)
+      goto RETRY;
+    if ( (EAGAIN == errno) ||
+         (EWOULDBLOCK == errno) )
+      return 0;
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Direct transmission to `%s' failed: %s (%p)\n",
+         GNUNET_a2s (connection->addr,
+                     connection->addrlen),
+         STRERROR (errno),
+         connection);
+    return GNUNET_SYSERR;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Connection transmitted %u bytes directly to `%s' (%p)\n",
+       (unsigned int) ret,
+       GNUNET_a2s (connection->addr,
+                   connection->addrlen),
+       connection);
+  return ret;
+}
+#endif
+
+
 /**
  * Create a connection to be proxied using a given connection.
  *
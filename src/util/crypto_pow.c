@@ -0,0 +1,595 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file util/crypto_pow.c
+ * @brief proof-of-work hashing and searching, as used by NSE and
+ *        revocation
+ *
+ * The search runs in worker threads, which only compute hashes and
+ * never call into the rest of GNUnet.  Worker i of n tries the nonces
+ * start + i, start + i + n, ...; so all nonces below the smallest
+ * nonce any worker is about to try have been covered, which is what
+ * we report as progress.  A worker that finds a proof writes a byte
+ * into a pipe watched by the scheduler, so the result is reported
+ * from the main thread.
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gcrypt.h>
+#include <pthread.h>
+
+#define LOG(kind,...) GNUNET_log_from (kind, "util-crypto-pow", __VA_ARGS__)
+
+/**
+ * Number of hashes a worker computes before it publishes its
+ * progress, checks if it should stop and pauses.
+ */
+#define ROUND_SIZE 10
+
+/**
+ * Upper limit for the number of workers.
+ */
+#define MAX_WORKERS 256
+
+
+/**
+ * Calculate the 'proof-of-work' hash (an expensive hash) of a
+ * buffer, using SCRYPT keyed with @a salt.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param buf data to hash
+ * @param buf_len number of bytes in @a buf
+ * @param result where to write the resulting hash
+ */
+void
+GNUNET_CRYPTO_pow_hash (const char *salt,
+                        const void *buf,
+                        size_t buf_len,
+                        struct GNUNET_HashCode *result)
+{
+  GNUNET_break (0 ==
+		gcry_kdf_derive (buf, buf_len,
+				 GCRY_KDF_SCRYPT,
+				 1 /* subalgo */,
+				 salt,
+				 strlen (salt),
+				 2 /* iterations; keep cost of individual op small */,
+				 sizeof (struct GNUNET_HashCode),
+				 result));
+}
+
+
+/**
+ * Count the leading zeroes in a hash.
+ *
+ * @param hash hash to count leading zeros in
+ * @return the number of leading zero bits
+ */
+unsigned int
+GNUNET_CRYPTO_hash_count_leading_zeros (const struct GNUNET_HashCode *hash)
+{
+  unsigned int hash_count;
+
+  hash_count = 0;
+  while ( (hash_count < sizeof (struct GNUNET_HashCode) * 8) &&
+          (0 == GNUNET_CRYPTO_hash_get_bit (hash,
+                                            hash_count)) )
+    hash_count++;
+  return hash_count;
+}
+
+
+/**
+ * Check if a nonce is a valid proof of work for some data.  The
+ * proof-of-work hash is computed over the nonce (in host byte order)
+ * followed by @a data.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param data data the proof is for, usually a public key
+ * @param data_size number of bytes in @a data
+ * @param nonce the proof to check
+ * @param bits number of leading zero bits required
+ * @return #GNUNET_YES if @a nonce is valid, #GNUNET_NO if not
+ */
+int
+GNUNET_CRYPTO_pow_check (const char *salt,
+                         const void *data,
+                         size_t data_size,
+                         uint64_t nonce,
+                         unsigned int bits)
+{
+  char buf[sizeof (uint64_t) + data_size] GNUNET_ALIGN;
+  struct GNUNET_HashCode result;
+
+  GNUNET_memcpy (buf,
+                 &nonce,
+                 sizeof (nonce));
+  GNUNET_memcpy (&buf[sizeof (nonce)],
+                 data,
+                 data_size);
+  GNUNET_CRYPTO_pow_hash (salt,
+                          buf,
+                          sizeof (buf),
+                          &result);
+  return (GNUNET_CRYPTO_hash_count_leading_zeros (&result) >= bits)
+    ? GNUNET_YES
+    : GNUNET_NO;
+}
+
+
+/**
+ * A thread of a search.
+ */
+struct Worker
+{
+  /**
+   * The search the worker belongs to.
+   */
+  struct GNUNET_CRYPTO_PowSearch *ps;
+
+  /**
+   * The thread.
+   */
+  pthread_t thread;
+
+  /**
+   * Next nonce the worker will try.  Protected by the lock of @e ps.
+   */
+  uint64_t next;
+};
+
+
+/**
+ * Handle for a proof-of-work search.
+ */
+struct GNUNET_CRYPTO_PowSearch
+{
+  /**
+   * Salt for the hash.
+   */
+  char *salt;
+
+  /**
+   * Room for the nonce, followed by the data the proof is for.
+   */
+  char *buf;
+
+  /**
+   * Number of bytes in @e buf.
+   */
+  size_t buf_len;
+
+  /**
+   * Number of leading zero bits required.
+   */
+  unsigned int bits;
+
+  /**
+   * How long workers pause after each round.
+   */
+  struct GNUNET_TIME_Relative delay;
+
+  /**
+   * How often to report progress.
+   */
+  struct GNUNET_TIME_Relative checkpoint_freq;
+
+  /**
+   * Function to call with progress and the result.
+   */
+  GNUNET_CRYPTO_PowCallback cb;
+
+  /**
+   * Closure for @e cb.
+   */
+  void *cb_cls;
+
+  /**
+   * Array of @e num_workers workers.
+   */
+  struct Worker *workers;
+
+  /**
+   * Number of running workers.
+   */
+  unsigned int num_workers;
+
+  /**
+   * Protects @e workers' progress, @e stop, @e found and @e result.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when the workers should stop.
+   */
+  pthread_cond_t cond;
+
+  /**
+   * #GNUNET_YES if the workers should stop.
+   */
+  int stop;
+
+  /**
+   * #GNUNET_YES if @e result is a valid proof.
+   */
+  int found;
+
+  /**
+   * The proof found.
+   */
+  uint64_t result;
+
+  /**
+   * Pipe the workers use to tell the scheduler about a result.
+   */
+  struct GNUNET_DISK_PipeHandle *pipe;
+
+  /**
+   * Task waiting for a result on @e pipe.
+   */
+  struct GNUNET_SCHEDULER_Task *result_task;
+
+  /**
+   * Task to report progress.
+   */
+  struct GNUNET_SCHEDULER_Task *checkpoint_task;
+};
+
+
+/**
+ * Main function of a worker.
+ *
+ * @param cls the `struct Worker`
+ * @return NULL
+ */
+static void *
+worker_main (void *cls)
+{
+  struct Worker *w = cls;
+  struct GNUNET_CRYPTO_PowSearch *ps = w->ps;
+  char buf[ps->buf_len] GNUNET_ALIGN;
+  struct GNUNET_HashCode result;
+  struct GNUNET_TIME_Absolute wake;
+  struct timespec ts;
+  uint64_t nonce;
+  uint64_t stride;
+  int stop;
+
+  GNUNET_memcpy (buf,
+                 ps->buf,
+                 ps->buf_len);
+  pthread_mutex_lock (&ps->lock);
+  /* only set once all workers are created, see
+     #GNUNET_CRYPTO_pow_search_start() */
+  stride = ps->num_workers;
+  nonce = w->next;
+  stop = ps->stop;
+  pthread_mutex_unlock (&ps->lock);
+  while (GNUNET_YES != stop)
+  {
+    for (unsigned int i=0;i<ROUND_SIZE;i++)
+    {
+      GNUNET_memcpy (buf,
+                     &nonce,
+                     sizeof (nonce));
+      GNUNET_CRYPTO_pow_hash (ps->salt,
+                              buf,
+                              ps->buf_len,
+                              &result);
+      if (GNUNET_CRYPTO_hash_count_leading_zeros (&result) >= ps->bits)
+      {
+        char c = 0;
+
+        pthread_mutex_lock (&ps->lock);
+        if (GNUNET_NO == ps->found)
+        {
+          ps->found = GNUNET_YES;
+          ps->result = nonce;
+          (void) GNUNET_DISK_file_write (GNUNET_DISK_pipe_handle (ps->pipe,
+                                                                  GNUNET_DISK_PIPE_END_WRITE),
+                                         &c,
+                                         sizeof (c));
+        }
+        ps->stop = GNUNET_YES;
+        pthread_mutex_unlock (&ps->lock);
+        return NULL;
+      }
+      if (UINT64_MAX - stride < nonce)
+      {
+        /* exhausted our share of the nonces */
+        pthread_mutex_lock (&ps->lock);
+        w->next = nonce;
+        pthread_mutex_unlock (&ps->lock);
+        return NULL;
+      }
+      nonce += stride;
+    }
+    pthread_mutex_lock (&ps->lock);
+    w->next = nonce;
+    if ( (GNUNET_YES != ps->stop) &&
+         (0 != ps->delay.rel_value_us) )
+    {
+      wake = GNUNET_TIME_relative_to_absolute (ps->delay);
+      ts.tv_sec = wake.abs_value_us / 1000000LL;
+      ts.tv_nsec = (wake.abs_value_us % 1000000LL) * 1000LL;
+      (void) pthread_cond_timedwait (&ps->cond,
+                                     &ps->lock,
+                                     &ts);
+    }
+    stop = ps->stop;
+    pthread_mutex_unlock (&ps->lock);
+  }
+  return NULL;
+}
+
+
+/**
+ * Compute the nonce up to which the search is complete.
+ *
+ * @param ps the search
+ * @return the smallest nonce any worker is about to try
+ */
+static uint64_t
+get_checkpoint (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  uint64_t min;
+
+  min = UINT64_MAX;
+  pthread_mutex_lock (&ps->lock);
+  for (unsigned int i=0;i<ps->num_workers;i++)
+    min = GNUNET_MIN (min,
+                      ps->workers[i].next);
+  pthread_mutex_unlock (&ps->lock);
+  return min;
+}
+
+
+/**
+ * Stop the workers and release the search.
+ *
+ * @param ps search to stop
+ */
+static void
+stop_search (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  pthread_mutex_lock (&ps->lock);
+  ps->stop = GNUNET_YES;
+  pthread_cond_broadcast (&ps->cond);
+  pthread_mutex_unlock (&ps->lock);
+  for (unsigned int i=0;i<ps->num_workers;i++)
+    GNUNET_break (0 ==
+                  pthread_join (ps->workers[i].thread,
+                                NULL));
+  if (NULL != ps->result_task)
+  {
+    GNUNET_SCHEDULER_cancel (ps->result_task);
+    ps->result_task = NULL;
+  }
+  if (NULL != ps->checkpoint_task)
+  {
+    GNUNET_SCHEDULER_cancel (ps->checkpoint_task);
+    ps->checkpoint_task = NULL;
+  }
+  GNUNET_DISK_pipe_close (ps->pipe);
+  pthread_cond_destroy (&ps->cond);
+  pthread_mutex_destroy (&ps->lock);
+  GNUNET_free (ps->workers);
+  GNUNET_free (ps->buf);
+  GNUNET_free (ps->salt);
+  GNUNET_free (ps);
+}
+
+
+/**
+ * A worker found a proof, report it.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PowSearch`
+ */
+static void
+result_cb (void *cls)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps = cls;
+  GNUNET_CRYPTO_PowCallback cb;
+  void *cb_cls;
+  uint64_t result;
+
+  ps->result_task = NULL;
+  pthread_mutex_lock (&ps->lock);
+  GNUNET_assert (GNUNET_YES == ps->found);
+  result = ps->result;
+  pthread_mutex_unlock (&ps->lock);
+  cb = ps->cb;
+  cb_cls = ps->cb_cls;
+  stop_search (ps);
+  cb (cb_cls,
+      result,
+      GNUNET_YES);
+}
+
+
+/**
+ * Report the progress of a search.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PowSearch`
+ */
+static void
+checkpoint_cb (void *cls)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps = cls;
+
+  ps->checkpoint_task
+    = GNUNET_SCHEDULER_add_delayed (ps->checkpoint_freq,
+                                    &checkpoint_cb,
+                                    ps);
+  ps->cb (ps->cb_cls,
+          get_checkpoint (ps),
+          GNUNET_NO);
+}
+
+
+/**
+ * Get the number of CPUs available to us.
+ *
+ * @return number of CPUs, at least 1
+ */
+static unsigned int
+get_num_cpus ()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long n;
+
+  n = sysconf (_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    return (unsigned int) GNUNET_MIN (n,
+                                      MAX_WORKERS);
+#endif
+  return 1;
+}
+
+
+/**
+ * Start searching for a proof of work, see #GNUNET_CRYPTO_pow_check().
+ * The nonce space is split across @a workers threads; results and
+ * progress are reported from the scheduler.
+ *
+ * @param salt salt for the hash, specific to the application
+ * @param data data the proof is for, usually a public key
+ * @param data_size number of bytes in @a data
+ * @param start first nonce to try
+ * @param bits number of leading zero bits required
+ * @param workers number of threads to use, 0 for one per CPU
+ * @param delay how long each thread pauses after every few hashes,
+ *        to limit the CPU load
+ * @param checkpoint_freq how often to report progress to @a cb
+ * @param cb function to call with progress and the result
+ * @param cb_cls closure for @a cb
+ * @return NULL on error
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_CRYPTO_pow_search_start (const char *salt,
+                                const void *data,
+                                size_t data_size,
+                                uint64_t start,
+                                unsigned int bits,
+                                unsigned int workers,
+                                struct GNUNET_TIME_Relative delay,
+                                struct GNUNET_TIME_Relative checkpoint_freq,
+                                GNUNET_CRYPTO_PowCallback cb,
+                                void *cb_cls)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps;
+  unsigned int n;
+
+  if (0 == workers)
+    workers = get_num_cpus ();
+  workers = GNUNET_MIN (workers,
+                        MAX_WORKERS);
+  ps = GNUNET_new (struct GNUNET_CRYPTO_PowSearch);
+  ps->pipe = GNUNET_DISK_pipe (GNUNET_NO,
+                               GNUNET_NO,
+                               GNUNET_NO,
+                               GNUNET_NO);
+  if (NULL == ps->pipe)
+  {
+    GNUNET_free (ps);
+    return NULL;
+  }
+  ps->salt = GNUNET_strdup (salt);
+  ps->buf_len = sizeof (uint64_t) + data_size;
+  ps->buf = GNUNET_malloc (ps->buf_len);
+  GNUNET_memcpy (&ps->buf[sizeof (uint64_t)],
+                 data,
+                 data_size);
+  ps->bits = bits;
+  ps->delay = delay;
+  ps->checkpoint_freq = checkpoint_freq;
+  ps->cb = cb;
+  ps->cb_cls = cb_cls;
+  ps->stop = GNUNET_NO;
+  ps->found = GNUNET_NO;
+  pthread_mutex_init (&ps->lock,
+                      NULL);
+  pthread_cond_init (&ps->cond,
+                     NULL);
+  ps->workers = GNUNET_new_array (workers,
+                                  struct Worker);
+  /* the workers read the stride from 'num_workers', so hold them
+     back until we know how many threads we actually got */
+  pthread_mutex_lock (&ps->lock);
+  for (n=0;n<workers;n++)
+  {
+    ps->workers[n].ps = ps;
+    ps->workers[n].next = start + n;
+    if (0 != pthread_create (&ps->workers[n].thread,
+                             NULL,
+                             &worker_main,
+                             &ps->workers[n]))
+    {
+      LOG (GNUNET_ERROR_TYPE_WARNING,
+           "Failed to create thread: %s\n",
+           STRERROR (errno));
+      break;
+    }
+  }
+  ps->num_workers = n;
+  pthread_mutex_unlock (&ps->lock);
+  if (0 == n)
+  {
+    stop_search (ps);
+    return NULL;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Searching for a %u-bit proof of work from %llu with %u threads\n",
+       bits,
+       (unsigned long long) start,
+       n);
+  ps->result_task
+    = GNUNET_SCHEDULER_add_read_file (GNUNET_TIME_UNIT_FOREVER_REL,
+                                      GNUNET_DISK_pipe_handle (ps->pipe,
+                                                               GNUNET_DISK_PIPE_END_READ),
+                                      &result_cb,
+                                      ps);
+  ps->checkpoint_task
+    = GNUNET_SCHEDULER_add_delayed (checkpoint_freq,
+                                    &checkpoint_cb,
+                                    ps);
+  return ps;
+}
+
+
+/**
+ * Stop a proof-of-work search.
+ *
+ * @param ps search to stop
+ * @return nonce to resume the search at, see #GNUNET_CRYPTO_PowCallback
+ */
+uint64_t
+GNUNET_CRYPTO_pow_search_cancel (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  uint64_t checkpoint;
+
+  checkpoint = get_checkpoint (ps);
+  stop_search (ps);
+  return checkpoint;
+}
+
+
+/* end of crypto_pow.c */
@@ -180,6 +180,151 @@ GNUNET_CRYPTO_symmetric_decrypt (const void *block,
 }
 
 
+/**
+ * Initialize AES-GCM cipher for authenticated encryption.
+ *
+ * @param handle handle to initialize
+ * @param sessionkey session key to use
+ * @param nonce nonce to use
+ * @param aad additional data to authenticate, can be NULL
+ * @param aad_size number of bytes in @a aad
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ */
+static int
+setup_cipher_aead (gcry_cipher_hd_t *handle,
+                   const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
+                   const struct GNUNET_CRYPTO_AeadNonce *nonce,
+                   const void *aad,
+                   size_t aad_size)
+{
+  int rc;
+
+  GNUNET_assert (0 ==
+                 gcry_cipher_open (handle, GCRY_CIPHER_AES256,
+                                   GCRY_CIPHER_MODE_GCM, 0));
+  rc = gcry_cipher_setkey (*handle,
+                           sessionkey->aes_key,
+                           sizeof (sessionkey->aes_key));
+  GNUNET_assert ((0 == rc) || ((char) rc == GPG_ERR_WEAK_KEY));
+  GNUNET_assert (0 ==
+                 gcry_cipher_setiv (*handle,
+                                    nonce->nonce,
+                                    sizeof (nonce->nonce)));
+  if ( (0 != aad_size) &&
+       (0 != gcry_cipher_authenticate (*handle,
+                                       aad,
+                                       aad_size)) )
+  {
+    gcry_cipher_close (*handle);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Encrypt and authenticate a block in a single pass (AES-256-GCM).
+ * Only the @e aes_key of @a sessionkey is used.
+ *
+ * @param block the block to encrypt
+ * @param size the size of the @a block
+ * @param aad additional data to authenticate (but not encrypt), can be NULL
+ * @param aad_size number of bytes in @a aad
+ * @param sessionkey the key used to encrypt
+ * @param nonce the nonce to use, must be unique for @a sessionkey
+ * @param result where to store the encrypted result, can be @a block
+ * @param[out] tag set to the authentication tag
+ * @return the size of the encrypted block (@a size), -1 for errors
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_aead_encrypt (const void *block,
+                                      size_t size,
+                                      const void *aad,
+                                      size_t aad_size,
+                                      const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
+                                      const struct GNUNET_CRYPTO_AeadNonce *nonce,
+                                      void *result,
+                                      struct GNUNET_CRYPTO_AeadTag *tag)
+{
+  gcry_cipher_hd_t handle;
+  int rc;
+
+  if (GNUNET_OK != setup_cipher_aead (&handle,
+                                      sessionkey,
+                                      nonce,
+                                      aad,
+                                      aad_size))
+    return -1;
+  if (block == result)
+    rc = gcry_cipher_encrypt (handle, result, size, NULL, 0);
+  else
+    rc = gcry_cipher_encrypt (handle, result, size, block, size);
+  if ( (0 != rc) ||
+       (0 != gcry_cipher_gettag (handle,
+                                 tag->tag,
+                                 sizeof (tag->tag))) )
+  {
+    gcry_cipher_close (handle);
+    return -1;
+  }
+  gcry_cipher_close (handle);
+  return size;
+}
+
+
+/**
+ * Decrypt a block encrypted with
+ * #GNUNET_CRYPTO_symmetric_aead_encrypt() and check its
+ * authentication tag.
+ *
+ * @param block the data to decrypt
+ * @param size the size of the @a block
+ * @param aad additional authenticated data, can be NULL
+ * @param aad_size number of bytes in @a aad
+ * @param sessionkey the key used to decrypt
+ * @param nonce the nonce used for encryption
+ * @param tag the authentication tag to check
+ * @param result where to store the plaintext, can be @a block
+ * @return the size of the decrypted block (@a size), -1 if the
+ *         tag does not match (the contents of @a result are
+ *         then undefined)
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_aead_decrypt (const void *block,
+                                      size_t size,
+                                      const void *aad,
+                                      size_t aad_size,
+                                      const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
+                                      const struct GNUNET_CRYPTO_AeadNonce *nonce,
+                                      const struct GNUNET_CRYPTO_AeadTag *tag,
+                                      void *result)
+{
+  gcry_cipher_hd_t handle;
+  int rc;
+
+  if (GNUNET_OK != setup_cipher_aead (&handle,
+                                      sessionkey,
+                                      nonce,
+                                      aad,
+                                      aad_size))
+    return -1;
+  if (block == result)
+    rc = gcry_cipher_decrypt (handle, result, size, NULL, 0);
+  else
+    rc = gcry_cipher_decrypt (handle, result, size, block, size);
+  if ( (0 != rc) ||
+       (0 != gcry_cipher_checktag (handle,
+                                   tag->tag,
+                                   sizeof (tag->tag))) )
+  {
+    gcry_cipher_close (handle);
+    return -1;
+  }
+  gcry_cipher_close (handle);
+  return size;
+}
+
+
 /**
  * @brief Derive an IV
  *
@@ -24,7 +24,11 @@
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
-#include <gcrypt.h>
+
+/**
+ * How often do we save and report our progress?
+ */
+#define CHECKPOINT_FREQUENCY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 10)
 
 /**
  * Amount of work required (W-bit collisions) for NSE proofs, in collision-bits.
@@ -36,11 +40,20 @@ static unsigned long long nse_work_required;
  */
 static struct GNUNET_TIME_Relative proof_find_delay;
 
+/**
+ * Number of threads to use, 0 for one per CPU.
+ */
+static unsigned long long num_workers;
+
 static struct GNUNET_CRYPTO_EddsaPublicKey pub;
 
 static uint64_t proof;
 
-static struct GNUNET_SCHEDULER_Task *proof_task;
+static struct GNUNET_CRYPTO_PowSearch *proof_search;
+
+static struct GNUNET_TIME_Absolute start_time;
+
+static uint64_t start_proof;
 
 static const struct GNUNET_CONFIGURATION_Handle *cfg;
 
@@ -51,11 +64,9 @@ static char *pwfn;
 
 /**
  * Write our current proof to disk.
- *
- * @param cls closure
  */
 static void
-shutdown_task (void *cls)
+write_proof ()
 {
   if (sizeof (proof) !=
       GNUNET_DISK_fn_write (pwfn,
@@ -70,109 +81,54 @@ shutdown_task (void *cls)
 
 
 /**
- * Calculate the 'proof-of-work' hash (an expensive hash).
+ * Stop the search and write our current proof to disk.
  *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
+ * @param cls closure
  */
 static void
-pow_hash (const void *buf,
-          size_t buf_len,
-          struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-  gcry_kdf_derive (buf, buf_len,
-                   GCRY_KDF_SCRYPT,
-                   1 /* subalgo */,
-                   "gnunet-proof-of-work", strlen ("gnunet-proof-of-work"),
-                   2 /* iterations; keep cost of individual op small */,
-                   sizeof (struct GNUNET_HashCode), result));
-}
-
-
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
+shutdown_task (void *cls)
 {
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while (0 == GNUNET_CRYPTO_hash_get_bit (hash, hash_count))
-    hash_count++;
-  return hash_count;
+  if (NULL != proof_search)
+  {
+    proof = GNUNET_CRYPTO_pow_search_cancel (proof_search);
+    proof_search = NULL;
+  }
+  write_proof ();
 }
 
 
 /**
- * Find our proof of work.
+ * Called by the search with our progress and the result.
  *
  * @param cls closure (unused)
- * @param tc task context
+ * @param nonce the proof found, or the value to resume the search at
+ * @param found #GNUNET_YES if @a nonce is the proof
  */
 static void
-find_proof (void *cls)
+proof_cb (void *cls,
+          uint64_t nonce,
+          int found)
 {
-  #define ROUND_SIZE 10
-  uint64_t counter;
-  char buf[sizeof (struct GNUNET_CRYPTO_EddsaPublicKey) +
-           sizeof (uint64_t)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-  unsigned int i;
-  struct GNUNET_TIME_Absolute timestamp;
   struct GNUNET_TIME_Relative elapsed;
 
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-	      "Got Proof of Work %llu\n",
-	      (unsigned long long) proof);
-  proof_task = NULL;
-  GNUNET_memcpy (&buf[sizeof (uint64_t)], &pub,
-          sizeof (struct GNUNET_CRYPTO_EddsaPublicKey));
-  i = 0;
-  counter = proof;
-  timestamp = GNUNET_TIME_absolute_get ();
-  while ((counter != UINT64_MAX) && (i < ROUND_SIZE))
+  proof = nonce;
+  if (GNUNET_YES == found)
   {
-    GNUNET_memcpy (buf, &counter, sizeof (uint64_t));
-    pow_hash (buf, sizeof (buf), &result);
-    if (nse_work_required <= count_leading_zeroes (&result))
-    {
-      proof = counter;
-      FPRINTF (stdout, "Proof of work found: %llu!\n",
-               (unsigned long long) proof);
-      GNUNET_SCHEDULER_shutdown ();
-      return;
-    }
-    counter++;
-    i++;
+    proof_search = NULL;
+    FPRINTF (stdout, "Proof of work found: %llu!\n",
+             (unsigned long long) proof);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
   }
-  elapsed = GNUNET_TIME_absolute_get_duration (timestamp);
-  elapsed = GNUNET_TIME_relative_divide (elapsed, ROUND_SIZE);
+  elapsed = GNUNET_TIME_absolute_get_duration (start_time);
+  if (nonce > start_proof)
+    elapsed = GNUNET_TIME_relative_divide (elapsed,
+                                           nonce - start_proof);
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Current: %llu [%s/proof]\n",
-              (unsigned long long) counter,
+              (unsigned long long) nonce,
               GNUNET_STRINGS_relative_time_to_string (elapsed, 0));
-  if (proof / (100 * ROUND_SIZE) < counter / (100 * ROUND_SIZE))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Testing proofs currently at %llu\n",
-                (unsigned long long) counter);
-    /* remember progress every 100 rounds */
-    proof = counter;
-    shutdown_task (NULL);
-  }
-  else
-  {
-    proof = counter;
-  }
-  proof_task =
-    GNUNET_SCHEDULER_add_delayed_with_priority (proof_find_delay,
-						GNUNET_SCHEDULER_PRIORITY_IDLE,
-						&find_proof, NULL);
+  write_proof ();
 }
 
 
@@ -290,10 +246,24 @@ run (void *cls,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Delay between tries: %s\n",
               GNUNET_STRINGS_relative_time_to_string (proof_find_delay, 1));
-  proof_task =
-    GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
-					&find_proof,
-					NULL);
+  start_time = GNUNET_TIME_absolute_get ();
+  start_proof = proof;
+  proof_search
+    = GNUNET_CRYPTO_pow_search_start ("gnunet-proof-of-work",
+                                      &pub,
+                                      sizeof (pub),
+                                      proof,
+                                      (unsigned int) nse_work_required,
+                                      (unsigned int) num_workers,
+                                      proof_find_delay,
+                                      CHECKPOINT_FREQUENCY,
+                                      &proof_cb,
+                                      NULL);
+  if (NULL == proof_search)
+  {
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
   GNUNET_SCHEDULER_add_shutdown (&shutdown_task,
 				 NULL);
 }
@@ -322,6 +292,9 @@ main (int argc, char *const *argv)
     { 't', "timeout", "TIME",
       gettext_noop ("time to wait between calculations"),
       1, &GNUNET_GETOPT_set_relative_time, &proof_find_delay },
+    { 'w', "workers", "COUNT",
+      gettext_noop ("number of threads to use, 0 for one per CPU"),
+      1, &GNUNET_GETOPT_set_ulong, &num_workers },
     GNUNET_GETOPT_OPTION_END
   };
   int ret;
@@ -911,6 +911,109 @@ GNUNET_NETWORK_socket_send (const struct GNUNET_NETWORK_Handle *desc,
 }
 
 
+#ifndef MINGW
+/**
+ * Send data from several buffers with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, #GNUNET_SYSERR on error
+ */
+ssize_t
+GNUNET_NETWORK_socket_sendv (const struct GNUNET_NETWORK_Handle *desc,
+                             const struct iovec *iov,
+                             unsigned int iovcnt)
+{
+  struct msghdr mh;
+  int flags;
+
+  memset (&mh,
+          0,
+          sizeof (mh));
+  mh.msg_iov = (struct iovec *) iov;
+  mh.msg_iovlen = iovcnt;
+  flags = 0;
+#ifdef MSG_DONTWAIT
+  flags |= MSG_DONTWAIT;
+#endif
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  return sendmsg (desc->fd,
+                  &mh,
+                  flags);
+}
+#endif
+
+
+#if HAVE_RECVMMSG
+/**
+ * Read several datagrams with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param msgs array of @a vlen message headers with the buffers
+ *        to receive into; the length of each datagram received is
+ *        stored in its `msg_len`
+ * @param vlen number of entries in @a msgs
+ * @return number of datagrams received, #GNUNET_SYSERR on error
+ */
+int
+GNUNET_NETWORK_socket_recvmmsg (const struct GNUNET_NETWORK_Handle *desc,
+                                struct mmsghdr *msgs,
+                                unsigned int vlen)
+{
+  int flags;
+
+  flags = 0;
+#ifdef MSG_DONTWAIT
+  flags |= MSG_DONTWAIT;
+#endif
+  return recvmmsg (desc->fd,
+                   msgs,
+                   vlen,
+                   flags,
+                   NULL);
+}
+#endif
+
+
+#if HAVE_SENDMMSG
+/**
+ * Send several datagrams with a single system call
+ * (always non-blocking).
+ *
+ * @param desc socket
+ * @param msgs array of @a vlen messages to send, each with
+ *        its destination address
+ * @param vlen number of entries in @a msgs
+ * @return number of datagrams sent, #GNUNET_SYSERR if
+ *         the first one could not be sent
+ */
+int
+GNUNET_NETWORK_socket_sendmmsg (const struct GNUNET_NETWORK_Handle *desc,
+                                struct mmsghdr *msgs,
+                                unsigned int vlen)
+{
+  int flags;
+
+  flags = 0;
+#ifdef MSG_DONTWAIT
+  flags |= MSG_DONTWAIT;
+#endif
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  return sendmmsg (desc->fd,
+                   msgs,
+                   vlen,
+                   flags);
+}
+#endif
+
+
 /**
  * Send data to a particular destination (always non-blocking).
  * This function only works for UDP sockets.
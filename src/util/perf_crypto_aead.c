@@ -0,0 +1,166 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2016 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file util/perf_crypto_aead.c
+ * @brief measure how many bytes per second a single CPU core can
+ *        encrypt and authenticate, with the AES+Twofish cipher and
+ *        HMAC used by core and with authenticated encryption
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Total number of bytes to encrypt per run.
+ */
+#define TOTAL_BYTES (256 * 1024 * 1024)
+
+
+/**
+ * Encrypt and authenticate messages like the legacy core
+ * protocol does: derive IV and authentication key, encrypt
+ * with AES and Twofish, compute HMAC-SHA512.
+ *
+ * @param buf message to encrypt
+ * @param size number of bytes in @a buf
+ * @param rbuf where to put the result
+ */
+static void
+encrypt_legacy (const char *buf,
+                size_t size,
+                char *rbuf)
+{
+  static const char ctx[] = "perf";
+  struct GNUNET_CRYPTO_SymmetricSessionKey sk;
+  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+  struct GNUNET_CRYPTO_AuthKey ak;
+  struct GNUNET_HashCode hmac;
+  uint32_t seed;
+  unsigned int i;
+
+  GNUNET_CRYPTO_symmetric_create_session_key (&sk);
+  for (i = 0; i < TOTAL_BYTES / size; i++)
+  {
+    seed = i;
+    GNUNET_CRYPTO_symmetric_derive_iv (&iv, &sk,
+                                       &seed, sizeof (seed),
+                                       ctx, sizeof (ctx),
+                                       NULL);
+    GNUNET_assert (size ==
+                   GNUNET_CRYPTO_symmetric_encrypt (buf, size,
+                                                    &sk, &iv,
+                                                    rbuf));
+    GNUNET_CRYPTO_hmac_derive_key (&ak, &sk,
+                                   &seed, sizeof (seed),
+                                   &sk, sizeof (sk),
+                                   ctx, sizeof (ctx),
+                                   NULL);
+    GNUNET_CRYPTO_hmac (&ak, rbuf, size, &hmac);
+  }
+}
+
+
+/**
+ * Encrypt and authenticate messages with AEAD in a single pass.
+ *
+ * @param buf message to encrypt
+ * @param size number of bytes in @a buf
+ * @param rbuf where to put the result
+ */
+static void
+encrypt_aead (const char *buf,
+              size_t size,
+              char *rbuf)
+{
+  struct GNUNET_CRYPTO_SymmetricSessionKey sk;
+  struct GNUNET_CRYPTO_AeadNonce nonce;
+  struct GNUNET_CRYPTO_AeadTag tag;
+  unsigned int i;
+
+  GNUNET_CRYPTO_symmetric_create_session_key (&sk);
+  memset (&nonce, 0, sizeof (nonce));
+  for (i = 0; i < TOTAL_BYTES / size; i++)
+  {
+    memcpy (&nonce, &i, sizeof (i));
+    GNUNET_assert (size ==
+                   GNUNET_CRYPTO_symmetric_aead_encrypt (buf, size,
+                                                         buf, 4,
+                                                         &sk, &nonce,
+                                                         rbuf, &tag));
+  }
+}
+
+
+/**
+ * Run one of the encryption functions and report its throughput.
+ *
+ * @param name name of the cipher suite for the report
+ * @param fun function to run
+ * @param size message size to use
+ */
+static void
+measure (const char *name,
+         void (*fun)(const char *buf,
+                     size_t size,
+                     char *rbuf),
+         size_t size)
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+  char *buf;
+  char *rbuf;
+  char *gauger_name;
+
+  buf = GNUNET_malloc (size);
+  rbuf = GNUNET_malloc (size);
+  memset (buf, 1, size);
+  start = GNUNET_TIME_absolute_get ();
+  fun (buf, size, rbuf);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  rate = (TOTAL_BYTES / 1024 / 1024) * 1000LL * 1000LL
+    / GNUNET_MAX (1, duration.rel_value_us);
+  printf ("%s, %u byte messages: %llu MiB/s\n",
+          name,
+          (unsigned int) size,
+          rate);
+  GNUNET_asprintf (&gauger_name,
+                   "%s encryption of %u byte messages",
+                   name,
+                   (unsigned int) size);
+  GAUGER ("UTIL", gauger_name, rate, "MiB/s");
+  GNUNET_free (gauger_name);
+  GNUNET_free (buf);
+  GNUNET_free (rbuf);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  measure ("AES+Twofish/HMAC", &encrypt_legacy, 1024);
+  measure ("AES-GCM", &encrypt_aead, 1024);
+  measure ("AES+Twofish/HMAC", &encrypt_legacy, 63 * 1024);
+  measure ("AES-GCM", &encrypt_aead, 63 * 1024);
+  return 0;
+}
+
+/* end of perf_crypto_aead.c */
@@ -0,0 +1,201 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file util/perf_crypto_pow.c
+ * @brief measure the proof-of-work hash rate with one thread and
+ *        with one thread per CPU
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * How long to search with each configuration.
+ */
+#define RUN_TIME GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 2)
+
+/**
+ * Salt to use (the one of NSE).
+ */
+#define SALT "gnunet-proof-of-work"
+
+/**
+ * Data the proof is for.
+ */
+static struct GNUNET_CRYPTO_EddsaPublicKey pub;
+
+/**
+ * The running search.
+ */
+static struct GNUNET_CRYPTO_PowSearch *ps;
+
+/**
+ * When did the running search start?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * Number of threads of the running search.
+ */
+static unsigned int workers;
+
+/**
+ * Number of threads to use in the second run.
+ */
+static unsigned int num_cpus;
+
+/**
+ * Return value from main().
+ */
+static int ret;
+
+
+/**
+ * We never find a proof, as we need all bits to be zero.
+ *
+ * @param cls NULL
+ * @param nonce checkpoint
+ * @param found #GNUNET_YES if a proof was found
+ */
+static void
+pow_cb (void *cls,
+        uint64_t nonce,
+        int found)
+{
+  if (GNUNET_YES == found)
+  {
+    GNUNET_break (0);
+    ps = NULL;
+    ret = 1;
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+/**
+ * Start a search with #workers threads.
+ */
+static void
+start_search ()
+{
+  start_time = GNUNET_TIME_absolute_get ();
+  ps = GNUNET_CRYPTO_pow_search_start (SALT,
+                                       &pub,
+                                       sizeof (pub),
+                                       0,
+                                       sizeof (struct GNUNET_HashCode) * 8,
+                                       workers,
+                                       GNUNET_TIME_UNIT_ZERO,
+                                       GNUNET_TIME_UNIT_FOREVER_REL,
+                                       &pow_cb,
+                                       NULL);
+  if (NULL == ps)
+  {
+    ret = 1;
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+/**
+ * Stop the running search and report its hash rate.
+ *
+ * @param cls NULL
+ */
+static void
+stop_search (void *cls)
+{
+  struct GNUNET_TIME_Relative duration;
+  uint64_t hashes;
+  char gauger_name[64];
+
+  if (NULL == ps)
+    return;
+  hashes = GNUNET_CRYPTO_pow_search_cancel (ps);
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  ps = NULL;
+  FPRINTF (stderr,
+           "%u thread(s): %llu hashes in %s, %llu hashes/s per core\n",
+           workers,
+           (unsigned long long) hashes,
+           GNUNET_STRINGS_relative_time_to_string (duration,
+                                                   GNUNET_YES),
+           (unsigned long long) (hashes * 1000LL * 1000LL
+                                 / (1 + duration.rel_value_us)
+                                 / workers));
+  GNUNET_snprintf (gauger_name,
+                   sizeof (gauger_name),
+                   "Proof-of-work with %s thread(s)",
+                   (1 == workers) ? "1" : "all");
+  GAUGER ("UTIL",
+          gauger_name,
+          hashes * 1000LL * 1000LL / (1 + duration.rel_value_us) / workers,
+          "hashes/s per core");
+  if ( (1 == workers) &&
+       (1 < num_cpus) )
+  {
+    workers = num_cpus;
+    start_search ();
+    if (NULL != ps)
+      GNUNET_SCHEDULER_add_delayed (RUN_TIME,
+                                    &stop_search,
+                                    NULL);
+  }
+}
+
+
+/**
+ * Run the benchmark.
+ *
+ * @param cls NULL
+ */
+static void
+run (void *cls)
+{
+  workers = 1;
+  start_search ();
+  if (NULL != ps)
+    GNUNET_SCHEDULER_add_delayed (RUN_TIME,
+                                  &stop_search,
+                                  NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("perf-crypto-pow",
+                    "WARNING",
+                    NULL);
+  num_cpus = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  if (sysconf (_SC_NPROCESSORS_ONLN) > 1)
+    num_cpus = (unsigned int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+  memset (&pub,
+          42,
+          sizeof (pub));
+  GNUNET_SCHEDULER_run (&run,
+                        NULL);
+  return ret;
+}
+
+/* end of perf_crypto_pow.c */
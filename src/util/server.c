@@ -1605,6 +1605,39 @@ GNUNET_SERVER_client_disable_corking (struct GNUNET_SERVER_Client *client)
 }
 
 
+#ifndef MINGW
+/**
+ * Try to send data from several buffers to the given client
+ * directly, without copying it into the write buffer first.
+ * Only possible while no transmission request is pending.
+ *
+ * @param client client to transmit to
+ * @param iov buffers to send, in order
+ * @param iovcnt number of entries in @a iov
+ * @return number of bytes sent, which may be less than requested;
+ *         0 if nothing could be sent right now (use
+ *         #GNUNET_SERVER_notify_transmit_ready() instead);
+ *         #GNUNET_SYSERR on errors
+ */
+ssize_t
+GNUNET_SERVER_client_sendv (struct GNUNET_SERVER_Client *client,
+                            const struct iovec *iov,
+                            unsigned int iovcnt)
+{
+  ssize_t ret;
+
+  if (NULL != client->th.callback)
+    return 0;
+  ret = GNUNET_CONNECTION_sendv (client->connection,
+                                 iov,
+                                 iovcnt);
+  if (0 < ret)
+    client->last_activity = GNUNET_TIME_absolute_get ();
+  return ret;
+}
+#endif
+
+
 /**
  * Wrapper for transmission notification that calls the original
  * callback and update the last activity time for our connection.
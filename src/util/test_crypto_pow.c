@@ -0,0 +1,215 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2017 GNUnet e.V.
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file util/test_crypto_pow.c
+ * @brief test the multi-threaded proof-of-work search
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+
+/**
+ * Salt to use.
+ */
+#define SALT "test-crypto-pow"
+
+/**
+ * Number of bits the proof must have.
+ */
+#define BITS 6
+
+/**
+ * Data to find a proof for.
+ */
+static char data[32];
+
+/**
+ * Search we expect to be cancelled.
+ */
+static struct GNUNET_CRYPTO_PowSearch *cancelled;
+
+/**
+ * Search we expect to finish.
+ */
+static struct GNUNET_CRYPTO_PowSearch *ps;
+
+/**
+ * Timeout task.
+ */
+static struct GNUNET_SCHEDULER_Task *tt;
+
+/**
+ * Return value from main().
+ */
+static int ok = 1;
+
+
+/**
+ * Called by the search that should find a proof.
+ *
+ * @param cls NULL
+ * @param nonce proof or checkpoint
+ * @param found #GNUNET_YES if @a nonce is the proof
+ */
+static void
+pow_cb (void *cls,
+        uint64_t nonce,
+        int found)
+{
+  if (GNUNET_YES != found)
+    return;
+  ps = NULL;
+  if (GNUNET_YES ==
+      GNUNET_CRYPTO_pow_check (SALT,
+                               data,
+                               sizeof (data),
+                               nonce,
+                               BITS))
+    ok = 0;
+  else
+    GNUNET_break (0);
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Called by the search that should never find a proof.
+ *
+ * @param cls NULL
+ * @param nonce checkpoint
+ * @param found #GNUNET_YES if @a nonce is the proof
+ */
+static void
+never_cb (void *cls,
+          uint64_t nonce,
+          int found)
+{
+  GNUNET_break (GNUNET_NO == found);
+}
+
+
+/**
+ * Clean up.
+ *
+ * @param cls NULL
+ */
+static void
+do_shutdown (void *cls)
+{
+  if (NULL != tt)
+  {
+    GNUNET_SCHEDULER_cancel (tt);
+    tt = NULL;
+  }
+  if (NULL != ps)
+  {
+    GNUNET_CRYPTO_pow_search_cancel (ps);
+    ps = NULL;
+  }
+}
+
+
+/**
+ * The search took too long.
+ *
+ * @param cls NULL
+ */
+static void
+do_timeout (void *cls)
+{
+  tt = NULL;
+  GNUNET_break (0);
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+/**
+ * Run the test.
+ *
+ * @param cls NULL
+ */
+static void
+run (void *cls)
+{
+  uint64_t resume;
+
+  GNUNET_SCHEDULER_add_shutdown (&do_shutdown,
+                                 NULL);
+  tt = GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MINUTES,
+                                     &do_timeout,
+                                     NULL);
+  /* a search that cannot succeed must be cancellable */
+  cancelled = GNUNET_CRYPTO_pow_search_start (SALT,
+                                              data,
+                                              sizeof (data),
+                                              42,
+                                              sizeof (struct GNUNET_HashCode) * 8,
+                                              3,
+                                              GNUNET_TIME_UNIT_ZERO,
+                                              GNUNET_TIME_UNIT_FOREVER_REL,
+                                              &never_cb,
+                                              NULL);
+  if (NULL == cancelled)
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  resume = GNUNET_CRYPTO_pow_search_cancel (cancelled);
+  cancelled = NULL;
+  if (resume < 42)
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  ps = GNUNET_CRYPTO_pow_search_start (SALT,
+                                       data,
+                                       sizeof (data),
+                                       0,
+                                       BITS,
+                                       0,
+                                       GNUNET_TIME_UNIT_ZERO,
+                                       GNUNET_TIME_UNIT_MILLISECONDS,
+                                       &pow_cb,
+                                       NULL);
+  if (NULL == ps)
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+  }
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("test-crypto-pow",
+                    "WARNING",
+                    NULL);
+  memset (data,
+          23,
+          sizeof (data));
+  GNUNET_SCHEDULER_run (&run,
+                        NULL);
+  return ok;
+}
+
+/* end of test_crypto_pow.c */
@@ -149,6 +149,89 @@ error:
 }
 
 
+static int
+testAead ()
+{
+  struct GNUNET_CRYPTO_SymmetricSessionKey key;
+  struct GNUNET_CRYPTO_AeadNonce nonce;
+  struct GNUNET_CRYPTO_AeadTag tag;
+  char aad[] = "header";
+  char buf[100];
+  /* AES-256-GCM test case 14 of the GCM specification */
+  unsigned char encrresult[] =
+  {
+    0xce, 0xa7, 0x40, 0x3d, 0x4d, 0x60, 0x6b, 0x6e,
+    0x07, 0x4e, 0xc5, 0xd3, 0xba, 0xf3, 0x9d, 0x18
+  };
+  unsigned char tagresult[] =
+  {
+    0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0,
+    0x26, 0x5b, 0x98, 0xb5, 0xd4, 0x8a, 0xb9, 0x19
+  };
+
+  memset (&key, 0, sizeof (key));
+  memset (&nonce, 0, sizeof (nonce));
+  memset (buf, 0, sizeof (encrresult));
+  if ( (sizeof (encrresult) !=
+        GNUNET_CRYPTO_symmetric_aead_encrypt (buf, sizeof (encrresult),
+                                              NULL, 0,
+                                              &key, &nonce,
+                                              buf, &tag)) ||
+       (0 != memcmp (buf, encrresult, sizeof (encrresult))) ||
+       (0 != memcmp (&tag, tagresult, sizeof (tagresult))) )
+  {
+    printf ("AEAD encrypted result wrong.\n");
+    return 1;
+  }
+
+  GNUNET_CRYPTO_symmetric_create_session_key (&key);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &nonce,
+                              sizeof (nonce));
+  memcpy (buf, TESTSTRING, strlen (TESTSTRING) + 1);
+  if (strlen (TESTSTRING) + 1 !=
+      GNUNET_CRYPTO_symmetric_aead_encrypt (buf, strlen (TESTSTRING) + 1,
+                                            aad, sizeof (aad),
+                                            &key, &nonce,
+                                            buf, &tag))
+  {
+    printf ("Wrong return value from AEAD encrypt.\n");
+    return 1;
+  }
+  if ( (-1 !=
+        GNUNET_CRYPTO_symmetric_aead_decrypt (buf, strlen (TESTSTRING) + 1,
+                                              aad, sizeof (aad) - 1,
+                                              &key, &nonce,
+                                              &tag, buf + 50)) )
+  {
+    printf ("AEAD decryption accepted wrong additional data.\n");
+    return 1;
+  }
+  buf[3] ^= 1;
+  if ( (-1 !=
+        GNUNET_CRYPTO_symmetric_aead_decrypt (buf, strlen (TESTSTRING) + 1,
+                                              aad, sizeof (aad),
+                                              &key, &nonce,
+                                              &tag, buf + 50)) )
+  {
+    printf ("AEAD decryption accepted modified ciphertext.\n");
+    return 1;
+  }
+  buf[3] ^= 1;
+  if ( (strlen (TESTSTRING) + 1 !=
+        GNUNET_CRYPTO_symmetric_aead_decrypt (buf, strlen (TESTSTRING) + 1,
+                                              aad, sizeof (aad),
+                                              &key, &nonce,
+                                              &tag, buf)) ||
+       (0 != strcmp (buf, TESTSTRING)) )
+  {
+    printf ("AEAD decryption failed.\n");
+    return 1;
+  }
+  return 0;
+}
+
+
 int
 main (int argc, char *argv[])
 {
@@ -159,6 +242,7 @@ main (int argc, char *argv[])
                  sizeof (struct GNUNET_CRYPTO_SymmetricInitializationVector));
   failureCount += testSymcipher ();
   failureCount += verifyCrypto ();
+  failureCount += testAead ();
 
   if (failureCount != 0)
   {